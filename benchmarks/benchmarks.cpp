@@ -0,0 +1,731 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QRandomGenerator>
+#include <QTimeZone>
+#include <QTextStream>
+#include <QPainter>
+#include <QtMath>
+#include <QtEndian>
+#include "common/rtree.h"
+#include "common/packedrtree.h"
+#include "data/data.h"
+#include "data/track.h"
+#include "map/dem.h"
+#include "map/filter.h"
+#include "map/hillshading.h"
+#include "map/emptymap.h"
+#include "map/maplist.h"
+#include "map/gcs.h"
+#include "map/pcs.h"
+#include "map/IMG/rgnfile.h"
+#include "map/IMG/huffmantable.h"
+#include "map/IMG/jls.h"
+#include "GUI/trackitem.h"
+
+#define TRACK_POINTS  100000
+#define FIT_POINTS    1000000
+#define RTREE_ITEMS   100000
+#define RTREE_QUERIES 1000
+#define MATRIX_SIZE   512
+#define TILE_SIZE     256
+#define RENDER_SIZE   1024
+#define HUFFMAN_WORDS (1024 * 1024)
+#define JLS_DATA      (1024 * 1024)
+
+typedef RTree<int, qreal, 2> RTreeI;
+typedef PackedRTree<int, qreal, 2> PackedRTreeI;
+
+static SegmentData segment(int size)
+{
+	SegmentData sd;
+	QDateTime time(QDate(2020, 1, 1), QTime(0, 0), QTimeZone::utc());
+
+	sd.reserve(size);
+	for (int i = 0; i < size; i++) {
+		Trackpoint p(Coordinates(14.0 + i * 1e-5,
+		  50.0 + qSin(i * 1e-3) * 1e-2));
+		p.setTimestamp(time.addSecs(i));
+		p.setElevation(300 + 50 * qSin(i * 1e-2));
+		p.setHeartRate(120 + 20 * qSin(i * 1e-3));
+		sd.append(p);
+	}
+
+	return sd;
+}
+
+static MatrixD terrain(int size)
+{
+	MatrixD m(size, size);
+
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < size; j++)
+			m.at(i, j) = 500 + 200 * qSin(i * 0.05) * qCos(j * 0.03)
+			  + 20 * qSin((i + j) * 0.4);
+
+	return m;
+}
+
+static void rect(QRandomGenerator &rnd, qreal min[2], qreal max[2])
+{
+	min[0] = rnd.bounded(1000.0);
+	min[1] = rnd.bounded(1000.0);
+	max[0] = min[0] + rnd.bounded(10.0);
+	max[1] = min[1] + rnd.bounded(10.0);
+}
+
+static void query(int i, qreal min[2], qreal max[2])
+{
+	min[0] = (i * 37) % 990;
+	min[1] = (i * 61) % 990;
+	max[0] = min[0] + 10;
+	max[1] = min[1] + 10;
+}
+
+/* Changing the filter settings invalidates the cached track graphs */
+static void invalidateGraphs()
+{
+	Track::setElevationFilter(Track::filterSettings().elevationWindow);
+}
+
+/* The Gaussian blur as it was before the cache friendly vertical pass, for
+   comparison with Filter::blur() (matrices without NaNs only) */
+namespace Old
+{
+	static QVector<int> boxesForGauss(double sigma, int n)
+	{
+		double wIdeal = sqrt((12 * sigma * sigma / n) + 1);
+		int wl = floor(wIdeal);
+		if (wl % 2 == 0)
+			wl--;
+		int wu = wl + 2;
+
+		double mIdeal = (12 * sigma*sigma - n * wl * wl - 4 * n * wl - 3 * n)
+		  / (-4 * wl - 4);
+		int m = round(mIdeal);
+
+		QVector<int> sizes(n);
+		for (int i = 0; i < n; i++)
+			sizes[i] = i < m ? wl : wu;
+
+		return sizes;
+	}
+
+	static void boxBlurH4(const MatrixD &src, MatrixD &dst, int r)
+	{
+		double iarr = 1.0 / (r + r + 1);
+
+		for (int i = 0; i < src.h(); i++) {
+			int ti = i * src.w(), li = ti, ri = ti + r;
+			double fv = src.at(ti);
+			double lv = src.at(ti + src.w() - 1);
+			double val = (r + 1) * fv;
+
+			for (int j = 0; j < r; j++)
+				val += src.at(ti + j);
+			for (int j = 0; j <= r; j++) {
+				val += src.at(ri++) - fv;
+				dst.at(ti++) = val * iarr;
+			}
+			for (int j = r + 1; j < src.w() - r; j++) {
+				val += src.at(ri++) - src.at(li++);
+				dst.at(ti++) = val * iarr;
+			}
+			for (int j = src.w() - r; j < src.w(); j++) {
+				val += lv - src.at(li++);
+				dst.at(ti++) = val * iarr;
+			}
+		}
+	}
+
+	static void boxBlurT4(const MatrixD &src, MatrixD &dst, int r)
+	{
+		double iarr = 1.0 / (r + r + 1);
+
+		for (int i = 0; i < src.w(); i++) {
+			int ti = i, li = ti, ri = ti + r * src.w();
+			double fv = src.at(ti);
+			double lv = src.at(ti + src.w() * (src.h() - 1));
+			double val = (r + 1) * fv;
+
+			for (int j = 0; j < r; j++)
+				val += src.at(ti + j * src.w());
+			for (int j = 0; j <= r; j++) {
+				val += src.at(ri) - fv;
+				dst.at(ti) = val * iarr;
+				ri += src.w(); ti += src.w();
+			}
+			for (int j = r + 1; j < src.h() - r; j++) {
+				val += src.at(ri) - src.at(li);
+				dst.at(ti) = val * iarr;
+				li += src.w(); ri += src.w(); ti += src.w();
+			}
+			for (int j = src.h() - r; j < src.h(); j++) {
+				val += lv - src.at(li);
+				dst.at(ti) = val * iarr;
+				li += src.w(); ti += src.w();
+			}
+		}
+	}
+
+	static void boxBlur4(MatrixD &src, MatrixD &dst, int r)
+	{
+		for (int i = 0; i < src.size(); i++)
+			dst.at(i) = src.at(i);
+
+		boxBlurH4(dst, src, r);
+		boxBlurT4(src, dst, r);
+	}
+
+	static MatrixD blur(const MatrixD &m, int radius)
+	{
+		MatrixD src(m);
+		MatrixD dst(m.h(), m.w());
+		QVector<int> bxs(boxesForGauss(radius, 3));
+
+		boxBlur4(src, dst, (bxs.at(0) - 1) / 2);
+		boxBlur4(dst, src, (bxs.at(1) - 1) / 2);
+		boxBlur4(src, dst, (bxs.at(2) - 1) / 2);
+
+		return dst;
+	}
+}
+
+/* A standalone IMG RGN subfile with a (non-huffman) NT symbols table of
+   a complete canonical code with 3 to 14 bits long codes. The codes over
+   12 bits are decoded by the binary search path, the others by the lookup
+   table. */
+static bool huffmanRGN(const QString &path)
+{
+	static const int lengths[] = {3, 6, 7, 9, 14};
+	static const int counts[] = {4, 16, 15, 64, 128};
+	QByteArray table;
+	quint32 code = 0;
+	int prev = lengths[0], entries = 0;
+
+	table.append((char)0x00); // ACL bits, huffman flag
+	table.append((char)16);   // code bits
+	table.append((char)227);  // binary search entries
+	table.append((char)8);    // symbol bits
+	table.append((char)0x01); // index bytes
+	for (int i = 0; i < 5; i++) {
+		code <<= lengths[i] - prev;
+		prev = lengths[i];
+		for (int j = 0; j < counts[i]; j++, code++, entries++) {
+			quint16 value = code << (16 - lengths[i]);
+			table.append((char)(value & 0xFF));
+			table.append((char)(value >> 8));
+			table.append((char)lengths[i]);
+			table.append((char)entries);
+		}
+	}
+	table.append(2, 0); // empty ACL table
+
+	QByteArray rgn(0x80, 0);
+	qToLittleEndian<quint16>(0x7D, rgn.data());
+	rgn.append((char)(((table.size() & 0x3F) << 2) | 2));
+	rgn.append((char)(table.size() >> 6));
+	rgn.append(table);
+	qToLittleEndian<quint32>(0x80, rgn.data() + 0x71);
+	qToLittleEndian<quint32>(rgn.size() - 0x80, rgn.data() + 0x75);
+	qToLittleEndian<quint32>(0x02, rgn.data() + 0x79); // table ID 0
+
+	QFile file(path);
+	return (file.open(QIODevice::WriteOnly)
+	  && file.write(rgn) == rgn.size());
+}
+
+/* A FIT activity file with one record message definition (timestamp,
+   position, altitude, heart rate and speed) and one data message per track
+   point */
+static bool fitFile(const QString &path, int points)
+{
+	static const quint8 fields[][3] = {
+		{253, 4, 0x86}, {0, 4, 0x85}, {1, 4, 0x85}, {2, 2, 0x84}, {3, 1, 0x02},
+		{6, 2, 0x84}
+	};
+	QFile file(path);
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+
+	QDataStream stream(&file);
+	stream.setByteOrder(QDataStream::LittleEndian);
+
+	stream << (quint8)12 << (quint8)0x10 << (quint16)2093
+	  << (quint32)(6 + sizeof(fields) + points * 18) << (quint32)0x5449462E;
+
+	stream << (quint8)0x40 << (quint8)0 << (quint8)0 << (quint16)20
+	  << (quint8)(sizeof(fields) / sizeof(fields[0]));
+	for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+		stream << fields[i][0] << fields[i][1] << fields[i][2];
+
+	for (int i = 0; i < points; i++) {
+		double lat = 50.0 + qSin(i * 1e-4) * 1e-1;
+		double lon = 14.0 + i * 1e-6;
+		stream << (quint8)0x00 << (quint32)(1000000000 + i)
+		  << (qint32)(lat / 180 * 0x7fffffff)
+		  << (qint32)(lon / 180 * 0x7fffffff)
+		  << (quint16)((300 + 50 * qSin(i * 1e-2) + 500) * 5)
+		  << (quint8)(120 + 20 * qSin(i * 1e-3))
+		  << (quint16)(3000 + 500 * qSin(i * 1e-3));
+	}
+	stream << (quint16)0; // CRC
+
+	return (stream.status() == QDataStream::Ok);
+}
+
+static bool searchCb(int data, void *context)
+{
+	Q_UNUSED(data);
+	++*(int*)context;
+	return true;
+}
+
+static QStringList files(const char *var)
+{
+	QString path(qEnvironmentVariable(var));
+	QStringList list;
+
+	if (path.isEmpty())
+		return list;
+
+	QDir dir(path);
+	QFileInfoList fl(dir.entryInfoList(QDir::Files | QDir::Dirs
+	  | QDir::NoDotAndDotDot, QDir::Name));
+	for (int i = 0; i < fl.size(); i++)
+		list.append(fl.at(i).absoluteFilePath());
+
+	return list;
+}
+
+class Benchmarks : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void initTestCase();
+
+	void parse_data();
+	void parse();
+	void trackGraphs();
+	void graphFilter_data();
+	void graphFilter();
+	void demElevation_data();
+	void demElevation();
+	void hillShading();
+	void blur_data();
+	void blur();
+	void rtreeBuild();
+	void rtreeSearch();
+	void packedRTreeBuild();
+	void packedRTreePack();
+	void packedRTreeSearch();
+	void huffmanDecode();
+	void jlsDecode_data();
+	void jlsDecode();
+	void mapRender_data();
+	void mapRender();
+	void painterPath();
+
+private:
+	QTemporaryDir _dir;
+	QString _gpx;
+	QString _fit;
+};
+
+void Benchmarks::initTestCase()
+{
+	QVERIFY(_dir.isValid());
+
+	_gpx = _dir.filePath("track.gpx");
+	QFile file(_gpx);
+	QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Text));
+
+	SegmentData sd(segment(TRACK_POINTS));
+	QTextStream stream(&file);
+	stream << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	  "<gpx version=\"1.1\" creator=\"benchmarks\""
+	  " xmlns=\"http://www.topografix.com/GPX/1/1\">\n<trk><trkseg>\n";
+	for (int i = 0; i < sd.size(); i++)
+		stream << "<trkpt lat=\"" << QString::number(sd.coordinates(i).lat(),
+		  'f', 7) << "\" lon=\"" << QString::number(sd.coordinates(i).lon(),
+		  'f', 7) << "\"><ele>" << sd.elevation(i) << "</ele><time>"
+		  << sd.timestamp(i).toString(Qt::ISODate) << "</time></trkpt>\n";
+	stream << "</trkseg></trk>\n</gpx>\n";
+
+	_fit = _dir.filePath("track.fit");
+	QVERIFY(fitFile(_fit, FIT_POINTS));
+}
+
+void Benchmarks::parse_data()
+{
+	QTest::addColumn<QString>("file");
+
+	QTest::newRow("synthetic.gpx") << _gpx;
+	QTest::newRow("synthetic.fit") << _fit;
+
+	QStringList list(files("GPXSEE_BENCH_DATA"));
+	for (int i = 0; i < list.size(); i++)
+		QTest::newRow(qPrintable(QFileInfo(list.at(i)).fileName()))
+		  << list.at(i);
+}
+
+void Benchmarks::parse()
+{
+	QFETCH(QString, file);
+
+	QBENCHMARK {
+		Data data(file);
+		QVERIFY(data.isValid());
+	}
+}
+
+void Benchmarks::trackGraphs()
+{
+	Track track(TrackData(segment(TRACK_POINTS)));
+	EmptyMap map;
+
+	QBENCHMARK {
+		invalidateGraphs();
+		track.elevation(&map);
+		track.speed();
+		track.heartRate();
+	}
+}
+
+void Benchmarks::graphFilter_data()
+{
+	static const int windows[] = {3, 11, 31, 101, 301};
+	static const char *names[] = {"average", "median", "gaussian"};
+
+	QTest::addColumn<int>("type");
+	QTest::addColumn<int>("window");
+
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 5; j++)
+			QTest::newRow(qPrintable(QString("%1/%2").arg(names[i])
+			  .arg(windows[j]))) << i << windows[j];
+}
+
+/* The elevation, speed and heart rate graphs of a track filtered with the
+   given filter type and window size */
+void Benchmarks::graphFilter()
+{
+	QFETCH(int, type);
+	QFETCH(int, window);
+
+	Track::Filter settings(Track::filterSettings());
+	Track track(TrackData(segment(TRACK_POINTS)));
+	EmptyMap map;
+
+	Track::setFilterType((Track::FilterType)type);
+	Track::setSpeedFilter(window);
+	Track::setHeartRateFilter(window);
+
+	QBENCHMARK {
+		Track::setElevationFilter(window);
+		track.elevation(&map);
+		track.speed();
+		track.heartRate();
+	}
+
+	Track::setFilterType(settings.type);
+	Track::setElevationFilter(settings.elevationWindow);
+	Track::setSpeedFilter(settings.speedWindow);
+	Track::setHeartRateFilter(settings.heartRateWindow);
+}
+
+/* 260x260 is the DEM matrix of a 256px raster tile with hillshading (the
+   tile is extended by blur + 1 = 2px on every side) */
+void Benchmarks::demElevation_data()
+{
+	QTest::addColumn<int>("size");
+
+	QTest::newRow("260x260") << 260;
+	QTest::newRow("512x512") << MATRIX_SIZE;
+}
+
+void Benchmarks::demElevation()
+{
+	QFETCH(int, size);
+
+	QString dir(qEnvironmentVariable("GPXSEE_BENCH_DEM"));
+	if (dir.isEmpty())
+		QSKIP("GPXSEE_BENCH_DEM not set");
+
+	DEM::setDir(dir);
+	QList<Area> tiles(DEM::tiles());
+	if (tiles.isEmpty())
+		QSKIP("No DEM tiles found");
+
+	const RectC &br = tiles.first().boundingRect();
+	MatrixC ll(size, size);
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < size; j++)
+			ll.at(i, j) = Coordinates(br.left() + (br.right() - br.left())
+			  * j / size, br.top() - (br.top() - br.bottom()) * i / size);
+
+	QBENCHMARK {
+		DEM::elevation(ll);
+	}
+}
+
+void Benchmarks::hillShading()
+{
+	MatrixD m(terrain(TILE_SIZE + 2));
+
+	QBENCHMARK {
+		HillShading::render(m, 1);
+	}
+}
+
+void Benchmarks::blur_data()
+{
+	QTest::addColumn<bool>("old");
+
+	QTest::newRow("current") << false;
+	QTest::newRow("old") << true;
+}
+
+/* The current blur must give bit-identical results to the old one */
+void Benchmarks::blur()
+{
+	QFETCH(bool, old);
+
+	MatrixD m(terrain(MATRIX_SIZE));
+	MatrixD current(Filter::blur(m, 3));
+	MatrixD reference(Old::blur(m, 3));
+	for (int i = 0; i < m.size(); i++)
+		QVERIFY(current.at(i) == reference.at(i));
+
+	if (old) {
+		QBENCHMARK {
+			Old::blur(m, 3);
+		}
+	} else {
+		QBENCHMARK {
+			Filter::blur(m, 3);
+		}
+	}
+}
+
+void Benchmarks::rtreeBuild()
+{
+	QRandomGenerator rnd(42);
+
+	QBENCHMARK {
+		RTreeI tree;
+		for (int i = 0; i < RTREE_ITEMS; i++) {
+			qreal min[2], max[2];
+			rect(rnd, min, max);
+			tree.Insert(min, max, i);
+		}
+	}
+}
+
+void Benchmarks::rtreeSearch()
+{
+	QRandomGenerator rnd(42);
+	RTreeI tree;
+
+	for (int i = 0; i < RTREE_ITEMS; i++) {
+		qreal min[2], max[2];
+		rect(rnd, min, max);
+		tree.Insert(min, max, i);
+	}
+
+	QBENCHMARK {
+		int found = 0;
+		for (int i = 0; i < RTREE_QUERIES; i++) {
+			qreal min[2], max[2];
+			query(i, min, max);
+			tree.Search(min, max, searchCb, &found);
+		}
+	}
+}
+
+/* Insert() + Pack(), the same items as in rtreeBuild() */
+void Benchmarks::packedRTreeBuild()
+{
+	QRandomGenerator rnd(42);
+
+	QBENCHMARK {
+		PackedRTreeI tree;
+		for (int i = 0; i < RTREE_ITEMS; i++) {
+			qreal min[2], max[2];
+			rect(rnd, min, max);
+			tree.Insert(min, max, i);
+		}
+		tree.Pack();
+	}
+}
+
+/* Pack() only (plus copying the items), the tree is repacked from the same
+   inserted items in every iteration */
+void Benchmarks::packedRTreePack()
+{
+	QRandomGenerator rnd(42);
+	PackedRTreeI items;
+
+	for (int i = 0; i < RTREE_ITEMS; i++) {
+		qreal min[2], max[2];
+		rect(rnd, min, max);
+		items.Insert(min, max, i);
+	}
+
+	QBENCHMARK {
+		PackedRTreeI tree(items);
+		tree.Pack();
+	}
+}
+
+void Benchmarks::packedRTreeSearch()
+{
+	QRandomGenerator rnd(42);
+	PackedRTreeI tree;
+
+	for (int i = 0; i < RTREE_ITEMS; i++) {
+		qreal min[2], max[2];
+		rect(rnd, min, max);
+		tree.Insert(min, max, i);
+	}
+	tree.Pack();
+
+	QBENCHMARK {
+		int found = 0;
+		for (int i = 0; i < RTREE_QUERIES; i++) {
+			qreal min[2], max[2];
+			query(i, min, max);
+			tree.Search(min, max, searchCb, &found);
+		}
+	}
+}
+
+/* Decodes a random (but with the complete code always valid) bit stream
+   symbol by symbol */
+void Benchmarks::huffmanDecode()
+{
+	QString path(_dir.filePath("huffman.rgn"));
+	QVERIFY(huffmanRGN(path));
+
+	IMG::RGNFile rgn(path);
+	IMG::SubFile::Handle hdl(&rgn);
+	QVERIFY(rgn.load(hdl));
+	const IMG::HuffmanTable *table = rgn.huffmanTable();
+	QVERIFY(table);
+
+	QRandomGenerator rnd(42);
+	QVector<quint32> bits(HUFFMAN_WORDS + 1);
+	rnd.fillRange(bits.data(), bits.size());
+
+	QBENCHMARK {
+		quint64 pos = 0, end = (quint64)HUFFMAN_WORDS * 32;
+		quint32 sum = 0;
+
+		while (pos < end) {
+			int w = pos >> 5, o = pos & 31;
+			quint32 data = o
+			  ? (bits.at(w) << o) | (bits.at(w + 1) >> (32 - o)) : bits.at(w);
+			quint8 size;
+			sum += table->symbol(data, size);
+			pos += size;
+		}
+
+		QVERIFY(sum);
+	}
+}
+
+void Benchmarks::jlsDecode_data()
+{
+	QTest::addColumn<bool>("flat");
+
+	QTest::newRow("random") << false;
+	QTest::newRow("flat") << true;
+}
+
+/* Decodes a 256x256 DEM tile from random data (mostly the regular mode) or
+   from all ones bits (a flat tile, the run mode only) */
+void Benchmarks::jlsDecode()
+{
+	QFETCH(bool, flat);
+
+	QString path(_dir.filePath(flat ? "flat.jls" : "random.jls"));
+	QByteArray data(JLS_DATA, (char)0xFF);
+	if (!flat) {
+		QRandomGenerator rnd(42);
+		rnd.fillRange((quint32*)data.data(), data.size() / sizeof(quint32));
+	}
+	QFile file(path);
+	QVERIFY(file.open(QIODevice::WriteOnly));
+	QVERIFY(file.write(data) == data.size());
+	file.close();
+
+	IMG::SubFile sf(path);
+	IMG::SubFile::Handle hdl(&sf);
+	IMG::JLS jls(1023, 0);
+	Matrix<qint16> img(TILE_SIZE, TILE_SIZE);
+
+	QBENCHMARK {
+		QVERIFY(sf.seek(hdl, 0));
+		QVERIFY(jls.decode(&sf, hdl, img));
+	}
+}
+
+void Benchmarks::mapRender_data()
+{
+	QTest::addColumn<QString>("file");
+
+	QStringList list(files("GPXSEE_BENCH_MAPS"));
+	if (list.isEmpty())
+		QTest::newRow("none") << QString();
+	for (int i = 0; i < list.size(); i++)
+		QTest::newRow(qPrintable(QFileInfo(list.at(i)).fileName()))
+		  << list.at(i);
+}
+
+/* Renders a fixed area in the map center on a detailed zoom level. All the
+   tiles are rendered in every iteration as the map is reloaded. */
+void Benchmarks::mapRender()
+{
+	QFETCH(QString, file);
+
+	if (file.isEmpty())
+		QSKIP("GPXSEE_BENCH_MAPS not set");
+
+	Map *map = MapList::loadMap(file, GCS::gcs(4326));
+	QVERIFY(map);
+
+	map->load(GCS::gcs(4326), PCS::pcs(3857), 1.0, false, -1, -1);
+	Coordinates c(map->llBounds().center());
+	map->zoomFit(QSize(RENDER_SIZE, RENDER_SIZE), RectC(c, 2000));
+	QPointF center(map->ll2xy(c));
+	QRectF rect(center.x() - RENDER_SIZE / 2, center.y() - RENDER_SIZE / 2,
+	  RENDER_SIZE, RENDER_SIZE);
+	map->unload();
+
+	QImage img(RENDER_SIZE, RENDER_SIZE, QImage::Format_ARGB32_Premultiplied);
+
+	QBENCHMARK {
+		map->load(GCS::gcs(4326), PCS::pcs(3857), 1.0, false, -1, -1);
+		QPainter painter(&img);
+		painter.translate(-rect.topLeft());
+		map->draw(&painter, rect, Map::Block);
+		painter.end();
+		map->unload();
+	}
+
+	delete map;
+}
+
+void Benchmarks::painterPath()
+{
+	Track track(TrackData(segment(TRACK_POINTS)));
+	EmptyMap map;
+	TrackItem item(track, &map);
+
+	QBENCHMARK {
+		item.setMap(&map);
+	}
+}
+
+QTEST_MAIN(Benchmarks)
+#include "benchmarks.moc"
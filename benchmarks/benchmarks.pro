@@ -0,0 +1,38 @@
+# GPXSee benchmarks (QtTest QBENCHMARK). Build with:
+#   qmake benchmarks/benchmarks.pro && make
+# and get machine-readable results with e.g.:
+#   ./gpxsee-benchmarks -o results.xml,xml
+#
+# The reference data are taken from the directories given by the
+# GPXSEE_BENCH_DATA (data files), GPXSEE_BENCH_MAPS (map files) and
+# GPXSEE_BENCH_DEM (DEM tiles) environment variables. Benchmarks without
+# reference data use synthetic data or are skipped.
+
+include(../gpxsee.pro)
+
+TARGET = gpxsee-benchmarks
+QT += testlib
+CONFIG += console
+CONFIG -= app_bundle
+
+# gpxsee.pro lists the files relative to the top directory
+APP_HEADERS = $$HEADERS
+APP_SOURCES = $$SOURCES
+APP_RESOURCES = $$RESOURCES
+APP_SOURCES -= src/main.cpp
+HEADERS =
+SOURCES =
+RESOURCES =
+for(file, APP_HEADERS): HEADERS += ../$$file
+for(file, APP_SOURCES): SOURCES += ../$$file
+for(file, APP_RESOURCES): RESOURCES += ../$$file
+INCLUDEPATH += ../src
+
+SOURCES += benchmarks.cpp
+
+TRANSLATIONS =
+INSTALLS =
+QMAKE_BUNDLE_DATA =
+ICON =
+QMAKE_INFO_PLIST =
+RC_ICONS =
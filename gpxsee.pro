@@ -35,18 +35,30 @@ HEADERS += src/common/config.h \
     src/common/wgs84.h \
     src/common/util.h \
     src/common/rtree.h \
+    src/common/packedrtree.h \
     src/common/kv.h \
     src/common/greatcircle.h \
     src/common/programpaths.h \
     src/common/tifffile.h \
+    src/common/trace.h \
+    src/common/cacheregistry.h \
+    src/common/threadpools.h \
     src/common/polygon.h \
     src/common/color.h \
     src/common/csv.h \
+    src/common/mappedfile.h \
+    src/common/linechunks.h \
+    src/common/ziparchive.h \
+    src/common/parse.h \
+    src/common/xml.h \
+    src/GUI/clusteritem.h \
     src/GUI/crosshairitem.h \
     src/GUI/motioninfoitem.h \
     src/GUI/pluginparameters.h \
     src/GUI/authenticationwidget.h \
     src/GUI/axislabelitem.h \
+    src/GUI/datastatistics.h \
+    src/GUI/memorydialog.h \
     src/GUI/dirselectwidget.h \
     src/GUI/flowlayout.h \
     src/GUI/graphicsscene.h \
@@ -59,7 +71,10 @@ HEADERS += src/common/config.h \
     src/GUI/poiaction.h \
     src/GUI/popup.h \
     src/GUI/thumbnail.h \
+    src/GUI/thumbnailcache.h \
     src/GUI/app.h \
+    src/GUI/tileserver.h \
+    src/GUI/startupprofile.h \
     src/GUI/icons.h \
     src/GUI/gui.h \
     src/GUI/axisitem.h \
@@ -83,9 +98,11 @@ HEADERS += src/common/config.h \
     src/GUI/graphtab.h \
     src/GUI/trackitem.h \
     src/GUI/tooltip.h \
+    src/GUI/rendercontext.h \
     src/GUI/routeitem.h \
     src/GUI/graphitem.h \
     src/GUI/pathitem.h \
+    src/GUI/pathlod.h \
     src/GUI/griditem.h \
     src/GUI/format.h \
     src/GUI/cadencegraph.h \
@@ -105,15 +122,17 @@ HEADERS += src/common/config.h \
     src/GUI/gearratiographitem.h \
     src/GUI/oddspinbox.h \
     src/GUI/settings.h \
-    src/GUI/searchpointer.h \
     src/GUI/mapview.h \
     src/GUI/font.h \
     src/GUI/areaitem.h \
     src/GUI/coordinatesitem.h \
     src/GUI/projectioncombobox.h \
     src/GUI/pathtickitem.h \
+    src/GUI/heatmapitem.h \
     src/GUI/pdfexportdialog.h \
     src/GUI/pngexportdialog.h \
+    src/GUI/pngwriter.h \
+    src/GUI/tileseeddialog.h \
     src/GUI/timezoneinfo.h \
     src/GUI/passwordedit.h \
     src/data/gpsdumpparser.h \
@@ -146,8 +165,12 @@ HEADERS += src/common/config.h \
     src/map/encmap.h \
     src/map/ENC/iso8211.h \
     src/map/filter.h \
+    src/map/llgrid.h \
     src/map/gemfmap.h \
     src/map/gmifile.h \
+    src/map/datatilejob.h \
+    src/map/imagetile.h \
+    src/map/imagetilejob.h \
     src/map/imgjob.h \
     src/map/metatype.h \
     src/map/mvtstyle.h \
@@ -169,6 +192,7 @@ HEADERS += src/common/config.h \
     src/map/proj/polarstereographic.h \
     src/map/proj/obliquestereographic.h \
     src/map/bitmapline.h \
+    src/map/blockloader.h \
     src/map/IMG/bitstream.h \
     src/map/IMG/deltastream.h \
     src/map/IMG/gmapdata.h \
@@ -184,6 +208,7 @@ HEADERS += src/common/config.h \
     src/map/IMG/imgdata.h \
     src/map/IMG/subfile.h \
     src/map/IMG/trefile.h \
+    src/map/IMG/tileindex.h \
     src/map/IMG/rgnfile.h \
     src/map/IMG/lblfile.h \
     src/map/IMG/vectortile.h \
@@ -196,6 +221,7 @@ HEADERS += src/common/config.h \
     src/map/mapsforge/rastertile.h \
     src/map/mapsforge/subfile.h \
     src/map/qctmap.h \
+    src/map/textcache.h \
     src/map/textpathitem.h \
     src/map/textpointitem.h \
     src/map/prjfile.h \
@@ -206,10 +232,12 @@ HEADERS += src/common/config.h \
     src/map/ellipsoid.h \
     src/map/datum.h \
     src/map/sqlitemap.h \
+    src/map/sqlitetiles.h \
     src/map/utm.h \
     src/map/map.h \
     src/map/dem.h \
     src/map/maplist.h \
+    src/map/mapstub.h \
     src/map/onlinemap.h \
     src/map/tile.h \
     src/map/emptymap.h \
@@ -218,8 +246,10 @@ HEADERS += src/common/config.h \
     src/map/ozf.h \
     src/map/atlas.h \
     src/map/matrix.h \
+    src/map/alignedmatrix.h \
     src/map/geotiff.h \
     src/map/pcs.h \
+    src/map/lazylist.h \
     src/map/transform.h \
     src/map/mapfile.h \
     src/map/gcs.h \
@@ -229,6 +259,13 @@ HEADERS += src/common/config.h \
     src/map/ct.h \
     src/map/mapsource.h \
     src/map/tileloader.h \
+    src/map/tilecache.h \
+    src/map/tilecoverage.h \
+    src/map/tileorder.h \
+    src/map/tilepack.h \
+    src/map/tileseeder.h \
+    src/map/validatorstore.h \
+    src/map/capabilitiesfile.h \
     src/map/wldfile.h \
     src/map/wmtsmap.h \
     src/map/wmts.h \
@@ -242,11 +279,13 @@ HEADERS += src/common/config.h \
     src/map/jnxmap.h \
     src/map/geotiffmap.h \
     src/map/image.h \
+    src/map/tiffimage.h \
     src/map/mbtilesmap.h \
     src/map/osm.h \
     src/map/rmap.h \
     src/map/calibrationpoint.h \
     src/map/textitem.h \
+    src/map/textitemlist.h \
     src/map/aqmmap.h \
     src/map/mapsforgemap.h \
     src/map/worldfilemap.h \
@@ -263,8 +302,14 @@ HEADERS += src/common/config.h \
     src/data/route.h \
     src/data/trackpoint.h \
     src/data/data.h \
+    src/data/dataloader.h \
+    src/data/datacache.h \
+    src/data/archive.h \
+    src/data/streamloader.h \
+    src/data/filetail.h \
     src/data/parser.h \
     src/data/trackdata.h \
+    src/data/segmentdata.h \
     src/data/routedata.h \
     src/data/path.h \
     src/data/gpxparser.h \
@@ -296,13 +341,23 @@ SOURCES += src/main.cpp \
     src/common/greatcircle.cpp \
     src/common/programpaths.cpp \
     src/common/tifffile.cpp \
+    src/common/trace.cpp \
+    src/common/cacheregistry.cpp \
+    src/common/threadpools.cpp \
     src/common/csv.cpp \
+    src/common/mappedfile.cpp \
+    src/common/ziparchive.cpp \
+    src/common/parse.cpp \
+    src/common/xml.cpp \
+    src/GUI/clusteritem.cpp \
     src/GUI/crosshairitem.cpp \
     src/GUI/motioninfoitem.cpp \
     src/GUI/pluginparameters.cpp \
     src/GUI/settings.cpp \
     src/GUI/authenticationwidget.cpp \
     src/GUI/axislabelitem.cpp \
+    src/GUI/datastatistics.cpp \
+    src/GUI/memorydialog.cpp \
     src/GUI/dirselectwidget.cpp \
     src/GUI/flowlayout.cpp \
     src/GUI/infolabel.cpp \
@@ -311,7 +366,10 @@ SOURCES += src/main.cpp \
     src/GUI/markerinfoitem.cpp \
     src/GUI/popup.cpp \
     src/GUI/thumbnail.cpp \
+    src/GUI/thumbnailcache.cpp \
     src/GUI/app.cpp \
+    src/GUI/tileserver.cpp \
+    src/GUI/startupprofile.cpp \
     src/GUI/gui.cpp \
     src/GUI/axisitem.cpp \
     src/GUI/slideritem.cpp \
@@ -330,9 +388,11 @@ SOURCES += src/main.cpp \
     src/GUI/fileselectwidget.cpp \
     src/GUI/temperaturegraph.cpp \
     src/GUI/trackitem.cpp \
+    src/GUI/rendercontext.cpp \
     src/GUI/routeitem.cpp \
     src/GUI/graphitem.cpp \
     src/GUI/pathitem.cpp \
+    src/GUI/pathlod.cpp \
     src/GUI/griditem.cpp \
     src/GUI/format.cpp \
     src/GUI/cadencegraph.cpp \
@@ -354,9 +414,12 @@ SOURCES += src/main.cpp \
     src/GUI/areaitem.cpp \
     src/GUI/coordinatesitem.cpp \
     src/GUI/pathtickitem.cpp \
+    src/GUI/heatmapitem.cpp \
     src/GUI/graphicsscene.cpp \
     src/GUI/pdfexportdialog.cpp \
     src/GUI/pngexportdialog.cpp \
+    src/GUI/pngwriter.cpp \
+    src/GUI/tileseeddialog.cpp \
     src/GUI/projectioncombobox.cpp \
     src/GUI/passwordedit.cpp \
     src/data/txtparser.cpp \
@@ -378,6 +441,7 @@ SOURCES += src/main.cpp \
     src/map/encmap.cpp \
     src/map/ENC/iso8211.cpp \
     src/map/filter.cpp \
+    src/map/llgrid.cpp \
     src/map/gemfmap.cpp \
     src/map/gmifile.cpp \
     src/map/mvtstyle.cpp \
@@ -396,6 +460,7 @@ SOURCES += src/main.cpp \
     src/map/proj/polarstereographic.cpp \
     src/map/proj/obliquestereographic.cpp \
     src/map/bitmapline.cpp \
+    src/map/blockloader.cpp \
     src/map/IMG/bitstream.cpp \
     src/map/IMG/deltastream.cpp \
     src/map/IMG/gmapdata.cpp \
@@ -409,6 +474,7 @@ SOURCES += src/main.cpp \
     src/map/IMG/imgdata.cpp \
     src/map/IMG/subfile.cpp \
     src/map/IMG/trefile.cpp \
+    src/map/IMG/tileindex.cpp \
     src/map/IMG/rgnfile.cpp \
     src/map/IMG/lblfile.cpp \
     src/map/IMG/vectortile.cpp \
@@ -421,19 +487,23 @@ SOURCES += src/main.cpp \
     src/map/imgmap.cpp \
     src/map/prjfile.cpp \
     src/map/qctmap.cpp \
+    src/map/textcache.cpp \
     src/map/textpathitem.cpp \
     src/map/textpointitem.cpp \
     src/map/bsbmap.cpp \
     src/map/kmzmap.cpp \
     src/map/maplist.cpp \
+    src/map/mapstub.cpp \
     src/map/onlinemap.cpp \
     src/map/emptymap.cpp \
     src/map/ozimap.cpp \
     src/map/sqlitemap.cpp \
+    src/map/sqlitetiles.cpp \
     src/map/tar.cpp \
     src/map/atlas.cpp \
     src/map/ozf.cpp \
     src/map/matrix.cpp \
+    src/map/alignedmatrix.cpp \
     src/map/ellipsoid.cpp \
     src/map/datum.cpp \
     src/map/utm.cpp \
@@ -448,6 +518,12 @@ SOURCES += src/main.cpp \
     src/map/linearunits.cpp \
     src/map/mapsource.cpp \
     src/map/tileloader.cpp \
+    src/map/tilecache.cpp \
+    src/map/tilecoverage.cpp \
+    src/map/tilepack.cpp \
+    src/map/tileseeder.cpp \
+    src/map/validatorstore.cpp \
+    src/map/capabilitiesfile.cpp \
     src/map/wldfile.cpp \
     src/map/wmtsmap.cpp \
     src/map/wmts.cpp \
@@ -461,11 +537,13 @@ SOURCES += src/main.cpp \
     src/map/dem.cpp \
     src/map/geotiffmap.cpp \
     src/map/image.cpp \
+    src/map/tiffimage.cpp \
     src/map/mbtilesmap.cpp \
     src/map/osm.cpp \
     src/map/rectd.cpp \
     src/map/rmap.cpp \
     src/map/textitem.cpp \
+    src/map/textitemlist.cpp \
     src/map/aqmmap.cpp \
     src/map/mapsforgemap.cpp \
     src/map/worldfilemap.cpp \
@@ -478,8 +556,14 @@ SOURCES += src/main.cpp \
     src/data/ov2parser.cpp \
     src/data/waypoint.cpp \
     src/data/data.cpp \
+    src/data/dataloader.cpp \
+    src/data/datacache.cpp \
+    src/data/archive.cpp \
+    src/data/streamloader.cpp \
+    src/data/filetail.cpp \
     src/data/poi.cpp \
     src/data/track.cpp \
+    src/data/segmentdata.cpp \
     src/data/route.cpp \
     src/data/path.cpp \
     src/data/gpxparser.cpp \
@@ -499,6 +583,9 @@ SOURCES += src/main.cpp \
     src/data/geojsonparser.cpp
 
 DEFINES += APP_VERSION=\\\"$$VERSION\\\"
+notrace {
+    DEFINES += NO_TRACE
+}
 
 RESOURCES += gpxsee.qrc
 TRANSLATIONS = lang/gpxsee_en.ts \
@@ -4,12 +4,26 @@ import android.content.Intent;
 
 public class Activity extends org.qtproject.qt.android.bindings.QtActivity
 {
+	private static native void trimMemory(int level);
+
 	@Override
 	public void onNewIntent(Intent intent)
 	{
 		setIntent(intent);
 	}
 
+	@Override
+	public void onTrimMemory(int level)
+	{
+		super.onTrimMemory(level);
+
+		/* The native method is registered only after the app has started */
+		try {
+			trimMemory(level);
+		} catch (UnsatisfiedLinkError e) {
+		}
+	}
+
 	public String intentPath()
 	{
 		String path = null;
@@ -7,23 +7,181 @@
 #include <QLibraryInfo>
 #include <QImageReader>
 #include <QFileInfo>
+#include <QDir>
+#include <QImage>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QPixmapCache>
 #ifdef Q_OS_ANDROID
 #include <QCoreApplication>
 #include <QJniObject>
+#include <QJniEnvironment>
 #endif // Q_OS_ANDROID
 #include "common/programpaths.h"
 #include "common/config.h"
+#include "common/trace.h"
+#include "common/cacheregistry.h"
 #include "map/downloader.h"
 #include "map/dem.h"
 #include "map/ellipsoid.h"
 #include "map/gcs.h"
 #include "map/conversion.h"
 #include "map/pcs.h"
+#include "map/map.h"
+#include "map/maplist.h"
 #include "data/waypoint.h"
+#include "data/data.h"
+#include "data/dataloader.h"
 #include "gui.h"
 #include "mapaction.h"
+#include "rendercontext.h"
+#include "tileserver.h"
+#include "startupprofile.h"
 #include "app.h"
 
+#define DEFAULT_RENDER_SIZE 512
+#define DEFAULT_SERVER_PORT 8080
+
+#ifdef Q_OS_ANDROID
+/* android.content.ComponentCallbacks2 */
+#define TRIM_MEMORY_RUNNING_LOW 10
+
+/* Activity.onTrimMemory() native callback, called from the Android UI
+   thread */
+static void onTrimMemory(JNIEnv *env, jclass cls, jint level)
+{
+	Q_UNUSED(env);
+	Q_UNUSED(cls);
+
+	QMetaObject::invokeMethod(QCoreApplication::instance(), "trimMemory",
+	  Qt::QueuedConnection, Q_ARG(int, level));
+}
+#endif // Q_OS_ANDROID
+
+static bool headless(const QStringList &args)
+{
+	for (int i = 1; i < args.count(); i++)
+		if (args.at(i) == "--render" || args.at(i) == "--serve"
+		  || args.at(i).startsWith("--serve="))
+			return true;
+
+	return false;
+}
+
+/* A null rect renders the whole context content. With a nonempty compare
+   directory, the images are compared with the reference images of the same
+   name in that directory. */
+struct RenderOptions
+{
+	RenderOptions() : size(DEFAULT_RENDER_SIZE, DEFAULT_RENDER_SIZE),
+	  timings(false), tolerance(0) {}
+
+	RectC rect;
+	QSize size;
+	bool timings;
+	QString compare;
+	int tolerance;
+};
+
+/* Pixels with any channel differing by more than tolerance from the
+   reference image are counted as different */
+static bool compareImage(const QImage &img, const QString &fileName,
+  int tolerance)
+{
+	QImage ref(fileName);
+	if (ref.isNull()) {
+		qWarning("%s: error reading reference image",
+		  qUtf8Printable(fileName));
+		return false;
+	}
+	if (ref.size() != img.size()) {
+		qWarning("%s: image size differs", qUtf8Printable(fileName));
+		return false;
+	}
+
+	QImage a(img.convertToFormat(QImage::Format_ARGB32));
+	QImage b(ref.convertToFormat(QImage::Format_ARGB32));
+	int diff = 0;
+
+	for (int y = 0; y < a.height(); y++) {
+		const QRgb *la = (const QRgb*)a.constScanLine(y);
+		const QRgb *lb = (const QRgb*)b.constScanLine(y);
+
+		for (int x = 0; x < a.width(); x++)
+			if (qAbs(qRed(la[x]) - qRed(lb[x])) > tolerance
+			  || qAbs(qGreen(la[x]) - qGreen(lb[x])) > tolerance
+			  || qAbs(qBlue(la[x]) - qBlue(lb[x])) > tolerance
+			  || qAbs(qAlpha(la[x]) - qAlpha(lb[x])) > tolerance)
+				diff++;
+	}
+
+	if (diff) {
+		qWarning("%s: %d pixels differ", qUtf8Printable(fileName), diff);
+		return false;
+	}
+
+	return true;
+}
+
+static bool renderImage(RenderContext &ctx, const RenderOptions &opts,
+  const QString &fileName)
+{
+	QImage img(opts.size, QImage::Format_ARGB32_Premultiplied);
+	QElapsedTimer timer;
+
+	img.fill(Qt::white);
+	timer.start();
+	ctx.render(&img, opts.rect.isNull() ? ctx.bounds() : opts.rect);
+	if (opts.timings)
+		qInfo("%s: %lld ms", qUtf8Printable(fileName), timer.elapsed());
+
+	if (!img.save(fileName, "png")) {
+		qWarning("%s: error writing image file", qUtf8Printable(fileName));
+		return false;
+	}
+
+	return (opts.compare.isEmpty() || compareImage(img, QDir(opts.compare)
+	  .filePath(QFileInfo(fileName).fileName()), opts.tolerance));
+}
+
+/* With a single input file, out is the output image file, otherwise it is
+   the output directory where the images are named after the input files.
+   The files are parsed in parallel and rendered one by one with the same
+   (loaded once) map. */
+static bool renderFiles(RenderContext &ctx, const QStringList &files,
+  const RenderOptions &opts, const QString &out)
+{
+	DataLoader loader(files, true);
+	QList<DataLoader::File> batch;
+	bool dir = (files.size() > 1 || QFileInfo(out).isDir());
+	bool ret = true;
+
+	loader.run();
+	while (loader.next(batch)) {
+		for (int i = 0; i < batch.size(); i++) {
+			DataLoader::File &file = batch[i];
+			const Data *data = file.data();
+
+			if (data->isValid()) {
+				QString fileName(dir ? QDir(out).filePath(QFileInfo(
+				  file.fileName()).completeBaseName() + ".png") : out);
+
+				ctx.clear();
+				ctx.addData(*data);
+				if (!renderImage(ctx, opts, fileName))
+					ret = false;
+			} else {
+				qWarning("%s: %s", qUtf8Printable(file.fileName()),
+				  qUtf8Printable(data->errorString()));
+				ret = false;
+			}
+
+			file.clear();
+		}
+	}
+
+	return ret;
+}
 
 App::App(int &argc, char **argv) : QApplication(argc, argv)
 {
@@ -33,6 +191,9 @@ App::App(int &argc, char **argv) : QApplication(argc, argv)
 	setApplicationName(QString(APP_NAME).toLower());
 #endif // Q_OS_WIN32 || Q_OS_MAC
 	setApplicationVersion(APP_VERSION);
+	StartupProfile::mark("application");
+
+	Trace::init();
 
 	QTranslator *app = new QTranslator(this);
 	QString trdir(ProgramPaths::translationsDir());
@@ -53,6 +214,7 @@ App::App(int &argc, char **argv) : QApplication(argc, argv)
 #endif // QT 6
 #endif // Q_OS_WIN32 || Q_OS_MAC
 		installTranslator(qt);
+	StartupProfile::mark("translations");
 
 #ifdef Q_OS_MAC
 	setAttribute(Qt::AA_DontShowIconsInMenus);
@@ -63,41 +225,250 @@ App::App(int &argc, char **argv) : QApplication(argc, argv)
 	   "QThreadStorage: Thread X exited after QThreadStorage Y destroyed" */
 	Downloader::setNetworkManager(new QNetworkAccessManager(this));
 	DEM::setDir(ProgramPaths::demDir());
+	DEM::setCacheDir(ProgramPaths::demCacheDir());
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
 	QImageReader::setAllocationLimit(0);
 #endif // QT6
 
 	loadDatums();
 	loadPCSs();
+	StartupProfile::mark("datums & projections");
 	Waypoint::loadSymbolIcons(ProgramPaths::symbolsDir());
+	StartupProfile::mark("symbols");
 
 #if defined(Q_OS_WIN32) || defined(Q_OS_MAC)
 	QIcon::setThemeName(APP_NAME);
 #endif // Q_OS_WIN32 || Q_OS_MAC
 	QIcon::setFallbackThemeName(APP_NAME);
 
+	/* No GUI is created in the headless render/server modes */
+	if (headless(arguments())) {
+		_gui = 0;
+		return;
+	}
+
 	_gui = new GUI(app->language());
+	StartupProfile::mark("GUI");
 
 #ifdef Q_OS_ANDROID
 	connect(this, &App::applicationStateChanged, this, &App::appStateChanged);
+
+	const JNINativeMethod methods[] = {
+		{"trimMemory", "(I)V", reinterpret_cast<void *>(onTrimMemory)}
+	};
+	QJniEnvironment env;
+	env.registerNativeMethods("org/gpxsee/gpxsee/Activity", methods, 1);
 #endif // Q_OS_ANDROID
 }
 
 App::~App()
 {
 	delete _gui;
+
+	if (Trace::isEnabled())
+		Trace::dump(Trace::fileName());
+}
+
+/* --seed=ZOOM or --seed=MINZOOM-MAXZOOM */
+static bool seedZooms(const QString &arg, Range &zooms)
+{
+	if (!arg.startsWith("--seed="))
+		return false;
+
+	QStringList list(arg.mid(7).split('-'));
+	bool ok1, ok2;
+	int min = list.first().toInt(&ok1);
+	int max = list.last().toInt(&ok2);
+	if (list.size() > 2 || !ok1 || !ok2 || min > max) {
+		qWarning("%s: invalid zoom range", qUtf8Printable(arg));
+		zooms = Range(0, -1);
+	} else
+		zooms = Range(min, max);
+
+	return true;
+}
+
+/* --size=WxH */
+static bool renderSize(const QString &arg, QSize &size)
+{
+	if (!arg.startsWith("--size="))
+		return false;
+
+	QStringList list(arg.mid(7).split('x'));
+	bool ok1, ok2;
+	int w = list.first().toInt(&ok1);
+	int h = list.last().toInt(&ok2);
+	if (list.size() != 2 || !ok1 || !ok2 || w <= 0 || h <= 0) {
+		qWarning("%s: invalid image size", qUtf8Printable(arg));
+		size = QSize();
+	} else
+		size = QSize(w, h);
+
+	return true;
+}
+
+/* --bounds=LEFT,TOP,RIGHT,BOTTOM (WGS84) */
+static bool renderBounds(const QString &arg, RectC &rect)
+{
+	if (!arg.startsWith("--bounds="))
+		return false;
+
+	QStringList list(arg.mid(9).split(','));
+	double val[4];
+	bool ok = (list.size() == 4);
+	for (int i = 0; ok && i < 4; i++)
+		val[i] = list.at(i).toDouble(&ok);
+
+	rect = ok ? RectC(Coordinates(val[0], val[1]), Coordinates(val[2], val[3]))
+	  : RectC();
+	if (!rect.isValid()) {
+		qWarning("%s: invalid bounds", qUtf8Printable(arg));
+		rect = RectC();
+	}
+
+	return true;
+}
+
+/* --render [--map=PATH] [--style=N] [--bounds=L,T,R,B] [--size=WxH]
+     [--out=FILE|DIR] [--hillshading] [--timings] [--compare=DIR]
+     [--tolerance=N] [FILE...]
+   Renders the files into PNG images without showing the GUI. The map area
+   is given by the data unless set with --bounds, without any files just the
+   map area is rendered (into out). --timings logs the rendering times.
+   --compare compares the images with the reference (golden) images of the
+   same name in DIR, the render fails when any pixel channel differs by more
+   than the tolerance (0 by default). A fixed set of renders can thus be used
+   to check the map rendering output and speed between versions. */
+int App::render(const QStringList &args)
+{
+	QStringList files;
+	QString map, out(".");
+	RenderOptions opts;
+	int style = -1;
+	bool hillShading = false;
+
+	for (int i = 1; i < args.count(); i++) {
+		const QString &arg = args.at(i);
+
+		if (arg == "--render")
+			continue;
+		else if (arg == "--hillshading")
+			hillShading = true;
+		else if (arg == "--timings")
+			opts.timings = true;
+		else if (arg.startsWith("--map="))
+			map = arg.mid(6);
+		else if (arg.startsWith("--out="))
+			out = arg.mid(6);
+		else if (arg.startsWith("--style="))
+			style = arg.mid(8).toInt();
+		else if (arg.startsWith("--compare="))
+			opts.compare = arg.mid(10);
+		else if (arg.startsWith("--tolerance="))
+			opts.tolerance = arg.mid(12).toInt();
+		else if (renderSize(arg, opts.size)) {
+			if (!opts.size.isValid())
+				return 1;
+		} else if (renderBounds(arg, opts.rect)) {
+			if (opts.rect.isNull())
+				return 1;
+		} else
+			files.append(arg);
+	}
+
+	if (files.isEmpty() && (opts.rect.isNull() || map.isEmpty())) {
+		qWarning("No input files.");
+		return 1;
+	}
+
+	RenderContext ctx(GCS::gcs(4326), PCS::pcs(3857), hillShading);
+	if (!map.isEmpty() && !ctx.setMap(map, style))
+		return 1;
+
+	if (files.isEmpty())
+		return renderImage(ctx, opts, QFileInfo(out).isDir()
+		  ? QDir(out).filePath("map.png") : out) ? 0 : 1;
+	else
+		return renderFiles(ctx, files, opts, out) ? 0 : 1;
+}
+
+/* --serve[=PORT] --map=PATH [--hillshading]
+   Serves the map tiles over HTTP without showing the GUI */
+int App::serve(const QStringList &args)
+{
+	QString path;
+	quint16 port = DEFAULT_SERVER_PORT;
+	bool hillShading = false;
+
+	for (int i = 1; i < args.count(); i++) {
+		const QString &arg = args.at(i);
+
+		if (arg.startsWith("--serve=")) {
+			bool ok;
+			port = arg.mid(8).toUShort(&ok);
+			if (!ok) {
+				qWarning("%s: invalid port", qUtf8Printable(arg));
+				return 1;
+			}
+		} else if (arg.startsWith("--map="))
+			path = arg.mid(6);
+		else if (arg == "--hillshading")
+			hillShading = true;
+	}
+
+	if (path.isEmpty()) {
+		qWarning("No map given.");
+		return 1;
+	}
+	Map *map = MapList::loadMap(path, GCS::gcs(4326));
+	if (!map)
+		return 1;
+	map->load(GCS::gcs(4326), PCS::pcs(3857), 1.0, false, -1, -1);
+
+	TileServer server(map, hillShading);
+	if (!server.listen(port)) {
+		qWarning("%d: %s", port, qUtf8Printable(server.errorString()));
+		delete map;
+		return 1;
+	}
+
+	int ret = exec();
+	map->unload();
+	delete map;
+
+	return ret;
 }
 
 int App::run()
+{
+	if (!_gui) {
+		QStringList args(arguments());
+		return args.contains("--render") ? render(args) : serve(args);
+	}
+
+	_gui->show();
+	StartupProfile::mark("window");
+
+	/* Load the data once the event loop has drawn the (empty) window */
+	QTimer::singleShot(0, this, &App::loadData);
+
+	return exec();
+}
+
+void App::loadData()
 {
 	MapAction *lastReady = 0;
 	QStringList args(arguments());
 	int silent = 0;
 	int showError = (args.count() - 1 > 1) ? 2 : 1;
+	Range seed(0, -1);
 
-	_gui->show();
+	StartupProfile::mark("event loop");
+	_gui->loadInitialData();
 
 	for (int i = 1; i < args.count(); i++) {
+		if (args.at(i) == "--startup-profile" || seedZooms(args.at(i), seed))
+			continue;
 		if (!_gui->openFile(args.at(i), false, silent)) {
 			MapAction *a;
 			if (!_gui->loadMap(args.at(i), a, silent))
@@ -111,8 +482,10 @@ int App::run()
 
 	if (lastReady)
 		lastReady->trigger();
+	StartupProfile::finish();
 
-	return exec();
+	if (seed.isValid())
+		_gui->seedTiles(seed);
 }
 
 #ifdef Q_OS_ANDROID
@@ -139,6 +512,18 @@ void App::appStateChanged(Qt::ApplicationState state)
 		}
 	}
 }
+
+/* All the in-memory caches are rebuilt on demand, so dropping them is the
+   cheapest way to avoid being killed by the system when it runs out of
+   memory or when the app goes to the background. */
+void App::trimMemory(int level)
+{
+	if (level < TRIM_MEMORY_RUNNING_LOW)
+		return;
+
+	CacheRegistry::clear();
+	QPixmapCache::clear();
+}
 #endif // Q_OS_ANDROID
 
 bool App::event(QEvent *event)
@@ -146,7 +531,7 @@ bool App::event(QEvent *event)
 	int silent = 0;
 	int showError = 1;
 
-	if (event->type() == QEvent::FileOpen) {
+	if (event->type() == QEvent::FileOpen && _gui) {
 		QFileOpenEvent *e = static_cast<QFileOpenEvent *>(event);
 
 		if (!_gui->openFile(e->file(), false, silent)) {
@@ -17,14 +17,18 @@ public:
 protected:
 	bool event(QEvent *event);
 
-#ifdef Q_OS_ANDROID
 private slots:
+	void loadData();
+#ifdef Q_OS_ANDROID
 	void appStateChanged(Qt::ApplicationState state);
+	void trimMemory(int level);
 #endif // Q_OS_ANDROID
 
 private:
 	void loadDatums();
 	void loadPCSs();
+	int render(const QStringList &args);
+	int serve(const QStringList &args);
 
 	GUI *_gui;
 };
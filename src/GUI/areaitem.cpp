@@ -3,6 +3,7 @@
 #include <QCursor>
 #include <QPainter>
 #include <QGraphicsSceneMouseEvent>
+#include <QStyleOptionGraphicsItem>
 #include "map/map.h"
 #include "popup.h"
 #include "tooltip.h"
@@ -23,9 +24,41 @@ ToolTip AreaItem::info(bool extended) const
 	return tt;
 }
 
+static RectC ringBounds(const QVector<Coordinates> &ring)
+{
+	RectC rect;
+
+	for (int i = 0; i < ring.size(); i++)
+		rect = rect.united(ring.at(i));
+
+	return rect;
+}
+
+static QVector<QVector<Coordinates> > rings(const Area &area)
+{
+	QVector<QVector<Coordinates> > rings;
+
+	for (int i = 0; i < area.polygons().size(); i++) {
+		const Polygon &polygon = area.polygons().at(i);
+		for (int j = 0; j < polygon.size(); j++)
+			rings.append(polygon.at(j));
+	}
+
+	return rings;
+}
+
 AreaItem::AreaItem(const Area &area, Map *map, GraphicsItem *parent)
   : PlaneItem(parent), _area(area)
 {
+	QVector<QVector<Coordinates> > r(rings(area));
+
+	/* The level of detail pyramid and the rings bounds do not depend on the
+	   map, they are computed only once */
+	_lod = PathLOD(r);
+	_ringBounds.resize(r.size());
+	for (int i = 0; i < r.size(); i++)
+		_ringBounds[i] = ringBounds(r.at(i));
+
 	_digitalZoom = 0;
 	_width = 2;
 	_opacity = 0.5;
@@ -39,41 +72,101 @@ AreaItem::AreaItem(const Area &area, Map *map, GraphicsItem *parent)
 
 	setCursor(Qt::ArrowCursor);
 	setAcceptHoverEvents(true);
+	setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
 }
 
-QPainterPath AreaItem::painterPath(Map *map, const Polygon &polygon)
+qreal AreaItem::tolerance(Map *map) const
 {
-	QPainterPath path;
-
-	for (int i = 0; i < polygon.size(); i++) {
-		const QVector<Coordinates> &subpath = polygon.at(i);
+	const RectC &bounds = _area.boundingRect();
+	QRectF rect(map->ll2xy(bounds.topLeft()), map->ll2xy(bounds.bottomRight()));
+	QPointF c(rect.center());
+	qreal s = qMax(qAbs(rect.width()), qAbs(rect.height())) / 2.0;
+
+	/* Half a pixel in meters, the max error of the simplified rings */
+	return map->resolution(QRectF(c - QPointF(s, s), c + QPointF(s, s)))
+	  / 2.0;
+}
 
-		path.moveTo(map->ll2xy(subpath.first()));
-		for (int j = 1; j < subpath.size(); j++)
-			path.lineTo(map->ll2xy(subpath.at(j)));
-		path.closeSubpath();
+/* The rings are projected in their level of detail form for the map
+   resolution, the holes smaller than a pixel are left out completely. */
+void AreaItem::updatePainterPath(Map *map)
+{
+	qreal tol = tolerance(map);
+	QVector<Coordinates> ll;
+	QPolygonF xy;
+	int ring = 0;
+
+	_parts.clear();
+	_shape = QPainterPath();
+	_boundingRect = QRectF();
+
+	for (int i = 0; i < _area.polygons().size(); i++) {
+		const Polygon &polygon = _area.polygons().at(i);
+		QPainterPath path;
+
+		for (int j = 0; j < polygon.size(); j++, ring++) {
+			const QVector<Coordinates> &subpath = polygon.at(j);
+
+			if (j) {
+				const RectC &rb = _ringBounds.at(ring);
+				QPointF tl(map->ll2xy(rb.topLeft()));
+				QPointF br(map->ll2xy(rb.bottomRight()));
+				if (qAbs(br.x() - tl.x()) < 1.0 && qAbs(br.y() - tl.y()) < 1.0)
+					continue;
+			}
+
+			const QVector<int> *lod = _lod.indexes(ring, tol);
+			if (lod) {
+				ll.resize(lod->size());
+				for (int k = 0; k < lod->size(); k++)
+					ll[k] = subpath.at(lod->at(k));
+				xy.resize(ll.size());
+				map->ll2xy(ll.constData(), xy.data(), xy.size());
+			} else {
+				xy.resize(subpath.size());
+				map->ll2xy(subpath.constData(), xy.data(), xy.size());
+			}
+
+			path.addPolygon(xy);
+			path.closeSubpath();
+		}
+
+		if (!path.isEmpty()) {
+			_parts.append(Part(path));
+			_boundingRect |= _parts.last().bounds;
+		}
 	}
-
-	return path;
 }
 
-void AreaItem::updatePainterPath(Map *map)
+QPainterPath AreaItem::shape() const
 {
-	_painterPath = QPainterPath();
+	if (_shape.isEmpty())
+		for (int i = 0; i < _parts.size(); i++)
+			_shape.addPath(_parts.at(i).path);
 
-	for (int i = 0; i < _area.polygons().size(); i++)
-		_painterPath.addPath(painterPath(map, _area.polygons().at(i)));
+	return _shape;
 }
 
 void AreaItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
   QWidget *widget)
 {
-	Q_UNUSED(option);
 	Q_UNUSED(widget);
 
+	/* Only the polygons intersecting the exposed rect (and the painter clip
+	   when plotting) are drawn */
+	QRectF exposed(option->exposedRect);
+	if (painter->hasClipping())
+		exposed &= painter->clipBoundingRect();
+	qreal w = _pen.widthF() / 2.0;
+
 	painter->setPen(_width ? _pen : QPen(Qt::NoPen));
-	painter->drawPath(_painterPath);
-	painter->fillPath(_painterPath, _brush);
+	for (int i = 0; i < _parts.size(); i++) {
+		const Part &part = _parts.at(i);
+		if (part.bounds.adjusted(-w, -w, w, w).intersects(exposed)) {
+			painter->drawPath(part.path);
+			painter->fillPath(part.path, _brush);
+		}
+	}
 
 /*
 	QPen p = QPen(QBrush(Qt::red), 0);
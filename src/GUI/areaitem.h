@@ -3,6 +3,7 @@
 
 #include "data/area.h"
 #include "planeitem.h"
+#include "pathlod.h"
 
 class AreaItem : public PlaneItem
 {
@@ -11,8 +12,8 @@ class AreaItem : public PlaneItem
 public:
 	AreaItem(const Area &area, Map *map, GraphicsItem *parent = 0);
 
-	QPainterPath shape() const {return _painterPath;}
-	QRectF boundingRect() const {return _painterPath.boundingRect();}
+	QPainterPath shape() const;
+	QRectF boundingRect() const {return _boundingRect;}
 	void paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
 	  QWidget *widget);
 
@@ -41,7 +42,17 @@ protected:
 	void hoverLeaveEvent(QGraphicsSceneHoverEvent *event);
 
 private:
-	QPainterPath painterPath(Map *map, const Polygon &polygon);
+	/* The painter path of a single polygon (outer ring + holes) */
+	struct Part {
+		Part() {}
+		Part(const QPainterPath &path)
+		  : path(path), bounds(path.boundingRect()) {}
+
+		QPainterPath path;
+		QRectF bounds;
+	};
+
+	qreal tolerance(Map *map) const;
 	void updatePainterPath(Map *map);
 	void updateColor();
 	void updateWidth();
@@ -52,6 +63,8 @@ private:
 	Qt::PenStyle penStyle() const;
 
 	Area _area;
+	PathLOD _lod;
+	QVector<RectC> _ringBounds;
 
 	qreal _width;
 	QColor _color;
@@ -61,7 +74,9 @@ private:
 
 	QPen _pen;
 	QBrush _brush;
-	QPainterPath _painterPath;
+	QVector<Part> _parts;
+	QRectF _boundingRect;
+	mutable QPainterPath _shape;
 };
 
 #endif // AREAITEM_H
@@ -78,6 +78,34 @@ QList<GraphItem*> CadenceGraph::loadData(const Data &data, Map *map)
 	return graphs;
 }
 
+GraphPair CadenceGraph::appendedData(const Track &track, int from, Map *map)
+  const
+{
+	Q_UNUSED(map);
+	return GraphPair(track.cadence(from), Graph());
+}
+
+int CadenceGraph::series() const
+{
+	return 1 << Track::Cadence;
+}
+
+void CadenceGraph::removeData(const QList<GraphItem*> &graphs)
+{
+	for (int i = 0; i < graphs.size(); i++) {
+		int idx = _tracks.indexOf(static_cast<CadenceGraphItem*>(graphs.at(i)));
+		if (idx < 0)
+			continue;
+
+		removeGraph(_tracks.at(idx));
+		delete _tracks.takeAt(idx);
+		_avg.remove(idx);
+	}
+
+	setInfo();
+	redraw();
+}
+
 qreal CadenceGraph::avg() const
 {
 	qreal sum = 0, w = 0;
@@ -0,0 +1,44 @@
+#include <cmath>
+#include <QPainter>
+#include "font.h"
+#include "clusteritem.h"
+
+
+#define PADDING 6
+
+ClusterItem::ClusterItem(int count, QGraphicsItem *parent)
+  : QGraphicsItem(parent), _text(QString::number(count)), _color(Qt::black)
+{
+	_font.setPixelSize(FONT_SIZE);
+	_font.setFamily(FONT_FAMILY);
+	_font.setBold(true);
+
+	QFontMetrics fm(_font);
+	qreal size = qMax(fm.boundingRect(_text).width(), fm.height()) + PADDING;
+	_boundingRect = QRectF(-size/2, -size/2, size, size);
+}
+
+void ClusterItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
+  QWidget *widget)
+{
+	Q_UNUSED(option);
+	Q_UNUSED(widget);
+
+	painter->setPen(Qt::NoPen);
+	painter->setBrush(QBrush(_color, Qt::SolidPattern));
+	painter->drawEllipse(_boundingRect);
+
+	painter->setFont(_font);
+	painter->setPen(qGray(_color.rgb()) < 128 ? Qt::white : Qt::black);
+	painter->drawText(_boundingRect, Qt::AlignCenter, _text);
+
+	//painter->setPen(Qt::red);
+	//painter->setBrush(Qt::NoBrush);
+	//painter->drawRect(boundingRect());
+}
+
+void ClusterItem::setColor(const QColor &color)
+{
+	_color = color;
+	update();
+}
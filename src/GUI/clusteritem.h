@@ -0,0 +1,27 @@
+#ifndef CLUSTERITEM_H
+#define CLUSTERITEM_H
+
+#include <QGraphicsItem>
+#include <cmath>
+#include <QFont>
+
+class ClusterItem : public QGraphicsItem
+{
+public:
+	ClusterItem(int count, QGraphicsItem *parent = 0);
+
+	QRectF boundingRect() const {return _boundingRect;}
+	void paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
+	  QWidget *widget);
+
+	void setColor(const QColor &color);
+	void setDigitalZoom(int zoom) {setScale(pow(2, -zoom));}
+
+private:
+	QString _text;
+	QColor _color;
+	QFont _font;
+	QRectF _boundingRect;
+};
+
+#endif // CLUSTERITEM_H
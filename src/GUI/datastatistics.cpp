@@ -0,0 +1,79 @@
+#include <QTimeZone>
+#include "data/data.h"
+#include "datastatistics.h"
+
+void DataStatistics::clear()
+{
+	_trackCount = 0;
+	_routeCount = 0;
+	_waypointCount = 0;
+	_areaCount = 0;
+	_trackDistance = 0;
+	_routeDistance = 0;
+	_time = 0;
+	_movingTime = 0;
+	_dateRange = DateTimeRange(QDateTime(), QDateTime());
+	_pathName = QString();
+}
+
+void DataStatistics::add(const Data &data)
+{
+	for (int i = 0; i < data.tracks().count(); i++) {
+		const Track &track = data.tracks().at(i);
+		_trackDistance += track.distance();
+		_time += track.time();
+		_movingTime += track.movingTime();
+		const QDateTime &date = track.date();
+		if (date.isValid()) {
+			if (_dateRange.first.isNull() || _dateRange.first > date)
+				_dateRange.first = date;
+			if (_dateRange.second.isNull() || _dateRange.second < date)
+				_dateRange.second = date;
+		}
+	}
+	_trackCount += data.tracks().count();
+
+	for (int i = 0; i < data.routes().count(); i++)
+		_routeDistance += data.routes().at(i).distance();
+	_routeCount += data.routes().count();
+
+	_waypointCount += data.waypoints().count();
+	_areaCount += data.areas().count();
+
+	if (_pathName.isNull()) {
+		if (data.tracks().count() == 1 && !data.routes().count())
+			_pathName = data.tracks().first().name();
+		else if (data.routes().count() == 1 && !data.tracks().count())
+			_pathName = data.routes().first().name();
+	} else
+		_pathName = QString();
+}
+
+void DataStatistics::add(const DataStatistics &stats)
+{
+	_trackCount += stats._trackCount;
+	_routeCount += stats._routeCount;
+	_waypointCount += stats._waypointCount;
+	_areaCount += stats._areaCount;
+	_trackDistance += stats._trackDistance;
+	_routeDistance += stats._routeDistance;
+	_time += stats._time;
+	_movingTime += stats._movingTime;
+
+	if (stats._dateRange.first.isValid() && (_dateRange.first.isNull()
+	  || _dateRange.first > stats._dateRange.first))
+		_dateRange.first = stats._dateRange.first;
+	if (stats._dateRange.second.isValid() && (_dateRange.second.isNull()
+	  || _dateRange.second < stats._dateRange.second))
+		_dateRange.second = stats._dateRange.second;
+
+	_pathName = (_trackCount + _routeCount == 1)
+	  ? (_pathName.isNull() ? stats._pathName : _pathName) : QString();
+}
+
+DataStatistics::DateTimeRange DataStatistics::dateRange(
+  const QTimeZone &zone) const
+{
+	return DateTimeRange(_dateRange.first.toTimeZone(zone),
+	  _dateRange.second.toTimeZone(zone));
+}
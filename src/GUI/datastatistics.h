@@ -0,0 +1,47 @@
+#ifndef DATASTATISTICS_H
+#define DATASTATISTICS_H
+
+#include <QPair>
+#include <QDateTime>
+#include <QString>
+
+class QTimeZone;
+class Data;
+
+/* Summary of the loaded data (status bar info, Statistics and the print
+   header). The per-file summaries are accumulated as the files are loaded,
+   the dates are kept in their own time zone and converted only on output so
+   a time zone change does not require any update. */
+class DataStatistics
+{
+public:
+	typedef QPair<QDateTime, QDateTime> DateTimeRange;
+
+	DataStatistics() {clear();}
+
+	void add(const Data &data);
+	void add(const DataStatistics &stats);
+	void addAreas(int count) {_areaCount += count;}
+	void clear();
+
+	int trackCount() const {return _trackCount;}
+	int routeCount() const {return _routeCount;}
+	int waypointCount() const {return _waypointCount;}
+	int areaCount() const {return _areaCount;}
+	qreal trackDistance() const {return _trackDistance;}
+	qreal routeDistance() const {return _routeDistance;}
+	qreal time() const {return _time;}
+	qreal movingTime() const {return _movingTime;}
+	DateTimeRange dateRange(const QTimeZone &zone) const;
+	/* The track/route name if there is only one track or route */
+	const QString &pathName() const {return _pathName;}
+
+private:
+	int _trackCount, _routeCount, _areaCount, _waypointCount;
+	qreal _trackDistance, _routeDistance;
+	qreal _time, _movingTime;
+	DateTimeRange _dateRange;
+	QString _pathName;
+};
+
+#endif // DATASTATISTICS_H
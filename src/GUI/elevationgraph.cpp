@@ -156,6 +156,71 @@ QList<GraphItem*> ElevationGraph::loadData(const Data &data, Map *map)
 	return graphs;
 }
 
+GraphPair ElevationGraph::appendedData(const Track &track, int from, Map *map)
+  const
+{
+	return track.elevation(map, from);
+}
+
+int ElevationGraph::series() const
+{
+	return 1 << Track::GPSElevation;
+}
+
+bool ElevationGraph::deleteGraph(QList<ElevationGraphItem *> &list,
+  GraphItem *item)
+{
+	int idx = list.indexOf(static_cast<ElevationGraphItem*>(item));
+	if (idx < 0)
+		return false;
+
+	if (item->secondaryGraph()) {
+		removeGraph(item->secondaryGraph());
+		delete list.takeAt(idx + 1);
+	}
+	removeGraph(item);
+	delete list.takeAt(idx);
+
+	return true;
+}
+
+/* The secondary graphs directly follow their primary graphs in the lists and
+   are not part of the summary */
+void ElevationGraph::updateStats(const QList<ElevationGraphItem *> &list,
+  qreal &ascent, qreal &descent, qreal &min, qreal &max) const
+{
+	ascent = 0;
+	descent = 0;
+	min = NAN;
+	max = NAN;
+
+	for (int i = 0; i < list.size(); i++) {
+		const ElevationGraphItem *gi = list.at(i);
+		if (i && list.at(i-1)->secondaryGraph() == gi)
+			continue;
+
+		ascent += gi->ascent();
+		descent += gi->descent();
+		max = nMax(max, gi->max());
+		min = nMin(min, gi->min());
+	}
+}
+
+void ElevationGraph::removeData(const QList<GraphItem*> &graphs)
+{
+	for (int i = 0; i < graphs.size(); i++) {
+		GraphItem *gi = graphs.at(i);
+		if (gi && !deleteGraph(_tracks, gi))
+			deleteGraph(_routes, gi);
+	}
+
+	updateStats(_tracks, _trackAscent, _trackDescent, _trackMin, _trackMax);
+	updateStats(_routes, _routeAscent, _routeDescent, _routeMin, _routeMax);
+
+	setInfo();
+	redraw();
+}
+
 void ElevationGraph::clear()
 {
 	qDeleteAll(_tracks);
@@ -15,6 +15,9 @@ public:
 
 	QString label() const {return tr("Elevation");}
 	QList<GraphItem*> loadData(const Data &data, Map *map);
+	GraphPair appendedData(const Track &track, int from, Map *map) const;
+	int series() const;
+	void removeData(const QList<GraphItem*> &graphs);
 	void clear();
 	void setUnits(enum Units units);
 	void showTracks(bool show);
@@ -34,6 +37,9 @@ private:
 	GraphItem *loadGraph(const Graph &graph, PathType type, const QColor &color,
 	  bool primary);
 	void showItems(const QList<ElevationGraphItem *> &list, bool show);
+	bool deleteGraph(QList<ElevationGraphItem *> &list, GraphItem *item);
+	void updateStats(const QList<ElevationGraphItem *> &list, qreal &ascent,
+	  qreal &descent, qreal &min, qreal &max) const;
 
 	qreal _trackAscent, _trackDescent;
 	qreal _routeAscent, _routeDescent;
@@ -1,24 +1,64 @@
+#include <algorithm>
 #include <QFileSystemWatcher>
+#include <QFileInfo>
 #include <QDir>
+#include <QSet>
 #include "filebrowser.h"
 
+#define UPDATE_DELAY 500 /* ms */
+
+static bool nameLessThan(const QString &s1, const QString &s2)
+{
+	int cmp = QString::compare(s1, s2, Qt::CaseInsensitive);
+	return cmp ? (cmp < 0) : (s1 < s2);
+}
+
 
 FileBrowser::FileBrowser(QObject *parent) : QObject(parent)
 {
 #ifndef Q_OS_ANDROID
 	_watcher = new QFileSystemWatcher(this);
 	connect(_watcher, &QFileSystemWatcher::directoryChanged, this,
-	  &FileBrowser::reloadDirectory);
+	  &FileBrowser::directoryChanged);
+
+	_timer.setSingleShot(true);
+	_timer.setInterval(UPDATE_DELAY);
+	connect(&_timer, &QTimer::timeout, this, &FileBrowser::updateDirectory);
 #endif // Q_OS_ANDROID
 
 	_index = -1;
 }
 
+QStringList FileBrowser::entries() const
+{
+	return QDir(_path).entryList(_filter, QDir::Files, QDir::Unsorted);
+}
+
+void FileBrowser::loadDirectory(const QString &path)
+{
+	_path = path;
+	_files = entries();
+	std::sort(_files.begin(), _files.end(), nameLessThan);
+}
+
+int FileBrowser::find(const QString &name) const
+{
+	QStringList::const_iterator it = std::lower_bound(_files.constBegin(),
+	  _files.constEnd(), name, nameLessThan);
+
+	return (it != _files.constEnd() && *it == name)
+	  ? it - _files.constBegin() : -1;
+}
+
+QString FileBrowser::filePath(int index) const
+{
+	return QDir(_path).absoluteFilePath(_files.at(index));
+}
+
 #ifdef Q_OS_ANDROID
 void FileBrowser::setCurrentDir(const QString &path)
 {
-	QDir dir(path);
-	_files = dir.entryInfoList(_filter, QDir::Files);
+	loadDirectory(path);
 	_index = _files.empty() ? -1 : 0;
 
 	emit listChanged();
@@ -27,25 +67,31 @@ void FileBrowser::setCurrentDir(const QString &path)
 void FileBrowser::setCurrent(const QString &path)
 {
 	QFileInfo file(path);
-	QDir dir = file.absoluteDir();
+	QString dir(file.absoluteDir().canonicalPath());
 
-	if (_files.isEmpty() || _files.last().canonicalPath()
-	  != dir.canonicalPath()) {
+	if (_path.isEmpty() || _path != dir) {
 		if (!_watcher->directories().isEmpty())
 			_watcher->removePaths(_watcher->directories());
-		_watcher->addPath(dir.canonicalPath());
-		_files = dir.entryInfoList(_filter, QDir::Files);
+		_watcher->addPath(dir);
+		_timer.stop();
+		loadDirectory(dir);
 	}
 
-	_index = _files.empty() ? -1 : _files.indexOf(file);
+	_index = find(file.fileName());
 }
 #endif // Q_OS_ANDROID
 
 void FileBrowser::setFilter(const QStringList &filter)
 {
 	_filter = filter;
-	if (!_files.isEmpty())
-		reloadDirectory(_files.last().canonicalPath());
+	if (_path.isEmpty())
+		return;
+
+	QString current((_index >= 0) ? _files.at(_index) : QString());
+	loadDirectory(_path);
+	_index = current.isNull() ? -1 : find(current);
+
+	emit listChanged();
 }
 
 bool FileBrowser::isLast() const
@@ -60,7 +106,7 @@ bool FileBrowser::isFirst() const
 
 QString FileBrowser::current()
 {
-	return (_index >= 0) ? _files.at(_index).absoluteFilePath() : QString();
+	return (_index >= 0) ? filePath(_index) : QString();
 }
 
 QString FileBrowser::next()
@@ -68,7 +114,7 @@ QString FileBrowser::next()
 	if (_index < 0 || _index == _files.size() - 1)
 		return QString();
 
-	return _files.at(++_index).absoluteFilePath();
+	return filePath(++_index);
 }
 
 QString FileBrowser::prev()
@@ -76,7 +122,7 @@ QString FileBrowser::prev()
 	if (_index <= 0)
 		return QString();
 
-	return _files.at(--_index).absoluteFilePath();
+	return filePath(--_index);
 }
 
 QString FileBrowser::last()
@@ -85,7 +131,7 @@ QString FileBrowser::last()
 		return QString();
 
 	_index = _files.size() - 1;
-	return _files.last().absoluteFilePath();
+	return filePath(_index);
 }
 
 QString FileBrowser::first()
@@ -94,16 +140,41 @@ QString FileBrowser::first()
 		return QString();
 
 	_index = 0;
-	return _files.first().absoluteFilePath();
+	return filePath(_index);
+}
+
+/* Bursts of changes (a file being written) end up in a single update */
+void FileBrowser::directoryChanged()
+{
+#ifndef Q_OS_ANDROID
+	_timer.start();
+#endif // Q_OS_ANDROID
 }
 
-void FileBrowser::reloadDirectory(const QString &path)
+void FileBrowser::updateDirectory()
 {
-	QDir dir(path);
-	QFileInfo current = (_index >= 0) ? _files.at(_index) : QFileInfo();
+	QString current((_index >= 0) ? _files.at(_index) : QString());
+	QStringList list(entries());
+	QSet<QString> names(list.constBegin(), list.constEnd());
+	bool changed = false;
+
+	for (int i = _files.size() - 1; i >= 0; i--) {
+		if (!names.remove(_files.at(i))) {
+			_files.removeAt(i);
+			changed = true;
+		}
+	}
+	for (QSet<QString>::const_iterator it = names.constBegin();
+	  it != names.constEnd(); ++it) {
+		_files.insert(std::lower_bound(_files.begin(), _files.end(), *it,
+		  nameLessThan), *it);
+		changed = true;
+	}
+
+	if (!changed)
+		return;
 
-	_files = dir.entryInfoList(_filter, QDir::Files);
-	_index = _files.empty() ? -1 : _files.indexOf(current);
+	_index = current.isNull() ? -1 : find(current);
 
 	emit listChanged();
 }
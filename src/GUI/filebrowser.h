@@ -2,11 +2,15 @@
 #define FILEBROWSER_H
 
 #include <QObject>
-#include <QFileInfo>
 #include <QStringList>
+#include <QTimer>
 
 class QFileSystemWatcher;
 
+/* The directory files are kept as a sorted list of file names. The watched
+   directory changes are debounced and applied as add/remove diffs, so the
+   list is never re-sorted and the current file lookups are binary searches
+   even in huge, constantly changing (live logging) directories. */
 class FileBrowser : public QObject
 {
 	Q_OBJECT
@@ -34,14 +38,22 @@ signals:
 	void listChanged();
 
 private slots:
-	void reloadDirectory(const QString &path);
+	void directoryChanged();
+	void updateDirectory();
 
 private:
+	QStringList entries() const;
+	void loadDirectory(const QString &path);
+	int find(const QString &name) const;
+	QString filePath(int index) const;
+
 #ifndef Q_OS_ANDROID
 	QFileSystemWatcher *_watcher;
+	QTimer _timer;
 #endif // Q_OS_ANDROID
 	QStringList _filter;
-	QFileInfoList _files;
+	QString _path;
+	QStringList _files;
 	int _index;
 };
 
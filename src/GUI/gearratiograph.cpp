@@ -83,6 +83,42 @@ QList<GraphItem*> GearRatioGraph::loadData(const Data &data, Map *map)
 	return graphs;
 }
 
+GraphPair GearRatioGraph::appendedData(const Track &track, int from, Map *map)
+  const
+{
+	Q_UNUSED(map);
+	return GraphPair(track.ratio(from), Graph());
+}
+
+int GearRatioGraph::series() const
+{
+	return 1 << Track::Ratio;
+}
+
+void GearRatioGraph::removeData(const QList<GraphItem*> &graphs)
+{
+	for (int i = 0; i < graphs.size(); i++) {
+		int idx = _tracks.indexOf(static_cast<GearRatioGraphItem*>(
+		  graphs.at(i)));
+		if (idx < 0)
+			continue;
+
+		removeGraph(_tracks.at(idx));
+		delete _tracks.takeAt(idx);
+	}
+
+	_map.clear();
+	for (int i = 0; i < _tracks.size(); i++) {
+		const QMap<qreal, qreal> &map = _tracks.at(i)->map();
+		for (QMap<qreal, qreal>::const_iterator it = map.constBegin();
+		  it != map.constEnd(); ++it)
+			_map.insert(it.key(), _map.value(it.key()) + it.value());
+	}
+
+	setInfo();
+	redraw();
+}
+
 qreal GearRatioGraph::top() const
 {
 	qreal key = NAN, val = NAN;
@@ -16,6 +16,9 @@ public:
 
 	QString label() const {return tr("Gear ratio");}
 	QList<GraphItem*> loadData(const Data &data, Map *map);
+	GraphPair appendedData(const Track &track, int from, Map *map) const;
+	int series() const;
+	void removeData(const QList<GraphItem*> &graphs);
 	void clear();
 	void showTracks(bool show);
 
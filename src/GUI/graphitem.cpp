@@ -1,3 +1,4 @@
+#include <cmath>
 #include <QPainter>
 #include <QGraphicsSceneMouseEvent>
 #include "popup.h"
@@ -18,6 +19,12 @@ GraphItem::GraphItem(const Graph &graph, GraphType type, int width,
 	setZValue(2.0);
 	setAcceptHoverEvents(true);
 
+	_summary.min = _graph.first().first().y();
+	_summary.max = _summary.min;
+	_summary.sum = 0;
+	for (int i = 0; i < _graph.size(); i++)
+		updateSummary(i, 0);
+
 	updateBounds();
 }
 
@@ -26,6 +33,18 @@ void GraphItem::updateShape()
 	QPainterPathStroker s;
 	s.setWidth(_pen.width() + 1);
 	_shape = s.createStroke(_path);
+	_boundingRect = _shape.boundingRect();
+}
+
+QPainterPath GraphItem::shape() const
+{
+	if (_shape.isEmpty() && !_path.isEmpty()) {
+		QPainterPathStroker s;
+		s.setWidth(_pen.width() + 1);
+		_shape = s.createStroke(_path);
+	}
+
+	return _shape;
 }
 
 void GraphItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
@@ -99,9 +118,9 @@ const GraphSegment *GraphItem::segment(qreal x, GraphType type) const
 	while (low <= high) {
 		mid = (high + low) / 2;
 		const GraphPoint &p = _graph.at(mid).last();
-		if (p.x(_type) > x)
+		if (p.x(type) > x)
 			high = mid - 1;
-		else if (p.x(_type) < x)
+		else if (p.x(type) < x)
 			low = mid + 1;
 		else
 			return &(_graph.at(mid));
@@ -253,34 +272,115 @@ void GraphItem::setScale(qreal sx, qreal sy)
 	updatePath();
 }
 
+void GraphItem::addColumn(const QPointF &first, const QPointF &min,
+  int minIndex, const QPointF &max, int maxIndex, const QPointF &last)
+{
+	/* M4 decimation - the first, min, max and last points of the pixel
+	   column (in their original order) give the same raster image as all
+	   the column's points */
+	_path.lineTo(first);
+	if (minIndex < maxIndex) {
+		_path.lineTo(min);
+		_path.lineTo(max);
+	} else if (maxIndex < minIndex) {
+		_path.lineTo(max);
+		_path.lineTo(min);
+	}
+	_path.lineTo(last);
+}
+
+void GraphItem::addPath(const GraphSegment &segment, int from)
+{
+	QPointF p(segment.at(from).x(_type) * _sx, -segment.at(from).y() * _sy);
+	QPointF first(p), min(p), max(p), last(p);
+	int minIndex = from, maxIndex = from;
+	qreal column = floor(p.x());
+
+	if (!from)
+		_path.moveTo(p);
+	for (int j = from + 1; j < segment.size(); j++) {
+		p = QPointF(segment.at(j).x(_type) * _sx, -segment.at(j).y() * _sy);
+
+		if (floor(p.x()) != column) {
+			addColumn(first, min, minIndex, max, maxIndex, last);
+			first = p; min = p; max = p;
+			minIndex = j; maxIndex = j;
+			column = floor(p.x());
+		} else {
+			if (p.y() < min.y()) {
+				min = p;
+				minIndex = j;
+			}
+			if (p.y() > max.y()) {
+				max = p;
+				maxIndex = j;
+			}
+		}
+		last = p;
+	}
+	addColumn(first, min, minIndex, max, maxIndex, last);
+}
+
 void GraphItem::updatePath()
 {
 	prepareGeometryChange();
 
 	_path = QPainterPath();
 
-	if (!((_type == Time && !_time) || _sx == 0 || _sy == 0)) {
-		for (int i = 0; i < _graph.size(); i++) {
-			const GraphSegment &segment = _graph.at(i);
-			QPointF p1(segment.first().x(_type) * _sx, -segment.first().y()
-			  * _sy);
-
-			_path.moveTo(p1);
-			for (int i = 1; i < segment.size(); i++) {
-				QPointF p2(segment.at(i).x(_type) * _sx, -segment.at(i).y()
-				  * _sy);
-				QPointF diff(p1 - p2);
-				if (qAbs(diff.x()) >= 1.0 || qAbs(diff.y()) >= 1.0) {
-					_path.lineTo(p2);
-					p1 = p2;
-				}
-			}
-		}
-	}
+	if (!((_type == Time && !_time) || _sx == 0 || _sy == 0))
+		for (int i = 0; i < _graph.size(); i++)
+			addPath(_graph.at(i), 0);
 
 	updateShape();
 }
 
+/* Live data - the points are appended to the last graph segment and only
+   the new part of the path is added, the shape is stroked on demand. */
+void GraphItem::append(const Graph &graph)
+{
+	GraphSegment &segment = _graph.last();
+	int from = segment.size();
+
+	for (int i = 0; i < graph.size(); i++)
+		segment.append(graph.at(i));
+	if (segment.size() == from)
+		return;
+
+	updateSummary(_graph.size() - 1, from);
+
+	bool time = _time;
+	for (int j = from; j < segment.size() && _time; j++)
+		if (std::isnan(segment.at(j).t()))
+			_time = false;
+	if (_time != time || _bounds.isNull()) {
+		updateBounds();
+		updatePath();
+		return;
+	}
+
+	qreal left = _bounds.left(), right = _bounds.right();
+	qreal top = _bounds.top(), bottom = _bounds.bottom();
+	for (int j = from; j < segment.size(); j++) {
+		QPointF p(segment.at(j).x(_type), -segment.at(j).y());
+		bottom = qMax(bottom, p.y()); top = qMin(top, p.y());
+		right = qMax(right, p.x()); left = qMin(left, p.x());
+	}
+	_bounds = QRectF(QPointF(left, top), QPointF(right, bottom));
+
+	if ((_type == Time && !_time) || _sx == 0 || _sy == 0)
+		return;
+
+	prepareGeometryChange();
+
+	addPath(segment, from);
+
+	qreal w = (_pen.width() + 1) / 2.0;
+	QRectF br(QPointF(left * _sx, top * _sy), QPointF(right * _sx,
+	  bottom * _sy));
+	_boundingRect |= br.adjusted(-w, -w, w, w);
+	_shape = QPainterPath();
+}
+
 void GraphItem::updateBounds()
 {
 	if (_type == Time && !_time) {
@@ -310,52 +410,19 @@ void GraphItem::updateBounds()
 		_bounds = QRectF(QPointF(left, top), QPointF(right, bottom));
 }
 
-qreal GraphItem::max() const
+void GraphItem::updateSummary(int segment, int from)
 {
-	qreal ret = _graph.first().first().y();
-
-	for (int i = 0; i < _graph.size(); i++) {
-		const GraphSegment &segment = _graph.at(i);
-
-		for (int j = 0; j < segment.size(); j++) {
-			qreal y = segment.at(j).y();
-			if (y > ret)
-				ret = y;
-		}
+	const GraphSegment &s = _graph.at(segment);
+
+	for (int j = from; j < s.size(); j++) {
+		qreal y = s.at(j).y();
+		if (y > _summary.max)
+			_summary.max = y;
+		if (y < _summary.min)
+			_summary.min = y;
+		if (j)
+			_summary.sum += y * (s.at(j).s() - s.at(j-1).s());
 	}
-
-	return ret;
-}
-
-qreal GraphItem::min() const
-{
-	qreal ret = _graph.first().first().y();
-
-	for (int i = 0; i < _graph.size(); i++) {
-		const GraphSegment &segment = _graph.at(i);
-
-		for (int j = 0; j < segment.size(); j++) {
-			qreal y = segment.at(j).y();
-			if (y < ret)
-				ret = y;
-		}
-	}
-
-	return ret;
-}
-
-qreal GraphItem::avg() const
-{
-	qreal sum = 0;
-
-	for (int i = 0; i < _graph.size(); i++) {
-		const GraphSegment &segment = _graph.at(i);
-
-		for (int j = 1; j < segment.size(); j++)
-			sum += segment.at(j).y() * (segment.at(j).s() - segment.at(j-1).s());
-	}
-
-	return sum/_graph.last().last().s();
 }
 
 void GraphItem::hoverEnterEvent(QGraphicsSceneHoverEvent *event)
@@ -380,6 +447,19 @@ void GraphItem::hoverLeaveEvent(QGraphicsSceneHoverEvent *event)
 	emit selected(false);
 }
 
+qint64 GraphItem::memoryUsage() const
+{
+	qint64 size = sizeof(*this) + (_path.elementCount() + _shape.elementCount())
+	  * sizeof(QPainterPath::Element);
+
+	/* The x axis columns are usually shared with the track and the other
+	   graphs, count only the graph's own values. */
+	for (int i = 0; i < _graph.size(); i++)
+		size += _graph.at(i).y().capacity() * sizeof(qreal);
+
+	return size;
+}
+
 void GraphItem::mousePressEvent(QGraphicsSceneMouseEvent *event)
 {
 	GraphicsScene *gs = dynamic_cast<GraphicsScene *>(scene());
@@ -28,17 +28,17 @@ public:
 
 	virtual ToolTip info(bool extended) const = 0;
 
-	QPainterPath shape() const {return _shape;}
-	QRectF boundingRect() const {return _shape.boundingRect();}
+	QPainterPath shape() const;
+	QRectF boundingRect() const {return _boundingRect;}
 	void paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
 	  QWidget *widget);
 
 	GraphType graphType() const {return _type;}
 	const QRectF &bounds() const {return _bounds;}
 
-	qreal max() const;
-	qreal min() const;
-	qreal avg() const;
+	qreal max() const {return _summary.max;}
+	qreal min() const {return _summary.min;}
+	qreal avg() const {return _summary.sum / _graph.last().last().s();}
 
 	void setScale(qreal sx, qreal sy);
 	void setGraphType(GraphType type);
@@ -57,6 +57,12 @@ public:
 
 	void redraw();
 
+	/* Appends the points to the last graph segment (live data) */
+	void append(const Graph &graph);
+
+	/* Estimated memory used by the item in bytes */
+	qint64 memoryUsage() const;
+
 signals:
 	void selected(bool);
 
@@ -73,19 +79,33 @@ protected:
 private:
 	const GraphSegment *segment(qreal x, GraphType type) const;
 	void updatePath();
+	void addPath(const GraphSegment &segment, int from);
+	void addColumn(const QPointF &first, const QPointF &min, int minIndex,
+	  const QPointF &max, int maxIndex, const QPointF &last);
 	void updateShape();
 	void updateBounds();
+	void updateSummary(int segment, int from);
 	void updateColor();
 	const QColor &color() const;
 
+	/* Summary statistics of the y values, computed once when the graph is
+	   created and updated incrementally on live data append. */
+	struct Summary {
+		qreal min, max;
+		/* Distance weighted sum of the values */
+		qreal sum;
+	};
+
 	Graph _graph;
+	Summary _summary;
 
 	QColor _color;
 	GraphType _type;
 	qreal _sx, _sy;
 
 	QPainterPath _path;
-	QPainterPath _shape;
+	mutable QPainterPath _shape;
+	QRectF _boundingRect;
 	QRectF _bounds;
 	QPen _pen;
 	bool _time;
@@ -9,6 +9,7 @@
 
 class Map;
 class Data;
+class Track;
 class GraphItem;
 
 class GraphTab : public GraphView
@@ -26,6 +27,22 @@ public:
 
 	virtual QString label() const = 0;
 	virtual QList<GraphItem*> loadData(const Data &data, Map *map) = 0;
+	/* The graphs of the track points appended from point index from on
+	   (live data) matching the graphs created by loadData() */
+	virtual GraphPair appendedData(const Track &track, int from, Map *map)
+	  const
+	{
+		Q_UNUSED(track);
+		Q_UNUSED(from);
+		Q_UNUSED(map);
+		return GraphPair(Graph(), Graph());
+	}
+	/* The track graph series (a mask of 1 << Track::Series) used by
+	   loadData(), they are computed in the background before loadData() is
+	   called */
+	virtual int series() const {return 0;}
+	/* Removes and deletes the graphs previously returned by loadData() */
+	virtual void removeData(const QList<GraphItem*> &graphs) = 0;
 	virtual void clear() {GraphView::clear();}
 	virtual void setUnits(enum Units units) {GraphView::setUnits(units);}
 	virtual void setGraphType(GraphType type) {GraphView::setGraphType(type);}
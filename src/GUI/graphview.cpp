@@ -8,6 +8,7 @@
 #include <QPalette>
 #include <QLocale>
 #include <QOpenGLWidget>
+#include "common/trace.h"
 #include "data/graph.h"
 #include "axisitem.h"
 #include "axislabelitem.h"
@@ -39,7 +40,10 @@ GraphView::GraphView(QWidget *parent)
 {
 	const QPalette &p = palette();
 
+	/* The graph scenes contain only a few items, but the slider is moved
+	   constantly, so maintaining a BSP index is not worth it. */
 	_scene = new GraphicsScene(this);
+	_scene->setItemIndexMethod(QGraphicsScene::NoIndex);
 	setScene(_scene);
 
 	setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
@@ -86,6 +90,7 @@ GraphView::GraphView(QWidget *parent)
 	_xLabel = tr("Distance");
 
 	_zoom = 1.0;
+	_dirty = false;
 
 	_angleDelta = 0;
 	_dragStart = 0;
@@ -226,7 +231,8 @@ void GraphView::addGraph(GraphItem *graph)
 void GraphView::removeGraph(GraphItem *graph)
 {
 	_graphs.removeOne(graph);
-	_scene->removeItem(graph);
+	if (graph->scene() == _scene)
+		_scene->removeItem(graph);
 
 	_bounds = QRectF();
 	for (int i = 0; i < _graphs.count(); i++)
@@ -235,6 +241,19 @@ void GraphView::removeGraph(GraphItem *graph)
 	setXUnits();
 }
 
+/* Live data - the view is not redrawn, call redraw() when all the graphs
+   have been updated */
+void GraphView::appendGraph(GraphItem *graph, const Graph &points)
+{
+	graph->append(points);
+
+	if (_graphs.contains(graph)) {
+		if (!graph->scene() && !graph->bounds().isNull())
+			_scene->addItem(graph);
+		_bounds |= graph->bounds();
+	}
+}
+
 void GraphView::removeItem(QGraphicsItem *item)
 {
 	if (item->scene() == _scene)
@@ -256,16 +275,25 @@ QRectF GraphView::bounds() const
 
 void GraphView::redraw()
 {
+	/* Hidden views (inactive graph tabs) are only redrawn when shown */
+	if (!isVisible()) {
+		_dirty = true;
+		return;
+	}
+
 	redraw(viewport()->size() - QSizeF(MARGIN, MARGIN));
 }
 
 void GraphView::redraw(const QSizeF &size)
 {
+	TRACE_SCOPE("GUI", "GraphView::redraw");
 	QRectF r;
 	QSizeF mx, my;
 	RangeF rx, ry;
 	qreal sx, sy;
 
+	_dirty = false;
+
 	if (_bounds.isNull()) {
 		removeItem(_xAxis);
 		removeItem(_yAxis);
@@ -350,7 +378,10 @@ void GraphView::redraw(const QSizeF &size)
 
 void GraphView::resizeEvent(QResizeEvent *e)
 {
-	redraw(e->size() - QSizeF(MARGIN, MARGIN));
+	if (isVisible())
+		redraw(e->size() - QSizeF(MARGIN, MARGIN));
+	else
+		_dirty = true;
 
 	QGraphicsView::resizeEvent(e);
 }
@@ -433,6 +464,14 @@ void GraphView::paintEvent(QPaintEvent *e)
 	QGraphicsView::paintEvent(e);
 }
 
+void GraphView::showEvent(QShowEvent *e)
+{
+	if (_dirty)
+		redraw();
+
+	QGraphicsView::showEvent(e);
+}
+
 void GraphView::plot(QPainter *painter, const QRectF &target, qreal scale)
 {
 	QSizeF canvas = QSizeF(target.width() / scale, target.height() / scale);
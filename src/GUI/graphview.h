@@ -47,6 +47,9 @@ public:
 
 	qreal sliderPosition() const {return _sliderPos;}
 
+	void appendGraph(GraphItem *graph, const Graph &points);
+	void redraw();
+
 signals:
 	void sliderPositionChanged(qreal);
 
@@ -62,6 +65,7 @@ protected:
 	void wheelEvent(QWheelEvent *e);
 	void changeEvent(QEvent *e);
 	void paintEvent(QPaintEvent *e);
+	void showEvent(QShowEvent *e);
 	bool event(QEvent *event);
 
 	const QString &yLabel() const {return _yLabel;}
@@ -77,7 +81,6 @@ protected:
 	void setMinYRange(qreal range) {_minYRange = range;}
 
 	QRectF bounds() const;
-	void redraw();
 	void addInfo(const QString &key, const QString &value);
 	void clearInfo();
 
@@ -123,6 +126,7 @@ private:
 	qreal _minYRange;
 
 	qreal _zoom;
+	bool _dirty;
 
 	int _angleDelta;
 	int _dragStart;
@@ -5,6 +5,7 @@
 #include <QStatusBar>
 #include <QMessageBox>
 #include <QCheckBox>
+#include <QFile>
 #include <QFileDialog>
 #include <QPrintDialog>
 #include <QPainter>
@@ -19,24 +20,39 @@
 #include <QLabel>
 #include <QSettings>
 #include <QLocale>
+#include <QEventLoop>
 #include <QMimeData>
 #include <QUrl>
+#include <QProgressDialog>
 #include <QPixmapCache>
 #include <QWindow>
 #include <QScreen>
 #include <QStyle>
 #include <QTabBar>
 #include <QGeoPositionInfoSource>
+#include <QFileSystemWatcher>
+#include <QTimer>
 #include "common/config.h"
 #include "common/programpaths.h"
+#include "common/trace.h"
+#include "common/cacheregistry.h"
+#include "common/threadpools.h"
 #include "data/data.h"
+#include "data/dataloader.h"
+#include "data/datacache.h"
+#include "data/streamloader.h"
+#include "data/filetail.h"
 #include "data/poi.h"
 #include "map/downloader.h"
+#include "map/tileloader.h"
+#include "map/tilecache.h"
 #include "map/demloader.h"
+#include "map/tileseeder.h"
 #include "map/maplist.h"
 #include "map/emptymap.h"
 #include "map/crs.h"
 #include "map/hillshading.h"
+#include "map/IMG/mapdata.h"
 #include "icons.h"
 #include "keys.h"
 #include "settings.h"
@@ -53,8 +69,14 @@
 #include "graphtab.h"
 #include "graphitem.h"
 #include "pathitem.h"
+#include "areaitem.h"
+#include "waypointitem.h"
 #include "mapaction.h"
 #include "poiaction.h"
+#include "pngwriter.h"
+#include "rendercontext.h"
+#include "startupprofile.h"
+#include "memorydialog.h"
 #include "gui.h"
 #ifdef Q_OS_ANDROID
 #include "common/util.h"
@@ -64,20 +86,44 @@
 
 #define MAX_RECENT_FILES  10
 #define TOOLBAR_ICON_SIZE 22
+#define PNG_EXPORT_STRIP_SIZE 4194304 /* pixels */
+#define GRAPHS_REDRAW_INTERVAL 1000 /* ms */
 
 GUI::GUI(const QString &lang)
 {
-	QString activeMap;
-	QStringList disabledPOIs, recentFiles;
+	QStringList recentFiles;
 
 	_lang = lang;
 
 	_poi = new POI(this);
 	_dem = new DEMLoader(ProgramPaths::demDir(true), this);
 	connect(_dem, &DEMLoader::finished, this, &GUI::demLoaded);
+	connect(_dem, &DEMLoader::progress, this, &GUI::demProgress);
+	_demProgress = 0;
+
+	_tailWatcher = new QFileSystemWatcher(this);
+	connect(_tailWatcher, &QFileSystemWatcher::fileChanged, this,
+	  &GUI::updateTail);
+	_graphsTimer = new QTimer(this);
+	_graphsTimer->setSingleShot(true);
+	_graphsTimer->setInterval(GRAPHS_REDRAW_INTERVAL);
+	connect(_graphsTimer, &QTimer::timeout, this, &GUI::redrawGraphs);
+	_graphWatcher = new QFutureWatcher<void>(this);
+	connect(_graphWatcher, &QFutureWatcher<void>::finished, this,
+	  &GUI::graphsComputed);
+	_graphJob = 0;
+	_graphTab = 0;
+	_graphJobId = 0;
+	_loading = false;
+
+	_tileSeed.area = TileSeed::Visible;
+	_tileSeed.zooms = Range(0, 16);
+	_tileSeed.radius = 1000;
 
 	createMapView();
+	StartupProfile::mark("map view");
 	createGraphTabs();
+	StartupProfile::mark("graph tabs");
 	createStatusBar();
 	createActions();
 	createMenus();
@@ -86,6 +132,7 @@ GUI::GUI(const QString &lang)
 #else // Q_OS_ANDROID
 	createToolBars();
 #endif // Q_OS_ANDROID
+	StartupProfile::mark("actions & menus");
 	createBrowser();
 
 	_splitter = new QSplitter();
@@ -104,27 +151,31 @@ GUI::GUI(const QString &lang)
 	setUnifiedTitleAndToolBarOnMac(true);
 	setAcceptDrops(true);
 
-	_trackCount = 0;
-	_routeCount = 0;
-	_waypointCount = 0;
-	_areaCount = 0;
-	_trackDistance = 0;
-	_routeDistance = 0;
-	_time = 0;
-	_movingTime = 0;
 	_lastTab = 0;
 
-	readSettings(activeMap, disabledPOIs, recentFiles);
-
-	loadInitialMaps(activeMap);
-	loadInitialPOIs(disabledPOIs);
+	readSettings(_activeMap, _disabledPOIs, recentFiles);
 #ifndef Q_OS_ANDROID
 	loadRecentFiles(recentFiles);
 #endif // Q_OS_ANDROID
+	StartupProfile::mark("settings");
 
 	updateGraphTabs();
 	updateStatusBarInfo();
+}
+
+/* The map and POI directories are loaded after the window has been shown
+   so that the (possibly slow) directory scans do not delay the first frame */
+void GUI::loadInitialData()
+{
+	loadInitialMaps(_activeMap);
+	StartupProfile::mark("maps");
+	loadInitialPOIs(_disabledPOIs);
+	StartupProfile::mark("POIs");
+
 	updateMapDEMDownloadAction();
+
+	_activeMap.clear();
+	_disabledPOIs.clear();
 }
 
 void GUI::createBrowser()
@@ -210,10 +261,20 @@ void GUI::createActions()
 	_pathsAction = new QAction(tr("Paths"), this);
 	_pathsAction->setMenuRole(QAction::NoRole);
 	connect(_pathsAction, &QAction::triggered, this, &GUI::paths);
+	_cacheStatisticsAction = new QAction(tr("Cache statistics"), this);
+	_cacheStatisticsAction->setMenuRole(QAction::NoRole);
+	connect(_cacheStatisticsAction, &QAction::triggered, this,
+	  &GUI::cacheStatistics);
+	_memoryAction = new QAction(tr("Memory usage..."), this);
+	_memoryAction->setMenuRole(QAction::NoRole);
+	connect(_memoryAction, &QAction::triggered, this, &GUI::memoryUsage);
 #ifndef Q_OS_ANDROID
 	_keysAction = new QAction(tr("Keyboard controls"), this);
 	_keysAction->setMenuRole(QAction::NoRole);
 	connect(_keysAction, &QAction::triggered, this, &GUI::keys);
+	_saveTraceAction = new QAction(tr("Save trace..."), this);
+	_saveTraceAction->setMenuRole(QAction::NoRole);
+	connect(_saveTraceAction, &QAction::triggered, this, &GUI::saveTrace);
 #endif // Q_OS_ANDROID
 	_aboutAction = new QAction(QIcon(APP_ICON), tr("About GPXSee"), this);
 	_aboutAction->setMenuRole(QAction::AboutRole);
@@ -266,6 +327,10 @@ void GUI::createActions()
 	_reloadFileAction->setActionGroup(_fileActionGroup);
 	connect(_reloadFileAction, &QAction::triggered, this, &GUI::reloadFiles);
 	addAction(_reloadFileAction);
+	_followFilesAction = new QAction(tr("Follow files"), this);
+	_followFilesAction->setMenuRole(QAction::NoRole);
+	_followFilesAction->setCheckable(true);
+	connect(_followFilesAction, &QAction::triggered, this, &GUI::reloadFiles);
 	_statisticsAction = new QAction(tr("Statistics..."), this);
 	_statisticsAction->setMenuRole(QAction::NoRole);
 	_statisticsAction->setShortcut(STATISTICS_SHORTCUT);
@@ -352,6 +417,11 @@ void GUI::createActions()
 	_clearMapCacheAction->setMenuRole(QAction::NoRole);
 	connect(_clearMapCacheAction, &QAction::triggered, this,
 	  &GUI::clearMapCache);
+	_seedMapTilesAction = new QAction(tr("Download map tiles..."), this);
+	_seedMapTilesAction->setEnabled(false);
+	_seedMapTilesAction->setMenuRole(QAction::NoRole);
+	connect(_seedMapTilesAction, &QAction::triggered, this,
+	  &GUI::seedMapTiles);
 	QAction *nextMapAction = new QAction(tr("Next map"), this);
 	nextMapAction->setMenuRole(QAction::NoRole);
 	nextMapAction->setShortcut(NEXT_MAP_SHORTCUT);
@@ -441,6 +511,11 @@ void GUI::createActions()
 	_showTicksAction->setCheckable(true);
 	connect(_showTicksAction, &QAction::triggered, _mapView,
 	  &MapView::showTicks);
+	_showHeatmapAction = new QAction(tr("Tracks heatmap"), this);
+	_showHeatmapAction->setMenuRole(QAction::NoRole);
+	_showHeatmapAction->setCheckable(true);
+	connect(_showHeatmapAction, &QAction::triggered, _mapView,
+	  &MapView::showHeatmap);
 	_showLegendAction = new QAction(tr("Legend"), this);
 	_showLegendAction->setMenuRole(QAction::NoRole);
 	_showLegendAction->setCheckable(true);
@@ -689,6 +764,7 @@ void GUI::createMenus()
 	fileMenu->addAction(_statisticsAction);
 	fileMenu->addSeparator();
 	fileMenu->addAction(_reloadFileAction);
+	fileMenu->addAction(_followFilesAction);
 	fileMenu->addAction(_closeFileAction);
 #if !defined(Q_OS_MAC) && !defined(Q_OS_ANDROID)
 	fileMenu->addSeparator();
@@ -700,6 +776,7 @@ void GUI::createMenus()
 	_mapMenu->addAction(_loadMapAction);
 	_mapMenu->addAction(_loadMapDirAction);
 	_mapMenu->addAction(_clearMapCacheAction);
+	_mapMenu->addAction(_seedMapTilesAction);
 	_mapMenu->addSeparator();
 	_mapStylesMenu = _mapMenu->addMenu(tr("Styles"));
 	_mapStylesMenu->menuAction()->setMenuRole(QAction::NoRole);
@@ -728,6 +805,7 @@ void GUI::createMenus()
 	dataMenu->addAction(_showWaypointLabelsAction);
 	dataMenu->addAction(_showRouteWaypointsAction);
 	dataMenu->addAction(_showTicksAction);
+	dataMenu->addAction(_showHeatmapAction);
 	dataMenu->addAction(_showLegendAction);
 	QMenu *markerMenu = dataMenu->addMenu(tr("Position info"));
 	markerMenu->menuAction()->setMenuRole(QAction::NoRole);
@@ -795,8 +873,12 @@ void GUI::createMenus()
 
 	QMenu *helpMenu = menuBar()->addMenu(tr("&Help"));
 	helpMenu->addAction(_pathsAction);
+	helpMenu->addAction(_cacheStatisticsAction);
+	helpMenu->addAction(_memoryAction);
 #ifndef Q_OS_ANDROID
 	helpMenu->addAction(_keysAction);
+	if (Trace::isEnabled())
+		helpMenu->addAction(_saveTraceAction);
 #endif // Q_OS_ANDROID
 	helpMenu->addSeparator();
 	helpMenu->addAction(_aboutAction);
@@ -938,6 +1020,15 @@ void GUI::about()
 }
 
 #ifndef Q_OS_ANDROID
+void GUI::saveTrace()
+{
+	QString fileName(QFileDialog::getSaveFileName(this, tr("Save trace"),
+	  Trace::fileName(), tr("Chrome trace files") + " (*.json)"));
+
+	if (!fileName.isEmpty() && !Trace::dump(fileName))
+		QMessageBox::critical(this, APP_NAME, tr("Error writing trace file."));
+}
+
 void GUI::keys()
 {
 	QMessageBox msgBox(this);
@@ -1026,6 +1117,72 @@ void GUI::paths()
 	msgBox.exec();
 }
 
+void GUI::memoryUsage()
+{
+	QList<MemoryDialog::Item> files, caches;
+
+	for (QHash<QString, LoadedItems>::const_iterator it
+	  = _loadedItems.constBegin(); it != _loadedItems.constEnd(); ++it) {
+		const LoadedItems &items = it.value();
+		qint64 size = items.size;
+
+		for (int i = 0; i < items.paths.size(); i++)
+			size += items.paths.at(i)->memoryUsage();
+		files.append(MemoryDialog::Item(Util::displayName(it.key()), size,
+		  _files.contains(it.key()) ? it.key() : QString()));
+	}
+
+	/* Only the caches with a known (KB) cost can be accounted */
+	QList<CacheRegistry::Stats> stats(CacheRegistry::stats());
+	for (int i = 0; i < stats.size(); i++)
+		if (stats.at(i).unit == CacheRegistry::KB)
+			caches.append(MemoryDialog::Item(stats.at(i).name,
+			  stats.at(i).size * 1024));
+
+	MemoryDialog dialog(files, caches, this);
+	if (dialog.exec() != QDialog::Accepted || dialog.files().isEmpty())
+		return;
+
+	for (int i = 0; i < dialog.files().size(); i++)
+		unloadFile(dialog.files().at(i));
+	if (_files.isEmpty())
+		closeAll();
+}
+
+void GUI::cacheStatistics()
+{
+	QList<CacheRegistry::Stats> stats(CacheRegistry::stats());
+	QLocale l;
+	QString table("<style>td {white-space: pre; padding-right: 1em;}</style>"
+	  "<table><tr><th></th><th>" + tr("Size") + "</th><th>" + tr("Limit")
+	  + "</th><th>" + tr("Hits") + "</th><th>" + tr("Misses") + "</th></tr>");
+
+	for (int i = 0; i < stats.size(); i++) {
+		const CacheRegistry::Stats &s = stats.at(i);
+		QString unit(s.unit == CacheRegistry::KB ? " " + tr("KB") : "");
+		quint64 total = s.hits + s.misses;
+
+		table += "<tr><td>" + s.name + (s.instances > 1
+		  ? " (" + l.toString(s.instances) + ")" : "") + "</td><td>"
+		  + l.toString(s.size) + unit + "</td><td>" + l.toString(s.limit) + unit
+		  + "</td><td>" + l.toString(s.hits) + (total ? " ("
+		  + l.toString(100.0 * s.hits / total, 'f', 1) + "%)" : "")
+		  + "</td><td>" + l.toString(s.misses) + "</td></tr>";
+	}
+	table += "</table>";
+
+	QMessageBox msgBox(this);
+	msgBox.setWindowTitle(tr("Cache statistics"));
+#ifdef Q_OS_ANDROID
+	msgBox.setText("<small>" + table + "</small>");
+#else // Q_OS_ANDROID
+	msgBox.setText("<h3>" + tr("Cache statistics") + "</h3>");
+	msgBox.setInformativeText(table);
+#endif // Q_OS_ANDROID
+
+	msgBox.exec();
+}
+
 void GUI::openFile()
 {
 #ifdef Q_OS_ANDROID
@@ -1037,14 +1194,13 @@ void GUI::openFile()
 #endif // Q_OS_ANDROID
 	int showError = (files.size() > 1) ? 2 : 1;
 
-	for (int i = 0; i < files.size(); i++)
-		openFile(files.at(i), true, showError);
+	openFiles(files, showError);
 	if (!files.isEmpty())
 		_dataDir = QFileInfo(files.last()).path();
 }
 
 #ifndef Q_OS_ANDROID
-void GUI::openDir(const QString &path, int &showError)
+void GUI::dirFiles(const QString &path, QStringList &files)
 {
 	QDir md(path);
 	md.setFilter(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
@@ -1055,10 +1211,31 @@ void GUI::openDir(const QString &path, int &showError)
 		const QFileInfo &fi = ml.at(i);
 
 		if (fi.isDir())
-			openDir(fi.absoluteFilePath(), showError);
+			dirFiles(fi.absoluteFilePath(), files);
+		else
+			files.append(fi.absoluteFilePath());
+	}
+}
+
+/* The JPEG images are not opened one by one, but the directory is opened as
+   one set of photo waypoints (with just the EXIF headers read) */
+void GUI::openDir(const QString &path, int &showError)
+{
+	QStringList files, other;
+	bool photos = false;
+
+	dirFiles(path, files);
+	for (int i = 0; i < files.size(); i++) {
+		QString suffix(QFileInfo(files.at(i)).suffix().toLower());
+		if (suffix == "jpg" || suffix == "jpeg")
+			photos = true;
 		else
-			openFile(fi.absoluteFilePath(), true, showError);
+			other.append(files.at(i));
 	}
+	if (photos)
+		other.prepend(path);
+
+	openFiles(other, showError);
 }
 #endif // Q_OS_ANDROID
 
@@ -1096,16 +1273,122 @@ bool GUI::openFile(const QString &fileName, bool tryUnknown, int &showError)
 	else
 		path = fileName;
 
+	/* Files opened (e.g. dropped) while a stream is loading are opened once
+	   the loading is done */
+	if (_loading) {
+		_queuedFiles.append(fileName);
+		return true;
+	}
+
 	QFileInfo fi(path);
 	QString canonicalPath(fi.canonicalFilePath());
 
 	if (_files.contains(canonicalPath))
 		return true;
 
-	if (!loadFile(path, tryUnknown, showError))
-		return false;
+	bool ret = loadFile(path, tryUnknown, showError);
+	if (ret) {
+		_files.append(canonicalPath);
+		fileOpened(path, canonicalPath);
+	}
+	openQueuedFiles(showError);
+
+	return ret;
+}
+
+void GUI::openQueuedFiles(int &showError)
+{
+	if (_queuedFiles.isEmpty())
+		return;
+
+	QStringList files(_queuedFiles);
+	_queuedFiles.clear();
+	openFiles(files, showError);
+}
+
+void GUI::openFiles(const QStringList &files, int &showError)
+{
+	QStringList paths, canonicalPaths;
+
+	if (_loading) {
+		_queuedFiles.append(files);
+		return;
+	}
+
+	for (int i = 0; i < files.size(); i++) {
+		QUrl url(files.at(i));
+		if (url.scheme() == "geo") {
+			openFile(files.at(i), true, showError);
+			continue;
+		}
+
+		QString path(url.isLocalFile() ? url.toLocalFile() : files.at(i));
+		QString canonicalPath(QFileInfo(path).canonicalFilePath());
+		if (_files.contains(canonicalPath)
+		  || canonicalPaths.contains(canonicalPath))
+			continue;
+
+		paths.append(path);
+		canonicalPaths.append(canonicalPath);
+	}
+
+	if (paths.size() < 2) {
+		for (int i = 0; i < paths.size(); i++)
+			openFile(paths.at(i), true, showError);
+		return;
+	}
+
+	QList<int> loaded(loadFiles(paths, canonicalPaths, showError));
+	for (int i = 0; i < loaded.size(); i++)
+		fileOpened(paths.at(loaded.at(i)), canonicalPaths.at(loaded.at(i)));
+	openQueuedFiles(showError);
+}
+
+/* The next() calls of the loader run a nested event loop. The user input is
+   blocked by the (window modal) progress dialog from the start, the files
+   opened otherwise in the meantime are queued by the _loading guard. Every
+   loaded file is registered in _files as soon as its data is inserted. */
+QList<int> GUI::loadFiles(const QStringList &files,
+  const QStringList &canonicalPaths, int &showError)
+{
+	DataLoader loader(files, true);
+	QProgressDialog progress(tr("Loading files..."), tr("Cancel"), 0,
+	  loader.count(), this);
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(0);
+	progress.show();
+	connect(&progress, &QProgressDialog::canceled, &loader,
+	  &DataLoader::cancel);
+	connect(&loader, &DataLoader::progress, &progress,
+	  &QProgressDialog::setValue);
+
+	QList<DataLoader::File> batch;
+	QList<int> loaded;
+	int index = 0;
+
+	_loading = true;
+	_mapView->beginLoad();
+	loader.run();
+	while (loader.next(batch)) {
+		for (int i = 0; i < batch.size(); i++, index++) {
+			DataLoader::File &f = batch[i];
+
+			if (!loader.isCanceled() && (loadTail(f.fileName())
+			  || loadFile(f.fileName(), *f.data(), showError))) {
+				_files.append(canonicalPaths.at(index));
+				loaded.append(index);
+			}
+			f.clear();
+		}
+	}
+	_mapView->endLoad();
+	_loading = false;
+
+	return loaded;
+}
 
-	_files.append(canonicalPath);
+void GUI::fileOpened(const QString &path, const QString &canonicalPath)
+{
 #ifndef Q_OS_ANDROID
 	_browser->setCurrent(path);
 #endif // Q_OS_ANDROID
@@ -1120,8 +1403,6 @@ bool GUI::openFile(const QString &fileName, bool tryUnknown, int &showError)
 #ifndef Q_OS_ANDROID
 	updateRecentFiles(canonicalPath);
 #endif // Q_OS_ANDROID
-
-	return true;
 }
 
 bool GUI::loadURL(const QUrl &url, int &showError)
@@ -1129,7 +1410,7 @@ bool GUI::loadURL(const QUrl &url, int &showError)
 	Data data(url);
 
 	if (data.isValid()) {
-		loadData(data);
+		loadData(data, url.toString());
 		return true;
 	} else {
 		if (showError) {
@@ -1156,10 +1437,146 @@ bool GUI::loadURL(const QUrl &url, int &showError)
 
 bool GUI::loadFile(const QString &fileName, bool tryUnknown, int &showError)
 {
+	if (loadTail(fileName))
+		return true;
+	if (StreamLoader::isStreamable(fileName))
+		return loadStream(fileName, showError);
+
 	Data data(fileName, tryUnknown);
+	return loadFile(fileName, data, showError);
+}
+
+bool GUI::loadStream(const QString &fileName, int &showError)
+{
+	StreamLoader loader(fileName);
+	QProgressDialog progress(tr("Loading file..."), tr("Cancel"), 0, 0, this);
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(0);
+	progress.show();
+	connect(&progress, &QProgressDialog::canceled, &loader,
+	  &StreamLoader::cancel);
+
+	QList<Track> tracks;
+	TrackData preview;
+	bool streamed = false;
+
+	/* See loadFiles() */
+	_loading = true;
+	loader.run();
+	while (loader.next(tracks, preview)) {
+		if (!tracks.isEmpty()) {
+			_mapView->clearPreview();
+			loadData(Data(tracks), QFileInfo(fileName).canonicalFilePath());
+			streamed = true;
+		}
+		if (!preview.isEmpty())
+			_mapView->setPreview(Track(preview));
+	}
+	_mapView->clearPreview();
+	_loading = false;
+
+	if (loader.isCanceled())
+		return streamed;
+
+	/* The already displayed tracks are kept (and the file is considered
+	   open) even when the rest of the file could not be parsed. */
+	return loadFile(fileName, *loader.data(), showError) || streamed;
+}
+
+/* The followed files are loaded with a FileTail that is then kept to parse
+   the data appended to the file */
+bool GUI::loadTail(const QString &fileName)
+{
+	if (!_followFilesAction->isChecked() || !FileTail::canTail(fileName))
+		return false;
+
+	QString path(QFileInfo(fileName).canonicalFilePath());
+	if (_tails.contains(path))
+		return false;
+	QSharedPointer<FileTail> tail(new FileTail(fileName));
+	if (!tail->isValid())
+		return false;
+
+	loadData(tail->data(), path);
+	_tails.insert(path, tail);
+	_tailWatcher->addPath(path);
+
+	return true;
+}
+
+void GUI::updateTail(const QString &path)
+{
+	QSharedPointer<FileTail> tail(_tails.value(path));
+	QVector<Waypoint> waypoints;
+	int from;
+
+	if (!tail)
+		return;
+	if (!tail->update(from, waypoints)) {
+		/* The file has been rewritten (a new log), start over */
+		if (tail->isTruncated()) {
+			reloadFile(path);
+			return;
+		}
+
+		qWarning("%s: %s", qUtf8Printable(path),
+		  qUtf8Printable(tail->errorString()));
+		_tailWatcher->removePath(path);
+		_tails.remove(path);
+		return;
+	}
+
+	if (from >= 0) {
+		const QList<PathItem*> &paths = _loadedItems[path].paths;
+		const Track &track = tail->tracks().last();
+
+		if (paths.isEmpty()) {
+			/* The track is displayed once it has two points */
+			if (track.isValid())
+				loadData(Data(tail->tracks()), path);
+		} else if (from > 0) {
+			PathItem *pi = paths.first();
+
+			_mapView->appendTrack(pi, track, from);
+			for (int i = 0; i < _tabs.size(); i++) {
+				GraphTab *tab = _tabs.at(i);
+				GraphItem *gi = pi->graph(i);
+				if (!gi)
+					continue;
+
+				GraphPair gp(tab->appendedData(track, from, _map));
+				tab->appendGraph(gi, gp.primary());
+				if (gi->secondaryGraph())
+					tab->appendGraph(gi->secondaryGraph(), gp.secondary());
+			}
+			if (!_graphsTimer->isActive())
+				_graphsTimer->start();
+		}
+	}
 
+	if (!waypoints.isEmpty())
+		_mapView->appendWaypoints(waypoints, &_loadedItems[path].items);
+}
+
+/* Rescaling the graphs is O(n), so the graphs of the followed files are
+   redrawn at most once per GRAPHS_REDRAW_INTERVAL */
+void GUI::redrawGraphs()
+{
+	for (int i = 0; i < _tabs.size(); i++)
+		_tabs.at(i)->redraw();
+}
+
+void GUI::clearTails()
+{
+	if (!_tailWatcher->files().isEmpty())
+		_tailWatcher->removePaths(_tailWatcher->files());
+	_tails.clear();
+}
+
+bool GUI::loadFile(const QString &fileName, const Data &data, int &showError)
+{
 	if (data.isValid()) {
-		loadData(data);
+		loadData(data, QFileInfo(fileName).canonicalFilePath());
 		return true;
 	} else {
 		updateNavigationActions();
@@ -1192,48 +1609,42 @@ bool GUI::loadFile(const QString &fileName, bool tryUnknown, int &showError)
 	}
 }
 
-void GUI::loadData(const Data &data)
+/* The waypoint and area items have no memory usage info of their own, their
+   sizes are estimated from the data at load time */
+static qint64 dataSize(const Data &data)
 {
-	QList<QList<GraphItem*> > graphs;
-	QList<PathItem*> paths;
+	qint64 size = data.waypoints().size() * sizeof(WaypointItem);
 
-	for (int i = 0; i < data.tracks().count(); i++) {
-		const Track &track = data.tracks().at(i);
-		_trackDistance += track.distance();
-		_time += track.time();
-		_movingTime += track.movingTime();
-		const QDateTime date = track.date().toTimeZone(_options.timeZone.zone());
-		if (date.isValid()) {
-			if (_dateRange.first.isNull() || _dateRange.first > date)
-				_dateRange.first = date;
-			if (_dateRange.second.isNull() || _dateRange.second < date)
-				_dateRange.second = date;
-		}
+	for (int i = 0; i < data.areas().size(); i++) {
+		const QList<Polygon> &polygons = data.areas().at(i).polygons();
+
+		size += sizeof(AreaItem);
+		for (int j = 0; j < polygons.size(); j++)
+			for (int k = 0; k < polygons.at(j).size(); k++)
+				size += polygons.at(j).at(k).size() * (sizeof(Coordinates)
+				  + sizeof(QPainterPath::Element));
 	}
-	_trackCount += data.tracks().count();
 
-	for (int i = 0; i < data.routes().count(); i++)
-		_routeDistance += data.routes().at(i).distance();
-	_routeCount += data.routes().count();
+	return size;
+}
 
-	_waypointCount += data.waypoints().count();
-	_areaCount += data.areas().count();
+void GUI::loadData(const Data &data, const QString &name)
+{
+	QList<PathItem*> paths;
+	LoadedItems &items = _loadedItems[name];
 
-	if (_pathName.isNull()) {
-		if (data.tracks().count() == 1 && !data.routes().count())
-			_pathName = data.tracks().first().name();
-		else if (data.routes().count() == 1 && !data.tracks().count())
-			_pathName = data.routes().first().name();
-	} else
-		_pathName = QString();
+	_stats.add(data);
+	items.stats.add(data);
 
-	for (int i = 0; i < _tabs.count(); i++)
-		graphs.append(_tabs.at(i)->loadData(data, _map));
 	/* Refreshing the splitter is necessary to update the map viewport and
 	   properly fit the data! */
 	if (updateGraphTabs())
 		_splitter->refresh();
-	paths = _mapView->loadData(data);
+	paths = _mapView->loadData(data, &items.items);
+
+	if (items.graphs.isEmpty())
+		for (int i = 0; i < _tabs.count(); i++)
+			items.graphs.append(QList<GraphItem*>());
 
 	GraphTab *gt = static_cast<GraphTab*>(_graphTabWidget->currentWidget());
 
@@ -1241,9 +1652,7 @@ void GUI::loadData(const Data &data)
 		PathItem *pi = paths.at(i);
 		if (!pi)
 			continue;
-
-		for (int j = 0; j < graphs.count(); j++)
-			pi->addGraph(graphs.at(j).at(i));
+		items.paths.append(pi);
 
 		if (gt) {
 			pi->setGraph(_tabs.indexOf(gt));
@@ -1251,9 +1660,131 @@ void GUI::loadData(const Data &data)
 		}
 	}
 
+	items.size += dataSize(data);
+
+	_graphJobs.append(GraphJob(++_graphJobId, name, data, paths,
+	  _tabs.count()));
+	loadGraphs();
+
 	updateDataDEMDownloadAction();
 }
 
+/* The graph items are created tab by tab, the current tab first, so the
+   visible graphs appear as soon as possible. The track graphs of a tab are
+   computed on the parser thread pool and the items are inserted once they
+   are ready. The items of every tab are created in the data loading order
+   to keep the graph colors in sync with the map. */
+void GUI::loadGraphs()
+{
+	int job, tab;
+
+	while (!_graphJob && nextGraphs(job, tab)) {
+		const GraphJob &gj = _graphJobs.at(job);
+		int series = _tabs.at(tab)->series();
+
+		if (!series) {
+			insertGraphs(job, tab);
+			continue;
+		}
+
+		_graphJob = gj.id;
+		_graphTab = tab;
+		_graphWatcher->setFuture(QtConcurrent::run(
+		  ThreadPools::pool(ThreadPools::Parse), &Track::computeGraphs,
+		  gj.data.tracks(), series, Track::filterSettings()));
+	}
+}
+
+bool GUI::nextGraphs(int &job, int &tab) const
+{
+	GraphTab *gt = static_cast<GraphTab*>(_graphTabWidget->currentWidget());
+	int current = gt ? _tabs.indexOf(gt) : -1;
+
+	for (int i = -1; i < _tabs.count(); i++) {
+		tab = (i < 0) ? current : i;
+		if (tab < 0 || (i >= 0 && tab == current))
+			continue;
+
+		for (job = 0; job < _graphJobs.size(); job++)
+			if (_graphJobs.at(job).pending.at(tab))
+				return true;
+	}
+
+	return false;
+}
+
+void GUI::insertGraphs(int job, int tab)
+{
+	GraphJob &gj = _graphJobs[job];
+	GraphTab *gt = _tabs.at(tab);
+	QHash<QString, LoadedItems>::iterator it(_loadedItems.find(gj.name));
+	QList<GraphItem*> graphs(gt->loadData(gj.data, _map));
+
+	it->graphs[tab].append(graphs);
+	for (int i = 0; i < gj.paths.count(); i++) {
+		PathItem *pi = gj.paths.at(i);
+		if (!pi)
+			continue;
+
+		pi->addGraph(tab, graphs.at(i));
+		if (gt == _graphTabWidget->currentWidget())
+			pi->setMarkerPosition(gt->sliderPosition());
+	}
+
+	gj.pending[tab] = false;
+	if (!gj.pending.contains(true))
+		_graphJobs.removeAt(job);
+
+	if (updateGraphTabs())
+		_splitter->refresh();
+}
+
+void GUI::graphsComputed()
+{
+	for (int i = 0; i < _graphJobs.size(); i++) {
+		if (_graphJobs.at(i).id == _graphJob) {
+			insertGraphs(i, _graphTab);
+			break;
+		}
+	}
+	_graphJob = 0;
+
+	loadGraphs();
+}
+
+/* Creates all the pending graph items right away, the missing graphs are
+   computed on the GUI thread */
+void GUI::finishGraphs()
+{
+	int job, tab;
+
+	_graphWatcher->waitForFinished();
+	for (int i = 0; i < _graphJobs.size(); i++) {
+		if (_graphJobs.at(i).id == _graphJob) {
+			insertGraphs(i, _graphTab);
+			break;
+		}
+	}
+	_graphJob = 0;
+
+	while (nextGraphs(job, tab))
+		insertGraphs(job, tab);
+}
+
+/* The running background computation works on its own copy of the tracks,
+   its result is ignored */
+void GUI::cancelGraphs(const QString &name)
+{
+	for (int i = 0; i < _graphJobs.size(); ) {
+		if (name.isNull() || _graphJobs.at(i).name == name) {
+			if (_graphJobs.at(i).id == _graphJob)
+				_graphJob = 0;
+			_graphJobs.removeAt(i);
+		} else
+			i++;
+	}
+}
+
 void GUI::openPOIFile()
 {
 #ifdef Q_OS_ANDROID
@@ -1332,7 +1863,52 @@ void GUI::exportPDFFile()
 	  _pdfExport.orientation, _pdfExport.margins, QPageLayout::Millimeter));
 	printer.setOutputFileName(_pdfExport.fileName);
 
-	plot(&printer);
+	plot(&printer, _pdfExport.mapPages);
+}
+
+/* The page is rendered in horizontal strips that are encoded right away, so
+   the memory needed does not depend on the output size */
+bool GUI::writePNGPage(const QString &fileName, const QSize &size,
+  const QRectF &contentRect, bool graphsPage)
+{
+	if (size.isEmpty())
+		return false;
+
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly)) {
+		qWarning("%s: %s", qUtf8Printable(file.fileName()),
+		  qUtf8Printable(file.errorString()));
+		return false;
+	}
+	PNGWriter writer(&file);
+	QRectF rect(QPointF(0, 0), size);
+	int stripHeight = qMax(1, PNG_EXPORT_STRIP_SIZE / size.width());
+	QImage strip(size.width(), qMin(stripHeight, size.height()),
+	  QImage::Format_ARGB32_Premultiplied);
+	bool ok = writer.start(size);
+
+	for (int y = 0; ok && y < size.height(); y += strip.height()) {
+		QPainter p(&strip);
+
+		if (_pngExport.antialiasing)
+			p.setRenderHint(QPainter::Antialiasing);
+		p.setClipRect(strip.rect());
+		p.translate(0, -y);
+		p.fillRect(rect, Qt::white);
+		if (graphsPage)
+			plotGraphsPage(&p, contentRect, 1);
+		else
+			plotMainPage(&p, contentRect, 1.0, true);
+		p.end();
+
+		ok = writer.write(strip);
+	}
+	if (!ok || !writer.finish()) {
+		qWarning("%s: PNG export error", qUtf8Printable(file.fileName()));
+		return false;
+	}
+
+	return true;
 }
 
 void GUI::exportPNGFile()
@@ -1341,33 +1917,24 @@ void GUI::exportPNGFile()
 	if (dialog.exec() != QDialog::Accepted)
 		return;
 
-	QImage img(_pngExport.size, QImage::Format_ARGB32_Premultiplied);
-	QPainter p(&img);
-	QRectF rect(0, 0, img.width(), img.height());
+	finishGraphs();
+
+	QRectF rect(QPointF(0, 0), _pngExport.size);
 	QRectF contentRect(rect.adjusted(_pngExport.margins.left(),
 	  _pngExport.margins.top(), -_pngExport.margins.right(),
 	  -_pngExport.margins.bottom()));
 
-	if (_pngExport.antialiasing)
-		p.setRenderHint(QPainter::Antialiasing);
-	p.fillRect(rect, Qt::white);
-	plotMainPage(&p, contentRect, 1.0, true);
-	img.save(_pngExport.fileName, "png");
+	if (!writePNGPage(_pngExport.fileName, _pngExport.size, contentRect,
+	  false))
+		return;
 
 	if (!_tabs.isEmpty() && _options.separateGraphPage) {
-		QImage img2(_pngExport.size.width(), (int)graphPlotHeight(rect, 1)
-		  + _pngExport.margins.bottom(), QImage::Format_ARGB32_Premultiplied);
-		QPainter p2(&img2);
-		QRectF rect2(0, 0, img2.width(), img2.height());
-
-		if (_pngExport.antialiasing)
-			p2.setRenderHint(QPainter::Antialiasing);
-		p2.fillRect(rect2, Qt::white);
-		plotGraphsPage(&p2, contentRect, 1);
-
 		QFileInfo fi(_pngExport.fileName);
-		img2.save(fi.absolutePath() + "/" + fi.baseName() + "-graphs."
-		  + fi.suffix(), "png");
+		QSize size(_pngExport.size.width(), (int)graphPlotHeight(rect, 1)
+		  + _pngExport.margins.bottom());
+
+		writePNGPage(fi.absolutePath() + "/" + fi.baseName() + "-graphs."
+		  + fi.suffix(), size, contentRect, true);
 	}
 }
 
@@ -1433,22 +2000,24 @@ void GUI::statistics()
 
 	header(text);
 
-	if (_showTracksAction->isChecked() && _trackCount > 1)
-		appendRow(tr("Tracks"), l.toString(_trackCount), text);
-	if (_showRoutesAction->isChecked() && _routeCount > 1)
-		appendRow(tr("Routes"), l.toString(_routeCount), text);
-	if (_showWaypointsAction->isChecked() && _waypointCount > 1)
-		appendRow(tr("Waypoints"), l.toString(_waypointCount), text);
-	if (_showAreasAction->isChecked() && _areaCount > 1)
-		appendRow(tr("Areas"), l.toString(_areaCount), text);
-
-	if (_dateRange.first.isValid()) {
-		if (_dateRange.first == _dateRange.second)
-			appendRow(tr("Date"), l.toString(_dateRange.first.date()), text);
+	if (_showTracksAction->isChecked() && _stats.trackCount() > 1)
+		appendRow(tr("Tracks"), l.toString(_stats.trackCount()), text);
+	if (_showRoutesAction->isChecked() && _stats.routeCount() > 1)
+		appendRow(tr("Routes"), l.toString(_stats.routeCount()), text);
+	if (_showWaypointsAction->isChecked() && _stats.waypointCount() > 1)
+		appendRow(tr("Waypoints"), l.toString(_stats.waypointCount()), text);
+	if (_showAreasAction->isChecked() && _stats.areaCount() > 1)
+		appendRow(tr("Areas"), l.toString(_stats.areaCount()), text);
+
+	DataStatistics::DateTimeRange range(_stats.dateRange(
+	  _options.timeZone.zone()));
+	if (range.first.isValid()) {
+		if (range.first == range.second)
+			appendRow(tr("Date"), l.toString(range.first.date()), text);
 		else
 			appendRow(tr("Date"), QString("%1 - %2").arg(
-			  l.toString(_dateRange.first.date(), QLocale::ShortFormat),
-			  l.toString(_dateRange.second.date(), QLocale::ShortFormat)), text);
+			  l.toString(range.first.date(), QLocale::ShortFormat),
+			  l.toString(range.second.date(), QLocale::ShortFormat)), text);
 	}
 
 	if (distance() > 0)
@@ -1487,27 +2056,29 @@ void GUI::plotMainPage(QPainter *painter, const QRectF &rect, qreal ratio,
 	int sc;
 
 
-	if (!_pathName.isNull() && _options.printName)
-		info.insert(tr("Name"), _pathName);
+	if (!!_stats.pathName().isNull() && _options.printName)
+		info.insert(tr("Name"), _stats.pathName());
 
 	if (_options.printItemCount) {
-		if (_showTracksAction->isChecked() && _trackCount > 1)
-			info.insert(tr("Tracks"), l.toString(_trackCount));
-		if (_showRoutesAction->isChecked() && _routeCount > 1)
-			info.insert(tr("Routes"), l.toString(_routeCount));
-		if (_showWaypointsAction->isChecked() && _waypointCount > 1)
-			info.insert(tr("Waypoints"), l.toString(_waypointCount));
-		if (_showAreasAction->isChecked() && _areaCount > 1)
-			info.insert(tr("Areas"), l.toString(_areaCount));
-	}
-
-	if (_dateRange.first.isValid() && _options.printDate) {
-		if (_dateRange.first == _dateRange.second)
-			info.insert(tr("Date"), l.toString(_dateRange.first.date()));
+		if (_showTracksAction->isChecked() && _stats.trackCount() > 1)
+			info.insert(tr("Tracks"), l.toString(_stats.trackCount()));
+		if (_showRoutesAction->isChecked() && _stats.routeCount() > 1)
+			info.insert(tr("Routes"), l.toString(_stats.routeCount()));
+		if (_showWaypointsAction->isChecked() && _stats.waypointCount() > 1)
+			info.insert(tr("Waypoints"), l.toString(_stats.waypointCount()));
+		if (_showAreasAction->isChecked() && _stats.areaCount() > 1)
+			info.insert(tr("Areas"), l.toString(_stats.areaCount()));
+	}
+
+	DataStatistics::DateTimeRange range(_stats.dateRange(
+	  _options.timeZone.zone()));
+	if (range.first.isValid() && _options.printDate) {
+		if (range.first == range.second)
+			info.insert(tr("Date"), l.toString(range.first.date()));
 		else {
 			info.insert(tr("Date"), QString("%1 - %2")
-			  .arg(l.toString(_dateRange.first.date(), QLocale::ShortFormat),
-			  l.toString(_dateRange.second.date(), QLocale::ShortFormat)));
+			  .arg(l.toString(range.first.date(), QLocale::ShortFormat),
+			  l.toString(range.second.date(), QLocale::ShortFormat)));
 		}
 	}
 
@@ -1587,8 +2158,38 @@ qreal GUI::graphPlotHeight(const QRectF &rect, qreal ratio)
 	return cnt * gh + (cnt - 1) * sp;
 }
 
-void GUI::plot(QPrinter *printer)
+/* The map pages are rendered off-screen with a separate instance of the
+   current map from the (re)loaded files, the map view is not touched */
+void GUI::plotMapPages(QPrinter *printer, QPainter *painter,
+  const QRectF &rect, qreal ratio, int pages)
 {
+	RenderContext ctx(_mapView->inputProjection(),
+	  _mapView->outputProjection(), _drawHillShadingAction->isChecked());
+	if (!_map->path().isEmpty() && !ctx.setMap(_map->path()))
+		return;
+
+	DataLoader loader(_files, false);
+	QList<DataLoader::File> batch;
+	loader.run();
+	while (loader.next(batch)) {
+		for (int i = 0; i < batch.size(); i++) {
+			if (batch.at(i).data()->isValid())
+				ctx.addData(*batch.at(i).data());
+			batch[i].clear();
+		}
+	}
+
+	QList<RectC> list(ctx.pages(pages));
+	for (int i = 0; i < list.size(); i++) {
+		printer->newPage();
+		ctx.render(painter, rect, list.at(i), ratio);
+	}
+}
+
+void GUI::plot(QPrinter *printer, int mapPages)
+{
+	finishGraphs();
+
 	QPainter p(printer);
 	qreal fsr = 1085.0 / (qMax(printer->width(), printer->height())
 	  / (qreal)printer->resolution());
@@ -1596,6 +2197,8 @@ void GUI::plot(QPrinter *printer)
 	QRectF rect(0, 0, printer->width(), printer->height());
 
 	plotMainPage(&p, rect, ratio);
+	if (mapPages > 1 && !_files.isEmpty())
+		plotMapPages(printer, &p, rect, ratio, mapPages);
 
 	if (!_tabs.isEmpty() && _options.separateGraphPage) {
 		printer->newPage();
@@ -1605,28 +2208,19 @@ void GUI::plot(QPrinter *printer)
 
 void GUI::reloadFiles()
 {
-	_trackCount = 0;
-	_routeCount = 0;
-	_waypointCount = 0;
-	_areaCount = 0;
-	_trackDistance = 0;
-	_routeDistance = 0;
-	_time = 0;
-	_movingTime = 0;
-	_dateRange = DateTimeRange(QDateTime(), QDateTime());
-	_pathName = QString();
+	cancelGraphs();
+	_stats.clear();
+	_loadedItems.clear();
+	clearTails();
 
 	for (int i = 0; i < _tabs.count(); i++)
 		_tabs.at(i)->clear();
 	_mapView->clear();
 
 	int showError = 2;
-	for (int i = 0; i < _files.size(); i++) {
-		if (!loadFile(_files.at(i), true, showError)) {
-			_files.removeAt(i);
-			i--;
-		}
-	}
+	QStringList files(_files);
+	_files.clear();
+	loadFiles(files, files, showError);
 
 	updateStatusBarInfo();
 	updateWindowTitle();
@@ -1638,20 +2232,75 @@ void GUI::reloadFiles()
 #endif // Q_OS_ANDROID
 	updateDataDEMDownloadAction();
 	_mapView->showExtendedInfo(_files.size() > 1);
+
+	openQueuedFiles(showError);
+}
+
+/* Removes the items of a single file (or URL) without touching the rest of
+   the loaded data. The view is not refitted. */
+void GUI::unloadFile(const QString &path)
+{
+	QHash<QString, LoadedItems>::iterator it(_loadedItems.find(path));
+	if (it == _loadedItems.end())
+		return;
+
+	if (_tails.remove(path))
+		_tailWatcher->removePath(path);
+
+	cancelGraphs(path);
+	_mapView->unloadData(it->items);
+	for (int i = 0; i < it->graphs.size(); i++)
+		_tabs.at(i)->removeData(it->graphs.at(i));
+
+	/* The areas of the loaded maps and DEM tiles are not owned by any file */
+	int areas = _stats.areaCount();
+	for (QHash<QString, LoadedItems>::const_iterator jt
+	  = _loadedItems.constBegin(); jt != _loadedItems.constEnd(); ++jt)
+		areas -= jt->stats.areaCount();
+
+	_loadedItems.erase(it);
+	_files.removeOne(path);
+
+	_stats.clear();
+	_stats.addAreas(areas);
+	for (QHash<QString, LoadedItems>::const_iterator jt
+	  = _loadedItems.constBegin(); jt != _loadedItems.constEnd(); ++jt)
+		_stats.add(jt->stats);
+
+	if (updateGraphTabs())
+		_splitter->refresh();
+	updateNavigationActions();
+	updateStatusBarInfo();
+	updateWindowTitle();
+	updateDataDEMDownloadAction();
+	_mapView->showExtendedInfo(_files.size() > 1);
+}
+
+/* Reloads a single file keeping its position in the file list */
+bool GUI::reloadFile(const QString &path)
+{
+	int index = _files.indexOf(path);
+	int showError = 2;
+
+	unloadFile(path);
+	if (!loadFile(path, true, showError))
+		return false;
+
+	_files.insert((index < 0) ? _files.size() : index, path);
+	_fileActionGroup->setEnabled(true);
+	updateStatusBarInfo();
+	updateWindowTitle();
+	_mapView->showExtendedInfo(_files.size() > 1);
+
+	return true;
 }
 
 void GUI::closeFiles()
 {
-	_trackCount = 0;
-	_routeCount = 0;
-	_waypointCount = 0;
-	_areaCount = 0;
-	_trackDistance = 0;
-	_routeDistance = 0;
-	_time = 0;
-	_movingTime = 0;
-	_dateRange = DateTimeRange(QDateTime(), QDateTime());
-	_pathName = QString();
+	cancelGraphs();
+	_stats.clear();
+	_loadedItems.clear();
+	clearTails();
 
 	for (int i = 0; i < _tabs.count(); i++)
 		_tabs.at(i)->clear();
@@ -2000,7 +2649,7 @@ void GUI::loadMapDirNode(const TreeNode<Map *> &node, QList<MapAction*> &actions
 				} else
 					connect(a, &MapAction::loaded, this, &GUI::mapLoadedDir);
 
-				_areaCount++;
+				_stats.addAreas(1);
 			}
 		} else {
 			map = a->data().value<Map*>();
@@ -2045,6 +2694,90 @@ void GUI::clearMapCache()
 		_mapView->clearMapCache();
 }
 
+void GUI::seedMapTiles()
+{
+	TileSeedDialog dialog(_tileSeed, _map->seedZooms(), _units, this);
+	if (dialog.exec() == QDialog::Accepted)
+		seedTiles(_tileSeed, true);
+}
+
+/* Command line seeding - the tracks/routes corridor when some paths are
+   loaded, the data area or the visible map area otherwise. */
+void GUI::seedTiles(const Range &zooms)
+{
+	TileSeed seed(_tileSeed);
+
+	if (_stats.trackCount() + _stats.routeCount())
+		seed.area = TileSeed::Corridor;
+	else if (_mapView->boundingRect().isValid())
+		seed.area = TileSeed::Data;
+	else
+		seed.area = TileSeed::Visible;
+	seed.zooms = zooms;
+
+	seedTiles(seed, false);
+}
+
+void GUI::seedTiles(const TileSeed &seed, bool confirm)
+{
+	QList<RectC> areas;
+
+	if (seed.area == TileSeed::Corridor)
+		areas = _mapView->corridor(seed.radius);
+	else if (seed.area == TileSeed::Data)
+		areas.append(_mapView->boundingRect());
+	else
+		areas.append(_mapView->visibleRect());
+
+	TileSeeder *seeder = _map->seeder(areas, seed.zooms);
+	if (!seeder) {
+		qWarning("%s: map does not support tiles download",
+		  qUtf8Printable(_map->name()));
+		return;
+	}
+
+	if (seeder->total() > SEED_LIMIT) {
+		QMessageBox::information(this, APP_NAME,
+		  tr("Map tiles download limit exceeded. Select a smaller area or "
+		  "a lower zoom level."));
+		delete seeder;
+		return;
+	} else if (!seeder->count()) {
+		if (confirm)
+			QMessageBox::information(this, APP_NAME,
+			  tr("All the map tiles are already downloaded."));
+		delete seeder;
+		return;
+	} else if (confirm && QMessageBox::question(this, APP_NAME,
+	  tr("Download %n map tiles (approx. %1)?", "", seeder->count())
+	  .arg(QLocale::system().formattedDataSize(seeder->size())))
+	  != QMessageBox::Yes) {
+		delete seeder;
+		return;
+	}
+
+	QProgressDialog progress(tr("Downloading map tiles..."), tr("Cancel"), 0,
+	  seeder->count(), this);
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(0);
+	QEventLoop wait;
+	connect(&progress, &QProgressDialog::canceled, seeder,
+	  &TileSeeder::cancel);
+	connect(&progress, &QProgressDialog::canceled, &wait, &QEventLoop::quit);
+	connect(seeder, &TileSeeder::progress, &progress,
+	  &QProgressDialog::setValue);
+	connect(seeder, &TileSeeder::finished, &wait, &QEventLoop::quit);
+
+	seeder->start();
+	wait.exec();
+
+	if (seeder->failed())
+		QMessageBox::warning(this, APP_NAME, tr("Could not download %n map "
+		  "tiles.", "", seeder->failed()));
+
+	delete seeder;
+}
+
 void GUI::downloadDataDEM()
 {
 	downloadDEM(_mapView->boundingRect());
@@ -2066,15 +2799,40 @@ void GUI::downloadDEM(const RectC &rect)
 	else if (cnt < DEM_DOWNLOAD_WARNING || QMessageBox::question(this, APP_NAME,
 	  tr("Download %n DEM tiles?", "", cnt)) == QMessageBox::Yes) {
 		_demRects.append(rect);
-		if (!_dem->loadTiles(rect) && _demRects.size() == 1)
-			demLoaded();
+		if (!_dem->loadTiles(rect)) {
+			if (_demRects.size() == 1)
+				demLoaded();
+		} else if (!_demProgress) {
+			_demProgress = new QProgressDialog(tr("Downloading DEM tiles..."),
+			  tr("Cancel"), 0, cnt, this);
+			_demProgress->setMinimumDuration(1000);
+			_demProgress->setAutoClose(false);
+			connect(_demProgress, &QProgressDialog::canceled, _dem,
+			  &DEMLoader::cancel);
+		}
 	}
 }
 
+void GUI::demProgress(int done, int total)
+{
+	if (!_demProgress)
+		return;
+
+	_demProgress->setMaximum(total);
+	_demProgress->setValue(done);
+}
+
 
 void GUI::demLoaded()
 {
-	for (int i = 0; i < _demRects.size(); i++) {
+	bool canceled = false;
+	if (_demProgress) {
+		canceled = _demProgress->wasCanceled();
+		_demProgress->deleteLater();
+		_demProgress = 0;
+	}
+
+	for (int i = 0; i < _demRects.size() && !canceled; i++) {
 		if (!_dem->checkTiles(_demRects.at(i))) {
 			QMessageBox::warning(this, APP_NAME,
 			  tr("Could not download all required DEM files."));
@@ -2084,6 +2842,7 @@ void GUI::demLoaded()
 
 	_demRects.clear();
 	DEM::clearCache();
+	HillShading::clearCache();
 
 	reloadFiles();
 	reloadMap();
@@ -2097,7 +2856,7 @@ void GUI::showDEMTiles()
 		QMessageBox::information(this, APP_NAME, tr("No local DEM tiles found."));
 	} else {
 		_mapView->loadDEMs(tiles);
-		_areaCount += tiles.size();
+		_stats.addAreas(tiles.size());
 		_fileActionGroup->setEnabled(true);
 	}
 }
@@ -2191,6 +2950,7 @@ void GUI::mapChanged(QAction *action)
 {
 	_map = action->data().value<Map*>();
 	_mapView->setMap(_map);
+	_seedMapTilesAction->setEnabled(_map->seedZooms().isValid());
 	updateMapDEMDownloadAction();
 	updateMapStyles();
 	updateMapLayers();
@@ -2320,8 +3080,8 @@ bool GUI::updateGraphTabs()
 	}
 
 	if (_graphTabWidget->count() &&
-	  ((_showTracksAction->isChecked() && _trackCount)
-	  || (_showRoutesAction->isChecked() && _routeCount))) {
+	  ((_showTracksAction->isChecked() && _stats.trackCount())
+	  || (_showRoutesAction->isChecked() && _stats.routeCount()))) {
 		if (_showGraphsAction->isChecked())
 			_graphTabWidget->setHidden(false);
 		_showGraphsAction->setEnabled(true);
@@ -2682,6 +3442,7 @@ void GUI::writeSettings()
 	WRITE(waypointLabels, _showWaypointLabelsAction->isChecked());
 	WRITE(routeWaypoints, _showRouteWaypointsAction->isChecked());
 	WRITE(pathTicks, _showTicksAction->isChecked());
+	WRITE(heatmap, _showHeatmapAction->isChecked());
 	WRITE(legend, _showLegendAction->isChecked());
 	WRITE(positionMarkers, _showMarkersAction->isChecked()
 	  || _showMarkerDateAction->isChecked()
@@ -2713,6 +3474,7 @@ void GUI::writeSettings()
 	WRITE(pdfMarginRight, _pdfExport.margins.right());
 	WRITE(pdfMarginBottom, _pdfExport.margins.bottom());
 	WRITE(pdfFileName, _pdfExport.fileName);
+	WRITE(pdfMapPages, _pdfExport.mapPages);
 	settings.endGroup();
 
 	/* PNG export */
@@ -2755,6 +3517,7 @@ void GUI::writeSettings()
 	WRITE(heartRateFilter, _options.heartRateFilter);
 	WRITE(cadenceFilter, _options.cadenceFilter);
 	WRITE(powerFilter, _options.powerFilter);
+	WRITE(filterType, _options.filterType);
 	WRITE(outlierEliminate, _options.outlierEliminate);
 	WRITE(detectPauses, _options.detectPauses);
 	WRITE(automaticPause, _options.automaticPause);
@@ -2781,8 +3544,16 @@ void GUI::writeSettings()
 	WRITE(positionPluginParameters, _options.pluginParams);
 	WRITE(useOpenGL, _options.useOpenGL);
 	WRITE(enableHTTP2, _options.enableHTTP2);
-	WRITE(pixmapCache, _options.pixmapCache);
+	WRITE(revalidateCache, _options.revalidateCache);
+	WRITE(pixmapCache(), _options.pixmapCache);
+	WRITE(tileImageCache(), _options.tileImageCache);
 	WRITE(demCache, _options.demCache);
+	WRITE(imgCache, _options.imgCache);
+	WRITE(dataCache, _options.dataCache);
+	WRITE(tileCache, _options.tileCache);
+	WRITE(prefetchRing, _options.prefetchRing);
+	WRITE(renderThreads, _options.renderThreads);
+	WRITE(parseThreads, _options.parseThreads);
 	WRITE(connectionTimeout, _options.connectionTimeout);
 	WRITE(hiresPrint, _options.hiresPrint);
 	WRITE(printName, _options.printName);
@@ -2965,6 +3736,10 @@ void GUI::readSettings(QString &activeMap, QStringList &disabledPOIs,
 		_showTicksAction->setChecked(true);
 		_mapView->showTicks(true);
 	}
+	if (READ(heatmap).toBool()) {
+		_showHeatmapAction->setChecked(true);
+		_mapView->showHeatmap(true);
+	}
 	if (READ(legend).toBool()) {
 		_showLegendAction->setChecked(true);
 		_mapView->showLegend(true);
@@ -3026,6 +3801,7 @@ void GUI::readSettings(QString &activeMap, QStringList &disabledPOIs,
 	  READ(pdfMarginTop).toReal(), READ(pdfMarginRight).toReal(),
 	  READ(pdfMarginBottom).toReal());
 	_pdfExport.fileName = READ(pdfFileName).toString();
+	_pdfExport.mapPages = qMax(1, READ(pdfMapPages).toInt());
 	settings.endGroup();
 
 	/* PNG export */
@@ -3066,6 +3842,7 @@ void GUI::readSettings(QString &activeMap, QStringList &disabledPOIs,
 	_options.heartRateFilter = READ(heartRateFilter).toInt();
 	_options.cadenceFilter = READ(cadenceFilter).toInt();
 	_options.powerFilter = READ(powerFilter).toInt();
+	_options.filterType = READ(filterType).toInt();
 	_options.outlierEliminate = READ(outlierEliminate).toBool();
 	_options.pauseSpeed = READ(pauseSpeed).toFloat();
 	_options.detectPauses = READ(detectPauses).toBool();
@@ -3092,8 +3869,16 @@ void GUI::readSettings(QString &activeMap, QStringList &disabledPOIs,
 	_options.pluginParams = READ(positionPluginParameters);
 	_options.useOpenGL = READ(useOpenGL).toBool();
 	_options.enableHTTP2 = READ(enableHTTP2).toBool();
-	_options.pixmapCache = READ(pixmapCache).toInt();
+	_options.revalidateCache = READ(revalidateCache).toBool();
+	_options.pixmapCache = READ(pixmapCache()).toInt();
+	_options.tileImageCache = READ(tileImageCache()).toInt();
 	_options.demCache = READ(demCache).toInt();
+	_options.imgCache = READ(imgCache).toInt();
+	_options.dataCache = READ(dataCache).toInt();
+	_options.tileCache = READ(tileCache).toInt();
+	_options.prefetchRing = READ(prefetchRing).toInt();
+	_options.renderThreads = READ(renderThreads).toInt();
+	_options.parseThreads = READ(parseThreads).toInt();
 	_options.connectionTimeout = READ(connectionTimeout).toInt();
 	_options.hiresPrint = READ(hiresPrint).toBool();
 	_options.printName = READ(printName).toBool();
@@ -3160,6 +3945,7 @@ void GUI::loadOptions()
 	Track::setHeartRateFilter(_options.heartRateFilter);
 	Track::setCadenceFilter(_options.cadenceFilter);
 	Track::setPowerFilter(_options.powerFilter);
+	Track::setFilterType((Track::FilterType)_options.filterType);
 	Track::setOutlierElimination(_options.outlierEliminate);
 	Track::detectPauses(_options.detectPauses);
 	Track::setAutomaticPause(_options.automaticPause);
@@ -3177,9 +3963,17 @@ void GUI::loadOptions()
 
 	Downloader::enableHTTP2(_options.enableHTTP2);
 	Downloader::setTimeout(_options.connectionTimeout);
+	Downloader::enableRevalidation(_options.revalidateCache);
 
 	QPixmapCache::setCacheLimit(_options.pixmapCache * 1024);
+	TileCache::setCacheSize(_options.tileImageCache * 1024);
 	DEM::setCacheSize(_options.demCache * 1024);
+	IMG::MapData::setCacheSize(_options.imgCache * 1024);
+	DataCache::setCacheSize(_options.dataCache * 1024);
+	TileLoader::setCacheSize(_options.tileCache * 1024);
+	TileLoader::setPrefetchRing(_options.prefetchRing);
+	ThreadPools::setMaxThreadCount(ThreadPools::Render, _options.renderThreads);
+	ThreadPools::setMaxThreadCount(ThreadPools::Parse, _options.parseThreads);
 
 	HillShading::setAlpha(_options.hillshadingAlpha);
 	HillShading::setBlur(_options.hillshadingBlur);
@@ -3270,11 +4064,8 @@ void GUI::updateOptions(const Options &options)
 		_mapView->setMapConfig(CRS::projection(options.inputProjection),
 		  CRS::projection(4326, options.outputProjection), options.hidpiMap);
 
-	if (options.timeZone != _options.timeZone) {
+	if (options.timeZone != _options.timeZone)
 		_mapView->setTimeZone(options.timeZone.zone());
-		_dateRange.first = _dateRange.first.toTimeZone(options.timeZone.zone());
-		_dateRange.second = _dateRange.second.toTimeZone(options.timeZone.zone());
-	}
 
 	SET_TAB_OPTION(palette, setPalette);
 	SET_TAB_OPTION(graphWidth, setGraphWidth);
@@ -3287,6 +4078,10 @@ void GUI::updateOptions(const Options &options)
 	SET_TRACK_OPTION(heartRateFilter, setHeartRateFilter);
 	SET_TRACK_OPTION(cadenceFilter, setCadenceFilter);
 	SET_TRACK_OPTION(powerFilter, setPowerFilter);
+	if (options.filterType != _options.filterType) {
+		Track::setFilterType((Track::FilterType)options.filterType);
+		reload = true;
+	}
 	SET_TRACK_OPTION(outlierEliminate, setOutlierElimination);
 	SET_TRACK_OPTION(detectPauses, detectPauses);
 	SET_TRACK_OPTION(automaticPause, setAutomaticPause);
@@ -3318,8 +4113,24 @@ void GUI::updateOptions(const Options &options)
 
 	if (options.pixmapCache != _options.pixmapCache)
 		QPixmapCache::setCacheLimit(options.pixmapCache * 1024);
+	if (options.tileImageCache != _options.tileImageCache)
+		TileCache::setCacheSize(options.tileImageCache * 1024);
 	if (options.demCache != _options.demCache)
 		DEM::setCacheSize(options.demCache * 1024);
+	if (options.imgCache != _options.imgCache)
+		IMG::MapData::setCacheSize(options.imgCache * 1024);
+	if (options.dataCache != _options.dataCache)
+		DataCache::setCacheSize(options.dataCache * 1024);
+	if (options.tileCache != _options.tileCache)
+		TileLoader::setCacheSize(options.tileCache * 1024);
+	if (options.prefetchRing != _options.prefetchRing)
+		TileLoader::setPrefetchRing(options.prefetchRing);
+	if (options.renderThreads != _options.renderThreads)
+		ThreadPools::setMaxThreadCount(ThreadPools::Render,
+		  options.renderThreads);
+	if (options.parseThreads != _options.parseThreads)
+		ThreadPools::setMaxThreadCount(ThreadPools::Parse,
+		  options.parseThreads);
 
 	SET_HS_OPTION(hillshadingAlpha, setAlpha);
 	SET_HS_OPTION(hillshadingBlur, setBlur);
@@ -3332,6 +4143,8 @@ void GUI::updateOptions(const Options &options)
 		Downloader::setTimeout(options.connectionTimeout);
 	if (options.enableHTTP2 != _options.enableHTTP2)
 		Downloader::enableHTTP2(options.enableHTTP2);
+	if (options.revalidateCache != _options.revalidateCache)
+		Downloader::enableRevalidation(options.revalidateCache);
 
 	if (options.dataPath != _options.dataPath)
 		_dataDir = options.dataPath;
@@ -3445,21 +4258,21 @@ qreal GUI::distance() const
 	qreal dist = 0;
 
 	if (_showTracksAction->isChecked())
-		dist += _trackDistance;
+		dist += _stats.trackDistance();
 	if (_showRoutesAction->isChecked())
-		dist += _routeDistance;
+		dist += _stats.routeDistance();
 
 	return dist;
 }
 
 qreal GUI::time() const
 {
-	return (_showTracksAction->isChecked()) ? _time : 0;
+	return (_showTracksAction->isChecked()) ? _stats.time() : 0;
 }
 
 qreal GUI::movingTime() const
 {
-	return (_showTracksAction->isChecked()) ? _movingTime : 0;
+	return (_showTracksAction->isChecked()) ? _stats.movingTime() : 0;
 }
 
 void GUI::show()
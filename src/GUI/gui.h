@@ -4,17 +4,23 @@
 #include <QMainWindow>
 #include <QString>
 #include <QList>
+#include <QHash>
 #include <QDate>
 #include <QPrinter>
+#include <QSharedPointer>
+#include <QFutureWatcher>
 #include "common/treenode.h"
 #include "common/rectc.h"
 #include "data/graph.h"
+#include "data/data.h"
 #include "units.h"
 #include "timetype.h"
 #include "format.h"
 #include "pdfexportdialog.h"
 #include "pngexportdialog.h"
+#include "tileseeddialog.h"
 #include "optionsdialog.h"
+#include "datastatistics.h"
 
 class QMenu;
 class QToolBar;
@@ -27,6 +33,9 @@ class QPrinter;
 class QGeoPositionInfoSource;
 class FileBrowser;
 class GraphTab;
+class PathItem;
+class GraphItem;
+class QGraphicsItem;
 class MapView;
 class Map;
 class POI;
@@ -35,7 +44,11 @@ class MapAction;
 class POIAction;
 class Data;
 class DEMLoader;
+class QProgressDialog;
 class NavigationWidget;
+class FileTail;
+class QFileSystemWatcher;
+class QTimer;
 
 class GUI : public QMainWindow
 {
@@ -47,14 +60,19 @@ public:
 	bool openFile(const QString &fileName, bool tryUnknown, int &showError);
 	bool loadMap(const QString &fileName, MapAction *&action, int &showError);
 	void show();
+	void loadInitialData();
 	void writeSettings();
+	void seedTiles(const Range &zooms);
 
 private slots:
 	void about();
 #ifndef Q_OS_ANDROID
 	void keys();
+	void saveTrace();
 #endif // Q_OS_ANDROID
 	void paths();
+	void cacheStatistics();
+	void memoryUsage();
 	void printFile();
 	void exportPDFFile();
 	void exportPNGFile();
@@ -62,6 +80,8 @@ private slots:
 	void openDir();
 	void closeAll();
 	void reloadFiles();
+	bool reloadFile(const QString &path);
+	void unloadFile(const QString &path);
 	void statistics();
 	void openPOIFile();
 	void showGraphs(bool show);
@@ -86,6 +106,7 @@ private slots:
 	void prevMap();
 	void openOptions();
 	void clearMapCache();
+	void seedMapTiles();
 	void downloadDataDEM();
 	void downloadMapDEM();
 	void showDEMTiles();
@@ -128,15 +149,21 @@ private slots:
 	void mapInitialized();
 
 	void demLoaded();
+	void demProgress(int done, int total);
+	void updateTail(const QString &path);
+	void redrawGraphs();
+	void graphsComputed();
 
 private:
-	typedef QPair<QDateTime, QDateTime> DateTimeRange;
-
 	void closeFiles();
-	void plot(QPrinter *printer);
+	void plot(QPrinter *printer, int mapPages = 1);
+	void plotMapPages(QPrinter *printer, QPainter *painter, const QRectF &rect,
+	  qreal ratio, int pages);
 	void plotMainPage(QPainter *painter, const QRectF &rect, qreal ratio,
 	  bool expand = false);
 	void plotGraphsPage(QPainter *painter, const QRectF &rect, qreal ratio);
+	bool writePNGPage(const QString &fileName, const QSize &size,
+	  const QRectF &contentRect, bool graphsPage);
 	qreal graphPlotHeight(const QRectF &rect, qreal ratio);
 
 	TreeNode<POIAction*> createPOIActionsNode(const TreeNode<QString> &node);
@@ -158,12 +185,27 @@ private:
 	void createBrowser();
 
 #ifndef Q_OS_ANDROID
+	void dirFiles(const QString &path, QStringList &files);
 	void openDir(const QString &path, int &showError);
 #endif // Q_OS_ANDROID
+	void openFiles(const QStringList &files, int &showError);
+	void fileOpened(const QString &path, const QString &canonicalPath);
 	bool openPOIFile(const QString &fileName);
 	bool loadFile(const QString &fileName, bool tryUnknown, int &showError);
+	bool loadFile(const QString &fileName, const Data &data, int &showError);
+	bool loadStream(const QString &fileName, int &showError);
+	bool loadTail(const QString &fileName);
+	void clearTails();
+	QList<int> loadFiles(const QStringList &files,
+	  const QStringList &canonicalPaths, int &showError);
+	void openQueuedFiles(int &showError);
 	bool loadURL(const QUrl &url, int &showError);
-	void loadData(const Data &data);
+	void loadData(const Data &data, const QString &name);
+	void loadGraphs();
+	bool nextGraphs(int &job, int &tab) const;
+	void insertGraphs(int job, int tab);
+	void finishGraphs();
+	void cancelGraphs(const QString &name = QString());
 	bool loadMapNode(const TreeNode<Map*> &node, MapAction *&action,
 	  const QList<QAction*> &existingActions, int &showError);
 	void loadMapDirNode(const TreeNode<Map*> &node, QList<MapAction*> &actions,
@@ -173,6 +215,7 @@ private:
 	bool updateGraphTabs();
 	void updateDataDEMDownloadAction();
 	void updateMapDEMDownloadAction();
+	void seedTiles(const TileSeed &seed, bool confirm);
 	void updateMapLayers();
 	void updateMapStyles();
 	void updateHillShading();
@@ -215,6 +258,9 @@ private:
 	void dropEvent(QDropEvent *event);
 
 	QString _lang;
+	/* Settings applied by loadInitialData() */
+	QString _activeMap;
+	QStringList _disabledPOIs;
 
 #ifdef Q_OS_ANDROID
 	NavigationWidget *_navigation;
@@ -242,6 +288,8 @@ private:
 	QAction *_exitAction;
 #endif // Q_OS_MAC + Q_OS_ANDROID
 	QAction *_pathsAction;
+	QAction *_cacheStatisticsAction;
+	QAction *_memoryAction;
 	QAction *_aboutAction;
 	QAction *_printFileAction;
 	QAction *_exportPDFFileAction;
@@ -250,6 +298,7 @@ private:
 	QAction *_openDirAction;
 	QAction *_closeFileAction;
 	QAction *_reloadFileAction;
+	QAction *_followFilesAction;
 	QAction *_statisticsAction;
 	QAction *_openPOIAction;
 	QAction *_selectAllPOIAction;
@@ -266,6 +315,7 @@ private:
 	QAction *_loadMapAction;
 	QAction *_loadMapDirAction;
 	QAction *_clearMapCacheAction;
+	QAction *_seedMapTilesAction;
 	QAction *_showGraphsAction;
 	QAction *_showGraphGridAction;
 	QAction *_showGraphSliderInfoAction;
@@ -275,6 +325,7 @@ private:
 	QAction *_showGraphTabsAction;
 #else // Q_OS_ANDROID
 	QAction *_keysAction;
+	QAction *_saveTraceAction;
 	QAction *_fullscreenAction;
 	QAction *_showToolbarsAction;
 	QAction *_nextAction;
@@ -302,6 +353,7 @@ private:
 	QAction *_showMarkerDateAction;
 	QAction *_showMarkerCoordinatesAction;
 	QAction *_showTicksAction;
+	QAction *_showHeatmapAction;
 	QAction *_showLegendAction;
 	QAction *_useStylesAction;
 	QAction *_showCoordinatesAction;
@@ -336,12 +388,51 @@ private:
 
 	FileBrowser *_browser;
 	QList<QString> _files;
-
-	int _trackCount, _routeCount, _areaCount, _waypointCount;
-	qreal _trackDistance, _routeDistance;
-	qreal _time, _movingTime;
-	DateTimeRange _dateRange;
-	QString _pathName;
+	/* Files opened while other files are being loaded */
+	QStringList _queuedFiles;
+	bool _loading;
+
+	DataStatistics _stats;
+	/* The items and statistics owned by the loaded files (and URLs), used for
+	   the memory usage report and to unload a single file */
+	struct LoadedItems {
+		LoadedItems() : size(0) {}
+
+		QList<PathItem*> paths;
+		QList<QGraphicsItem*> items;
+		/* Per graph tab */
+		QList<QList<GraphItem*> > graphs;
+		DataStatistics stats;
+		qint64 size;
+	};
+	QHash<QString, LoadedItems> _loadedItems;
+
+	/* The graph items of the loaded data still to be created, per graph tab.
+	   The track graphs of a tab are computed in the background first. */
+	struct GraphJob {
+		GraphJob() : data(QList<Track>()), id(0) {}
+		GraphJob(int id, const QString &name, const Data &data,
+		  const QList<PathItem*> &paths, int tabs)
+		  : name(name), data(data), paths(paths), id(id)
+		{
+			for (int i = 0; i < tabs; i++)
+				pending.append(true);
+		}
+
+		QString name;
+		Data data;
+		QList<PathItem*> paths;
+		QList<bool> pending;
+		int id;
+	};
+	QList<GraphJob> _graphJobs;
+	QFutureWatcher<void> *_graphWatcher;
+	int _graphJob, _graphTab, _graphJobId;
+
+	/* The followed (live) data files */
+	QHash<QString, QSharedPointer<FileTail> > _tails;
+	QFileSystemWatcher *_tailWatcher;
+	QTimer *_graphsTimer;
 
 #ifndef Q_OS_ANDROID
 	QList<QByteArray> _windowStates;
@@ -351,6 +442,7 @@ private:
 
 	PDFExport _pdfExport;
 	PNGExport _pngExport;
+	TileSeed _tileSeed;
 	Options _options;
 
 	QString _dataDir, _mapDir, _poiDir;
@@ -358,6 +450,7 @@ private:
 	Units _units;
 
 	QList<RectC> _demRects;
+	QProgressDialog *_demProgress;
 };
 
 #endif // GUI_H
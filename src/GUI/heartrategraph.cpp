@@ -78,6 +78,35 @@ QList<GraphItem*> HeartRateGraph::loadData(const Data &data, Map *map)
 	return graphs;
 }
 
+GraphPair HeartRateGraph::appendedData(const Track &track, int from, Map *map)
+  const
+{
+	Q_UNUSED(map);
+	return GraphPair(track.heartRate(from), Graph());
+}
+
+int HeartRateGraph::series() const
+{
+	return 1 << Track::HeartRate;
+}
+
+void HeartRateGraph::removeData(const QList<GraphItem*> &graphs)
+{
+	for (int i = 0; i < graphs.size(); i++) {
+		int idx = _tracks.indexOf(
+		  static_cast<HeartRateGraphItem*>(graphs.at(i)));
+		if (idx < 0)
+			continue;
+
+		removeGraph(_tracks.at(idx));
+		delete _tracks.takeAt(idx);
+		_avg.remove(idx);
+	}
+
+	setInfo();
+	redraw();
+}
+
 qreal HeartRateGraph::avg() const
 {
 	qreal sum = 0, w = 0;
@@ -0,0 +1,233 @@
+#include <cmath>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include "common/threadpools.h"
+#include "map/map.h"
+#include "heatmapitem.h"
+
+#define TILE_SIZE  256
+#define TILE_CACHE 512  /* tiles */
+#define SATURATION 100  /* paths */
+
+static QVector<QRgb> colorTable()
+{
+	/* transparent -> blue -> cyan -> yellow -> red */
+	static const QColor stops[] = {QColor(0, 0, 255), QColor(0, 255, 255),
+	  QColor(255, 255, 0), QColor(255, 0, 0)};
+	QVector<QRgb> table(256);
+
+	table[0] = qRgba(0, 0, 0, 0);
+	for (int i = 1; i < 256; i++) {
+		qreal v = (i - 1) / 254.0 * 3;
+		int s = qMin((int)v, 2);
+		qreal f = v - s;
+		const QColor &c0 = stops[s];
+		const QColor &c1 = stops[s + 1];
+		int alpha = qMin(128 + i, 255);
+
+		table[i] = qPremultiply(qRgba(
+		  (int)(c0.red() + f * (c1.red() - c0.red())),
+		  (int)(c0.green() + f * (c1.green() - c0.green())),
+		  (int)(c0.blue() + f * (c1.blue() - c0.blue())), alpha));
+	}
+
+	return table;
+}
+
+static const QVector<QRgb> &colors()
+{
+	static QVector<QRgb> table(colorTable());
+	return table;
+}
+
+void HeatmapItem::Tile::render()
+{
+	QRectF tr(_xy.x() * TILE_SIZE, _xy.y() * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+	QRectF sr(tr.adjusted(-1, -1, 1, 1));
+	QVector<float> density;
+	/* The last path that has been accumulated into the pixel, every path
+	   counts only once per pixel */
+	QVector<int> stamp;
+	float max = 0;
+
+	for (int i = 0; i < _item->_lines.size(); i++) {
+		if (!_item->_bounds.at(i).intersects(sr))
+			continue;
+
+		if (density.isEmpty()) {
+			density.fill(0, TILE_SIZE * TILE_SIZE);
+			stamp.fill(-1, TILE_SIZE * TILE_SIZE);
+		}
+
+		const QPolygonF &line = _item->_lines.at(i);
+		for (int j = 1; j < line.size(); j++) {
+			const QPointF &p0 = line.at(j-1);
+			const QPointF &p1 = line.at(j);
+			if (!QRectF(p0, p1).normalized().adjusted(-1, -1, 1, 1)
+			  .intersects(sr))
+				continue;
+
+			QPointF d(p1 - p0);
+			int steps = qMax((int)ceil(qMax(qAbs(d.x()), qAbs(d.y()))), 1);
+			for (int s = 0; s <= steps; s++) {
+				QPointF p(p0 + d * ((qreal)s / steps) - tr.topLeft());
+				int x = (int)floor(p.x());
+				int y = (int)floor(p.y());
+				if (x < 0 || y < 0 || x >= TILE_SIZE || y >= TILE_SIZE)
+					continue;
+
+				int idx = y * TILE_SIZE + x;
+				if (stamp.at(idx) == i)
+					continue;
+				stamp[idx] = i;
+				density[idx] += 1.0f;
+				max = qMax(max, density.at(idx));
+			}
+		}
+	}
+
+	if (max == 0)
+		return;
+
+	float scale = 255.0 / log1p(qMin(_item->_paths, SATURATION));
+	const QVector<QRgb> &table = colors();
+
+	_image = QImage(TILE_SIZE, TILE_SIZE, QImage::Format_ARGB32_Premultiplied);
+	for (int y = 0; y < TILE_SIZE; y++) {
+		QRgb *line = (QRgb*)_image.scanLine(y);
+		for (int x = 0; x < TILE_SIZE; x++) {
+			float v = density.at(y * TILE_SIZE + x);
+			line[x] = (v > 0)
+			  ? table.at(qMin(qMax((int)(log1p(v) * scale), 1), 255)) : 0;
+		}
+	}
+}
+
+HeatmapItem::HeatmapItem(QGraphicsItem *parent)
+  : QGraphicsItem(parent), _map(0), _paths(0), _tiles(TILE_CACHE)
+{
+	setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+void HeatmapItem::project(int segment)
+{
+	const QVector<Coordinates> &ll = _segments.at(segment);
+	QPolygonF &line = _lines[segment];
+
+	line.resize(ll.size());
+	_map->ll2xy(ll.constData(), line.data(), ll.size());
+	_bounds[segment] = line.boundingRect();
+}
+
+void HeatmapItem::invalidate(const QRectF &rect)
+{
+	QList<quint64> keys(_tiles.keys());
+
+	for (int i = 0; i < keys.size(); i++) {
+		quint64 k = keys.at(i);
+		QRectF tr(QPointF((qint32)(k >> 32), (qint32)(k & 0xFFFFFFFF))
+		  * TILE_SIZE, QSizeF(TILE_SIZE, TILE_SIZE));
+		if (tr.intersects(rect))
+			_tiles.remove(k);
+	}
+}
+
+void HeatmapItem::addPath(const Path &path)
+{
+	QRectF br;
+
+	for (int i = 0; i < path.size(); i++) {
+		const PathSegment &ps = path.at(i);
+		if (ps.size() < 2)
+			continue;
+
+		QVector<Coordinates> ll(ps.size());
+		for (int j = 0; j < ps.size(); j++)
+			ll[j] = ps.at(j).coordinates();
+
+		_segments.append(ll);
+		_lines.append(QPolygonF());
+		_bounds.append(QRectF());
+		if (_map) {
+			project(_segments.size() - 1);
+			br |= _bounds.last().adjusted(-1, -1, 1, 1);
+		}
+	}
+
+	_paths++;
+	if (br.isNull())
+		return;
+
+	/* The colour scale depends on the number of paths until saturated */
+	if (_paths <= SATURATION)
+		_tiles.clear();
+	else
+		invalidate(br);
+
+	prepareGeometryChange();
+	_boundingRect |= br;
+}
+
+void HeatmapItem::setMap(Map *map)
+{
+	prepareGeometryChange();
+
+	_map = map;
+	_tiles.clear();
+	_boundingRect = QRectF();
+
+	for (int i = 0; i < _segments.size(); i++) {
+		project(i);
+		_boundingRect |= _bounds.at(i).adjusted(-1, -1, 1, 1);
+	}
+}
+
+void HeatmapItem::clear()
+{
+	prepareGeometryChange();
+
+	_segments.clear();
+	_lines.clear();
+	_bounds.clear();
+	_paths = 0;
+	_tiles.clear();
+	_boundingRect = QRectF();
+}
+
+void HeatmapItem::paint(QPainter *painter,
+  const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+	Q_UNUSED(widget);
+
+	QRectF rect(option->exposedRect & _boundingRect);
+	if (painter->hasClipping())
+		rect &= painter->clipBoundingRect();
+	if (rect.isEmpty())
+		return;
+
+	QPoint tl((int)floor(rect.left() / TILE_SIZE),
+	  (int)floor(rect.top() / TILE_SIZE));
+	QPoint br((int)floor(rect.right() / TILE_SIZE),
+	  (int)floor(rect.bottom() / TILE_SIZE));
+	QList<Tile> tiles;
+
+	for (int x = tl.x(); x <= br.x(); x++)
+		for (int y = tl.y(); y <= br.y(); y++)
+			if (!_tiles.contains(key(QPoint(x, y))))
+				tiles.append(Tile(QPoint(x, y), this));
+
+	if (!tiles.isEmpty()) {
+		ThreadPools::blockingMap(ThreadPools::Render, tiles, &Tile::render);
+		for (int i = 0; i < tiles.size(); i++)
+			_tiles.insert(key(tiles.at(i).xy()),
+			  new QImage(tiles.at(i).image()));
+	}
+
+	for (int x = tl.x(); x <= br.x(); x++) {
+		for (int y = tl.y(); y <= br.y(); y++) {
+			QImage *img = _tiles.object(key(QPoint(x, y)));
+			if (img && !img->isNull())
+				painter->drawImage(QPointF(x * TILE_SIZE, y * TILE_SIZE), *img);
+		}
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef HEATMAPITEM_H
+#define HEATMAPITEM_H
+
+#include <QGraphicsItem>
+#include <QCache>
+#include <QImage>
+#include "data/path.h"
+
+class Map;
+
+/* Density heatmap of (a large number of) paths drawn as a single item. The
+   paths are accumulated into a per tile raster of the number of paths
+   passing each pixel that is colour-mapped into the tile image. The tiles
+   are rendered in parallel for the current map zoom and cached until the
+   map/zoom changes or a path covering the tile is added. */
+class HeatmapItem : public QGraphicsItem
+{
+public:
+	HeatmapItem(QGraphicsItem *parent = 0);
+
+	QRectF boundingRect() const {return _boundingRect;}
+	void paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
+	  QWidget *widget);
+
+	void addPath(const Path &path);
+	void setMap(Map *map);
+	void clear();
+
+private:
+	class Tile
+	{
+	public:
+		Tile(const QPoint &xy, const HeatmapItem *item)
+		  : _xy(xy), _item(item) {}
+
+		const QPoint &xy() const {return _xy;}
+		const QImage &image() const {return _image;}
+
+		void render();
+
+	private:
+		QPoint _xy;
+		const HeatmapItem *_item;
+		QImage _image;
+	};
+
+	void project(int path);
+	void invalidate(const QRectF &rect);
+
+	static quint64 key(const QPoint &xy)
+	  {return ((quint64)(quint32)xy.x() << 32) | (quint32)xy.y();}
+
+	Map *_map;
+	/* The path segments, their scene coordinates and bounds for the current
+	   map zoom */
+	QVector<QVector<Coordinates> > _segments;
+	QVector<QPolygonF> _lines;
+	QVector<QRectF> _bounds;
+	int _paths;
+
+	QRectF _boundingRect;
+	QCache<quint64, QImage> _tiles;
+};
+
+#endif // HEATMAPITEM_H
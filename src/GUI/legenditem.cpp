@@ -12,6 +12,8 @@ LegendItem::LegendItem(QGraphicsItem *parent) : QGraphicsItem(parent)
 {
 	_bgColor = Qt::white;
 	_drawBackground = false;
+
+	setCacheMode(QGraphicsItem::DeviceCoordinateCache);
 }
 
 void LegendItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <QGraphicsView>
 #include <QGraphicsScene>
 #include <QWheelEvent>
@@ -7,6 +8,8 @@
 #include <QClipboard>
 #include <QOpenGLWidget>
 #include <QGeoPositionInfoSource>
+#include <QTimer>
+#include "common/trace.h"
 #include "data/poi.h"
 #include "data/data.h"
 #include "map/map.h"
@@ -22,6 +25,8 @@
 #include "mapaction.h"
 #include "markerinfoitem.h"
 #include "crosshairitem.h"
+#include "heatmapitem.h"
+#include "clusteritem.h"
 #include "motioninfoitem.h"
 #include "mapview.h"
 
@@ -32,6 +37,30 @@
 #define SCALE_OFFSET     7
 #define COORDINATES_OFFSET SCALE_OFFSET
 #define LEGEND_OFFSET SCALE_OFFSET
+#define CLUSTER_CELL     64 // px
+#define CLUSTER_MIN      16
+#define CACHED_WAYPOINTS 512
+#define REPAINT_INTERVAL 16 // ms
+#define PREFETCH_DELAY   500 // ms
+#define INTERACTION_IDLE 300 // ms
+#define LOADED_MAPS      2
+#define MARKER_MARGIN    256 // px
+
+static void boundsMinMax(const RectC &rect, qreal min[2], qreal max[2])
+{
+	min[0] = rect.left();
+	min[1] = rect.bottom();
+	max[0] = rect.right();
+	max[1] = rect.top();
+}
+
+static bool pathCb(PathItem *item, void *context)
+{
+	QList<PathItem*> *list = (QList<PathItem*>*)context;
+	list->append(item);
+
+	return true;
+}
 
 
 MapView::MapView(Map *map, POI *poi, QWidget *parent) : QGraphicsView(parent)
@@ -51,6 +80,17 @@ MapView::MapView(Map *map, POI *poi, QWidget *parent) : QGraphicsView(parent)
 	viewport()->setAttribute(Qt::WA_AcceptTouchEvents);
 	grabGesture(Qt::PinchGesture);
 
+	_repaintTimer = new QTimer(this);
+	_repaintTimer->setSingleShot(true);
+	connect(_repaintTimer, &QTimer::timeout, this, &MapView::reloadMap);
+	_prefetchTimer = new QTimer(this);
+	_prefetchTimer->setSingleShot(true);
+	connect(_prefetchTimer, &QTimer::timeout, this, &MapView::prefetch);
+	_interactionTimer = new QTimer(this);
+	_interactionTimer->setSingleShot(true);
+	connect(_interactionTimer, &QTimer::timeout, this,
+	  &MapView::interactionFinished);
+
 	_mapScale = new ScaleItem();
 	_mapScale->setZValue(2.0);
 	_scene->addItem(_mapScale);
@@ -69,12 +109,18 @@ MapView::MapView(Map *map, POI *poi, QWidget *parent) : QGraphicsView(parent)
 	_map = map;
 	_map->load(_inputProjection, _outputProjection, _deviceRatio, _hidpi,
 	  _style, _layer);
-	connect(_map, &Map::tilesLoaded, this, &MapView::reloadMap);
+	connect(_map, &Map::tilesLoaded, this, &MapView::tilesLoaded);
+
+	_heatmap = new HeatmapItem();
+	_heatmap->setVisible(false);
+	_heatmap->setMap(_map);
+	_scene->addItem(_heatmap);
 
 	_poi = poi;
 	connect(_poi, &POI::pointsChanged, this, &MapView::updatePOI);
 
 	_positionSource = 0;
+	_preview = 0;
 	_crosshair = new CrosshairItem();
 	_crosshair->setZValue(2.0);
 	_crosshair->setVisible(false);
@@ -114,6 +160,7 @@ MapView::MapView(Map *map, POI *poi, QWidget *parent) : QGraphicsView(parent)
 	_showMarkers = false;
 	_markerInfoType = MarkerInfoItem::None;
 	_showPathTicks = false;
+	_showHeatmap = false;
 	_trackWidth = 3;
 	_routeWidth = 3;
 	_trackStyle = Qt::SolidLine;
@@ -130,7 +177,12 @@ MapView::MapView(Map *map, POI *poi, QWidget *parent) : QGraphicsView(parent)
 
 	_opengl = false;
 	_plot = false;
+	_interactive = false;
+	_markerPos = NAN;
+	_loading = false;
+	_loadZoom = 0;
 	_digitalZoom = 0;
+	_waypointsCache = QGraphicsItem::DeviceCoordinateCache;
 	_pinchZoom = 0;
 	_wheelDelta = 0;
 
@@ -180,7 +232,7 @@ PathItem *MapView::addTrack(const Track &track)
 	ti->setColor(_palette.nextColor());
 	ti->setWidth(_trackWidth);
 	ti->setPenStyle(_trackStyle);
-	ti->setVisible(_showTracks);
+	ti->setVisible(_showTracks && !_showHeatmap);
 	ti->setDigitalZoom(_digitalZoom);
 	ti->setMarkerColor(_markerColor);
 	ti->setMarkerBackgroundColor(_backgroundColor);
@@ -189,6 +241,10 @@ PathItem *MapView::addTrack(const Track &track)
 	ti->showMarkerInfo(_markerInfoType);
 	ti->showTicks(_showPathTicks);
 	_scene->addItem(ti);
+	indexPath(ti);
+
+	if (_showHeatmap)
+		_heatmap->addPath(ti->path());
 
 	if (_showTracks) {
 		addPOI(_poi->points(ti->path()));
@@ -223,6 +279,7 @@ PathItem *MapView::addRoute(const Route &route)
 	ri->showMarkerInfo(_markerInfoType);
 	ri->showTicks(_showPathTicks);
 	_scene->addItem(ri);
+	indexPath(ri);
 
 	if (_showRoutes) {
 		addPOI(_poi->points(ri->path()));
@@ -232,11 +289,11 @@ PathItem *MapView::addRoute(const Route &route)
 	return ri;
 }
 
-void MapView::addArea(const Area &area)
+PlaneItem *MapView::addArea(const Area &area)
 {
 	if (!area.isValid()) {
 		skipColor();
-		return;
+		return 0;
 	}
 
 	AreaItem *ai = new AreaItem(area, _map);
@@ -256,9 +313,12 @@ void MapView::addArea(const Area &area)
 		addPOI(_poi->points(ai->bounds()));
 		_legend->addItem(ai);
 	}
+
+	return ai;
 }
 
-void MapView::addWaypoints(const QVector<Waypoint> &waypoints)
+void MapView::addWaypoints(const QVector<Waypoint> &waypoints,
+  QList<QGraphicsItem*> *items)
 {
 	for (int i = 0; i < waypoints.count(); i++) {
 		const Waypoint &w = waypoints.at(i);
@@ -273,11 +333,16 @@ void MapView::addWaypoints(const QVector<Waypoint> &waypoints)
 		wi->showIcon(_showWaypointIcons);
 		wi->setVisible(_showWaypoints);
 		wi->setDigitalZoom(_digitalZoom);
+		wi->setCacheMode(_waypointsCache);
 		_scene->addItem(wi);
+		if (items)
+			items->append(wi);
 
 		if (_showWaypoints)
 			addPOI(_poi->points(w));
 	}
+
+	updateWaypointsCache();
 }
 
 MapItem *MapView::addMap(MapAction *map)
@@ -303,22 +368,138 @@ MapItem *MapView::addMap(MapAction *map)
 	return mi;
 }
 
-QList<PathItem *> MapView::loadData(const Data &data)
+/* If items is set, all the created map items are appended to it so they can
+   be later removed with unloadData() */
+QList<PathItem *> MapView::loadData(const Data &data,
+  QList<QGraphicsItem*> *items)
 {
 	QList<PathItem *> paths;
 	int zoom = _map->zoom();
 
-	for (int i = 0; i < data.areas().count(); i++)
-		addArea(data.areas().at(i));
+	for (int i = 0; i < data.areas().count(); i++) {
+		PlaneItem *ai = addArea(data.areas().at(i));
+		if (ai && items)
+			items->append(ai);
+	}
 	for (int i = 0; i < data.tracks().count(); i++)
 		paths.append(addTrack(data.tracks().at(i)));
 	for (int i = 0; i < data.routes().count(); i++)
 		paths.append(addRoute(data.routes().at(i)));
-	addWaypoints(data.waypoints());
+	if (items) {
+		for (int i = 0; i < paths.size(); i++)
+			if (paths.at(i))
+				items->append(paths.at(i));
+	}
+	addWaypoints(data.waypoints(), items);
+
+	if (!_loading)
+		fitLoadedContent(zoom);
+
+	return paths;
+}
+
+/* Removes (and deletes) the items of a single data file without rebuilding
+   the rest of the scene. The view is not refitted. */
+void MapView::unloadData(const QList<QGraphicsItem*> &items)
+{
+	bool tracks = false;
+
+	for (int i = 0; i < items.size(); i++) {
+		QGraphicsItem *item = items.at(i);
+
+		if (TrackItem *ti = dynamic_cast<TrackItem*>(item)) {
+			_tracks.removeOne(ti);
+			unindexPath(ti, ti->bounds());
+			tracks = true;
+		} else if (RouteItem *ri = dynamic_cast<RouteItem*>(item)) {
+			_routes.removeOne(ri);
+			unindexPath(ri, ri->bounds());
+		} else if (PlaneItem *pi = dynamic_cast<PlaneItem*>(item))
+			_areas.removeOne(pi);
+		else if (WaypointItem *wi = dynamic_cast<WaypointItem*>(item))
+			_waypoints.removeOne(wi);
+
+		_scene->removeItem(item);
+		delete item;
+	}
+
+	_tr = RectC();
+	for (int i = 0; i < _tracks.size(); i++)
+		_tr |= _tracks.at(i)->bounds();
+	_rr = RectC();
+	for (int i = 0; i < _routes.size(); i++)
+		_rr |= _routes.at(i)->path().boundingRect();
+	_ar = RectC();
+	for (int i = 0; i < _areas.size(); i++)
+		_ar |= _areas.at(i)->bounds();
+	_wr = RectC();
+	for (int i = 0; i < _waypoints.size(); i++)
+		_wr = _wr.united(_waypoints.at(i)->waypoint().coordinates());
+
+	if (tracks && _showHeatmap) {
+		_heatmap->clear();
+		for (int i = 0; i < _tracks.size(); i++)
+			_heatmap->addPath(_tracks.at(i)->path());
+	}
+
+	updateLegend();
+	updatePOI();
+}
+
+/* Live data - the view is not fitted to the new content */
+void MapView::appendTrack(PathItem *item, const Track &track, int from)
+{
+	TrackItem *ti = static_cast<TrackItem*>(item);
+	RectC bounds(ti->bounds());
+
+	ti->append(track, from);
+	_tr |= ti->bounds();
+
+	if (ti->bounds().topLeft() != bounds.topLeft()
+	  || ti->bounds().bottomRight() != bounds.bottomRight()) {
+		unindexPath(ti, bounds);
+		indexPath(ti);
+	}
+}
+
+/* Preview of a partially parsed (streamed) track. The preview is drawn with
+   the color the track gets once it is loaded and is not part of the loaded
+   data (legend, POI, heatmap, path index). */
+void MapView::setPreview(const Track &track)
+{
+	clearPreview();
+	if (!track.isValid())
+		return;
+
+	Palette palette(_palette);
+	_preview = new TrackItem(track, _map);
+	_preview->setColor(palette.nextColor());
+	_preview->setWidth(_trackWidth);
+	_preview->setPenStyle(_trackStyle);
+	_preview->setDigitalZoom(_digitalZoom);
+	_preview->setVisible(_showTracks && !_showHeatmap);
+	_scene->addItem(_preview);
+}
+
+void MapView::clearPreview()
+{
+	delete _preview;
+	_preview = 0;
+}
+
+void MapView::appendWaypoints(const QVector<Waypoint> &waypoints,
+  QList<QGraphicsItem*> *items)
+{
+	addWaypoints(waypoints, items);
+	if (_showWaypoints)
+		updatePOIVisibility();
+}
 
+void MapView::fitLoadedContent(int zoom)
+{
 	if (_tracks.empty() && _routes.empty() && _waypoints.empty()
 	  && _areas.empty())
-		return paths;
+		return;
 
 	if (fitMapZoom() != zoom)
 		rescale();
@@ -326,8 +507,20 @@ QList<PathItem *> MapView::loadData(const Data &data)
 		updatePOIVisibility();
 
 	centerOn(contentCenter());
+}
 
-	return paths;
+/* Bulk loading - the view is fitted to the content (which rescales all the
+   items) only once in endLoad() instead of on every loadData() call. */
+void MapView::beginLoad()
+{
+	_loading = true;
+	_loadZoom = _map->zoom();
+}
+
+void MapView::endLoad()
+{
+	_loading = false;
+	fitLoadedContent(_loadZoom);
 }
 
 void MapView::loadMaps(const QList<MapAction *> &maps)
@@ -375,26 +568,95 @@ QPointF MapView::contentCenter() const
 	return br.isNull() ? sceneRect().center() : _map->ll2xy(br.center());
 }
 
-void MapView::updatePOIVisibility()
+void MapView::clearPOIItems()
 {
-	if (!_showPOI)
-		return;
+	for (int i = 0; i < _poiItems.size(); i++)
+		_scene->removeItem(_poiItems.at(i));
+	qDeleteAll(_poiItems);
+	_poiItems.clear();
+
+	for (int i = 0; i < _clusters.size(); i++)
+		_scene->removeItem(_clusters.at(i));
+	qDeleteAll(_clusters);
+	_clusters.clear();
+}
+
+void MapView::addPOIItem(const Waypoint &waypoint)
+{
+	WaypointItem *pi = new WaypointItem(waypoint, _map);
+	pi->setZValue(1);
+	pi->setSize(_poiSize);
+	pi->setColor(_poiColor);
+	pi->showLabel(_showPOILabels);
+	pi->showIcon(_showPOIIcons);
+	pi->setDigitalZoom(_digitalZoom);
+	pi->setCacheMode(_waypointsCache);
+	_scene->addItem(pi);
+
+	_poiItems.append(pi);
+}
+
+void MapView::createPOIItems()
+{
+	/* Only the POIs of the grid cells with a few POIs at the current zoom
+	   get their own items, all the other cells are represented by a single
+	   cluster item so the number of the scene items stays bounded */
+	QHash<QPair<int, int>, QList<const Waypoint*> > cells;
+
+	for (QSet<Waypoint>::const_iterator it = _pois.constBegin();
+	  it != _pois.constEnd(); ++it) {
+		QPointF p(_map->ll2xy(it->coordinates()));
+		cells[qMakePair((int)floor(p.x() / CLUSTER_CELL),
+		  (int)floor(p.y() / CLUSTER_CELL))].append(&(*it));
+	}
+
+	for (QHash<QPair<int, int>, QList<const Waypoint*> >::const_iterator it
+	  = cells.constBegin(); it != cells.constEnd(); ++it) {
+		const QList<const Waypoint*> &pois = it.value();
 
-	for (POIHash::const_iterator it = _pois.constBegin();
-	  it != _pois.constEnd(); it++)
-		it.value()->show();
-
-	if (!_overlapPOIs) {
-		for (POIHash::const_iterator it = _pois.constBegin();
-		  it != _pois.constEnd(); it++) {
-			for (POIHash::const_iterator jt = _pois.constBegin();
-			  jt != _pois.constEnd(); jt++) {
-				if (it.value()->isVisible() && jt.value()->isVisible()
-				  && it != jt && it.value()->collidesWithItem(jt.value()))
-					jt.value()->hide();
+		if (pois.size() < CLUSTER_MIN) {
+			for (int i = 0; i < pois.size(); i++)
+				addPOIItem(*pois.at(i));
+			continue;
+		}
+
+		QPointF center;
+		for (int i = 0; i < pois.size(); i++)
+			center += _map->ll2xy(pois.at(i)->coordinates());
+
+		ClusterItem *ci = new ClusterItem(pois.size());
+		ci->setPos(center / pois.size());
+		ci->setZValue(1);
+		ci->setColor(_poiColor);
+		ci->setDigitalZoom(_digitalZoom);
+		_scene->addItem(ci);
+
+		_clusters.append(ci);
+	}
+}
+
+void MapView::updatePOIVisibility()
+{
+	clearPOIItems();
+
+	if (_showPOI) {
+		createPOIItems();
+
+		if (!_overlapPOIs) {
+			for (int i = 0; i < _poiItems.size(); i++) {
+				WaypointItem *pi = _poiItems.at(i);
+				if (!pi->isVisible())
+					continue;
+				for (int j = 0; j < _poiItems.size(); j++) {
+					WaypointItem *pj = _poiItems.at(j);
+					if (i != j && pj->isVisible() && pi->collidesWithItem(pj))
+						pj->hide();
+				}
 			}
 		}
 	}
+
+	updateWaypointsCache();
 }
 
 void MapView::rescale()
@@ -411,11 +673,8 @@ void MapView::rescale()
 	for (int i = 0; i < _waypoints.size(); i++)
 		_waypoints.at(i)->setMap(_map);
 
-	for (POIHash::const_iterator it = _pois.constBegin();
-	  it != _pois.constEnd(); it++)
-		it.value()->setMap(_map);
-
 	_crosshair->setMap(_map);
+	_heatmap->setMap(_map);
 
 	updatePOIVisibility();
 }
@@ -437,21 +696,23 @@ void MapView::setPalette(const Palette &palette)
 
 void MapView::setMap(Map *map)
 {
-	QRectF vr(mapToScene(viewport()->rect()).boundingRect()
-	  .intersected(_map->bounds()));
-	RectC cr(_map->xy2ll(vr.topLeft()), _map->xy2ll(vr.bottomRight()));
+	RectC cr(visibleRect());
 
-	disconnect(_map, &Map::tilesLoaded, this, &MapView::reloadMap);
-	_map->unload();
+	disconnect(_map, &Map::tilesLoaded, this, &MapView::tilesLoaded);
 	if (map != _map) {
+		keepLoaded(_map);
 		_style = -1;
 		_layer = -1;
+		_map = map;
+		if (!takeLoaded(_map))
+			_map->load(_inputProjection, _outputProjection, _deviceRatio,
+			  _hidpi, _style, _layer);
+	} else {
+		_map->unload();
+		_map->load(_inputProjection, _outputProjection, _deviceRatio, _hidpi,
+		  _style, _layer);
 	}
-
-	_map = map;
-	_map->load(_inputProjection, _outputProjection, _deviceRatio, _hidpi,
-	  _style, _layer);
-	connect(_map, &Map::tilesLoaded, this, &MapView::reloadMap);
+	connect(_map, &Map::tilesLoaded, this, &MapView::tilesLoaded);
 
 	digitalZoom(0);
 
@@ -466,6 +727,57 @@ void MapView::setMap(Map *map)
 	reloadMap();
 }
 
+MapView::LoadedMap::LoadedMap(Map *map, const Projection &in,
+  const Projection &out, qreal ratio, bool hidpi, int style, int layer)
+  : map(map), in(in), out(out), ratio(ratio), hidpi(hidpi), style(style),
+  layer(layer)
+{
+}
+
+/* The last LOADED_MAPS inactive maps are kept loaded (including all their
+   data caches), so switching back to such map does not have to rebuild the
+   map data. */
+void MapView::keepLoaded(Map *map)
+{
+	_loadedMaps.prepend(LoadedMap(map, _inputProjection, _outputProjection,
+	  _deviceRatio, _hidpi, _style, _layer));
+
+	while (_loadedMaps.size() > LOADED_MAPS) {
+		LoadedMap lm(_loadedMaps.takeLast());
+		if (lm.map)
+			lm.map->unload();
+	}
+}
+
+/* Returns true when the map is still loaded with the current setup */
+bool MapView::takeLoaded(Map *map)
+{
+	for (int i = 0; i < _loadedMaps.size(); i++) {
+		if (_loadedMaps.at(i).map != map)
+			continue;
+
+		LoadedMap lm(_loadedMaps.takeAt(i));
+		if (lm.in == _inputProjection && lm.out == _outputProjection
+		  && lm.ratio == _deviceRatio && lm.hidpi == _hidpi
+		  && lm.style == _style && lm.layer == _layer)
+			return true;
+
+		map->unload();
+		return false;
+	}
+
+	return false;
+}
+
+void MapView::unloadMaps()
+{
+	for (int i = 0; i < _loadedMaps.size(); i++)
+		if (_loadedMaps.at(i).map)
+			_loadedMaps.at(i).map->unload();
+
+	_loadedMaps.clear();
+}
+
 void MapView::setPOI(POI *poi)
 {
 	disconnect(_poi, &POI::pointsChanged, this, &MapView::updatePOI);
@@ -500,10 +812,6 @@ void MapView::setGraph(int index)
 
 void MapView::updatePOI()
 {
-	for (POIHash::const_iterator it = _pois.constBegin();
-	  it != _pois.constEnd(); it++)
-		_scene->removeItem(it.value());
-	qDeleteAll(_pois);
 	_pois.clear();
 
 	if (_showTracks)
@@ -524,24 +832,26 @@ void MapView::updatePOI()
 
 void MapView::addPOI(const QList<Waypoint> &waypoints)
 {
-	for (int i = 0; i < waypoints.size(); i++) {
-		const Waypoint &w = waypoints.at(i);
+	for (int i = 0; i < waypoints.size(); i++)
+		_pois.insert(waypoints.at(i));
+}
 
-		if (_pois.contains(SearchPointer<Waypoint>(&w)))
-			continue;
+/* The device coordinate cache spares the label layout on every repaint, but
+   with too many items their pixmaps only thrash the global QPixmapCache */
+void MapView::updateWaypointsCache()
+{
+	QGraphicsItem::CacheMode mode = (_waypoints.size() + _poiItems.size()
+	  > CACHED_WAYPOINTS) ? QGraphicsItem::NoCache
+	  : QGraphicsItem::DeviceCoordinateCache;
 
-		WaypointItem *pi = new WaypointItem(w, _map);
-		pi->setZValue(1);
-		pi->setSize(_poiSize);
-		pi->setColor(_poiColor);
-		pi->showLabel(_showPOILabels);
-		pi->showIcon(_showPOIIcons);
-		pi->setVisible(_showPOI);
-		pi->setDigitalZoom(_digitalZoom);
-		_scene->addItem(pi);
-
-		_pois.insert(SearchPointer<Waypoint>(&(pi->waypoint())), pi);
-	}
+	if (mode == _waypointsCache)
+		return;
+	_waypointsCache = mode;
+
+	for (int i = 0; i < _waypoints.size(); i++)
+		_waypoints.at(i)->setCacheMode(mode);
+	for (int i = 0; i < _poiItems.size(); i++)
+		_poiItems.at(i)->setCacheMode(mode);
 }
 
 void MapView::setUnits(Units units)
@@ -585,6 +895,47 @@ void MapView::setTimeZone(const QTimeZone &zone)
 		_routes.at(i)->updateMarkerInfo();
 }
 
+RectC MapView::visibleRect() const
+{
+	QRectF vr(mapToScene(viewport()->rect()).boundingRect()
+	  .intersected(_map->bounds()));
+	return RectC(_map->xy2ll(vr.topLeft()), _map->xy2ll(vr.bottomRight()));
+}
+
+/* Areas covering the displayed tracks and routes up to the given distance
+   (in meters) from the path. */
+QList<RectC> MapView::corridor(qreal radius) const
+{
+	QList<PathItem*> items;
+	QList<RectC> list;
+
+	if (_showTracks)
+		for (int i = 0; i < _tracks.size(); i++)
+			items.append(_tracks.at(i));
+	if (_showRoutes)
+		for (int i = 0; i < _routes.size(); i++)
+			items.append(_routes.at(i));
+
+	for (int i = 0; i < items.size(); i++) {
+		const Path &path = items.at(i)->path();
+
+		for (int j = 0; j < path.size(); j++) {
+			const PathSegment &segment = path.at(j);
+			qreal last = -radius;
+
+			for (int k = 0; k < segment.size(); k++) {
+				const PathPoint &p = segment.at(k);
+				if (p.distance() - last >= radius || k == segment.size() - 1) {
+					list.append(RectC(p.coordinates(), radius));
+					last = p.distance();
+				}
+			}
+		}
+	}
+
+	return list;
+}
+
 void MapView::clearMapCache()
 {
 	_map->clearCache();
@@ -609,9 +960,10 @@ void MapView::digitalZoom(int zoom)
 		_areas.at(i)->setDigitalZoom(_digitalZoom);
 	for (int i = 0; i < _waypoints.size(); i++)
 		_waypoints.at(i)->setDigitalZoom(_digitalZoom);
-	for (POIHash::const_iterator it = _pois.constBegin();
-	  it != _pois.constEnd(); it++)
-		it.value()->setDigitalZoom(_digitalZoom);
+	for (int i = 0; i < _poiItems.size(); i++)
+		_poiItems.at(i)->setDigitalZoom(_digitalZoom);
+	for (int i = 0; i < _clusters.size(); i++)
+		_clusters.at(i)->setDigitalZoom(_digitalZoom);
 
 	_mapScale->setDigitalZoom(_digitalZoom);
 	_cursorCoordinates->setDigitalZoom(_digitalZoom);
@@ -650,6 +1002,8 @@ void MapView::pinchGesture(QPinchGesture *gesture)
 	QPinchGesture::ChangeFlags changeFlags = gesture->changeFlags();
 	qreal scaleFactor = gesture->totalScaleFactor();
 
+	interaction();
+
 	if (changeFlags & QPinchGesture::ScaleFactorChanged) {
 		int z = 0;
 
@@ -675,6 +1029,8 @@ void MapView::wheelEvent(QWheelEvent *event)
 	int delta = event->angleDelta().y()
 	  ? event->angleDelta().y() : event->angleDelta().x();
 
+	interaction();
+
 	_wheelDelta += delta;
 	if (qAbs(_wheelDelta) < (15 * 8))
 		return;
@@ -804,6 +1160,14 @@ void MapView::plot(QPainter *painter, const QRectF &target, qreal scale,
 	  (-LEGEND_OFFSET - _legend->boundingRect().width()) * p,
 	  LEGEND_OFFSET * p)));
 
+	// Update the markers out of the display view
+	QList<PathItem*> paths;
+	for (int i = 0; i < _tracks.size(); i++)
+		paths.append(_tracks.at(i));
+	for (int i = 0; i < _routes.size(); i++)
+		paths.append(_routes.at(i));
+	updateMarkers(paths);
+
 	// Print the view
 	render(painter, target, adj.toRect());
 
@@ -834,15 +1198,21 @@ void MapView::plot(QPainter *painter, const QRectF &target, qreal scale,
 void MapView::clear()
 {
 	_pois.clear();
+	_poiItems.clear();
+	_clusters.clear();
 	_tracks.clear();
+	_preview = 0;
 	_routes.clear();
 	_areas.clear();
 	_waypoints.clear();
+	_pathIndex.RemoveAll();
+	_waypointsCache = QGraphicsItem::DeviceCoordinateCache;
 
 	_scene->removeItem(_mapScale);
 	_scene->removeItem(_cursorCoordinates);
 	_scene->removeItem(_positionCoordinates);
 	_scene->removeItem(_crosshair);
+	_scene->removeItem(_heatmap);
 	_scene->removeItem(_motionInfo);
 	_scene->removeItem(_legend);
 	_scene->clear();
@@ -850,6 +1220,8 @@ void MapView::clear()
 	_scene->addItem(_cursorCoordinates);
 	_scene->addItem(_positionCoordinates);
 	_scene->addItem(_crosshair);
+	_heatmap->clear();
+	_scene->addItem(_heatmap);
 	_scene->addItem(_motionInfo);
 	_legend->clear();
 	_scene->addItem(_legend);
@@ -872,7 +1244,8 @@ void MapView::showTracks(bool show)
 	_showTracks = show;
 
 	for (int i = 0; i < _tracks.count(); i++)
-		_tracks.at(i)->setVisible(show);
+		_tracks.at(i)->setVisible(show && !_showHeatmap);
+	_heatmap->setVisible(show && _showHeatmap);
 
 	updateLegend();
 	updatePOI();
@@ -966,6 +1339,27 @@ void MapView::showTicks(bool show)
 		_routes.at(i)->showTicks(show);
 }
 
+/* Draws all the tracks as a single density heatmap instead of the individual
+   track items, which is the only usable view of thousands of tracks. The
+   heatmap keeps its own copy of the tracks, so it is only filled when
+   shown. */
+void MapView::showHeatmap(bool show)
+{
+	if (_showHeatmap == show)
+		return;
+
+	_showHeatmap = show;
+
+	_heatmap->clear();
+	if (show)
+		for (int i = 0; i < _tracks.size(); i++)
+			_heatmap->addPath(_tracks.at(i)->path());
+
+	for (int i = 0; i < _tracks.count(); i++)
+		_tracks.at(i)->setVisible(_showTracks && !show);
+	_heatmap->setVisible(_showTracks && show);
+}
+
 void MapView::showMap(bool show)
 {
 	_showMap = show;
@@ -976,10 +1370,6 @@ void MapView::showPOI(bool show)
 {
 	_showPOI = show;
 
-	for (POIHash::const_iterator it = _pois.constBegin();
-	  it != _pois.constEnd(); it++)
-		it.value()->setVisible(show);
-
 	updatePOIVisibility();
 }
 
@@ -987,10 +1377,6 @@ void MapView::showPOILabels(bool show)
 {
 	_showPOILabels = show;
 
-	for (POIHash::const_iterator it = _pois.constBegin();
-	  it != _pois.constEnd(); it++)
-		it.value()->showLabel(show);
-
 	updatePOIVisibility();
 }
 
@@ -998,10 +1384,6 @@ void MapView::showPOIIcons(bool show)
 {
 	_showPOIIcons = show;
 
-	for (POIHash::const_iterator it = _pois.constBegin();
-	  it != _pois.constEnd(); it++)
-		it.value()->showIcon(show);
-
 	updatePOIVisibility();
 }
 
@@ -1121,18 +1503,18 @@ void MapView::setPOISize(int size)
 {
 	_poiSize = size;
 
-	for (POIHash::const_iterator it = _pois.constBegin();
-	  it != _pois.constEnd(); it++)
-		it.value()->setSize(size);
+	for (int i = 0; i < _poiItems.size(); i++)
+		_poiItems.at(i)->setSize(size);
 }
 
 void MapView::setPOIColor(const QColor &color)
 {
 	_poiColor = color;
 
-	for (POIHash::const_iterator it = _pois.constBegin();
-	  it != _pois.constEnd(); it++)
-		it.value()->setColor(color);
+	for (int i = 0; i < _poiItems.size(); i++)
+		_poiItems.at(i)->setColor(color);
+	for (int i = 0; i < _clusters.size(); i++)
+		_clusters.at(i)->setColor(color);
 }
 
 void MapView::setMapOpacity(int opacity)
@@ -1165,6 +1547,11 @@ void MapView::drawBackground(QPainter *painter, const QRectF &rect)
 		QRectF ir = rect.intersected(_map->bounds());
 		Map::Flags flags = Map::NoFlags;
 
+		/* Only draw the part of the map that is really going to be painted
+		   when plotting into a clipped (strip) device */
+		if (_plot && painter->hasClipping())
+			ir &= painter->clipBoundingRect();
+
 		if (_mapOpacity < 1.0)
 			painter->setOpacity(_mapOpacity);
 
@@ -1174,13 +1561,22 @@ void MapView::drawBackground(QPainter *painter, const QRectF &rect)
 			flags = Map::OpenGL;
 		if (_hillShading)
 			flags |= Map::HillShading;
+		if (_interactive && !_plot)
+			flags |= Map::Draft;
 
+		TRACE_SCOPE("map", "draw");
 		_map->draw(painter, ir, flags);
+
+		/* Every repaint (i.e. any user interaction) postpones the prefetch */
+		if (!_plot)
+			_prefetchTimer->start(PREFETCH_DELAY);
 	}
 }
 
 void MapView::paintEvent(QPaintEvent *event)
 {
+	TRACE_SCOPE("GUI", "MapView::paintEvent");
+
 	if (!_plot) {
 		QPointF scaleScenePos = mapToScene(rect().bottomRight() + QPoint(
 		  -(SCALE_OFFSET + _mapScale->boundingRect().width()),
@@ -1211,6 +1607,8 @@ void MapView::paintEvent(QPaintEvent *event)
 				_motionInfo->setPos(coordinatesScenePos);
 		}
 
+		updateMarkers(visiblePaths());
+
 		QPointF legendPos = mapToScene(rect().topRight() + QPoint(
 		  -(LEGEND_OFFSET + _legend->boundingRect().width()), LEGEND_OFFSET));
 		_legend->setPos(legendPos);
@@ -1221,6 +1619,8 @@ void MapView::paintEvent(QPaintEvent *event)
 
 void MapView::scrollContentsBy(int dx, int dy)
 {
+	interaction();
+
 	QGraphicsView::scrollContentsBy(dx, dy);
 
 	QRectF sr(mapToScene(viewport()->rect()).boundingRect());
@@ -1312,6 +1712,7 @@ void MapView::drawHillShading(bool draw)
 {
 	_hillShading = draw;
 
+	unloadMaps();
 	_map->unload();
 	_map->load(_inputProjection, _outputProjection, _deviceRatio, _hidpi,
 	  _style, _layer);
@@ -1324,8 +1725,7 @@ void MapView::selectStyle(int style)
 	_style = style;
 	_layer = -1;
 
-	_map->unload();
-	_map->load(_inputProjection, _outputProjection, _deviceRatio, _hidpi,
+	_map->restyle(_inputProjection, _outputProjection, _deviceRatio, _hidpi,
 	  _style, _layer);
 
 	reloadMap();
@@ -1335,8 +1735,7 @@ void MapView::selectLayer(int layer)
 {
 	_layer = layer;
 
-	_map->unload();
-	_map->load(_inputProjection, _outputProjection, _deviceRatio, _hidpi,
+	_map->restyle(_inputProjection, _outputProjection, _deviceRatio, _hidpi,
 	  _style, _layer);
 
 	reloadMap();
@@ -1368,19 +1767,114 @@ void MapView::setMarkerColor(const QColor &color)
 		_routes.at(i)->setMarkerColor(color);
 }
 
+void MapView::indexPath(PathItem *item)
+{
+	qreal min[2], max[2];
+
+	boundsMinMax(item->bounds(), min, max);
+	_pathIndex.Insert(min, max, item);
+}
+
+void MapView::unindexPath(PathItem *item, const RectC &bounds)
+{
+	qreal min[2], max[2];
+
+	boundsMinMax(bounds, min, max);
+	_pathIndex.Remove(min, max, item);
+}
+
+/* The marker info labels may reach out of the path bounds, so the view is
+   extended by a margin. */
+QList<PathItem*> MapView::visiblePaths() const
+{
+	QList<PathItem*> list;
+	QRectF vr(mapToScene(viewport()->rect().adjusted(-MARKER_MARGIN,
+	  -MARKER_MARGIN, MARKER_MARGIN, MARKER_MARGIN)).boundingRect()
+	  .intersected(_map->bounds()));
+	RectC rect(_map->xy2ll(vr.topLeft()), _map->xy2ll(vr.bottomRight()));
+	qreal min[2], max[2];
+
+	if (rect.left() > rect.right()) {
+		boundsMinMax(RectC(rect.topLeft(), Coordinates(180.0,
+		  rect.bottom())), min, max);
+		_pathIndex.Search(min, max, pathCb, &list);
+		boundsMinMax(RectC(Coordinates(-180.0, rect.top()),
+		  rect.bottomRight()), min, max);
+		_pathIndex.Search(min, max, pathCb, &list);
+	} else {
+		boundsMinMax(rect, min, max);
+		_pathIndex.Search(min, max, pathCb, &list);
+	}
+
+	return list;
+}
+
+/* Brings the markers of the paths that were out of the view on the last
+   marker position change up to date. */
+void MapView::updateMarkers(const QList<PathItem*> &paths)
+{
+	if (std::isnan(_markerPos))
+		return;
+
+	for (int i = 0; i < paths.size(); i++)
+		if (paths.at(i)->markerPosition() != _markerPos)
+			paths.at(i)->setMarkerPosition(_markerPos);
+}
+
+/* Only the markers of the visible paths are moved, the rest is updated lazily
+   in updateMarkers() once they get into the view. */
 void MapView::setMarkerPosition(qreal pos)
 {
-	for (int i = 0; i < _tracks.size(); i++)
-		_tracks.at(i)->setMarkerPosition(pos);
-	for (int i = 0; i < _routes.size(); i++)
-		_routes.at(i)->setMarkerPosition(pos);
+	_markerPos = pos;
+
+	QList<PathItem*> paths(visiblePaths());
+	for (int i = 0; i < paths.size(); i++)
+		paths.at(i)->setMarkerPosition(pos);
 }
 
 void MapView::reloadMap()
 {
+	_repaintTimer->stop();
 	_scene->invalidate();
 }
 
+/* The tiles of the parallel jobs finish shortly one after another, the
+   repaints are coalesced to at most one per (60Hz) display frame */
+void MapView::tilesLoaded()
+{
+	if (!_repaintTimer->isActive())
+		_repaintTimer->start(REPAINT_INTERVAL);
+}
+
+/* While the view is being panned/zoomed, the maps render draft (without hill
+   shading) tiles. Only makes a difference when the hill shading is on. */
+void MapView::interaction()
+{
+	if (!(_hillShading && _map->hillShading()))
+		return;
+
+	_interactive = true;
+	_interactionTimer->start(INTERACTION_IDLE);
+}
+
+/* Refine the draft tiles rendered during the interaction */
+void MapView::interactionFinished()
+{
+	_interactive = false;
+	reloadMap();
+}
+
+void MapView::prefetch()
+{
+	QRectF vr(mapToScene(viewport()->rect()).boundingRect());
+	Map::Flags flags = _opengl ? Map::OpenGL : Map::NoFlags;
+	if (_hillShading)
+		flags |= Map::HillShading;
+
+	if (_showMap)
+		_map->prefetch(vr.intersected(_map->bounds()), flags);
+}
+
 void MapView::setMapConfig(const Projection &in, const Projection &out,
   bool hidpi)
 {
@@ -1388,6 +1882,7 @@ void MapView::setMapConfig(const Projection &in, const Projection &out,
 	_outputProjection = out;
 	_hidpi = hidpi;
 
+	unloadMaps();
 	setMap(_map);
 }
 
@@ -1395,6 +1890,7 @@ void MapView::setDevicePixelRatio(qreal ratio)
 {
 	_deviceRatio = ratio;
 
+	unloadMaps();
 	setMap(_map);
 }
 
@@ -1506,10 +2002,9 @@ void MapView::setHidpi(bool hidpi)
 {
 	_hidpi = hidpi;
 
-	QRectF vr(mapToScene(viewport()->rect()).boundingRect()
-	  .intersected(_map->bounds()));
-	RectC cr(_map->xy2ll(vr.topLeft()), _map->xy2ll(vr.bottomRight()));
+	RectC cr(visibleRect());
 
+	unloadMaps();
 	_map->unload();
 	_map->load(_inputProjection, _outputProjection, _deviceRatio, _hidpi,
 	  _style, _layer);
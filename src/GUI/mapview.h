@@ -4,12 +4,14 @@
 #include <QGraphicsView>
 #include <QVector>
 #include <QHash>
+#include <QSet>
 #include <QList>
 #include <QFlags>
+#include <QPointer>
 #include "common/rectc.h"
+#include "common/rtree.h"
 #include "data/waypoint.h"
 #include "map/projection.h"
-#include "searchpointer.h"
 #include "units.h"
 #include "format.h"
 #include "markerinfoitem.h"
@@ -22,6 +24,7 @@ class QGeoPositionInfoSource;
 class QGeoPositionInfo;
 class QGestureEvent;
 class QPinchGesture;
+class QTimer;
 class Data;
 class POI;
 class Map;
@@ -30,6 +33,7 @@ class Route;
 class TrackItem;
 class RouteItem;
 class WaypointItem;
+class ClusterItem;
 class ScaleItem;
 class CoordinatesItem;
 class PathItem;
@@ -40,6 +44,7 @@ class Area;
 class QTimeZone;
 class MapAction;
 class CrosshairItem;
+class HeatmapItem;
 class MotionInfoItem;
 
 class MapView : public QGraphicsView
@@ -56,7 +61,16 @@ public:
 
 	MapView(Map *map, POI *poi, QWidget *parent = 0);
 
-	QList<PathItem *> loadData(const Data &data);
+	QList<PathItem *> loadData(const Data &data,
+	  QList<QGraphicsItem*> *items = 0);
+	void unloadData(const QList<QGraphicsItem*> &items);
+	void appendTrack(PathItem *item, const Track &track, int from);
+	void setPreview(const Track &track);
+	void clearPreview();
+	void appendWaypoints(const QVector<Waypoint> &waypoints,
+	  QList<QGraphicsItem*> *items = 0);
+	void beginLoad();
+	void endLoad();
 	void loadMaps(const QList<MapAction*> &maps);
 	void loadDEMs(const QList<Area> &dems);
 
@@ -101,7 +115,10 @@ public:
 	void selectLayer(int layer);
 
 	RectC boundingRect() const;
+	RectC visibleRect() const;
+	QList<RectC> corridor(qreal radius) const;
 	const Projection &inputProjection() const {return _inputProjection;}
+	const Projection &outputProjection() const {return _outputProjection;}
 
 #ifdef Q_OS_ANDROID
 signals:
@@ -117,6 +134,7 @@ public slots:
 	void showCursorCoordinates(bool show);
 	void showPositionCoordinates(bool show);
 	void showTicks(bool show);
+	void showHeatmap(bool show);
 	void showMarkers(bool show);
 	void showMarkerInfo(MarkerInfoItem::Type type);
 	void showOverlappedPOIs(bool show);
@@ -137,32 +155,46 @@ public slots:
 private slots:
 	void updatePOI();
 	void reloadMap();
+	void tilesLoaded();
+	void prefetch();
+	void interactionFinished();
 	void updatePosition(const QGeoPositionInfo &pos);
 
 private:
-	typedef QHash<SearchPointer<Waypoint>, WaypointItem*> POIHash;
+	typedef RTree<PathItem*, qreal, 2> PathTree;
 
 	PathItem *addTrack(const Track &track);
 	PathItem *addRoute(const Route &route);
 	MapItem *addMap(MapAction *map);
-	void addArea(const Area &area);
-	void addWaypoints(const QVector<Waypoint> &waypoints);
+	PlaneItem *addArea(const Area &area);
+	void addWaypoints(const QVector<Waypoint> &waypoints,
+	  QList<QGraphicsItem*> *items = 0);
 	void addPOI(const QList<Waypoint> &waypoints);
+	void indexPath(PathItem *item);
+	void unindexPath(PathItem *item, const RectC &bounds);
+	QList<PathItem*> visiblePaths() const;
+	void updateMarkers(const QList<PathItem*> &paths);
 	void loadPOI();
 	void clearPOI();
 
 	int fitMapZoom() const;
 	QPointF contentCenter() const;
 	void rescale();
+	void fitLoadedContent(int zoom);
 	void centerOn(const QPointF &pos);
 	void zoom(int zoom, const QPoint &pos, bool shift);
 	void digitalZoom(int zoom);
 	void updatePOIVisibility();
+	void createPOIItems();
+	void addPOIItem(const Waypoint &waypoint);
+	void clearPOIItems();
+	void updateWaypointsCache();
 	bool gestureEvent(QGestureEvent *event);
 	void pinchGesture(QPinchGesture *gesture);
 	void skipColor() {_palette.nextColor();}
 	void setHidpi(bool hidpi);
 	void updateLegend();
+	void interaction();
 
 	void mouseMoveEvent(QMouseEvent *event);
 	void mousePressEvent(QMouseEvent *event);
@@ -178,21 +210,47 @@ private:
 	void scrollContentsBy(int dx, int dy);
 
 	GraphicsScene *_scene;
+	QTimer *_repaintTimer;
+	QTimer *_prefetchTimer;
+	QTimer *_interactionTimer;
 	ScaleItem *_mapScale;
 	CoordinatesItem *_cursorCoordinates, *_positionCoordinates;
 	CrosshairItem *_crosshair;
+	HeatmapItem *_heatmap;
 	MotionInfoItem *_motionInfo;
 	LegendItem *_legend;
 	QList<TrackItem*> _tracks;
+	TrackItem *_preview;
 	QList<RouteItem*> _routes;
 	QList<WaypointItem*> _waypoints;
 	QList<PlaneItem*> _areas;
-	POIHash _pois;
+	QSet<Waypoint> _pois;
+	QList<WaypointItem*> _poiItems;
+	QList<ClusterItem*> _clusters;
 
 	RectC _tr, _rr, _wr, _ar;
+	PathTree _pathIndex;
+	qreal _markerPos;
 	qreal _res;
 
+	/* Inactive maps kept loaded, most recently used first */
+	struct LoadedMap {
+		LoadedMap(Map *map, const Projection &in, const Projection &out,
+		  qreal ratio, bool hidpi, int style, int layer);
+
+		QPointer<Map> map;
+		Projection in, out;
+		qreal ratio;
+		bool hidpi;
+		int style, layer;
+	};
+
+	void keepLoaded(Map *map);
+	bool takeLoaded(Map *map);
+	void unloadMaps();
+
 	Map *_map;
+	QList<LoadedMap> _loadedMaps;
 	POI *_poi;
 	QGeoPositionInfoSource *_positionSource;
 
@@ -203,7 +261,7 @@ private:
 	bool _showMap, _showTracks, _showRoutes, _showAreas, _showWaypoints,
 	  _showWaypointLabels, _showPOI, _showPOILabels, _showRouteWaypoints,
 	  _showMarkers, _showPathTicks, _showPOIIcons, _showWaypointIcons,
-	  _showPosition, _showPositionCoordinates, _showMotionInfo;
+	  _showPosition, _showPositionCoordinates, _showMotionInfo, _showHeatmap;
 	MarkerInfoItem::Type _markerInfoType;
 	bool _overlapPOIs, _followPosition;
 	int _trackWidth, _routeWidth, _areaWidth;
@@ -218,7 +276,11 @@ private:
 	int _layer;
 
 	int _digitalZoom;
+	QGraphicsItem::CacheMode _waypointsCache;
 	bool _plot;
+	bool _interactive;
+	bool _loading;
+	int _loadZoom;
 	QCursor _cursor;
 
 	qreal _deviceRatio;
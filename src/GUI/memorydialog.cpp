@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <QVBoxLayout>
+#include <QDialogButtonBox>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QHeaderView>
+#include <QLocale>
+#include "memorydialog.h"
+
+
+static bool sizeGreaterThan(const MemoryDialog::Item &i1,
+  const MemoryDialog::Item &i2)
+{
+	return i1.size > i2.size;
+}
+
+MemoryDialog::MemoryDialog(const QList<Item> &files, const QList<Item> &caches,
+  QWidget *parent) : QDialog(parent)
+{
+#ifdef Q_OS_ANDROID
+	setWindowFlags(Qt::Window);
+	setWindowState(Qt::WindowFullScreen);
+#endif /* Q_OS_ANDROID */
+
+	_tree = new QTreeWidget();
+	_tree->setColumnCount(2);
+	_tree->setHeaderLabels(QStringList() << tr("Item") << tr("Size"));
+	_tree->setSelectionMode(QAbstractItemView::ExtendedSelection);
+	_tree->setRootIsDecorated(false);
+	_tree->addTopLevelItem(addGroup(tr("Files"), files));
+	_tree->addTopLevelItem(addGroup(tr("Map caches"), caches));
+	_tree->expandAll();
+	_tree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+	_tree->header()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
+	_tree->header()->setStretchLastSection(false);
+	connect(_tree, &QTreeWidget::itemSelectionChanged, this,
+	  &MemoryDialog::selectionChanged);
+
+	QDialogButtonBox *buttonBox = new QDialogButtonBox();
+	_unloadButton = buttonBox->addButton(tr("Unload"),
+	  QDialogButtonBox::AcceptRole);
+	_unloadButton->setToolTip(tr("Close the selected files"));
+	_unloadButton->setEnabled(false);
+	buttonBox->addButton(QDialogButtonBox::Close);
+	connect(buttonBox, &QDialogButtonBox::accepted, this,
+	  &MemoryDialog::accept);
+	connect(buttonBox, &QDialogButtonBox::rejected, this,
+	  &MemoryDialog::reject);
+
+	QVBoxLayout *layout = new QVBoxLayout;
+	layout->addWidget(_tree);
+	layout->addWidget(buttonBox);
+	setLayout(layout);
+
+	setWindowTitle(tr("Memory"));
+	setWindowFlags(windowFlags() & ~Qt::WindowContextHelpButtonHint);
+	resize(480, 360);
+}
+
+/* The items are sorted by size so that the heaviest ones are on the top */
+QTreeWidgetItem *MemoryDialog::addGroup(const QString &name,
+  const QList<Item> &items)
+{
+	QList<Item> sorted(items);
+	QLocale l;
+	qint64 total = 0;
+
+	std::sort(sorted.begin(), sorted.end(), sizeGreaterThan);
+
+	QTreeWidgetItem *group = new QTreeWidgetItem();
+	group->setFlags(Qt::ItemIsEnabled);
+	for (int i = 0; i < sorted.size(); i++) {
+		const Item &item = sorted.at(i);
+		QTreeWidgetItem *ti = new QTreeWidgetItem(group, QStringList()
+		  << item.name << l.formattedDataSize(item.size));
+		ti->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+		ti->setData(0, Qt::UserRole, item.file);
+		if (item.file.isEmpty())
+			ti->setFlags(Qt::ItemIsEnabled);
+		total += item.size;
+	}
+
+	QFont font(group->font(0));
+	font.setBold(true);
+	group->setText(0, name);
+	group->setText(1, l.formattedDataSize(total));
+	group->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+	group->setFont(0, font);
+	group->setFont(1, font);
+
+	return group;
+}
+
+void MemoryDialog::selectionChanged()
+{
+	_unloadButton->setEnabled(!_tree->selectedItems().isEmpty());
+}
+
+void MemoryDialog::accept()
+{
+	QList<QTreeWidgetItem*> selected(_tree->selectedItems());
+
+	for (int i = 0; i < selected.size(); i++)
+		_unload.append(selected.at(i)->data(0, Qt::UserRole).toString());
+
+	QDialog::accept();
+}
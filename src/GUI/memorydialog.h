@@ -0,0 +1,48 @@
+#ifndef MEMORYDIALOG_H
+#define MEMORYDIALOG_H
+
+#include <QDialog>
+#include <QStringList>
+
+class QTreeWidget;
+class QTreeWidgetItem;
+class QPushButton;
+
+class MemoryDialog : public QDialog
+{
+	Q_OBJECT
+
+public:
+	struct Item
+	{
+		Item() : size(0) {}
+		Item(const QString &name, qint64 size, const QString &file = QString())
+		  : name(name), file(file), size(size) {}
+
+		QString name;
+		/* The path of the file the item can be unloaded with, if any */
+		QString file;
+		qint64 size;
+	};
+
+	MemoryDialog(const QList<Item> &files, const QList<Item> &caches,
+	  QWidget *parent = 0);
+
+	/* The files selected for unloading */
+	const QStringList &files() const {return _unload;}
+
+public slots:
+	void accept();
+
+private slots:
+	void selectionChanged();
+
+private:
+	QTreeWidgetItem *addGroup(const QString &name, const QList<Item> &items);
+
+	QTreeWidget *_tree;
+	QPushButton *_unloadButton;
+	QStringList _unload;
+};
+
+#endif // MEMORYDIALOG_H
@@ -15,6 +15,7 @@
 #include <QButtonGroup>
 #include <QGeoPositionInfoSource>
 #include "map/pcs.h"
+#include "data/track.h"
 #include "icons.h"
 #include "infolabel.h"
 #include "colorbox.h"
@@ -333,7 +334,13 @@ QWidget *OptionsDialog::createAppearancePage()
 
 QWidget *OptionsDialog::createDataPage()
 {
-	QString filterToolTip = tr("Moving average window size");
+	QString filterToolTip = tr("Filter window size");
+
+	_filterType = new QComboBox();
+	_filterType->addItem(tr("Moving average"), Track::MovingAverage);
+	_filterType->addItem(tr("Median"), Track::Median);
+	_filterType->addItem(tr("Gaussian"), Track::Gaussian);
+	_filterType->setCurrentIndex(_filterType->findData(_options.filterType));
 
 	_elevationFilter = new OddSpinBox();
 	_elevationFilter->setValue(_options.elevationFilter);
@@ -358,6 +365,7 @@ QWidget *OptionsDialog::createDataPage()
 	QWidget *filterTab = new QWidget();
 	QFormLayout *filterTabLayout = new QFormLayout();
 	filterTabLayout->addWidget(new QLabel(tr("Smoothing")));
+	filterTabLayout->addRow(tr("Filter:"), _filterType);
 	filterTabLayout->addRow(tr("Elevation:"), _elevationFilter);
 	filterTabLayout->addRow(tr("Speed:"), _speedFilter);
 	filterTabLayout->addRow(tr("Heart rate:"), _heartRateFilter);
@@ -368,6 +376,7 @@ QWidget *OptionsDialog::createDataPage()
 	filterTab->setLayout(filterTabLayout);
 #else // Q_OS_MAC
 	QFormLayout *smoothLayout = new QFormLayout();
+	smoothLayout->addRow(tr("Filter:"), _filterType);
 	smoothLayout->addRow(tr("Elevation:"), _elevationFilter);
 	smoothLayout->addRow(tr("Speed:"), _speedFilter);
 	smoothLayout->addRow(tr("Heart rate:"), _heartRateFilter);
@@ -772,6 +781,10 @@ QWidget *OptionsDialog::createSystemPage()
 	_useOpenGL->setChecked(_options.useOpenGL);
 	_enableHTTP2 = new QCheckBox(tr("Enable HTTP/2"));
 	_enableHTTP2->setChecked(_options.enableHTTP2);
+	_revalidateCache = new QCheckBox(tr("Revalidate cached tiles"));
+	_revalidateCache->setChecked(_options.revalidateCache);
+	_revalidateCache->setToolTip(tr("Check the expired cached map tiles and "
+	  "DEM files for updates using conditional HTTP requests"));
 
 	_pixmapCache = new QSpinBox();
 	_pixmapCache->setMinimum(64);
@@ -779,12 +792,70 @@ QWidget *OptionsDialog::createSystemPage()
 	_pixmapCache->setSuffix(UNIT_SPACE + tr("MB"));
 	_pixmapCache->setValue(_options.pixmapCache);
 
+	_tileImageCache = new QSpinBox();
+	_tileImageCache->setMinimum(16);
+	_tileImageCache->setMaximum(2048);
+	_tileImageCache->setSuffix(UNIT_SPACE + tr("MB"));
+	_tileImageCache->setValue(_options.tileImageCache);
+	_tileImageCache->setToolTip(tr("Size of the in-memory cache of the "
+	  "decoded map tiles (per map)"));
+
 	_demCache = new QSpinBox();
 	_demCache->setMinimum(64);
 	_demCache->setMaximum(4096);
 	_demCache->setSuffix(UNIT_SPACE + tr("MB"));
 	_demCache->setValue(_options.demCache);
 
+	_imgCache = new QSpinBox();
+	_imgCache->setMinimum(16);
+	_imgCache->setMaximum(4096);
+	_imgCache->setSuffix(UNIT_SPACE + tr("MB"));
+	_imgCache->setValue(_options.imgCache);
+	_imgCache->setToolTip(tr("Size of the in-memory cache of the decoded "
+	  "Garmin IMG map data (per map)"));
+
+	_dataCache = new QSpinBox();
+	_dataCache->setMinimum(0);
+	_dataCache->setMaximum(16384);
+	_dataCache->setSuffix(UNIT_SPACE + tr("MB"));
+	_dataCache->setSpecialValueText(tr("Disabled"));
+	_dataCache->setValue(_options.dataCache);
+	_dataCache->setToolTip(tr("Size of the on-disk cache of the parsed data "
+	  "files"));
+
+	_tileCache = new QSpinBox();
+	_tileCache->setMinimum(0);
+	_tileCache->setMaximum(65536);
+	_tileCache->setSuffix(UNIT_SPACE + tr("MB"));
+	_tileCache->setSpecialValueText(tr("Unlimited"));
+	_tileCache->setValue(_options.tileCache);
+	_tileCache->setToolTip(tr("Size of the on-disk cache of the downloaded "
+	  "tiles (per map)"));
+
+	_prefetchRing = new QSpinBox();
+	_prefetchRing->setMinimum(0);
+	_prefetchRing->setMaximum(4);
+	_prefetchRing->setSpecialValueText(tr("Disabled"));
+	_prefetchRing->setValue(_options.prefetchRing);
+	_prefetchRing->setToolTip(tr("Number of the online map tiles rows/columns "
+	  "around the visible area that are downloaded in advance"));
+
+	_renderThreads = new QSpinBox();
+	_renderThreads->setMinimum(0);
+	_renderThreads->setMaximum(256);
+	_renderThreads->setSpecialValueText(tr("Automatic"));
+	_renderThreads->setValue(_options.renderThreads);
+	_renderThreads->setToolTip(tr("Number of the map tiles rendering threads, "
+	  "automatic uses all the CPU cores"));
+
+	_parseThreads = new QSpinBox();
+	_parseThreads->setMinimum(0);
+	_parseThreads->setMaximum(256);
+	_parseThreads->setSpecialValueText(tr("Automatic"));
+	_parseThreads->setValue(_options.parseThreads);
+	_parseThreads->setToolTip(tr("Number of the data files loading threads, "
+	  "automatic uses all the CPU cores"));
+
 	_connectionTimeout = new QSpinBox();
 	_connectionTimeout->setMinimum(30);
 	_connectionTimeout->setMaximum(120);
@@ -795,18 +866,34 @@ QWidget *OptionsDialog::createSystemPage()
 	QWidget *systemTab = new QWidget();
 	QFormLayout *systemTabLayout = new QFormLayout();
 	systemTabLayout->addRow(tr("Image cache size:"), _pixmapCache);
+	systemTabLayout->addRow(tr("Tile image cache size:"), _tileImageCache);
 	systemTabLayout->addRow(tr("DEM cache size:"), _demCache);
+	systemTabLayout->addRow(tr("IMG cache size:"), _imgCache);
+	systemTabLayout->addRow(tr("Data cache size:"), _dataCache);
+	systemTabLayout->addRow(tr("Tile cache size:"), _tileCache);
+	systemTabLayout->addRow(tr("Tiles prefetch:"), _prefetchRing);
+	systemTabLayout->addRow(tr("Render threads:"), _renderThreads);
+	systemTabLayout->addRow(tr("Data loading threads:"), _parseThreads);
 	systemTabLayout->addRow(tr("Connection timeout:"), _connectionTimeout);
 	systemTabLayout->addWidget(_enableHTTP2);
+	systemTabLayout->addWidget(_revalidateCache);
 	systemTabLayout->addWidget(_useOpenGL);
 	systemTab->setLayout(systemTabLayout);
 #else // Q_OS_MAC
 	QFormLayout *formLayout = new QFormLayout();
 	formLayout->addRow(tr("Image cache size:"), _pixmapCache);
+	formLayout->addRow(tr("Tile image cache size:"), _tileImageCache);
 	formLayout->addRow(tr("DEM cache size:"), _demCache);
+	formLayout->addRow(tr("IMG cache size:"), _imgCache);
+	formLayout->addRow(tr("Data cache size:"), _dataCache);
+	formLayout->addRow(tr("Tile cache size:"), _tileCache);
+	formLayout->addRow(tr("Tiles prefetch:"), _prefetchRing);
+	formLayout->addRow(tr("Render threads:"), _renderThreads);
+	formLayout->addRow(tr("Data loading threads:"), _parseThreads);
 	formLayout->addRow(tr("Connection timeout:"), _connectionTimeout);
 	QFormLayout *checkboxLayout = new QFormLayout();
 	checkboxLayout->addWidget(_enableHTTP2);
+	checkboxLayout->addWidget(_revalidateCache);
 	checkboxLayout->addWidget(_useOpenGL);
 	QWidget *systemTab = new QWidget();
 	QVBoxLayout *systemTabLayout = new QVBoxLayout();
@@ -966,6 +1053,7 @@ void OptionsDialog::accept()
 	_options.heartRateFilter = _heartRateFilter->value();
 	_options.cadenceFilter = _cadenceFilter->value();
 	_options.powerFilter = _powerFilter->value();
+	_options.filterType = _filterType->currentData().toInt();
 	_options.outlierEliminate = _outlierEliminate->isChecked();
 	_options.detectPauses = _detectPauses->isChecked();
 	_options.automaticPause = _automaticPause->isChecked();
@@ -1009,8 +1097,16 @@ void OptionsDialog::accept()
 
 	_options.useOpenGL = _useOpenGL->isChecked();
 	_options.enableHTTP2 = _enableHTTP2->isChecked();
+	_options.revalidateCache = _revalidateCache->isChecked();
 	_options.pixmapCache = _pixmapCache->value();
+	_options.tileImageCache = _tileImageCache->value();
 	_options.demCache = _demCache->value();
+	_options.imgCache = _imgCache->value();
+	_options.dataCache = _dataCache->value();
+	_options.tileCache = _tileCache->value();
+	_options.prefetchRing = _prefetchRing->value();
+	_options.renderThreads = _renderThreads->value();
+	_options.parseThreads = _parseThreads->value();
 	_options.connectionTimeout = _connectionTimeout->value();
 	_options.dataPath = _dataPath->dir();
 	_options.mapsPath = _mapsPath->dir();
@@ -55,6 +55,7 @@ struct Options {
 	int heartRateFilter;
 	int cadenceFilter;
 	int powerFilter;
+	int filterType;
 	bool outlierEliminate;
 	bool detectPauses;
 	bool automaticPause;
@@ -85,8 +86,16 @@ struct Options {
 	// System
 	bool useOpenGL;
 	bool enableHTTP2;
+	bool revalidateCache;
 	int pixmapCache;
+	int tileImageCache;
 	int demCache;
+	int imgCache;
+	int dataCache;
+	int tileCache;
+	int prefetchRing;
+	int renderThreads;
+	int parseThreads;
 	int connectionTimeout;
 	QString dataPath;
 	QString mapsPath;
@@ -163,6 +172,7 @@ private:
 	OddSpinBox *_heartRateFilter;
 	OddSpinBox *_cadenceFilter;
 	OddSpinBox *_powerFilter;
+	QComboBox *_filterType;
 	QCheckBox *_outlierEliminate;
 	QRadioButton *_automaticPause;
 	QRadioButton *_manualPause;
@@ -196,10 +206,18 @@ private:
 	PluginParameters *_pluginParameters;
 	// System
 	QSpinBox *_pixmapCache;
+	QSpinBox *_tileImageCache;
 	QSpinBox *_demCache;
+	QSpinBox *_imgCache;
+	QSpinBox *_dataCache;
+	QSpinBox *_tileCache;
+	QSpinBox *_prefetchRing;
+	QSpinBox *_renderThreads;
+	QSpinBox *_parseThreads;
 	QSpinBox *_connectionTimeout;
 	QCheckBox *_useOpenGL;
 	QCheckBox *_enableHTTP2;
+	QCheckBox *_revalidateCache;
 	DirSelectWidget *_dataPath;
 	DirSelectWidget *_mapsPath;
 	DirSelectWidget *_poiPath;
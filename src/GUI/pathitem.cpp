@@ -1,6 +1,7 @@
 #include <cmath>
 #include <QCursor>
 #include <QPainter>
+#include <QStyleOptionGraphicsItem>
 #include <QGraphicsSceneMouseEvent>
 #include "common/greatcircle.h"
 #include "map/map.h"
@@ -11,6 +12,7 @@
 #include "pathitem.h"
 
 #define GEOGRAPHICAL_MILE 1855.3248
+#define CHUNK_SIZE        256
 
 Units PathItem::_units = Metric;
 QTimeZone PathItem::_timeZone = QTimeZone::utc();
@@ -25,12 +27,50 @@ static inline unsigned segments(qreal distance)
 	return ceil(distance / GEOGRAPHICAL_MILE);
 }
 
+struct HitCTX
+{
+	HitCTX(const QVector<QLineF> &lines, const QPointF &point, qreal dist)
+	  : lines(lines), point(point), tolerance2(dist * dist), hit(false) {}
+
+	const QVector<QLineF> &lines;
+	const QPointF &point;
+	qreal tolerance2;
+	bool hit;
+};
+
+static qreal dist2(const QLineF &line, const QPointF &p)
+{
+	QPointF d(line.p2() - line.p1());
+	QPointF v(p - line.p1());
+	qreal l2 = d.x() * d.x() + d.y() * d.y();
+	qreal t = l2 > 0 ? qMax(0.0, qMin(1.0, (v.x() * d.x() + v.y() * d.y())
+	  / l2)) : 0;
+	QPointF r(v - t * d);
+
+	return r.x() * r.x() + r.y() * r.y();
+}
+
+static bool hitCb(int data, void *context)
+{
+	HitCTX *ctx = (HitCTX*)context;
+
+	if (dist2(ctx->lines.at(data), ctx->point) <= ctx->tolerance2) {
+		ctx->hit = true;
+		return false;
+	}
+
+	return true;
+}
+
 PathItem::PathItem(const Path &path, Map *map, QGraphicsItem *parent)
-  : GraphicsItem(parent), _path(path), _map(map), _graph(0)
+  : GraphicsItem(parent), _path(path), _lod(path), _bounds(path.boundingRect()),
+  _map(map), _graph(0), _graphIndex(-1)
 {
 	Q_ASSERT(_path.isValid());
 
 	_digitalZoom = 0;
+	_segmentHint = 0;
+	_pointHint = 0;
 	_width = 3;
 	_color = Qt::black;
 	_penStyle = Qt::SolidLine;
@@ -40,11 +80,14 @@ PathItem::PathItem(const Path &path, Map *map, QGraphicsItem *parent)
 
 	_pen = QPen(color(), width());
 
+	_ticks = new PathTickItem(this);
+
 	updatePainterPath();
 	updateShape();
 	updateTicks();
 
 	_markerDistance = _path.first().first().distance();
+	_markerPos = NAN;
 	_marker = new MarkerItem(this);
 	_marker->setZValue(1);
 	_marker->setPos(position(_markerDistance));
@@ -53,16 +96,128 @@ PathItem::PathItem(const Path &path, Map *map, QGraphicsItem *parent)
 
 	setCursor(Qt::ArrowCursor);
 	setAcceptHoverEvents(true);
+	setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+qreal PathItem::strokeWidth() const
+{
+	return (_width + 1) * pow(2, -_digitalZoom);
+}
+
+QRectF PathItem::chunkRect(int i) const
+{
+	qreal w = strokeWidth() / 2.0;
+	return _chunks.at(i).bounds.adjusted(-w, -w, w, w);
+}
+
+const QPainterPath &PathItem::chunkShape(int i) const
+{
+	const Chunk &chunk = _chunks.at(i);
+
+	if (chunk.shape.isEmpty()) {
+		QPainterPathStroker s;
+		s.setWidth(strokeWidth());
+		chunk.shape = s.createStroke(chunk.path);
+	}
+
+	return chunk.shape;
 }
 
 void PathItem::updateShape()
 {
-	QPainterPathStroker s;
-	s.setWidth((_width + 1) * pow(2, -_digitalZoom));
-	_shape = s.createStroke(_painterPath);
+	_boundingRect = QRectF();
+
+	for (int i = 0; i < _chunks.size(); i++) {
+		_chunks[i].shape = QPainterPath();
+		_boundingRect |= chunkRect(i);
+	}
+}
+
+QPainterPath PathItem::shape() const
+{
+	QPainterPath shape;
+
+	for (int i = 0; i < _chunks.size(); i++)
+		shape.addPath(chunkShape(i));
+
+	return shape;
 }
 
-bool PathItem::addSegment(const Coordinates &c1, const Coordinates &c2)
+void PathItem::updateLineTree() const
+{
+	for (int i = 0; i < _chunks.size(); i++) {
+		const QPainterPath &path = _chunks.at(i).path;
+
+		for (int j = 1; j < path.elementCount(); j++) {
+			const QPainterPath::Element &e = path.elementAt(j);
+			if (!e.isLineTo())
+				continue;
+			const QPainterPath::Element &p = path.elementAt(j - 1);
+			QLineF line(p.x, p.y, e.x, e.y);
+			qreal min[2], max[2];
+
+			min[0] = qMin(line.x1(), line.x2());
+			min[1] = qMin(line.y1(), line.y2());
+			max[0] = qMax(line.x1(), line.x2());
+			max[1] = qMax(line.y1(), line.y2());
+			_lineTree.Insert(min, max, _lines.size());
+			_lines.append(line);
+		}
+	}
+
+	_lines.squeeze();
+	_lineTree.Pack();
+}
+
+/* The (hover) hit-test is a search in the line segments index with the half
+   stroke width tolerance instead of testing the stroked chunk shapes. */
+bool PathItem::contains(const QPointF &point) const
+{
+	if (!_boundingRect.contains(point))
+		return false;
+	if (_lines.isEmpty())
+		updateLineTree();
+
+	qreal w = strokeWidth() / 2.0;
+	qreal min[2], max[2];
+	HitCTX ctx(_lines, point, w);
+
+	min[0] = point.x() - w;
+	min[1] = point.y() - w;
+	max[0] = point.x() + w;
+	max[1] = point.y() + w;
+	_lineTree.Search(min, max, hitCb, &ctx);
+
+	return ctx.hit;
+}
+
+bool PathItem::collidesWithPath(const QPainterPath &path,
+  Qt::ItemSelectionMode mode) const
+{
+	if (mode != Qt::IntersectsItemShape)
+		return QGraphicsItem::collidesWithPath(path, mode);
+
+	QRectF rect(path.controlPointRect());
+	for (int i = 0; i < _chunks.size(); i++)
+		if (chunkRect(i).intersects(rect) && path.intersects(chunkShape(i)))
+			return true;
+
+	return false;
+}
+
+void PathItem::addChunk()
+{
+	const QPainterPath::Element &e = _painterPath.elementAt(
+	  _painterPath.elementCount() - 1);
+	QPointF last(e.x, e.y);
+
+	_chunks.append(Chunk(_painterPath));
+	_painterPath = QPainterPath();
+	_painterPath.moveTo(last);
+}
+
+bool PathItem::addSegment(const Coordinates &c1, const Coordinates &c2,
+  const QPointF &p2)
 {
 	if (fabs(c1.lon() - c2.lon()) > 180.0) {
 		// Split segment on date line crossing
@@ -83,65 +238,186 @@ bool PathItem::addSegment(const Coordinates &c1, const Coordinates &c2)
 			_painterPath.lineTo(_map->ll2xy(Coordinates(-180, p.y())));
 			_painterPath.moveTo(_map->ll2xy(Coordinates(180, p.y())));
 		}
-		_painterPath.lineTo(_map->ll2xy(c2));
+		_painterPath.lineTo(p2);
 
 		return true;
 	} else {
-		QPointF p(_map->ll2xy(c2));
 		const QPainterPath::Element &e = _painterPath.elementAt(
 		  _painterPath.elementCount() - 1);
-		qreal dx = qAbs(p.x() - e.x);
-		qreal dy = qAbs(p.y() - e.y);
+		qreal dx = qAbs(p2.x() - e.x);
+		qreal dy = qAbs(p2.y() - e.y);
 
 		if (dx >= 1.0 || dy >= 1.0) {
-			_painterPath.lineTo(p);
+			_painterPath.lineTo(p2);
 			return true;
 		} else
 			return false;
 	}
 }
 
+qreal PathItem::tolerance() const
+{
+	QRectF rect(_map->ll2xy(_bounds.topLeft()),
+	  _map->ll2xy(_bounds.bottomRight()));
+	QPointF c(rect.center());
+	qreal s = qMax(qAbs(rect.width()), qAbs(rect.height())) / 2.0;
+
+	/* Half a pixel in meters, the max error of the simplified path */
+	return _map->resolution(QRectF(c - QPointF(s, s), c + QPointF(s, s)))
+	  / 2.0;
+}
+
+/* The great circle points do not depend on the map projection or zoom, so
+   they are computed only once for every (level of detail) segment and only
+   reprojected on the following updates. */
+const QVector<Coordinates> &PathItem::greatCircle(int segment,
+  const PathPoint *p1, const PathPoint *p2, qreal dist)
+{
+	const PathPoint *data = _path.at(segment).constData();
+	GCCache &cache = _gcCache[segment];
+	GCKey key(p1 - data, p2 - data);
+	GCCache::iterator it = cache.find(key);
+
+	if (it == cache.end()) {
+		GreatCircle gc(p1->coordinates(), p2->coordinates());
+		unsigned n = segments(dist);
+		QVector<Coordinates> points;
+
+		points.reserve(n - 1);
+		for (unsigned k = 1; k < n; k++)
+			points.append(gc.pointAt(k/(double)n));
+		it = cache.insert(key, points);
+	}
+
+	return *it;
+}
+
+/* Adds the points from..size-1 of the (level of detail) segment to the
+   painter path, xy are the projected points starting with point from-1 */
+void PathItem::addPoints(int i, const QVector<int> *lod, int from, int size,
+  const QVector<QPointF> &xy)
+{
+	const PathSegment &segment = _path.at(i);
+	const PathPoint *p1 = &segment.at(lod ? lod->at(from - 1) : from - 1);
+	QVector<QPointF> gcxy;
+
+	for (int j = from; j < size; j++) {
+		const PathPoint *p2 = &segment.at(lod ? lod->at(j) : j);
+		const QPointF &p = xy.at(j - from + 1);
+		double dist = p2->distance() - p1->distance();
+
+		if (dist > GEOGRAPHICAL_MILE) {
+			const QVector<Coordinates> &gc = greatCircle(i, p1, p2, dist);
+			Coordinates last(p1->coordinates());
+
+			gcxy.resize(gc.size());
+			_map->ll2xy(gc.constData(), gcxy.data(), gc.size());
+			for (int k = 0; k < gc.size(); k++) {
+				addSegment(last, gc.at(k), gcxy.at(k));
+				last = gc.at(k);
+			}
+			addSegment(last, p2->coordinates(), p);
+			p1 = p2;
+		} else {
+			if (addSegment(p1->coordinates(), p2->coordinates(), p))
+				p1 = p2;
+		}
+
+		if (_painterPath.elementCount() >= CHUNK_SIZE)
+			addChunk();
+	}
+}
+
 void PathItem::updatePainterPath()
 {
+	qreal tol = tolerance();
+	QVector<Coordinates> ll;
+	QVector<QPointF> xy;
+
+	_chunks.clear();
+	_lines.clear();
+	_lineTree.RemoveAll();
 	_painterPath = QPainterPath();
+	_gcCache.resize(_path.size());
 
 	for (int i = 0; i < _path.size(); i++) {
 		const PathSegment &segment = _path.at(i);
-		const PathPoint *p1 = &segment.first();
+		const QVector<int> *lod = _lod.indexes(i, tol);
+		int size = lod ? lod->size() : segment.size();
+
+		/* Project all the (level of detail) segment points at once */
+		ll.resize(size);
+		xy.resize(size);
+		for (int j = 0; j < size; j++)
+			ll[j] = segment.at(lod ? lod->at(j) : j).coordinates();
+		_map->ll2xy(ll.constData(), xy.data(), size);
+
+		_painterPath.moveTo(xy.first());
+		addPoints(i, lod, 1, size, xy);
+	}
 
-		_painterPath.moveTo(_map->ll2xy(p1->coordinates()));
+	if (_painterPath.elementCount() > 1)
+		_chunks.append(Chunk(_painterPath));
+	_painterPath = QPainterPath();
+}
 
-		for (int j = 1; j < segment.size(); j++) {
-			const PathPoint *p2 = &segment.at(j);
-			double dist = p2->distance() - p1->distance();
+/* Live data - the points are appended to the last path segment and only the
+   painter path chunks of the new points are created. */
+void PathItem::append(const Path &path)
+{
+	PathSegment &segment = _path.last();
+	int from = segment.size();
 
-			if (dist > GEOGRAPHICAL_MILE) {
-				GreatCircle gc(p1->coordinates(), p2->coordinates());
-				Coordinates last(p1->coordinates());
-				unsigned n = segments(dist);
+	for (int i = 0; i < path.size(); i++)
+		segment += path.at(i);
+	if (segment.size() == from)
+		return;
 
-				for (unsigned k = 1; k <= n; k++) {
-					Coordinates c(gc.pointAt(k/(double)n));
-					addSegment(last, c);
-					last = c;
-				}
-				p1 = p2;
-			} else {
-				if (addSegment(p1->coordinates(), p2->coordinates()))
-					p1 = p2;
-			}
-		}
-	}
+	for (int j = from; j < segment.size(); j++)
+		_bounds = _bounds.united(segment.at(j).coordinates());
+	_lod.append(_path.size() - 1, from, segment.size());
+
+	QVector<Coordinates> ll(segment.size() - from + 1);
+	QVector<QPointF> xy(ll.size());
+	for (int j = 0; j < ll.size(); j++)
+		ll[j] = segment.at(from - 1 + j).coordinates();
+	_map->ll2xy(ll.constData(), xy.data(), ll.size());
+
+	prepareGeometryChange();
+
+	int chunks = _chunks.size();
+	_painterPath = QPainterPath();
+	_painterPath.moveTo(xy.first());
+	addPoints(_path.size() - 1, 0, from, segment.size(), xy);
+	if (_painterPath.elementCount() > 1)
+		_chunks.append(Chunk(_painterPath));
+	_painterPath = QPainterPath();
+
+	for (int i = chunks; i < _chunks.size(); i++)
+		_boundingRect |= chunkRect(i);
+	_lines.clear();
+	_lineTree.RemoveAll();
+
+	if (_showTicks)
+		updateTicks();
 }
 
 void PathItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
 	  QWidget *widget)
 {
-	Q_UNUSED(option);
 	Q_UNUSED(widget);
 
+	/* When plotting (QGraphicsView::render()) the exposed rect is the whole
+	   item, so the chunks are culled with the painter clip (the page) too.
+	   Only the chunks visible on the page get into the PDF/print output. */
+	QRectF exposed(option->exposedRect);
+	if (painter->hasClipping())
+		exposed &= painter->clipBoundingRect();
+
 	painter->setPen(_pen);
-	painter->drawPath(_painterPath);
+	for (int i = 0; i < _chunks.size(); i++)
+		if (chunkRect(i).intersects(exposed))
+			painter->drawPath(_chunks.at(i).path);
 
 /*
 	painter->setPen(Qt::red);
@@ -182,8 +458,7 @@ void PathItem::updateColor()
 
 	_pen.setColor(c);
 
-	for (int i = 0; i < _ticks.size(); i++)
-		_ticks[i]->setColor(c);
+	_ticks->setColor(c);
 
 	update();
 }
@@ -237,8 +512,7 @@ void PathItem::setDigitalZoom(int zoom)
 	_digitalZoom = zoom;
 	_pen.setWidthF(width() * pow(2, -_digitalZoom));
 	_marker->setScale(pow(2, -_digitalZoom));
-	for (int i = 0; i < _ticks.size(); i++)
-		_ticks.at(i)->setDigitalZoom(zoom);
+	_ticks->setDigitalZoom(zoom);
 
 	updateShape();
 }
@@ -258,11 +532,28 @@ void PathItem::updateStyle()
 
 const PathSegment *PathItem::segment(qreal x) const
 {
-	for (int i = 0; i < _path.size(); i++)
-		if (x <= _path.at(i).last().distance())
-			return &(_path.at(i));
+	if (_path.isEmpty() || x > _path.last().last().distance())
+		return 0;
+
+	if (_segmentHint < _path.size() && x <= _path.at(_segmentHint).last()
+	  .distance() && (!_segmentHint || x > _path.at(_segmentHint - 1).last()
+	  .distance()))
+		return &(_path.at(_segmentHint));
+
+	int low = 0;
+	int high = _path.size() - 1;
+
+	while (low < high) {
+		int mid = low + ((high - low) / 2);
+		if (_path.at(mid).last().distance() < x)
+			low = mid + 1;
+		else
+			high = mid;
+	}
 
-	return 0;
+	_segmentHint = low;
+
+	return &(_path.at(low));
 }
 
 QPointF PathItem::position(qreal x) const
@@ -271,34 +562,38 @@ QPointF PathItem::position(qreal x) const
 	if (!seg)
 		return QPointF(NAN, NAN);
 
-	int low = 0;
-	int high = seg->count() - 1;
-	int mid = 0;
-
 	if (!(x >= seg->first().distance() && x <= seg->last().distance()))
 		return QPointF(NAN, NAN);
 
-	while (low <= high) {
-		mid = low + ((high - low) / 2);
-		qreal val = seg->at(mid).distance();
-		if (val > x)
-			high = mid - 1;
-		else if (val < x)
-			low = mid + 1;
-		else
-			return _map->ll2xy(seg->at(mid).coordinates());
+	/* Marker/slider moves are mostly continuous, so try the last hit point
+	   interval first before falling back to the binary search */
+	int i;
+	if (_pointHint < seg->size() - 1 && seg->at(_pointHint).distance() <= x
+	  && x < seg->at(_pointHint + 1).distance())
+		i = _pointHint;
+	else {
+		int low = 0;
+		int high = seg->size() - 1;
+
+		while (low < high) {
+			int mid = low + ((high - low + 1) / 2);
+			if (seg->at(mid).distance() > x)
+				high = mid - 1;
+			else
+				low = mid;
+		}
+
+		i = low;
+		_pointHint = i;
 	}
 
-	Coordinates c1, c2;
-	qreal p1, p2;
+	if (seg->at(i).distance() == x)
+		return _map->ll2xy(seg->at(i).coordinates());
 
-	if (seg->at(mid).distance() < x) {
-		c1 = seg->at(mid).coordinates(); c2 = seg->at(mid+1).coordinates();
-		p1 = seg->at(mid).distance(); p2 = seg->at(mid+1).distance();
-	} else {
-		c1 = seg->at(mid-1).coordinates(); c2 = seg->at(mid).coordinates();
-		p1 = seg->at(mid-1).distance(); p2 = seg->at(mid).distance();
-	}
+	Coordinates c1(seg->at(i).coordinates());
+	Coordinates c2(seg->at(i+1).coordinates());
+	qreal p1 = seg->at(i).distance();
+	qreal p2 = seg->at(i+1).distance();
 
 	qreal dist = p2 - p1;
 
@@ -334,6 +629,7 @@ void PathItem::setMarkerPosition(qreal pos)
 	  : NAN;
 
 	_markerDistance = distance;
+	_markerPos = pos;
 	QPointF pp(position(distance));
 
 	if (isValid(pp)) {
@@ -456,22 +752,20 @@ unsigned PathItem::tickSize() const
 
 void PathItem::updateTicks()
 {
-	qDeleteAll(_ticks);
-	_ticks.clear();
-
-	if (!_showTicks)
+	if (!_showTicks) {
+		_ticks->clear();
 		return;
+	}
 
 	int ts = tickSize();
 	int tc = _path.last().last().distance() / (ts * xInM());
-	QRect tr = PathTickItem::tickRect(ts * tc);
+	QVector<QPointF> pos(tc);
 
-	_ticks.resize(tc);
-	for (int i = 0; i < tc; i++) {
-		_ticks[i] = new PathTickItem(tr, (i + 1) * ts, this);
-		_ticks[i]->setPos(position((i + 1) * ts * xInM()));
-		_ticks[i]->setColor(_pen.color());
-	}
+	for (int i = 0; i < tc; i++)
+		pos[i] = position((i + 1) * ts * xInM());
+
+	_ticks->setColor(_pen.color());
+	_ticks->setTicks(pos, ts);
 }
 
 void PathItem::showTicks(bool show)
@@ -484,9 +778,13 @@ void PathItem::showTicks(bool show)
 	updateTicks();
 }
 
-void PathItem::addGraph(GraphItem *graph)
+void PathItem::addGraph(int index, GraphItem *graph)
 {
-	_graphs.append(graph);
+	while (_graphs.size() <= index)
+		_graphs.append(0);
+	_graphs[index] = graph;
+	if (index == _graphIndex)
+		_graph = graph;
 
 	if (graph) {
 		connect(this, &PathItem::selected, graph, &GraphItem::hover);
@@ -500,9 +798,42 @@ void PathItem::addGraph(GraphItem *graph)
 	}
 }
 
+qint64 PathItem::memoryUsage() const
+{
+	qint64 size = sizeof(*this) + _lod.memoryUsage()
+	  + _painterPath.elementCount() * sizeof(QPainterPath::Element);
+
+	for (int i = 0; i < _path.size(); i++)
+		size += _path.at(i).capacity() * sizeof(PathPoint);
+	for (int i = 0; i < _chunks.size(); i++)
+		size += sizeof(Chunk) + (_chunks.at(i).path.elementCount()
+		  + _chunks.at(i).shape.elementCount()) * sizeof(QPainterPath::Element);
+	size += _lines.capacity() * sizeof(QLineF);
+	for (int i = 0; i < _gcCache.size(); i++) {
+		const GCCache &cache = _gcCache.at(i);
+		for (GCCache::const_iterator it = cache.constBegin();
+		  it != cache.constEnd(); ++it)
+			size += it.value().capacity() * sizeof(Coordinates);
+	}
+
+	for (int i = 0; i < _graphs.size(); i++) {
+		const GraphItem *graph = _graphs.at(i);
+		if (graph) {
+			size += graph->memoryUsage();
+			if (graph->secondaryGraph())
+				size += graph->secondaryGraph()->memoryUsage();
+		}
+	}
+
+	return size;
+}
+
 void PathItem::setGraph(int index)
 {
-	_graph = _graphs.at(index);
+	_graphIndex = index;
+	_graph = graph(index);
+	/* The position is graph type dependent */
+	_markerPos = NAN;
 }
 
 void PathItem::hoverEnterEvent(QGraphicsSceneHoverEvent *event)
@@ -2,13 +2,17 @@
 #define PATHITEM_H
 
 #include <QPen>
+#include <QLineF>
 #include <QTimeZone>
+#include <QHash>
 #include "data/path.h"
 #include "data/link.h"
+#include "common/packedrtree.h"
 #include "graphicsscene.h"
 #include "markerinfoitem.h"
 #include "format.h"
 #include "units.h"
+#include "pathlod.h"
 
 class Map;
 class PathTickItem;
@@ -23,8 +27,11 @@ public:
 	PathItem(const Path &path, Map *map, QGraphicsItem *parent = 0);
 	virtual ~PathItem() {}
 
-	QPainterPath shape() const {return _shape;}
-	QRectF boundingRect() const {return _shape.boundingRect();}
+	QPainterPath shape() const;
+	QRectF boundingRect() const {return _boundingRect;}
+	bool contains(const QPointF &point) const;
+	bool collidesWithPath(const QPainterPath &path,
+	  Qt::ItemSelectionMode mode = Qt::IntersectsItemShape) const;
 	void paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
 	  QWidget *widget);
 
@@ -32,9 +39,16 @@ public:
 	const QString &file() const {return _file;}
 	const QString &name() const {return _name;}
 	const Path &path() const {return _path;}
+	const RectC &bounds() const {return _bounds;}
 	const QColor &color() const;
 
-	void addGraph(GraphItem *graph);
+	/* The graphs are added per graph tab index, in any tab order */
+	void addGraph(int index, GraphItem *graph);
+	GraphItem *graph(int index) const
+	  {return (index >= 0 && index < _graphs.size()) ? _graphs.at(index) : 0;}
+
+	/* Appends the path points to the last path segment (live data) */
+	void append(const Path &path);
 
 	void setMap(Map *map);
 	void setGraph(int index);
@@ -51,11 +65,15 @@ public:
 	void showTicks(bool show);
 
 	void setMarkerPosition(qreal pos);
+	qreal markerPosition() const {return _markerPos;}
 
 	void updateTicks();
 	void updateMarkerInfo();
 	void updateStyle();
 
+	/* Estimated memory used by the item (including its graphs) in bytes */
+	qint64 memoryUsage() const;
+
 	static void setUnits(Units units) {_units = units;}
 	static void setTimeZone(const QTimeZone &zone) {_timeZone = zone;}
 
@@ -82,11 +100,42 @@ protected:
 	static QTimeZone _timeZone;
 
 private:
+	/* The painter path is split into spatial chunks, so that only the
+	   visible parts are drawn and the shapes used for hit-testing are only
+	   stroked for the chunks that are really tested. */
+	struct Chunk {
+		Chunk() {}
+		Chunk(const QPainterPath &path)
+		  : path(path), bounds(path.boundingRect()) {}
+
+		QPainterPath path;
+		QRectF bounds;
+		mutable QPainterPath shape;
+	};
+
+	/* Index of the painter path line segments used for hit-testing (hover),
+	   built on the first test after the painter path changes. */
+	typedef PackedRTree<int, qreal, 2> LineTree;
+
+	typedef QPair<int, int> GCKey;
+	typedef QHash<GCKey, QVector<Coordinates> > GCCache;
+
 	const PathSegment *segment(qreal x) const;
 	QPointF position(qreal distance) const;
+	qreal tolerance() const;
+	const QVector<Coordinates> &greatCircle(int segment, const PathPoint *p1,
+	  const PathPoint *p2, qreal dist);
 	void updatePainterPath();
+	void addPoints(int i, const QVector<int> *lod, int from, int size,
+	  const QVector<QPointF> &xy);
 	void updateShape();
-	bool addSegment(const Coordinates &c1, const Coordinates &c2);
+	void addChunk();
+	qreal strokeWidth() const;
+	QRectF chunkRect(int i) const;
+	const QPainterPath &chunkShape(int i) const;
+	void updateLineTree() const;
+	bool addSegment(const Coordinates &c1, const Coordinates &c2,
+	  const QPointF &p2);
 	void setMarkerInfo(qreal pos);
 	void updateColor();
 	void updateWidth();
@@ -98,17 +147,25 @@ private:
 	unsigned tickSize() const;
 
 	Path _path;
+	PathLOD _lod;
+	RectC _bounds;
 
 	Map *_map;
 	QList<GraphItem *> _graphs;
 	GraphItem *_graph;
+	int _graphIndex;
 	MarkerItem *_marker;
 	MarkerInfoItem *_markerInfo;
-	QVector<PathTickItem*> _ticks;
+	PathTickItem *_ticks;
 
 	QPen _pen;
-	QPainterPath _shape;
+	QVector<Chunk> _chunks;
+	QRectF _boundingRect;
+	mutable QVector<QLineF> _lines;
+	mutable LineTree _lineTree;
 	QPainterPath _painterPath;
+	QVector<GCCache> _gcCache;
+	mutable int _segmentHint, _pointHint;
 
 	qreal _width;
 	QColor _color;
@@ -117,6 +174,7 @@ private:
 	bool _showTicks;
 	MarkerInfoItem::Type _markerInfoType;
 	qreal _markerDistance;
+	qreal _markerPos;
 	int _digitalZoom;
 };
 
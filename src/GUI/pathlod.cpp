@@ -0,0 +1,161 @@
+#include <cmath>
+#include <QPointF>
+#include <QLineF>
+#include "common/wgs84.h"
+#include "pathlod.h"
+
+
+#define MIN_POINTS 64
+
+struct Range {
+	Range() {}
+	Range(int first, int last, qreal importance)
+	  : first(first), last(last), importance(importance) {}
+
+	int first, last;
+	qreal importance;
+};
+
+static qreal distance(const QPointF &p, const QPointF &a, const QPointF &b)
+{
+	QPointF ab(b - a), ap(p - a);
+	qreal l2 = ab.x() * ab.x() + ab.y() * ab.y();
+
+	if (l2 == 0)
+		return QLineF(a, p).length();
+
+	qreal t = qBound(0.0, (ap.x() * ab.x() + ap.y() * ab.y()) / l2, 1.0);
+	return QLineF(a + t * ab, p).length();
+}
+
+static inline const Coordinates &coordinates(const PathPoint &point)
+{
+	return point.coordinates();
+}
+
+static inline const Coordinates &coordinates(const Coordinates &c)
+{
+	return c;
+}
+
+/* Importance of every point = the Douglas-Peucker tolerance at which the
+   point is still part of the simplified segment. */
+template<class T>
+static QVector<qreal> importance(const T &segment)
+{
+	QVector<QPointF> xy(segment.size());
+	QVector<qreal> imp(segment.size(), 0);
+	QVector<Range> stack;
+	qreal k = deg2rad(WGS84_RADIUS);
+	qreal ck = k * cos(deg2rad(coordinates(segment.first()).lat()));
+
+	for (int i = 0; i < segment.size(); i++) {
+		const Coordinates &c = coordinates(segment.at(i));
+		xy[i] = QPointF(c.lon() * ck, c.lat() * k);
+	}
+
+	imp[0] = INFINITY;
+	imp[segment.size() - 1] = INFINITY;
+	stack.append(Range(0, segment.size() - 1, INFINITY));
+
+	while (!stack.isEmpty()) {
+		Range r(stack.takeLast());
+		qreal max = -1;
+		int index = -1;
+
+		for (int i = r.first + 1; i < r.last; i++) {
+			qreal d = distance(xy.at(i), xy.at(r.first), xy.at(r.last));
+			if (d > max) {
+				max = d;
+				index = i;
+			}
+		}
+		if (index < 0)
+			continue;
+
+		/* The levels must be nested, so a point can not be more important
+		   than the point that has split its range */
+		imp[index] = qMin(max, r.importance);
+		stack.append(Range(r.first, index, imp.at(index)));
+		stack.append(Range(index, r.last, imp.at(index)));
+	}
+
+	return imp;
+}
+
+template<class T>
+static QVector<QVector<int> > levels(const T &segment)
+{
+	QVector<QVector<int> > levels;
+
+	if (segment.size() < MIN_POINTS)
+		return levels;
+
+	QVector<qreal> imp(importance(segment));
+	QVector<int> level;
+
+	for (int j = 0; j < imp.size(); j++)
+		if (imp.at(j) >= 1.0)
+			level.append(j);
+	levels.append(level);
+
+	/* Every level is a subset of the previous one */
+	for (qreal tolerance = 2.0; level.size() > 2; tolerance *= 2.0) {
+		QVector<int> next;
+		for (int j = 0; j < level.size(); j++)
+			if (imp.at(level.at(j)) >= tolerance)
+				next.append(level.at(j));
+		levels.append(next);
+		level = next;
+	}
+
+	return levels;
+}
+
+PathLOD::PathLOD(const Path &path)
+{
+	_levels.resize(path.size());
+
+	for (int i = 0; i < path.size(); i++)
+		_levels[i] = levels(path.at(i));
+}
+
+PathLOD::PathLOD(const QVector<QVector<Coordinates> > &rings)
+{
+	_levels.resize(rings.size());
+
+	for (int i = 0; i < rings.size(); i++)
+		_levels[i] = levels(rings.at(i));
+}
+
+const QVector<int> *PathLOD::indexes(int segment, qreal tolerance) const
+{
+	const QVector<QVector<int> > &levels = _levels.at(segment);
+	int level = std::isfinite(tolerance) && tolerance >= 1.0
+	  ? (int)log2(tolerance) : -1;
+
+	if (level < 0 || levels.isEmpty())
+		return 0;
+
+	return &levels.at(qMin(level, levels.size() - 1));
+}
+
+void PathLOD::append(int segment, int from, int to)
+{
+	QVector<QVector<int> > &levels = _levels[segment];
+
+	for (int i = 0; i < levels.size(); i++)
+		for (int j = from; j < to; j++)
+			levels[i].append(j);
+}
+
+qint64 PathLOD::memoryUsage() const
+{
+	qint64 size = 0;
+
+	for (int i = 0; i < _levels.size(); i++)
+		for (int j = 0; j < _levels.at(i).size(); j++)
+			size += _levels.at(i).at(j).capacity() * sizeof(int);
+
+	return size;
+}
@@ -0,0 +1,32 @@
+#ifndef PATHLOD_H
+#define PATHLOD_H
+
+#include <QVector>
+#include "data/path.h"
+
+/* Douglas-Peucker level of detail pyramid of a path (or of a set of area
+   rings). The points importance is computed once in a local equirectangular
+   projection, level N then holds the indexes of the segment points required
+   to keep the segment within 2^N meters of the original geometry. */
+class PathLOD
+{
+public:
+	PathLOD() {}
+	PathLOD(const Path &path);
+	PathLOD(const QVector<QVector<Coordinates> > &rings);
+
+	/* The points to draw with the given tolerance (in meters) or 0 if all
+	   the segment points are required. */
+	const QVector<int> *indexes(int segment, qreal tolerance) const;
+
+	/* Adds the (live data) points from..to-1 of the segment. The points are
+	   not simplified, they are part of all the levels. */
+	void append(int segment, int from, int to);
+
+	qint64 memoryUsage() const;
+
+private:
+	QVector<QVector<QVector<int> > > _levels;
+};
+
+#endif // PATHLOD_H
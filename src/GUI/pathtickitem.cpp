@@ -1,6 +1,8 @@
 #include <QPainter>
 #include <QCursor>
+#include <QStyleOptionGraphicsItem>
 #include <QGraphicsSceneMouseEvent>
+#include <QtMath>
 #include "font.h"
 #include "popup.h"
 #include "pathitem.h"
@@ -18,38 +20,134 @@ static QFont defaultFont()
 }
 
 QFont PathTickItem::_font = defaultFont();
+QHash<int, QStaticText> PathTickItem::_texts;
 
-PathTickItem::PathTickItem(const QRectF &tickRect, int value,
-  QGraphicsItem *parent) : GraphicsItem(parent), _tickRect(tickRect),
-  _text(QString::number(value))
+PathTickItem::PathTickItem(QGraphicsItem *parent)
+  : GraphicsItem(parent), _scale(1.0)
 {
-	_tickRect.moveCenter(QPointF(0, -_tickRect.height()/2.0 - 3));
-
 	setCursor(Qt::ArrowCursor);
 	setAcceptHoverEvents(true);
+	setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+QStaticText PathTickItem::text(int value)
+{
+	QHash<int, QStaticText>::iterator it(_texts.find(value));
+
+	if (it == _texts.end()) {
+		QStaticText st(QString::number(value));
+		st.setTextFormat(Qt::PlainText);
+		st.prepare(QTransform(), _font);
+		it = _texts.insert(value, st);
+	}
+
+	return *it;
 }
 
-QRectF PathTickItem::boundingRect() const
+QRectF PathTickItem::tickRect(int value)
 {
-	return _tickRect.adjusted(0, 0, 0, 3);
+	QFontMetrics fm(_font);
+	QRectF rect(fm.boundingRect(QRect(), Qt::AlignCenter,
+	  QString::number(qMax(value, 10))).adjusted(-2, 0, 2, 0));
+	rect.moveCenter(QPointF(0, -rect.height()/2.0 - 3));
+
+	return rect;
+}
+
+QRectF PathTickItem::tickRect(const Tick &tick) const
+{
+	QRectF rect(_tickRect.adjusted(0, 0, 0, 3));
+	return QRectF(tick.pos + rect.topLeft() * _scale, rect.size() * _scale);
+}
+
+void PathTickItem::updateBoundingRect()
+{
+	_boundingRect = QRectF();
+	for (int i = 0; i < _ticks.size(); i++)
+		_boundingRect |= tickRect(_ticks.at(i));
+	_shape = QPainterPath();
+}
+
+QPainterPath PathTickItem::shape() const
+{
+	if (_shape.isEmpty()) {
+		for (int i = 0; i < _ticks.size(); i++)
+			_shape.addRect(tickRect(_ticks.at(i)));
+	}
+
+	return _shape;
+}
+
+void PathTickItem::setTicks(const QVector<QPointF> &pos, int step)
+{
+	prepareGeometryChange();
+
+	_tickRect = tickRect(step * pos.size());
+	_ticks.resize(pos.size());
+	for (int i = 0; i < pos.size(); i++) {
+		/* For propper rounded rect rendering, the ticks must be positioned
+		   in the middle of a pixel */
+		QPoint p(pos.at(i).toPoint());
+		_ticks[i] = Tick(QPointF(p.x() - 0.5, p.y() - 0.5),
+		  text((i + 1) * step));
+	}
+
+	updateBoundingRect();
+}
+
+void PathTickItem::clear()
+{
+	prepareGeometryChange();
+
+	_ticks.clear();
+	updateBoundingRect();
+}
+
+void PathTickItem::setColor(const QColor &color)
+{
+	_brush = QBrush(color);
+	update();
+}
+
+void PathTickItem::setDigitalZoom(int zoom)
+{
+	prepareGeometryChange();
+
+	_scale = qPow(2, -zoom);
+	updateBoundingRect();
 }
 
 void PathTickItem::paint(QPainter *painter,
   const QStyleOptionGraphicsItem *option, QWidget *widget)
 {
-	Q_UNUSED(option);
 	Q_UNUSED(widget);
 
 	QPointF arrow[3] = {QPointF(0, 0), QPointF(3, -3), QPointF(-3, -3)};
+	QRectF exposed(option->exposedRect);
+	if (painter->hasClipping())
+		exposed &= painter->clipBoundingRect();
 
 	painter->setFont(_font);
 	painter->setRenderHint(QPainter::Antialiasing, false);
-
 	painter->setPen(Qt::white);
 	painter->setBrush(_brush);
-	painter->drawPolygon(arrow, 3);
-	painter->drawRoundedRect(_tickRect, 1.5, 1.5);
-	painter->drawText(_tickRect, Qt::AlignCenter, _text);
+
+	for (int i = 0; i < _ticks.size(); i++) {
+		const Tick &tick = _ticks.at(i);
+		if (!tickRect(tick).intersects(exposed))
+			continue;
+
+		QSizeF ts(tick.text.size());
+
+		painter->save();
+		painter->translate(tick.pos);
+		painter->scale(_scale, _scale);
+		painter->drawPolygon(arrow, 3);
+		painter->drawRoundedRect(_tickRect, 1.5, 1.5);
+		painter->drawStaticText(QPointF(_tickRect.center().x() - ts.width()/2,
+		  _tickRect.center().y() - ts.height()/2), tick.text);
+		painter->restore();
+	}
 
 /*
 	painter->setBrush(Qt::NoBrush);
@@ -58,21 +156,6 @@ void PathTickItem::paint(QPainter *painter,
 */
 }
 
-void PathTickItem::setPos(const QPointF &pos)
-{
-	/* For propper rounded rect rendering, the item must be positioned in the
-	   middle of a pixel */
-	QPoint p(pos.toPoint());
-	QGraphicsItem::setPos(QPointF(p.x() - 0.5, p.y() - 0.5));
-}
-
-QRect PathTickItem::tickRect(int value)
-{
-	QFontMetrics fm(_font);
-	return fm.boundingRect(QRect(), Qt::AlignCenter,
-	  QString::number(qMax(value, 10))).adjusted(-2, 0, 2, 0);
-}
-
 void PathTickItem::mousePressEvent(QGraphicsSceneMouseEvent *event)
 {
 	const PathItem *pi = static_cast<PathItem*>(parentItem());
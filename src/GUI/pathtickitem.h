@@ -2,22 +2,30 @@
 #define PATHTICKITEM_H
 
 #include <QFont>
+#include <QHash>
+#include <QStaticText>
 #include <QGraphicsItem>
-#include <QtMath>
 #include "graphicsscene.h"
 
+/* All the distance ticks of a path drawn by a single item. A separate item
+   for every tick made long tracks create (and recreate on every zoom/units
+   change) tens of thousands of scene items. */
 class PathTickItem : public GraphicsItem
 {
 public:
-	PathTickItem(const QRectF &tickRect, int value, QGraphicsItem *parent = 0);
+	PathTickItem(QGraphicsItem *parent = 0);
 
-	QRectF boundingRect() const;
+	QRectF boundingRect() const {return _boundingRect;}
+	QPainterPath shape() const;
 	void paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
 	  QWidget *widget);
 
-	void setPos(const QPointF &pos);
-	void setColor(const QColor &color) {_brush = QBrush(color);}
-	void setDigitalZoom(int zoom) {setScale(qPow(2, -zoom));}
+	/* Ticks with values (i + 1) * step at the given positions */
+	void setTicks(const QVector<QPointF> &pos, int step);
+	void clear();
+
+	void setColor(const QColor &color);
+	void setDigitalZoom(int zoom);
 
 	int type() const {return parentItem()->type();}
 	ToolTip info(bool extended) const
@@ -25,17 +33,36 @@ public:
 		return static_cast<GraphicsItem*>(parentItem())->info(extended);
 	}
 
-	static QRect tickRect(int value);
-
 protected:
 	void mousePressEvent(QGraphicsSceneMouseEvent *event);
 
 private:
+	struct Tick
+	{
+		Tick() {}
+		Tick(const QPointF &pos, const QStaticText &text)
+		  : pos(pos), text(text) {}
+
+		QPointF pos;
+		QStaticText text;
+	};
+
+	QRectF tickRect(const Tick &tick) const;
+	void updateBoundingRect();
+
+	static QRectF tickRect(int value);
+	static QStaticText text(int value);
+
+	QVector<Tick> _ticks;
 	QRectF _tickRect;
-	QString _text;
+	qreal _scale;
 	QBrush _brush;
+	QRectF _boundingRect;
+	mutable QPainterPath _shape;
 
 	static QFont _font;
+	/* The laid out tick labels, shared by all the paths */
+	static QHash<int, QStaticText> _texts;
 };
 
 #endif // PATHTICKITEM_H
@@ -5,6 +5,7 @@
 #include <QGroupBox>
 #include <QComboBox>
 #include <QRadioButton>
+#include <QSpinBox>
 #include <QMessageBox>
 #include <QTabWidget>
 #include "marginswidget.h"
@@ -69,6 +70,15 @@ PDFExportDialog::PDFExportDialog(PDFExport &exp, Units units, QWidget *parent)
 	_margins->setValue((units == Metric)
 	  ? _export.margins * MM2CM : _export.margins * MM2IN);
 
+	/* Atlas mode, the paths are split to the given number of map pages
+	   following the main page */
+	_mapPages = new QSpinBox();
+	_mapPages->setMinimum(1);
+	_mapPages->setMaximum(100);
+	_mapPages->setValue(_export.mapPages);
+	_mapPages->setToolTip(tr("Number of additional map pages the paths are"
+	  " split to, 1 means no additional pages"));
+
 #ifndef Q_OS_MAC
 	QGroupBox *pageSetupBox = new QGroupBox(tr("Page Setup"));
 #endif // Q_OS_MAC
@@ -77,6 +87,7 @@ PDFExportDialog::PDFExportDialog(PDFExport &exp, Units units, QWidget *parent)
 	pageSetupLayout->addRow(tr("Resolution:"), _resolution);
 	pageSetupLayout->addRow(tr("Orientation:"), orientationLayout);
 	pageSetupLayout->addRow(tr("Margins:"), _margins);
+	pageSetupLayout->addRow(tr("Map pages:"), _mapPages);
 #ifdef Q_OS_MAC
 	QFrame *line = new QFrame();
 	line->setFrameShape(QFrame::HLine);
@@ -138,6 +149,7 @@ void PDFExportDialog::accept()
 	_export.paperSize = paperSize;
 	_export.resolution = resolution;
 	_export.orientation = orientation;
+	_export.mapPages = _mapPages->value();
 	_export.margins = (_units == Imperial)
 	  ? _margins->value() / MM2IN : _margins->value() / MM2CM;
 
@@ -7,6 +7,7 @@
 
 class QComboBox;
 class QRadioButton;
+class QSpinBox;
 class FileSelectWidget;
 class MarginsFWidget;
 
@@ -17,6 +18,7 @@ struct PDFExport
 	QPageLayout::Orientation orientation;
 	QMarginsF margins;
 	int resolution;
+	int mapPages;
 };
 
 class PDFExportDialog : public QDialog
@@ -39,6 +41,7 @@ private:
 	QRadioButton *_portrait;
 	QRadioButton *_landscape;
 	MarginsFWidget *_margins;
+	QSpinBox *_mapPages;
 };
 
 #endif // PDFEXPORTDIALOG_H
@@ -0,0 +1,131 @@
+#include <cstring>
+#include <QIODevice>
+#include <QImage>
+#include <QtEndian>
+#include "pngwriter.h"
+
+#define BUFFER_SIZE 65536
+
+PNGWriter::PNGWriter(QIODevice *device)
+  : _device(device), _rows(0), _init(false)
+{
+	memset(&_stream, 0, sizeof(_stream));
+	_buffer.resize(BUFFER_SIZE);
+}
+
+PNGWriter::~PNGWriter()
+{
+	if (_init)
+		deflateEnd(&_stream);
+}
+
+bool PNGWriter::writeChunk(const char *type, const char *data, quint32 size)
+{
+	uchar len[4], crc[4];
+	uLong sum;
+
+	qToBigEndian(size, len);
+	sum = crc32(0, (const Bytef*)type, 4);
+	if (size)
+		sum = crc32(sum, (const Bytef*)data, size);
+	qToBigEndian((quint32)sum, crc);
+
+	return (_device->write((const char*)len, 4) == 4
+	  && _device->write(type, 4) == 4
+	  && (!size || _device->write(data, size) == size)
+	  && _device->write((const char*)crc, 4) == 4);
+}
+
+bool PNGWriter::deflateData(const uchar *data, uint size, int flush)
+{
+	int ret;
+
+	_stream.next_in = (Bytef*)data;
+	_stream.avail_in = size;
+
+	do {
+		_stream.next_out = (Bytef*)_buffer.data();
+		_stream.avail_out = _buffer.size();
+		ret = deflate(&_stream, flush);
+		if (ret == Z_STREAM_ERROR)
+			return false;
+
+		uint len = _buffer.size() - _stream.avail_out;
+		if (len && !writeChunk("IDAT", _buffer.constData(), len))
+			return false;
+	} while (_stream.avail_out == 0 || (flush == Z_FINISH
+	  && ret != Z_STREAM_END));
+
+	return true;
+}
+
+bool PNGWriter::start(const QSize &size)
+{
+	static const char signature[] = "\x89PNG\r\n\x1a\n";
+	uchar ihdr[13];
+
+	_size = size;
+	_rows = 0;
+	_line.resize(size.width() * 3 + 1);
+
+	if (deflateInit(&_stream, Z_DEFAULT_COMPRESSION) != Z_OK)
+		return false;
+	_init = true;
+
+	qToBigEndian((quint32)size.width(), ihdr);
+	qToBigEndian((quint32)size.height(), ihdr + 4);
+	ihdr[8] = 8; // bit depth
+	ihdr[9] = 2; // RGB
+	ihdr[10] = 0;
+	ihdr[11] = 0;
+	ihdr[12] = 0;
+
+	return (_device->write(signature, 8) == 8
+	  && writeChunk("IHDR", (const char*)ihdr, sizeof(ihdr)));
+}
+
+/* The rows are written with the "Sub" filter, it is cheap and gives a good
+   compression ratio for the map images. */
+bool PNGWriter::write(const QImage &strip)
+{
+	Q_ASSERT(strip.width() == _size.width());
+	Q_ASSERT(strip.format() == QImage::Format_ARGB32_Premultiplied);
+
+	int h = qMin(strip.height(), _size.height() - _rows);
+	uchar *line = (uchar*)_line.data();
+
+	for (int i = 0; i < h; i++) {
+		const QRgb *src = (const QRgb*)strip.constScanLine(i);
+		uchar prev[3] = {0, 0, 0};
+
+		line[0] = 1;
+		for (int j = 0; j < _size.width(); j++) {
+			QRgb c = qUnpremultiply(src[j]);
+			uchar *dst = line + 1 + j * 3;
+
+			dst[0] = qRed(c) - prev[0];
+			dst[1] = qGreen(c) - prev[1];
+			dst[2] = qBlue(c) - prev[2];
+			prev[0] = qRed(c);
+			prev[1] = qGreen(c);
+			prev[2] = qBlue(c);
+		}
+
+		if (!deflateData(line, _line.size(), Z_NO_FLUSH))
+			return false;
+	}
+	_rows += h;
+
+	return true;
+}
+
+bool PNGWriter::finish()
+{
+	if (_rows != _size.height() || !deflateData(0, 0, Z_FINISH))
+		return false;
+
+	deflateEnd(&_stream);
+	_init = false;
+
+	return writeChunk("IEND", 0, 0);
+}
@@ -0,0 +1,35 @@
+#ifndef PNGWRITER_H
+#define PNGWRITER_H
+
+#include <QSize>
+#include <QByteArray>
+#include <zlib.h>
+
+class QIODevice;
+class QImage;
+
+/* Streaming (8-bit RGB) PNG encoder. The image rows are written in strips,
+   so the whole image never has to be in memory. */
+class PNGWriter
+{
+public:
+	PNGWriter(QIODevice *device);
+	~PNGWriter();
+
+	bool start(const QSize &size);
+	bool write(const QImage &strip);
+	bool finish();
+
+private:
+	bool writeChunk(const char *type, const char *data, quint32 size);
+	bool deflateData(const uchar *data, uint size, int flush);
+
+	QIODevice *_device;
+	QSize _size;
+	int _rows;
+	z_stream _stream;
+	bool _init;
+	QByteArray _line, _buffer;
+};
+
+#endif // PNGWRITER_H
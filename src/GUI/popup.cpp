@@ -11,6 +11,7 @@
 #include <QApplication>
 #include "tooltip.h"
 #include "thumbnail.h"
+#include "thumbnailcache.h"
 #include "flowlayout.h"
 #include "popup.h"
 
@@ -91,9 +92,15 @@ void PopupFrame::createLayout(const ToolTip &content)
 	if (!content.images().isEmpty()) {
 		FlowLayout *imagesLayout = new FlowLayout(0, 2, 2);
 		int size = qMin(960/content.images().size(), 240);
+		QList<ThumbnailCache::Entry> thumbnails;
 
 		for (int i = 0; i < content.images().size(); i++)
-			imagesLayout->addWidget(new Thumbnail(content.images().at(i), size));
+			thumbnails.append(ThumbnailCache::Entry(content.images().at(i),
+			  size));
+		ThumbnailCache::load(thumbnails);
+		for (int i = 0; i < thumbnails.size(); i++)
+			imagesLayout->addWidget(new Thumbnail(thumbnails.at(i).path(),
+			  thumbnails.at(i).image()));
 
 		layout->addLayout(imagesLayout);
 	}
@@ -77,6 +77,34 @@ QList<GraphItem*> PowerGraph::loadData(const Data &data, Map *map)
 	return graphs;
 }
 
+GraphPair PowerGraph::appendedData(const Track &track, int from, Map *map)
+  const
+{
+	Q_UNUSED(map);
+	return GraphPair(track.power(from), Graph());
+}
+
+int PowerGraph::series() const
+{
+	return 1 << Track::Power;
+}
+
+void PowerGraph::removeData(const QList<GraphItem*> &graphs)
+{
+	for (int i = 0; i < graphs.size(); i++) {
+		int idx = _tracks.indexOf(static_cast<PowerGraphItem*>(graphs.at(i)));
+		if (idx < 0)
+			continue;
+
+		removeGraph(_tracks.at(idx));
+		delete _tracks.takeAt(idx);
+		_avg.remove(idx);
+	}
+
+	setInfo();
+	redraw();
+}
+
 qreal PowerGraph::avg() const
 {
 	qreal sum = 0, w = 0;
@@ -0,0 +1,187 @@
+#include <QPainter>
+#include <QPaintDevice>
+#include "data/data.h"
+#include "map/maplist.h"
+#include "map/emptymap.h"
+#include "graphicsscene.h"
+#include "trackitem.h"
+#include "routeitem.h"
+#include "areaitem.h"
+#include "waypointitem.h"
+#include "rendercontext.h"
+
+#define MARGIN 10
+
+RenderContext::RenderContext(const Projection &in, const Projection &out,
+  bool hillShading) : _in(in), _out(out), _hillShading(hillShading)
+{
+	_map = new EmptyMap();
+	_scene = new GraphicsScene();
+}
+
+RenderContext::~RenderContext()
+{
+	delete _scene;
+	_map->unload();
+	delete _map;
+}
+
+bool RenderContext::setMap(const QString &path, int style)
+{
+	Map *map = MapList::loadMap(path, _in);
+	if (!map)
+		return false;
+
+	_map->unload();
+	delete _map;
+	_map = map;
+	_map->load(_in, _out, 1.0, false, style, -1);
+
+	return true;
+}
+
+void RenderContext::clear()
+{
+	_scene->clear();
+	_paths.clear();
+	_areas.clear();
+	_waypoints.clear();
+	_palette.reset();
+	_bounds = RectC();
+}
+
+void RenderContext::addData(const Data &data)
+{
+	for (int i = 0; i < data.areas().count(); i++) {
+		const Area &area = data.areas().at(i);
+		if (!area.isValid()) {
+			_palette.nextColor();
+			continue;
+		}
+		AreaItem *ai = new AreaItem(area, _map);
+		ai->setColor(_palette.nextColor());
+		ai->setZValue(-area.boundingRect().area());
+		_bounds |= ai->bounds();
+		_areas.append(ai);
+		_scene->addItem(ai);
+	}
+	for (int i = 0; i < data.tracks().count(); i++) {
+		const Track &track = data.tracks().at(i);
+		if (!track.isValid()) {
+			_palette.nextColor();
+			continue;
+		}
+		TrackItem *ti = new TrackItem(track, _map);
+		ti->setColor(_palette.nextColor());
+		ti->showMarker(false);
+		_bounds |= ti->path().boundingRect();
+		_paths.append(ti);
+		_scene->addItem(ti);
+	}
+	for (int i = 0; i < data.routes().count(); i++) {
+		const Route &route = data.routes().at(i);
+		if (!route.isValid()) {
+			_palette.nextColor();
+			continue;
+		}
+		RouteItem *ri = new RouteItem(route, _map);
+		ri->setColor(_palette.nextColor());
+		ri->showMarker(false);
+		_bounds |= ri->path().boundingRect();
+		_paths.append(ri);
+		_scene->addItem(ri);
+	}
+	for (int i = 0; i < data.waypoints().count(); i++) {
+		WaypointItem *wi = new WaypointItem(data.waypoints().at(i), _map);
+		wi->setZValue(1);
+		_bounds = _bounds.united(wi->waypoint().coordinates());
+		_waypoints.append(wi);
+		_scene->addItem(wi);
+	}
+}
+
+/* The paths are taken as one continuous path, every page starts with the
+   last point of the previous page so that the pages connect */
+QList<RectC> RenderContext::pages(int count) const
+{
+	QList<RectC> list;
+	qreal total = 0;
+
+	for (int i = 0; i < _paths.size(); i++)
+		total += _paths.at(i)->path().last().last().distance();
+	if (total <= 0 || count < 2)
+		return list << _bounds;
+
+	qreal step = total / count, offset = 0;
+	RectC rect;
+	Coordinates last;
+
+	for (int i = 0; i < _paths.size(); i++) {
+		const Path &path = _paths.at(i)->path();
+
+		for (int j = 0; j < path.size(); j++) {
+			const PathSegment &segment = path.at(j);
+
+			for (int k = 0; k < segment.size(); k++) {
+				const PathPoint &p = segment.at(k);
+
+				if (offset + p.distance() > (list.size() + 1) * step
+				  && list.size() < count - 1) {
+					list.append(rect);
+					rect = RectC().united(last);
+				}
+				rect = rect.united(p.coordinates());
+				last = p.coordinates();
+			}
+		}
+
+		offset += path.last().last().distance();
+	}
+	list.append(rect);
+
+	return list;
+}
+
+/* The map and the items are rendered in ratio-times bigger "pixels" than the
+   target device pixels */
+void RenderContext::render(QPainter *painter, const QRectF &target,
+  const RectC &rect, qreal ratio)
+{
+	QSizeF size(target.size() / ratio);
+	Map::Flags flags = Map::Block;
+	if (_hillShading)
+		flags |= Map::HillShading;
+
+	_map->zoomFit(size.toSize() - QSize(2*MARGIN, 2*MARGIN), rect.isNull()
+	  ? _map->llBounds() : rect);
+	for (int i = 0; i < _paths.size(); i++)
+		_paths.at(i)->setMap(_map);
+	for (int i = 0; i < _areas.size(); i++)
+		_areas.at(i)->setMap(_map);
+	for (int i = 0; i < _waypoints.size(); i++)
+		_waypoints.at(i)->setMap(_map);
+	_scene->setSceneRect(_map->bounds());
+
+	QPointF center(rect.isNull() ? _map->bounds().center()
+	  : _map->ll2xy(rect.center()));
+	QRectF src(center - QPointF(size.width() / 2.0, size.height() / 2.0),
+	  size);
+
+	painter->save();
+	painter->setClipRect(target, Qt::IntersectClip);
+	painter->translate(target.topLeft());
+	painter->scale(ratio, ratio);
+	painter->translate(-src.topLeft());
+	_map->draw(painter, src.intersected(_map->bounds()), flags);
+	painter->restore();
+
+	_scene->render(painter, target, src);
+}
+
+void RenderContext::render(QPaintDevice *device, const RectC &rect)
+{
+	QPainter painter(device);
+	painter.setRenderHints(QPainter::Antialiasing
+	  | QPainter::SmoothPixmapTransform);
+	render(&painter, QRectF(0, 0, device->width(), device->height()), rect);
+}
@@ -0,0 +1,58 @@
+#ifndef RENDERCONTEXT_H
+#define RENDERCONTEXT_H
+
+#include <QList>
+#include "common/rectc.h"
+#include "map/projection.h"
+#include "palette.h"
+
+class QPainter;
+class QPaintDevice;
+class Map;
+class Data;
+class GraphicsScene;
+class PathItem;
+class AreaItem;
+class WaypointItem;
+
+/* Self-contained off-screen render state - a map instance with its own
+   projections and zoom and the data items - that renders to any paint
+   device without any GUI or MapView widgets. Rendering thus never affects
+   the state of the displayed map and several contexts can exist at the same
+   time. Used by the headless render mode and by the PDF atlas export.
+
+   The maps use QPixmap/QPixmapCache, so a context must be used from the GUI
+   thread only. */
+class RenderContext
+{
+public:
+	RenderContext(const Projection &in, const Projection &out,
+	  bool hillShading);
+	~RenderContext();
+
+	bool setMap(const QString &path, int style = -1);
+
+	void addData(const Data &data);
+	void clear();
+	const RectC &bounds() const {return _bounds;}
+	/* Splits the paths into count sections of the same length and returns
+	   the sections' bounds */
+	QList<RectC> pages(int count) const;
+
+	void render(QPainter *painter, const QRectF &target, const RectC &rect,
+	  qreal ratio = 1.0);
+	void render(QPaintDevice *device, const RectC &rect);
+
+private:
+	Map *_map;
+	Projection _in, _out;
+	bool _hillShading;
+	GraphicsScene *_scene;
+	QList<PathItem*> _paths;
+	QList<AreaItem*> _areas;
+	QList<WaypointItem*> _waypoints;
+	Palette _palette;
+	RectC _bounds;
+};
+
+#endif // RENDERCONTEXT_H
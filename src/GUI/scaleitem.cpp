@@ -21,6 +21,8 @@ ScaleItem::ScaleItem(QGraphicsItem *parent) : QGraphicsItem(parent)
 
 	_font.setPixelSize(FONT_SIZE);
 	_font.setFamily(FONT_FAMILY);
+
+	setCacheMode(QGraphicsItem::DeviceCoordinateCache);
 }
 
 void ScaleItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
@@ -1,5 +1,7 @@
 #include <QLocale>
 #include <QDir>
+#include <QGuiApplication>
+#include <QScreen>
 #include <QPageLayout>
 #include <QPageSize>
 #include <QGeoPositionInfoSource>
@@ -33,11 +35,19 @@
 	  : QPageSize::PageSizeId::A4)
 
 #ifdef Q_OS_ANDROID
-#define PIXMAP_CACHE 384
-#define DEM_CACHE    128
+#define PIXMAP_CACHE     384
+#define DEM_CACHE        128
+#define DATA_CACHE       128
+#define TILE_CACHE       1024
+#define TILE_IMAGE_CACHE 64
+#define IMG_CACHE        64
 #else // Q_OS_ANDROID
-#define PIXMAP_CACHE 512
-#define DEM_CACHE    256
+#define PIXMAP_CACHE     512
+#define DEM_CACHE        256
+#define DATA_CACHE       512
+#define TILE_CACHE       4096
+#define TILE_IMAGE_CACHE 128
+#define IMG_CACHE        128
 #endif // Q_OS_ANDROID
 
 
@@ -121,6 +131,34 @@ void Settings::SettingList::write(QSettings &settings,
 	settings.endArray();
 }
 
+/* The image cache defaults are sized to hold the given number of full screen
+   (device pixel) RGB32 images, so that HiDPI/4K screens do not end up with
+   constant evictions, with the static defaults as the lower bound. */
+static int screenCacheSize(int screens, int min, int max)
+{
+	QScreen *screen = QGuiApplication::primaryScreen();
+	if (!screen)
+		return min;
+
+	QSize size(screen->size() * screen->devicePixelRatio());
+	qint64 mb = ((qint64)size.width() * size.height() * 4 * screens) >> 20;
+
+	return (int)qBound((qint64)min, mb, (qint64)max);
+}
+
+const Settings::Setting &Settings::pixmapCache()
+{
+	static Setting s("pixmapCache", screenCacheSize(16, PIXMAP_CACHE, 4096));
+	return s;
+}
+
+const Settings::Setting &Settings::tileImageCache()
+{
+	static Setting s("tileImageCache", screenCacheSize(4, TILE_IMAGE_CACHE,
+	  2048));
+	return s;
+}
+
 const Settings::Setting &Settings::positionPlugin()
 {
 	static Setting s("positionPlugin", defaultPlugin());
@@ -170,6 +208,7 @@ SETTING(routeWaypoints,      "routeWaypoints",         true                   );
 SETTING(waypointIcons,       "waypointIcons",          false                  );
 SETTING(waypointLabels,      "waypointLabels",         true                   );
 SETTING(pathTicks,           "pathTicks",              false                  );
+SETTING(heatmap,             "heatmap",                false                  );
 SETTING(legend,              "legend",                 false                  );
 SETTING(positionMarkers,     "positionMarkers",        true                   );
 SETTING(markerInfo,          "markerInfo",             MarkerInfoItem::None   );
@@ -193,6 +232,7 @@ SETTING(pdfMarginRight,      "marginRight",            5                      );
 SETTING(pdfMarginBottom,     "marginBottom",           5                      );
 SETTING(pdfFileName,         "fileName",               CWD("export.pdf")      );
 SETTING(pdfResolution,       "resolution",             600                    );
+SETTING(pdfMapPages,         "mapPages",               1                      );
 
 /* PNG export */
 SETTING(pngWidth,            "width",                  600                    );
@@ -231,6 +271,7 @@ SETTING(speedFilter,         "speedFilter",            5                      );
 SETTING(heartRateFilter,     "heartrateFilter",        3                      );
 SETTING(cadenceFilter,       "cadenceFilter",          3                      );
 SETTING(powerFilter,         "powerFilter",            3                      );
+SETTING(filterType,          "filterType",             0                      );
 SETTING(outlierEliminate,    "outlierEliminate",       true                   );
 SETTING(detectPauses,        "detectPauses",           true                   );
 SETTING(automaticPause,      "automaticPause",         true                   );
@@ -255,8 +296,14 @@ SETTING(hillshadingAltitude, "hillshadingAltitude",    45                     );
 SETTING(hillshadingZFactor,  "hillshadingZFactor",     0.8                    );
 SETTING(useOpenGL,           "useOpenGL",              false                  );
 SETTING(enableHTTP2,         "enableHTTP2",            true                   );
-SETTING(pixmapCache,         "pixmapCache",            PIXMAP_CACHE           );
+SETTING(revalidateCache,     "revalidateCache",        false                  );
 SETTING(demCache,            "demCache",               DEM_CACHE              );
+SETTING(imgCache,            "imgCache",               IMG_CACHE              );
+SETTING(dataCache,           "dataCache",              DATA_CACHE             );
+SETTING(tileCache,           "tileCache",              TILE_CACHE             );
+SETTING(prefetchRing,        "prefetchRing",           1                      );
+SETTING(renderThreads,       "renderThreads",          0                      );
+SETTING(parseThreads,        "parseThreads",           0                      );
 SETTING(connectionTimeout,   "connectionTimeout",      30                     );
 SETTING(hiresPrint,          "hiresPrint",             false                  );
 SETTING(printName,           "printName",              true                   );
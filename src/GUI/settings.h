@@ -121,6 +121,7 @@ public:
 	static const Setting waypointIcons;
 	static const Setting waypointLabels;
 	static const Setting pathTicks;
+	static const Setting heatmap;
 	static const Setting legend;
 	static const Setting positionMarkers;
 	static const Setting markerInfo;
@@ -144,6 +145,7 @@ public:
 	static const Setting pdfMarginBottom;
 	static const Setting pdfFileName;
 	static const Setting pdfResolution;
+	static const Setting pdfMapPages;
 
 	/* PNG export */
 	static const Setting pngWidth;
@@ -182,6 +184,7 @@ public:
 	static const Setting heartRateFilter;
 	static const Setting cadenceFilter;
 	static const Setting powerFilter;
+	static const Setting filterType;
 	static const Setting outlierEliminate;
 	static const Setting detectPauses;
 	static const Setting automaticPause;
@@ -206,8 +209,16 @@ public:
 	static const Setting hillshadingZFactor;
 	static const Setting useOpenGL;
 	static const Setting enableHTTP2;
-	static const Setting pixmapCache;
+	static const Setting revalidateCache;
+	static const Setting &pixmapCache();
+	static const Setting &tileImageCache();
 	static const Setting demCache;
+	static const Setting imgCache;
+	static const Setting dataCache;
+	static const Setting tileCache;
+	static const Setting prefetchRing;
+	static const Setting renderThreads;
+	static const Setting parseThreads;
 	static const Setting connectionTimeout;
 	static const Setting hiresPrint;
 	static const Setting printName;
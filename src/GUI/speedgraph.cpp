@@ -104,6 +104,55 @@ QList<GraphItem*> SpeedGraph::loadData(const Data &data, Map *map)
 	return graphs;
 }
 
+GraphPair SpeedGraph::appendedData(const Track &track, int from, Map *map)
+  const
+{
+	Q_UNUSED(map);
+	return track.speed(from);
+}
+
+int SpeedGraph::series() const
+{
+	return (1 << Track::ReportedSpeed) | (1 << Track::ComputedSpeed);
+}
+
+/* The secondary graphs directly follow their primary graphs in _tracks while
+   the summary vectors are indexed by the primary graphs only */
+void SpeedGraph::removeData(const QList<GraphItem*> &graphs)
+{
+	for (int i = 0; i < graphs.size(); i++) {
+		GraphItem *gi = graphs.at(i);
+		int idx = -1, pi = 0;
+
+		if (!gi)
+			continue;
+		for (int j = 0; j < _tracks.size(); j++) {
+			if (_tracks.at(j) == gi) {
+				idx = j;
+				break;
+			}
+			if (!j || _tracks.at(j-1)->secondaryGraph() != _tracks.at(j))
+				pi++;
+		}
+		if (idx < 0)
+			continue;
+
+		if (gi->secondaryGraph()) {
+			removeGraph(gi->secondaryGraph());
+			delete _tracks.takeAt(idx + 1);
+		}
+		removeGraph(gi);
+		delete _tracks.takeAt(idx);
+
+		_avg.remove(pi);
+		_mavg.remove(pi);
+		_max.remove(pi);
+	}
+
+	setInfo();
+	redraw();
+}
+
 qreal SpeedGraph::avg() const
 {
 	qreal sum = 0, w = 0;
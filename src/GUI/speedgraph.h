@@ -17,6 +17,9 @@ public:
 
 	QString label() const {return tr("Speed");}
 	QList<GraphItem*> loadData(const Data &data, Map *map);
+	GraphPair appendedData(const Track &track, int from, Map *map) const;
+	int series() const;
+	void removeData(const QList<GraphItem*> &graphs);
 	void clear();
 	void setUnits(Units units);
 	void setTimeType(TimeType type);
@@ -0,0 +1,29 @@
+#include <QtGlobal>
+#include "startupprofile.h"
+
+bool StartupProfile::_enabled = false;
+QElapsedTimer StartupProfile::_timer;
+qint64 StartupProfile::_last = 0;
+
+void StartupProfile::start()
+{
+	_enabled = true;
+	_last = 0;
+	_timer.start();
+}
+
+void StartupProfile::mark(const char *phase)
+{
+	if (!_enabled)
+		return;
+
+	qint64 now = _timer.elapsed();
+	qInfo("startup: %6lld ms (%5lld ms) %s", now, now - _last, phase);
+	_last = now;
+}
+
+void StartupProfile::finish()
+{
+	mark("startup finished");
+	_enabled = false;
+}
@@ -0,0 +1,24 @@
+#ifndef STARTUPPROFILE_H
+#define STARTUPPROFILE_H
+
+#include <QElapsedTimer>
+
+/* Startup timeline enabled with the --startup-profile command line option.
+   Every mark() logs the time since the program start and the duration of the
+   phase that ended with the mark. */
+class StartupProfile
+{
+public:
+	static void start();
+	static void mark(const char *phase);
+	static void finish();
+
+	static bool isEnabled() {return _enabled;}
+
+private:
+	static bool _enabled;
+	static QElapsedTimer _timer;
+	static qint64 _last;
+};
+
+#endif // STARTUPPROFILE_H
@@ -83,6 +83,35 @@ QList<GraphItem*> TemperatureGraph::loadData(const Data &data, Map *map)
 	return graphs;
 }
 
+GraphPair TemperatureGraph::appendedData(const Track &track, int from, Map *map)
+  const
+{
+	Q_UNUSED(map);
+	return GraphPair(track.temperature(from), Graph());
+}
+
+int TemperatureGraph::series() const
+{
+	return 1 << Track::Temperature;
+}
+
+void TemperatureGraph::removeData(const QList<GraphItem*> &graphs)
+{
+	for (int i = 0; i < graphs.size(); i++) {
+		int idx = _tracks.indexOf(
+		  static_cast<TemperatureGraphItem*>(graphs.at(i)));
+		if (idx < 0)
+			continue;
+
+		removeGraph(_tracks.at(idx));
+		delete _tracks.takeAt(idx);
+		_avg.remove(idx);
+	}
+
+	setInfo();
+	redraw();
+}
+
 qreal TemperatureGraph::avg() const
 {
 	qreal sum = 0, w = 0;
@@ -15,6 +15,9 @@ public:
 
 	QString label() const {return tr("Temperature");}
 	QList<GraphItem*> loadData(const Data &data, Map *map);
+	GraphPair appendedData(const Track &track, int from, Map *map) const;
+	int series() const;
+	void removeData(const QList<GraphItem*> &graphs);
 	void clear();
 	void setUnits(enum Units units);
 	void showTracks(bool show);
@@ -1,32 +1,12 @@
-#include <QImageReader>
 #include <QDesktopServices>
 #include <QFileInfo>
 #include <QMouseEvent>
 #include "thumbnail.h"
 
-static QSize thumbnailSize(const QSize &size, int limit)
+Thumbnail::Thumbnail(const QString &path, const QImage &image,
+  QWidget *parent) : QLabel(parent)
 {
-	int width, height;
-	if (size.width() > size.height()) {
-		width = qMin(size.width(), limit);
-		qreal ratio = size.width() / (qreal)size.height();
-		height = (int)(width / ratio);
-	} else {
-		height = qMin(size.height(), limit);
-		qreal ratio = size.height() / (qreal)size.width();
-		width = (int)(height / ratio);
-	}
-
-	return QSize(width, height);
-}
-
-Thumbnail::Thumbnail(const QString &path, int limit, QWidget *parent)
-  : QLabel(parent)
-{
-	QImageReader reader(path);
-	reader.setAutoTransform(true);
-	reader.setScaledSize(thumbnailSize(reader.size(), limit));
-	setPixmap(QPixmap::fromImage(reader.read()));
+	setPixmap(QPixmap::fromImage(image));
 
 	setCursor(Qt::PointingHandCursor);
 
@@ -3,12 +3,12 @@
 
 #include <QLabel>
 
-class ImageInfo;
+class QImage;
 
 class Thumbnail : public QLabel
 {
 public:
-	Thumbnail(const QString &path, int limit, QWidget *parent = 0);
+	Thumbnail(const QString &path, const QImage &image, QWidget *parent = 0);
 
 protected:
 	void mousePressEvent(QMouseEvent *event);
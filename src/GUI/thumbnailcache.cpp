@@ -0,0 +1,191 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDataStream>
+#include <QImageReader>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include "common/programpaths.h"
+#include "common/tifffile.h"
+#include "common/threadpools.h"
+#include "thumbnailcache.h"
+
+#define SOI_MARKER  0xFFD8
+#define SOS_MARKER  0xFFDA
+#define APP1_MARKER 0xFFE1
+
+#define Orientation                 274
+#define JPEGInterchangeFormat       513
+#define JPEGInterchangeFormatLength 514
+
+#define SOURCE_KEY "Source"
+
+static QSize thumbnailSize(const QSize &size, int limit)
+{
+	int width, height;
+	if (size.width() > size.height()) {
+		width = qMin(size.width(), limit);
+		qreal ratio = size.width() / (qreal)size.height();
+		height = (int)(width / ratio);
+	} else {
+		height = qMin(size.height(), limit);
+		qreal ratio = size.height() / (qreal)size.width();
+		width = (int)(height / ratio);
+	}
+
+	return QSize(width, height);
+}
+
+static QString cacheFile(const QFileInfo &fi, int limit)
+{
+	QByteArray hash(QCryptographicHash::hash(fi.absoluteFilePath().toUtf8()
+	  + '\0' + QByteArray::number(limit), QCryptographicHash::Sha1));
+
+	return QDir(ProgramPaths::thumbnailCacheDir()).filePath(
+	  QString::fromLatin1(hash.toHex()) + ".png");
+}
+
+static QString source(const QFileInfo &fi)
+{
+	return QString::number(fi.size()) + ":"
+	  + QString::number(fi.lastModified().toMSecsSinceEpoch());
+}
+
+static bool readIFD(TIFFFile &tiff, quint32 offset, quint32 &orientation,
+  quint32 &jpeg, quint32 &jpegLength, quint32 &next)
+{
+	quint16 count;
+
+	if (!tiff.seek(offset) || !tiff.readValue(count))
+		return false;
+
+	for (quint16 i = 0; i < count; i++) {
+		quint16 tag, type;
+		quint32 cnt, value;
+
+		if (!(tiff.readValue(tag) && tiff.readValue(type)
+		  && tiff.readValue(cnt) && tiff.readValue(value)))
+			return false;
+
+		/* SHORT values are left-aligned in the value field */
+		if (type == TIFF_SHORT && tiff.isBE())
+			value >>= 16;
+		else if (type == TIFF_SHORT)
+			value &= 0xFFFF;
+
+		if (tag == Orientation)
+			orientation = value;
+		else if (tag == JPEGInterchangeFormat)
+			jpeg = value;
+		else if (tag == JPEGInterchangeFormatLength)
+			jpegLength = value;
+	}
+
+	return tiff.readValue(next);
+}
+
+/* The EXIF thumbnail is the JPEG image referenced from IFD1. Images
+   with a non-default orientation are skipped as the embedded thumbnails
+   are not transformed. */
+static QByteArray exifThumbnail(const QString &path)
+{
+	QFile file(path);
+	quint16 marker, size;
+
+	if (!file.open(QIODevice::ReadOnly))
+		return QByteArray();
+
+	QDataStream stream(&file);
+	stream.setByteOrder(QDataStream::BigEndian);
+	stream >> marker;
+	if (marker != SOI_MARKER)
+		return QByteArray();
+
+	while (true) {
+		stream >> marker >> size;
+		if (stream.status() != QDataStream::Ok || marker == SOS_MARKER
+		  || size < 2)
+			return QByteArray();
+
+		if (marker == APP1_MARKER) {
+			char magic[6];
+			if (stream.readRawData(magic, sizeof(magic)) == sizeof(magic)
+			  && !memcmp(magic, "Exif\0\0", sizeof(magic)))
+				break;
+			file.seek(file.pos() + size - 2 - sizeof(magic));
+		} else
+			file.seek(file.pos() + size - 2);
+	}
+
+	TIFFFile tiff(&file);
+	if (!tiff.isValid())
+		return QByteArray();
+
+	quint32 orientation = 1, jpeg = 0, jpegLength = 0, ifd1 = 0, next;
+	if (!readIFD(tiff, tiff.ifd(), orientation, jpeg, jpegLength, ifd1)
+	  || orientation != 1 || !ifd1)
+		return QByteArray();
+	if (!readIFD(tiff, ifd1, orientation, jpeg, jpegLength, next)
+	  || !jpeg || !jpegLength || !tiff.seek(jpeg))
+		return QByteArray();
+
+	QByteArray data(tiff.read(jpegLength));
+	return (data.size() == (int)jpegLength) ? data : QByteArray();
+}
+
+static QImage decode(const QString &path, int limit)
+{
+	QImageReader reader(path);
+	QSize size(thumbnailSize(reader.size(), limit));
+
+	QByteArray exif(exifThumbnail(path));
+	if (!exif.isEmpty()) {
+		QBuffer buffer(&exif);
+		QImageReader er(&buffer);
+		QSize es(er.size());
+		/* Some cameras pad the thumbnail to 4:3, skip those */
+		if (es.width() >= size.width() && es.height() >= size.height()
+		  && qAbs(es.width() * size.height() - es.height() * size.width())
+		  <= es.width() * size.height() / 50) {
+			er.setScaledSize(size);
+			QImage img(er.read());
+			if (!img.isNull())
+				return img;
+		}
+	}
+
+	reader.setAutoTransform(true);
+	reader.setScaledSize(size);
+	return reader.read();
+}
+
+void ThumbnailCache::Entry::load()
+{
+	QFileInfo fi(_path);
+	/* Non-file (e.g. Android content://) images are not cached */
+	if (!fi.exists()) {
+		_image = decode(_path, _limit);
+		return;
+	}
+
+	QString file(cacheFile(fi, _limit));
+	QString src(source(fi));
+
+	if (_image.load(file, "PNG") && _image.text(SOURCE_KEY) == src)
+		return;
+
+	_image = decode(_path, _limit);
+	if (_image.isNull())
+		return;
+
+	_image.setText(SOURCE_KEY, src);
+	if (QDir().mkpath(ProgramPaths::thumbnailCacheDir())
+	  && !_image.save(file, "PNG"))
+		qWarning("%s: error writing thumbnail cache file",
+		  qUtf8Printable(file));
+}
+
+void ThumbnailCache::load(QList<Entry> &entries)
+{
+	ThreadPools::blockingMap(ThreadPools::Parse, entries, &Entry::load);
+}
@@ -0,0 +1,36 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QImage>
+#include <QList>
+#include <QString>
+
+/* On-disk cache of the image thumbnails. The entries are keyed by the image
+   path and the thumbnail size limit and are valid as long as the image file
+   size and modification time match the ones stored in the entry. On a cache
+   miss, the embedded EXIF thumbnail is used when it is big enough, otherwise
+   the image is decoded at the reduced (thumbnail) size. */
+class ThumbnailCache
+{
+public:
+	class Entry {
+	public:
+		Entry() : _limit(0) {}
+		Entry(const QString &path, int limit) : _path(path), _limit(limit) {}
+
+		const QString &path() const {return _path;}
+		const QImage &image() const {return _image;}
+
+		void load();
+
+	private:
+		QString _path;
+		int _limit;
+		QImage _image;
+	};
+
+	/* Loads the thumbnails in parallel on the global thread pool */
+	static void load(QList<Entry> &entries);
+};
+
+#endif // THUMBNAILCACHE_H
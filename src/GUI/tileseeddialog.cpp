@@ -0,0 +1,100 @@
+#include <QVBoxLayout>
+#include <QFormLayout>
+#include <QDialogButtonBox>
+#include <QComboBox>
+#include <QSpinBox>
+#include <QDoubleSpinBox>
+#include "tileseeddialog.h"
+
+
+TileSeedDialog::TileSeedDialog(TileSeed &seed, const Range &zooms,
+  Units units, QWidget *parent) : QDialog(parent), _seed(seed)
+{
+	int index;
+
+#ifdef Q_OS_ANDROID
+	setWindowFlags(Qt::Window);
+	setWindowState(Qt::WindowFullScreen);
+#endif /* Q_OS_ANDROID */
+
+	_area = new QComboBox();
+	_area->addItem(tr("Visible map area"), TileSeed::Visible);
+	_area->addItem(tr("Data area"), TileSeed::Data);
+	_area->addItem(tr("Tracks/routes corridor"), TileSeed::Corridor);
+	if ((index = _area->findData(_seed.area)) >= 0)
+		_area->setCurrentIndex(index);
+	connect(_area, QOverload<int>::of(&QComboBox::currentIndexChanged), this,
+	  &TileSeedDialog::areaChanged);
+
+	QString unit;
+	if (units == Imperial) {
+		_unit = MIINM;
+		unit = tr("mi");
+	} else if (units == Nautical) {
+		_unit = NMIINM;
+		unit = tr("nmi");
+	} else {
+		_unit = KMINM;
+		unit = tr("km");
+	}
+	_radius = new QDoubleSpinBox();
+	_radius->setDecimals(1);
+	_radius->setMinimum(0.1);
+	_radius->setMaximum(100.0);
+	_radius->setSingleStep(0.5);
+	_radius->setSuffix(UNIT_SPACE + unit);
+	_radius->setValue(_seed.radius / _unit);
+	_radius->setToolTip(tr("Distance from the track/route"));
+
+	_minZoom = new QSpinBox();
+	_minZoom->setRange(zooms.min(), zooms.max());
+	_minZoom->setValue(qBound(zooms.min(), _seed.zooms.min(), zooms.max()));
+	_maxZoom = new QSpinBox();
+	_maxZoom->setRange(zooms.min(), zooms.max());
+	_maxZoom->setValue(qBound(zooms.min(), _seed.zooms.max(), zooms.max()));
+
+	QHBoxLayout *zoomLayout = new QHBoxLayout();
+	zoomLayout->addWidget(_minZoom);
+	zoomLayout->addWidget(_maxZoom);
+
+	QFormLayout *formLayout = new QFormLayout();
+	formLayout->addRow(tr("Area:"), _area);
+	formLayout->addRow(tr("Corridor radius:"), _radius);
+	formLayout->addRow(tr("Zoom levels:"), zoomLayout);
+
+	QDialogButtonBox *buttonBox = new QDialogButtonBox();
+	buttonBox->addButton(tr("Download"), QDialogButtonBox::AcceptRole);
+	buttonBox->addButton(QDialogButtonBox::Cancel);
+	connect(buttonBox, &QDialogButtonBox::accepted, this,
+	  &TileSeedDialog::accept);
+	connect(buttonBox, &QDialogButtonBox::rejected, this,
+	  &TileSeedDialog::reject);
+
+	QVBoxLayout *layout = new QVBoxLayout;
+	layout->addLayout(formLayout);
+#ifdef Q_OS_ANDROID
+	layout->addStretch();
+#endif // Q_OS_ANDROID
+	layout->addWidget(buttonBox);
+	setLayout(layout);
+
+	areaChanged();
+
+	setWindowTitle(tr("Download Map Tiles"));
+	setWindowFlags(windowFlags() & ~Qt::WindowContextHelpButtonHint);
+}
+
+void TileSeedDialog::areaChanged()
+{
+	_radius->setEnabled(_area->currentData().toInt() == TileSeed::Corridor);
+}
+
+void TileSeedDialog::accept()
+{
+	_seed.area = (TileSeed::Area)_area->currentData().toInt();
+	_seed.radius = _radius->value() * _unit;
+	_seed.zooms = Range(qMin(_minZoom->value(), _maxZoom->value()),
+	  qMax(_minZoom->value(), _maxZoom->value()));
+
+	QDialog::accept();
+}
@@ -0,0 +1,49 @@
+#ifndef TILESEEDDIALOG_H
+#define TILESEEDDIALOG_H
+
+#include <QDialog>
+#include "common/range.h"
+#include "units.h"
+
+class QComboBox;
+class QSpinBox;
+class QDoubleSpinBox;
+
+struct TileSeed
+{
+	enum Area {
+		Visible,
+		Data,
+		Corridor
+	};
+
+	Area area;
+	Range zooms;
+	qreal radius;
+};
+
+class TileSeedDialog : public QDialog
+{
+	Q_OBJECT
+
+public:
+	TileSeedDialog(TileSeed &seed, const Range &zooms, Units units,
+	  QWidget *parent = 0);
+
+public slots:
+	void accept();
+
+private slots:
+	void areaChanged();
+
+private:
+	TileSeed &_seed;
+	qreal _unit;
+
+	QComboBox *_area;
+	QDoubleSpinBox *_radius;
+	QSpinBox *_minZoom;
+	QSpinBox *_maxZoom;
+};
+
+#endif // TILESEEDDIALOG_H
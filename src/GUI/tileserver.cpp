@@ -0,0 +1,184 @@
+#include <QTcpSocket>
+#include <QFileInfo>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QBuffer>
+#include <QImage>
+#include <QPainter>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include "common/programpaths.h"
+#include "map/map.h"
+#include "map/osm.h"
+#include "tileserver.h"
+
+#define TILE_SIZE    256
+#define MAX_REQUEST  8192
+#define SERVER_DIR   "server"
+
+TileServer::TileServer(Map *map, bool hillShading, QObject *parent)
+  : QObject(parent), _map(map), _hillShading(hillShading), _busy(false)
+{
+	QFileInfo fi(map->path());
+	QByteArray key(fi.absoluteFilePath().toUtf8() + '\n'
+	  + QByteArray::number(fi.lastModified().toMSecsSinceEpoch()) + '\n'
+	  + QByteArray::number(hillShading));
+
+	_id = QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+	_cacheDir = QDir(ProgramPaths::tilesDir()).filePath(QString(SERVER_DIR)
+	  + "/" + QString::fromLatin1(_id));
+
+	connect(&_server, &QTcpServer::newConnection, this,
+	  &TileServer::newConnection);
+}
+
+bool TileServer::listen(quint16 port)
+{
+	return _server.listen(QHostAddress::Any, port);
+}
+
+void TileServer::newConnection()
+{
+	QTcpSocket *socket;
+
+	while ((socket = _server.nextPendingConnection())) {
+		connect(socket, &QTcpSocket::readyRead, this,
+		  &TileServer::readRequest);
+		connect(socket, &QTcpSocket::disconnected, socket,
+		  &QObject::deleteLater);
+	}
+}
+
+void TileServer::reply(QTcpSocket *socket, const QByteArray &status,
+  const QByteArray &etag, const QByteArray &data)
+{
+	QByteArray header("HTTP/1.1 " + status + "\r\n");
+
+	if (!etag.isEmpty())
+		header.append("ETag: " + etag + "\r\n");
+	if (!data.isEmpty())
+		header.append("Content-Type: image/png\r\n");
+	header.append("Content-Length: " + QByteArray::number(data.size())
+	  + "\r\nConnection: close\r\n\r\n");
+
+	socket->write(header);
+	socket->write(data);
+	socket->disconnectFromHost();
+}
+
+/* Drawing the map may run a nested event loop (online maps), the requests
+   received meanwhile are postponed as the map can only draw one tile at
+   a time. */
+void TileServer::readRequest()
+{
+	QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+
+	if (_busy) {
+		if (!_pending.contains(socket))
+			_pending.append(socket);
+		return;
+	}
+
+	_busy = true;
+	handleRequest(socket);
+	while (!_pending.isEmpty()) {
+		QPointer<QTcpSocket> s(_pending.takeFirst());
+		if (s)
+			handleRequest(s);
+	}
+	_busy = false;
+}
+
+/* Only the request line and the If-None-Match header are of interest,
+   the connection is closed after every reply. */
+void TileServer::handleRequest(QTcpSocket *socket)
+{
+	QByteArray request(socket->peek(MAX_REQUEST));
+	int end = request.indexOf("\r\n\r\n");
+
+	if (end < 0) {
+		if (request.size() >= MAX_REQUEST)
+			reply(socket, "400 Bad Request");
+		return;
+	}
+	socket->read(end + 4);
+
+	QList<QByteArray> lines(request.left(end).split('\n'));
+	QList<QByteArray> rl(lines.first().trimmed().split(' '));
+	if (rl.size() != 3 || rl.at(0) != "GET") {
+		reply(socket, "405 Method Not Allowed");
+		return;
+	}
+
+	QList<QByteArray> path(rl.at(1).split('/'));
+	bool zok = false, xok = false, yok = false;
+	int z = (path.size() == 4) ? path.at(1).toInt(&zok) : -1;
+	int x = (path.size() == 4) ? path.at(2).toInt(&xok) : -1;
+	int y = (path.size() == 4 && path.at(3).endsWith(".png"))
+	  ? path.at(3).left(path.at(3).size() - 4).toInt(&yok) : -1;
+	if (z < OSM::ZOOMS.min() || z > OSM::ZOOMS.max() || !zok || !xok
+	  || !yok || x < 0 || y < 0 || x >= (1<<z) || y >= (1<<z)) {
+		reply(socket, "404 Not Found");
+		return;
+	}
+
+	QByteArray etag("\"" + _id + "-" + QByteArray::number(z) + "-"
+	  + QByteArray::number(x) + "-" + QByteArray::number(y) + "\"");
+	for (int i = 1; i < lines.size(); i++) {
+		QByteArray line(lines.at(i).trimmed());
+		if (line.toLower().startsWith("if-none-match:")
+		  && line.mid(14).trimmed() == etag) {
+			reply(socket, "304 Not Modified", etag);
+			return;
+		}
+	}
+
+	QByteArray data;
+	if (tile(z, x, y, data))
+		reply(socket, "200 OK", etag, data);
+	else
+		reply(socket, "500 Internal Server Error");
+}
+
+bool TileServer::tile(int z, int x, int y, QByteArray &data)
+{
+	QString file(QString("%1/%2/%3/%4.png").arg(_cacheDir).arg(z).arg(x)
+	  .arg(y));
+
+	QFile cached(file);
+	if (cached.open(QIODevice::ReadOnly)) {
+		data = cached.readAll();
+		return true;
+	}
+
+	RectC rect(OSM::tile2ll(QPoint(x, y), z),
+	  OSM::tile2ll(QPoint(x + 1, y + 1), z));
+	_map->zoomFit(QSize(TILE_SIZE, TILE_SIZE), rect);
+	QRectF src(_map->ll2xy(rect.topLeft()), _map->ll2xy(rect.bottomRight()));
+
+	QImage img(TILE_SIZE, TILE_SIZE, QImage::Format_ARGB32_Premultiplied);
+	img.fill(Qt::transparent);
+	QPainter painter(&img);
+	painter.setRenderHints(QPainter::Antialiasing
+	  | QPainter::SmoothPixmapTransform);
+	painter.scale(TILE_SIZE / src.width(), TILE_SIZE / src.height());
+	painter.translate(-src.topLeft());
+	_map->draw(&painter, src.intersected(_map->bounds()), _hillShading
+	  ? Map::Block | Map::HillShading : Map::Block);
+	painter.end();
+
+	QBuffer buffer(&data);
+	buffer.open(QIODevice::WriteOnly);
+	if (!img.save(&buffer, "png"))
+		return false;
+
+	QDir().mkpath(QFileInfo(file).absolutePath());
+	QSaveFile out(file);
+	if (out.open(QIODevice::WriteOnly)) {
+		out.write(data);
+		out.commit();
+	}
+
+	return true;
+}
@@ -0,0 +1,47 @@
+#ifndef TILESERVER_H
+#define TILESERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QString>
+#include <QPointer>
+#include <QList>
+
+class QTcpSocket;
+class Map;
+
+/* Minimal HTTP server providing the /{z}/{x}/{y}.png Web Mercator tiles of
+   a map. The rendered tiles are cached on disk (per map and map file
+   modification time) and served with ETags, so the clients can revalidate
+   their cached tiles. */
+class TileServer : public QObject
+{
+	Q_OBJECT
+
+public:
+	TileServer(Map *map, bool hillShading, QObject *parent = 0);
+
+	bool listen(quint16 port);
+	QString errorString() const {return _server.errorString();}
+
+private slots:
+	void newConnection();
+	void readRequest();
+
+private:
+	void handleRequest(QTcpSocket *socket);
+	bool tile(int z, int x, int y, QByteArray &data);
+	void reply(QTcpSocket *socket, const QByteArray &status,
+	  const QByteArray &etag = QByteArray(),
+	  const QByteArray &data = QByteArray());
+
+	QTcpServer _server;
+	Map *_map;
+	bool _hillShading;
+	QString _cacheDir;
+	QByteArray _id;
+	QList<QPointer<QTcpSocket> > _pending;
+	bool _busy;
+};
+
+#endif // TILESERVER_H
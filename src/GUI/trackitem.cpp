@@ -62,3 +62,12 @@ TrackItem::TrackItem(const Track &track, Map *map, QGraphicsItem *parent)
 	_movingTime = track.movingTime();
 	_file = track.file();
 }
+
+/* Live data - the track points appended from point index from on */
+void TrackItem::append(const Track &track, int from)
+{
+	PathItem::append(track.path(from));
+
+	_time = track.time();
+	_movingTime = track.movingTime();
+}
@@ -16,6 +16,8 @@ public:
 
 	ToolTip info(bool extended) const;
 
+	void append(const Track &track, int from);
+
 private:
 	qreal _time;
 	qreal _movingTime;
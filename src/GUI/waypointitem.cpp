@@ -2,6 +2,7 @@
 #include <QPainter>
 #include <QGraphicsSceneMouseEvent>
 #include <QLabel>
+#include <QPixmapCache>
 #include "font.h"
 #include "popup.h"
 #include "waypointitem.h"
@@ -16,6 +17,22 @@ Units WaypointItem::_units = Metric;
 CoordinatesFormat WaypointItem::_format = DecimalDegrees;
 QTimeZone WaypointItem::_timeZone = QTimeZone::utc();
 
+/* The style icons are loaded as QImages in the parser threads, the pixmaps
+   are created on the GUI thread and shared between all the items with the
+   same icon */
+static QPixmap styleIcon(const QImage &img)
+{
+	QString key("wpt_" + QString::number(img.cacheKey()));
+	QPixmap pm;
+
+	if (!QPixmapCache::find(key, &pm)) {
+		pm = QPixmap::fromImage(img);
+		QPixmapCache::insert(key, pm);
+	}
+
+	return pm;
+}
+
 ToolTip WaypointItem::info(bool extended) const
 {
 	Q_UNUSED(extended);
@@ -82,9 +99,12 @@ WaypointItem::WaypointItem(const Waypoint &waypoint, Map *map,
 	_size = 8;
 	_color = Qt::black;
 
-	_icon = (_waypoint.style().icon().isNull())
-	  ? Waypoint::symbolIcon(_waypoint.symbol())
-	  : &_waypoint.style().icon();
+	if (_waypoint.style().icon().isNull())
+		_icon = Waypoint::symbolIcon(_waypoint.symbol());
+	else {
+		_styleIcon = styleIcon(_waypoint.style().icon());
+		_icon = &_styleIcon;
+	}
 
 	_font.setPixelSize(FS(size()));
 	_font.setFamily(FONT_FAMILY);
@@ -106,7 +126,7 @@ void WaypointItem::updateCache()
 {
 	QPainterPath p;
 	qreal pointSize = _font.bold() ? HS(size()) : size();
-	const QPixmap &icon = _waypoint.style().icon();
+	const QImage &icon = _waypoint.style().icon();
 
 	if (_showLabel && !_waypoint.name().isEmpty()) {
 		QFontMetrics fm(_font);
@@ -156,7 +176,7 @@ void WaypointItem::paint(QPainter *painter,
 	Q_UNUSED(option);
 	Q_UNUSED(widget);
 	qreal pointSize = _font.bold() ? HS(size()) : size();
-	const QPixmap &icon = _waypoint.style().icon();
+	const QImage &icon = _waypoint.style().icon();
 
 	painter->setPen(color());
 
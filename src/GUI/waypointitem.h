@@ -61,6 +61,7 @@ private:
 	QFont _font;
 	QRect _labelBB;
 	const QPixmap *_icon;
+	QPixmap _styleIcon;
 	QPainterPath _shape;
 
 	static Units _units;
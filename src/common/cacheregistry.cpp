@@ -0,0 +1,81 @@
+#include "cacheregistry.h"
+
+/* Function-local statics, the caches may be static objects themselves */
+QMutex &CacheRegistry::lock()
+{
+	static QMutex lock;
+	return lock;
+}
+
+QList<CacheRegistry::Entry*> &CacheRegistry::entries()
+{
+	static QList<Entry*> list;
+	return list;
+}
+
+CacheRegistry::Entry::Entry(const char *name, Unit unit, QMutex *lock)
+  : _name(name), _unit(unit), _lock(lock)
+{
+	QMutexLocker locker(&CacheRegistry::lock());
+	CacheRegistry::entries().append(this);
+}
+
+CacheRegistry::Entry::~Entry()
+{
+	QMutexLocker locker(&CacheRegistry::lock());
+	CacheRegistry::entries().removeOne(this);
+}
+
+QList<CacheRegistry::Stats> CacheRegistry::stats()
+{
+	QMutexLocker locker(&lock());
+	const QList<Entry*> &list = entries();
+	QList<Stats> stats;
+
+	for (int i = 0; i < list.size(); i++) {
+		const Entry *e = list.at(i);
+		qint64 size, limit;
+
+		if (e->_lock)
+			e->_lock->lock();
+		e->cost(size, limit);
+		if (e->_lock)
+			e->_lock->unlock();
+
+		int j;
+		for (j = 0; j < stats.size(); j++)
+			if (stats.at(j).name == e->_name)
+				break;
+		if (j == stats.size()) {
+			Stats s;
+			s.name = e->_name;
+			s.unit = e->_unit;
+			stats.append(s);
+		}
+
+		Stats &s = stats[j];
+		s.instances++;
+		s.size += size;
+		s.limit += limit;
+		s.hits += e->hits();
+		s.misses += e->misses();
+	}
+
+	return stats;
+}
+
+void CacheRegistry::clear()
+{
+	QMutexLocker locker(&lock());
+	const QList<Entry*> &list = entries();
+
+	for (int i = 0; i < list.size(); i++) {
+		Entry *e = list.at(i);
+
+		if (e->_lock)
+			e->_lock->lock();
+		e->purge();
+		if (e->_lock)
+			e->_lock->unlock();
+	}
+}
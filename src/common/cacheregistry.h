@@ -0,0 +1,99 @@
+#ifndef CACHEREGISTRY_H
+#define CACHEREGISTRY_H
+
+#include <QCache>
+#include <QList>
+#include <QString>
+#include <QMutex>
+#include <QAtomicInt>
+
+/* Registry of the program caches for the cache statistics. Every cache
+   instance registers itself on construction, the statistics of all the
+   instances with the same name (e.g. the caches of all the loaded maps of
+   the same type) are summed up. */
+class CacheRegistry
+{
+public:
+	enum Unit {KB, Items};
+
+	struct Stats
+	{
+		Stats() : unit(KB), instances(0), size(0), limit(0), hits(0),
+		  misses(0) {}
+
+		QString name;
+		Unit unit;
+		int instances;
+		qint64 size, limit;
+		quint64 hits, misses;
+	};
+
+	class Entry
+	{
+	public:
+		/* lock is the lock the cache owner guards the cache with (if the
+		   cache is used from multiple threads) */
+		Entry(const char *name, Unit unit, QMutex *lock = 0);
+		virtual ~Entry();
+
+		void hit() const {_hits.ref();}
+		void miss() const {_misses.ref();}
+		quint64 hits() const {return (uint)_hits.loadRelaxed();}
+		quint64 misses() const {return (uint)_misses.loadRelaxed();}
+
+	protected:
+		/* Called with the cache lock held */
+		virtual void cost(qint64 &size, qint64 &limit) const = 0;
+		virtual void purge() = 0;
+
+	private:
+		Q_DISABLE_COPY(Entry)
+
+		const char *_name;
+		Unit _unit;
+		QMutex *_lock;
+		mutable QAtomicInt _hits, _misses;
+
+		friend class CacheRegistry;
+	};
+
+	static QList<Stats> stats();
+	/* Drops the content of all the caches (on low memory), must be called
+	   from the GUI thread as some caches have no lock */
+	static void clear();
+
+private:
+	static QMutex &lock();
+	static QList<Entry*> &entries();
+};
+
+/* QCache that counts the object() hits/misses and reports its cost to the
+   registry */
+template <class Key, class T>
+class StatsCache : public QCache<Key, T>, public CacheRegistry::Entry
+{
+public:
+	StatsCache(const char *name, CacheRegistry::Unit unit,
+	  QMutex *lock = 0, int maxCost = 100)
+	  : QCache<Key, T>(maxCost), CacheRegistry::Entry(name, unit, lock) {}
+
+	T *object(const Key &key) const
+	{
+		T *obj = QCache<Key, T>::object(key);
+		if (obj)
+			hit();
+		else
+			miss();
+		return obj;
+	}
+
+protected:
+	void cost(qint64 &size, qint64 &limit) const
+	{
+		size = this->totalCost();
+		limit = this->maxCost();
+	}
+	void purge() {this->clear();}
+};
+
+#endif // CACHEREGISTRY_H
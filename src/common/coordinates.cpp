@@ -1,14 +1,37 @@
 #include "wgs84.h"
 #include "coordinates.h"
 
+static inline double haversine(double lat1, double lon1, double cos1,
+  double lat2, double lon2, double cos2)
+{
+	double sLat = sin(deg2rad(lat2 - lat1) / 2.0);
+	double sLon = sin(deg2rad(lon2 - lon1) / 2.0);
+	double a = sLat * sLat + cos1 * cos2 * sLon * sLon;
+
+	/* 2*asin(sqrt(a)) == 2*atan2(sqrt(a), sqrt(1-a)), a can only get
+	   (slightly) above 1 due to rounding errors */
+	return (WGS84_RADIUS * 2.0 * asin(sqrt(qMin(a, 1.0))));
+}
+
 double Coordinates::distanceTo(const Coordinates &c) const
 {
-	double dLat = deg2rad(c.lat() - _lat);
-	double dLon = deg2rad(c.lon() - _lon);
-	double a = pow(sin(dLat / 2.0), 2.0)
-	  + cos(deg2rad(_lat)) * cos(deg2rad(c.lat())) * pow(sin(dLon / 2.0), 2.0);
+	return haversine(_lat, _lon, cos(deg2rad(_lat)), c.lat(), c.lon(),
+	  cos(deg2rad(c.lat())));
+}
+
+void Coordinates::distances(const Coordinates *c, int n, double *d)
+{
+	if (n < 2)
+		return;
 
-	return (WGS84_RADIUS * (2.0 * atan2(sqrt(a), sqrt(1.0 - a))));
+	/* Every point's cos(lat) is computed only once */
+	double cos1 = cos(deg2rad(c[0].lat()));
+	for (int i = 1; i < n; i++) {
+		double cos2 = cos(deg2rad(c[i].lat()));
+		d[i-1] = haversine(c[i-1].lat(), c[i-1].lon(), cos1, c[i].lat(),
+		  c[i].lon(), cos2);
+		cos1 = cos2;
+	}
 }
 
 #ifndef QT_NO_DEBUG
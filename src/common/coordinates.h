@@ -28,6 +28,9 @@ public:
 	    && _lat >= -90.0 && _lat <= 90.0);}
 
 	double distanceTo(const Coordinates &c) const;
+	/* Distances of the n-1 consecutive point pairs of the c array,
+	   d[i] = c[i].distanceTo(c[i+1]) */
+	static void distances(const Coordinates *c, int n, double *d);
 
 private:
 	double _lat, _lon;
@@ -1,21 +1,46 @@
 #include <QByteArrayList>
 #include "csv.h"
 
+#define BUFFER_SIZE 65536
+
 /*
 RFC 4180 parser with the following enchancements:
  - allows an arbitrary delimiter
  - allows LF line ends in addition to CRLF line ends
+
+The input is read in chunks and the (unquoted) fields are stored in a single
+line buffer that is reused for all the entries, so parsing an entry does not
+allocate any memory.
 */
 
-bool CSV::readEntry(QByteArrayList &list, int limit)
+CSV::CSV(QIODevice *device, char delimiter)
+  : _device(device), _delimiter(delimiter), _line(1), _pos(0), _end(0),
+  _size(0)
+{
+	_buffer.resize(BUFFER_SIZE);
+}
+
+bool CSV::fill()
 {
-	int state = 0, len = 0;
+	qint64 size = _device->read(_buffer.data(), _buffer.size());
+	if (size <= 0)
+		return false;
+
+	_pos = 0;
+	_end = size;
+
+	return true;
+}
+
+bool CSV::readEntry(int limit)
+{
+	int state = 0, len = 0, start = 0;
 	char c;
-	QByteArray field;
 
-	list.clear();
+	_size = 0;
+	_fields.resize(0);
 
-	while (_device->getChar(&c)) {
+	while (getChar(c)) {
 		if (limit && ++len > limit)
 			return false;
 
@@ -24,41 +49,41 @@ bool CSV::readEntry(QByteArrayList &list, int limit)
 				if (c == '\r')
 					state = 3;
 				else if (c == '\n') {
-					list.append(field);
+					_fields.append(Span(start, _size - start));
 					_line++;
 					return true;
 				} else if (c == _delimiter) {
-					list.append(field);
-					field.clear();
+					_fields.append(Span(start, _size - start));
+					start = _size;
 				} else if (c == '"') {
-					if (!field.isEmpty())
+					if (_size > start)
 						return false;
 					state = 1;
 				} else
-					field.append(c);
+					append(c);
 				break;
 			case 1:
 				if (c == '"')
 					state = 2;
 				else {
-					field.append(c);
+					append(c);
 					if (c == '\n')
 						_line++;
 				}
 				break;
 			case 2:
 				if (c == '"') {
-					field.append('"');
+					append('"');
 					state = 1;
 				} else if (c == _delimiter || c == '\r' || c == '\n') {
-					_device->ungetChar(c);
+					ungetChar();
 					state = 0;
 				} else
 					return false;
 				break;
 			case 3:
 				if (c == '\n') {
-					_device->ungetChar(c);
+					ungetChar();
 					state = 0;
 				} else
 					return false;
@@ -66,7 +91,18 @@ bool CSV::readEntry(QByteArrayList &list, int limit)
 		}
 	}
 
-	list.append(field);
+	_fields.append(Span(start, _size - start));
+
+	return (atEnd() && (state == 0 || state == 2));
+}
+
+bool CSV::readEntry(QByteArrayList &list, int limit)
+{
+	bool ret = readEntry(limit);
+
+	list.clear();
+	for (int i = 0; i < _fields.size(); i++)
+		list.append(field(i).toByteArray());
 
-	return (_device->atEnd() && (state == 0 || state == 2));
+	return ret;
 }
@@ -2,21 +2,81 @@
 #define CSV_H
 
 #include <QIODevice>
+#include <QVector>
 
 class CSV
 {
 public:
-	CSV(QIODevice *device, char delimiter = ',')
-	  : _device(device), _delimiter(delimiter), _line(1) {}
+	/* View of an entry field. Only valid until the next readEntry() call. */
+	class Field
+	{
+	public:
+		Field(const char *data, int size) : _data(data), _size(size) {}
+
+		const char *constData() const {return _data;}
+		int size() const {return _size;}
+		bool isEmpty() const {return !_size;}
+
+		QByteArray toByteArray() const {return QByteArray(_data, _size);}
+		bool operator==(const char *str) const
+		  {return (!qstrncmp(_data, str, _size) && !str[_size]);}
+		bool operator!=(const char *str) const {return !(*this == str);}
+
+	private:
+		const char *_data;
+		int _size;
+	};
+
+	CSV(QIODevice *device, char delimiter = ',');
+
+	/* Reads the next entry into the internal (reused) line buffer, the fields
+	   are then accessible with fields()/field() */
+	bool readEntry(int limit = 4096);
+	int fields() const {return _fields.size();}
+	Field field(int i) const
+	{
+		const Span &s = _fields.at(i);
+		return Field(_entry.constData() + s.offset, s.length);
+	}
 
 	bool readEntry(QByteArrayList &list, int limit = 4096);
-	bool atEnd() const {return _device->atEnd();}
+	bool atEnd() const {return (_pos == _end && _device->atEnd());}
 	int line() const {return _line;}
 
 private:
+	struct Span {
+		Span() {}
+		Span(int offset, int length) : offset(offset), length(length) {}
+
+		int offset;
+		int length;
+	};
+
+	bool getChar(char &c)
+	{
+		if (_pos == _end && !fill())
+			return false;
+		c = _buffer.at(_pos++);
+		return true;
+	}
+	void ungetChar() {_pos--;}
+	bool fill();
+	void append(char c)
+	{
+		if (_size == _entry.size())
+			_entry.resize(qMax(_entry.size() * 2, 256));
+		_entry.data()[_size++] = c;
+	}
+
 	QIODevice *_device;
 	char _delimiter;
 	int _line;
+
+	QByteArray _buffer;
+	int _pos, _end;
+	QByteArray _entry;
+	int _size;
+	QVector<Span> _fields;
 };
 
 #endif // CSV_H
@@ -18,4 +18,29 @@ inline uint qHash(const QPoint &p)
 #define HASH_T size_t
 #endif // QT6
 
+/* Hashing of the (composite) cache keys. The 64-bit mixing function (the
+   splitmix64 finalizer) spreads the bits of the packed integer keys over the
+   whole hash value, unlike a plain XOR of the key parts that makes small
+   integer keys cluster and e.g. the diagonal tiles (x, y) and (y, x)
+   collide. */
+namespace Hash
+{
+	inline quint64 mix(quint64 x)
+	{
+		x ^= x >> 30;
+		x *= Q_UINT64_C(0xbf58476d1ce4e5b9);
+		x ^= x >> 27;
+		x *= Q_UINT64_C(0x94d049bb133111eb);
+		x ^= x >> 31;
+		return x;
+	}
+
+	inline HASH_T key(quint64 key)
+	  {return (HASH_T)mix(key);}
+	inline HASH_T key(quint32 high, quint32 low)
+	  {return (HASH_T)mix(((quint64)high << 32) | low);}
+	inline HASH_T combine(quint64 h1, quint64 h2)
+	  {return (HASH_T)mix(h1 ^ (mix(h2) + Q_UINT64_C(0x9e3779b97f4a7c15)));}
+}
+
 #endif // HASH_H
@@ -0,0 +1,85 @@
+#ifndef LINECHUNKS_H
+#define LINECHUNKS_H
+
+#include <cstring>
+#include <QVector>
+#include <QString>
+#include "threadpools.h"
+
+/* Parallel parsing of the line oriented text formats. The data are split at
+   line boundaries into chunks that are parsed by the parser threads into
+   chunk local results. The results are then merged in the file order by the
+   parser that is also responsible for any state carried over the chunk
+   boundaries. */
+class LineChunk
+{
+public:
+	LineChunk() : begin(0), end(0), lines(0) {}
+
+	const char *begin;
+	const char *end;
+	/* Number of processed lines, on error the (chunk relative) error line */
+	int lines;
+	QString errorString;
+};
+
+namespace LineChunks
+{
+	/* Splits the data into at most as many chunks as there are parser threads
+	   with each chunk being at least minSize bytes long. T must be
+	   a LineChunk subclass. */
+	template <class T>
+	QVector<T> split(const char *begin, const char *end, qint64 minSize)
+	{
+		qint64 count = qMin((qint64)ThreadPools::pool(ThreadPools::Parse)
+		  ->maxThreadCount(), (qint64)(end - begin) / minSize);
+		qint64 size = (count > 1) ? (end - begin) / count : (end - begin);
+		QVector<T> chunks;
+
+		for (const char *cp = begin; cp < end; ) {
+			const char *ce = end;
+			if (end - cp > size + minSize / 2) {
+				const char *nl = (const char*)memchr(cp + size, '\n',
+				  end - (cp + size));
+				if (nl)
+					ce = nl + 1;
+			}
+
+			T chunk;
+			chunk.begin = cp;
+			chunk.end = ce;
+			chunks.append(chunk);
+
+			cp = ce;
+		}
+
+		return chunks;
+	}
+
+	template <class T, class MapFunctor>
+	void parse(QVector<T> &chunks, MapFunctor func)
+	{
+		if (chunks.size() == 1)
+			(chunks[0].*func)();
+		else
+			ThreadPools::blockingMap(ThreadPools::Parse, chunks, func);
+	}
+
+	/* Returns the index of the first failed chunk or -1 when all the chunks
+	   were parsed successfully. The error line is relative to the first
+	   chunk. */
+	template <class T>
+	int error(const QVector<T> &chunks, int &line)
+	{
+		line = 0;
+		for (int i = 0; i < chunks.size(); i++) {
+			line += chunks.at(i).lines;
+			if (!chunks.at(i).errorString.isNull())
+				return i;
+		}
+
+		return -1;
+	}
+}
+
+#endif // LINECHUNKS_H
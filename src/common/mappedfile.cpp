@@ -0,0 +1,84 @@
+#include <cstring>
+#include <QBuffer>
+#include "mappedfile.h"
+
+
+MappedFile::MappedFile(QIODevice *device)
+  : _device(device), _file(qobject_cast<QFile*>(device)), _data(0), _pos(0)
+{
+	QBuffer *buffer = qobject_cast<QBuffer*>(device);
+
+	_size = _device->size();
+	if (buffer)
+		_data = (uchar*)buffer->data().constData();
+	else if (_file && _size > 0)
+		_data = _file->map(0, _size);
+	if (_data)
+		_pos = _device->pos();
+}
+
+MappedFile::~MappedFile()
+{
+	if (_data && _file)
+		_file->unmap(_data);
+}
+
+bool MappedFile::seek(qint64 pos)
+{
+	if (!isMapped())
+		return _device->seek(pos);
+
+	if (pos < 0 || pos > _size)
+		return false;
+	_pos = pos;
+
+	return true;
+}
+
+qint64 MappedFile::read(char *data, qint64 maxSize)
+{
+	if (!isMapped())
+		return _device->read(data, maxSize);
+
+	qint64 size = qMin(maxSize, _size - _pos);
+	memcpy(data, _data + _pos, size);
+	_pos += size;
+
+	return size;
+}
+
+QByteArray MappedFile::read(qint64 maxSize)
+{
+	if (!isMapped())
+		return _device->read(maxSize);
+
+	qint64 size = qMin(maxSize, _size - _pos);
+	QByteArray ba((const char*)(_data + _pos), size);
+	_pos += size;
+
+	return ba;
+}
+
+/* Returns a pointer to the next size bytes of the file and moves the file
+   position behind them or null (keeping the position) if there is not enough
+   data available.
+   The pointer is valid until the next data() call. */
+const char *MappedFile::data(qint64 size)
+{
+	if (!isMapped()) {
+		qint64 pos = _device->pos();
+		_buffer = _device->read(size);
+		if (_buffer.size() == size)
+			return _buffer.constData();
+		_device->seek(pos);
+		return 0;
+	}
+
+	if (size > _size - _pos)
+		return 0;
+
+	const char *ptr = (const char*)(_data + _pos);
+	_pos += size;
+
+	return ptr;
+}
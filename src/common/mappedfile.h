@@ -0,0 +1,49 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <QFile>
+#include <QByteArray>
+
+/* Read-only random access to a file that uses a memory mapping of the whole
+   file when possible, so that the binary parsers can walk the data with
+   plain pointers without any syscalls or buffer copies. When the file can
+   not be mapped (e.g. files from Android content URIs or special files),
+   the buffered QFile I/O is used instead. In-memory buffers (QBuffer) are
+   accessed directly like the mapped files. */
+class MappedFile
+{
+public:
+	MappedFile(QIODevice *device);
+	~MappedFile();
+
+	bool isMapped() const {return (_data != 0);}
+	QString fileName() const
+	  {return _file ? _file->fileName() : _device->objectName();}
+	QString errorString() const {return _device->errorString();}
+
+	qint64 size() const {return _size;}
+	qint64 pos() const {return isMapped() ? _pos : _device->pos();}
+	bool atEnd() const {return (pos() >= _size);}
+	bool seek(qint64 pos);
+	bool skip(qint64 size) {return seek(pos() + size);}
+
+	qint64 read(char *data, qint64 maxSize);
+	QByteArray read(qint64 maxSize);
+	const char *data(qint64 size);
+
+	/* The whole mapped file as a non-owning byte array, empty when the file
+	   is not mapped. */
+	QByteArray bytes() const
+	  {return isMapped() ? QByteArray::fromRawData((const char*)_data, _size)
+	  : QByteArray();}
+
+private:
+	QIODevice *_device;
+	QFile *_file;
+	uchar *_data;
+	qint64 _size;
+	qint64 _pos;
+	QByteArray _buffer;
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,332 @@
+#ifndef PACKEDRTREE_H
+#define PACKEDRTREE_H
+
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <QtGlobal>
+#include <QVector>
+#include <QByteArray>
+
+/* Static, bulk-loaded R-tree for the read-only spatial indexes. The items are
+   collected with Insert() and the tree is built at once with Pack() using the
+   Sort-Tile-Recursive (STR) algorithm. The items and the node bounding boxes
+   are stored in contiguous arrays (level by level, every node has NODESIZE
+   children except the last one on each level), so the build is just a few
+   sorts and the search does no pointer chasing.
+
+   The API mirrors the (dynamic) RTree one, but Search() may only be called on
+   a packed tree. Like with RTree, the search callback returns false to stop
+   the search.
+
+   A packed tree can be stored with Data() and restored with SetData(), the
+   arrays are copied as they are (the data type must be a plain value, e.g. an
+   index, and the stored data is only valid for the same build/platform). */
+template<class DATATYPE, class ELEMTYPE, int NUMDIMS, int NODESIZE = 16>
+class PackedRTree
+{
+public:
+	class Iterator
+	{
+	public:
+		Iterator() : _idx(0) {}
+
+	private:
+		int _idx;
+
+		friend class PackedRTree;
+	};
+
+	PackedRTree() : _packed(true) {}
+
+	void Insert(const ELEMTYPE a_min[NUMDIMS], const ELEMTYPE a_max[NUMDIMS],
+	  const DATATYPE &a_data)
+	{
+		Item item;
+
+		for (int i = 0; i < NUMDIMS; i++) {
+			item.rect.min[i] = a_min[i];
+			item.rect.max[i] = a_max[i];
+		}
+		item.data = a_data;
+
+		_items.append(item);
+		_packed = false;
+	}
+
+	void Pack();
+
+	int Search(const ELEMTYPE a_min[NUMDIMS], const ELEMTYPE a_max[NUMDIMS],
+	  bool a_resultCallback(DATATYPE a_data, void* a_context),
+	  void* a_context) const;
+
+	void RemoveAll()
+	{
+		_items.clear();
+		_nodes.clear();
+		_levels.clear();
+		_packed = true;
+	}
+	int Count() const {return _items.size();}
+
+	QByteArray Data() const;
+	bool SetData(const QByteArray &a_data);
+
+	void GetFirst(Iterator &a_it) const {a_it._idx = 0;}
+	void GetNext(Iterator &a_it) const {a_it._idx++;}
+	bool IsNull(const Iterator &a_it) const
+	  {return (a_it._idx >= _items.size());}
+	DATATYPE &GetAt(const Iterator &a_it) {return _items[a_it._idx].data;}
+
+private:
+	struct Rect {
+		ELEMTYPE min[NUMDIMS];
+		ELEMTYPE max[NUMDIMS];
+
+		bool overlaps(const Rect &other) const
+		{
+			for (int i = 0; i < NUMDIMS; i++)
+				if (min[i] > other.max[i] || other.min[i] > max[i])
+					return false;
+			return true;
+		}
+
+		void unite(const Rect &other)
+		{
+			for (int i = 0; i < NUMDIMS; i++) {
+				min[i] = qMin(min[i], other.min[i]);
+				max[i] = qMax(max[i], other.max[i]);
+			}
+		}
+	};
+
+	struct Item {
+		Rect rect;
+		DATATYPE data;
+	};
+
+	class CenterCmp
+	{
+	public:
+		CenterCmp(int dim) : _dim(dim) {}
+
+		bool operator()(const Item &a, const Item &b) const
+		{
+			return (a.rect.min[_dim] + a.rect.max[_dim])
+			  < (b.rect.min[_dim] + b.rect.max[_dim]);
+		}
+
+	private:
+		int _dim;
+	};
+
+	struct Level {
+		Level(int offset, int size) : offset(offset), size(size) {}
+
+		int offset;
+		int size;
+	};
+
+	enum {HeaderSize = 7};
+
+	void header(quint32 hdr[HeaderSize]) const
+	{
+		hdr[0] = NUMDIMS;
+		hdr[1] = NODESIZE;
+		hdr[2] = sizeof(ELEMTYPE);
+		hdr[3] = sizeof(DATATYPE);
+		hdr[4] = _items.size();
+		hdr[5] = _nodes.size();
+		hdr[6] = _levels.size();
+	}
+
+	void sort(int begin, int end, int dim);
+	const Rect &rect(int level, int idx) const
+	{
+		return level ? _nodes.at(_levels.at(level).offset + idx)
+		  : _items.at(idx).rect;
+	}
+	bool search(int level, int idx, const Rect &rect, int &found,
+	  bool a_resultCallback(DATATYPE a_data, void* a_context),
+	  void* a_context) const;
+
+	QVector<Item> _items;
+	QVector<Rect> _nodes;
+	QVector<Level> _levels;
+	bool _packed;
+};
+
+template<class DATATYPE, class ELEMTYPE, int NUMDIMS, int NODESIZE>
+void PackedRTree<DATATYPE, ELEMTYPE, NUMDIMS, NODESIZE>::sort(int begin,
+  int end, int dim)
+{
+	std::sort(_items.begin() + begin, _items.begin() + end, CenterCmp(dim));
+	if (dim == NUMDIMS - 1)
+		return;
+
+	/* Split the range into S^(1/k) slabs of whole nodes along the current
+	   dimension and sort each slab by the remaining dimensions */
+	int nodes = (end - begin + NODESIZE - 1) / NODESIZE;
+	int slabs = (int)ceil(pow((double)nodes, 1.0 / (NUMDIMS - dim)));
+	int slabSize = ((nodes + slabs - 1) / slabs) * NODESIZE;
+
+	for (int i = begin; i < end; i += slabSize)
+		sort(i, qMin(i + slabSize, end), dim + 1);
+}
+
+template<class DATATYPE, class ELEMTYPE, int NUMDIMS, int NODESIZE>
+void PackedRTree<DATATYPE, ELEMTYPE, NUMDIMS, NODESIZE>::Pack()
+{
+	_nodes.clear();
+	_levels.clear();
+	_packed = true;
+
+	if (_items.isEmpty())
+		return;
+
+	sort(0, _items.size(), 0);
+
+	_levels.append(Level(0, _items.size()));
+	do {
+		const Level &prev = _levels.last();
+		int level = _levels.size() - 1;
+		int size = (prev.size + NODESIZE - 1) / NODESIZE;
+		int offset = _nodes.size();
+
+		for (int i = 0; i < size; i++) {
+			int end = qMin((i + 1) * NODESIZE, prev.size);
+			Rect r(rect(level, i * NODESIZE));
+			for (int j = i * NODESIZE + 1; j < end; j++)
+				r.unite(rect(level, j));
+			_nodes.append(r);
+		}
+
+		_levels.append(Level(offset, size));
+	} while (_levels.last().size > 1);
+
+	_items.squeeze();
+	_nodes.squeeze();
+}
+
+template<class DATATYPE, class ELEMTYPE, int NUMDIMS, int NODESIZE>
+bool PackedRTree<DATATYPE, ELEMTYPE, NUMDIMS, NODESIZE>::search(int level,
+  int idx, const Rect &rect, int &found,
+  bool a_resultCallback(DATATYPE a_data, void* a_context),
+  void* a_context) const
+{
+	int begin = idx * NODESIZE;
+	int end = qMin(begin + NODESIZE, _levels.at(level - 1).size);
+
+	for (int i = begin; i < end; i++) {
+		if (level == 1) {
+			const Item &item = _items.at(i);
+			if (item.rect.overlaps(rect)) {
+				found++;
+				if (!a_resultCallback(item.data, a_context))
+					return false;
+			}
+		} else if (this->rect(level - 1, i).overlaps(rect)) {
+			if (!search(level - 1, i, rect, found, a_resultCallback,
+			  a_context))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+template<class DATATYPE, class ELEMTYPE, int NUMDIMS, int NODESIZE>
+int PackedRTree<DATATYPE, ELEMTYPE, NUMDIMS, NODESIZE>::Search(
+  const ELEMTYPE a_min[NUMDIMS], const ELEMTYPE a_max[NUMDIMS],
+  bool a_resultCallback(DATATYPE a_data, void* a_context),
+  void* a_context) const
+{
+	Q_ASSERT(_packed);
+
+	Rect r;
+	for (int i = 0; i < NUMDIMS; i++) {
+		Q_ASSERT(a_min[i] <= a_max[i]);
+		r.min[i] = a_min[i];
+		r.max[i] = a_max[i];
+	}
+
+	int found = 0;
+	if (_levels.size() > 1 && rect(_levels.size() - 1, 0).overlaps(r))
+		search(_levels.size() - 1, 0, r, found, a_resultCallback, a_context);
+
+	return found;
+}
+
+template<class DATATYPE, class ELEMTYPE, int NUMDIMS, int NODESIZE>
+QByteArray PackedRTree<DATATYPE, ELEMTYPE, NUMDIMS, NODESIZE>::Data() const
+{
+	Q_ASSERT(_packed);
+
+	quint32 hdr[HeaderSize];
+	header(hdr);
+
+	QByteArray ba;
+	ba.reserve(sizeof(hdr) + _items.size() * sizeof(Item)
+	  + _nodes.size() * sizeof(Rect) + _levels.size() * sizeof(Level));
+	ba.append((const char*)hdr, sizeof(hdr));
+	ba.append((const char*)_items.constData(), _items.size() * sizeof(Item));
+	ba.append((const char*)_nodes.constData(), _nodes.size() * sizeof(Rect));
+	ba.append((const char*)_levels.constData(),
+	  _levels.size() * sizeof(Level));
+
+	return ba;
+}
+
+template<class DATATYPE, class ELEMTYPE, int NUMDIMS, int NODESIZE>
+bool PackedRTree<DATATYPE, ELEMTYPE, NUMDIMS, NODESIZE>::SetData(
+  const QByteArray &a_data)
+{
+	quint32 hdr[HeaderSize], ref[HeaderSize];
+
+	if ((size_t)a_data.size() < sizeof(hdr))
+		return false;
+	memcpy(hdr, a_data.constData(), sizeof(hdr));
+
+	RemoveAll();
+	header(ref);
+	for (int i = 0; i < 4; i++)
+		if (hdr[i] != ref[i])
+			return false;
+	if ((quint64)a_data.size() != sizeof(hdr) + (quint64)hdr[4] * sizeof(Item)
+	  + (quint64)hdr[5] * sizeof(Rect) + (quint64)hdr[6] * sizeof(Level))
+		return false;
+
+	const char *ptr = a_data.constData() + sizeof(hdr);
+	_items.resize(hdr[4]);
+	memcpy((void*)_items.data(), ptr, hdr[4] * sizeof(Item));
+	ptr += hdr[4] * sizeof(Item);
+	_nodes.resize(hdr[5]);
+	memcpy((void*)_nodes.data(), ptr, hdr[5] * sizeof(Rect));
+	ptr += hdr[5] * sizeof(Rect);
+	_levels.reserve(hdr[6]);
+	for (quint32 i = 0; i < hdr[6]; i++, ptr += sizeof(Level)) {
+		Level level(0, 0);
+		memcpy((void*)&level, ptr, sizeof(Level));
+		_levels.append(level);
+	}
+
+	/* Check the level structure so that a broken entry can not make the
+	   search read out of the arrays */
+	if (_levels.isEmpty() ? !_items.isEmpty()
+	  : (_levels.first().size != _items.size() || _levels.last().size != 1)) {
+		RemoveAll();
+		return false;
+	}
+	for (int i = 1; i < _levels.size(); i++) {
+		const Level &l = _levels.at(i);
+		if (l.size != (_levels.at(i - 1).size + NODESIZE - 1) / NODESIZE
+		  || l.offset < 0 || l.offset + l.size > _nodes.size()) {
+			RemoveAll();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+#endif // PACKEDRTREE_H
@@ -0,0 +1,221 @@
+#include <QTimeZone>
+#include "parse.h"
+
+
+static const double POW10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+	1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline int chr(char c) {return (unsigned char)c;}
+static inline int chr(QChar c) {return c.unicode();}
+
+static inline bool isDigit(int c) {return (c >= '0' && c <= '9');}
+static inline bool isSpace(int c)
+  {return (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f'
+  || c == '\v');}
+
+template<class T>
+static int number(const T *str, int len)
+{
+	int res = 0;
+
+	for (const T *sp = str; sp < str + len; sp++) {
+		int c = chr(*sp);
+		if (!isDigit(c))
+			return -1;
+		res = res * 10 + c - '0';
+	}
+
+	return res;
+}
+
+/* Decimal numbers with at most 19 significant digits whose value can be
+   computed with a single correctly rounded floating point operation
+   (mantissa <= 2^53, |exponent| <= 22, the Clinger's fast path). */
+template<class T>
+static bool fastDouble(const T *str, int len, double &val)
+{
+	const T *sp = str, *ep = str + len;
+	quint64 mantissa = 0;
+	int digits = 0, exp = 0;
+	bool neg = false, integer;
+
+	while (sp < ep && isSpace(chr(*sp)))
+		sp++;
+	while (ep > sp && isSpace(chr(*(ep - 1))))
+		ep--;
+	if (sp == ep)
+		return false;
+
+	if (chr(*sp) == '-') {
+		neg = true;
+		sp++;
+	} else if (chr(*sp) == '+')
+		sp++;
+
+	const T *ip = sp;
+	for (; sp < ep && isDigit(chr(*sp)); sp++) {
+		if (digits == 19)
+			return false;
+		mantissa = mantissa * 10 + (chr(*sp) - '0');
+		if (mantissa)
+			digits++;
+	}
+	integer = (sp > ip);
+
+	if (sp < ep && chr(*sp) == '.') {
+		const T *fp = ++sp;
+		for (; sp < ep && isDigit(chr(*sp)); sp++) {
+			if (digits == 19)
+				return false;
+			mantissa = mantissa * 10 + (chr(*sp) - '0');
+			if (mantissa)
+				digits++;
+			exp--;
+		}
+		if (!integer && sp == fp)
+			return false;
+	} else if (!integer)
+		return false;
+
+	if (sp < ep && (chr(*sp) == 'e' || chr(*sp) == 'E')) {
+		bool eneg = false;
+		int e;
+
+		if (++sp < ep && (chr(*sp) == '-' || chr(*sp) == '+'))
+			eneg = (chr(*sp++) == '-');
+		if (sp == ep || ep - sp > 3)
+			return false;
+		if ((e = number(sp, ep - sp)) < 0)
+			return false;
+		exp += eneg ? -e : e;
+		sp = ep;
+	}
+
+	if (sp != ep || mantissa > (1ULL<<53) || exp < -22 || exp > 22)
+		return false;
+
+	double v = (double)mantissa;
+	v = (exp < 0) ? v / POW10[-exp] : v * POW10[exp];
+	val = neg ? -v : v;
+
+	return true;
+}
+
+/* YYYY-MM-DDTHH:MM:SS[.s...][Z] */
+template<class T>
+static bool fastDateTime(const T *str, int len, QDateTime &dt)
+{
+	int y, M, d, h, m, s, ms = 0;
+	const T *sp, *ep = str + len;
+
+	if (len < 19 || chr(str[4]) != '-' || chr(str[7]) != '-'
+	  || chr(str[10]) != 'T' || chr(str[13]) != ':' || chr(str[16]) != ':')
+		return false;
+	if ((y = number(str, 4)) < 0 || (M = number(str + 5, 2)) < 0
+	  || (d = number(str + 8, 2)) < 0 || (h = number(str + 11, 2)) < 0
+	  || (m = number(str + 14, 2)) < 0 || (s = number(str + 17, 2)) < 0)
+		return false;
+
+	sp = str + 19;
+	if (sp < ep && chr(*sp) == '.') {
+		const T *fp = ++sp;
+		int frac = 0, scale = 1;
+
+		for (; sp < ep && isDigit(chr(*sp)); sp++) {
+			if (sp - fp < 4) {
+				frac = frac * 10 + (chr(*sp) - '0');
+				scale *= 10;
+			}
+		}
+		if (sp == fp)
+			return false;
+		ms = qMin((frac * 1000 + scale / 2) / scale, 999);
+	}
+
+	bool utc = (sp < ep && chr(*sp) == 'Z');
+	if (utc)
+		sp++;
+	if (sp != ep)
+		return false;
+
+	QDate date(y, M, d);
+	QTime time(h, m, s, ms);
+	if (!date.isValid() || !time.isValid())
+		return false;
+
+	dt = utc ? QDateTime(date, time, QTimeZone::utc()) : QDateTime(date, time);
+
+	return true;
+}
+
+bool Parse::toDouble(const char *str, int len, double &val)
+{
+	bool ok;
+
+	if (fastDouble(str, len, val))
+		return true;
+
+	val = QByteArray::fromRawData(str, len).toDouble(&ok);
+	return ok;
+}
+
+bool Parse::toDouble(const QChar *str, int len, double &val)
+{
+	bool ok;
+
+	if (fastDouble(str, len, val))
+		return true;
+
+	val = QString::fromRawData(str, len).toDouble(&ok);
+	return ok;
+}
+
+QDateTime Parse::isoDateTime(const char *str, int len)
+{
+	QDateTime dt;
+
+	if (fastDateTime(str, len, dt))
+		return dt;
+
+	return QDateTime::fromString(QString::fromLatin1(str, len), Qt::ISODate);
+}
+
+QDateTime Parse::isoDateTime(const QChar *str, int len)
+{
+	QDateTime dt;
+
+	if (fastDateTime(str, len, dt))
+		return dt;
+
+	return QDateTime::fromString(QString(str, len), Qt::ISODate);
+}
+
+bool Parse::hhmmss(const char *str, int len, QTime &time)
+{
+	int h, m, s, ms = 0;
+
+	if (len < 6 || (h = number(str, 2)) < 0 || (m = number(str + 2, 2)) < 0
+	  || (s = number(str + 4, 2)) < 0)
+		return false;
+
+	if (len > 6) {
+		const char *fp = str + 7;
+		int fl = len - 7, frac, scale = 1;
+
+		if (str[6] != '.')
+			return false;
+		if (fl > 3)
+			fl = 3;
+		if ((frac = number(fp, fl)) < 0 || number(fp + fl, len - 7 - fl) < 0)
+			return false;
+		for (int i = 0; i < fl; i++)
+			scale *= 10;
+		ms = frac * 1000 / scale;
+	}
+
+	time = QTime(h, m, s, ms);
+
+	return time.isValid();
+}
@@ -0,0 +1,29 @@
+#ifndef PARSE_H
+#define PARSE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QDateTime>
+
+/* Locale independent number and timestamp parsing for the text format
+   parsers. The common cases are decoded directly from the input buffers,
+   everything else falls back to the (slow) Qt conversions, so the results
+   always match the Qt functions. */
+namespace Parse
+{
+	bool toDouble(const char *str, int len, double &val);
+	bool toDouble(const QChar *str, int len, double &val);
+	template<class T> bool toDouble(const T &str, double &val)
+	  {return toDouble(str.constData(), str.size(), val);}
+
+	/* Qt::ISODate date/time */
+	QDateTime isoDateTime(const char *str, int len);
+	QDateTime isoDateTime(const QChar *str, int len);
+	template<class T> QDateTime isoDateTime(const T &str)
+	  {return isoDateTime(str.constData(), str.size());}
+
+	/* NMEA hhmmss[.s...] time */
+	bool hhmmss(const char *str, int len, QTime &time);
+}
+
+#endif // PARSE_H
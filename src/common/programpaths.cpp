@@ -9,6 +9,13 @@
 #define CRS_DIR          "CRS"
 #define DEM_DIR          "DEM"
 #define TILES_DIR        "tiles"
+#define DATA_CACHE_DIR   "data"
+#define DEM_CACHE_DIR    "DEM"
+#define IMG_CACHE_DIR    "IMG"
+#define THUMBNAILS_DIR   "thumbnails"
+#define SYMBOL_CACHE_DIR "symbols"
+#define TAR_CACHE_DIR    "tar"
+#define MAP_LIST_CACHE   "maps.cache"
 #define TRANSLATIONS_DIR "translations"
 #define STYLE_DIR        "style"
 #define SYMBOLS_DIR      "symbols"
@@ -117,6 +124,48 @@ QString ProgramPaths::tilesDir()
 	  QStandardPaths::CacheLocation)).filePath(TILES_DIR);
 }
 
+QString ProgramPaths::dataCacheDir()
+{
+	return QDir(QStandardPaths::writableLocation(
+	  QStandardPaths::CacheLocation)).filePath(DATA_CACHE_DIR);
+}
+
+QString ProgramPaths::demCacheDir()
+{
+	return QDir(QStandardPaths::writableLocation(
+	  QStandardPaths::CacheLocation)).filePath(DEM_CACHE_DIR);
+}
+
+QString ProgramPaths::imgCacheDir()
+{
+	return QDir(QStandardPaths::writableLocation(
+	  QStandardPaths::CacheLocation)).filePath(IMG_CACHE_DIR);
+}
+
+QString ProgramPaths::thumbnailCacheDir()
+{
+	return QDir(QStandardPaths::writableLocation(
+	  QStandardPaths::CacheLocation)).filePath(THUMBNAILS_DIR);
+}
+
+QString ProgramPaths::symbolCacheDir()
+{
+	return QDir(QStandardPaths::writableLocation(
+	  QStandardPaths::CacheLocation)).filePath(SYMBOL_CACHE_DIR);
+}
+
+QString ProgramPaths::tarCacheDir()
+{
+	return QDir(QStandardPaths::writableLocation(
+	  QStandardPaths::CacheLocation)).filePath(TAR_CACHE_DIR);
+}
+
+QString ProgramPaths::mapListCacheFile()
+{
+	return QDir(QStandardPaths::writableLocation(
+	  QStandardPaths::CacheLocation)).filePath(MAP_LIST_CACHE);
+}
+
 QString ProgramPaths::translationsDir()
 {
 #ifdef Q_OS_ANDROID
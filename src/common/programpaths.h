@@ -12,6 +12,13 @@ namespace ProgramPaths
 	QString styleDir(bool writable = false);
 	QString symbolsDir(bool writable = false);
 	QString tilesDir();
+	QString dataCacheDir();
+	QString demCacheDir();
+	QString imgCacheDir();
+	QString thumbnailCacheDir();
+	QString symbolCacheDir();
+	QString tarCacheDir();
+	QString mapListCacheFile();
 	QString translationsDir();
 
 	QString ellipsoidsFile();
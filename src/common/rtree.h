@@ -27,6 +27,7 @@
 #include <cmath>
 #include <cstdlib>
 #include <QtGlobal>
+#include <QVector>
 
 
 #define RTREE_TEMPLATE template<class DATATYPE, class ELEMTYPE, int NUMDIMS, \
@@ -34,9 +35,11 @@
 #define RTREE_QUAL RTree<DATATYPE, ELEMTYPE, NUMDIMS, ELEMTYPEREAL, TMAXNODES, \
   TMINNODES>
 
-// This version does not contain a fixed memory allocator, fill in lines with
-// EXAMPLE to implement one.
-#define RTREE_DONT_USE_MEMPOOLS 
+// The nodes are allocated from per-tree slabs (freed nodes are kept in a free
+// list and reused, all the slabs are freed at once on RemoveAll()/destruction).
+// Define RTREE_DONT_USE_MEMPOOLS to allocate each node separately.
+//#define RTREE_DONT_USE_MEMPOOLS
+#define RTREE_SLAB_SIZE 64
 // Better split classification, may be slower on some systems
 #define RTREE_USE_SPHERICAL_VOLUME
 
@@ -367,6 +370,14 @@ protected:
 
 	/// Root of tree
 	Node* m_root;
+	#ifndef RTREE_DONT_USE_MEMPOOLS
+	/// Node memory slabs, the last one is being filled
+	QVector<Node*> m_slabs;
+	/// Number of used nodes in the last slab
+	int m_slabUsed;
+	/// List of freed nodes (linked through the first branch)
+	Node* m_freeNodes;
+	#endif // RTREE_DONT_USE_MEMPOOLS
 	/// Unit sphere constant for required number of dimensions
 	ELEMTYPEREAL m_unitSphereVolume;
 };
@@ -382,6 +393,11 @@ RTREE_QUAL::RTree()
 	// object pointer. Since we are storing as union with non data branch
 	Q_ASSERT(sizeof(DATATYPE) == sizeof(void*) || sizeof(DATATYPE) == sizeof(int));
 
+	#ifndef RTREE_DONT_USE_MEMPOOLS
+	m_slabUsed = RTREE_SLAB_SIZE;
+	m_freeNodes = 0;
+	#endif // RTREE_DONT_USE_MEMPOOLS
+
 	// Precomputed volumes of the unit spheres for the first few dimensions
 	const float UNIT_SPHERE_VOLUMES[] = {
 		0.000000f, 2.000000f, 3.141593f, // Dimension  0,1,2
@@ -513,7 +529,11 @@ void RTREE_QUAL::Reset()
 	RemoveAllRec(m_root);
 	#else // RTREE_DONT_USE_MEMPOOLS
 	// Just reset memory pools.  We are not using complex types
-	// EXAMPLE
+	for (int i = 0; i < m_slabs.size(); ++i)
+		delete[] m_slabs.at(i);
+	m_slabs.clear();
+	m_slabUsed = RTREE_SLAB_SIZE;
+	m_freeNodes = 0;
 	#endif // RTREE_DONT_USE_MEMPOOLS
 }
 
@@ -539,7 +559,16 @@ typename RTREE_QUAL::Node* RTREE_QUAL::AllocNode()
 	#ifdef RTREE_DONT_USE_MEMPOOLS
 	newNode = new Node;
 	#else // RTREE_DONT_USE_MEMPOOLS
-	// EXAMPLE
+	if (m_freeNodes) {
+		newNode = m_freeNodes;
+		m_freeNodes = m_freeNodes->m_branch[0].m_child;
+	} else {
+		if (m_slabUsed == RTREE_SLAB_SIZE) {
+			m_slabs.append(new Node[RTREE_SLAB_SIZE]);
+			m_slabUsed = 0;
+		}
+		newNode = m_slabs.last() + m_slabUsed++;
+	}
 	#endif // RTREE_DONT_USE_MEMPOOLS
 	InitNode(newNode);
 	return newNode;
@@ -554,7 +583,8 @@ void RTREE_QUAL::FreeNode(Node* a_node)
 	#ifdef RTREE_DONT_USE_MEMPOOLS
 	delete a_node;
 	#else // RTREE_DONT_USE_MEMPOOLS
-	// EXAMPLE
+	a_node->m_branch[0].m_child = m_freeNodes;
+	m_freeNodes = a_node;
 	#endif // RTREE_DONT_USE_MEMPOOLS
 }
 
@@ -564,22 +594,16 @@ void RTREE_QUAL::FreeNode(Node* a_node)
 RTREE_TEMPLATE
 typename RTREE_QUAL::ListNode* RTREE_QUAL::AllocListNode()
 {
-	#ifdef RTREE_DONT_USE_MEMPOOLS
+	// The list nodes are only used (shortly) when removing items, they are
+	// allocated separately even with the node pools
 	return new ListNode;
-	#else // RTREE_DONT_USE_MEMPOOLS
-	// EXAMPLE
-	#endif // RTREE_DONT_USE_MEMPOOLS
 }
 
 
 RTREE_TEMPLATE
 void RTREE_QUAL::FreeListNode(ListNode* a_listNode)
 {
-	#ifdef RTREE_DONT_USE_MEMPOOLS
 	delete a_listNode;
-	#else // RTREE_DONT_USE_MEMPOOLS
-	// EXAMPLE
-	#endif // RTREE_DONT_USE_MEMPOOLS
 }
 
 
@@ -11,6 +11,25 @@
 	the "official" Qt6 installers have ICU support disabled (QTBUG-121353).
 */
 
+static bool isSingleByte(int codepage)
+{
+	return (codepage == 0 || codepage == 874
+	  || (codepage >= 1250 && codepage <= 1258));
+}
+
+void TextCodec::createTable()
+{
+	QVector<QChar> table(256);
+
+	for (int i = 0; i < 256; i++) {
+		QString str(toString(QByteArray(1, (char)i)));
+		table[i] = str.isEmpty() ? QChar(QChar::ReplacementCharacter)
+		  : str.at(0);
+	}
+
+	_table = table;
+}
+
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0) || defined(Q_OS_ANDROID)
 
 static QTextCodec *codec(int mib)
@@ -81,10 +100,20 @@ TextCodec::TextCodec(int codepage)
 			qWarning("%d: Unknown codepage, using ISO-8859-1", codepage);
 			_codec = 0;
 	}
+
+	if (_codec && isSingleByte(codepage))
+		createTable();
 }
 
 QString TextCodec::toString(const QByteArray &ba)
 {
+	if (!_table.isEmpty()) {
+		QString str(ba.size(), Qt::Uninitialized);
+		for (int i = 0; i < ba.size(); i++)
+			str[i] = _table.at((uchar)ba.at(i));
+		return str;
+	}
+
 	return _codec ? _codec->toUnicode(ba) : QString::fromLatin1(ba);
 }
 
@@ -108,10 +137,20 @@ TextCodec::TextCodec(int codepage)
 		if (!_decoder.isValid())
 			qWarning("%d: Unknown codepage, using ISO-8859-1", codepage);
 	}
+
+	if (_decoder.isValid() && isSingleByte(codepage))
+		createTable();
 }
 
 QString TextCodec::toString(const QByteArray &ba)
 {
+	if (!_table.isEmpty()) {
+		QString str(ba.size(), Qt::Uninitialized);
+		for (int i = 0; i < ba.size(); i++)
+			str[i] = _table.at((uchar)ba.at(i));
+		return str;
+	}
+
 	return _decoder.isValid() ? _decoder.decode(ba) : QString::fromLatin1(ba);
 }
 #endif // QT 6 || ANDROID
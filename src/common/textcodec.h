@@ -2,6 +2,7 @@
 #define TEXTCODEC_H
 
 #include <QString>
+#include <QVector>
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0) || defined(Q_OS_ANDROID)
 #include <QTextCodec>
 #else // QT 6 || ANDROID
@@ -17,6 +18,11 @@ public:
 	QString toString(const QByteArray &ba);
 
 private:
+	void createTable();
+
+	/* Lookup table of the single byte code pages, the conversion is then
+	   a plain (and thread-safe) table lookup */
+	QVector<QChar> _table;
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0) || defined(Q_OS_ANDROID)
 	QTextCodec *_codec;
 #else // QT 6 || ANDROID
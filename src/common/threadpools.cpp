@@ -0,0 +1,26 @@
+#include <QThread>
+#include "threadpools.h"
+
+QThreadPool *ThreadPools::pool(Type type)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+	static QThreadPool render, parse;
+
+	return (type == Render) ? &render : &parse;
+#else // QT 6
+	Q_UNUSED(type);
+	return QThreadPool::globalInstance();
+#endif // QT 6
+}
+
+void ThreadPools::setMaxThreadCount(Type type, int count)
+{
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+	/* The global pool is sized by the render pool setting */
+	if (type != Render)
+		return;
+#endif // QT 6
+
+	pool(type)->setMaxThreadCount(count > 0
+	  ? count : QThread::idealThreadCount());
+}
@@ -0,0 +1,45 @@
+#ifndef THREADPOOLS_H
+#define THREADPOOLS_H
+
+#include <QThreadPool>
+#include <QtConcurrent>
+
+/* Separate worker thread pools for the map tiles rendering and the data
+   parsing, so that loading a lot of files does not stall the map rendering
+   and vice versa. The pools sizes default to the number of CPU cores.
+
+   QtConcurrent::map() has no thread pool argument in Qt5, all the work
+   runs in the global pool there (sized as the render pool). */
+class ThreadPools
+{
+public:
+	enum Type {Render, Parse};
+
+	static QThreadPool *pool(Type type);
+	/* 0 sets the default (ideal) thread count */
+	static void setMaxThreadCount(Type type, int count);
+
+	template <class Sequence, class MapFunctor>
+	static QFuture<void> map(Type type, Sequence &sequence, MapFunctor func)
+	{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+		return QtConcurrent::map(pool(type), sequence, func);
+#else // QT 6
+		Q_UNUSED(type);
+		return QtConcurrent::map(sequence, func);
+#endif // QT 6
+	}
+
+	template <class Sequence, class MapFunctor>
+	static void blockingMap(Type type, Sequence &sequence, MapFunctor func)
+	{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+		QtConcurrent::blockingMap(pool(type), sequence, func);
+#else // QT 6
+		Q_UNUSED(type);
+		QtConcurrent::blockingMap(sequence, func);
+#endif // QT 6
+	}
+};
+
+#endif // THREADPOOLS_H
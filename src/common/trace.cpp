@@ -0,0 +1,161 @@
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+#include <QList>
+#include <QElapsedTimer>
+#include "trace.h"
+
+#define TRACE_FILE  "GPXSEE_TRACE"
+#define BUFFER_SIZE 16384 /* events per thread */
+
+struct Event
+{
+	const char *category;
+	const char *name;
+	qint64 start;
+	qint64 duration;
+	quintptr thread;
+};
+
+/* Only the owning thread writes into the buffer, the lock is taken by the
+   dump and is otherwise uncontended */
+class Buffer
+{
+public:
+	Buffer() : _events(BUFFER_SIZE), _pos(0), _size(0) {}
+
+	void append(const Event &event)
+	{
+		QMutexLocker locker(&_lock);
+		_events[_pos] = event;
+		_pos = (_pos + 1) % BUFFER_SIZE;
+		_size = qMin(_size + 1, BUFFER_SIZE);
+	}
+
+	QVector<Event> events()
+	{
+		QMutexLocker locker(&_lock);
+		QVector<Event> list;
+		list.reserve(_size);
+		for (int i = 0; i < _size; i++)
+			list.append(_events.at((_pos - _size + i + BUFFER_SIZE)
+			  % BUFFER_SIZE));
+		return list;
+	}
+
+private:
+	QMutex _lock;
+	QVector<Event> _events;
+	int _pos, _size;
+};
+
+/* The buffers of the finished threads (the thread pool threads expire) are
+   reused by new threads so the number of buffers is bounded by the maximal
+   number of concurrent threads and the recorded events are kept */
+static QMutex lock;
+static QList<Buffer*> buffers;
+static QList<Buffer*> freeBuffers;
+
+class ThreadBuffer
+{
+public:
+	ThreadBuffer()
+	{
+		QMutexLocker locker(&lock);
+		if (freeBuffers.isEmpty()) {
+			_buffer = new Buffer();
+			buffers.append(_buffer);
+		} else
+			_buffer = freeBuffers.takeLast();
+	}
+	~ThreadBuffer()
+	{
+		QMutexLocker locker(&lock);
+		freeBuffers.append(_buffer);
+	}
+
+	Buffer *buffer() const {return _buffer;}
+
+private:
+	Buffer *_buffer;
+};
+
+bool Trace::_enabled = false;
+
+static QString traceFile;
+static QElapsedTimer timer;
+
+bool Trace::init()
+{
+#ifdef NO_TRACE
+	return false;
+#else // NO_TRACE
+	traceFile = qEnvironmentVariable(TRACE_FILE);
+	if (traceFile.isEmpty())
+		return false;
+
+	timer.start();
+	_enabled = true;
+
+	return true;
+#endif // NO_TRACE
+}
+
+const QString &Trace::fileName()
+{
+	return traceFile;
+}
+
+qint64 Trace::now()
+{
+	return timer.nsecsElapsed() / 1000;
+}
+
+void Trace::event(const char *category, const char *name, qint64 start)
+{
+	static thread_local ThreadBuffer tb;
+	Event e;
+
+	e.category = category;
+	e.name = name;
+	e.start = start;
+	e.duration = now() - start;
+	e.thread = (quintptr)QThread::currentThreadId();
+
+	tb.buffer()->append(e);
+}
+
+bool Trace::dump(const QString &fileName)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qWarning("%s: %s", qUtf8Printable(fileName),
+		  qUtf8Printable(file.errorString()));
+		return false;
+	}
+
+	QList<Buffer*> list;
+	lock.lock();
+	list = buffers;
+	lock.unlock();
+
+	file.write("[\n");
+	bool first = true;
+	for (int i = 0; i < list.size(); i++) {
+		QVector<Event> events(list.at(i)->events());
+
+		for (int j = 0; j < events.size(); j++) {
+			const Event &e = events.at(j);
+			file.write(QByteArray(first ? "" : ",\n") + "{\"name\":\""
+			  + e.name + "\",\"cat\":\"" + e.category + "\",\"ph\":\"X\""
+			  + ",\"ts\":" + QByteArray::number(e.start) + ",\"dur\":"
+			  + QByteArray::number(e.duration) + ",\"pid\":1,\"tid\":"
+			  + QByteArray::number(e.thread) + "}");
+			first = false;
+		}
+	}
+	file.write("\n]\n");
+
+	return (file.error() == QFileDevice::NoError);
+}
@@ -0,0 +1,97 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QtGlobal>
+
+class QString;
+
+/* Lightweight application tracing. The timed phases are recorded into a ring
+   buffer per thread and can be dumped at any time to a file in the Chrome
+   trace event format (chrome://tracing, Perfetto, ...). Tracing is enabled
+   by setting the GPXSEE_TRACE environment variable to the trace file path,
+   the trace is written to the file on exit. Otherwise the timers cost just a
+   flag check and building with NO_TRACE (CONFIG+=notrace) removes them
+   completely. */
+class Trace
+{
+public:
+	/* Times the phases of a function, every next() call ends the current
+	   phase and starts a new one. The last phase ends with the scope. */
+	class Scope
+	{
+	public:
+		Scope(const char *category, const char *name)
+		  : _category(category), _name(name), _start(0)
+		{
+			if (isEnabled())
+				_start = now();
+		}
+		~Scope()
+		{
+			if (isEnabled())
+				event(_category, _name, _start);
+		}
+
+		void next(const char *name)
+		{
+			if (isEnabled()) {
+				event(_category, _name, _start);
+				_start = now();
+			}
+			_name = name;
+		}
+
+	private:
+		const char *_category;
+		const char *_name;
+		qint64 _start;
+	};
+
+	/* Times asynchronous operations (jobs, downloads) */
+	class Span
+	{
+	public:
+		Span() : _start(0) {}
+
+		void start()
+		{
+			if (isEnabled())
+				_start = now();
+		}
+		void end(const char *category, const char *name) const
+		{
+			if (isEnabled())
+				event(category, name, _start);
+		}
+
+	private:
+		qint64 _start;
+	};
+
+	static bool init();
+#ifdef NO_TRACE
+	static bool isEnabled() {return false;}
+#else // NO_TRACE
+	static bool isEnabled() {return _enabled;}
+#endif // NO_TRACE
+	static const QString &fileName();
+
+	/* Time in microseconds since the trace start */
+	static qint64 now();
+	/* Records a phase that started at start (from now()) and ends now */
+	static void event(const char *category, const char *name, qint64 start);
+	static bool dump(const QString &fileName);
+
+private:
+	static bool _enabled;
+};
+
+#ifdef NO_TRACE
+#define TRACE_SCOPE(category, name)
+#define TRACE_NEXT(name)
+#else // NO_TRACE
+#define TRACE_SCOPE(category, name) Trace::Scope _trace(category, name)
+#define TRACE_NEXT(name) _trace.next(name)
+#endif // NO_TRACE
+
+#endif // TRACE_H
@@ -0,0 +1,48 @@
+#include "xml.h"
+
+XML::Names::Names(const char * const names[], int count)
+{
+	_names.reserve(count);
+
+	for (int i = 0; i < count; i++) {
+		_names.append(QString::fromLatin1(names[i]));
+		HashValue hash = qHash(_names.last(), 0);
+		Q_ASSERT(!_ids.contains(hash));
+		_ids.insert(hash, i);
+	}
+}
+
+int XML::Names::id(const QXmlStreamReader &reader) const
+{
+	QHash<HashValue, int>::const_iterator it(_ids.constFind(
+	  qHash(reader.name(), 0)));
+
+	return (it != _ids.constEnd() && reader.name() == _names.at(*it))
+	  ? *it : -1;
+}
+
+bool XML::readText(QXmlStreamReader &reader, Text &text)
+{
+	text.clear();
+
+	while (!reader.atEnd()) {
+		switch (reader.readNext()) {
+			case QXmlStreamReader::Characters:
+			case QXmlStreamReader::EntityReference:
+				text.append(reader.text().constData(), reader.text().size());
+				break;
+			case QXmlStreamReader::Comment:
+			case QXmlStreamReader::ProcessingInstruction:
+				break;
+			case QXmlStreamReader::EndElement:
+				return true;
+			case QXmlStreamReader::StartElement:
+				reader.raiseError("Expected character data.");
+				return false;
+			default:
+				return false;
+		}
+	}
+
+	return false;
+}
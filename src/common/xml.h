@@ -0,0 +1,42 @@
+#ifndef XML_H
+#define XML_H
+
+#include <QHash>
+#include <QVector>
+#include <QVarLengthArray>
+#include <QXmlStreamReader>
+
+namespace XML
+{
+	/* Interned element names. Maps the current element name of a stream
+	   reader to its index in the names table with a single hash lookup and
+	   without any string allocation, so that the parsers can dispatch the
+	   elements with a switch instead of a chain of string comparisons. */
+	class Names
+	{
+	public:
+		Names(const char * const names[], int count);
+
+		/* Returns the name index or -1 for unknown names */
+		int id(const QXmlStreamReader &reader) const;
+
+	private:
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+		typedef size_t HashValue;
+#else // QT 6
+		typedef uint HashValue;
+#endif // QT 6
+
+		QVector<QString> _names;
+		QHash<HashValue, int> _ids;
+	};
+
+	/* Element character data in a stack buffer, numbers and timestamps
+	   always fit into the preallocated space */
+	typedef QVarLengthArray<QChar, 64> Text;
+
+	/* readElementText() equivalent that does not create a QString */
+	bool readText(QXmlStreamReader &reader, Text &text);
+}
+
+#endif // XML_H
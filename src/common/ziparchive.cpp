@@ -0,0 +1,391 @@
+#include <cstring>
+#include <climits>
+#include <zlib.h>
+#include <QtEndian>
+#include <QBuffer>
+#include "mappedfile.h"
+#include "ziparchive.h"
+
+#define EOCD_SIGNATURE    0x06054b50
+#define EOCD64_SIGNATURE  0x06064b50
+#define LOCATOR_SIGNATURE 0x07064b50
+#define CDH_SIGNATURE     0x02014b50
+#define LFH_SIGNATURE     0x04034b50
+
+#define EOCD_SIZE    22
+#define EOCD64_SIZE  56
+#define LOCATOR_SIZE 20
+#define CDH_SIZE     46
+#define LFH_SIZE     30
+#define COMMENT_MAX  65535
+
+#define METHOD_STORED  0
+#define METHOD_DEFLATE 8
+
+#define FLAG_ENCRYPTED 0x0001
+#define FLAG_UTF8      0x0800
+
+#define INFLATE_CHUNK  (1<<30)
+
+int ZipArchive::_cacheLimit = 16384; /* KB */
+
+static inline quint16 u16(const char *data)
+{
+	return qFromLittleEndian<quint16>((const uchar*)data);
+}
+
+static inline quint32 u32(const char *data)
+{
+	return qFromLittleEndian<quint32>((const uchar*)data);
+}
+
+static inline quint64 u64(const char *data)
+{
+	return qFromLittleEndian<quint64>((const uchar*)data);
+}
+
+/* Inflates the raw deflate stream, at most outSize bytes are produced */
+static QByteArray inflateRaw(const char *data, quint64 size, quint64 outSize)
+{
+	z_stream strm;
+	QByteArray out;
+
+	if (size > UINT_MAX || outSize > INT_MAX)
+		return QByteArray();
+
+	memset(&strm, 0, sizeof(strm));
+	if (inflateInit2(&strm, -MAX_WBITS) != Z_OK)
+		return QByteArray();
+
+	out.resize(outSize);
+	strm.next_in = (Bytef*)data;
+	strm.avail_in = size;
+	strm.next_out = (Bytef*)out.data();
+	strm.avail_out = outSize;
+
+	int ret = inflate(&strm, Z_FINISH);
+	inflateEnd(&strm);
+	if (!(ret == Z_STREAM_END || strm.avail_out == 0))
+		return QByteArray();
+
+	out.resize(strm.total_out);
+
+	return out;
+}
+
+/* Sequential device inflating a raw deflate stream on the fly */
+class InflateDevice : public QIODevice
+{
+public:
+	InflateDevice(const QByteArray &data) : _data(data), _pos(0), _end(false)
+	{
+		memset(&_strm, 0, sizeof(_strm));
+		_ok = (inflateInit2(&_strm, -MAX_WBITS) == Z_OK);
+	}
+	~InflateDevice()
+	{
+		if (_ok)
+			inflateEnd(&_strm);
+	}
+
+	bool isSequential() const {return true;}
+	bool atEnd() const {return (_end && QIODevice::bytesAvailable() == 0);}
+
+protected:
+	qint64 readData(char *data, qint64 maxSize);
+	qint64 writeData(const char *data, qint64 maxSize)
+	  {Q_UNUSED(data); Q_UNUSED(maxSize); return -1;}
+
+private:
+	QByteArray _data;
+	qint64 _pos;
+	z_stream _strm;
+	bool _ok;
+	bool _end;
+};
+
+qint64 InflateDevice::readData(char *data, qint64 maxSize)
+{
+	if (_end)
+		return 0;
+	if (!_ok)
+		return -1;
+
+	_strm.next_out = (Bytef*)data;
+	_strm.avail_out = qMin<qint64>(maxSize, INFLATE_CHUNK);
+
+	while (_strm.avail_out) {
+		if (!_strm.avail_in) {
+			if (_pos >= _data.size())
+				return -1;
+			_strm.next_in = (Bytef*)_data.constData() + _pos;
+			_strm.avail_in = qMin<qint64>(_data.size() - _pos, INFLATE_CHUNK);
+			_pos += _strm.avail_in;
+		}
+
+		int ret = inflate(&_strm, Z_NO_FLUSH);
+		if (ret == Z_STREAM_END) {
+			_end = true;
+			break;
+		} else if (ret != Z_OK)
+			return -1;
+	}
+
+	return (Bytef*)_strm.next_out - (Bytef*)data;
+}
+
+
+ZipArchive::ZipArchive(const QString &fileName)
+  : _file(fileName), _mapped(0)
+{
+}
+
+ZipArchive::~ZipArchive()
+{
+	close();
+}
+
+bool ZipArchive::open()
+{
+	if (!_file.open(QIODevice::ReadOnly)) {
+		_errorString = _file.errorString();
+		return false;
+	}
+	_mapped = new MappedFile(&_file);
+
+	/* The index is kept between close()/open() calls */
+	if (_index.isEmpty() && !readDirectory()) {
+		_errorString = "Invalid ZIP central directory";
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void ZipArchive::close()
+{
+	_cache.clear();
+
+	delete _mapped;
+	_mapped = 0;
+	_file.close();
+}
+
+bool ZipArchive::readDirectory()
+{
+	qint64 size = _mapped->size();
+	qint64 tail = qMin(size, (qint64)(LOCATOR_SIZE + EOCD_SIZE + COMMENT_MAX));
+
+	if (tail < EOCD_SIZE || !_mapped->seek(size - tail))
+		return false;
+	QByteArray ba(_mapped->read(tail));
+	if (ba.size() != tail)
+		return false;
+	const char *data = ba.constData();
+
+	qint64 eocd = -1;
+	for (qint64 i = tail - EOCD_SIZE; i >= 0; i--) {
+		if (u32(data + i) == EOCD_SIGNATURE) {
+			eocd = i;
+			break;
+		}
+	}
+	if (eocd < 0)
+		return false;
+
+	quint64 count = u16(data + eocd + 10);
+	quint64 cdSize = u32(data + eocd + 12);
+	quint64 cdOffset = u32(data + eocd + 16);
+
+	if (eocd >= LOCATOR_SIZE
+	  && u32(data + eocd - LOCATOR_SIZE) == LOCATOR_SIGNATURE) {
+		if (!_mapped->seek(u64(data + eocd - LOCATOR_SIZE + 8)))
+			return false;
+		QByteArray rec(_mapped->read(EOCD64_SIZE));
+		if (rec.size() != EOCD64_SIZE
+		  || u32(rec.constData()) != EOCD64_SIGNATURE)
+			return false;
+		count = u64(rec.constData() + 32);
+		cdSize = u64(rec.constData() + 40);
+		cdOffset = u64(rec.constData() + 48);
+	}
+
+	if (cdOffset + cdSize > (quint64)size || cdSize > INT_MAX
+	  || !_mapped->seek(cdOffset))
+		return false;
+	QByteArray cd(_mapped->read(cdSize));
+	if ((quint64)cd.size() != cdSize)
+		return false;
+
+	qint64 pos = 0;
+	for (quint64 i = 0; i < count; i++)
+		if (!readEntry(cd.constData(), cd.size(), pos))
+			return false;
+
+	return !_index.isEmpty();
+}
+
+bool ZipArchive::readEntry(const char *data, qint64 size, qint64 &pos)
+{
+	if (size - pos < CDH_SIZE || u32(data + pos) != CDH_SIGNATURE)
+		return false;
+
+	const char *hdr = data + pos;
+	quint16 flags = u16(hdr + 8);
+	quint16 nameLen = u16(hdr + 28);
+	quint16 extraLen = u16(hdr + 30);
+	quint16 commentLen = u16(hdr + 32);
+	Entry entry;
+
+	if (size - pos < CDH_SIZE + nameLen + extraLen + commentLen)
+		return false;
+
+	entry.method = u16(hdr + 10);
+	entry.compressedSize = u32(hdr + 20);
+	entry.size = u32(hdr + 24);
+	entry.offset = u32(hdr + 42);
+
+	/* ZIP64 extended information extra field */
+	const char *extra = hdr + CDH_SIZE + nameLen;
+	for (int i = 0; i + 4 <= extraLen; ) {
+		quint16 id = u16(extra + i);
+		quint16 len = u16(extra + i + 2);
+		if (i + 4 + len > extraLen)
+			break;
+
+		if (id == 0x0001) {
+			const char *p = extra + i + 4;
+			const char *end = p + len;
+
+			if (entry.size == 0xFFFFFFFF && p + 8 <= end) {
+				entry.size = u64(p);
+				p += 8;
+			}
+			if (entry.compressedSize == 0xFFFFFFFF && p + 8 <= end) {
+				entry.compressedSize = u64(p);
+				p += 8;
+			}
+			if (entry.offset == 0xFFFFFFFF && p + 8 <= end)
+				entry.offset = u64(p);
+		}
+
+		i += 4 + len;
+	}
+
+	QString name((flags & FLAG_UTF8)
+	  ? QString::fromUtf8(hdr + CDH_SIZE, nameLen)
+	  : QString::fromLocal8Bit(hdr + CDH_SIZE, nameLen));
+	if (!(flags & FLAG_ENCRYPTED))
+		_index.insert(name, entry);
+
+	pos += CDH_SIZE + nameLen + extraLen + commentLen;
+
+	return true;
+}
+
+qint64 ZipArchive::dataOffset(const Entry &entry)
+{
+	if (!_mapped->seek(entry.offset))
+		return -1;
+	const char *hdr = _mapped->data(LFH_SIZE);
+	if (!hdr || u32(hdr) != LFH_SIGNATURE)
+		return -1;
+
+	quint64 offset = entry.offset + LFH_SIZE + u16(hdr + 26) + u16(hdr + 28);
+
+	return (offset + entry.compressedSize <= (quint64)_mapped->size())
+	  ? (qint64)offset : -1;
+}
+
+bool ZipArchive::stored(const QString &name, qint64 &offset, qint64 &size)
+{
+	QHash<QString, Entry>::const_iterator it(_index.constFind(name));
+
+	if (!isOpen() || it == _index.constEnd() || it->method != METHOD_STORED)
+		return false;
+
+	offset = dataOffset(*it);
+	size = it->size;
+
+	return (offset >= 0);
+}
+
+/* Returns the entry data. With maxSize set, only the first (at least) maxSize
+   bytes of the entry may be returned. Stored entries of mapped archives are
+   returned without copying the data. */
+QByteArray ZipArchive::fileData(const QString &name, qint64 maxSize)
+{
+	QHash<QString, Entry>::const_iterator it(_index.constFind(name));
+	if (!isOpen() || it == _index.constEnd())
+		return QByteArray();
+	const Entry &entry = *it;
+
+	QByteArray *cached = _cache.object(name);
+	if (cached)
+		return *cached;
+
+	qint64 offset = dataOffset(entry);
+	if (offset < 0 || !_mapped->seek(offset))
+		return QByteArray();
+
+	if (entry.method == METHOD_STORED) {
+		if (!_mapped->isMapped())
+			return _mapped->read(entry.size);
+		const char *data = _mapped->data(entry.size);
+		return data ? QByteArray::fromRawData(data, entry.size) : QByteArray();
+	} else if (entry.method == METHOD_DEFLATE) {
+		bool partial = (maxSize >= 0 && (quint64)maxSize < entry.size);
+		const char *data = _mapped->data(entry.compressedSize);
+		if (!data)
+			return QByteArray();
+
+		QByteArray ba(inflateRaw(data, entry.compressedSize,
+		  partial ? maxSize : entry.size));
+		if (!partial && (quint64)ba.size() == entry.size) {
+			if (_cache.maxCost() != _cacheLimit)
+				_cache.setMaxCost(_cacheLimit);
+			_cache.insert(name, new QByteArray(ba), qMax(ba.size() / 1024, 1));
+		}
+
+		return ba;
+	} else
+		return QByteArray();
+}
+
+QIODevice *ZipArchive::device(const QString &name)
+{
+	QHash<QString, Entry>::const_iterator it(_index.constFind(name));
+	if (!isOpen() || it == _index.constEnd())
+		return 0;
+	const Entry &entry = *it;
+
+	qint64 offset = dataOffset(entry);
+	if (offset < 0 || !_mapped->seek(offset))
+		return 0;
+
+	QIODevice *dev;
+	if (entry.method == METHOD_STORED) {
+		QBuffer *buffer = new QBuffer();
+		buffer->setData(fileData(name));
+		dev = buffer;
+	} else if (entry.method == METHOD_DEFLATE) {
+		if (entry.compressedSize > INT_MAX)
+			return 0;
+		QByteArray data;
+		if (_mapped->isMapped()) {
+			const char *ptr = _mapped->data(entry.compressedSize);
+			if (ptr)
+				data = QByteArray::fromRawData(ptr, entry.compressedSize);
+		} else
+			data = _mapped->read(entry.compressedSize);
+		if ((quint64)data.size() != entry.compressedSize)
+			return 0;
+		dev = new InflateDevice(data);
+	} else
+		return 0;
+
+	dev->open(QIODevice::ReadOnly);
+
+	return dev;
+}
@@ -0,0 +1,64 @@
+#ifndef ZIPARCHIVE_H
+#define ZIPARCHIVE_H
+
+#include <QFile>
+#include <QHash>
+#include <QStringList>
+#include <QCache>
+#include <QByteArray>
+
+class MappedFile;
+
+/* Random access reader of ZIP archives. The central directory is parsed only
+   once on open() into a name index, the archive file is memory mapped (when
+   possible) and the stored (uncompressed) entries are returned as non-owning
+   views of the mapped data that are valid until close(). The inflated
+   entries are kept in a small LRU cache. The class is not thread-safe. */
+class ZipArchive
+{
+public:
+	ZipArchive(const QString &fileName);
+	~ZipArchive();
+
+	bool open();
+	void close();
+	bool isOpen() const {return (_mapped != 0);}
+	QString fileName() const {return _file.fileName();}
+	const QString &errorString() const {return _errorString;}
+
+	bool contains(const QString &name) const {return _index.contains(name);}
+	QByteArray fileData(const QString &name, qint64 maxSize = -1);
+	bool stored(const QString &name, qint64 &offset, qint64 &size);
+	QStringList fileNames() const {return _index.keys();}
+
+	/* Returns a new (caller owned) sequential device reading the entry data,
+	   the deflated entries are inflated on the fly while being read. The
+	   device must not be used after close(). */
+	QIODevice *device(const QString &name);
+
+	static void setCacheSize(int size) {_cacheLimit = size;}
+
+private:
+	struct Entry {
+		Entry() : method(0), compressedSize(0), size(0), offset(0) {}
+
+		quint16 method;
+		quint64 compressedSize;
+		quint64 size;
+		quint64 offset;
+	};
+
+	bool readDirectory();
+	bool readEntry(const char *data, qint64 size, qint64 &pos);
+	qint64 dataOffset(const Entry &entry);
+
+	QFile _file;
+	MappedFile *_mapped;
+	QHash<QString, Entry> _index;
+	QCache<QString, QByteArray> _cache;
+	QString _errorString;
+
+	static int _cacheLimit;
+};
+
+#endif // ZIPARCHIVE_H
@@ -0,0 +1,246 @@
+#include <cctype>
+#include <cstring>
+#include <zlib.h>
+#include "common/ziparchive.h"
+#include "archive.h"
+
+
+#define BLOCKSIZE      512
+#define INPUT_SIZE     65536
+#define MAX_ENTRY_SIZE (1<<30)
+#define MAX_NAME_SIZE  4096
+
+#define BLOCKCOUNT(size) \
+	((size)/BLOCKSIZE + ((size) % BLOCKSIZE > 0 ? 1 : 0))
+
+/* TAR header fields offsets */
+#define TAR_NAME     0
+#define TAR_SIZE     124
+#define TAR_TYPEFLAG 156
+#define TAR_MAGIC    257
+#define TAR_PREFIX   345
+
+static quint64 number(const char* data, size_t size)
+{
+	const char *sp;
+	quint64 val = 0;
+
+	for (sp = data; sp < data + size; sp++)
+		if (isdigit(*sp))
+			break;
+	for (; sp < data + size && isdigit(*sp); sp++)
+		val = val * 8 + *sp - '0';
+
+	return val;
+}
+
+static QByteArray string(const char *data, size_t size)
+{
+	const char *end = (const char*)memchr(data, 0, size);
+	return QByteArray(data, end ? end - data : size);
+}
+
+Archive::Type Archive::type(const QString &fileName)
+{
+	QString name(fileName.toLower());
+
+	if (name.endsWith(".zip"))
+		return ZIP;
+	else if (name.endsWith(".tar"))
+		return TAR;
+	else if (name.endsWith(".tgz") || name.endsWith(".tar.gz"))
+		return TGZ;
+	else
+		return Unknown;
+}
+
+bool Archive::isArchive(const QString &fileName)
+{
+	return (type(fileName) != Unknown);
+}
+
+QStringList Archive::filter()
+{
+	return QStringList() << "*.zip" << "*.tar" << "*.tgz" << "*.tar.gz";
+}
+
+Archive::Archive(const QString &fileName)
+  : _type(type(fileName)), _file(fileName), _zip(0), _next(0), _strm(0)
+{
+}
+
+Archive::~Archive()
+{
+	delete _zip;
+
+	if (_strm) {
+		inflateEnd(_strm);
+		delete _strm;
+	}
+}
+
+bool Archive::open()
+{
+	switch (_type) {
+		case ZIP:
+			_zip = new ZipArchive(_file.fileName());
+			if (!_zip->open()) {
+				_errorString = _zip->errorString();
+				return false;
+			}
+			_names = _zip->fileNames();
+			_names.sort();
+			return true;
+		case TGZ:
+			_strm = new z_stream;
+			memset(_strm, 0, sizeof(z_stream));
+			/* 16 = gzip header and trailer */
+			if (inflateInit2(_strm, MAX_WBITS + 16) != Z_OK) {
+				_errorString = "zlib initialization error";
+				return false;
+			}
+			_in.resize(INPUT_SIZE);
+			/* fallthrough */
+		case TAR:
+			if (!_file.open(QIODevice::ReadOnly)) {
+				_errorString = _file.errorString();
+				return false;
+			}
+			return true;
+		default:
+			_errorString = "Unknown archive format";
+			return false;
+	}
+}
+
+qint64 Archive::read(char *data, qint64 maxSize)
+{
+	if (!_strm)
+		return _file.read(data, maxSize);
+
+	_strm->next_out = (Bytef*)data;
+	_strm->avail_out = maxSize;
+
+	while (_strm->avail_out) {
+		if (!_strm->avail_in) {
+			qint64 size = _file.read(_in.data(), _in.size());
+			if (size < 0)
+				return -1;
+			else if (!size)
+				break;
+			_strm->next_in = (Bytef*)_in.data();
+			_strm->avail_in = size;
+		}
+
+		int ret = inflate(_strm, Z_NO_FLUSH);
+		if (ret == Z_STREAM_END)
+			break;
+		else if (ret != Z_OK)
+			return -1;
+	}
+
+	return maxSize - _strm->avail_out;
+}
+
+bool Archive::readTAR(char *data, qint64 size)
+{
+	while (size > 0) {
+		qint64 ret = read(data, qMin(size, (qint64)MAX_ENTRY_SIZE));
+		if (ret <= 0)
+			return false;
+		data += ret;
+		size -= ret;
+	}
+
+	return true;
+}
+
+bool Archive::skipTAR(qint64 size)
+{
+	if (!_strm)
+		return _file.seek(_file.pos() + size);
+
+	char buffer[BLOCKSIZE * 16];
+	while (size > 0) {
+		qint64 len = qMin(size, (qint64)sizeof(buffer));
+		if (!readTAR(buffer, len))
+			return false;
+		size -= len;
+	}
+
+	return true;
+}
+
+bool Archive::nextTAR(QString &name, QByteArray &data)
+{
+	char hdr[BLOCKSIZE];
+	QByteArray longName;
+
+	while (true) {
+		qint64 ret = read(hdr, BLOCKSIZE);
+		/* A missing end of archive marker is not an error */
+		if (!ret || (ret == BLOCKSIZE && !hdr[TAR_NAME]))
+			return false;
+		if (ret < BLOCKSIZE) {
+			_errorString = "Error reading TAR header block";
+			return false;
+		}
+
+		quint64 size = number(hdr + TAR_SIZE, 12);
+		qint64 blocks = BLOCKCOUNT(size) * BLOCKSIZE;
+		char type = hdr[TAR_TYPEFLAG];
+
+		if (type == 'L') {
+			/* GNU long name of the next entry */
+			if (size > MAX_NAME_SIZE) {
+				_errorString = "Invalid TAR long name";
+				return false;
+			}
+			longName.resize(blocks);
+			if (!readTAR(longName.data(), blocks)) {
+				_errorString = "Error reading TAR data blocks";
+				return false;
+			}
+			longName = string(longName.constData(), size);
+		} else if ((type == '0' || type == '\0') && size <= MAX_ENTRY_SIZE) {
+			if (longName.isEmpty()) {
+				QByteArray path(string(hdr + TAR_NAME, 100));
+				if (!memcmp(hdr + TAR_MAGIC, "ustar", 5) && hdr[TAR_PREFIX])
+					path = string(hdr + TAR_PREFIX, 155) + "/" + path;
+				name = QString::fromUtf8(path);
+			} else
+				name = QString::fromUtf8(longName);
+
+			data.resize(size);
+			if (!(readTAR(data.data(), size) && skipTAR(blocks - size))) {
+				_errorString = "Error reading TAR data blocks";
+				return false;
+			}
+
+			return true;
+		} else {
+			/* Directories, links, PAX headers and oversized files */
+			if (!skipTAR(blocks)) {
+				_errorString = "Error skipping TAR data blocks";
+				return false;
+			}
+			longName.clear();
+		}
+	}
+}
+
+bool Archive::next(QString &name, QByteArray &data)
+{
+	if (_type != ZIP)
+		return nextTAR(name, data);
+
+	while (_next < _names.size()) {
+		name = _names.at(_next++);
+		if (name.endsWith('/'))
+			continue;
+		data = _zip->fileData(name);
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,51 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <QFile>
+#include <QStringList>
+#include <QByteArray>
+
+class ZipArchive;
+struct z_stream_s;
+
+/* Sequential reader of the data files archives (ZIP, TAR and gzip
+   compressed TAR). The entries are read in the archive order, the compressed
+   TAR archives are inflated on the fly so the archive is never extracted as
+   a whole. */
+class Archive
+{
+public:
+	Archive(const QString &fileName);
+	~Archive();
+
+	bool open();
+	const QString &errorString() const {return _errorString;}
+
+	/* Reads the next regular file entry. Returns false at the end of the
+	   archive or on error (errorString() is set in such case). */
+	bool next(QString &name, QByteArray &data);
+
+	static bool isArchive(const QString &fileName);
+	static QStringList filter();
+
+private:
+	enum Type {Unknown, ZIP, TAR, TGZ};
+
+	static Type type(const QString &fileName);
+
+	qint64 read(char *data, qint64 maxSize);
+	bool readTAR(char *data, qint64 size);
+	bool skipTAR(qint64 size);
+	bool nextTAR(QString &name, QByteArray &data);
+
+	Type _type;
+	QFile _file;
+	ZipArchive *_zip;
+	QStringList _names;
+	int _next;
+	z_stream_s *_strm;
+	QByteArray _in;
+	QString _errorString;
+};
+
+#endif // ARCHIVE_H
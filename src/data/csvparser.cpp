@@ -1,49 +1,85 @@
-#include <QByteArrayList>
+#include <QBuffer>
 #include "common/csv.h"
+#include "common/parse.h"
 #include "csvparser.h"
 
-bool CSVParser::parse(QFile *file, QList<TrackData> &tracks,
-  QList<RouteData> &routes, QList<Area> &polygons,
-  QVector<Waypoint> &waypoints)
+static QString toString(const CSV::Field &field)
 {
-	Q_UNUSED(tracks);
-	Q_UNUSED(routes);
-	Q_UNUSED(polygons);
-	CSV csv(file);
-	QByteArrayList entry;
-	bool ok;
+	return QString::fromUtf8(field.constData(), field.size());
+}
+
+bool CSVParser::readEntries(QIODevice *device, QVector<Waypoint> &waypoints)
+{
+	CSV csv(device);
+	double lon, lat;
 
 	while (!csv.atEnd()) {
-		if (!csv.readEntry(entry)) {
+		if (!csv.readEntry()) {
 			_errorString = "Parse error";
-			_errorLine = csv.line();
+			_errorLine = _lines + csv.line();
 			return false;
 		}
-		if (entry.size() < 3) {
+		if (csv.fields() < 3) {
 			_errorString = "Invalid column count";
-			_errorLine = csv.line() - 1;
+			_errorLine = _lines + csv.line() - 1;
 			return false;
 		}
 
-		double lon = entry.at(0).toDouble(&ok);
-		if (!ok || (lon < -180.0 || lon > 180.0)) {
+		if (!Parse::toDouble(csv.field(0), lon)
+		  || (lon < -180.0 || lon > 180.0)) {
 			_errorString = "Invalid longitude";
-			_errorLine = csv.line() - 1;
+			_errorLine = _lines + csv.line() - 1;
 			return false;
 		}
-		double lat = entry.at(1).toDouble(&ok);
-		if (!ok || (lat < -90.0 || lat > 90.0)) {
+		if (!Parse::toDouble(csv.field(1), lat)
+		  || (lat < -90.0 || lat > 90.0)) {
 			_errorString = "Invalid latitude";
-			_errorLine = csv.line() - 1;
+			_errorLine = _lines + csv.line() - 1;
 			return false;
 		}
 		Waypoint wp(Coordinates(lon, lat));
-		wp.setName(entry.at(2));
-		if (entry.size() > 3)
-			wp.setDescription(entry.at(3));
+		wp.setName(toString(csv.field(2)));
+		if (csv.fields() > 3)
+			wp.setDescription(toString(csv.field(3)));
 
 		waypoints.append(wp);
 	}
 
+	_lines += csv.line() - 1;
+
 	return true;
 }
+
+bool CSVParser::parse(QIODevice *file, QList<TrackData> &tracks,
+  QList<RouteData> &routes, QList<Area> &polygons,
+  QVector<Waypoint> &waypoints)
+{
+	Q_UNUSED(tracks);
+	Q_UNUSED(routes);
+	Q_UNUSED(polygons);
+
+	_lines = 0;
+
+	return readEntries(file, waypoints);
+}
+
+bool CSVParser::tail(QFile *file, SegmentData &segment,
+  QVector<Waypoint> &waypoints)
+{
+	Q_UNUSED(segment);
+	qint64 pos = file->pos();
+	QByteArray data(file->readAll());
+
+	/* Only the complete lines are parsed, the rest is left for the next
+	   call */
+	data.truncate(data.lastIndexOf('\n') + 1);
+	if (!file->seek(pos + data.size())) {
+		_errorString = "I/O error";
+		return false;
+	}
+
+	QBuffer buffer(&data);
+	buffer.open(QIODevice::ReadOnly);
+
+	return readEntries(&buffer, waypoints);
+}
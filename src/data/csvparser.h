@@ -6,16 +6,23 @@
 class CSVParser : public Parser
 {
 public:
-	CSVParser() : _errorLine(0) {}
+	CSVParser() : _errorLine(0), _lines(0) {}
 
-	bool parse(QFile *file, QList<TrackData> &tracks, QList<RouteData> &routes,
-	  QList<Area> &polygons, QVector<Waypoint> &waypoints);
+	bool parse(QIODevice *file, QList<TrackData> &tracks,
+	  QList<RouteData> &routes, QList<Area> &polygons,
+	  QVector<Waypoint> &waypoints);
 	QString errorString() const {return _errorString;}
 	int errorLine() const {return _errorLine;}
 
+	bool canTail() const {return true;}
+	bool tail(QFile *file, SegmentData &segment, QVector<Waypoint> &waypoints);
+
 private:
+	bool readEntries(QIODevice *device, QVector<Waypoint> &waypoints);
+
 	QString _errorString;
 	int _errorLine;
+	int _lines;
 };
 
 #endif // CSVPARSER_H
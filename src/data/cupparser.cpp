@@ -120,7 +120,7 @@ bool CUPParser::task(const QString &fileName, const QByteArrayList &entry,
 	return true;
 }
 
-bool CUPParser::parse(QFile *file, QList<TrackData> &tracks,
+bool CUPParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons,
   QVector<Waypoint> &waypoints)
 {
@@ -156,7 +156,7 @@ bool CUPParser::parse(QFile *file, QList<TrackData> &tracks,
 				return false;
 		} else if (segment == Tasks) {
 			if (entry.at(0) != "Options" && !entry.at(0).startsWith("ObsZone=")
-			  && !task(file->fileName(), entry, waypoints, routes))
+			  && !task(fileName(file), entry, waypoints, routes))
 				return false;
 		}
 
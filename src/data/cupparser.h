@@ -8,8 +8,9 @@ class CUPParser : public Parser
 public:
 	CUPParser() : _errorLine(0) {}
 
-	bool parse(QFile *file, QList<TrackData> &tracks, QList<RouteData> &routes,
-	  QList<Area> &polygons, QVector<Waypoint> &waypoints);
+	bool parse(QIODevice *file, QList<TrackData> &tracks,
+	  QList<RouteData> &routes, QList<Area> &polygons,
+	  QVector<Waypoint> &waypoints);
 	QString errorString() const {return _errorString;}
 	int errorLine() const {return _errorLine;}
 
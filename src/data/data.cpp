@@ -1,7 +1,11 @@
 #include <QApplication>
 #include <QFile>
 #include <QFileInfo>
+#include <QScopedPointer>
+#include <QBuffer>
 #include "common/util.h"
+#include "common/trace.h"
+#include "common/threadpools.h"
 #include "map/crs.h"
 #include "gpxparser.h"
 #include "tcxparser.h"
@@ -26,76 +30,84 @@
 #include "txtparser.h"
 #include "vtkparser.h"
 #include "vkxparser.h"
+#include "datacache.h"
+#include "archive.h"
 #include "data.h"
 
 
-static GPXParser gpx;
-static TCXParser tcx;
-static KMLParser kml;
-static FITParser fit;
-static CSVParser csv;
-static IGCParser igc;
-static NMEAParser nmea;
-static PLTParser plt;
-static WPTParser wpt;
-static RTEParser rte;
-static LOCParser loc;
-static SLFParser slf;
-static GeoJSONParser geojson;
-static EXIFParser exif;
-static CUPParser cup;
-static GPIParser gpi;
-static SMLParser sml;
-static OV2Parser ov2;
-static ITNParser itn;
-static OMDParser omd;
-static GHPParser ghp;
-static TwoNavParser twonav;
-static GPSDumpParser gpsdump;
-static TXTParser txt;
-static VTKParser vtk;
-static VKXParser vkx;
-
-static QMultiMap<QString, Parser*> parsers()
+template<class T> static Parser *create()
 {
-	QMultiMap<QString, Parser*> map;
-
-	map.insert("gpx", &gpx);
-	map.insert("tcx", &tcx);
-	map.insert("kml", &kml);
-	map.insert("kmz", &kml);
-	map.insert("fit", &fit);
-	map.insert("csv", &csv);
-	map.insert("igc", &igc);
-	map.insert("nmea", &nmea);
-	map.insert("plt", &plt);
-	map.insert("wpt", &wpt);
-	map.insert("rte", &rte);
-	map.insert("loc", &loc);
-	map.insert("slf", &slf);
-	map.insert("json", &geojson);
-	map.insert("geojson", &geojson);
-	map.insert("jpeg", &exif);
-	map.insert("jpg", &exif);
-	map.insert("cup", &cup);
-	map.insert("gpi", &gpi);
-	map.insert("sml", &sml);
-	map.insert("ov2", &ov2);
-	map.insert("itn", &itn);
-	map.insert("omd", &omd);
-	map.insert("ghp", &ghp);
-	map.insert("trk", &twonav);
-	map.insert("rte", &twonav);
-	map.insert("wpt", &twonav);
-	map.insert("wpt", &gpsdump);
-	map.insert("txt", &txt);
-	map.insert("vtk", &vtk);
-	map.insert("vkx", &vkx);
+	return new T();
+}
+
+static QMultiMap<QString, Data::ParserFactory> parsers()
+{
+	QMultiMap<QString, Data::ParserFactory> map;
+
+	map.insert("gpx", &create<GPXParser>);
+	map.insert("tcx", &create<TCXParser>);
+	map.insert("kml", &create<KMLParser>);
+	map.insert("kmz", &create<KMLParser>);
+	map.insert("fit", &create<FITParser>);
+	map.insert("csv", &create<CSVParser>);
+	map.insert("igc", &create<IGCParser>);
+	map.insert("nmea", &create<NMEAParser>);
+	map.insert("plt", &create<PLTParser>);
+	map.insert("wpt", &create<WPTParser>);
+	map.insert("rte", &create<RTEParser>);
+	map.insert("loc", &create<LOCParser>);
+	map.insert("slf", &create<SLFParser>);
+	map.insert("json", &create<GeoJSONParser>);
+	map.insert("geojson", &create<GeoJSONParser>);
+	map.insert("jpeg", &create<EXIFParser>);
+	map.insert("jpg", &create<EXIFParser>);
+	map.insert("cup", &create<CUPParser>);
+	map.insert("gpi", &create<GPIParser>);
+	map.insert("sml", &create<SMLParser>);
+	map.insert("ov2", &create<OV2Parser>);
+	map.insert("itn", &create<ITNParser>);
+	map.insert("omd", &create<OMDParser>);
+	map.insert("ghp", &create<GHPParser>);
+	map.insert("trk", &create<TwoNavParser>);
+	map.insert("rte", &create<TwoNavParser>);
+	map.insert("wpt", &create<TwoNavParser>);
+	map.insert("wpt", &create<GPSDumpParser>);
+	map.insert("txt", &create<TXTParser>);
+	map.insert("vtk", &create<VTKParser>);
+	map.insert("vkx", &create<VKXParser>);
 
 	return map;
 }
 
-QMultiMap<QString, Parser*> Data::_parsers = parsers();
+QMultiMap<QString, Data::ParserFactory> Data::_parsers = parsers();
+
+/* The archive entries are parsed from in-memory buffers named by the entry
+   path */
+class Data::ArchiveEntry
+{
+public:
+	ArchiveEntry() : _data(0) {}
+	ArchiveEntry(const QString &name, const QByteArray &buffer)
+	  : _name(name), _buffer(buffer), _data(0) {}
+
+	Data *data() const {return _data;}
+
+	void load()
+	{
+		QBuffer buffer(&_buffer);
+		buffer.setObjectName(_name);
+
+		if (buffer.open(QIODevice::ReadOnly))
+			_data = new Data(buffer, _name);
+
+		_buffer = QByteArray();
+	}
+
+private:
+	QString _name;
+	QByteArray _buffer;
+	Data *_data;
+};
 
 void Data::processData(QList<TrackData> &trackData, QList<RouteData> &routeData)
 {
@@ -105,65 +117,200 @@ void Data::processData(QList<TrackData> &trackData, QList<RouteData> &routeData)
 		_routes.append(Route(routeData.at(i)));
 }
 
-Data::Data(const QString &fileName, bool tryUnknown)
+bool Data::parse(ParserFactory factory, QIODevice &file,
+  QList<TrackData> &trackData, QList<RouteData> &routeData, QStringList &errors,
+  Parser::Handler *handler)
 {
+	/* Every file gets its own parser instances as the parsers keep their
+	   state, so multiple files can be parsed at the same time. */
+	TRACE_SCOPE("data", "parse");
+	QScopedPointer<Parser> parser(factory());
+	parser->setHandler(handler);
+
+	if (parser->parse(&file, trackData, routeData, _polygons, _waypoints))
+		return true;
+
+	_errorLine = parser->errorLine();
+	_errorString = parser->errorString();
+	errors.append(QString("line %1: %2").arg(_errorLine).arg(_errorString));
+	file.reset();
+
+	return false;
+}
+
+Data::Data(const QString &fileName, bool tryUnknown, Parser::Handler *handler)
+{
+	TRACE_SCOPE("data", "load");
 	QFile file(fileName);
 	QFileInfo fi(Util::displayName(fileName));
 	QList<TrackData> trackData;
 	QList<RouteData> routeData;
+	QStringList errors;
 
 	_valid = false;
 	_errorLine = 0;
 
+	/* Directories are imported as one set of EXIF photo waypoints */
+	if (QFileInfo(fileName).isDir()) {
+		if (EXIFParser::parseDir(fileName, _waypoints))
+			_valid = true;
+		else
+			_errorString = "No geotagged JPEG images found";
+		return;
+	}
+
+	/* Archives are imported as one data set of all the contained files */
+	if (Archive::isArchive(fileName)) {
+		loadArchive(fileName);
+		return;
+	}
+
 	if (!file.open(QFile::ReadOnly)) {
 		_errorString = file.errorString();
 		return;
 	}
 
-	QMultiMap<QString, Parser*>::iterator it;
+	if (DataCache::load(fileName, trackData, routeData, _polygons,
+	  _waypoints)) {
+		processData(trackData, routeData);
+		_valid = true;
+		return;
+	}
+
+	QMultiMap<QString, ParserFactory>::const_iterator it;
 	QString suffix(fi.suffix().toLower());
-	if ((it = _parsers.find(suffix)) != _parsers.end()) {
-		while (it != _parsers.end() && it.key() == suffix) {
-			if (it.value()->parse(&file, trackData, routeData, _polygons,
-			  _waypoints)) {
+	if ((it = _parsers.constFind(suffix)) != _parsers.constEnd()) {
+		for (; it != _parsers.constEnd() && it.key() == suffix; ++it) {
+			if (parse(it.value(), file, trackData, routeData, errors,
+			  handler)) {
+				/* The streamed tracks are not part of the data */
+				if (!handler)
+					DataCache::save(fileName, trackData, routeData, _polygons,
+					  _waypoints);
 				processData(trackData, routeData);
 				_valid = true;
 				return;
-			} else {
-				_errorLine = it.value()->errorLine();
-				_errorString = it.value()->errorString();
 			}
-			file.reset();
-			++it;
 		}
 
 		qWarning("%s:", qUtf8Printable(fileName));
-		for (it = _parsers.find(suffix); it != _parsers.end()
-		  && it.key() == suffix; it++)
-			qWarning("  %s: line %d: %s", qUtf8Printable(it.key()),
-			  it.value()->errorLine(), qUtf8Printable(it.value()->errorString()));
+		for (int i = 0; i < errors.size(); i++)
+			qWarning("  %s: %s", qUtf8Printable(suffix),
+			  qUtf8Printable(errors.at(i)));
 
 	} else if (tryUnknown) {
-		for (it = _parsers.begin(); it != _parsers.end(); it++) {
-			if (it.value()->parse(&file, trackData, routeData, _polygons,
-			  _waypoints)) {
+		for (it = _parsers.constBegin(); it != _parsers.constEnd(); ++it) {
+			if (parse(it.value(), file, trackData, routeData, errors)) {
+				DataCache::save(fileName, trackData, routeData, _polygons,
+				  _waypoints);
 				processData(trackData, routeData);
 				_valid = true;
 				return;
 			}
-			file.reset();
 		}
 
 		qWarning("%s:", qUtf8Printable(fileName));
-		for (it = _parsers.begin(); it != _parsers.end(); it++)
-			qWarning("  %s: line %d: %s", qUtf8Printable(it.key()),
-			  it.value()->errorLine(), qUtf8Printable(it.value()->errorString()));
+		it = _parsers.constBegin();
+		for (int i = 0; i < errors.size(); i++, ++it)
+			qWarning("  %s: %s", qUtf8Printable(it.key()),
+			  qUtf8Printable(errors.at(i)));
 
 		_errorLine = 0;
 		_errorString = "Unknown format";
 	}
 }
 
+Data::Data(QIODevice &file, const QString &name) : _valid(false), _errorLine(0)
+{
+	QList<TrackData> trackData;
+	QList<RouteData> routeData;
+	QStringList errors;
+	QString suffix(QFileInfo(name).suffix().toLower());
+
+	QMultiMap<QString, ParserFactory>::const_iterator it;
+	for (it = _parsers.constFind(suffix); it != _parsers.constEnd()
+	  && it.key() == suffix; ++it) {
+		if (parse(it.value(), file, trackData, routeData, errors)) {
+			for (int i = 0; i < trackData.size(); i++)
+				trackData[i].setFile(name);
+			for (int i = 0; i < routeData.size(); i++)
+				routeData[i].setFile(name);
+			processData(trackData, routeData);
+			_valid = true;
+			return;
+		}
+	}
+
+	qWarning("%s:", qUtf8Printable(name));
+	for (int i = 0; i < errors.size(); i++)
+		qWarning("  %s: %s", qUtf8Printable(suffix),
+		  qUtf8Printable(errors.at(i)));
+}
+
+void Data::loadArchive(const QString &fileName)
+{
+	Archive archive(fileName);
+	QList<ArchiveEntry> batch;
+	QFuture<void> future;
+	QString name;
+	QByteArray buffer;
+	bool end = false;
+	int count = 0;
+
+	if (!archive.open()) {
+		_errorString = archive.errorString();
+		return;
+	}
+
+	QThreadPool *pool = ThreadPools::pool(ThreadPools::Parse);
+	int batchSize = qMax(1, pool->maxThreadCount()) * 2;
+
+	/* The next batch of entries is read (inflated) while the previous batch
+	   is being parsed */
+	while (!(end && batch.isEmpty())) {
+		QList<ArchiveEntry> next;
+		while (!end && next.size() < batchSize) {
+			if (!archive.next(name, buffer))
+				end = true;
+			else if (_parsers.contains(QFileInfo(name).suffix().toLower()))
+				next.append(ArchiveEntry(fileName + "/" + name, buffer));
+		}
+
+		/* The archive is usually loaded on a parser pool thread, its slot
+		   must be released while waiting or the loading of multiple archives
+		   deadlocks when all the pool threads wait for the entries */
+		pool->releaseThread();
+		future.waitForFinished();
+		pool->reserveThread();
+
+		for (int i = 0; i < batch.size(); i++) {
+			Data *data = batch.at(i).data();
+			if (data && data->isValid()) {
+				_tracks.append(data->_tracks);
+				_routes.append(data->_routes);
+				_polygons.append(data->_polygons);
+				_waypoints.append(data->_waypoints);
+				count++;
+			}
+			delete data;
+		}
+
+		batch = next;
+		future = ThreadPools::map(ThreadPools::Parse, batch,
+		  &ArchiveEntry::load);
+	}
+
+	if (!archive.errorString().isEmpty())
+		qWarning("%s: %s", qUtf8Printable(fileName),
+		  qUtf8Printable(archive.errorString()));
+
+	if (count)
+		_valid = true;
+	else
+		_errorString = archive.errorString().isEmpty()
+		  ? "No supported files found in the archive" : archive.errorString();
+}
+
 Data::Data(const QUrl &url)
 {
 	bool caOk, cbOk, ccOk;
@@ -251,6 +398,8 @@ QString Data::formats()
 	  + qApp->translate("Data", "SML files") + " (*.sml);;"
 	  + qApp->translate("Data", "TCX files") + " (*.tcx);;"
 	  + qApp->translate("Data", "70mai GPS log files") + " (*.txt);;"
+	  + qApp->translate("Data", "Archives") + " ("
+	    + Archive::filter().join(" ") + ");;"
 	  + qApp->translate("Data", "VKX files") + " (*.vkx);;"
 	  + qApp->translate("Data", "VTK files") + " (*.vtk);;"
 	  + qApp->translate("Data", "TwoNav files") + " (*.rte *.trk *.wpt);;"
@@ -263,12 +412,13 @@ QStringList Data::filter()
 	QStringList filter;
 	QString last;
 
-	for (QMultiMap<QString, Parser*>::iterator it = _parsers.begin();
-	  it != _parsers.end(); it++) {
+	for (QMultiMap<QString, ParserFactory>::const_iterator it
+	  = _parsers.constBegin(); it != _parsers.constEnd(); ++it) {
 		if (it.key() != last)
 			filter << "*." + it.key();
 		last = it.key();
 	}
+	filter << Archive::filter();
 
 	return filter;
 }
@@ -13,8 +13,14 @@
 class Data
 {
 public:
-	Data(const QString &fileName, bool tryUnknown = true);
+	typedef Parser *(*ParserFactory)();
+
+	Data(const QString &fileName, bool tryUnknown = true,
+	  Parser::Handler *handler = 0);
 	Data(const QUrl &url);
+	Data(const QList<Track> &tracks,
+	  const QVector<Waypoint> &waypoints = QVector<Waypoint>())
+	  : _valid(true), _errorLine(0), _tracks(tracks), _waypoints(waypoints) {}
 
 	bool isValid() const {return _valid;}
 	const QString &errorString() const {return _errorString;}
@@ -29,6 +35,14 @@ public:
 	static QStringList filter();
 
 private:
+	class ArchiveEntry;
+
+	Data(QIODevice &file, const QString &name);
+
+	void loadArchive(const QString &fileName);
+	bool parse(ParserFactory factory, QIODevice &file,
+	  QList<TrackData> &trackData, QList<RouteData> &routeData,
+	  QStringList &errors, Parser::Handler *handler = 0);
 	void processData(QList<TrackData> &trackData, QList<RouteData> &routeData);
 
 	bool _valid;
@@ -40,7 +54,7 @@ private:
 	QList<Area> _polygons;
 	QVector<Waypoint> _waypoints;
 
-	static QMultiMap<QString, Parser*> _parsers;
+	static QMultiMap<QString, ParserFactory> _parsers;
 };
 
 #endif // DATA_H
@@ -0,0 +1,547 @@
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include "common/programpaths.h"
+#include "common/mappedfile.h"
+#include "datacache.h"
+
+
+#define MAGIC   0x47504443
+#define VERSION 1
+#define SUFFIX  ".gpxsee-cache"
+
+#define INDEX_MAGIC  0x47504458
+#define INDEX_SUFFIX ".gpxsee-index"
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+#define BYTE_ORDER_MARK 1
+#else
+#define BYTE_ORDER_MARK 2
+#endif
+
+QMutex DataCache::_lock;
+qint64 DataCache::_limit = 0;
+qint64 DataCache::_size = -1;
+
+static void write(QDataStream &stream, const QVector<Link> &links)
+{
+	stream << (qint32)links.size();
+	for (int i = 0; i < links.size(); i++)
+		stream << links.at(i).URL() << links.at(i).text();
+}
+
+static bool read(QDataStream &stream, QVector<Link> &links)
+{
+	qint32 size;
+	QString url, text;
+
+	stream >> size;
+	for (int i = 0; i < size && stream.status() == QDataStream::Ok; i++) {
+		stream >> url >> text;
+		links.append(Link(url, text));
+	}
+
+	return (stream.status() == QDataStream::Ok);
+}
+
+static void write(QDataStream &stream, const QVector<Coordinates> &path)
+{
+	stream << (qint32)path.size();
+	stream.writeRawData((const char*)path.constData(),
+	  path.size() * sizeof(Coordinates));
+}
+
+static bool read(QDataStream &stream, QVector<Coordinates> &path)
+{
+	qint32 size;
+
+	stream >> size;
+	if (stream.status() != QDataStream::Ok || size < 0 || (qint64)size
+	  * (qint64)sizeof(Coordinates) > stream.device()->bytesAvailable())
+		return false;
+
+	int len = size * sizeof(Coordinates);
+	path.resize(size);
+	return (stream.readRawData((char*)path.data(), len) == len);
+}
+
+static void write(QDataStream &stream, const LineStyle &style)
+{
+	stream << style.color() << style.width() << (qint32)style.style();
+}
+
+static void read(QDataStream &stream, LineStyle &style)
+{
+	QColor color;
+	qreal width;
+	qint32 penStyle;
+
+	stream >> color >> width >> penStyle;
+	style = LineStyle(color, width, (Qt::PenStyle)penStyle);
+}
+
+static void write(QDataStream &stream, const Waypoint &waypoint)
+{
+	stream << waypoint.coordinates().lon() << waypoint.coordinates().lat()
+	  << waypoint.name() << waypoint.description() << waypoint.comment()
+	  << waypoint.address() << waypoint.phone() << waypoint.symbol()
+	  << waypoint.images() << waypoint.timestamp() << waypoint.elevation()
+	  << waypoint.style().icon() << waypoint.style().color()
+	  << (qint32)waypoint.style().size();
+	write(stream, waypoint.links());
+}
+
+static bool read(QDataStream &stream, Waypoint &waypoint)
+{
+	double lon, lat;
+	QString name, desc, comment, address, phone, symbol;
+	QVector<QString> images;
+	QDateTime timestamp;
+	qreal elevation;
+	QImage icon;
+	QColor color;
+	qint32 size;
+	QVector<Link> links;
+
+	stream >> lon >> lat >> name >> desc >> comment >> address >> phone
+	  >> symbol >> images >> timestamp >> elevation >> icon >> color >> size;
+	if (!read(stream, links))
+		return false;
+
+	waypoint.setCoordinates(Coordinates(lon, lat));
+	waypoint.setName(name);
+	waypoint.setDescription(desc);
+	waypoint.setComment(comment);
+	waypoint.setAddress(address);
+	waypoint.setPhone(phone);
+	waypoint.setSymbol(symbol);
+	for (int i = 0; i < images.size(); i++)
+		waypoint.addImage(images.at(i));
+	waypoint.setTimestamp(timestamp);
+	waypoint.setElevation(elevation);
+	waypoint.setStyle(PointStyle(icon, color, size));
+	for (int i = 0; i < links.size(); i++)
+		waypoint.addLink(links.at(i));
+
+	return true;
+}
+
+static void write(QDataStream &stream, const QVector<Waypoint> &waypoints)
+{
+	stream << (qint32)waypoints.size();
+	for (int i = 0; i < waypoints.size(); i++)
+		write(stream, waypoints.at(i));
+}
+
+static bool read(QDataStream &stream, QVector<Waypoint> &waypoints)
+{
+	qint32 size;
+
+	stream >> size;
+	if (stream.status() != QDataStream::Ok || size < 0)
+		return false;
+
+	waypoints.reserve(waypoints.size() + size);
+	for (int i = 0; i < size; i++) {
+		Waypoint w;
+		if (!read(stream, w))
+			return false;
+		waypoints.append(w);
+	}
+
+	return true;
+}
+
+template<class T>
+static void writeInfo(QDataStream &stream, const T &data)
+{
+	stream << data.name() << data.description() << data.comment()
+	  << data.file();
+	write(stream, data.links());
+	write(stream, data.style());
+}
+
+template<class T>
+static bool readInfo(QDataStream &stream, T &data)
+{
+	QString name, desc, comment, file;
+	QVector<Link> links;
+	LineStyle style;
+
+	stream >> name >> desc >> comment >> file;
+	if (!read(stream, links))
+		return false;
+	read(stream, style);
+
+	data.setName(name);
+	data.setDescription(desc);
+	data.setComment(comment);
+	data.setFile(file);
+	for (int i = 0; i < links.size(); i++)
+		data.addLink(links.at(i));
+	data.setStyle(style);
+
+	return (stream.status() == QDataStream::Ok);
+}
+
+static void write(QDataStream &stream, const TrackData &track)
+{
+	writeInfo(stream, track);
+	stream << (qint32)track.size();
+	for (int i = 0; i < track.size(); i++)
+		stream << track.at(i);
+}
+
+static bool read(QDataStream &stream, TrackData &track)
+{
+	qint32 size;
+
+	if (!readInfo(stream, track))
+		return false;
+	stream >> size;
+	if (stream.status() != QDataStream::Ok || size < 0)
+		return false;
+
+	track.reserve(size);
+	for (int i = 0; i < size; i++) {
+		SegmentData segment;
+		stream >> segment;
+		if (stream.status() != QDataStream::Ok)
+			return false;
+		track.append(segment);
+	}
+
+	return true;
+}
+
+static void write(QDataStream &stream, const RouteData &route)
+{
+	writeInfo(stream, route);
+	write(stream, static_cast<const QVector<Waypoint>&>(route));
+}
+
+static bool read(QDataStream &stream, RouteData &route)
+{
+	return (readInfo(stream, route)
+	  && read(stream, static_cast<QVector<Waypoint>&>(route)));
+}
+
+static void write(QDataStream &stream, const Area &area)
+{
+	const PolygonStyle &style = area.style();
+
+	stream << area.name() << area.description() << style.fill()
+	  << style.stroke() << style.width();
+
+	stream << (qint32)area.polygons().size();
+	for (int i = 0; i < area.polygons().size(); i++) {
+		const Polygon &polygon = area.polygons().at(i);
+
+		stream << (qint32)polygon.size();
+		for (int j = 0; j < polygon.size(); j++)
+			write(stream, polygon.at(j));
+	}
+}
+
+static bool read(QDataStream &stream, Area &area)
+{
+	QString name, desc;
+	QColor fill, stroke;
+	qreal width;
+	qint32 polygons, paths;
+
+	stream >> name >> desc >> fill >> stroke >> width >> polygons;
+	if (stream.status() != QDataStream::Ok || polygons < 0)
+		return false;
+
+	for (int i = 0; i < polygons; i++) {
+		Polygon polygon;
+
+		stream >> paths;
+		if (stream.status() != QDataStream::Ok || paths < 0)
+			return false;
+		for (int j = 0; j < paths; j++) {
+			QVector<Coordinates> path;
+			if (!read(stream, path))
+				return false;
+			polygon.append(path);
+		}
+
+		area.append(polygon);
+	}
+
+	area.setName(name);
+	area.setDescription(desc);
+	area.setStyle(PolygonStyle(fill, stroke, width));
+
+	return true;
+}
+
+template<class T>
+static void writeList(QDataStream &stream, const QList<T> &list)
+{
+	stream << (qint32)list.size();
+	for (int i = 0; i < list.size(); i++)
+		write(stream, list.at(i));
+}
+
+template<class T>
+static bool readList(QDataStream &stream, QList<T> &list)
+{
+	qint32 size;
+
+	stream >> size;
+	if (stream.status() != QDataStream::Ok || size < 0)
+		return false;
+
+	list.reserve(size);
+	for (int i = 0; i < size; i++) {
+		T item;
+		if (!read(stream, item))
+			return false;
+		list.append(item);
+	}
+
+	return true;
+}
+
+QString DataCache::cacheFile(const QFileInfo &fi, const char *suffix)
+{
+	QByteArray hash(QCryptographicHash::hash(fi.absoluteFilePath().toUtf8(),
+	  QCryptographicHash::Sha1));
+
+	return QDir(ProgramPaths::dataCacheDir()).filePath(
+	  QString::fromLatin1(hash.toHex()) + suffix);
+}
+
+bool DataCache::load(const QString &fileName, QList<TrackData> &tracks,
+  QList<RouteData> &routes, QList<Area> &areas, QVector<Waypoint> &waypoints)
+{
+	if (!_limit)
+		return false;
+
+	QFileInfo fi(fileName);
+	QFile file(cacheFile(fi, SUFFIX));
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	MappedFile mf(&file);
+	QByteArray ba(mf.bytes());
+	QBuffer buffer(&ba);
+	if (mf.isMapped())
+		buffer.open(QIODevice::ReadOnly);
+	QDataStream stream(mf.isMapped() ? (QIODevice*)&buffer : (QIODevice*)&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic;
+	quint16 version;
+	quint8 byteOrder;
+	qint64 size, time;
+	QString path;
+
+	stream >> magic >> version >> byteOrder >> size >> time >> path;
+	if (stream.status() != QDataStream::Ok || magic != MAGIC
+	  || version != VERSION || byteOrder != BYTE_ORDER_MARK
+	  || size != fi.size() || time != fi.lastModified().toMSecsSinceEpoch()
+	  || path != fi.absoluteFilePath())
+		return false;
+
+	QList<TrackData> t;
+	QList<RouteData> r;
+	QList<Area> a;
+	QVector<Waypoint> w;
+	if (!(readList(stream, t) && readList(stream, r) && readList(stream, a)
+	  && read(stream, w))) {
+		qWarning("%s: invalid data cache entry",
+		  qUtf8Printable(file.fileName()));
+		return false;
+	}
+
+	tracks = t;
+	routes = r;
+	areas = a;
+	waypoints = w;
+
+	/* Mark the entry as recently used */
+	file.close();
+	if (file.open(QIODevice::Append))
+		file.setFileTime(QDateTime::currentDateTime(),
+		  QFileDevice::FileModificationTime);
+
+	return true;
+}
+
+void DataCache::save(const QString &fileName, const QList<TrackData> &tracks,
+  const QList<RouteData> &routes, const QList<Area> &areas,
+  const QVector<Waypoint> &waypoints)
+{
+	if (!_limit)
+		return;
+
+	QFileInfo fi(fileName);
+	if (!QDir().mkpath(ProgramPaths::dataCacheDir()))
+		return;
+
+	QSaveFile file(cacheFile(fi, SUFFIX));
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+
+	stream << (quint32)MAGIC << (quint16)VERSION << (quint8)BYTE_ORDER_MARK
+	  << fi.size() << fi.lastModified().toMSecsSinceEpoch()
+	  << fi.absoluteFilePath();
+	writeList(stream, tracks);
+	writeList(stream, routes);
+	writeList(stream, areas);
+	write(stream, waypoints);
+
+	/* An existing entry is replaced, only the size difference counts */
+	qint64 size = file.size() - QFileInfo(file.fileName()).size();
+	if (stream.status() != QDataStream::Ok || !file.commit()) {
+		qWarning("%s: error writing data cache entry",
+		  qUtf8Printable(file.fileName()));
+		return;
+	}
+
+	evict(size);
+}
+
+QByteArray DataCache::loadIndex(const QString &fileName)
+{
+	if (!_limit)
+		return QByteArray();
+
+	QFileInfo fi(fileName);
+	QFile file(cacheFile(fi, INDEX_SUFFIX));
+	if (!file.open(QIODevice::ReadOnly))
+		return QByteArray();
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic;
+	quint16 version;
+	quint8 byteOrder;
+	qint64 size, time;
+	QString path;
+
+	stream >> magic >> version >> byteOrder >> size >> time >> path;
+	if (stream.status() != QDataStream::Ok || magic != INDEX_MAGIC
+	  || version != VERSION || byteOrder != BYTE_ORDER_MARK
+	  || size != fi.size() || time != fi.lastModified().toMSecsSinceEpoch()
+	  || path != fi.absoluteFilePath())
+		return QByteArray();
+
+	/* The index is the raw rest of the file */
+	QByteArray index(file.readAll());
+
+	file.close();
+	if (file.open(QIODevice::Append))
+		file.setFileTime(QDateTime::currentDateTime(),
+		  QFileDevice::FileModificationTime);
+
+	return index;
+}
+
+void DataCache::saveIndex(const QString &fileName, const QByteArray &index)
+{
+	if (!_limit)
+		return;
+
+	QFileInfo fi(fileName);
+	if (!QDir().mkpath(ProgramPaths::dataCacheDir()))
+		return;
+
+	QSaveFile file(cacheFile(fi, INDEX_SUFFIX));
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+
+	stream << (quint32)INDEX_MAGIC << (quint16)VERSION
+	  << (quint8)BYTE_ORDER_MARK << fi.size()
+	  << fi.lastModified().toMSecsSinceEpoch() << fi.absoluteFilePath();
+	stream.writeRawData(index.constData(), index.size());
+
+	qint64 size = file.size() - QFileInfo(file.fileName()).size();
+	if (stream.status() != QDataStream::Ok || !file.commit()) {
+		qWarning("%s: error writing data cache entry",
+		  qUtf8Printable(file.fileName()));
+		return;
+	}
+
+	evict(size);
+}
+
+void DataCache::removeAll()
+{
+	QDir dir(ProgramPaths::dataCacheDir());
+	QFileInfoList list(dir.entryInfoList(QStringList() << "*" SUFFIX
+	  << "*" INDEX_SUFFIX, QDir::Files));
+	for (int i = 0; i < list.size(); i++)
+		QFile::remove(list.at(i).absoluteFilePath());
+}
+
+void DataCache::evict(qint64 size)
+{
+	QMutexLocker locker(&_lock);
+
+	if (_size >= 0) {
+		_size += size;
+		if (_size <= _limit)
+			return;
+	}
+
+	QDir dir(ProgramPaths::dataCacheDir());
+	QFileInfoList list(dir.entryInfoList(QStringList() << "*" SUFFIX
+	  << "*" INDEX_SUFFIX, QDir::Files, QDir::Time));
+	qint64 total = 0;
+	int i;
+
+	for (i = 0; i < list.size(); i++)
+		total += list.at(i).size();
+	if (total <= _limit) {
+		_size = total;
+		return;
+	}
+
+	/* Remove the least recently used entries to get some headroom so that
+	   the directory does not have to be rescanned on every save. */
+	total = 0;
+	for (i = 0; i < list.size(); i++) {
+		if (total + list.at(i).size() > _limit - _limit / 10)
+			break;
+		total += list.at(i).size();
+	}
+	for (; i < list.size(); i++)
+		if (!QFile::remove(list.at(i).absoluteFilePath()))
+			total += list.at(i).size();
+
+	_size = total;
+}
+
+void DataCache::setCacheSize(int size)
+{
+	QMutexLocker locker(&_lock);
+
+	_limit = (qint64)size * 1024;
+
+	if (!_limit) {
+		removeAll();
+		_size = 0;
+	} else
+		_size = -1;
+}
+
+void DataCache::clear()
+{
+	QMutexLocker locker(&_lock);
+
+	removeAll();
+	_size = 0;
+}
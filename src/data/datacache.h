@@ -0,0 +1,47 @@
+#ifndef DATACACHE_H
+#define DATACACHE_H
+
+#include <QList>
+#include <QVector>
+#include <QString>
+#include <QMutex>
+#include "trackdata.h"
+#include "routedata.h"
+#include "waypoint.h"
+#include "area.h"
+
+class QFileInfo;
+
+/* On-disk cache of the parsed data. The entries are keyed by the file path,
+   size and modification time and are evicted in LRU order (the entries'
+   modification time is updated on every hit) when the cache size limit is
+   exceeded. */
+class DataCache
+{
+public:
+	static bool load(const QString &fileName, QList<TrackData> &tracks,
+	  QList<RouteData> &routes, QList<Area> &areas,
+	  QVector<Waypoint> &waypoints);
+	static void save(const QString &fileName, const QList<TrackData> &tracks,
+	  const QList<RouteData> &routes, const QList<Area> &areas,
+	  const QVector<Waypoint> &waypoints);
+
+	/* Spatial index (or other derived data) entries stored beside the data
+	   entries, validated and evicted the same way */
+	static QByteArray loadIndex(const QString &fileName);
+	static void saveIndex(const QString &fileName, const QByteArray &index);
+
+	static void setCacheSize(int size);
+	static void clear();
+
+private:
+	static QString cacheFile(const QFileInfo &fi, const char *suffix);
+	static void removeAll();
+	static void evict(qint64 size);
+
+	static QMutex _lock;
+	static qint64 _limit;
+	static qint64 _size;
+};
+
+#endif // DATACACHE_H
@@ -0,0 +1,118 @@
+#include <QEventLoop>
+#include "common/threadpools.h"
+#include "data.h"
+#include "dataloader.h"
+
+
+void DataLoader::File::load()
+{
+	_data = new Data(_fileName, _tryUnknown);
+}
+
+void DataLoader::File::clear()
+{
+	delete _data;
+	_data = 0;
+}
+
+DataLoader::DataLoader(const QStringList &files, bool tryUnknown,
+  QObject *parent) : QObject(parent), _next(0), _done(0), _running(0),
+  _canceled(0)
+{
+	for (int i = 0; i < files.size(); i++)
+		_files.append(File(files.at(i), tryUnknown));
+
+	/* Big enough to keep all the threads busy, small enough to show the
+	   first data soon */
+	_batchSize = qMax(1, ThreadPools::pool(ThreadPools::Parse)
+	  ->maxThreadCount()) * 4;
+
+	connect(&_watcher, &QFutureWatcher<void>::finished, this,
+	  &DataLoader::batchFinished);
+}
+
+DataLoader::~DataLoader()
+{
+	_future.cancel();
+	_future.waitForFinished();
+
+	for (int i = 0; i < _batch.size(); i++)
+		_batch[i].clear();
+	for (int i = 0; i < _ready.size(); i++)
+		_ready[i].clear();
+}
+
+void DataLoader::startBatch()
+{
+	int end = qMin(_next + _batchSize, _files.size());
+
+	_batch = _files.mid(_next, end - _next);
+	_next = end;
+	_running.storeRelease(1);
+
+	_future = ThreadPools::map(ThreadPools::Parse, _batch, &File::load);
+	_watcher.setFuture(_future);
+}
+
+void DataLoader::run()
+{
+	if (_next < _files.size())
+		startBatch();
+	else
+		emit ready();
+}
+
+void DataLoader::cancel()
+{
+	_canceled.storeRelease(1);
+	_future.cancel();
+	emit ready();
+}
+
+void DataLoader::batchFinished()
+{
+	_running.storeRelease(0);
+
+	if (_canceled.loadAcquire()) {
+		for (int i = 0; i < _batch.size(); i++)
+			_batch[i].clear();
+	} else {
+		_ready.append(_batch);
+		_done += _batch.size();
+	}
+	_batch.clear();
+
+	if (!_canceled.loadAcquire() && _next < _files.size())
+		startBatch();
+
+	emit progress(_done);
+	emit ready();
+}
+
+/* Returns the next batch of parsed files (in the original order). The caller
+   takes the ownership of the data and must call File::clear() on each of the
+   returned files. Returns false when all the files have been processed or
+   the loading has been canceled. */
+bool DataLoader::next(QList<File> &files)
+{
+	files.clear();
+
+	if (_ready.isEmpty() && _running.loadAcquire()
+	  && !_canceled.loadAcquire()) {
+		QEventLoop loop;
+		connect(this, &DataLoader::ready, &loop, &QEventLoop::quit);
+		loop.exec();
+	}
+
+	if (_canceled.loadAcquire()) {
+		for (int i = 0; i < _ready.size(); i++)
+			_ready[i].clear();
+		_ready.clear();
+		return false;
+	}
+
+	files = _ready;
+	_ready.clear();
+
+	return !files.isEmpty();
+}
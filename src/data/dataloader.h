@@ -0,0 +1,72 @@
+#ifndef DATALOADER_H
+#define DATALOADER_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QList>
+#include <QStringList>
+#include <QFutureWatcher>
+
+class Data;
+
+/* Parses a list of data files on the global thread pool. The files are
+   processed in batches and the parsed data is handed over to the caller
+   (in the original order) using next() that keeps the event loop running
+   while waiting for the next batch. */
+class DataLoader : public QObject
+{
+	Q_OBJECT
+
+public:
+	class File {
+	public:
+		File() : _tryUnknown(true), _data(0) {}
+		File(const QString &fileName, bool tryUnknown)
+		  : _fileName(fileName), _tryUnknown(tryUnknown), _data(0) {}
+
+		const QString &fileName() const {return _fileName;}
+		const Data *data() const {return _data;}
+
+		void load();
+		void clear();
+
+	private:
+		QString _fileName;
+		bool _tryUnknown;
+		Data *_data;
+	};
+
+	DataLoader(const QStringList &files, bool tryUnknown,
+	  QObject *parent = 0);
+	~DataLoader();
+
+	void run();
+	bool next(QList<File> &files);
+
+	int count() const {return _files.size();}
+	int done() const {return _done;}
+	bool isCanceled() const {return _canceled.loadAcquire();}
+
+public slots:
+	void cancel();
+
+signals:
+	void progress(int done);
+	void ready();
+
+private slots:
+	void batchFinished();
+
+private:
+	void startBatch();
+
+	QList<File> _files;
+	QList<File> _batch;
+	QList<File> _ready;
+	QFutureWatcher<void> _watcher;
+	QFuture<void> _future;
+	int _next, _done, _batchSize;
+	QAtomicInt _running, _canceled;
+};
+
+#endif // DATALOADER_H
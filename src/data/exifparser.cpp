@@ -1,11 +1,16 @@
 #include <QDataStream>
 #include <QTimeZone>
+#include <QBuffer>
+#include <QDirIterator>
 #include "common/tifffile.h"
 #include "common/util.h"
+#include "common/threadpools.h"
 #include "exifparser.h"
 
 
 #define SOI_MARKER       0xFFD8
+#define EOI_MARKER       0xFFD9
+#define SOS_MARKER       0xFFDA
 #define APP1_MARKER      0xFFE1
 
 #define GPSIFDTag        34853
@@ -165,9 +170,10 @@ bool EXIFParser::readIFD(TIFFFile &file, quint32 offset,
 	return true;
 }
 
-bool EXIFParser::parseTIFF(QFile *file, QVector<Waypoint> &waypoints)
+bool EXIFParser::parseTIFF(QIODevice *device, const QString &fileName,
+  QVector<Waypoint> &waypoints)
 {
-	TIFFFile tiff(file);
+	TIFFFile tiff(device);
 	if (!tiff.isValid()) {
 		_errorString = "Invalid EXIF data";
 		return false;
@@ -208,8 +214,8 @@ bool EXIFParser::parseTIFF(QFile *file, QVector<Waypoint> &waypoints)
 	}
 
 	Waypoint wp(c);
-	wp.setName(Util::file2name(file->fileName()));
-	wp.addImage(file->fileName());
+	wp.setName(Util::file2name(fileName));
+	wp.addImage(fileName);
 	wp.setElevation(altitude(tiff, GPSIFD.value(GPSAltitude),
 	  GPSIFD.value(GPSAltitudeRef)));
 	wp.setTimestamp(QDateTime(QDate::fromString(text(tiff,
@@ -222,37 +228,104 @@ bool EXIFParser::parseTIFF(QFile *file, QVector<Waypoint> &waypoints)
 	return true;
 }
 
-bool EXIFParser::parse(QFile *file, QList<TrackData> &tracks,
-  QList<RouteData> &routes, QList<Area> &polygons,
-  QVector<Waypoint> &waypoints)
+/* Walks the JPEG segment headers up to the EXIF APP1 segment and reads just
+   that segment (at most 64KB), the image data is never read */
+bool EXIFParser::readAPP1(QIODevice *device, QByteArray &data)
 {
-	Q_UNUSED(tracks);
-	Q_UNUSED(routes);
-	Q_UNUSED(polygons);
-	quint16 marker;
+	quint16 marker, size;
 
-	QDataStream stream(file);
+	QDataStream stream(device);
 	stream.setByteOrder(QDataStream::BigEndian);
 	stream >> marker;
-	if (marker != SOI_MARKER) {
+	if (stream.status() != QDataStream::Ok || marker != SOI_MARKER) {
 		_errorString = "Not a JPEG file";
 		return false;
 	}
 
-	while (!stream.atEnd()) {
-		stream >> marker;
+	while (true) {
+		stream >> marker >> size;
+		if (stream.status() != QDataStream::Ok || (marker & 0xFF00) != 0xFF00
+		  || marker == SOS_MARKER || marker == EOI_MARKER || size < 2)
+			break;
+
 		if (marker == APP1_MARKER) {
-			quint16 size;
-			char magic[6];
-			stream >> size;
-			if (stream.readRawData(magic, sizeof(magic)) == sizeof(magic) &&
-			  !memcmp(magic, "Exif\0\0", sizeof(magic)))
-				return parseTIFF(file, waypoints);
-			else
+			data = device->read(size - 2);
+			if (data.size() < size - 2)
 				break;
-		}
+			if (data.startsWith(QByteArray("Exif\0\0", 6))) {
+				data.remove(0, 6);
+				return true;
+			}
+		} else if (!device->seek(device->pos() + size - 2))
+			break;
 	}
 
 	_errorString = "No EXIF data found";
 	return false;
 }
+
+bool EXIFParser::parse(QIODevice *file, QList<TrackData> &tracks,
+  QList<RouteData> &routes, QList<Area> &polygons,
+  QVector<Waypoint> &waypoints)
+{
+	Q_UNUSED(tracks);
+	Q_UNUSED(routes);
+	Q_UNUSED(polygons);
+	QByteArray data;
+
+	if (!readAPP1(file, data))
+		return false;
+
+	QBuffer buffer(&data);
+	buffer.open(QIODevice::ReadOnly);
+
+	return parseTIFF(&buffer, fileName(file), waypoints);
+}
+
+class Photo
+{
+public:
+	Photo() {}
+	Photo(const QString &path) : _path(path) {}
+
+	const QVector<Waypoint> &waypoints() const {return _waypoints;}
+
+	void load()
+	{
+		QFile file(_path);
+		QList<TrackData> tracks;
+		QList<RouteData> routes;
+		QList<Area> areas;
+
+		if (file.open(QIODevice::ReadOnly))
+			EXIFParser().parse(&file, tracks, routes, areas, _waypoints);
+	}
+
+private:
+	QString _path;
+	QVector<Waypoint> _waypoints;
+};
+
+/* The files are processed in parallel on the global thread pool, so the
+   number of concurrent reads is bounded by the pool size */
+bool EXIFParser::parseDir(const QString &path, QVector<Waypoint> &waypoints)
+{
+	QStringList files;
+	QDirIterator it(path, QStringList() << "*.jpg" << "*.jpeg", QDir::Files,
+	  QDirIterator::Subdirectories);
+	while (it.hasNext())
+		files.append(it.next());
+	files.sort();
+
+	QList<Photo> photos;
+	photos.reserve(files.size());
+	for (int i = 0; i < files.size(); i++)
+		photos.append(Photo(files.at(i)));
+
+	ThreadPools::blockingMap(ThreadPools::Parse, photos, &Photo::load);
+
+	for (int i = 0; i < photos.size(); i++)
+		waypoints += photos.at(i).waypoints();
+
+	return !waypoints.isEmpty();
+}
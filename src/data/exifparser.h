@@ -9,11 +9,16 @@ class TIFFFile;
 class EXIFParser : public Parser
 {
 public:
-	bool parse(QFile *file, QList<TrackData> &tracks, QList<RouteData> &routes,
-	  QList<Area> &polygons, QVector<Waypoint> &waypoints);
+	bool parse(QIODevice *file, QList<TrackData> &tracks,
+	  QList<RouteData> &routes, QList<Area> &polygons,
+	  QVector<Waypoint> &waypoints);
 	QString errorString() const {return _errorString;}
 	int errorLine() const {return 0;}
 
+	/* Imports all the JPEG images in the directory (and its subdirectories)
+	   as one set of waypoints */
+	static bool parseDir(const QString &path, QVector<Waypoint> &waypoints);
+
 private:
 	struct IFDEntry {
 		IFDEntry() : type(0), count(0), offset(0) {}
@@ -23,7 +28,9 @@ private:
 		quint32 offset;
 	};
 
-	bool parseTIFF(QFile *file, QVector<Waypoint> &waypoints);
+	bool readAPP1(QIODevice *device, QByteArray &data);
+	bool parseTIFF(QIODevice *device, const QString &fileName,
+	  QVector<Waypoint> &waypoints);
 	bool readIFD(TIFFFile &file, quint32 offset, const QSet<quint16> &tags,
 	  QMap<quint16, IFDEntry> &entries) const;
 	bool readEntry(TIFFFile &file, const QSet<quint16> &tags,
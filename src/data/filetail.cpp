@@ -0,0 +1,81 @@
+#include <QFileInfo>
+#include "nmeaparser.h"
+#include "csvparser.h"
+#include "data.h"
+#include "filetail.h"
+
+
+static Parser *parser(const QString &fileName)
+{
+	QString suffix(QFileInfo(fileName).suffix().toLower());
+
+	if (suffix == "nmea")
+		return new NMEAParser();
+	else if (suffix == "csv")
+		return new CSVParser();
+	else
+		return 0;
+}
+
+FileTail::FileTail(const QString &fileName)
+  : _file(fileName), _parser(parser(fileName)), _valid(false), _errorLine(0)
+{
+	int from;
+
+	if (!_parser) {
+		_errorString = "Unsupported format";
+		return;
+	}
+	if (!_file.open(QFile::ReadOnly)) {
+		_errorString = _file.errorString();
+		return;
+	}
+
+	_valid = update(from, _waypoints);
+}
+
+bool FileTail::canTail(const QString &fileName)
+{
+	QScopedPointer<Parser> p(parser(fileName));
+	return (p && p->canTail());
+}
+
+Data FileTail::data() const
+{
+	return Data(_tracks, _waypoints);
+}
+
+bool FileTail::update(int &from, QVector<Waypoint> &waypoints)
+{
+	SegmentData segment;
+	int size = waypoints.size();
+
+	from = -1;
+
+	if (isTruncated()) {
+		_errorString = "File truncated";
+		return false;
+	}
+
+	if (!_parser->tail(&_file, segment, waypoints)) {
+		_errorString = _parser->errorString();
+		_errorLine = _parser->errorLine();
+		return false;
+	}
+
+	if (&waypoints != &_waypoints)
+		_waypoints += waypoints.mid(size);
+
+	if (segment.isEmpty())
+		return true;
+
+	if (_tracks.isEmpty()) {
+		TrackData data(segment);
+		data.setFile(_file.fileName());
+		_tracks.append(Track(data));
+		from = 0;
+	} else
+		from = _tracks.last().append(segment);
+
+	return true;
+}
@@ -0,0 +1,47 @@
+#ifndef FILETAIL_H
+#define FILETAIL_H
+
+#include <QFile>
+#include <QScopedPointer>
+#include "parser.h"
+#include "track.h"
+
+class Data;
+
+/* Follows a growing line based data file (a live GPS log). The file is kept
+   open and update() parses only the data appended since the previous call,
+   the new points extend the (single) track of the file. */
+class FileTail
+{
+public:
+	FileTail(const QString &fileName);
+
+	bool isValid() const {return _valid;}
+	const QString &errorString() const {return _errorString;}
+	int errorLine() const {return _errorLine;}
+	/* The file is shorter than the already parsed data */
+	bool isTruncated() const {return _file.size() < _file.pos();}
+
+	/* All the data parsed so far */
+	Data data() const;
+	const QList<Track> &tracks() const {return _tracks;}
+
+	/* Parses the data appended to the file. from is set to the index of the
+	   first new point in the last track segment, -1 when no track points
+	   have been added and 0 when the track has been created. */
+	bool update(int &from, QVector<Waypoint> &waypoints);
+
+	static bool canTail(const QString &fileName);
+
+private:
+	QFile _file;
+	QScopedPointer<Parser> _parser;
+	QList<Track> _tracks;
+	QVector<Waypoint> _waypoints;
+
+	bool _valid;
+	QString _errorString;
+	int _errorLine;
+};
+
+#endif // FILETAIL_H
@@ -1,5 +1,6 @@
 #include <QtEndian>
 #include <QTimeZone>
+#include "common/mappedfile.h"
 #include "GUI/format.h"
 #include "fitparser.h"
 
@@ -90,8 +91,82 @@ static QMap<int, QString> locationPointSymbolsInit()
 static QMap<int, QString> coursePointSymbols = coursePointSymbolsInit();
 static QMap<int, QString> locationPointSymbols = locationPointSymbolsInit();
 
+static int typeSize(quint8 type)
+{
+	switch (type) {
+		case 0: // enum
+		case 1: // sint8
+		case 2: // uint8
+			return 1;
+		case 3:
+		case 0x83: // sint16
+		case 4:
+		case 0x84: // uint16
+			return 2;
+		case 5:
+		case 0x85: // sint32
+		case 6:
+		case 0x86: // uint32
+			return 4;
+		default:
+			return 0;
+	}
+}
+
+static bool isRecordField(quint8 id)
+{
+	switch (id) {
+		case 0:
+		case 1:
+		case 2:
+		case 3:
+		case 4:
+		case 6:
+		case 7:
+		case 13:
+		case 73:
+		case 78:
+		case TIMESTAMP:
+			return true;
+		default:
+			return false;
+	}
+}
+
+template<class T> static inline bool fieldValue(const char *data,
+  quint8 endian, T inval, qint64 &val)
+{
+	T var = endian ? qFromBigEndian<T>(data) : qFromLittleEndian<T>(data);
+	val = var;
+	return (var != inval);
+}
 
-bool FITParser::readData(QFile *file, char *data, size_t size)
+/* Decodes a record field of the given (size checked) type */
+static bool fieldValue(const char *data, quint8 type, quint8 endian,
+  qint64 &val)
+{
+	switch (type) {
+		case 1: // sint8
+			return fieldValue<qint8>(data, endian, 0x7f, val);
+		case 2: // uint8
+		case 0: // enum
+			return fieldValue<quint8>(data, endian, 0xff, val);
+		case 3:
+		case 0x83: // sint16
+			return fieldValue<qint16>(data, endian, 0x7fff, val);
+		case 4:
+		case 0x84: // uint16
+			return fieldValue<quint16>(data, endian, 0xffff, val);
+		case 5:
+		case 0x85: // sint32
+			return fieldValue<qint32>(data, endian, 0x7fffffff, val);
+		default: // uint32
+			return fieldValue<quint32>(data, endian, 0xffffffffU, val);
+	}
+}
+
+
+bool FITParser::readData(MappedFile *file, char *data, size_t size)
 {
 	qint64 n;
 
@@ -109,12 +184,14 @@ bool FITParser::readData(QFile *file, char *data, size_t size)
 
 template<class T> bool FITParser::readValue(CTX &ctx, T &val)
 {
-	if (!readData(ctx.file, (char*)&val, sizeof(T)))
+	const char *data = ctx.file->data(sizeof(T));
+	if (!data) {
+		_errorString = "Premature end of data";
 		return false;
+	}
 
 	ctx.len -= sizeof(T);
-	if (sizeof(T) > 1)
-		val = (ctx.endian) ? qFromBigEndian(val) : qFromLittleEndian(val);
+	val = (ctx.endian) ? qFromBigEndian<T>(data) : qFromLittleEndian<T>(data);
 
 	return true;
 }
@@ -122,7 +199,7 @@ template<class T> bool FITParser::readValue(CTX &ctx, T &val)
 bool FITParser::skipValue(CTX &ctx, quint8 size)
 {
 	ctx.len -= size;
-	return ctx.file->seek(ctx.file->pos() + size);
+	return ctx.file->skip(size);
 }
 
 bool FITParser::parseDefinitionMessage(CTX &ctx, quint8 header)
@@ -132,6 +209,8 @@ bool FITParser::parseDefinitionMessage(CTX &ctx, quint8 header)
 
 	def->fields.clear();
 	def->devFields.clear();
+	def->record.clear();
+	def->size = 0;
 
 	// reserved/unused
 	if (!skipValue(ctx, 1))
@@ -155,11 +234,10 @@ bool FITParser::parseDefinitionMessage(CTX &ctx, quint8 header)
 		return false;
 
 	def->fields.resize(numFields);
-	for (int i = 0; i < def->fields.size(); i++) {
-		if (!readData(ctx.file, (char*)&(def->fields[i]), sizeof(Field)))
-			return false;
-		ctx.len -= sizeof(Field);
-	}
+	if (!readData(ctx.file, (char*)def->fields.data(),
+	  numFields * sizeof(Field)))
+		return false;
+	ctx.len -= numFields * sizeof(Field);
 
 	// developer definition records
 	if (header & 0x20) {
@@ -167,16 +245,38 @@ bool FITParser::parseDefinitionMessage(CTX &ctx, quint8 header)
 			return false;
 
 		def->devFields.resize(numFields);
-		for (int i = 0; i < def->devFields.size(); i++) {
-			if (!readData(ctx.file, (char*)&(def->devFields[i]), sizeof(Field)))
-				return false;
-			ctx.len -= sizeof(Field);
-		}
+		if (!readData(ctx.file, (char*)def->devFields.data(),
+		  numFields * sizeof(Field)))
+			return false;
+		ctx.len -= numFields * sizeof(Field);
 	}
 
+	if (def->globalId == RECORD)
+		compileRecord(def);
+
 	return true;
 }
 
+/* The record messages make the bulk of the data, so their definitions are
+   compiled into a decoding plan. The whole message is then read at once and
+   only the plan fields are decoded, without any per field I/O and QVariant
+   boxing. */
+void FITParser::compileRecord(MessageDefinition *def)
+{
+	quint32 offset = 0;
+
+	for (int i = 0; i < def->fields.size(); i++) {
+		const Field &field = def->fields.at(i);
+		if (isRecordField(field.id) && field.size == typeSize(field.type))
+			def->record.append(RecordField(offset, field.type, field.id));
+		offset += field.size;
+	}
+	for (int i = 0; i < def->devFields.size(); i++)
+		offset += def->devFields.at(i).size;
+
+	def->size = offset;
+}
+
 bool FITParser::readField(CTX &ctx, const Field *field, QVariant &val,
   bool &valid)
 {
@@ -246,6 +346,9 @@ bool FITParser::parseData(CTX &ctx, const MessageDefinition *def)
 		return false;
 	}
 
+	if (def->globalId == RECORD)
+		return parseRecordMessage(ctx, def);
+
 	ctx.endian = def->endian;
 
 	for (int i = 0; i < def->fields.size(); i++) {
@@ -257,42 +360,7 @@ bool FITParser::parseData(CTX &ctx, const MessageDefinition *def)
 
 		if (field->id == TIMESTAMP)
 			ctx.timestamp = val.toUInt();
-		else if (def->globalId == RECORD) {
-			switch (field->id) {
-				case 0:
-					ctx.trackpoint.rcoordinates().setLat(
-					  (val.toInt() / (double)0x7fffffff) * 180);
-					break;
-				case 1:
-					ctx.trackpoint.rcoordinates().setLon(
-					  (val.toInt() / (double)0x7fffffff) * 180);
-					break;
-				case 2:
-					ctx.trackpoint.setElevation((val.toUInt() / 5.0) - 500);
-					break;
-				case 3:
-					ctx.trackpoint.setHeartRate(val.toUInt());
-					break;
-				case 4:
-					ctx.trackpoint.setCadence(val.toUInt());
-					break;
-				case 6:
-					ctx.trackpoint.setSpeed(val.toUInt() / 1000.0f);
-					break;
-				case 7:
-					ctx.trackpoint.setPower(val.toUInt());
-					break;
-				case 13:
-					ctx.trackpoint.setTemperature(val.toInt());
-					break;
-				case 73:
-					ctx.trackpoint.setSpeed(val.toUInt() / 1000.0f);
-					break;
-				case 78:
-					ctx.trackpoint.setElevation((val.toUInt() / 5.0) - 500);
-					break;
-			}
-		} else if (def->globalId == EVENT) {
+		else if (def->globalId == EVENT) {
 			switch (field->id) {
 				case 0:
 					event.id = val.toUInt();
@@ -384,18 +452,6 @@ bool FITParser::parseData(CTX &ctx, const MessageDefinition *def)
 			quint32 rear = ((event.data & 0x0000FF00) >> 8);
 			ctx.ratio = ((qreal)front / (qreal)rear);
 		}
-	} else if (def->globalId == RECORD) {
-		if (ctx.trackpoint.coordinates().isValid()) {
-			ctx.trackpoint.setTimestamp(QDateTime::fromSecsSinceEpoch(
-			  ctx.timestamp + 631065600, QTimeZone::utc()));
-			ctx.trackpoint.setRatio(ctx.ratio);
-			if (!ctx.segment) {
-				ctx.track.append(SegmentData());
-				ctx.segment = true;
-			}
-			ctx.track.last().append(ctx.trackpoint);
-			ctx.trackpoint = Trackpoint();
-		}
 	} else if (def->globalId == COURSEPOINT) {
 		if (waypoint.coordinates().isValid())
 			ctx.waypoints.append(waypoint);
@@ -423,6 +479,73 @@ bool FITParser::parseData(CTX &ctx, const MessageDefinition *def)
 	return true;
 }
 
+bool FITParser::parseRecordMessage(CTX &ctx, const MessageDefinition *def)
+{
+	const char *data = ctx.file->data(def->size);
+	if (!data) {
+		_errorString = "Premature end of data";
+		return false;
+	}
+	ctx.len -= def->size;
+	ctx.endian = def->endian;
+
+	for (int i = 0; i < def->record.size(); i++) {
+		const RecordField &field = def->record.at(i);
+		qint64 val;
+
+		if (!fieldValue(data + field.offset, field.type, def->endian, val))
+			continue;
+
+		switch (field.id) {
+			case TIMESTAMP:
+				ctx.timestamp = (quint32)val;
+				break;
+			case 0:
+				ctx.trackpoint.rcoordinates().setLat(
+				  ((qint32)val / (double)0x7fffffff) * 180);
+				break;
+			case 1:
+				ctx.trackpoint.rcoordinates().setLon(
+				  ((qint32)val / (double)0x7fffffff) * 180);
+				break;
+			case 2:
+			case 78:
+				ctx.trackpoint.setElevation(((quint32)val / 5.0) - 500);
+				break;
+			case 3:
+				ctx.trackpoint.setHeartRate((quint32)val);
+				break;
+			case 4:
+				ctx.trackpoint.setCadence((quint32)val);
+				break;
+			case 6:
+			case 73:
+				ctx.trackpoint.setSpeed((quint32)val / 1000.0f);
+				break;
+			case 7:
+				ctx.trackpoint.setPower((quint32)val);
+				break;
+			case 13:
+				ctx.trackpoint.setTemperature((qint32)val);
+				break;
+		}
+	}
+
+	if (ctx.trackpoint.coordinates().isValid()) {
+		ctx.trackpoint.setTimestamp(QDateTime::fromSecsSinceEpoch(
+		  ctx.timestamp + 631065600, QTimeZone::utc()));
+		ctx.trackpoint.setRatio(ctx.ratio);
+		if (!ctx.segment) {
+			ctx.track.append(SegmentData());
+			ctx.segment = true;
+		}
+		ctx.track.last().append(ctx.trackpoint);
+		ctx.trackpoint = Trackpoint();
+	}
+
+	return true;
+}
+
 bool FITParser::parseDataMessage(CTX &ctx, quint8 header)
 {
 	int localId = header & 0xf;
@@ -478,12 +601,13 @@ bool FITParser::parseHeader(CTX &ctx)
 	return true;
 }
 
-bool FITParser::parse(QFile *file, QList<TrackData> &tracks,
+bool FITParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons, QVector<Waypoint> &waypoints)
 {
 	Q_UNUSED(routes);
 	Q_UNUSED(polygons);
-	CTX ctx(file, waypoints);
+	MappedFile mf(file);
+	CTX ctx(&mf, waypoints);
 
 	if (!parseHeader(ctx))
 		return false;
@@ -493,7 +617,7 @@ bool FITParser::parse(QFile *file, QList<TrackData> &tracks,
 			return false;
 
 	tracks.append(ctx.track);
-	tracks.last().setFile(file->fileName());
+	tracks.last().setFile(fileName(file));
 
 	return true;
 }
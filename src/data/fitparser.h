@@ -3,6 +3,8 @@
 
 #include "parser.h"
 
+class MappedFile;
+
 class FITParser : public Parser
 {
 public:
@@ -12,8 +14,9 @@ public:
 		static_assert(sizeof(FileHeader) == 12, "Invalid FileHeader alignment");
 	}
 
-	bool parse(QFile *file, QList<TrackData> &tracks, QList<RouteData> &routes,
-	  QList<Area> &polygons, QVector<Waypoint> &waypoints);
+	bool parse(QIODevice *file, QList<TrackData> &tracks,
+	  QList<RouteData> &routes, QList<Area> &polygons,
+	  QVector<Waypoint> &waypoints);
 	QString errorString() const {return _errorString;}
 	int errorLine() const {return 0;}
 
@@ -48,21 +51,35 @@ private:
 		quint8 size;
 		quint8 type;
 	};
+	/* Decoding plan entry of a record message field (only the fields used
+	   by the track points are in the plan) */
+	struct RecordField
+	{
+		RecordField() {}
+		RecordField(quint16 offset, quint8 type, quint8 id)
+		  : offset(offset), type(type), id(id) {}
+
+		quint16 offset;
+		quint8 type;
+		quint8 id;
+	};
 	struct MessageDefinition
 	{
-		MessageDefinition() : globalId(0), endian(0) {}
+		MessageDefinition() : size(0), globalId(0), endian(0) {}
 
 		QVector<Field> fields;
 		QVector<Field> devFields;
+		QVector<RecordField> record;
+		quint32 size;
 		quint16 globalId;
 		quint8 endian;
 	};
 	struct CTX {
-		CTX(QFile *file, QVector<Waypoint> &waypoints)
+		CTX(MappedFile *file, QVector<Waypoint> &waypoints)
 		  : file(file), waypoints(waypoints), len(0), endian(0), timestamp(0),
 		  ratio(NAN), laps(0), segment(false) {}
 
-		QFile *file;
+		MappedFile *file;
 		QVector<Waypoint> &waypoints;
 		TrackData track;
 		quint32 len;
@@ -75,7 +92,7 @@ private:
 		bool segment;
 	};
 
-	bool readData(QFile *file, char *data, size_t size);
+	bool readData(MappedFile *file, char *data, size_t size);
 	template<class T> bool readValue(CTX &ctx, T &val);
 	bool skipValue(CTX &ctx, quint8 size);
 	bool readField(CTX &ctx, const Field *field, QVariant &val, bool &valid);
@@ -86,6 +103,9 @@ private:
 	bool parseCompressedMessage(CTX &ctx, quint8 header);
 	bool parseDataMessage(CTX &ctx, quint8 header);
 	bool parseData(CTX &ctx, const MessageDefinition *def);
+	bool parseRecordMessage(CTX &ctx, const MessageDefinition *def);
+
+	static void compileRecord(MessageDefinition *def);
 
 	QString _errorString;
 };
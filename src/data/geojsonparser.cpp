@@ -1,5 +1,8 @@
 #include <QJsonDocument>
 #include <QJsonArray>
+#include <QJsonObject>
+#include "common/mappedfile.h"
+#include "common/parse.h"
 #include "map/crs.h"
 #include "geojsonparser.h"
 
@@ -7,6 +10,8 @@
 #define MARKER_SIZE_SMALL  8
 #define MARKER_SIZE_LARGE  16
 
+#define MAX_NUMBER_LENGTH  128
+
 #define PROJ(object, parent) \
 	((object).isNull() ? (parent) : (object))
 
@@ -185,7 +190,7 @@ static bool isWS(char c)
 	return (c == 0x20 || c == 0x09 || c == 0x0A || c == 0x0D) ? true : false;
 }
 
-static bool possiblyJSONObject(QFile *file)
+static bool possiblyJSONObject(QIODevice *file)
 {
 	char c;
 
@@ -201,29 +206,219 @@ static bool possiblyJSONObject(QFile *file)
 	return false;
 }
 
-bool GeoJSONParser::a2c(const QJsonArray &data, const Projection &proj,
-  Coordinates &c)
+static const char *skipWS(const char *p, const char *end)
+{
+	while (p < end && isWS(*p))
+		p++;
+	return p;
+}
+
+static bool skipString(const char *&p, const char *end)
+{
+	for (p++; p < end; p++) {
+		if (*p == '\\')
+			p++;
+		else if (*p == '"') {
+			p++;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Skips a JSON value (p must point to its first character). The value is
+   only checked for a valid structure, the content is checked on parsing. */
+static bool skipValue(const char *&p, const char *end)
+{
+	if (p >= end)
+		return false;
+
+	if (*p == '"')
+		return skipString(p, end);
+	else if (*p == '{' || *p == '[') {
+		int depth = 0;
+
+		while (p < end) {
+			if (*p == '"') {
+				if (!skipString(p, end))
+					return false;
+				continue;
+			} else if (*p == '{' || *p == '[')
+				depth++;
+			else if (*p == '}' || *p == ']') {
+				if (--depth == 0) {
+					p++;
+					return true;
+				}
+			}
+			p++;
+		}
+
+		return false;
+	} else {
+		const char *start = p;
+		while (p < end && !isWS(*p) && *p != ',' && *p != '}' && *p != ']')
+			p++;
+		return (p > start);
+	}
+}
+
+GeoJSONParser::ArrayReader::ArrayReader(const Value &array)
+  : _p(array.begin), _end(array.end), _first(true), _error(false)
+{
+	if (array.isArray())
+		_p++;
+	else
+		_p = _end;
+}
+
+bool GeoJSONParser::ArrayReader::next(Value &item)
+{
+	_p = skipWS(_p, _end);
+	if (_p >= _end || *_p == ']')
+		return false;
+
+	if (!_first) {
+		if (*_p != ',') {
+			_error = true;
+			return false;
+		}
+		_p = skipWS(_p + 1, _end);
+	}
+	_first = false;
+
+	const char *begin = _p;
+	if (!skipValue(_p, _end)) {
+		_error = true;
+		return false;
+	}
+	item = Value(begin, _p);
+
+	return true;
+}
+
+bool GeoJSONParser::syntaxError(const char *pos)
+{
+	_errorString = QString("JSON parse error on offset %1")
+	  .arg(QString::number(pos - _data));
+	return false;
+}
+
+bool GeoJSONParser::object(const char *&p, const char *end, Object &object)
+{
+	p = skipWS(p + 1, end);
+	if (p < end && *p == '}') {
+		p++;
+		return true;
+	}
+
+	while (true) {
+		if (p >= end || *p != '"')
+			return syntaxError(p);
+		const char *key = p + 1;
+		if (!skipString(p, end))
+			return syntaxError(p);
+		QByteArray name(key, p - key - 1);
+
+		p = skipWS(p, end);
+		if (p >= end || *p != ':')
+			return syntaxError(p);
+		p = skipWS(p + 1, end);
+
+		const char *begin = p;
+		if (!skipValue(p, end))
+			return syntaxError(p);
+		object.insert(name, Value(begin, p));
+
+		p = skipWS(p, end);
+		if (p < end && *p == ',')
+			p = skipWS(p + 1, end);
+		else if (p < end && *p == '}') {
+			p++;
+			return true;
+		} else
+			return syntaxError(p);
+	}
+}
+
+bool GeoJSONParser::object(const Value &value, Object &object)
+{
+	if (!value.isObject())
+		return true;
+
+	const char *p = value.begin;
+	return this->object(p, value.end, object);
+}
+
+QString GeoJSONParser::string(const Value &value)
 {
-	c = (data.count() >= 2 && data.at(0).isDouble() && data.at(1).isDouble())
-	  ? proj.xy2ll(PointD(data.at(0).toDouble(), data.at(1).toDouble()))
-	  : Coordinates();
+	if (value.first() != '"')
+		return QString();
+
+	const char *begin = value.begin + 1;
+	const char *end = value.end - 1;
+	for (const char *p = begin; p < end; p++)
+		if (*p == '\\')
+			return json(value).toString();
+
+	return QString::fromUtf8(begin, end - begin);
+}
+
+/* The value is wrapped into an array as Qt5 only parses arrays and objects
+   on the top level. */
+QJsonValue GeoJSONParser::json(const Value &value)
+{
+	if (!value.exists())
+		return QJsonValue(QJsonValue::Undefined);
+
+	QByteArray ba;
+	ba.reserve(value.end - value.begin + 2);
+	ba.append('[');
+	ba.append(value.begin, value.end - value.begin);
+	ba.append(']');
+
+	return QJsonDocument::fromJson(ba).array().at(0);
+}
+
+bool GeoJSONParser::a2c(const Value &data, const Projection &proj,
+  Coordinates &c, double &elevation)
+{
+	ArrayReader array(data);
+	Value item;
+	double val[3];
+	bool ok[3] = {false, false, false};
+	int count = 0;
+
+	while (array.next(item)) {
+		if (count < 3 && item.end - item.begin <= MAX_NUMBER_LENGTH)
+			ok[count] = Parse::toDouble(item.begin, item.end - item.begin,
+			  val[count]);
+		count++;
+	}
+	if (array.error())
+		return syntaxError(array.pos());
+
+	c = (count >= 2 && ok[0] && ok[1])
+	  ? proj.xy2ll(PointD(val[0], val[1])) : Coordinates();
+	elevation = (count == 3 && ok[2]) ? val[2] : NAN;
 
 	if (c.isValid())
 		return true;
 	else {
-		QJsonDocument doc(QJsonDocument::fromVariant(data.toVariantList()));
+		QByteArray ba(data.begin, qMin<qint64>(data.end - data.begin, 64));
 		_errorString = QString("%1: invalid coordinates")
-		  .arg(QString::fromUtf8(doc.toJson(QJsonDocument::Compact)));
+		  .arg(QString::fromUtf8(ba).simplified());
 		return false;
 	}
 }
 
-bool GeoJSONParser::crs(const QJsonObject &object, Projection &proj)
+bool GeoJSONParser::crs(const Object &object, Projection &proj)
 {
 	if (!object.contains("crs"))
 		return true;
 
-	QJsonObject crsObj(object["crs"].toObject());
+	QJsonObject crsObj(json(object.value("crs")).toObject());
 	if (crsObj["type"].toString() != "name" || !crsObj.contains("properties")) {
 		_errorString = "Invalid crs object";
 		return false;
@@ -239,9 +434,9 @@ bool GeoJSONParser::crs(const QJsonObject &object, Projection &proj)
 	}
 }
 
-GeoJSONParser::Type GeoJSONParser::type(const QJsonObject &json)
+GeoJSONParser::Type GeoJSONParser::type(const Object &object)
 {
-	QString str(json["type"].toString());
+	QString str(string(object.value("type")));
 
 	if (str == "Point")
 		return Point;
@@ -265,36 +460,39 @@ GeoJSONParser::Type GeoJSONParser::type(const QJsonObject &json)
 		return Unknown;
 }
 
-bool GeoJSONParser::point(const QJsonObject &object, const Projection &parent,
+bool GeoJSONParser::point(const Object &object, const Projection &parent,
   const QJsonValue &properties, QVector<Waypoint> &waypoints)
 {
 	if (!object.contains("coordinates")) {
 		_errorString = "Missing Point coordinates array";
 		return false;
 	}
-	if (object["coordinates"].isNull())
-		return true;
-	QJsonArray coordinates(object["coordinates"].toArray());
-	if (coordinates.isEmpty())
+	Value coordinates(object.value("coordinates"));
+	if (coordinates.isNull())
 		return true;
+	ArrayReader array(coordinates);
+	Value item;
+	if (!array.next(item))
+		return array.error() ? syntaxError(array.pos()) : true;
 	Projection proj;
 	if (!crs(object, proj))
 		return false;
 
 	Coordinates c;
-	if (!a2c(coordinates, PROJ(proj, parent), c))
+	double ele;
+	if (!a2c(coordinates, PROJ(proj, parent), c, ele))
 		return false;
 
 	Waypoint waypoint(c);
-	if (coordinates.count() == 3 && coordinates.at(2).isDouble())
-		waypoint.setElevation(coordinates.at(2).toDouble());
+	if (!std::isnan(ele))
+		waypoint.setElevation(ele);
 	setWaypointProperties(waypoint, properties);
 	waypoints.append(waypoint);
 
 	return true;
 }
 
-bool GeoJSONParser::multiPoint(const QJsonObject &object,
+bool GeoJSONParser::multiPoint(const Object &object,
   const Projection &parent, const QJsonValue &properties,
   QVector<Waypoint> &waypoints)
 {
@@ -302,35 +500,37 @@ bool GeoJSONParser::multiPoint(const QJsonObject &object,
 		_errorString = "Missing MultiPoint coordinates array";
 		return false;
 	}
-	if (object["coordinates"].isNull())
+	Value coordinates(object.value("coordinates"));
+	if (coordinates.isNull())
 		return true;
-	QJsonArray coordinates(object["coordinates"].toArray());
 	Projection proj;
 	if (!crs(object, proj))
 		return false;
+	ArrayReader array(coordinates);
+	Value data;
 	Coordinates c;
+	double ele;
 
-	for (int i = 0; i < coordinates.size(); i++) {
-		if (!coordinates.at(i).isArray()) {
+	while (array.next(data)) {
+		if (!data.isArray()) {
 			_errorString = "Invalid MultiPoint data";
 			return false;
 		} else {
-			QJsonArray data(coordinates.at(i).toArray());
-			if (!a2c(data, PROJ(proj, parent), c))
+			if (!a2c(data, PROJ(proj, parent), c, ele))
 				return false;
 
 			Waypoint waypoint(c);
-			if (data.count() == 3 && data.at(2).isDouble())
-				waypoint.setElevation(data.at(2).toDouble());
+			if (!std::isnan(ele))
+				waypoint.setElevation(ele);
 			setWaypointProperties(waypoint, properties);
 			waypoints.append(waypoint);
 		}
 	}
 
-	return true;
+	return array.error() ? syntaxError(array.pos()) : true;
 }
 
-bool GeoJSONParser::lineString(const QJsonObject &object, const QString &file,
+bool GeoJSONParser::lineString(const Object &object, const QString &file,
   const Projection &parent, const QJsonValue &properties,
   QList<TrackData> &tracks)
 {
@@ -338,32 +538,36 @@ bool GeoJSONParser::lineString(const QJsonObject &object, const QString &file,
 		_errorString = "Missing LineString coordinates array";
 		return false;
 	}
-	if (object["coordinates"].isNull())
-		return true;
-	QJsonArray coordinates(object["coordinates"].toArray());
-	if (coordinates.isEmpty())
+	Value coordinates(object.value("coordinates"));
+	if (coordinates.isNull())
 		return true;
 	Projection proj;
 	if (!crs(object, proj))
 		return false;
+	ArrayReader array(coordinates);
 	SegmentData segment;
+	Value data;
 	Coordinates c;
+	double ele;
 
-	for (int i = 0; i < coordinates.size(); i++) {
-		if (!coordinates.at(i).isArray()) {
+	while (array.next(data)) {
+		if (!data.isArray()) {
 			_errorString = "Invalid LineString data";
 			return false;
 		}
 
-		QJsonArray data(coordinates.at(i).toArray());
-		if (!a2c(data, PROJ(proj, parent), c))
+		if (!a2c(data, PROJ(proj, parent), c, ele))
 			return false;
 
 		Trackpoint t(c);
-		if (data.count() == 3 && data.at(2).isDouble())
-			t.setElevation(data.at(2).toDouble());
+		if (!std::isnan(ele))
+			t.setElevation(ele);
 		segment.append(t);
 	}
+	if (array.error())
+		return syntaxError(array.pos());
+	if (segment.isEmpty())
+		return true;
 
 	setSegmentProperties(segment, -1, properties);
 	TrackData track(segment);
@@ -374,7 +578,7 @@ bool GeoJSONParser::lineString(const QJsonObject &object, const QString &file,
 	return true;
 }
 
-bool GeoJSONParser::multiLineString(const QJsonObject &object,
+bool GeoJSONParser::multiLineString(const Object &object,
   const QString &file, const Projection &parent, const QJsonValue &properties,
   QList<TrackData> &tracks)
 {
@@ -382,45 +586,52 @@ bool GeoJSONParser::multiLineString(const QJsonObject &object,
 		_errorString = "Missing MultiLineString coordinates array";
 		return false;
 	}
-	if (object["coordinates"].isNull())
-		return true;
-	QJsonArray coordinates(object["coordinates"].toArray());
-	if (coordinates.isEmpty())
+	Value coordinates(object.value("coordinates"));
+	if (coordinates.isNull())
 		return true;
 	Projection proj;
 	if (!crs(object, proj))
 		return false;
+	ArrayReader array(coordinates);
 	TrackData track;
+	Value ls;
 	Coordinates c;
+	double ele;
 
-	for (int i = 0; i < coordinates.size(); i++) {
-		if (!coordinates.at(i).isArray()) {
+	while (array.next(ls)) {
+		if (!ls.isArray()) {
 			_errorString = "Invalid MultiLineString data";
 			return false;
 		} else {
+			ArrayReader lsArray(ls);
 			SegmentData segment;
+			Value data;
 
-			QJsonArray ls(coordinates.at(i).toArray());
-			for (int j = 0; j < ls.size(); j++) {
-				if (!ls.at(j).isArray()) {
+			while (lsArray.next(data)) {
+				if (!data.isArray()) {
 					_errorString = "Invalid MultiLineString LineString data";
 					return false;
 				}
 
-				QJsonArray data(ls.at(j).toArray());
-				if (!a2c(data, PROJ(proj, parent), c))
+				if (!a2c(data, PROJ(proj, parent), c, ele))
 					return false;
 
 				Trackpoint t(c);
-				if (data.count() == 3 && data.at(2).isDouble())
-					t.setElevation(data.at(2).toDouble());
+				if (!std::isnan(ele))
+					t.setElevation(ele);
 				segment.append(t);
 			}
+			if (lsArray.error())
+				return syntaxError(lsArray.pos());
 
 			setSegmentProperties(segment, track.size(), properties);
 			track.append(segment);
 		}
 	}
+	if (array.error())
+		return syntaxError(array.pos());
+	if (track.isEmpty())
+		return true;
 
 	track.setFile(file);
 	setTrackProperties(track, properties);
@@ -429,48 +640,63 @@ bool GeoJSONParser::multiLineString(const QJsonObject &object,
 	return true;
 }
 
-bool GeoJSONParser::polygon(const QJsonObject &object, const Projection &parent,
+bool GeoJSONParser::linearRing(const Value &value, const Projection &proj,
+  QVector<Coordinates> &ring, const char *error)
+{
+	ArrayReader array(value);
+	Value point;
+	Coordinates c;
+	double ele;
+
+	while (array.next(point)) {
+		if (!point.isArray()) {
+			_errorString = error;
+			return false;
+		}
+
+		if (!a2c(point, proj, c, ele))
+			return false;
+
+		ring.append(c);
+	}
+
+	return array.error() ? syntaxError(array.pos()) : true;
+}
+
+bool GeoJSONParser::polygon(const Object &object, const Projection &parent,
   const QJsonValue &properties, QList<Area> &areas)
 {
 	if (!object.contains("coordinates")) {
 		_errorString = "Missing Polygon coordinates array";
 		return false;
 	}
-	if (object["coordinates"].isNull())
-		return true;
-	QJsonArray coordinates(object["coordinates"].toArray());
-	if (coordinates.isEmpty())
+	Value coordinates(object.value("coordinates"));
+	if (coordinates.isNull())
 		return true;
 	Projection proj;
 	if (!crs(object, proj))
 		return false;
+	ArrayReader array(coordinates);
 	::Polygon poly;
-	Coordinates c;
+	Value lr;
 
-	for (int i = 0; i < coordinates.size(); i++) {
-		if (!coordinates.at(i).isArray()) {
+	while (array.next(lr)) {
+		if (!lr.isArray()) {
 			_errorString = "Invalid Polygon linear ring";
 			return false;
 		}
 
-		QJsonArray lr(coordinates.at(i).toArray());
 		QVector<Coordinates> data;
-
-		for (int j = 0; j < lr.size(); j++) {
-			if (!lr.at(j).isArray()) {
-				_errorString = "Invalid Polygon linear ring data";
-				return false;
-			}
-
-			QJsonArray point(lr.at(j).toArray());
-			if (!a2c(point, PROJ(proj, parent), c))
-				return false;
-
-			data.append(c);
-		}
+		if (!linearRing(lr, PROJ(proj, parent), data,
+		  "Invalid Polygon linear ring data"))
+			return false;
 
 		poly.append(data);
 	}
+	if (array.error())
+		return syntaxError(array.pos());
+	if (poly.isEmpty())
+		return true;
 
 	Area area(poly);
 	setAreaProperties(area, properties);
@@ -479,60 +705,55 @@ bool GeoJSONParser::polygon(const QJsonObject &object, const Projection &parent,
 	return true;
 }
 
-bool GeoJSONParser::multiPolygon(const QJsonObject &object,
+bool GeoJSONParser::multiPolygon(const Object &object,
   const Projection &parent, const QJsonValue &properties, QList<Area> &areas)
 {
 	if (!object.contains("coordinates")) {
 		_errorString = "Missing MultiPolygon coordinates array";
 		return false;
 	}
-	if (object["coordinates"].isNull())
-		return true;
-	QJsonArray coordinates(object["coordinates"].toArray());
-	if (coordinates.isEmpty())
+	Value coordinates(object.value("coordinates"));
+	if (coordinates.isNull())
 		return true;
 	Projection proj;
 	if (!crs(object, proj))
 		return false;
+	ArrayReader array(coordinates);
 	Area area;
-	Coordinates c;
+	Value polygon;
 
-	for (int i = 0; i < coordinates.size(); i++) {
-		if (!coordinates.at(i).isArray()) {
+	while (array.next(polygon)) {
+		if (!polygon.isArray()) {
 			_errorString = "Invalid MultiPolygon data";
 			return false;
 		} else {
+			ArrayReader polygonArray(polygon);
 			::Polygon poly;
+			Value lr;
 
-			QJsonArray polygon(coordinates.at(i).toArray());
-			for (int j = 0; j < polygon.size(); j++) {
-				if (!polygon.at(j).isArray()) {
+			while (polygonArray.next(lr)) {
+				if (!lr.isArray()) {
 					_errorString = "Invalid MultiPolygon linear ring";
 					return false;
 				}
 
-				QJsonArray lr(polygon.at(j).toArray());
 				QVector<Coordinates> data;
-
-				for (int k = 0; k < lr.size(); k++) {
-					if (!lr.at(k).isArray()) {
-						_errorString = "Invalid MultiPolygon linear ring data";
-						return false;
-					}
-
-					QJsonArray point(lr.at(k).toArray());
-					if (!a2c(point, PROJ(proj, parent), c))
-						return false;
-
-					data.append(c);
-				}
+				if (!linearRing(lr, PROJ(proj, parent), data,
+				  "Invalid MultiPolygon linear ring data"))
+					return false;
 
 				poly.append(data);
 			}
+			if (polygonArray.error())
+				return syntaxError(polygonArray.pos());
 
 			area.append(poly);
 		}
 	}
+	if (array.error())
+		return syntaxError(array.pos());
+	if (area.isEmpty())
+		return true;
 
 	setAreaProperties(area, properties);
 	areas.append(area);
@@ -540,22 +761,25 @@ bool GeoJSONParser::multiPolygon(const QJsonObject &object,
 	return true;
 }
 
-bool GeoJSONParser::geometryCollection(const QJsonObject &object,
+bool GeoJSONParser::geometryCollection(const Object &object,
   const QString &file, const Projection &parent, const QJsonValue &properties,
   QList<TrackData> &tracks, QList<Area> &areas, QVector<Waypoint> &waypoints)
 {
-	if (!object["geometries"].isArray()) {
+	if (!object.value("geometries").isArray()) {
 		_errorString = "Invalid/missing GeometryCollection geometries array";
 		return false;
 	}
 
-	QJsonArray geometries(object["geometries"].toArray());
 	Projection proj;
 	if (!crs(object, proj))
 		return false;
+	ArrayReader array(object.value("geometries"));
+	Value item;
 
-	for (int i = 0; i < geometries.size(); i++) {
-		QJsonObject geometry(geometries.at(i).toObject());
+	while (array.next(item)) {
+		Object geometry;
+		if (!this->object(item, geometry))
+			return false;
 
 		switch (type(geometry)) {
 			case Point:
@@ -593,28 +817,30 @@ bool GeoJSONParser::geometryCollection(const QJsonObject &object,
 					return false;
 				break;
 			default:
-				_errorString = geometry["type"].toString()
+				_errorString = string(geometry.value("type"))
 				  + ": invalid/missing geometry type";
 				return false;
 		}
 	}
 
-	return true;
+	return array.error() ? syntaxError(array.pos()) : true;
 }
 
-bool GeoJSONParser::feature(const QJsonObject &object, const QString &file,
+bool GeoJSONParser::feature(const Object &object, const QString &file,
   const Projection &parent, QList<TrackData> &tracks, QList<Area> &areas,
   QVector<Waypoint> &waypoints)
 {
-	if (object["geometry"].isNull())
+	if (object.value("geometry").isNull())
 		return true;
-	if (!object["geometry"].isObject()) {
+	if (!object.value("geometry").isObject()) {
 		_errorString = "Invalid/missing Feature geometry object";
 		return false;
 	}
 
-	QJsonValue properties(object["properties"]);
-	QJsonObject geometry(object["geometry"].toObject());
+	QJsonValue properties(json(object.value("properties")));
+	Object geometry;
+	if (!this->object(object.value("geometry"), geometry))
+		return false;
 	Projection proj;
 	if (!crs(object, proj))
 		return false;
@@ -639,36 +865,42 @@ bool GeoJSONParser::feature(const QJsonObject &object, const QString &file,
 		case MultiPolygon:
 			return multiPolygon(geometry, PROJ(proj, parent), properties, areas);
 		default:
-			_errorString = geometry["type"].toString()
+			_errorString = string(geometry.value("type"))
 			  + ": invalid/missing Feature geometry";
 			return false;
 	}
 }
 
-bool GeoJSONParser::featureCollection(const QJsonObject &object,
+/* The features are parsed one by one, so only a single feature's properties
+   are held as a JSON DOM at a time. */
+bool GeoJSONParser::featureCollection(const Object &object,
   const QString &file, const Projection &parent, QList<TrackData> &tracks,
   QList<Area> &areas, QVector<Waypoint> &waypoints)
 {
-	if (!object["features"].isArray()) {
+	if (!object.value("features").isArray()) {
 		_errorString = "Invalid/missing FeatureCollection features array";
 		return false;
 	}
 
-	QJsonArray features(object["features"].toArray());
 	Projection proj;
 	if (!crs(object, proj))
 		return false;
+	ArrayReader array(object.value("features"));
+	Value item;
 
-	for (int i = 0; i < features.size(); i++)
-		if (!feature(features.at(i).toObject(), file, PROJ(proj, parent),
-		  tracks, areas, waypoints))
+	while (array.next(item)) {
+		Object f;
+		if (!this->object(item, f))
+			return false;
+		if (!feature(f, file, PROJ(proj, parent), tracks, areas, waypoints))
 			return false;
+	}
 
-	return true;
+	return array.error() ? syntaxError(array.pos()) : true;
 }
 
 
-bool GeoJSONParser::parse(QFile *file, QList<TrackData> &tracks,
+bool GeoJSONParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &areas, QVector<Waypoint> &waypoints)
 {
 	Q_UNUSED(routes);
@@ -679,18 +911,23 @@ bool GeoJSONParser::parse(QFile *file, QList<TrackData> &tracks,
 	} else
 		file->reset();
 
-	QJsonParseError error;
-	QJsonDocument doc(QJsonDocument::fromJson(file->readAll(), &error));
-
-	if (doc.isNull()) {
-		_errorString = QString("JSON parse error on offset %1: %2")
-		  .arg(QString::number(error.offset), error.errorString());
+	MappedFile mf(file);
+	_data = mf.data(mf.size());
+	if (!_data) {
+		_errorString = "I/O error";
 		return false;
 	}
 
-	QJsonObject object(doc.object());
+	const char *end = _data + mf.size();
+	const char *p = skipWS(_data, end);
+	Object object;
+	if (!this->object(p, end, object))
+		return false;
+	if (skipWS(p, end) != end)
+		return syntaxError(p);
+
 	Projection proj(GCS::WGS84());
-	QString fileName(file->fileName());
+	QString fileName(Parser::fileName(file));
 
 	switch (type(object)) {
 		case Point:
@@ -714,10 +951,10 @@ bool GeoJSONParser::parse(QFile *file, QList<TrackData> &tracks,
 		case MultiPolygon:
 			return multiPolygon(object, proj, QJsonValue(), areas);
 		case Unknown:
-			if (object["type"].toString().isNull())
+			if (string(object.value("type")).isNull())
 				_errorString = "Not a GeoJSON file";
 			else
-				_errorString = object["type"].toString()
+				_errorString = string(object.value("type"))
 				  + ": unknown GeoJSON object";
 			return false;
 	}
@@ -1,18 +1,19 @@
 #ifndef GEOJSONPARSER_H
 #define GEOJSONPARSER_H
 
-#include <QJsonObject>
+#include <QHash>
+#include <QByteArray>
+#include <QJsonValue>
 #include "parser.h"
 
-class QJsonObject;
-class QJsonArray;
 class Projection;
 
 class GeoJSONParser : public Parser
 {
 public:
-	bool parse(QFile *file, QList<TrackData> &tracks, QList<RouteData> &routes,
-	  QList<Area> &areas, QVector<Waypoint> &waypoints);
+	bool parse(QIODevice *file, QList<TrackData> &tracks,
+	  QList<RouteData> &routes, QList<Area> &areas,
+	  QVector<Waypoint> &waypoints);
 	QString errorString() const {return _errorString;}
 	int errorLine() const {return 0;}
 
@@ -30,33 +31,79 @@ private:
 		FeatureCollection
 	};
 
-	bool a2c(const QJsonArray &data, const Projection &proj, Coordinates &c);
-	Type type(const QJsonObject &json);
-	bool crs(const QJsonObject &object, Projection &proj);
-	bool point(const QJsonObject &object, const Projection &parent,
+	/* The GeoJSON data is parsed directly from the (mapped) file without
+	   building a DOM of the whole document. The values are ranges of the
+	   raw JSON text, only the small parts (properties, CRS) are converted
+	   to QJsonValues and the coordinates are parsed directly. */
+	struct Value
+	{
+		Value() : begin(0), end(0) {}
+		Value(const char *begin, const char *end) : begin(begin), end(end) {}
+
+		char first() const {return (begin < end) ? *begin : 0;}
+		bool exists() const {return (begin != 0);}
+		bool isNull() const {return (first() == 'n');}
+		bool isObject() const {return (first() == '{');}
+		bool isArray() const {return (first() == '[');}
+
+		const char *begin;
+		const char *end;
+	};
+	typedef QHash<QByteArray, Value> Object;
+
+	class ArrayReader
+	{
+	public:
+		ArrayReader(const Value &array);
+
+		bool next(Value &item);
+		bool error() const {return _error;}
+		const char *pos() const {return _p;}
+
+	private:
+		const char *_p;
+		const char *_end;
+		bool _first;
+		bool _error;
+	};
+
+	bool syntaxError(const char *pos);
+	bool object(const char *&p, const char *end, Object &object);
+	bool object(const Value &value, Object &object);
+	QString string(const Value &value);
+	QJsonValue json(const Value &value);
+
+	bool a2c(const Value &data, const Projection &proj, Coordinates &c,
+	  double &elevation);
+	Type type(const Object &object);
+	bool crs(const Object &object, Projection &proj);
+	bool point(const Object &object, const Projection &parent,
 	  const QJsonValue &properties, QVector<Waypoint> &waypoints);
-	bool multiPoint(const QJsonObject &object, const Projection &parent,
+	bool multiPoint(const Object &object, const Projection &parent,
 	  const QJsonValue &properties, QVector<Waypoint> &waypoints);
-	bool lineString(const QJsonObject &coordinates, const QString &file,
+	bool lineString(const Object &object, const QString &file,
 	  const Projection &parent, const QJsonValue &properties,
 	  QList<TrackData> &tracks);
-	bool multiLineString(const QJsonObject &object, const QString &file,
+	bool multiLineString(const Object &object, const QString &file,
 	  const Projection &proj, const QJsonValue &properties,
 	  QList<TrackData> &tracks);
-	bool polygon(const QJsonObject &object, const Projection &parent,
+	bool linearRing(const Value &value, const Projection &proj,
+	  QVector<Coordinates> &ring, const char *error);
+	bool polygon(const Object &object, const Projection &parent,
 	  const QJsonValue &properties, QList<Area> &areas);
-	bool multiPolygon(const QJsonObject &object, const Projection &proj,
+	bool multiPolygon(const Object &object, const Projection &proj,
 	  const QJsonValue &properties, QList<Area> &areas);
-	bool geometryCollection(const QJsonObject &json, const QString &file,
+	bool geometryCollection(const Object &object, const QString &file,
 	  const Projection &parent, const QJsonValue &properties,
 	  QList<TrackData> &tracks, QList<Area> &areas, QVector<Waypoint> &waypoints);
-	bool feature(const QJsonObject &json, const QString &file,
+	bool feature(const Object &object, const QString &file,
 	  const Projection &parent, QList<TrackData> &tracks, QList<Area> &areas,
 	  QVector<Waypoint> &waypoints);
-	bool featureCollection(const QJsonObject &object, const QString &file,
+	bool featureCollection(const Object &object, const QString &file,
 	  const Projection &parent, QList<TrackData> &tracks, QList<Area> &areas,
 	  QVector<Waypoint> &waypoints);
 
+	const char *_data;
 	QString _errorString;
 };
 
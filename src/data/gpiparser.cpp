@@ -12,6 +12,7 @@
 #include "common/textcodec.h"
 #include "common/color.h"
 #include "common/util.h"
+#include "common/mappedfile.h"
 #include "address.h"
 #include "gpiparser.h"
 
@@ -46,24 +47,6 @@ QDebug operator<<(QDebug dbg, const TranslatedString &ts)
 }
 #endif // QT_NO_DEBUG
 
-class CryptDevice : public QIODevice
-{
-public:
-	CryptDevice(QIODevice *device, quint32 key, quint32 blockSize,
-	  QObject *parent = 0);
-	bool isSequential() const {return true;}
-
-protected:
-	qint64 readData(char *data, qint64 maxSize);
-	qint64 writeData(const char *, qint64) {return -1;}
-
-private:
-	QIODevice *_device;
-	quint32 _key;
-	QByteArray _block;
-	int _available;
-};
-
 static void demangle(quint8 *data, quint32 size, quint32 key)
 {
 	static const unsigned char shuf[] = {
@@ -87,50 +70,42 @@ static void demangle(quint8 *data, quint32 size, quint32 key)
 	}
 }
 
-CryptDevice::CryptDevice(QIODevice *device, quint32 key, quint32 blockSize,
-  QObject *parent) : QIODevice(parent), _device(device), _key(key), _available(0)
-{
-	_block.resize(blockSize);
-	setOpenMode(_device->openMode());
-}
-
-qint64 CryptDevice::readData(char *data, qint64 maxSize)
+/* Little endian reader of the in-memory (mapped) GPI data with the subset of
+   the QDataStream API used by the parser. All the reads are bounds checked
+   pointer reads, reading past the end of the data sets the ReadPastEnd status
+   and returns zeros like QDataStream does. */
+class DataStream
 {
-	qint64 rs, ts = 0;
-	int cs;
-
-	if (_available) {
-		cs = qMin(maxSize, (qint64)_available);
-		memcpy(data, _block.constData() + _block.size() - _available, cs);
-		_available -= cs;
-		maxSize -= cs;
-		ts = cs;
-	}
-
-	while (maxSize) {
-		if ((rs = _device->read(_block.data(), _block.size())) < 0)
-			return -1;
-		else if (!rs)
-			break;
-		_available = rs;
-		demangle((quint8*)_block.data(), _available, _key);
-		cs = qMin(maxSize, (qint64)_available);
-		memcpy(data + ts, _block.constData(), cs);
-		_available -= cs;
-		maxSize -= cs;
-		ts += cs;
+public:
+	DataStream(const char *data, qint64 size)
+	  : _pos(data), _end(data + size), _status(QDataStream::Ok) {}
+
+	QDataStream::Status status() const {return _status;}
+	void setStatus(QDataStream::Status status)
+	{
+		if (_status == QDataStream::Ok)
+			_status = status;
 	}
+	void setCodepage(quint16 codepage) {_codec = TextCodec(codepage);}
 
-	return ts;
-}
-
-
-class DataStream : public QDataStream
-{
-public:
-	DataStream(QIODevice *d) : QDataStream(d) {}
+	const char *pos() const {return _pos;}
+	qint64 bytesAvailable() const {return _end - _pos;}
+
+	template<class T> DataStream &operator>>(T &val)
+	{
+		if (_end - _pos < (qint64)sizeof(T)) {
+			val = 0;
+			_pos = _end;
+			setStatus(QDataStream::ReadPastEnd);
+		} else {
+			val = qFromLittleEndian<T>(_pos);
+			_pos += sizeof(T);
+		}
 
-	void setCodepage(quint16 codepage) {_codec = TextCodec(codepage);}
+		return *this;
+	}
+	int readRawData(char *s, int len);
+	int skipRawData(int len);
 
 	quint16 readString(QString &str);
 	qint32 readInt24();
@@ -141,17 +116,45 @@ public:
 	quint16 nextHeaderType();
 
 private:
+	const char *_pos;
+	const char *_end;
+	QDataStream::Status _status;
 	TextCodec _codec;
 };
 
+int DataStream::readRawData(char *s, int len)
+{
+	int size = (int)qMin<qint64>(len, _end - _pos);
+
+	memcpy(s, _pos, size);
+	_pos += size;
+	if (size < len)
+		setStatus(QDataStream::ReadPastEnd);
+
+	return size;
+}
+
+int DataStream::skipRawData(int len)
+{
+	int size = (int)qMin<qint64>(len, _end - _pos);
+
+	_pos += size;
+	if (size < len)
+		setStatus(QDataStream::ReadPastEnd);
+
+	return size;
+}
+
 quint16 DataStream::readString(QString &str)
 {
 	quint16 len;
 	*this >> len;
-	QByteArray ba;
-	ba.resize(len);
-	readRawData(ba.data(), len);
-	str = _codec.toString(ba);
+
+	int size = (int)qMin<qint64>(len, _end - _pos);
+	str = _codec.toString(QByteArray::fromRawData(_pos, size));
+	_pos += size;
+	if (size < len)
+		setStatus(QDataStream::ReadPastEnd);
 
 	return len + 2;
 }
@@ -168,13 +171,11 @@ qint32 DataStream::readInt24()
 
 quint16 DataStream::nextHeaderType()
 {
-	quint16 type = 0;
-
-	if (device()->peek((char*)&type, sizeof(type)) < (qint64)sizeof(type)) {
+	if (_end - _pos < 2) {
 		setStatus(QDataStream::ReadCorruptData);
 		return 0xFFFF;
 	} else
-		return qFromLittleEndian(type);
+		return qFromLittleEndian<quint16>(_pos);
 }
 
 quint8 DataStream::readRecordHeader(RecordHeader &hdr)
@@ -596,7 +597,7 @@ static quint32 readSpatialIndex(DataStream &stream, QVector<Waypoint> &waypoints
 	return rs + rh.size;
 }
 
-static quint32 readSymbol(DataStream &stream, QPixmap &pixmap)
+static quint32 readSymbol(DataStream &stream, QImage &img)
 {
 	RecordHeader rh;
 	quint8 rs, u8, bpp, transparent;
@@ -604,7 +605,6 @@ static quint32 readSymbol(DataStream &stream, QPixmap &pixmap)
 	quint16 id, height, width, lineSize;
 	QByteArray data;
 	QVector<QRgb> palette;
-	QImage img;
 
 	rs = stream.readRecordHeader(rh);
 	stream >> id >> height >> width >> lineSize >> bpp >> u8 >> u8 >> u8
@@ -631,14 +631,12 @@ static quint32 readSymbol(DataStream &stream, QPixmap &pixmap)
 	if (data.size() >= lineSize * height) {
 		if (paletteSize) {
 			img = QImage((uchar*)data.data(), width, height, lineSize,
-			  QImage::Format_Indexed8);
+			  QImage::Format_Indexed8).copy();
 			img.setColorTable(palette);
 		} else
 			img = QImage((uchar*)data.data(), width, height, lineSize,
 			  QImage::Format_RGBX8888).rgbSwapped();
 	}
-	pixmap = QPixmap::fromImage(img);
-
 	/* There should be no more data left in the record, but broken GPI files
 	   generated by pinns.co.uk tools exist in the wild so we read out
 	   the record as a workaround for such files. */
@@ -657,7 +655,7 @@ static void readPOIDatabase(DataStream &stream, QVector<Waypoint> &waypoints,
 	QList<TranslatedString> obj;
 	quint32 ds;
 	QVector<QPair<int, quint16> > il;
-	QVector<QPixmap> icons;
+	QVector<QImage> icons;
 
 	stream.readRecordHeader(rh);
 	ds = stream.readTranslatedObjects(obj);
@@ -666,7 +664,7 @@ static void readPOIDatabase(DataStream &stream, QVector<Waypoint> &waypoints,
 		while (stream.status() == QDataStream::Ok && ds < rh.size) {
 			switch (stream.nextHeaderType()) {
 				case 5:
-					icons.append(QPixmap());
+					icons.append(QImage());
 					ds += readSymbol(stream, icons.last());
 					break;
 				case 8:
@@ -773,24 +771,34 @@ bool GPIParser::readFileHeader(DataStream &stream, quint32 &ebs)
 		return true;
 }
 
-bool GPIParser::parse(QFile *file, QList<TrackData> &tracks,
+bool GPIParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons, QVector<Waypoint> &waypoints)
 {
 	Q_UNUSED(tracks);
 	Q_UNUSED(routes);
-	DataStream stream(file);
+	MappedFile mf(file);
+	const char *data = mf.data(mf.size());
 	quint32 ebs;
 
-	stream.setByteOrder(QDataStream::LittleEndian);
+	if (!data) {
+		_errorString = "I/O error";
+		return false;
+	}
+
+	/* The data is read directly from the memory mapping (or the whole file
+	   buffer when the file can not be mapped) without any per field I/O */
+	DataStream stream(data, mf.size());
 
 	if (!readFileHeader(stream, ebs) || !readGPIHeader(stream))
 		return false;
 
 	if (ebs) {
-		CryptDevice dev(stream.device(), 0xf870b5, ebs);
-		DataStream cryptStream(&dev);
-		cryptStream.setByteOrder(QDataStream::LittleEndian);
-		return readData(cryptStream, waypoints, polygons, file->fileName());
+		QByteArray ba(stream.pos(), stream.bytesAvailable());
+		for (int i = 0; i < ba.size(); i += ebs)
+			demangle((quint8*)ba.data() + i, qMin<int>(ebs, ba.size() - i),
+			  0xf870b5);
+		DataStream cryptStream(ba.constData(), ba.size());
+		return readData(cryptStream, waypoints, polygons, fileName(file));
 	} else
-		return readData(stream, waypoints, polygons, file->fileName());
+		return readData(stream, waypoints, polygons, fileName(file));
 }
@@ -86,7 +86,7 @@ static Coordinates parseUTM(const QString &zone, const QString &easting,
 	return proj.xy2ll(PointD(x, y));
 }
 
-bool GPSDumpParser::parse(QFile *file, QList<TrackData> &tracks,
+bool GPSDumpParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons, QVector<Waypoint> &waypoints)
 {
 	static const QRegularExpression dm("[ ]{2,}");
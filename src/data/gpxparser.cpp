@@ -1,12 +1,15 @@
+#include "common/parse.h"
 #include "address.h"
 #include "gpxparser.h"
 
 
+/* Number of the track points handed over to the stream handler at once */
+#define STREAM_CHUNK 4096
+
 qreal GPXParser::number()
 {
-	bool res;
-	qreal ret = _reader.readElementText().toDouble(&res);
-	if (!res)
+	double ret;
+	if (!Parse::toDouble(_reader.readElementText(), ret))
 		_reader.raiseError(QString("Invalid %1").arg(
 		  _reader.name().toString()));
 
@@ -15,8 +18,7 @@ qreal GPXParser::number()
 
 QDateTime GPXParser::time()
 {
-	QDateTime d = QDateTime::fromString(_reader.readElementText(),
-	  Qt::ISODate);
+	QDateTime d(Parse::isoDateTime(_reader.readElementText()));
 	if (!d.isValid())
 		_reader.raiseError(QString("Invalid %1").arg(
 		  _reader.name().toString()));
@@ -41,16 +43,16 @@ Link GPXParser::link()
 
 Coordinates GPXParser::coordinates()
 {
-	bool res;
+	double lon, lat;
 	const QXmlStreamAttributes &attr = _reader.attributes();
 
-	qreal lon = attr.value("lon").toDouble(&res);
-	if (!res || (lon < -180.0 || lon > 180.0)) {
+	if (!Parse::toDouble(attr.value("lon"), lon)
+	  || (lon < -180.0 || lon > 180.0)) {
 		_reader.raiseError("Invalid longitude");
 		return Coordinates();
 	}
-	qreal lat = attr.value("lat").toDouble(&res);
-	if (!res || (lat < -90.0 || lat > 90.0)) {
+	if (!Parse::toDouble(attr.value("lat"), lat)
+	  || (lat < -90.0 || lat > 90.0)) {
 		_reader.raiseError("Invalid latitude");
 		return Coordinates();
 	}
@@ -225,11 +227,23 @@ void GPXParser::trackpoints(SegmentData &segment)
 {
 	while (_reader.readNextStartElement()) {
 		if (_reader.name() == QLatin1String("trkpt")) {
-			segment.append(Trackpoint(coordinates()));
-			trackpointData(segment.last());
+			Trackpoint t(coordinates());
+			trackpointData(t);
+			segment.append(t);
+			if (_handler && !(segment.size() % STREAM_CHUNK))
+				streamPoints(segment, segment.size() - STREAM_CHUNK);
 		} else
 			_reader.skipCurrentElement();
 	}
+
+	if (_handler && segment.size() % STREAM_CHUNK)
+		streamPoints(segment, segment.size() - segment.size() % STREAM_CHUNK);
+}
+
+void GPXParser::streamPoints(const SegmentData &segment, int from)
+{
+	if (!_reader.error() && !_handler->trackpoints(segment, from))
+		_reader.raiseError("Canceled");
 }
 
 void GPXParser::routeExtension(RouteData &route)
@@ -390,6 +404,11 @@ void GPXParser::gpx(QList<TrackData> &tracks, QList<RouteData> &routes,
 		if (_reader.name() == QLatin1String("trk")) {
 			tracks.append(TrackData());
 			track(tracks.back());
+			if (_handler && !_reader.error()) {
+				if (!_handler->track(tracks.last()))
+					_reader.raiseError("Canceled");
+				tracks.removeLast();
+			}
 		} else if (_reader.name() == QLatin1String("rte")) {
 			routes.append(RouteData());
 			QFile *file = qobject_cast<QFile *>(_reader.device());
@@ -406,7 +425,7 @@ void GPXParser::gpx(QList<TrackData> &tracks, QList<RouteData> &routes,
 	}
 }
 
-bool GPXParser::parse(QFile *file, QList<TrackData> &tracks,
+bool GPXParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &areas, QVector<Waypoint> &waypoints)
 {
 	_reader.clear();
@@ -7,8 +7,9 @@
 class GPXParser : public Parser
 {
 public:
-	bool parse(QFile *file, QList<TrackData> &tracks, QList<RouteData> &routes,
-	  QList<Area> &areas, QVector<Waypoint> &waypoints);
+	bool parse(QIODevice *file, QList<TrackData> &tracks,
+	  QList<RouteData> &routes, QList<Area> &areas,
+	  QVector<Waypoint> &waypoints);
 	QString errorString() const {return _reader.errorString();}
 	int errorLine() const {return _reader.lineNumber();}
 
@@ -17,6 +18,7 @@ private:
 	  QList<Area> &areas, QVector<Waypoint> &waypoints);
 	void track(TrackData &track);
 	void trackpoints(SegmentData &segment);
+	void streamPoints(const SegmentData &segment, int from);
 	void routepoints(RouteData &route, QList<TrackData> &tracks);
 	void rpExtension(SegmentData *autoRoute);
 	void tpExtension(Trackpoint &trackpoint);
@@ -42,17 +42,54 @@ inline QDebug operator<<(QDebug dbg, const GraphPoint &point)
 }
 #endif // QT_NO_DEBUG
 
-class GraphSegment : public QVector<GraphPoint>
+/* Columnar graph segment. The x axis columns (distance and time) are
+   implicitly shared, so all the graphs of a track segment that contain all
+   the segment points reference the same (track) columns instead of having
+   their own copies. An empty time column means no time. */
+class GraphSegment
 {
 public:
-	GraphSegment(const QDateTime &start)
-	  : _start(start) {}
-	GraphSegment(int size, const QDateTime &start)
-	  : QVector<GraphPoint>(size), _start(start) {}
+	GraphSegment(const QDateTime &start) : _start(start) {}
+	GraphSegment(const QVector<qreal> &s, const QVector<qreal> &t,
+	  const QVector<qreal> &y, const QDateTime &start)
+	  : _s(s), _t(t), _y(y), _start(start) {}
 
+	int size() const {return _y.size();}
+	int count() const {return _y.size();}
+	bool isEmpty() const {return _y.isEmpty();}
+
+	GraphPoint at(int i) const
+	  {return GraphPoint(_s.at(i), _t.isEmpty() ? NAN : _t.at(i), _y.at(i));}
+	GraphPoint first() const {return at(0);}
+	GraphPoint last() const {return at(size() - 1);}
+
+	void append(const GraphPoint &point)
+	{
+		if (!_t.isEmpty())
+			_t.append(point.t());
+		else if (!std::isnan(point.t())) {
+			_t.fill(NAN, _y.size());
+			_t.append(point.t());
+		}
+		_s.append(point.s());
+		_y.append(point.y());
+	}
+	void append(const GraphSegment &other)
+	{
+		for (int i = 0; i < other.size(); i++)
+			append(other.at(i));
+	}
+	void setY(int i, qreal y) {_y[i] = y;}
+	void setAxis(const QVector<qreal> &s, const QVector<qreal> &t)
+	  {_s = s; _t = t;}
+
+	const QVector<qreal> &s() const {return _s;}
+	const QVector<qreal> &t() const {return _t;}
+	const QVector<qreal> &y() const {return _y;}
 	const QDateTime &start() const {return _start;}
 
 private:
+	QVector<qreal> _s, _t, _y;
 	QDateTime _start;
 };
 
@@ -62,9 +99,11 @@ public:
 	bool hasTime() const
 	{
 		for (int i = 0; i < size(); i++) {
-			const GraphSegment &segment = at(i);
-			for (int j = 0; j < segment.size(); j++)
-				if (std::isnan(segment.at(j).t()))
+			const QVector<qreal> &t = at(i).t();
+			if (t.isEmpty() && !at(i).isEmpty())
+				return false;
+			for (int j = 0; j < t.size(); j++)
+				if (std::isnan(t.at(j)))
 					return false;
 		}
 		return true;
@@ -1,8 +1,11 @@
 #include <cstring>
 #include <QTimeZone>
 #include "common/util.h"
+#include "common/mappedfile.h"
 #include "igcparser.h"
 
+#define MIN_CHUNK_SIZE 262144
+
 
 static bool readLat(const char *data, qreal &lat)
 {
@@ -126,32 +129,34 @@ bool IGCParser::readHRecord(CTX &ctx, const char *line, int len)
 }
 
 bool IGCParser::readBRecord(CTX &ctx, const char *line, int len,
-  SegmentData &segment)
+  SegmentData &segment, QString &errorString)
 {
 	qreal lat, lon, ele;
 	QTime time;
 
-	if (len < 35)
+	if (len < 35) {
+		errorString = "Invalid B record";
 		return false;
+	}
 	if (line[24] != 'A')
 		return true;
 
 	if (!readTimestamp(line + 1, time)) {
-		_errorString = "Invalid timestamp";
+		errorString = "Invalid timestamp";
 		return false;
 	}
 
 	if (!readLat(line + 7, lat)) {
-		_errorString = "Invalid latitude";
+		errorString = "Invalid latitude";
 		return false;
 	}
 	if (!readLon(line + 15, lon)) {
-		_errorString = "Invalid longitude";
+		errorString = "Invalid longitude";
 		return false;
 	}
 
 	if (!readAltitude(line + 24, ele)) {
-		_errorString = "Invalid altitude";
+		errorString = "Invalid altitude";
 		return false;
 	}
 
@@ -196,71 +201,176 @@ bool IGCParser::readCRecord(const char *line, int len, RouteData &route)
 	return true;
 }
 
-bool IGCParser::parse(QFile *file, QList<TrackData> &tracks,
-  QList<RouteData> &routes, QList<Area> &polygons,
-  QVector<Waypoint> &waypoints)
+void IGCParser::beginTrack(CTX &ctx, const QString &fileName,
+  QList<TrackData> &tracks)
 {
-	Q_UNUSED(waypoints);
-	Q_UNUSED(polygons);
-	qint64 len;
-	char line[76 + 2 + 1 + 1];
-	bool route = false, track = false;
-	CTX ctx;
-
-
-	_errorLine = 1;
-	_errorString.clear();
+	if (ctx.date.isNull()) {
+		/* The date H header is mandatory, but XCSOAR generates files without
+		   it, so add a dummy date in such case */
+		qWarning("%s: Missing date header", qUtf8Printable(fileName));
+		ctx.date = QDate(1970, 1, 1);
+	}
 
-	while (!file->atEnd()) {
-		len = file->readLine(line, sizeof(line));
+	tracks.append(SegmentData());
+	tracks.last().setFile(fileName);
+	ctx.time = QTime(0, 0);
+	ctx.track = true;
+}
 
-		if (len < 0) {
-			_errorString = "I/O error";
-			return false;
-		} else if (len > (qint64)sizeof(line) - 1) {
-			_errorString = "Line limit exceeded";
-			return false;
-		}
+bool IGCParser::readRecords(CTX &ctx, const char *&lp, const char *end,
+  const QString &fileName, QList<TrackData> &tracks, QList<RouteData> &routes,
+  bool header)
+{
+	while (lp < end) {
+		const char *nl = (const char*)memchr(lp, '\n', end - lp);
+		const char *le = nl ? nl + 1 : end;
+		int len = le - lp;
 
 		if (_errorLine == 1) {
-			if (!readARecord(line, len)) {
+			if (!readARecord(lp, len)) {
 				_errorString = "Invalid/missing A record";
 				return false;
 			}
 		} else {
-			if (line[0] == 'H') {
-				if (!readHRecord(ctx, line, len))
+			if (lp[0] == 'H') {
+				if (!readHRecord(ctx, lp, len))
 					return false;
-			} else if (line[0] == 'C') {
-				if (route) {
-					if (!readCRecord(line, len, routes.last()))
+			} else if (lp[0] == 'C') {
+				if (ctx.route) {
+					if (!readCRecord(lp, len, routes.last()))
 						return false;
 				} else {
-					route = true;
+					ctx.route = true;
 					routes.append(RouteData());
-					routes.last().setFile(file->fileName());
-				}
-			} else if (line[0] == 'B') {
-				if (ctx.date.isNull()) {
-					/* The date H header is mandatory, but XCSOAR generates
-					   files without it, so add a dummy date in such case */
-					qWarning("%s: Missing date header",
-					  qUtf8Printable(file->fileName()));
-					ctx.date = QDate(1970, 1, 1);
+					routes.last().setFile(fileName);
 				}
-				if (!track) {
-					tracks.append(SegmentData());
-					tracks.last().setFile(file->fileName());
-					ctx.time = QTime(0, 0);
-					track = true;
-				}
-				if (!readBRecord(ctx, line, len, tracks.last().last()))
+			} else if (lp[0] == 'B') {
+				if (header)
+					return true;
+				if (!ctx.track)
+					beginTrack(ctx, fileName, tracks);
+				if (!readBRecord(ctx, lp, len, tracks.last().last(),
+				  _errorString))
 					return false;
 			}
 		}
 
 		_errorLine++;
+		lp = le;
 	}
 
 	return true;
 }
+
+void IGCParser::Chunk::parse()
+{
+	CTX ctx;
+
+	ctx.date = date;
+	ctx.time = QTime(0, 0);
+
+	for (const char *lp = begin; lp < end; ) {
+		const char *nl = (const char*)memchr(lp, '\n', end - lp);
+		const char *le = nl ? nl + 1 : end;
+		int len = le - lp;
+
+		lines++;
+
+		if (lp[0] == 'B') {
+			if (!readBRecord(ctx, lp, len, segment, errorString))
+				return;
+		} else if (lp[0] == 'C' || (lp[0] == 'H' && len >= 11
+		  && !::strncmp(lp, "HFDTE", 5))) {
+			header = true;
+			return;
+		}
+
+		lp = le;
+	}
+}
+
+bool IGCParser::parse(QIODevice *file, QList<TrackData> &tracks,
+  QList<RouteData> &routes, QList<Area> &polygons,
+  QVector<Waypoint> &waypoints)
+{
+	Q_UNUSED(waypoints);
+	Q_UNUSED(polygons);
+	QByteArray buffer;
+	const char *data;
+	qint64 size;
+	CTX ctx;
+
+
+	_errorLine = 1;
+	_errorString.clear();
+
+	MappedFile mf(file);
+	if (mf.isMapped()) {
+		size = mf.size() - mf.pos();
+		if (!(data = mf.data(size))) {
+			_errorString = "I/O error";
+			return false;
+		}
+	} else {
+		buffer = file->readAll();
+		data = buffer.constData();
+		size = buffer.size();
+	}
+	const char *lp = data, *end = data + size;
+
+	/* The header records are parsed sequentially up to the first fix */
+	if (!readRecords(ctx, lp, end, fileName(file), tracks, routes, true))
+		return false;
+	if (lp == end)
+		return true;
+
+	/* The fixes of large files are parsed in parallel chunks, unless there
+	   are date headers or task records interleaved with the fixes */
+	QVector<Chunk> chunks(LineChunks::split<Chunk>(lp, end, MIN_CHUNK_SIZE));
+	if (chunks.size() > 1) {
+		bool header = false;
+
+		beginTrack(ctx, fileName(file), tracks);
+		for (int i = 0; i < chunks.size(); i++)
+			chunks[i].date = ctx.date;
+		LineChunks::parse(chunks, &Chunk::parse);
+
+		for (int i = 0; i < chunks.size(); i++)
+			header |= chunks.at(i).header;
+
+		if (!header) {
+			int line;
+			int i = LineChunks::error(chunks, line);
+			if (i >= 0) {
+				_errorString = chunks.at(i).errorString;
+				_errorLine += line - 1;
+				return false;
+			}
+
+			/* The chunks dates start at the header date, shift them by the
+			   days passed in the previous chunks */
+			SegmentData &segment = tracks.last().last();
+			for (i = 0; i < chunks.size(); i++) {
+				SegmentData &cs = chunks[i].segment;
+				if (cs.isEmpty())
+					continue;
+
+				if (!segment.isEmpty()) {
+					QDateTime last(segment.timestamp(segment.size() - 1));
+					int days = ctx.date.daysTo(last.date());
+					if (cs.timestamp(0).time() < last.time())
+						days++;
+					if (days)
+						for (int j = 0; j < cs.size(); j++)
+							cs.setTimestamp(j, cs.timestamp(j).addDays(days));
+				}
+
+				segment.append(cs);
+			}
+
+			return true;
+		}
+	}
+
+	return readRecords(ctx, lp, end, fileName(file), tracks, routes, false);
+}
@@ -3,6 +3,7 @@
 
 #include <QDate>
 #include <QTime>
+#include "common/linechunks.h"
 #include "parser.h"
 
 
@@ -11,20 +12,45 @@ class IGCParser : public Parser
 public:
 	IGCParser() : _errorLine(0) {}
 
-	bool parse(QFile *file, QList<TrackData> &tracks, QList<RouteData> &routes,
-	  QList<Area> &polygons, QVector<Waypoint> &waypoints);
+	bool parse(QIODevice *file, QList<TrackData> &tracks,
+	  QList<RouteData> &routes, QList<Area> &polygons,
+	  QVector<Waypoint> &waypoints);
 	QString errorString() const {return _errorString;}
 	int errorLine() const {return _errorLine;}
 
 private:
 	struct CTX {
+		CTX() : route(false), track(false) {}
+
 		QDate date;
 		QTime time;
+		bool route;
+		bool track;
+	};
+
+	class Chunk : public LineChunk
+	{
+	public:
+		Chunk() : header(false) {}
+
+		void parse();
+
+		QDate date;
+		SegmentData segment;
+		/* The chunk contains header records and must be parsed
+		   sequentially */
+		bool header;
 	};
 
 	bool readHRecord(CTX &ctx, const char *line, int len);
-	bool readBRecord(CTX &ctx, const char *line, int len, SegmentData &segment);
+	static bool readBRecord(CTX &ctx, const char *line, int len,
+	  SegmentData &segment, QString &errorString);
 	bool readCRecord(const char *line, int len, RouteData &route);
+	void beginTrack(CTX &ctx, const QString &fileName,
+	  QList<TrackData> &tracks);
+	bool readRecords(CTX &ctx, const char *&lp, const char *end,
+	  const QString &fileName, QList<TrackData> &tracks,
+	  QList<RouteData> &routes, bool header);
 
 	int _errorLine;
 	QString _errorString;
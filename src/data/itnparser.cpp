@@ -2,7 +2,7 @@
 #include "common/textcodec.h"
 #include "itnparser.h"
 
-bool ITNParser::parse(QFile *file, QList<TrackData> &tracks,
+bool ITNParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons, QVector<Waypoint> &waypoints)
 {
 	Q_UNUSED(tracks);
@@ -40,7 +40,7 @@ bool ITNParser::parse(QFile *file, QList<TrackData> &tracks,
 		_errorLine++;
 	}
 
-	rd.setFile(file->fileName());
+	rd.setFile(fileName(file));
 	routes.append(rd);
 
 	return true;
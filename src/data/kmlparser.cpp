@@ -1,27 +1,16 @@
-/*
-	WARNING: This code uses internal Qt API - the QZipReader class for reading
-	ZIP files - and things may break if Qt changes the API. For Qt5 this is not
-	a problem as we can "see the future" now and there are no changes in all
-	the supported Qt5 versions up to the last one (5.15). In Qt6 the class
-	might change or even disappear in the future, but this is very unlikely
-	as there were no changes for several years and The Qt Company's policy
-	is: "do not invest any resources into any desktop related stuff unless
-	absolutely necessary". There is an issue (QTBUG-3897) since the year 2009 to
-	include the ZIP reader into the public API, which aptly illustrates the
-	effort The Qt Company is willing to make about anything desktop related...
-*/
-
 #include <QFileInfo>
 #include <QTemporaryDir>
 #include <QCryptographicHash>
 #include <QtEndian>
 #include <QUrl>
 #include <QRegularExpression>
-#include <private/qzipreader_p.h>
+#include <QScopedPointer>
 #include "common/util.h"
+#include "common/parse.h"
+#include "common/ziparchive.h"
 #include "kmlparser.h"
 
-static bool isZIP(QFile *file)
+static bool isZIP(QIODevice *file)
 {
 	quint32 magic;
 
@@ -29,6 +18,39 @@ static bool isZIP(QFile *file)
 	  && qFromLittleEndian(magic) == 0x04034b50);
 }
 
+/* Extracts all the (resource) files except of the KML files from the ZIP
+   archive and returns the name of the main (first top level) KML file. The
+   KML file itself is not extracted but parsed directly from the archive. */
+static bool extract(ZipArchive &zip, const QDir &dir, QString &kml)
+{
+	QStringList names(zip.fileNames());
+	names.sort();
+
+	for (int i = 0; i < names.size(); i++) {
+		const QString &name = names.at(i);
+		if (name.endsWith('/'))
+			continue;
+		if (name.endsWith(".kml")) {
+			if (kml.isEmpty() && !name.contains('/'))
+				kml = name;
+			continue;
+		}
+
+		QString path(QDir::cleanPath(name));
+		if (path.startsWith("../") || QDir::isAbsolutePath(path))
+			continue;
+		QFileInfo fi(dir.absoluteFilePath(path));
+		if (!dir.mkpath(fi.absolutePath()))
+			return false;
+		QFile file(fi.absoluteFilePath());
+		if (!file.open(QIODevice::WriteOnly)
+		  || file.write(zip.fileData(name)) < 0)
+			return false;
+	}
+
+	return true;
+}
+
 qreal KMLParser::number()
 {
 	bool res;
@@ -61,8 +83,7 @@ bool KMLParser::coord(Trackpoint &trackpoint)
 	QString data = _reader.readElementText();
 	const QChar *sp, *ep, *cp, *vp;
 	int c = 0;
-	qreal val[3];
-	bool res;
+	double val[3];
 
 	if (data.isEmpty())
 		return true;
@@ -79,8 +100,7 @@ bool KMLParser::coord(Trackpoint &trackpoint)
 			if (c > 2)
 				return false;
 
-			val[c] = QString(vp, cp - vp).toDouble(&res);
-			if (!res)
+			if (!Parse::toDouble(vp, cp - vp, val[c]))
 				return false;
 
 			if (c == 1) {
@@ -105,8 +125,7 @@ bool KMLParser::pointCoordinates(Waypoint &waypoint)
 	QString data = _reader.readElementText();
 	const QChar *sp, *ep, *cp, *vp;
 	int c = 0;
-	qreal val[3];
-	bool res;
+	double val[3];
 
 
 	sp = data.constData();
@@ -121,8 +140,7 @@ bool KMLParser::pointCoordinates(Waypoint &waypoint)
 			if (c > 1)
 				return false;
 
-			val[c] = QString(vp, cp - vp).toDouble(&res);
-			if (!res)
+			if (!Parse::toDouble(vp, cp - vp, val[c]))
 				return false;
 
 			c++;
@@ -131,8 +149,7 @@ bool KMLParser::pointCoordinates(Waypoint &waypoint)
 			if (c < 1)
 				return false;
 
-			val[c] = QString(vp, cp - vp).toDouble(&res);
-			if (!res)
+			if (!Parse::toDouble(vp, cp - vp, val[c]))
 				return false;
 
 			waypoint.setCoordinates(Coordinates(val[0], val[1]));
@@ -155,8 +172,7 @@ bool KMLParser::lineCoordinates(SegmentData &segment)
 	QString data = _reader.readElementText();
 	const QChar *sp, *ep, *cp, *vp;
 	int c = 0;
-	qreal val[3];
-	bool res;
+	double val[3];
 
 
 	sp = data.constData();
@@ -171,8 +187,7 @@ bool KMLParser::lineCoordinates(SegmentData &segment)
 			if (c > 1)
 				return false;
 
-			val[c] = QString(vp, cp - vp).toDouble(&res);
-			if (!res)
+			if (!Parse::toDouble(vp, cp - vp, val[c]))
 				return false;
 
 			c++;
@@ -181,8 +196,7 @@ bool KMLParser::lineCoordinates(SegmentData &segment)
 			if (c < 1 || c > 2)
 				return false;
 
-			val[c] = QString(vp, cp - vp).toDouble(&res);
-			if (!res)
+			if (!Parse::toDouble(vp, cp - vp, val[c]))
 				return false;
 
 			segment.append(Trackpoint(Coordinates(val[0], val[1])));
@@ -206,8 +220,7 @@ bool KMLParser::polygonCoordinates(QVector<Coordinates> &points)
 	QString data = _reader.readElementText();
 	const QChar *sp, *ep, *cp, *vp;
 	int c = 0;
-	qreal val[3];
-	bool res;
+	double val[3];
 
 
 	sp = data.constData();
@@ -222,8 +235,7 @@ bool KMLParser::polygonCoordinates(QVector<Coordinates> &points)
 			if (c > 1)
 				return false;
 
-			val[c] = QString(vp, cp - vp).toDouble(&res);
-			if (!res)
+			if (!Parse::toDouble(vp, cp - vp, val[c]))
 				return false;
 
 			c++;
@@ -232,8 +244,7 @@ bool KMLParser::polygonCoordinates(QVector<Coordinates> &points)
 			if (c < 1 || c > 2)
 				return false;
 
-			val[c] = QString(vp, cp - vp).toDouble(&res);
-			if (!res)
+			if (!Parse::toDouble(vp, cp - vp, val[c]))
 				return false;
 
 			points.append(Coordinates(val[0], val[1]));
@@ -494,11 +505,14 @@ void KMLParser::track(SegmentData &segment)
 			if (i == segment.size()) {
 				_reader.raiseError(error);
 				return;
-			} else if (!coord(segment[i])) {
+			}
+			Trackpoint t(segment.at(i));
+			if (!coord(t)) {
 				_reader.raiseError("Invalid coordinates");
 				return;
 			}
-			if (segment.at(i).coordinates().isNull())
+			segment[i] = t;
+			if (t.coordinates().isNull())
 				empty = true;
 			i++;
 		} else if (_reader.name() == QLatin1String("ExtendedData"))
@@ -755,12 +769,12 @@ QString KMLParser::styleUrl()
 void KMLParser::iconStyle(const QDir &dir, const QString &id,
   PointStyleMap &styles)
 {
-	QPixmap img;
+	QImage img;
 	QColor c(0x55, 0x55, 0x55);
 
 	while (_reader.readNextStartElement()) {
 		if (_reader.name() == QLatin1String("Icon"))
-			img = QPixmap(dir.absoluteFilePath(icon()));
+			img = QImage(dir.absoluteFilePath(icon()));
 		else if (_reader.name() == QLatin1String("color"))
 			c = color();
 		else
@@ -926,40 +940,44 @@ void KMLParser::kml(const Ctx &ctx, QList<TrackData> &tracks,
 	}
 }
 
-bool KMLParser::parse(QFile *file, QList<TrackData> &tracks,
+bool KMLParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &areas, QVector<Waypoint> &waypoints)
 {
 	Q_UNUSED(routes);
-	QFileInfo fi(*file);
+	QFileInfo fi(fileName(file));
 
 	_reader.clear();
 
 	if (isZIP(file)) {
-		QZipReader zip(fi.absoluteFilePath(), QIODevice::ReadOnly);
+		/* The KMZ resources are extracted from the archive file */
+		if (!qobject_cast<QFile*>(file)) {
+			_reader.raiseError("KMZ files in archives are not supported");
+			return false;
+		}
+
+		ZipArchive zip(fi.absoluteFilePath());
 		QTemporaryDir tempDir;
-		if (!tempDir.isValid() || !zip.extractAll(tempDir.path()))
+		QDir zipDir(tempDir.path());
+		QString kmlName;
+
+		if (!tempDir.isValid() || !zip.open()
+		  || !extract(zip, zipDir, kmlName))
 			_reader.raiseError("Error extracting ZIP file");
+		else if (kmlName.isEmpty())
+			_reader.raiseError("No KML file found in ZIP file");
 		else {
-			QDir zipDir(tempDir.path());
-			QFileInfoList files(zipDir.entryInfoList(QStringList("*.kml"),
-			  QDir::Files));
-
-			if (files.isEmpty())
-				_reader.raiseError("No KML file found in ZIP file");
+			QScopedPointer<QIODevice> kmlFile(zip.device(kmlName));
+			if (!kmlFile)
+				_reader.raiseError("Error opening KML file");
 			else {
-				QFile kmlFile(files.first().absoluteFilePath());
-				if (!kmlFile.open(QIODevice::ReadOnly))
-					_reader.raiseError("Error opening KML file");
-				else {
-					_reader.setDevice(&kmlFile);
-
-					if (_reader.readNextStartElement()) {
-						if (_reader.name() == QLatin1String("kml"))
-							kml(Ctx(fi.absoluteFilePath(), zipDir, true),
-							  tracks, areas, waypoints);
-						else
-							_reader.raiseError("Not a KML file");
-					}
+				_reader.setDevice(kmlFile.data());
+
+				if (_reader.readNextStartElement()) {
+					if (_reader.name() == QLatin1String("kml"))
+						kml(Ctx(fi.absoluteFilePath(), zipDir, true),
+						  tracks, areas, waypoints);
+					else
+						_reader.raiseError("Not a KML file");
 				}
 			}
 		}
@@ -53,7 +53,7 @@ void LOCParser::loc(QVector<Waypoint> &waypoints)
 	}
 }
 
-bool LOCParser::parse(QFile *file, QList<TrackData> &tracks,
+bool LOCParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons,
   QVector<Waypoint> &waypoints)
 {
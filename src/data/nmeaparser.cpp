@@ -1,12 +1,29 @@
 #include <cstring>
 #include <QTimeZone>
 #include "common/util.h"
+#include "common/parse.h"
+#include "common/mappedfile.h"
 #include "nmeaparser.h"
 
+#define MAX_LINE 82 /* 80 + CRLF */
+
+
+static inline int hexValue(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	else if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	else if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	else
+		return -1;
+}
 
 static bool validSentence(const char  *line, int len)
 {
 	const char *lp;
+	quint8 sum = 0;
 
 	if (len < 12 || line[0] != '$')
 		return false;
@@ -14,19 +31,18 @@ static bool validSentence(const char  *line, int len)
 	for (lp = line + len - 1; lp > line + 3; lp--)
 		if (!::isspace(*lp))
 			break;
-	if (*(lp-2) != '*' || !::isalnum(*(lp-1)) || !::isalnum(*(lp)))
+	if (*(lp-2) != '*')
 		return false;
 
-	return true;
-}
-
-static bool readFloat(const char *data, int len, qreal &f)
-{
-	bool ok;
+	int hi = hexValue(*(lp-1));
+	int lo = hexValue(*lp);
+	if (hi < 0 || lo < 0)
+		return false;
 
-	f = QByteArray::fromRawData(data, len).toFloat(&ok);
+	for (const char *cp = line + 1; cp < lp - 2; cp++)
+		sum ^= (quint8)*cp;
 
-	return ok;
+	return (sum == ((hi << 4) | lo));
 }
 
 bool NMEAParser::readAltitude(const char *data, int len, qreal &ele)
@@ -36,7 +52,7 @@ bool NMEAParser::readAltitude(const char *data, int len, qreal &ele)
 		return true;
 	}
 
-	if (!readFloat(data, len, ele)) {
+	if (!Parse::toDouble(data, len, ele)) {
 		_errorString = "Invalid altitude";
 		return false;
 	}
@@ -51,7 +67,7 @@ bool NMEAParser::readGeoidHeight(const char *data, int len, qreal &gh)
 		return true;
 	}
 
-	if (!readFloat(data, len, gh)) {
+	if (!Parse::toDouble(data, len, gh)) {
 		_errorString = "Invalid geoid height";
 		return false;
 	}
@@ -61,37 +77,17 @@ bool NMEAParser::readGeoidHeight(const char *data, int len, qreal &gh)
 
 bool NMEAParser::readTime(const char *data, int len, QTime &time)
 {
-	int h, m, s, ms = 0;
-
-
 	if (!len) {
 		time = QTime();
 		return true;
 	}
 
-	if (len < 6)
-		goto error;
-
-	h = Util::str2int(data, 2);
-	m = Util::str2int(data + 2, 2);
-	s = Util::str2int(data + 4, 2);
-	if (h < 0 || m < 0 || s < 0)
-		goto error;
-
-	if (len > 7 && data[6] == '.') {
-		if ((ms = Util::str2int(data + 7, len - 7)) < 0)
-			goto error;
+	if (!Parse::hhmmss(data, len, time)) {
+		_errorString = "Invalid time";
+		return false;
 	}
 
-	time = QTime(h, m, s, ms);
-	if (!time.isValid())
-		goto error;
-
 	return true;
-
-error:
-	_errorString = "Invalid time";
-	return false;
 }
 
 bool NMEAParser::readDate(const char *data, int len, QDate &date)
@@ -131,7 +127,7 @@ error:
 bool NMEAParser::readLat(const char *data, int len, qreal &lat)
 {
 	int d, mi;
-	qreal mf;
+	double mf;
 	bool ok;
 
 
@@ -145,7 +141,7 @@ bool NMEAParser::readLat(const char *data, int len, qreal &lat)
 
 	d = Util::str2int(data, 2);
 	mi = Util::str2int(data + 2, 2);
-	mf = QByteArray::fromRawData(data + 4, len - 4).toFloat(&ok);
+	ok = Parse::toDouble(data + 4, len - 4, mf);
 	if (d < 0 || mi < 0 || !ok)
 		goto error;
 
@@ -181,7 +177,7 @@ bool NMEAParser::readNS(const char *data, int len, qreal &lat)
 bool NMEAParser::readLon(const char *data, int len, qreal &lon)
 {
 	int d, mi;
-	qreal mf;
+	double mf;
 	bool ok;
 
 
@@ -195,7 +191,7 @@ bool NMEAParser::readLon(const char *data, int len, qreal &lon)
 
 	d = Util::str2int(data, 3);
 	mi = Util::str2int(data + 3, 2);
-	mf = QByteArray::fromRawData(data + 5, len - 5).toFloat(&ok);
+	ok = Parse::toDouble(data + 5, len - 5, mf);
 	if (d < 0 || mi < 0 || !ok)
 		goto error;
 
@@ -481,51 +477,110 @@ bool NMEAParser::readZDA(CTX &ctx, const char *line, int len)
 	return true;
 }
 
-bool NMEAParser::parse(QFile *file, QList<TrackData> &tracks,
-  QList<RouteData> &routes, QList<Area> &polygons,
+bool NMEAParser::readSentence(const char *line, int len, SegmentData &segment,
   QVector<Waypoint> &waypoints)
 {
-	Q_UNUSED(routes);
-	Q_UNUSED(polygons);
-	qint64 len;
-	char line[80 + 2/*CRLF*/ + 1/*'\0'*/ + 1/*extra byte for limit check*/];
-	SegmentData segment;
-	CTX ctx;
+	if (validSentence(line, len)) {
+		if (!memcmp(line + 3, "RMC,", 4)) {
+			if (!readRMC(_ctx, line + 7, len - 7, segment))
+				return false;
+		} else if (!memcmp(line + 3, "GGA,", 4)) {
+			if (!readGGA(_ctx, line + 7, len - 7, segment))
+				return false;
+		} else if (!memcmp(line + 3, "WPL,", 4)) {
+			if (!readWPL(line + 7, len - 7, waypoints))
+				return false;
+		} else if (!memcmp(line + 3, "ZDA,", 4)) {
+			if (!readZDA(_ctx, line + 7, len - 7))
+				return false;
+		}
+	}
 
+	return true;
+}
 
-	_errorLine = 1;
-	_errorString.clear();
+bool NMEAParser::readLines(QIODevice *file, SegmentData &segment,
+  QVector<Waypoint> &waypoints, bool tail)
+{
+	qint64 len, pos;
+	char line[MAX_LINE + 1/*'\0'*/ + 1/*extra byte for limit check*/];
 
 	while (!file->atEnd()) {
+		pos = file->pos();
 		len = file->readLine(line, sizeof(line));
 
 		if (len < 0) {
 			_errorString = "I/O error";
 			return false;
+		} else if (tail && len && line[len-1] != '\n' && file->atEnd()) {
+			/* The line is still being written */
+			file->seek(pos);
+			break;
 		} else if (len >= (qint64)sizeof(line) - 1) {
 			_errorString = "Line limit exceeded";
 			return false;
 		}
 
-		if (validSentence(line, len)) {
-			if (!memcmp(line + 3, "RMC,", 4)) {
-				if (!readRMC(ctx, line + 7, len - 7, segment))
-					return false;
-			} else if (!memcmp(line + 3, "GGA,", 4)) {
-				if (!readGGA(ctx, line + 7, len - 7, segment))
-					return false;
-			} else if (!memcmp(line + 3, "WPL,", 4)) {
-				if (!readWPL(line + 7, len - 7, waypoints))
-					return false;
-			} else if (!memcmp(line + 3, "ZDA,", 4)) {
-				if (!readZDA(ctx, line + 7, len - 7))
-					return false;
-			}
+		if (!readSentence(line, len, segment, waypoints))
+			return false;
+
+		_errorLine++;
+	}
+
+	return true;
+}
+
+/* Mapped files are scanned for the line ends (memchr) directly in the mapped
+   data without copying the lines */
+bool NMEAParser::readData(const char *data, qint64 size, SegmentData &segment,
+  QVector<Waypoint> &waypoints)
+{
+	const char *end = data + size;
+
+	for (const char *lp = data; lp < end; ) {
+		const char *nl = (const char*)memchr(lp, '\n', end - lp);
+		const char *le = nl ? nl + 1 : end;
+
+		if (le - lp > MAX_LINE) {
+			_errorString = "Line limit exceeded";
+			return false;
 		}
 
+		if (!readSentence(lp, le - lp, segment, waypoints))
+			return false;
+
 		_errorLine++;
+		lp = le;
 	}
 
+	return true;
+}
+
+bool NMEAParser::parse(QIODevice *file, QList<TrackData> &tracks,
+  QList<RouteData> &routes, QList<Area> &polygons,
+  QVector<Waypoint> &waypoints)
+{
+	Q_UNUSED(routes);
+	Q_UNUSED(polygons);
+	SegmentData segment;
+
+	_ctx = CTX();
+	_errorLine = 1;
+	_errorString.clear();
+
+	MappedFile mf(file);
+	if (mf.isMapped()) {
+		qint64 size = mf.size() - mf.pos();
+		const char *data = mf.data(size);
+		if (!data) {
+			_errorString = "I/O error";
+			return false;
+		}
+		if (!readData(data, size, segment, waypoints))
+			return false;
+	} else if (!readLines(file, segment, waypoints, false))
+		return false;
+
 	if (!segment.size() && !waypoints.size()) {
 		_errorString = "No usable NMEA sentence found";
 		return false;
@@ -533,9 +588,19 @@ bool NMEAParser::parse(QFile *file, QList<TrackData> &tracks,
 
 	if (segment.size()) {
 		tracks.append(TrackData());
-		tracks.last().setFile(file->fileName());
+		tracks.last().setFile(fileName(file));
 		tracks.last().append(segment);
 	}
 
 	return true;
 }
+
+bool NMEAParser::tail(QFile *file, SegmentData &segment,
+  QVector<Waypoint> &waypoints)
+{
+	if (!_errorLine)
+		_errorLine = 1;
+	_errorString.clear();
+
+	return readLines(file, segment, waypoints, true);
+}
@@ -10,11 +10,15 @@ class NMEAParser : public Parser
 public:
 	NMEAParser() : _errorLine(0) {}
 
-	bool parse(QFile *file, QList<TrackData> &tracks, QList<RouteData> &routes,
-	  QList<Area> &polygons, QVector<Waypoint> &waypoints);
+	bool parse(QIODevice *file, QList<TrackData> &tracks,
+	  QList<RouteData> &routes, QList<Area> &polygons,
+	  QVector<Waypoint> &waypoints);
 	QString errorString() const {return _errorString;}
 	int errorLine() const {return _errorLine;}
 
+	bool canTail() const {return true;}
+	bool tail(QFile *file, SegmentData &segment, QVector<Waypoint> &waypoints);
+
 private:
 	struct CTX {
 		CTX() : GGA(false) {}
@@ -37,7 +41,14 @@ private:
 	bool readGGA(CTX &ctx, const char *line, int len, SegmentData &segment);
 	bool readWPL(const char *line, int len, QVector<Waypoint> &waypoints);
 	bool readZDA(CTX &ctx, const char *line, int len);
-
+	bool readSentence(const char *line, int len, SegmentData &segment,
+	  QVector<Waypoint> &waypoints);
+	bool readLines(QIODevice *file, SegmentData &segment,
+	  QVector<Waypoint> &waypoints, bool tail);
+	bool readData(const char *data, qint64 size, SegmentData &segment,
+	  QVector<Waypoint> &waypoints);
+
+	CTX _ctx;
 	int _errorLine;
 	QString _errorString;
 };
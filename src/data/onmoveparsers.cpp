@@ -1,8 +1,11 @@
 #include <QFileInfo>
 #include <QDir>
 #include <QtEndian>
+#include "common/mappedfile.h"
 #include "onmoveparsers.h"
 
+#define CHUNK_SIZE 20
+
 
 static inline quint16 u16(const char *buffer)
 {
@@ -109,13 +112,13 @@ bool OMDParser::readF2(const char *chunk, const Header &hdr, Sequence &seq,
 	quint8 hr2 = chunk[16];
 
 	if (seq.idx[0] >= 0) {
-		Trackpoint &p0 = segment[seq.idx[0]];
+		SegmentData::Point p0(segment[seq.idx[0]]);
 		if (hdr.hr)
 			p0.setHeartRate(hr1);
 		p0.setSpeed(speed1 / 360.0);
 	}
 	if (seq.idx[1] >= 0) {
-		Trackpoint &p1 = segment[seq.idx[1]];
+		SegmentData::Point p1(segment[seq.idx[1]]);
 		if (hdr.hr)
 			p1.setHeartRate(hr2);
 		p1.setSpeed(speed2 / 360.0);
@@ -128,7 +131,7 @@ bool OMDParser::readF2(const char *chunk, const Header &hdr, Sequence &seq,
 	return true;
 }
 
-bool OMDParser::parse(QFile *file, QList<TrackData> &tracks,
+bool OMDParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons, QVector<Waypoint> &waypoints)
 {
 	Q_UNUSED(routes);
@@ -137,15 +140,15 @@ bool OMDParser::parse(QFile *file, QList<TrackData> &tracks,
 	SegmentData segment;
 	Header hdr;
 	Sequence seq;
-	char chunk[20];
-	qint64 size;
+	MappedFile mf(file);
+	const char *chunk;
 
 	// If no header file is found or it is invalid, continue with the default
 	// header values. The track will have a fictional date and possibly some
 	// zero-graphs, but it will be still usable.
-	readHeaderFile(file->fileName(), hdr);
+	readHeaderFile(fileName(file), hdr);
 
-	while ((size = file->read(chunk, sizeof(chunk))) == sizeof(chunk)) {
+	while ((chunk = mf.data(CHUNK_SIZE))) {
 		switch ((quint8)chunk[19]) {
 			case 0xF1:
 				if (!readF1(chunk, hdr, seq, segment))
@@ -161,10 +164,7 @@ bool OMDParser::parse(QFile *file, QList<TrackData> &tracks,
 		}
 	}
 
-	if (size < 0) {
-		_errorString = "I/O error";
-		return false;
-	} else if (size) {
+	if (!mf.atEnd()) {
 		_errorString = "unexpected end of file";
 		return false;
 	}
@@ -246,7 +246,7 @@ bool GHPParser::readF0(const char *chunk, const Header &hdr, int &time,
 	return true;
 }
 
-bool GHPParser::parse(QFile *file, QList<TrackData> &tracks,
+bool GHPParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons, QVector<Waypoint> &waypoints)
 {
 	Q_UNUSED(routes);
@@ -255,20 +255,17 @@ bool GHPParser::parse(QFile *file, QList<TrackData> &tracks,
 	SegmentData segment;
 	Header hdr;
 	int time = 0;
-	char chunk[20];
-	qint64 size;
+	MappedFile mf(file);
+	const char *chunk;
 
 	// see OMD
-	readHeaderFile(file->fileName(), hdr);
+	readHeaderFile(fileName(file), hdr);
 
-	while ((size = file->read(chunk, sizeof(chunk))) == sizeof(chunk))
+	while ((chunk = mf.data(CHUNK_SIZE)))
 		if (!readF0(chunk, hdr, time, segment))
 			return false;
 
-	if (size < 0) {
-		_errorString = "I/O error";
-		return false;
-	} else if (size) {
+	if (!mf.atEnd()) {
 		_errorString = "unexpected end of file";
 		return false;
 	}
@@ -278,7 +275,7 @@ bool GHPParser::parse(QFile *file, QList<TrackData> &tracks,
 	}
 
 	tracks.append(TrackData());
-	tracks.last().setFile(file->fileName());
+	tracks.last().setFile(fileName(file));
 	tracks.last().append(segment);
 
 	return true;
@@ -2,7 +2,7 @@
 #include "common/textcodec.h"
 #include "ov2parser.h"
 
-bool OV2Parser::parse(QFile *file, QList<TrackData> &tracks,
+bool OV2Parser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons, QVector<Waypoint> &waypoints)
 {
 	Q_UNUSED(tracks);
@@ -1,6 +1,10 @@
+#include <cstring>
+#include "common/mappedfile.h"
 #include "map/gcs.h"
 #include "oziparsers.h"
 
+#define MIN_CHUNK_SIZE 262144
+
 static qint64 delphi2unixMS(double date)
 {
 	return (qint64)((date - 25569.0) * 86400000);
@@ -26,27 +30,114 @@ static QByteArray &decode(QByteArray &ba)
 }
 
 
-bool PLTParser::parse(QFile *file, QList<TrackData> &tracks,
+static bool readTrackpoint(const GCS &gcs, const QByteArray &line,
+  SegmentData &segment, QString &errorString)
+{
+	bool res;
+
+	QList<QByteArray> list = line.split(',');
+	if (list.size() < 2) {
+		errorString = "Parse error";
+		return false;
+	}
+
+	qreal lat = list.at(0).trimmed().toDouble(&res);
+	if (!res || (lat < -90.0 || lat > 90.0)) {
+		errorString = "Invalid latitude";
+		return false;
+	}
+	qreal lon = list.at(1).trimmed().toDouble(&res);
+	if (!res || (lon < -180.0 || lon > 180.0)) {
+		errorString = "Invalid longitude";
+		return false;
+	}
+
+	Trackpoint tp(gcs.toWGS84(Coordinates(lon, lat)));
+
+	if (list.size() >= 4) {
+		QByteArray field(list.at(3).trimmed());
+		if (!field.isEmpty()) {
+			double elevation = field.toDouble(&res);
+			if (!res) {
+				errorString = "Invalid elevation";
+				return false;
+			}
+			if (elevation != -777)
+				tp.setElevation(elevation * 0.3048);
+		}
+	}
+	if (list.size() >= 5) {
+		QByteArray field(list.at(4).trimmed());
+		if (!field.isEmpty()) {
+			double date = field.toDouble(&res);
+			if (!res) {
+				errorString = "Invalid date";
+				return false;
+			}
+			tp.setTimestamp(QDateTime::fromMSecsSinceEpoch(
+			  delphi2unixMS(date)));
+		}
+	}
+
+	segment.append(tp);
+
+	return true;
+}
+
+void PLTParser::Chunk::parse()
+{
+	for (const char *lp = begin; lp < end; ) {
+		const char *nl = (const char*)memchr(lp, '\n', end - lp);
+		const char *le = nl ? nl + 1 : end;
+
+		lines++;
+		if (!readTrackpoint(*gcs, QByteArray::fromRawData(lp, le - lp),
+		  segment, errorString))
+			return;
+
+		lp = le;
+	}
+}
+
+bool PLTParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons,
   QVector<Waypoint> &waypoints)
 {
 	Q_UNUSED(waypoints);
 	Q_UNUSED(routes);
 	Q_UNUSED(polygons);
-	bool res;
+	QByteArray buffer;
+	const char *data;
+	qint64 size;
 	GCS gcs;
 
 	_errorLine = 1;
 	_errorString.clear();
 
+	MappedFile mf(file);
+	if (mf.isMapped()) {
+		size = mf.size() - mf.pos();
+		if (!(data = mf.data(size))) {
+			_errorString = "I/O error";
+			return false;
+		}
+	} else {
+		buffer = file->readAll();
+		data = buffer.constData();
+		size = buffer.size();
+	}
+	const char *lp = data, *end = data + size;
+
 	tracks.append(TrackData());
 	TrackData &track = tracks.last();
-	track.setFile(file->fileName());
+	track.setFile(fileName(file));
 	track.append(SegmentData());
 	SegmentData &segment = track.last();
 
-	while (!file->atEnd()) {
-		QByteArray line = file->readLine(4096);
+	for (; lp < end && _errorLine <= 6; _errorLine++) {
+		const char *nl = (const char*)memchr(lp, '\n', end - lp);
+		const char *le = nl ? nl + 1 : end;
+		QByteArray line(QByteArray::fromRawData(lp, le - lp));
 
 		if (_errorLine == 1) {
 			QString fileType(QString::fromUtf8(line).trimmed());
@@ -67,62 +158,33 @@ bool PLTParser::parse(QFile *file, QList<TrackData> &tracks,
 				  list.at(1).toUInt()));
 			if (list.size() >= 4)
 				track.setName(list.at(3));
-		} else if (_errorLine > 6) {
-			QList<QByteArray> list = line.split(',');
-			if (list.size() < 2) {
-				_errorString = "Parse error";
-				return false;
-			}
-
-			qreal lat = list.at(0).trimmed().toDouble(&res);
-			if (!res || (lat < -90.0 || lat > 90.0)) {
-				_errorString = "Invalid latitude";
-				return false;
-			}
-			qreal lon = list.at(1).trimmed().toDouble(&res);
-			if (!res || (lon < -180.0 || lon > 180.0)) {
-				_errorString = "Invalid longitude";
-				return false;
-			}
-
-			Trackpoint tp(gcs.toWGS84(Coordinates(lon, lat)));
-
-			if (list.size() >= 4) {
-				QByteArray field(list.at(3).trimmed());
-				if (!field.isEmpty()) {
-					double elevation = field.toDouble(&res);
-					if (!res) {
-						_errorString = "Invalid elevation";
-						return false;
-					}
-					if (elevation != -777)
-						tp.setElevation(elevation * 0.3048);
-				}
-			}
-			if (list.size() >= 5) {
-				QByteArray field(list.at(4).trimmed());
-				if (!field.isEmpty()) {
-					double date = field.toDouble(&res);
-					if (!res) {
-						_errorString = "Invalid date";
-						return false;
-					}
-					tp.setTimestamp(QDateTime::fromMSecsSinceEpoch(
-					  delphi2unixMS(date)));
-				}
-			}
-
-
-			segment.append(tp);
 		}
 
-		_errorLine++;
+		lp = le;
+	}
+
+	/* The track points are independent of each other, so large files are
+	   parsed in parallel chunks */
+	QVector<Chunk> chunks(LineChunks::split<Chunk>(lp, end, MIN_CHUNK_SIZE));
+	for (int i = 0; i < chunks.size(); i++)
+		chunks[i].gcs = &gcs;
+	LineChunks::parse(chunks, &Chunk::parse);
+
+	int line;
+	int i = LineChunks::error(chunks, line);
+	if (i >= 0) {
+		_errorString = chunks.at(i).errorString;
+		_errorLine += line - 1;
+		return false;
 	}
 
+	for (i = 0; i < chunks.size(); i++)
+		segment.append(chunks.at(i).segment);
+
 	return true;
 }
 
-bool RTEParser::parse(QFile *file, QList<TrackData> &tracks,
+bool RTEParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons,
   QVector<Waypoint> &waypoints)
 {
@@ -160,7 +222,7 @@ bool RTEParser::parse(QFile *file, QList<TrackData> &tracks,
 
 			if (list.at(0).trimmed() == "R") {
 				routes.append(RouteData());
-				routes.last().setFile(file->fileName());
+				routes.last().setFile(fileName(file));
 				record = true;
 
 				if (list.size() >= 3) {
@@ -227,7 +289,7 @@ bool RTEParser::parse(QFile *file, QList<TrackData> &tracks,
 	return true;
 }
 
-bool WPTParser::parse(QFile *file, QList<TrackData> &tracks,
+bool WPTParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons,
   QVector<Waypoint> &waypoints)
 {
@@ -1,19 +1,34 @@
 #ifndef OZIPARSERS_H
 #define OZIPARSERS_H
 
+#include "common/linechunks.h"
 #include "parser.h"
 
+class GCS;
+
 class PLTParser : public Parser
 {
 public:
 	PLTParser() : _errorLine(0) {}
 
-	bool parse(QFile *file, QList<TrackData> &tracks, QList<RouteData> &routes,
-	  QList<Area> &polygons, QVector<Waypoint> &waypoints);
+	bool parse(QIODevice *file, QList<TrackData> &tracks,
+	  QList<RouteData> &routes, QList<Area> &polygons,
+	  QVector<Waypoint> &waypoints);
 	QString errorString() const {return _errorString;}
 	int errorLine() const {return _errorLine;}
 
 private:
+	class Chunk : public LineChunk
+	{
+	public:
+		Chunk() : gcs(0) {}
+
+		void parse();
+
+		const GCS *gcs;
+		SegmentData segment;
+	};
+
 	QString _errorString;
 	int _errorLine;
 };
@@ -23,8 +38,9 @@ class RTEParser : public Parser
 public:
 	RTEParser() : _errorLine(0) {}
 
-	bool parse(QFile *file, QList<TrackData> &tracks, QList<RouteData> &routes,
-	  QList<Area> &polygons, QVector<Waypoint> &waypoints);
+	bool parse(QIODevice *file, QList<TrackData> &tracks,
+	  QList<RouteData> &routes, QList<Area> &polygons,
+	  QVector<Waypoint> &waypoints);
 	QString errorString() const {return _errorString;}
 	int errorLine() const {return _errorLine;}
 
@@ -38,8 +54,9 @@ class WPTParser : public Parser
 public:
 	WPTParser() : _errorLine(0) {}
 
-	bool parse(QFile *file, QList<TrackData> &tracks, QList<RouteData> &routes,
-	  QList<Area> &polygons, QVector<Waypoint> &waypoints);
+	bool parse(QIODevice *file, QList<TrackData> &tracks,
+	  QList<RouteData> &routes, QList<Area> &polygons,
+	  QVector<Waypoint> &waypoints);
 	QString errorString() const {return _errorString;}
 	int errorLine() const {return _errorLine;}
 
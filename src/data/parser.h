@@ -5,6 +5,7 @@
 #include <QList>
 #include <QVector>
 #include <QFile>
+#include <QIODevice>
 #include "trackdata.h"
 #include "routedata.h"
 #include "waypoint.h"
@@ -14,13 +15,55 @@
 class Parser
 {
 public:
+	/* Consumer of the tracks of the parsers that support streaming (GPX).
+	   The points of the currently parsed segment are handed over in chunks,
+	   from being the index of the first new point (0 = a new segment). The
+	   streamed tracks are handed over as soon as they are complete and are
+	   not part of the parse() output. Returning false aborts the parsing. */
+	class Handler
+	{
+	public:
+		virtual ~Handler() {}
+		virtual bool trackpoints(const SegmentData &segment, int from) = 0;
+		virtual bool track(const TrackData &track) = 0;
+	};
+
+	Parser() : _handler(0) {}
 	virtual ~Parser() {}
 
-	virtual bool parse(QFile *file, QList<TrackData> &tracks,
+	/* The data are parsed from a file or from a buffer (archive entries)
+	   named by its object name */
+	virtual bool parse(QIODevice *file, QList<TrackData> &tracks,
 	  QList<RouteData> &routes, QList<Area> &polygons,
 	  QVector<Waypoint> &waypoints) = 0;
 	virtual QString errorString() const = 0;
 	virtual int errorLine() const = 0;
+
+	void setHandler(Handler *handler) {_handler = handler;}
+
+	static QString fileName(const QIODevice *device)
+	{
+		const QFile *file = qobject_cast<const QFile*>(device);
+		return file ? file->fileName() : device->objectName();
+	}
+
+	/* Line based formats can be followed while the file grows (live GPS
+	   logs). tail() continues the parsing at the current file position with
+	   the parser state left by the previous tail() call and appends the new
+	   track points to the segment. Incomplete trailing lines are not parsed,
+	   the file position is left at their start. */
+	virtual bool canTail() const {return false;}
+	virtual bool tail(QFile *file, SegmentData &segment,
+	  QVector<Waypoint> &waypoints)
+	{
+		Q_UNUSED(file);
+		Q_UNUSED(segment);
+		Q_UNUSED(waypoints);
+		return false;
+	}
+
+protected:
+	Handler *_handler;
 };
 
 #endif // PARSER_H
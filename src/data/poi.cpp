@@ -1,38 +1,124 @@
 #include <QFile>
 #include <QDir>
+#include <QBuffer>
+#include <QDataStream>
+#include <QCryptographicHash>
 #include "common/rectc.h"
 #include "common/greatcircle.h"
 #include "common/wgs84.h"
+#include "common/threadpools.h"
+#include "datacache.h"
 #include "data.h"
 #include "path.h"
 #include "poi.h"
 
 
+#define CORRIDOR_LENGTH 16 // radius multiples
+#define CACHE_SIZE      256 // paths
+#define BLOCK_SIZE      1024 // waypoints
+
+#define NAME        0x0001
+#define DESCRIPTION 0x0002
+#define COMMENT     0x0004
+#define ADDRESS     0x0008
+#define PHONE       0x0010
+#define SYMBOL      0x0020
+#define IMAGES      0x0040
+#define LINKS       0x0080
+#define TIMESTAMP   0x0100
+#define ELEVATION   0x0200
+#define STYLE       0x0400
+
+struct SearchCTX
+{
+	SearchCTX(QSet<int> &set, int start) : set(set), start(start) {}
+
+	QSet<int> &set;
+	int start;
+};
+
 static bool cb(size_t data, void* context)
 {
-	QSet<int> *set = (QSet<int>*) context;
-	set->insert((int)data);
+	SearchCTX *ctx = (SearchCTX*) context;
+	ctx->set.insert(ctx->start + (int)data);
 
 	return true;
 }
 
-POI::File::File(int start, int end, const QVector<Waypoint> &data)
-  : _enabled(true)
+static double segmentDistance(const Coordinates &c, const Coordinates &c1,
+  const Coordinates &c2)
 {
+	double cl = cos(deg2rad(c.lat()));
+	double dl1 = c1.lon() - c.lon();
+	double dl2 = c2.lon() - c.lon();
+	if (dl1 > 180.0)
+		dl1 -= 360.0;
+	else if (dl1 < -180.0)
+		dl1 += 360.0;
+	if (dl2 > 180.0)
+		dl2 -= 360.0;
+	else if (dl2 < -180.0)
+		dl2 += 360.0;
+
+	double x1 = deg2rad(dl1) * cl * WGS84_RADIUS;
+	double y1 = deg2rad(c1.lat() - c.lat()) * WGS84_RADIUS;
+	double x2 = deg2rad(dl2) * cl * WGS84_RADIUS;
+	double y2 = deg2rad(c2.lat() - c.lat()) * WGS84_RADIUS;
+	double dx = x2 - x1;
+	double dy = y2 - y1;
+	double l2 = dx * dx + dy * dy;
+	double t = (l2 > 0) ? qMax(0.0, qMin(1.0, -(x1 * dx + y1 * dy) / l2)) : 0;
+
+	return sqrt((x1 + t * dx) * (x1 + t * dx) + (y1 + t * dy) * (y1 + t * dy));
+}
+
+/* The cache key of a path is its content hash, so it does not depend on the
+   path storage (the path objects are temporaries) */
+static QByteArray pathId(const Path &path)
+{
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+
+	for (int i = 0; i < path.size(); i++) {
+		const PathSegment &segment = path.at(i);
+		for (int j = 0; j < segment.size(); j++) {
+			const Coordinates &c = segment.at(j).coordinates();
+			double ll[2] = {c.lon(), c.lat()};
+			hash.addData((const char*)ll, sizeof(ll));
+		}
+		hash.addData("|", 1);
+	}
+
+	return hash.result();
+}
+
+/* The tree items are the waypoint indexes relative to the file's first
+   waypoint so that the (cached) tree does not depend on the file load order */
+POI::File::File(const QString &path, int start, int end,
+  const QVector<Coordinates> &data) : _enabled(true), _start(start)
+{
+	if (_tree.SetData(DataCache::loadIndex(path))
+	  && _tree.Count() == end - start + 1)
+		return;
+
 	qreal c[2];
 
+	_tree.RemoveAll();
 	for (int i = start; i <= end; i++) {
-		const Coordinates &p = data.at(i).coordinates();
+		const Coordinates &p = data.at(i);
 
 		c[0] = p.lon();
 		c[1] = p.lat();
-		_tree.Insert(c, c, i);
+		_tree.Insert(c, c, i - start);
 	}
+
+	_tree.Pack();
+	DataCache::saveIndex(path, _tree.Data());
 }
 
 void POI::File::search(const RectC &rect, QSet<int> &set) const
 {
 	qreal min[2], max[2];
+	SearchCTX ctx(set, _start);
 
 	if (_enabled) {
 		if (rect.left() > rect.right()) {
@@ -40,19 +126,19 @@ void POI::File::search(const RectC &rect, QSet<int> &set) const
 			min[1] = rect.bottomRight().lat();
 			max[0] = 180.0;
 			max[1] = rect.topLeft().lat();
-			_tree.Search(min, max, cb, &set);
+			_tree.Search(min, max, cb, &ctx);
 
 			min[0] = -180.0;
 			min[1] = rect.bottomRight().lat();
 			max[0] = rect.bottomRight().lon();
 			max[1] = rect.topLeft().lat();
-			_tree.Search(min, max, cb, &set);
+			_tree.Search(min, max, cb, &ctx);
 		} else {
 			min[0] = rect.topLeft().lon();
 			min[1] = rect.bottomRight().lat();
 			max[0] = rect.bottomRight().lon();
 			max[1] = rect.topLeft().lat();
-			_tree.Search(min, max, cb, &set);
+			_tree.Search(min, max, cb, &ctx);
 		}
 	}
 }
@@ -62,6 +148,9 @@ POI::POI(QObject *parent) : QObject(parent)
 {
 	_errorLine = 0;
 	_radius = 1000;
+	_revision = 0;
+
+	_cache.setMaxCost(CACHE_SIZE);
 }
 
 POI::~POI()
@@ -72,24 +161,214 @@ POI::~POI()
 bool POI::loadFile(const QString &path)
 {
 	Data data(path);
+	return loadData(path, data);
+}
 
+bool POI::loadData(const QString &path, const Data &data)
+{
 	if (!data.isValid()) {
 		_errorString = data.errorString();
 		_errorLine = data.errorLine();
 		return false;
 	}
 
-	int start = _data.size();
-	_data.append(data.waypoints());
+	int start = _coordinates.size();
+	append(data.waypoints());
 
-	_files.insert(path, new File(start, _data.size() - 1, _data));
+	_files.insert(path, new File(path, start, _coordinates.size() - 1,
+	  _coordinates));
+	_revision++;
 
 	emit pointsChanged();
 
 	return true;
 }
 
-TreeNode<QString> POI::loadDir(const QString &path)
+int POI::styleIndex(const PointStyle &style)
+{
+	StyleKey key(style.icon().cacheKey(), QPair<qint64, int>(
+	  style.color().isValid() ? (qint64)style.color().rgba() : -1,
+	  style.size()));
+
+	QHash<StyleKey, int>::const_iterator it(_styleIndex.constFind(key));
+	if (it != _styleIndex.constEnd())
+		return *it;
+
+	_styles.append(style);
+	_styleIndex.insert(key, _styles.size() - 1);
+
+	return _styles.size() - 1;
+}
+
+void POI::append(const QVector<Waypoint> &waypoints)
+{
+	QBuffer buffer;
+	QDataStream stream(&buffer);
+
+	if (_coordinates.size() % BLOCK_SIZE) {
+		buffer.setBuffer(&_blocks.last());
+		buffer.open(QIODevice::WriteOnly | QIODevice::Append);
+	}
+
+	for (int i = 0; i < waypoints.size(); i++) {
+		const Waypoint &w = waypoints.at(i);
+		const PointStyle &style = w.style();
+		quint16 flags = 0;
+
+		if (_coordinates.size() % BLOCK_SIZE == 0) {
+			buffer.close();
+			if (!_blocks.isEmpty())
+				_blocks.last().squeeze();
+			_blocks.append(QByteArray());
+			buffer.setBuffer(&_blocks.last());
+			buffer.open(QIODevice::WriteOnly);
+		}
+
+		if (!w.name().isEmpty())
+			flags |= NAME;
+		if (!w.description().isEmpty())
+			flags |= DESCRIPTION;
+		if (!w.comment().isEmpty())
+			flags |= COMMENT;
+		if (!w.address().isEmpty())
+			flags |= ADDRESS;
+		if (!w.phone().isEmpty())
+			flags |= PHONE;
+		if (!w.symbol().isEmpty())
+			flags |= SYMBOL;
+		if (!w.images().isEmpty())
+			flags |= IMAGES;
+		if (!w.links().isEmpty())
+			flags |= LINKS;
+		if (w.timestamp().isValid())
+			flags |= TIMESTAMP;
+		if (w.hasElevation())
+			flags |= ELEVATION;
+		if (!style.icon().isNull() || style.color().isValid()
+		  || style.size() >= 0)
+			flags |= STYLE;
+
+		_coordinates.append(w.coordinates());
+		_offsets.append(buffer.pos());
+
+		stream << flags;
+		if (flags & NAME)
+			stream << w.name().toUtf8();
+		if (flags & DESCRIPTION)
+			stream << w.description().toUtf8();
+		if (flags & COMMENT)
+			stream << w.comment().toUtf8();
+		if (flags & ADDRESS)
+			stream << w.address().toUtf8();
+		if (flags & PHONE)
+			stream << w.phone().toUtf8();
+		if (flags & SYMBOL)
+			stream << w.symbol().toUtf8();
+		if (flags & IMAGES) {
+			stream << (quint32)w.images().size();
+			for (int j = 0; j < w.images().size(); j++)
+				stream << w.images().at(j).toUtf8();
+		}
+		if (flags & LINKS) {
+			stream << (quint32)w.links().size();
+			for (int j = 0; j < w.links().size(); j++)
+				stream << w.links().at(j).URL().toUtf8()
+				  << w.links().at(j).text().toUtf8();
+		}
+		if (flags & TIMESTAMP)
+			stream << w.timestamp();
+		if (flags & ELEVATION)
+			stream << (double)w.elevation();
+		if (flags & STYLE)
+			stream << (quint32)styleIndex(style);
+	}
+
+	buffer.close();
+	if (!_blocks.isEmpty())
+		_blocks.last().squeeze();
+	_coordinates.squeeze();
+	_offsets.squeeze();
+}
+
+static QString string(QDataStream &stream)
+{
+	QByteArray ba;
+	stream >> ba;
+	return QString::fromUtf8(ba);
+}
+
+Waypoint POI::waypoint(int index) const
+{
+	QDataStream stream(_blocks.at(index / BLOCK_SIZE));
+	Waypoint w(_coordinates.at(index));
+	quint16 flags;
+
+	stream.skipRawData(_offsets.at(index));
+	stream >> flags;
+
+	if (flags & NAME)
+		w.setName(string(stream));
+	if (flags & DESCRIPTION)
+		w.setDescription(string(stream));
+	if (flags & COMMENT)
+		w.setComment(string(stream));
+	if (flags & ADDRESS)
+		w.setAddress(string(stream));
+	if (flags & PHONE)
+		w.setPhone(string(stream));
+	if (flags & SYMBOL)
+		w.setSymbol(string(stream));
+	if (flags & IMAGES) {
+		quint32 size;
+		stream >> size;
+		for (quint32 i = 0; i < size; i++)
+			w.addImage(string(stream));
+	}
+	if (flags & LINKS) {
+		quint32 size;
+		stream >> size;
+		for (quint32 i = 0; i < size; i++) {
+			QString url(string(stream));
+			w.addLink(Link(url, string(stream)));
+		}
+	}
+	if (flags & TIMESTAMP) {
+		QDateTime timestamp;
+		stream >> timestamp;
+		w.setTimestamp(timestamp);
+	}
+	if (flags & ELEVATION) {
+		double elevation;
+		stream >> elevation;
+		w.setElevation(elevation);
+	}
+	if (flags & STYLE) {
+		quint32 style;
+		stream >> style;
+		w.setStyle(_styles.at(style));
+	}
+
+	return w;
+}
+
+void POI::dirFiles(const QString &path, QList<DataLoader::File> &files)
+{
+	QDir md(path);
+	md.setFilter(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+	QFileInfoList fl = md.entryInfoList();
+
+	for (int i = 0; i < fl.size(); i++) {
+		const QFileInfo &fi = fl.at(i);
+
+		if (fi.isDir())
+			dirFiles(fi.absoluteFilePath(), files);
+		else
+			files.append(DataLoader::File(fi.absoluteFilePath(), true));
+	}
+}
+
+TreeNode<QString> POI::loadDir(const QString &path,
+  const QHash<QString, const Data*> &data)
 {
 	QDir md(path);
 	md.setFilter(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
@@ -101,11 +380,12 @@ TreeNode<QString> POI::loadDir(const QString &path)
 		const QFileInfo &fi = fl.at(i);
 
 		if (fi.isDir()) {
-			TreeNode<QString> child(loadDir(fi.absoluteFilePath()));
+			TreeNode<QString> child(loadDir(fi.absoluteFilePath(), data));
 			if (!child.isEmpty())
 				tree.addChild(child);
 		} else {
-			if (loadFile(fi.absoluteFilePath()))
+			const Data *d = data.value(fi.absoluteFilePath());
+			if (d && loadData(fi.absoluteFilePath(), *d))
 				tree.addItem(fi.absoluteFilePath());
 			else
 				qWarning("%s: %s", qUtf8Printable(fi.absoluteFilePath()),
@@ -116,22 +396,93 @@ TreeNode<QString> POI::loadDir(const QString &path)
 	return tree;
 }
 
+TreeNode<QString> POI::loadDir(const QString &path)
+{
+	QList<DataLoader::File> files;
+	QHash<QString, const Data*> data;
+
+	/* Parse all the files in parallel first, then add them to the POI tree
+	   in the directory order. */
+	dirFiles(path, files);
+	ThreadPools::blockingMap(ThreadPools::Parse, files,
+	  &DataLoader::File::load);
+	for (int i = 0; i < files.size(); i++)
+		data.insert(files.at(i).fileName(), files.at(i).data());
+
+	TreeNode<QString> tree(loadDir(path, data));
+
+	for (int i = 0; i < files.size(); i++)
+		files[i].clear();
+
+	return tree;
+}
+
 void POI::search(const RectC &rect, QSet<int> &set) const
 {
 	for (ConstIterator it = _files.constBegin(); it != _files.constEnd(); ++it)
 		(*it)->search(rect, set);
 }
 
+void POI::search(const QVector<Coordinates> &points, int start, int end,
+  const RectC &rect, QSet<int> &set) const
+{
+	QSet<int> candidates;
+	QSet<int>::const_iterator it;
+	int first = qMax(start - 1, 0);
+	int last = qMin(end + 1, points.size() - 1);
+
+	search(rect, candidates);
+
+	for (it = candidates.constBegin(); it != candidates.constEnd(); ++it) {
+		if (set.contains(*it))
+			continue;
+
+		const Coordinates &c = _coordinates.at(*it);
+		for (int i = first; i <= qMax(first, last - 1); i++) {
+			if (segmentDistance(c, points.at(i), points.at(qMin(i + 1, last)))
+			  <= _radius) {
+				set.insert(*it);
+				break;
+			}
+		}
+	}
+}
+
+QString POI::state() const
+{
+	QStringList disabled;
+
+	for (ConstIterator it = _files.constBegin(); it != _files.constEnd(); ++it)
+		if (!(*it)->isEnabled())
+			disabled.append(it.key());
+	disabled.sort();
+
+	return QString::number(_revision) + ":" + QString::number(_radius) + ":"
+	  + disabled.join(":");
+}
+
 QList<Waypoint> POI::points(const Path &path) const
 {
 	QList<Waypoint> ret;
 	QSet<int> set;
 	QSet<int>::const_iterator it;
-
-
+	QVector<Coordinates> points;
+	QVector<double> distances;
+
+	PathKey key(pathId(path), state());
+	const QList<Waypoint> *cached = _cache.object(key);
+	if (cached)
+		return *cached;
+
+	/* The path is sampled in (at most) radius steps and the sample point
+	   boxes are merged into corridor boxes of CORRIDOR_LENGTH radiuses that
+	   are queried at once. The candidates are then filtered by their exact
+	   distance to the path. */
 	for (int i = 0; i < path.count(); i++) {
 		const PathSegment &segment = path.at(i);
 
+		points.clear();
+		distances.clear();
 		for (int j = 1; j < segment.size(); j++) {
 			double ds = segment.at(j).distance() - segment.at(j-1).distance();
 			unsigned n = (unsigned)ceil(ds / _radius);
@@ -140,22 +491,41 @@ QList<Waypoint> POI::points(const Path &path) const
 				GreatCircle gc(segment.at(j-1).coordinates(),
 				  segment.at(j).coordinates());
 				for (unsigned k = 0; k < n; k++) {
-					RectC br(gc.pointAt((double)k/n), _radius);
-					search(br, set);
+					points.append(gc.pointAt((double)k/n));
+					distances.append(segment.at(j-1).distance() + (ds * k) / n);
 				}
 			} else {
-				RectC br(segment.at(j-1).coordinates(), _radius);
-				search(br, set);
+				points.append(segment.at(j-1).coordinates());
+				distances.append(segment.at(j-1).distance());
 			}
 		}
-	}
-
-	RectC br(path.last().last().coordinates(), _radius);
-	search(br, set);
+		points.append(segment.last().coordinates());
+		distances.append(segment.last().distance());
+
+		RectC rect;
+		int start = 0;
+		for (int j = 0; j < points.size(); j++) {
+			RectC br(points.at(j), _radius);
+
+			if (j > start && (br.left() > br.right()
+			  || rect.left() > rect.right()
+			  || qAbs(points.at(j).lon() - points.at(j-1).lon()) > 180.0
+			  || distances.at(j) - distances.at(start)
+			  > CORRIDOR_LENGTH * _radius)) {
+				search(points, start, j - 1, rect, set);
+				rect = RectC();
+				start = j;
+			}
 
+			rect |= br;
+		}
+		search(points, start, points.size() - 1, rect, set);
+	}
 
 	for (it = set.constBegin(); it != set.constEnd(); ++it)
-		ret.append(_data.at(*it));
+		ret.append(waypoint(*it));
+
+	_cache.insert(key, new QList<Waypoint>(ret));
 
 	return ret;
 }
@@ -170,7 +540,7 @@ QList<Waypoint> POI::points(const Waypoint &point) const
 	search(br, set);
 
 	for (it = set.constBegin(); it != set.constEnd(); ++it)
-		ret.append(_data.at(*it));
+		ret.append(waypoint(*it));
 
 	return ret;
 }
@@ -186,7 +556,7 @@ QList<Waypoint> POI::points(const RectC &rect) const
 	search(br, set);
 
 	for (it = set.constBegin(); it != set.constEnd(); ++it)
-		ret.append(_data.at(*it));
+		ret.append(waypoint(*it));
 
 	return ret;
 }
@@ -5,12 +5,15 @@
 #include <QPointF>
 #include <QString>
 #include <QStringList>
-#include "common/rtree.h"
+#include <QCache>
+#include "common/packedrtree.h"
 #include "common/treenode.h"
 #include "waypoint.h"
+#include "dataloader.h"
 
 class Path;
 class RectC;
+class Data;
 
 class POI : public QObject
 {
@@ -39,27 +42,53 @@ signals:
 	void pointsChanged();
 
 private:
-	typedef RTree<size_t, qreal, 2> POITree;
+	typedef PackedRTree<size_t, qreal, 2> POITree;
 	class File {
 	public:
-		File(int start, int end, const QVector<Waypoint> &data);
+		File(const QString &path, int start, int end,
+		  const QVector<Coordinates> &data);
 
 		void search(const RectC &rect, QSet<int> &set) const;
 		void enable(bool enable) {_enabled = enable;}
+		bool isEnabled() const {return _enabled;}
 
 	private:
 		bool _enabled;
+		int _start;
 		POITree _tree;
 	};
+	typedef QPair<qint64, QPair<qint64, int> > StyleKey;
 	typedef QHash<QString, File*>::const_iterator ConstIterator;
 	typedef QHash<QString, File*>::iterator Iterator;
+	typedef QPair<QByteArray, QString> PathKey;
 
+	QString state() const;
 	void search(const RectC &rect, QSet<int> &set) const;
-
-	QVector<Waypoint> _data;
+	void search(const QVector<Coordinates> &points, int start, int end,
+	  const RectC &rect, QSet<int> &set) const;
+	bool loadData(const QString &path, const Data &data);
+	void append(const QVector<Waypoint> &waypoints);
+	int styleIndex(const PointStyle &style);
+	Waypoint waypoint(int index) const;
+	void dirFiles(const QString &path, QList<DataLoader::File> &files);
+	TreeNode<QString> loadDir(const QString &path,
+	  const QHash<QString, const Data*> &data);
+
+	/* Compact POI storage - only the coordinates used by the search are kept
+	   as plain values, the rest of the waypoints data is kept serialized in
+	   blocks of BLOCK_SIZE waypoints (with the styles shared in a table) and
+	   the waypoints are decoded only when returned from the points()
+	   queries. */
+	QVector<Coordinates> _coordinates;
+	QVector<int> _offsets;
+	QVector<QByteArray> _blocks;
+	QVector<PointStyle> _styles;
+	QHash<StyleKey, int> _styleIndex;
 	QHash<QString, File*> _files;
 
 	unsigned _radius;
+	unsigned _revision;
+	mutable QCache<PathKey, QList<Waypoint> > _cache;
 
 	QString _errorString;
 	int _errorLine;
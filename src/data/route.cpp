@@ -40,6 +40,8 @@ Graph Route::gpsElevation() const
 		if (_data.at(i).hasElevation())
 			gs.append(GraphPoint(_distance.at(i), NAN, _data.at(i).elevation()));
 
+	if (gs.size() == _distance.size())
+		gs.setAxis(_distance, QVector<qreal>());
 	if (gs.size() >= 2)
 		graph.append(gs);
 
@@ -55,12 +57,19 @@ Graph Route::demElevation(Map *map) const
 	QDateTime date;
 	GraphSegment gs(date);
 
+	MatrixC ll(1, _data.size());
+	for (int i = 0; i < _data.size(); i++)
+		ll.at(i) = _data.at(i).coordinates();
+	MatrixD ele(map->elevation(ll));
+
 	for (int i = 0; i < _data.size(); i++) {
-		qreal dem = map->elevation(_data.at(i).coordinates());
+		qreal dem = ele.at(i);
 		if (!std::isnan(dem))
 			gs.append(GraphPoint(_distance.at(i), NAN, dem));
 	}
 
+	if (gs.size() == _distance.size())
+		gs.setAxis(_distance, QVector<qreal>());
 	if (gs.size() >= 2)
 		graph.append(gs);
 
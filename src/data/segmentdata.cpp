@@ -0,0 +1,200 @@
+#include "segmentdata.h"
+
+const qint64 SegmentData::NO_TIME;
+
+static inline qint64 msecs(const QDateTime &timestamp)
+{
+	return timestamp.isValid()
+	  ? timestamp.toMSecsSinceEpoch() : SegmentData::NO_TIME;
+}
+
+void SegmentData::clear()
+{
+	_coordinates.clear();
+	_time.clear();
+	for (int i = 0; i < FieldCount; i++)
+		_values[i].clear();
+}
+
+void SegmentData::append(const Trackpoint &point)
+{
+	int i = _coordinates.size();
+
+	_coordinates.append(point.coordinates());
+
+	qint64 ms = msecs(point.timestamp());
+	if (!_time.isEmpty())
+		_time.append(ms);
+	else if (ms != NO_TIME) {
+		_time.fill(NO_TIME, i);
+		_time.append(ms);
+	}
+
+	qreal values[FieldCount] = {point.elevation(), point.speed(),
+	  point.heartRate(), point.temperature(), point.cadence(), point.power(),
+	  point.ratio()};
+	for (int j = 0; j < FieldCount; j++) {
+		QVector<qreal> &column = _values[j];
+		if (!column.isEmpty())
+			column.append(values[j]);
+		else if (!std::isnan(values[j])) {
+			column.fill(NAN, i);
+			column.append(values[j]);
+		}
+	}
+}
+
+void SegmentData::append(const SegmentData &other)
+{
+	int size = _coordinates.size();
+	int otherSize = other._coordinates.size();
+
+	_coordinates << other._coordinates;
+
+	if (!other._time.isEmpty()) {
+		if (_time.isEmpty())
+			_time.fill(NO_TIME, size);
+		_time << other._time;
+	} else if (!_time.isEmpty())
+		_time.insert(_time.size(), otherSize, NO_TIME);
+
+	for (int j = 0; j < FieldCount; j++) {
+		QVector<qreal> &column = _values[j];
+		const QVector<qreal> &otherColumn = other._values[j];
+
+		if (!otherColumn.isEmpty()) {
+			if (column.isEmpty())
+				column.fill(NAN, size);
+			column << otherColumn;
+		} else if (!column.isEmpty())
+			column.insert(column.size(), otherSize, NAN);
+	}
+}
+
+Trackpoint SegmentData::at(int i) const
+{
+	Trackpoint t(_coordinates.at(i));
+
+	if (hasTimestamp(i))
+		t.setTimestamp(timestamp(i));
+	t.setElevation(elevation(i));
+	t.setSpeed(speed(i));
+	t.setHeartRate(heartRate(i));
+	t.setTemperature(temperature(i));
+	t.setCadence(cadence(i));
+	t.setPower(power(i));
+	t.setRatio(ratio(i));
+
+	return t;
+}
+
+void SegmentData::set(int i, const Trackpoint &point)
+{
+	_coordinates[i] = point.coordinates();
+	setTimestamp(i, point.timestamp());
+	setValue(Elevation, i, point.elevation());
+	setValue(Speed, i, point.speed());
+	setValue(HeartRate, i, point.heartRate());
+	setValue(Temperature, i, point.temperature());
+	setValue(Cadence, i, point.cadence());
+	setValue(Power, i, point.power());
+	setValue(Ratio, i, point.ratio());
+}
+
+void SegmentData::setTimestamp(int i, const QDateTime &timestamp)
+{
+	qint64 ms = msecs(timestamp);
+
+	if (_time.isEmpty()) {
+		if (ms == NO_TIME)
+			return;
+		_time.fill(NO_TIME, _coordinates.size());
+	}
+
+	_time[i] = ms;
+}
+
+void SegmentData::setValue(Field field, int i, qreal value)
+{
+	QVector<qreal> &column = _values[field];
+
+	if (column.isEmpty()) {
+		if (std::isnan(value))
+			return;
+		column.fill(NAN, _coordinates.size());
+	}
+
+	column[i] = value;
+}
+
+template<class T>
+static void writeColumn(QDataStream &stream, const QVector<T> &column)
+{
+	stream.writeRawData((const char*)column.constData(),
+	  column.size() * sizeof(T));
+}
+
+template<class T>
+static bool readColumn(QDataStream &stream, QVector<T> &column, int size)
+{
+	qint64 len = (qint64)size * sizeof(T);
+
+	if (stream.device()->bytesAvailable() < len) {
+		stream.setStatus(QDataStream::ReadPastEnd);
+		return false;
+	}
+
+	column.resize(size);
+	if (stream.readRawData((char*)column.data(), len) != len) {
+		column.clear();
+		stream.setStatus(QDataStream::ReadPastEnd);
+		return false;
+	}
+
+	return true;
+}
+
+QDataStream &operator<<(QDataStream &stream, const SegmentData &segment)
+{
+	quint32 columns = 0;
+
+	if (!segment._time.isEmpty())
+		columns |= 1;
+	for (int i = 0; i < SegmentData::FieldCount; i++)
+		if (!segment._values[i].isEmpty())
+			columns |= 1U<<(i + 1);
+
+	stream << (qint32)segment._coordinates.size() << columns;
+
+	writeColumn(stream, segment._coordinates);
+	if (!segment._time.isEmpty())
+		writeColumn(stream, segment._time);
+	for (int i = 0; i < SegmentData::FieldCount; i++)
+		if (!segment._values[i].isEmpty())
+			writeColumn(stream, segment._values[i]);
+
+	return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, SegmentData &segment)
+{
+	qint32 size;
+	quint32 columns;
+
+	segment.clear();
+
+	stream >> size >> columns;
+	if (stream.status() != QDataStream::Ok || size < 0)
+		return stream;
+
+	if (!readColumn(stream, segment._coordinates, size))
+		return stream;
+	if ((columns & 1) && !readColumn(stream, segment._time, size))
+		return stream;
+	for (int i = 0; i < SegmentData::FieldCount; i++)
+		if ((columns & (1U<<(i + 1)))
+		  && !readColumn(stream, segment._values[i], size))
+			return stream;
+
+	return stream;
+}
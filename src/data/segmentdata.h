@@ -0,0 +1,158 @@
+#ifndef SEGMENTDATA_H
+#define SEGMENTDATA_H
+
+#include <QVector>
+#include <QDataStream>
+#include <QDateTime>
+#include <QTimeZone>
+#include <limits>
+#include "trackpoint.h"
+
+/* Columnar (structure of arrays) track segment storage. The coordinates are
+   always present, all the other columns are allocated only when the segment
+   contains at least one valid value of the given type and the timestamps are
+   stored as milliseconds since epoch (UTC). */
+class SegmentData
+{
+public:
+	enum Field {
+		Elevation, Speed, HeartRate, Temperature, Cadence, Power, Ratio,
+		FieldCount
+	};
+
+	/* Reference to a segment point, allows the parsers to modify already
+	   appended points the same way as with Trackpoint */
+	class Point
+	{
+	public:
+		const Coordinates &coordinates() const
+		  {return _data->coordinates(_index);}
+		QDateTime timestamp() const {return _data->timestamp(_index);}
+		qreal elevation() const {return _data->elevation(_index);}
+		qreal speed() const {return _data->speed(_index);}
+		qreal heartRate() const {return _data->heartRate(_index);}
+		qreal temperature() const {return _data->temperature(_index);}
+		qreal cadence() const {return _data->cadence(_index);}
+		qreal power() const {return _data->power(_index);}
+		qreal ratio() const {return _data->ratio(_index);}
+
+		bool hasTimestamp() const {return _data->hasTimestamp(_index);}
+		bool hasElevation() const {return _data->hasElevation(_index);}
+		bool hasSpeed() const {return _data->hasSpeed(_index);}
+		bool hasHeartRate() const {return _data->hasHeartRate(_index);}
+		bool hasTemperature() const {return _data->hasTemperature(_index);}
+		bool hasCadence() const {return _data->hasCadence(_index);}
+		bool hasPower() const {return _data->hasPower(_index);}
+		bool hasRatio() const {return _data->hasRatio(_index);}
+
+		void setCoordinates(const Coordinates &coordinates)
+		  {_data->_coordinates[_index] = coordinates;}
+		void setTimestamp(const QDateTime &timestamp)
+		  {_data->setTimestamp(_index, timestamp);}
+		void setElevation(qreal elevation)
+		  {_data->setValue(Elevation, _index, elevation);}
+		void setSpeed(qreal speed) {_data->setValue(Speed, _index, speed);}
+		void setHeartRate(qreal heartRate)
+		  {_data->setValue(HeartRate, _index, heartRate);}
+		void setTemperature(qreal temperature)
+		  {_data->setValue(Temperature, _index, temperature);}
+		void setCadence(qreal cadence)
+		  {_data->setValue(Cadence, _index, cadence);}
+		void setPower(qreal power) {_data->setValue(Power, _index, power);}
+		void setRatio(qreal ratio) {_data->setValue(Ratio, _index, ratio);}
+
+		Point &operator=(const Trackpoint &point)
+		  {_data->set(_index, point); return *this;}
+		operator Trackpoint() const {return _data->at(_index);}
+
+	private:
+		friend class SegmentData;
+
+		Point(SegmentData *data, int index) : _data(data), _index(index) {}
+
+		SegmentData *_data;
+		int _index;
+	};
+
+	SegmentData() {}
+
+	int size() const {return _coordinates.size();}
+	int count() const {return _coordinates.size();}
+	bool isEmpty() const {return _coordinates.isEmpty();}
+	void reserve(int size) {_coordinates.reserve(size);}
+	void clear();
+
+	void append(const Trackpoint &point);
+	void append(const SegmentData &other);
+	SegmentData &operator<<(const SegmentData &other)
+	  {append(other); return *this;}
+	SegmentData &operator<<(const Trackpoint &point)
+	  {append(point); return *this;}
+
+	Trackpoint at(int i) const;
+	Trackpoint first() const {return at(0);}
+	Trackpoint last() const {return at(size() - 1);}
+	Point operator[](int i) {return Point(this, i);}
+	Point first() {return Point(this, 0);}
+	Point last() {return Point(this, size() - 1);}
+	void set(int i, const Trackpoint &point);
+
+	/* Column access */
+	const Coordinates &coordinates(int i) const {return _coordinates.at(i);}
+	const QVector<Coordinates> &coordinates() const {return _coordinates;}
+	qint64 msecs(int i) const
+	  {return _time.isEmpty() ? NO_TIME : _time.at(i);}
+	QDateTime timestamp(int i) const
+	{
+		qint64 ms = msecs(i);
+		return (ms == NO_TIME)
+		  ? QDateTime() : QDateTime::fromMSecsSinceEpoch(ms, QTimeZone::utc());
+	}
+	qreal value(Field field, int i) const
+	  {return _values[field].isEmpty() ? NAN : _values[field].at(i);}
+	qreal elevation(int i) const {return value(Elevation, i);}
+	qreal speed(int i) const {return value(Speed, i);}
+	qreal heartRate(int i) const {return value(HeartRate, i);}
+	qreal temperature(int i) const {return value(Temperature, i);}
+	qreal cadence(int i) const {return value(Cadence, i);}
+	qreal power(int i) const {return value(Power, i);}
+	qreal ratio(int i) const {return value(Ratio, i);}
+
+	bool hasTimestamp(int i) const {return (msecs(i) != NO_TIME);}
+	bool hasValue(Field field, int i) const
+	  {return !std::isnan(value(field, i));}
+	bool hasElevation(int i) const {return hasValue(Elevation, i);}
+	bool hasSpeed(int i) const {return hasValue(Speed, i);}
+	bool hasHeartRate(int i) const {return hasValue(HeartRate, i);}
+	bool hasTemperature(int i) const {return hasValue(Temperature, i);}
+	bool hasCadence(int i) const {return hasValue(Cadence, i);}
+	bool hasPower(int i) const {return hasValue(Power, i);}
+	bool hasRatio(int i) const {return hasValue(Ratio, i);}
+
+	/* Whether the column exists at all (= any point may have the value) */
+	bool hasTimestamps() const {return !_time.isEmpty();}
+	bool hasValues(Field field) const {return !_values[field].isEmpty();}
+
+	void setTimestamp(int i, const QDateTime &timestamp);
+	void setValue(Field field, int i, qreal value);
+
+	static const qint64 NO_TIME = std::numeric_limits<qint64>::min();
+
+private:
+	friend QDataStream &operator<<(QDataStream &stream,
+	  const SegmentData &segment);
+	friend QDataStream &operator>>(QDataStream &stream, SegmentData &segment);
+
+	QVector<Coordinates> _coordinates;
+	QVector<qint64> _time;
+	QVector<qreal> _values[FieldCount];
+};
+
+Q_DECLARE_TYPEINFO(SegmentData, Q_MOVABLE_TYPE);
+
+/* The columns are (de)serialized as raw memory blocks in the native byte
+   order, the format is thus only usable for local data like the data cache */
+QDataStream &operator<<(QDataStream &stream, const SegmentData &segment);
+QDataStream &operator>>(QDataStream &stream, SegmentData &segment);
+
+#endif // SEGMENTDATA_H
@@ -2,8 +2,7 @@
 
 void SLFParser::warning(const char *text) const
 {
-	const QFile *file = static_cast<QFile *>(_reader.device());
-	qWarning("%s:%lld: %s", qUtf8Printable(file->fileName()),
+	qWarning("%s:%lld: %s", qUtf8Printable(fileName(_reader.device())),
 	  _reader.lineNumber(), text);
 }
 
@@ -95,7 +94,7 @@ void SLFParser::activity(TrackData &track)
 	}
 }
 
-bool SLFParser::parse(QFile *file, QList<TrackData> &tracks,
+bool SLFParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons,
   QVector<Waypoint> &waypoints)
 {
@@ -109,7 +108,7 @@ bool SLFParser::parse(QFile *file, QList<TrackData> &tracks,
 	if (_reader.readNextStartElement()) {
 		if (_reader.name() == QLatin1String("Activity")) {
 			tracks.append(TrackData());
-			tracks.last().setFile(file->fileName());
+			tracks.last().setFile(fileName(file));
 			activity(tracks.last());
 		} else
 			_reader.raiseError("Not a SLF file");
@@ -1,5 +1,29 @@
+#include "common/parse.h"
+#include "common/util.h"
+#include "common/xml.h"
 #include "smlparser.h"
 
+namespace SML
+{
+	enum Element {
+		Sml, DeviceLog, Samples, Sample, Latitude, Longitude, UTC, GPSAltitude,
+		SampleType, Cadence, Temperature, HR, BikePower, Speed
+	};
+}
+
+/* Must match the SML::Element order */
+static const char * const ELEMENTS[] = {
+	"sml", "DeviceLog", "Samples", "Sample", "Latitude", "Longitude", "UTC",
+	"GPSAltitude", "SampleType", "Cadence", "Temperature", "HR", "BikePower",
+	"Speed"
+};
+
+static int element(const QXmlStreamReader &reader)
+{
+	static const XML::Names names(ELEMENTS, ARRAY_SIZE(ELEMENTS));
+	return names.id(reader);
+}
+
 
 #ifndef QT_NO_DEBUG
 QDebug operator<<(QDebug dbg, const SMLParser::Sensors &sensors)
@@ -13,75 +37,92 @@ QDebug operator<<(QDebug dbg, const SMLParser::Sensors &sensors)
 #endif // QT_NO_DEBUG
 
 
+bool SMLParser::number(qreal &val)
+{
+	XML::Text text;
+	double d;
+
+	if (!(XML::readText(_reader, text) && Parse::toDouble(text, d)))
+		return false;
+	val = d;
+
+	return true;
+}
+
 void SMLParser::sample(SegmentData &segment, SensorsMap &map)
 {
 	QDateTime timestamp;
 	Sensors sensors;
 	qreal lat = NAN, lon = NAN, altitude = NAN;
-	bool ok, periodic = false;
+	bool periodic = false;
+	XML::Text text;
 
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("Latitude")) {
-			lat = _reader.readElementText().toDouble(&ok);
-			if (!ok || lat < -90 || lat > 90) {
-				_reader.raiseError("Invalid Latitude");
-				return;
-			}
-		} else if (_reader.name() == QLatin1String("Longitude")) {
-			lon = _reader.readElementText().toDouble(&ok);
-			if (!ok || lon < -180 || lon > 180) {
-				_reader.raiseError("Invalid Longitude");
-				return;
-			}
-		} else if (_reader.name() == QLatin1String("UTC")) {
-			timestamp = QDateTime::fromString(_reader.readElementText(),
-			  Qt::ISODate);
-			if (!timestamp.isValid()) {
-				_reader.raiseError("Invalid timestamp");
-				return;
-			}
-		} else if (_reader.name() == QLatin1String("GPSAltitude")) {
-			altitude = _reader.readElementText().toDouble(&ok);
-			if (!ok) {
-				_reader.raiseError("Invalid GPS altitude");
-				return;
-			}
-		} else if (_reader.name() == QLatin1String("SampleType")) {
-			if (_reader.readElementText() == "periodic")
-				periodic = true;
-		} else if (_reader.name() == QLatin1String("Cadence")) {
-			sensors.cadence = _reader.readElementText().toDouble(&ok);
-			if (!ok || sensors.cadence < 0) {
-				_reader.raiseError("Invalid Cadence");
-				return;
-			}
-		} else if (_reader.name() == QLatin1String("Temperature")) {
-			sensors.temperature = _reader.readElementText().toDouble(&ok);
-			// Temperature is in Kelvin units
-			if (!ok || sensors.temperature < 0) {
-				_reader.raiseError("Invalid Temperature");
-				return;
-			}
-		} else if (_reader.name() == QLatin1String("HR")) {
-			sensors.hr = _reader.readElementText().toDouble(&ok);
-			if (!ok || sensors.hr < 0) {
-				_reader.raiseError("Invalid HR");
-				return;
-			}
-		} else if (_reader.name() == QLatin1String("BikePower")) {
-			sensors.power = _reader.readElementText().toDouble(&ok);
-			if (!ok || sensors.power < 0) {
-				_reader.raiseError("Invalid BikePower");
-				return;
-			}
-		} else if (_reader.name() == QLatin1String("Speed")) {
-			sensors.speed = _reader.readElementText().toDouble(&ok);
-			if (!ok || sensors.speed < 0) {
-				_reader.raiseError("Invalid Speed");
-				return;
-			}
-		} else
-			_reader.skipCurrentElement();
+		switch (element(_reader)) {
+			case SML::Latitude:
+				if (!number(lat) || lat < -90 || lat > 90) {
+					_reader.raiseError("Invalid Latitude");
+					return;
+				}
+				break;
+			case SML::Longitude:
+				if (!number(lon) || lon < -180 || lon > 180) {
+					_reader.raiseError("Invalid Longitude");
+					return;
+				}
+				break;
+			case SML::UTC:
+				if (XML::readText(_reader, text))
+					timestamp = Parse::isoDateTime(text);
+				if (!timestamp.isValid()) {
+					_reader.raiseError("Invalid timestamp");
+					return;
+				}
+				break;
+			case SML::GPSAltitude:
+				if (!number(altitude)) {
+					_reader.raiseError("Invalid GPS altitude");
+					return;
+				}
+				break;
+			case SML::SampleType:
+				if (_reader.readElementText() == "periodic")
+					periodic = true;
+				break;
+			case SML::Cadence:
+				if (!number(sensors.cadence) || sensors.cadence < 0) {
+					_reader.raiseError("Invalid Cadence");
+					return;
+				}
+				break;
+			case SML::Temperature:
+				// Temperature is in Kelvin units
+				if (!number(sensors.temperature) || sensors.temperature < 0) {
+					_reader.raiseError("Invalid Temperature");
+					return;
+				}
+				break;
+			case SML::HR:
+				if (!number(sensors.hr) || sensors.hr < 0) {
+					_reader.raiseError("Invalid HR");
+					return;
+				}
+				break;
+			case SML::BikePower:
+				if (!number(sensors.power) || sensors.power < 0) {
+					_reader.raiseError("Invalid BikePower");
+					return;
+				}
+				break;
+			case SML::Speed:
+				if (!number(sensors.speed) || sensors.speed < 0) {
+					_reader.raiseError("Invalid Speed");
+					return;
+				}
+				break;
+			default:
+				_reader.skipCurrentElement();
+		}
 	}
 
 	if (periodic && timestamp.isValid())
@@ -100,14 +141,14 @@ void SMLParser::samples(SegmentData &segment)
 	SensorsMap map;
 
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("Sample")) {
+		if (element(_reader) == SML::Sample)
 			sample(segment, map);
-		} else
+		else
 			_reader.skipCurrentElement();
 	}
 
 	for (int i = 0; i < segment.size(); i++) {
-		Trackpoint &t = segment[i];
+		SegmentData::Point t(segment[i]);
 		SensorsMap::const_iterator it(map.lowerBound(t.timestamp()));
 
 		if (it != map.constEnd()) {
@@ -123,7 +164,7 @@ void SMLParser::samples(SegmentData &segment)
 void SMLParser::deviceLog(TrackData &track)
 {
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("Samples")) {
+		if (element(_reader) == SML::Samples) {
 			track.append(SegmentData());
 			samples(track.last());
 		} else
@@ -134,7 +175,7 @@ void SMLParser::deviceLog(TrackData &track)
 void SMLParser::sml(QList<TrackData> &tracks)
 {
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("DeviceLog")) {
+		if (element(_reader) == SML::DeviceLog) {
 			tracks.append(TrackData());
 			QFile *file = qobject_cast<QFile*>(_reader.device());
 			if (file)
@@ -145,7 +186,7 @@ void SMLParser::sml(QList<TrackData> &tracks)
 	}
 }
 
-bool SMLParser::parse(QFile *file, QList<TrackData> &tracks,
+bool SMLParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons,
   QVector<Waypoint> &waypoints)
 {
@@ -157,7 +198,7 @@ bool SMLParser::parse(QFile *file, QList<TrackData> &tracks,
 	_reader.setDevice(file);
 
 	if (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("sml"))
+		if (element(_reader) == SML::Sml)
 			sml(tracks);
 		else
 			_reader.raiseError("Not a SML file");
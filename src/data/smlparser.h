@@ -9,8 +9,9 @@
 class SMLParser : public Parser
 {
 public:
-	bool parse(QFile *file, QList<TrackData> &tracks, QList<RouteData> &routes,
-	  QList<Area> &polygons, QVector<Waypoint> &waypoints);
+	bool parse(QIODevice *file, QList<TrackData> &tracks,
+	  QList<RouteData> &routes, QList<Area> &polygons,
+	  QVector<Waypoint> &waypoints);
 	QString errorString() const {return _reader.errorString();}
 	int errorLine() const {return _reader.lineNumber();}
 
@@ -29,6 +30,7 @@ private:
 	void deviceLog(TrackData &track);
 	void samples(SegmentData &segment);
 	void sample(SegmentData &segment, SensorsMap &map);
+	bool number(qreal &val);
 
 #ifndef QT_NO_DEBUG
 	friend QDebug operator<<(QDebug dbg, const Sensors &sensors);
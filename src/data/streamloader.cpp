@@ -0,0 +1,153 @@
+#include <QEventLoop>
+#include <QFileInfo>
+#include "common/threadpools.h"
+#include "data.h"
+#include "streamloader.h"
+
+
+#define STREAM_MIN_SIZE (8 * 1024 * 1024)
+#define PREVIEW_SIZE    16384
+
+StreamLoader::StreamLoader(const QString &fileName, QObject *parent)
+  : QObject(parent), _fileName(fileName), _data(0), _previewIndex(0),
+  _previewSize(0), _previewStep(1), _previewChanged(false), _running(0),
+  _canceled(0)
+{
+	connect(&_watcher, &QFutureWatcher<void>::finished, this,
+	  &StreamLoader::finished);
+}
+
+StreamLoader::~StreamLoader()
+{
+	_canceled.storeRelease(1);
+	_future.waitForFinished();
+
+	delete _data;
+}
+
+bool StreamLoader::isStreamable(const QString &fileName)
+{
+	QFileInfo fi(fileName);
+	return (fi.suffix().toLower() == "gpx" && fi.size() >= STREAM_MIN_SIZE);
+}
+
+void StreamLoader::load(StreamLoader *loader)
+{
+	loader->_data = new Data(loader->_fileName, false, loader);
+}
+
+void StreamLoader::run()
+{
+	_running.storeRelease(1);
+	_future = QtConcurrent::run(ThreadPools::pool(ThreadPools::Parse),
+	  &StreamLoader::load, this);
+	_watcher.setFuture(_future);
+}
+
+void StreamLoader::cancel()
+{
+	_canceled.storeRelease(1);
+	emit ready();
+}
+
+void StreamLoader::finished()
+{
+	_running.storeRelease(0);
+	emit ready();
+}
+
+void StreamLoader::decimate(SegmentData &segment)
+{
+	SegmentData decimated;
+
+	decimated.reserve(segment.size() / 2 + 1);
+	for (int i = 0; i < segment.size(); i += 2)
+		decimated.append(Trackpoint(segment.coordinates(i)));
+
+	segment = decimated;
+}
+
+/* Called from the worker thread for every chunk of the parsed segment. Every
+   _previewStep-th point makes it to the preview, the step is doubled (and
+   the preview decimated) whenever the preview exceeds PREVIEW_SIZE. */
+bool StreamLoader::trackpoints(const SegmentData &segment, int from)
+{
+	_lock.lock();
+
+	if (!from)
+		_preview.append(SegmentData());
+	SegmentData &ps = _preview.last();
+	for (int i = from; i < segment.size(); i++, _previewIndex++) {
+		if (!(_previewIndex % _previewStep)) {
+			ps.append(Trackpoint(segment.coordinates(i)));
+			_previewSize++;
+		}
+	}
+
+	if (_previewSize > PREVIEW_SIZE) {
+		_previewSize = 0;
+		for (int i = 0; i < _preview.size(); i++) {
+			decimate(_preview[i]);
+			_previewSize += _preview.at(i).size();
+		}
+		_previewStep *= 2;
+	}
+	_previewChanged = true;
+
+	_lock.unlock();
+
+	emit ready();
+
+	return !_canceled.loadAcquire();
+}
+
+/* Called from the worker thread for every parsed track */
+bool StreamLoader::track(const TrackData &track)
+{
+	Track t(track);
+
+	_lock.lock();
+	_tracks.append(t);
+	_preview.clear();
+	_previewIndex = 0;
+	_previewSize = 0;
+	_previewStep = 1;
+	_previewChanged = false;
+	_lock.unlock();
+
+	emit ready();
+
+	return !_canceled.loadAcquire();
+}
+
+/* Returns the tracks parsed since the last call and the preview of the
+   currently parsed track if it has changed since the last call (an empty
+   preview otherwise). Returns false when the whole file has been parsed
+   (data() is then available) or the loading has been canceled. */
+bool StreamLoader::next(QList<Track> &tracks, TrackData &preview)
+{
+	while (true) {
+		_lock.lock();
+		tracks = _tracks;
+		_tracks.clear();
+		preview = _previewChanged ? _preview : TrackData();
+		_previewChanged = false;
+		_lock.unlock();
+
+		if (!tracks.isEmpty() || !preview.isEmpty() || !_running.loadAcquire()
+		  || _canceled.loadAcquire())
+			break;
+
+		QEventLoop loop;
+		connect(this, &StreamLoader::ready, &loop, &QEventLoop::quit);
+		loop.exec();
+	}
+
+	if (_canceled.loadAcquire()) {
+		tracks.clear();
+		preview.clear();
+		return false;
+	}
+
+	return (!tracks.isEmpty() || !preview.isEmpty());
+}
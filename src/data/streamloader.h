@@ -0,0 +1,65 @@
+#ifndef STREAMLOADER_H
+#define STREAMLOADER_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QFuture>
+#include <QFutureWatcher>
+#include "parser.h"
+#include "track.h"
+
+class Data;
+
+/* Parses a (huge) data file on a worker thread and hands the tracks over
+   as soon as they are parsed, so that the first tracks can be displayed
+   while the rest of the file is still being parsed. The track that is being
+   parsed is available as a preview, decimated to at most PREVIEW_SIZE points
+   to bound its memory and drawing costs. Only the tracks are streamed, all
+   the other data is part of the final data(). */
+class StreamLoader : public QObject, public Parser::Handler
+{
+	Q_OBJECT
+
+public:
+	StreamLoader(const QString &fileName, QObject *parent = 0);
+	~StreamLoader();
+
+	void run();
+	bool next(QList<Track> &tracks, TrackData &preview);
+	const Data *data() const {return _data;}
+
+	bool isCanceled() const {return _canceled.loadAcquire();}
+
+	bool trackpoints(const SegmentData &segment, int from);
+	bool track(const TrackData &track);
+
+	static bool isStreamable(const QString &fileName);
+
+public slots:
+	void cancel();
+
+signals:
+	void ready();
+
+private slots:
+	void finished();
+
+private:
+	static void load(StreamLoader *loader);
+	static void decimate(SegmentData &segment);
+
+	QString _fileName;
+	Data *_data;
+	QList<Track> _tracks;
+	TrackData _preview;
+	int _previewIndex, _previewSize, _previewStep;
+	bool _previewChanged;
+	QMutex _lock;
+	QFutureWatcher<void> _watcher;
+	QFuture<void> _future;
+	QAtomicInt _running, _canceled;
+};
+
+#endif // STREAMLOADER_H
@@ -3,22 +3,24 @@
 
 #include <QPen>
 #include <QBrush>
-#include <QPixmap>
+#include <QImage>
 
 class PointStyle {
 public:
 	PointStyle() : _size(-1) {}
-	PointStyle(const QPixmap &icon, const QColor &color = QColor(), int size = -1)
+	PointStyle(const QImage &icon, const QColor &color = QColor(), int size = -1)
 	  : _icon(icon), _color(color), _size(size) {}
 	PointStyle(const QColor &color, int size = -1)
 	  : _color(color), _size(size) {}
 
 	const QColor &color() const {return _color;}
-	const QPixmap &icon() const {return _icon;}
+	/* The icons are loaded in the parser threads, where no QPixmaps can be
+	   created */
+	const QImage &icon() const {return _icon;}
 	int size() const {return _size;}
 
 private:
-	QPixmap _icon;
+	QImage _icon;
 	QColor _color;
 	int _size;
 };
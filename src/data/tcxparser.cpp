@@ -1,18 +1,48 @@
+#include "common/parse.h"
+#include "common/util.h"
+#include "common/xml.h"
 #include "tcxparser.h"
 
+namespace TCX
+{
+	enum Element {
+		TrainingCenterDatabase, Courses, Activities, Course, Activity,
+		MultiSportSession, FirstSport, NextSport, Lap, Track, Trackpoint,
+		CoursePoint, Name, Notes, Position, LatitudeDegrees, LongitudeDegrees,
+		AltitudeMeters, Time, HeartRateBpm, Value, Cadence, Extensions, TPX,
+		RunCadence, Watts, Speed, PointType
+	};
+}
+
+/* Must match the TCX::Element order */
+static const char * const ELEMENTS[] = {
+	"TrainingCenterDatabase", "Courses", "Activities", "Course", "Activity",
+	"MultiSportSession", "FirstSport", "NextSport", "Lap", "Track",
+	"Trackpoint", "CoursePoint", "Name", "Notes", "Position",
+	"LatitudeDegrees", "LongitudeDegrees", "AltitudeMeters", "Time",
+	"HeartRateBpm", "Value", "Cadence", "Extensions", "TPX", "RunCadence",
+	"Watts", "Speed", "PointType"
+};
+
+static int element(const QXmlStreamReader &reader)
+{
+	static const XML::Names names(ELEMENTS, ARRAY_SIZE(ELEMENTS));
+	return names.id(reader);
+}
+
 
 void TCXParser::warning(const char *text) const
 {
-	const QFile *file = static_cast<QFile *>(_reader.device());
-	qWarning("%s:%lld: %s", qUtf8Printable(file->fileName()),
+	qWarning("%s:%lld: %s", qUtf8Printable(fileName(_reader.device())),
 	  _reader.lineNumber(), text);
 }
 
 qreal TCXParser::number()
 {
-	bool res;
-	qreal ret = _reader.readElementText().toDouble(&res);
-	if (!res)
+	XML::Text text;
+	double ret;
+
+	if (!(XML::readText(_reader, text) && Parse::toDouble(text, ret)))
 		_reader.raiseError(QString("Invalid %1").arg(
 		  _reader.name().toString()));
 
@@ -21,8 +51,11 @@ qreal TCXParser::number()
 
 QDateTime TCXParser::time()
 {
-	QDateTime d = QDateTime::fromString(_reader.readElementText(),
-	  Qt::ISODate);
+	XML::Text text;
+	QDateTime d;
+
+	if (XML::readText(_reader, text))
+		d = Parse::isoDateTime(text);
 	if (!d.isValid())
 		_reader.raiseError(QString("Invalid %1").arg(
 		  _reader.name().toString()));
@@ -33,24 +66,31 @@ QDateTime TCXParser::time()
 Coordinates TCXParser::position()
 {
 	Coordinates pos;
-	qreal val;
+	XML::Text text;
+	double val;
 	bool res;
 
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("LatitudeDegrees")) {
-			val = _reader.readElementText().toDouble(&res);
-			if (!res || (val < -90.0 || val > 90.0))
-				_reader.raiseError("Invalid LatitudeDegrees");
-			else
-				pos.setLat(val);
-		} else if (_reader.name() == QLatin1String("LongitudeDegrees")) {
-			val = _reader.readElementText().toDouble(&res);
-			if (!res || (val < -180.0 || val > 180.0))
-				_reader.raiseError("Invalid LongitudeDegrees");
-			else
-				pos.setLon(val);
-		} else
-			_reader.skipCurrentElement();
+		switch (element(_reader)) {
+			case TCX::LatitudeDegrees:
+				res = XML::readText(_reader, text)
+				  && Parse::toDouble(text, val);
+				if (!res || (val < -90.0 || val > 90.0))
+					_reader.raiseError("Invalid LatitudeDegrees");
+				else
+					pos.setLat(val);
+				break;
+			case TCX::LongitudeDegrees:
+				res = XML::readText(_reader, text)
+				  && Parse::toDouble(text, val);
+				if (!res || (val < -180.0 || val > 180.0))
+					_reader.raiseError("Invalid LongitudeDegrees");
+				else
+					pos.setLon(val);
+				break;
+			default:
+				_reader.skipCurrentElement();
+		}
 	}
 
 	return pos;
@@ -59,7 +99,7 @@ Coordinates TCXParser::position()
 void TCXParser::heartRateBpm(Trackpoint &trackpoint)
 {
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("Value"))
+		if (element(_reader) == TCX::Value)
 			trackpoint.setHeartRate(number());
 		else
 			_reader.skipCurrentElement();
@@ -69,21 +109,26 @@ void TCXParser::heartRateBpm(Trackpoint &trackpoint)
 void TCXParser::TPX(Trackpoint &trackpoint)
 {
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("RunCadence"))
-			trackpoint.setCadence(number());
-		else if (_reader.name() == QLatin1String("Watts"))
-			trackpoint.setPower(number());
-		else if (_reader.name() == QLatin1String("Speed"))
-			trackpoint.setSpeed(number());
-		else
-			_reader.skipCurrentElement();
+		switch (element(_reader)) {
+			case TCX::RunCadence:
+				trackpoint.setCadence(number());
+				break;
+			case TCX::Watts:
+				trackpoint.setPower(number());
+				break;
+			case TCX::Speed:
+				trackpoint.setSpeed(number());
+				break;
+			default:
+				_reader.skipCurrentElement();
+		}
 	}
 }
 
 void TCXParser::extensions(Trackpoint &trackpoint)
 {
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("TPX"))
+		if (element(_reader) == TCX::TPX)
 			TPX(trackpoint);
 		else
 			_reader.skipCurrentElement();
@@ -93,47 +138,63 @@ void TCXParser::extensions(Trackpoint &trackpoint)
 void TCXParser::trackpointData(Trackpoint &trackpoint)
 {
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("Position"))
-			trackpoint.setCoordinates(position());
-		else if (_reader.name() == QLatin1String("AltitudeMeters"))
-			trackpoint.setElevation(number());
-		else if (_reader.name() == QLatin1String("Time"))
-			trackpoint.setTimestamp(time());
-		else if (_reader.name() == QLatin1String("HeartRateBpm"))
-			heartRateBpm(trackpoint);
-		else if (_reader.name() == QLatin1String("Cadence"))
-			trackpoint.setCadence(number());
-		else if (_reader.name() == QLatin1String("Extensions"))
-			extensions(trackpoint);
-		else
-			_reader.skipCurrentElement();
+		switch (element(_reader)) {
+			case TCX::Position:
+				trackpoint.setCoordinates(position());
+				break;
+			case TCX::AltitudeMeters:
+				trackpoint.setElevation(number());
+				break;
+			case TCX::Time:
+				trackpoint.setTimestamp(time());
+				break;
+			case TCX::HeartRateBpm:
+				heartRateBpm(trackpoint);
+				break;
+			case TCX::Cadence:
+				trackpoint.setCadence(number());
+				break;
+			case TCX::Extensions:
+				extensions(trackpoint);
+				break;
+			default:
+				_reader.skipCurrentElement();
+		}
 	}
 }
 
 void TCXParser::waypointData(Waypoint &waypoint)
 {
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("Position"))
-			waypoint.setCoordinates(position());
-		else if (_reader.name() == QLatin1String("Name"))
-			waypoint.setName(_reader.readElementText());
-		else if (_reader.name() == QLatin1String("Notes"))
-			waypoint.setDescription(_reader.readElementText());
-		else if (_reader.name() == QLatin1String("AltitudeMeters"))
-			waypoint.setElevation(number());
-		else if (_reader.name() == QLatin1String("Time"))
-			waypoint.setTimestamp(time());
-		else if (_reader.name() == QLatin1String("PointType"))
-			waypoint.setSymbol(_reader.readElementText());
-		else
-			_reader.skipCurrentElement();
+		switch (element(_reader)) {
+			case TCX::Position:
+				waypoint.setCoordinates(position());
+				break;
+			case TCX::Name:
+				waypoint.setName(_reader.readElementText());
+				break;
+			case TCX::Notes:
+				waypoint.setDescription(_reader.readElementText());
+				break;
+			case TCX::AltitudeMeters:
+				waypoint.setElevation(number());
+				break;
+			case TCX::Time:
+				waypoint.setTimestamp(time());
+				break;
+			case TCX::PointType:
+				waypoint.setSymbol(_reader.readElementText());
+				break;
+			default:
+				_reader.skipCurrentElement();
+		}
 	}
 }
 
 void TCXParser::trackpoints(SegmentData &segment)
 {
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("Trackpoint")) {
+		if (element(_reader) == TCX::Trackpoint) {
 			Trackpoint t;
 			trackpointData(t);
 			if (t.coordinates().isValid())
@@ -148,7 +209,7 @@ void TCXParser::trackpoints(SegmentData &segment)
 void TCXParser::lap(SegmentData &segment)
 {
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("Track"))
+		if (element(_reader) == TCX::Track)
 			trackpoints(segment);
 		else
 			_reader.skipCurrentElement();
@@ -158,14 +219,16 @@ void TCXParser::lap(SegmentData &segment)
 void TCXParser::course(QVector<Waypoint> &waypoints, TrackData &track)
 {
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("Track")) {
+		int id = element(_reader);
+
+		if (id == TCX::Track) {
 			track.append(SegmentData());
 			trackpoints(track.last());
-		} else if (_reader.name() == QLatin1String("Name"))
+		} else if (id == TCX::Name)
 			track.setName(_reader.readElementText());
-		else if (_reader.name() == QLatin1String("Notes"))
+		else if (id == TCX::Notes)
 			track.setDescription(_reader.readElementText());
-		else if (_reader.name() == QLatin1String("CoursePoint")) {
+		else if (id == TCX::CoursePoint) {
 			Waypoint w;
 			waypointData(w);
 			if (w.coordinates().isValid())
@@ -182,19 +245,23 @@ void TCXParser::activity(TrackData &track)
 	track.append(SegmentData());
 
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("Lap"))
-			lap(track.last());
-		else if (_reader.name() == QLatin1String("Notes"))
-			track.setDescription(_reader.readElementText());
-		else
-			_reader.skipCurrentElement();
+		switch (element(_reader)) {
+			case TCX::Lap:
+				lap(track.last());
+				break;
+			case TCX::Notes:
+				track.setDescription(_reader.readElementText());
+				break;
+			default:
+				_reader.skipCurrentElement();
+		}
 	}
 }
 
 void TCXParser::courses(QList<TrackData> &tracks, QVector<Waypoint> &waypoints)
 {
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("Course")) {
+		if (element(_reader) == TCX::Course) {
 			tracks.append(TrackData());
 			QFile *file = qobject_cast<QFile*>(_reader.device());
 			if (file)
@@ -208,7 +275,7 @@ void TCXParser::courses(QList<TrackData> &tracks, QVector<Waypoint> &waypoints)
 void TCXParser::sport(QList<TrackData> &tracks)
 {
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("Activity")) {
+		if (element(_reader) == TCX::Activity) {
 			tracks.append(TrackData());
 			QFile *file = qobject_cast<QFile*>(_reader.device());
 			if (file)
@@ -222,24 +289,29 @@ void TCXParser::sport(QList<TrackData> &tracks)
 void TCXParser::multiSportSession(QList<TrackData> &tracks)
 {
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("FirstSport")
-		  || _reader.name() == QLatin1String("NextSport"))
-			sport(tracks);
-		else
-			_reader.skipCurrentElement();
+		switch (element(_reader)) {
+			case TCX::FirstSport:
+			case TCX::NextSport:
+				sport(tracks);
+				break;
+			default:
+				_reader.skipCurrentElement();
+		}
 	}
 }
 
 void TCXParser::activities(QList<TrackData> &tracks)
 {
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("Activity")) {
+		int id = element(_reader);
+
+		if (id == TCX::Activity) {
 			tracks.append(TrackData());
 			QFile *file = qobject_cast<QFile*>(_reader.device());
 			if (file)
 				tracks.last().setFile(file->fileName());
 			activity(tracks.last());
-		} else if (_reader.name() == QLatin1String("MultiSportSession"))
+		} else if (id == TCX::MultiSportSession)
 			multiSportSession(tracks);
 		else
 			_reader.skipCurrentElement();
@@ -249,16 +321,20 @@ void TCXParser::activities(QList<TrackData> &tracks)
 void TCXParser::tcx(QList<TrackData> &tracks, QVector<Waypoint> &waypoints)
 {
 	while (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("Courses"))
-			courses(tracks, waypoints);
-		else if (_reader.name() == QLatin1String("Activities"))
-			activities(tracks);
-		else
-			_reader.skipCurrentElement();
+		switch (element(_reader)) {
+			case TCX::Courses:
+				courses(tracks, waypoints);
+				break;
+			case TCX::Activities:
+				activities(tracks);
+				break;
+			default:
+				_reader.skipCurrentElement();
+		}
 	}
 }
 
-bool TCXParser::parse(QFile *file, QList<TrackData> &tracks,
+bool TCXParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons,
   QVector<Waypoint> &waypoints)
 {
@@ -269,7 +345,7 @@ bool TCXParser::parse(QFile *file, QList<TrackData> &tracks,
 	_reader.setDevice(file);
 
 	if (_reader.readNextStartElement()) {
-		if (_reader.name() == QLatin1String("TrainingCenterDatabase"))
+		if (element(_reader) == TCX::TrainingCenterDatabase)
 			tcx(tracks, waypoints);
 		else
 			_reader.raiseError("Not a TCX file");
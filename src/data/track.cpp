@@ -7,6 +7,7 @@ int Track::_speedWindow = 5;
 int Track::_heartRateWindow = 3;
 int Track::_cadenceWindow = 3;
 int Track::_powerWindow = 3;
+Track::FilterType Track::_filterType = Track::MovingAverage;
 
 bool Track::_detectPauses = true;
 bool Track::_automaticPause = true;
@@ -20,6 +21,8 @@ bool Track::_show2ndElevation = false;
 bool Track::_show2ndSpeed = false;
 bool Track::_useSegments = true;
 
+unsigned Track::_settings = 1;
+
 static qreal avg(const QVector<qreal> &v)
 {
 	qreal sum = 0;
@@ -30,17 +33,115 @@ static qreal avg(const QVector<qreal> &v)
 	return sum/v.size();
 }
 
-static qreal median(QVector<qreal> &v)
+/*
+   Streaming median estimator (the P-square algorithm by Jain and Chlamtac).
+   Uses constant memory and a single pass over the data instead of copying
+   and sorting the whole data set.
+*/
+class MedianEstimator
 {
-	std::sort(v.begin(), v.end());
-	return v.at(v.size() / 2);
+public:
+	MedianEstimator() : _count(0) {}
+
+	void add(qreal x)
+	{
+		if (std::isnan(x))
+			return;
+
+		if (_count < 5) {
+			_q[_count++] = x;
+			if (_count == 5) {
+				std::sort(_q, _q + 5);
+				for (int i = 0; i < 5; i++) {
+					_n[i] = i;
+					_np[i] = i;
+				}
+			}
+			return;
+		}
+
+		int k;
+		if (x < _q[0]) {
+			_q[0] = x;
+			k = 0;
+		} else if (x >= _q[4]) {
+			_q[4] = x;
+			k = 3;
+		} else {
+			for (k = 0; k < 3; k++)
+				if (x < _q[k+1])
+					break;
+		}
+
+		for (int i = k + 1; i < 5; i++)
+			_n[i]++;
+		for (int i = 0; i < 5; i++)
+			_np[i] += dn(i);
+		_count++;
+
+		for (int i = 1; i < 4; i++) {
+			qreal d = _np[i] - _n[i];
+			if ((d >= 1.0 && _n[i+1] - _n[i] > 1)
+			  || (d <= -1.0 && _n[i-1] - _n[i] < -1)) {
+				int s = (d > 0) ? 1 : -1;
+				qreal q = parabolic(i, s);
+				_q[i] = (_q[i-1] < q && q < _q[i+1]) ? q : linear(i, s);
+				_n[i] += s;
+			}
+		}
+	}
+
+	qreal value() const
+	{
+		if (_count >= 5)
+			return _q[2];
+		else if (!_count)
+			return NAN;
+
+		qreal q[5];
+		std::copy(_q, _q + _count, q);
+		std::sort(q, q + _count);
+		return q[_count / 2];
+	}
+
+private:
+	static qreal dn(int i) {return i * 0.25;}
+
+	qreal parabolic(int i, int d) const
+	{
+		return _q[i] + d / (qreal)(_n[i+1] - _n[i-1])
+		  * ((_n[i] - _n[i-1] + d) * (_q[i+1] - _q[i]) / (_n[i+1] - _n[i])
+		  + (_n[i+1] - _n[i] - d) * (_q[i] - _q[i-1]) / (_n[i] - _n[i-1]));
+	}
+	qreal linear(int i, int d) const
+	{
+		return _q[i] + d * (_q[i+d] - _q[i]) / (_n[i+d] - _n[i]);
+	}
+
+	qreal _q[5];
+	qreal _np[5];
+	int _n[5];
+	int _count;
+};
+
+static qreal median(const QVector<qreal> &v)
+{
+	MedianEstimator m;
+
+	for (int i = 0; i < v.size(); i++)
+		m.add(v.at(i));
+
+	return m.value();
 }
 
-static qreal MAD(QVector<qreal> &v, qreal m)
+static qreal MAD(const QVector<qreal> &v, qreal m)
 {
+	MedianEstimator mad;
+
 	for (int i = 0; i < v.size(); i++)
-		v[i] = qAbs(v.at(i) - m);
-	return median(v);
+		mad.add(qAbs(v.at(i) - m));
+
+	return mad.value();
 }
 
 /*
@@ -53,9 +154,8 @@ static QSet<int> eliminate(const QVector<qreal> &v)
 {
 	QSet<int> rm;
 
-	QVector<qreal> w(v);
-	qreal m = median(w);
-	qreal M = MAD(w, m);
+	qreal m = median(v);
+	qreal M = MAD(v, m);
 
 	for (int i = 0; i < v.size(); i++)
 		if (qAbs((0.6745 * (v.at(i) - m)) / M) > 5.0)
@@ -64,28 +164,107 @@ static QSet<int> eliminate(const QVector<qreal> &v)
 	return rm;
 }
 
-static GraphSegment filter(const GraphSegment &g, int window)
+/*
+   When the graph contains all the segment points, its x axis columns are the
+   segment distance/time vectors, so share them instead of keeping a copy in
+   every graph.
+*/
+void Track::shareAxis(GraphSegment &gs, const Segment &seg)
 {
-	if (g.size() < window || window < 2)
-		return g;
+	if (gs.size() == seg.distance.size())
+		gs.setAxis(seg.distance, gs.t().isEmpty() ? gs.t() : seg.time);
+}
 
+/*
+   All the filters are centered windows of the given (odd) size. The border
+   values, where the window does not fit into the data, are set to the first
+   or last full window value.
+*/
+static void movingAverage(const QVector<qreal> &v, int window,
+  QVector<qreal> &ret)
+{
+	int hw = window/2;
 	qreal acc = 0;
-	GraphSegment ret(g.size(), g.start());
 
 	for (int i = 0; i < window; i++)
-		acc += g.at(i).y();
-	for (int i = 0; i <= window/2; i++)
-		ret[i] = GraphPoint(g.at(i).s(), g.at(i).t(), acc/window);
+		acc += v.at(i);
+	for (int i = 0; i <= hw; i++)
+		ret[i] = acc/window;
 
-	for (int i = window/2 + 1; i < g.size() - window/2; i++) {
-		acc += g.at(i + window/2).y() - g.at(i - (window/2 + 1)).y();
-		ret[i] = GraphPoint(g.at(i).s(), g.at(i).t(), acc/window);
+	for (int i = hw + 1; i < v.size() - hw; i++) {
+		acc += v.at(i + hw) - v.at(i - (hw + 1));
+		ret[i] = acc/window;
 	}
 
-	for (int i = g.size() - window/2; i < g.size(); i++)
-		ret[i] = GraphPoint(g.at(i).s(), g.at(i).t(), acc/window);
+	for (int i = v.size() - hw; i < v.size(); i++)
+		ret[i] = acc/window;
+}
 
-	return ret;
+static void movingMedian(const QVector<qreal> &v, int window,
+  QVector<qreal> &ret)
+{
+	int hw = window/2;
+	QVector<qreal> sorted(v.mid(0, window));
+	std::sort(sorted.begin(), sorted.end());
+
+	for (int i = 0; i <= hw; i++)
+		ret[i] = sorted.at(hw);
+
+	/* The sorted window is updated by removing the oldest and inserting the
+	   newest value using binary search, the memmove of the (small) window is
+	   much cheaper than a full sort for every sample. */
+	for (int i = hw + 1; i < v.size() - hw; i++) {
+		QVector<qreal>::iterator it = std::lower_bound(sorted.begin(),
+		  sorted.end(), v.at(i - (hw + 1)));
+		sorted.erase(it);
+		it = std::lower_bound(sorted.begin(), sorted.end(), v.at(i + hw));
+		sorted.insert(it, v.at(i + hw));
+		ret[i] = sorted.at(hw);
+	}
+
+	for (int i = v.size() - hw; i < v.size(); i++)
+		ret[i] = sorted.at(hw);
+}
+
+/* Gaussian filter approximated by three passes of a moving average filter
+   (central limit theorem) with a combined support of the window size */
+static void movingGaussian(const QVector<qreal> &v, int window,
+  QVector<qreal> &ret)
+{
+	int box = (window + 2) / 3;
+	if (!(box & 1))
+		box++;
+	if (box < 3) {
+		movingAverage(v, window, ret);
+		return;
+	}
+
+	QVector<qreal> tmp(v.size());
+	movingAverage(v, box, ret);
+	movingAverage(ret, box, tmp);
+	movingAverage(tmp, box, ret);
+}
+
+GraphSegment Track::filter(const GraphSegment &g, int window, FilterType type)
+{
+	if (g.size() < window || window < 2)
+		return g;
+
+	const QVector<qreal> &v = g.y();
+	QVector<qreal> f(g.size());
+
+	switch (type) {
+		case Median:
+			movingMedian(v, window, f);
+			break;
+		case Gaussian:
+			movingGaussian(v, window, f);
+			break;
+		default:
+			movingAverage(v, window, f);
+	}
+
+	return GraphSegment(g.s(), g.t(), f, g.start());
 }
 
 
@@ -107,7 +286,7 @@ qreal Track::lastTime(int seg)
 	return 0;
 }
 
-Track::Track(const TrackData &data) : _pause(0)
+Track::Track(const TrackData &data) : _pause(0), _cache(new Cache())
 {
 	qreal ds, dt;
 
@@ -132,25 +311,28 @@ Track::Track(const TrackData &data) : _pause(0)
 
 		Segment &seg = _segments.last();
 
-		seg.start = sd.first().timestamp();
+		seg.start = sd.timestamp(0);
 		seg.distance.append(lastDistance(i));
-		seg.time.append(sd.first().hasTimestamp() ? lastTime(i) : NAN);
-		seg.speed.append(sd.first().hasTimestamp() ? 0 : NAN);
-		acceleration.append(sd.first().hasTimestamp() ? 0 : NAN);
+		seg.time.append(sd.hasTimestamp(0) ? lastTime(i) : NAN);
+		seg.speed.append(sd.hasTimestamp(0) ? 0 : NAN);
+		acceleration.append(sd.hasTimestamp(0) ? 0 : NAN);
 		bool hasTime = !std::isnan(seg.time.first());
 
+		QVector<double> distances(sd.size() - 1);
+		Coordinates::distances(sd.coordinates().constData(), sd.size(),
+		  distances.data());
+
 		for (int j = 1; j < sd.size(); j++) {
-			ds = sd.at(j).coordinates().distanceTo(sd.at(j-1).coordinates());
+			ds = distances.at(j-1);
 			seg.distance.append(seg.distance.last() + ds);
 
-			if (hasTime && sd.at(j).timestamp().isValid()) {
-				if (sd.at(j).timestamp() > sd.at(j-1).timestamp())
-					dt = sd.at(j-1).timestamp().msecsTo(
-					  sd.at(j).timestamp()) / 1000.0;
+			if (hasTime && sd.hasTimestamp(j)) {
+				if (sd.msecs(j) > sd.msecs(j-1))
+					dt = (sd.msecs(j) - sd.msecs(j-1)) / 1000.0;
 				else {
 					qWarning("%s: %s: time skew detected",
 					  qUtf8Printable(_data.name()),
-					  qUtf8Printable(sd.at(j).timestamp().toString(Qt::ISODate)));
+					  qUtf8Printable(sd.timestamp(j).toString(Qt::ISODate)));
 					dt = 0;
 				}
 			} else {
@@ -238,8 +420,8 @@ Track::Track(const TrackData &data) : _pause(0)
 				seg.distance[j] = seg.distance.at(last);
 				seg.speed[j] = 0;
 			} else {
-				ds = sd.at(j).coordinates().distanceTo(
-				  sd.at(last).coordinates());
+				ds = sd.coordinates(j).distanceTo(
+				  sd.coordinates(last));
 				seg.distance[j] = seg.distance.at(last) + ds;
 
 				dt = seg.time.at(j) - seg.time.at(last);
@@ -250,26 +432,77 @@ Track::Track(const TrackData &data) : _pause(0)
 	}
 }
 
-Graph Track::gpsElevation() const
+int Track::append(const SegmentData &points)
+{
+	if (points.isEmpty())
+		return -1;
+
+	if (_data.isEmpty()) {
+		_data.append(SegmentData());
+		_segments.append(Segment());
+	}
+
+	int i = _data.size() - 1;
+	int from = _data.last().size();
+	SegmentData &sd = _data.last();
+	Segment &seg = _segments.last();
+
+	sd.append(points);
+
+	if (!from) {
+		seg.start = sd.timestamp(0);
+		seg.distance.append(lastDistance(i));
+		seg.time.append(sd.hasTimestamp(0) ? lastTime(i) : NAN);
+		seg.speed.append(sd.hasTimestamp(0) ? 0 : NAN);
+	}
+
+	int last = qMax(from - 1, 0);
+	while (last > 0 && seg.outliers.contains(last))
+		last--;
+
+	for (int j = qMax(from, 1); j < sd.size(); j++) {
+		qreal ds = sd.coordinates(j).distanceTo(sd.coordinates(last));
+		qreal dt = (std::isnan(seg.time.at(last)) || !sd.hasTimestamp(j))
+		  ? NAN : qMax(sd.msecs(j) - sd.msecs(last), (qint64)0) / 1000.0;
+
+		seg.distance.append(seg.distance.at(last) + ds);
+		seg.time.append(seg.time.at(last) + dt);
+		if (std::isnan(dt))
+			seg.speed.append(NAN);
+		else
+			seg.speed.append((dt < 1e-3) ? seg.speed.at(last) : ds / dt);
+
+		last = j;
+	}
+
+	/* The track copies keep their (now incomplete) graphs */
+	_cache = QSharedPointer<Cache>(new Cache());
+
+	return from;
+}
+
+Graph Track::computeGPSElevation(int from, const Filter &settings) const
 {
 	Graph ret;
 
-	for (int i = 0; i < _data.size(); i++) {
+	for (int i = firstSegment(from); i < _data.size(); i++) {
 		const SegmentData &sd = _data.at(i);
-		if (sd.size() < 2)
+		if (sd.size() < 2 || !sd.hasValues(SegmentData::Elevation))
 			continue;
 		const Segment &seg = _segments.at(i);
 		GraphSegment gs(seg.start);
 
-		for (int j = 0; j < sd.size(); j++) {
-			if (!sd.at(j).hasElevation() || seg.outliers.contains(j))
+		for (int j = from; j < sd.size(); j++) {
+			if (!sd.hasElevation(j) || seg.outliers.contains(j))
 				continue;
 			gs.append(GraphPoint(seg.distance.at(j), seg.time.at(j),
-			  sd.at(j).elevation()));
+			  sd.elevation(j)));
 		}
 
-		if (gs.size() >= 2)
-			ret.append(filter(gs, _elevationWindow));
+		shareAxis(gs, seg);
+		if (gs.size() >= minPoints(from))
+			ret.append(from ? gs : filter(gs, settings.elevationWindow,
+			  settings.type));
 	}
 
 	if (_data.style().color().isValid())
@@ -278,26 +511,32 @@ Graph Track::gpsElevation() const
 	return ret;
 }
 
-Graph Track::demElevation(Map *map) const
+Graph Track::demElevation(Map *map, int from) const
 {
 	Graph ret;
 
-	for (int i = 0; i < _data.size(); i++) {
+	for (int i = firstSegment(from); i < _data.size(); i++) {
 		const SegmentData &sd = _data.at(i);
 		if (sd.size() < 2)
 			continue;
 		const Segment &seg = _segments.at(i);
 		GraphSegment gs(seg.start);
 
-		for (int j = 0; j < sd.size(); j++) {
-			qreal dem = map->elevation(sd.at(j).coordinates());
+		MatrixC ll(1, sd.size() - from);
+		for (int j = from; j < sd.size(); j++)
+			ll.at(j - from) = sd.coordinates(j);
+		MatrixD ele(map->elevation(ll));
+
+		for (int j = from; j < sd.size(); j++) {
+			qreal dem = ele.at(j - from);
 			if (std::isnan(dem) || seg.outliers.contains(j))
 				continue;
 			gs.append(GraphPoint(seg.distance.at(j), seg.time.at(j), dem));
 		}
 
-		if (gs.size() >= 2)
-			ret.append(filter(gs, _elevationWindow));
+		shareAxis(gs, seg);
+		if (gs.size() >= minPoints(from))
+			ret.append(from ? gs : filter(gs, _elevationWindow, _filterType));
 	}
 
 	if (_data.style().color().isValid())
@@ -306,8 +545,20 @@ Graph Track::demElevation(Map *map) const
 	return ret;
 }
 
-GraphPair Track::elevation(Map *map) const
+GraphPair Track::elevation(Map *map, int from) const
 {
+	/* The appended points must extend the graphs chosen for the whole track,
+	   so the choice can not depend on the (possibly empty) new values */
+	if (from) {
+		bool gps = _data.last().hasValues(SegmentData::Elevation);
+		if (_useDEM || !gps)
+			return GraphPair(demElevation(map, from),
+			  (gps && _show2ndElevation) ? gpsElevation(from) : Graph());
+		else
+			return GraphPair(gpsElevation(from),
+			  _show2ndElevation ? demElevation(map, from) : Graph());
+	}
+
 	if (_useDEM) {
 		Graph dem(demElevation(map));
 		return (dem.isEmpty())
@@ -321,11 +572,11 @@ GraphPair Track::elevation(Map *map) const
 	}
 }
 
-Graph Track::computedSpeed() const
+Graph Track::computeComputedSpeed(int from, const Filter &settings) const
 {
 	Graph ret;
 
-	for (int i = 0; i < _data.size(); i++) {
+	for (int i = firstSegment(from); i < _data.size(); i++) {
 		const SegmentData &sd = _data.at(i);
 		if (sd.size() < 2)
 			continue;
@@ -334,7 +585,7 @@ Graph Track::computedSpeed() const
 		QList<int> stop;
 		qreal v;
 
-		for (int j = 0; j < sd.size(); j++) {
+		for (int j = from; j < sd.size(); j++) {
 			if (seg.stop.contains(j) && !std::isnan(seg.speed.at(j))) {
 				v = 0;
 				stop.append(gs.size());
@@ -346,12 +597,14 @@ Graph Track::computedSpeed() const
 			gs.append(GraphPoint(seg.distance.at(j), seg.time.at(j), v));
 		}
 
-		if (gs.size() >= 2) {
-			ret.append(filter(gs, _speedWindow));
+		shareAxis(gs, seg);
+		if (gs.size() >= minPoints(from)) {
+			ret.append(from ? gs : filter(gs, settings.speedWindow,
+			  settings.type));
 			GraphSegment &filtered = ret.last();
 
 			for (int j = 0; j < stop.size(); j++)
-				filtered[stop.at(j)].setY(0);
+				filtered.setY(stop.at(j), 0);
 		}
 	}
 
@@ -361,37 +614,39 @@ Graph Track::computedSpeed() const
 	return ret;
 }
 
-Graph Track::reportedSpeed() const
+Graph Track::computeReportedSpeed(int from, const Filter &settings) const
 {
 	Graph ret;
 
-	for (int i = 0; i < _data.size(); i++) {
+	for (int i = firstSegment(from); i < _data.size(); i++) {
 		const SegmentData &sd = _data.at(i);
-		if (sd.size() < 2)
+		if (sd.size() < 2 || !sd.hasValues(SegmentData::Speed))
 			continue;
 		const Segment &seg = _segments.at(i);
 		GraphSegment gs(seg.start);
 		QList<int> stop;
 		qreal v;
 
-		for (int j = 0; j < sd.size(); j++) {
-			if (seg.stop.contains(j) && sd.at(j).hasSpeed()) {
+		for (int j = from; j < sd.size(); j++) {
+			if (seg.stop.contains(j) && sd.hasSpeed(j)) {
 				v = 0;
 				stop.append(gs.size());
-			} else if (sd.at(j).hasSpeed() && !seg.outliers.contains(j))
-				v = sd.at(j).speed();
+			} else if (sd.hasSpeed(j) && !seg.outliers.contains(j))
+				v = sd.speed(j);
 			else
 				continue;
 
 			gs.append(GraphPoint(seg.distance.at(j), seg.time.at(j), v));
 		}
 
-		if (gs.size() >= 2) {
-			ret.append(filter(gs, _speedWindow));
+		shareAxis(gs, seg);
+		if (gs.size() >= minPoints(from)) {
+			ret.append(from ? gs : filter(gs, settings.speedWindow,
+			  settings.type));
 			GraphSegment &filtered = ret.last();
 
 			for (int j = 0; j < stop.size(); j++)
-				filtered[stop.at(j)].setY(0);
+				filtered.setY(stop.at(j), 0);
 		}
 	}
 
@@ -401,8 +656,19 @@ Graph Track::reportedSpeed() const
 	return ret;
 }
 
-GraphPair Track::speed() const
+GraphPair Track::speed(int from) const
 {
+	if (from) {
+		bool reported = _data.last().hasValues(SegmentData::Speed);
+		bool computed = !std::isnan(_segments.last().time.last());
+		if (reported && (_useReportedSpeed || !computed))
+			return GraphPair(reportedSpeed(from),
+			  _show2ndSpeed ? computedSpeed(from) : Graph());
+		else
+			return GraphPair(computedSpeed(from),
+			  (reported && _show2ndSpeed) ? reportedSpeed(from) : Graph());
+	}
+
 	if (_useReportedSpeed) {
 		Graph reported(reportedSpeed());
 		return (reported.isEmpty())
@@ -416,24 +682,26 @@ GraphPair Track::speed() const
 	}
 }
 
-Graph Track::heartRate() const
+Graph Track::computeHeartRate(int from, const Filter &settings) const
 {
 	Graph ret;
 
-	for (int i = 0; i < _data.size(); i++) {
+	for (int i = firstSegment(from); i < _data.size(); i++) {
 		const SegmentData &sd = _data.at(i);
-		if (sd.size() < 2)
+		if (sd.size() < 2 || !sd.hasValues(SegmentData::HeartRate))
 			continue;
 		const Segment &seg = _segments.at(i);
 		GraphSegment gs(seg.start);
 
-		for (int j = 0; j < sd.size(); j++)
-			if (sd.at(j).hasHeartRate() && !seg.outliers.contains(j))
+		for (int j = from; j < sd.size(); j++)
+			if (sd.hasHeartRate(j) && !seg.outliers.contains(j))
 				gs.append(GraphPoint(seg.distance.at(j), seg.time.at(j),
-				  sd.at(j).heartRate()));
+				  sd.heartRate(j)));
 
-		if (gs.size() >= 2)
-			ret.append(filter(gs, _heartRateWindow));
+		shareAxis(gs, seg);
+		if (gs.size() >= minPoints(from))
+			ret.append(from ? gs : filter(gs, settings.heartRateWindow,
+			  settings.type));
 	}
 
 	if (_data.style().color().isValid())
@@ -442,24 +710,25 @@ Graph Track::heartRate() const
 	return ret;
 }
 
-Graph Track::temperature() const
+Graph Track::computeTemperature(int from, const Filter &settings) const
 {
 	Graph ret;
 
-	for (int i = 0; i < _data.size(); i++) {
+	for (int i = firstSegment(from); i < _data.size(); i++) {
 		const SegmentData &sd = _data.at(i);
-		if (sd.size() < 2)
+		if (sd.size() < 2 || !sd.hasValues(SegmentData::Temperature))
 			continue;
 		const Segment &seg = _segments.at(i);
 		GraphSegment gs(seg.start);
 
-		for (int j = 0; j < sd.count(); j++) {
-			if (sd.at(j).hasTemperature() && !seg.outliers.contains(j))
+		for (int j = from; j < sd.count(); j++) {
+			if (sd.hasTemperature(j) && !seg.outliers.contains(j))
 				gs.append(GraphPoint(seg.distance.at(j), seg.time.at(j),
-				  sd.at(j).temperature()));
+				  sd.temperature(j)));
 		}
 
-		if (gs.size() >= 2)
+		shareAxis(gs, seg);
+		if (gs.size() >= minPoints(from))
 			ret.append(gs);
 	}
 
@@ -469,23 +738,24 @@ Graph Track::temperature() const
 	return ret;
 }
 
-Graph Track::ratio() const
+Graph Track::computeRatio(int from, const Filter &settings) const
 {
 	Graph ret;
 
-	for (int i = 0; i < _data.size(); i++) {
+	for (int i = firstSegment(from); i < _data.size(); i++) {
 		const SegmentData &sd = _data.at(i);
-		if (sd.size() < 2)
+		if (sd.size() < 2 || !sd.hasValues(SegmentData::Ratio))
 			continue;
 		const Segment &seg = _segments.at(i);
 		GraphSegment gs(seg.start);
 
-		for (int j = 0; j < sd.size(); j++)
-			if (sd.at(j).hasRatio() && !seg.outliers.contains(j))
+		for (int j = from; j < sd.size(); j++)
+			if (sd.hasRatio(j) && !seg.outliers.contains(j))
 				gs.append(GraphPoint(seg.distance.at(j), seg.time.at(j),
-				  sd.at(j).ratio()));
+				  sd.ratio(j)));
 
-		if (gs.size() >= 2)
+		shareAxis(gs, seg);
+		if (gs.size() >= minPoints(from))
 			ret.append(gs);
 	}
 
@@ -495,37 +765,39 @@ Graph Track::ratio() const
 	return ret;
 }
 
-Graph Track::cadence() const
+Graph Track::computeCadence(int from, const Filter &settings) const
 {
 	Graph ret;
 
-	for (int i = 0; i < _data.size(); i++) {
+	for (int i = firstSegment(from); i < _data.size(); i++) {
 		const SegmentData &sd = _data.at(i);
-		if (sd.size() < 2)
+		if (sd.size() < 2 || !sd.hasValues(SegmentData::Cadence))
 			continue;
 		const Segment &seg = _segments.at(i);
 		GraphSegment gs(seg.start);
 		QList<int> stop;
 		qreal c;
 
-		for (int j = 0; j < sd.size(); j++) {
-			if (sd.at(j).hasCadence() && seg.stop.contains(j)) {
+		for (int j = from; j < sd.size(); j++) {
+			if (sd.hasCadence(j) && seg.stop.contains(j)) {
 				c = 0;
 				stop.append(gs.size());
-			} else if (sd.at(j).hasCadence() && !seg.outliers.contains(j))
-				c = sd.at(j).cadence();
+			} else if (sd.hasCadence(j) && !seg.outliers.contains(j))
+				c = sd.cadence(j);
 			else
 				continue;
 
 			gs.append(GraphPoint(seg.distance.at(j), seg.time.at(j), c));
 		}
 
-		if (gs.size() >= 2) {
-			ret.append(filter(gs, _cadenceWindow));
+		shareAxis(gs, seg);
+		if (gs.size() >= minPoints(from)) {
+			ret.append(from ? gs : filter(gs, settings.cadenceWindow,
+			  settings.type));
 			GraphSegment &filtered = ret.last();
 
 			for (int j = 0; j < stop.size(); j++)
-				filtered[stop.at(j)].setY(0);
+				filtered.setY(stop.at(j), 0);
 		}
 	}
 
@@ -535,38 +807,40 @@ Graph Track::cadence() const
 	return ret;
 }
 
-Graph Track::power() const
+Graph Track::computePower(int from, const Filter &settings) const
 {
 	Graph ret;
 	QList<int> stop;
 	qreal p;
 
 
-	for (int i = 0; i < _data.size(); i++) {
+	for (int i = firstSegment(from); i < _data.size(); i++) {
 		const SegmentData &sd = _data.at(i);
-		if (sd.size() < 2)
+		if (sd.size() < 2 || !sd.hasValues(SegmentData::Power))
 			continue;
 		const Segment &seg = _segments.at(i);
 		GraphSegment gs(seg.start);
 
-		for (int j = 0; j < sd.size(); j++) {
-			if (sd.at(j).hasPower() && seg.stop.contains(j)) {
+		for (int j = from; j < sd.size(); j++) {
+			if (sd.hasPower(j) && seg.stop.contains(j)) {
 				p = 0;
 				stop.append(gs.size());
-			} else if (sd.at(j).hasPower() && !seg.outliers.contains(j))
-				p = sd.at(j).power();
+			} else if (sd.hasPower(j) && !seg.outliers.contains(j))
+				p = sd.power(j);
 			else
 				continue;
 
 			gs.append(GraphPoint(seg.distance.at(j), seg.time.at(j), p));
 		}
 
-		if (gs.size() >= 2) {
-			ret.append(filter(gs, _powerWindow));
+		shareAxis(gs, seg);
+		if (gs.size() >= minPoints(from)) {
+			ret.append(from ? gs : filter(gs, settings.powerWindow,
+			  settings.type));
 			GraphSegment &filtered = ret.last();
 
 			for (int j = 0; j < stop.size(); j++)
-				filtered[stop.at(j)].setY(0);
+				filtered.setY(stop.at(j), 0);
 		}
 	}
 
@@ -576,6 +850,140 @@ Graph Track::power() const
 	return ret;
 }
 
+Track::Filter Track::filterSettings()
+{
+	Filter filter;
+
+	filter.id = _settings;
+	filter.elevationWindow = _elevationWindow;
+	filter.speedWindow = _speedWindow;
+	filter.heartRateWindow = _heartRateWindow;
+	filter.cadenceWindow = _cadenceWindow;
+	filter.powerWindow = _powerWindow;
+	filter.type = _filterType;
+
+	return filter;
+}
+
+Track::SeriesFunction Track::seriesFunction(Series series)
+{
+	static const SeriesFunction functions[SeriesCount] = {
+		&Track::computeGPSElevation, &Track::computeReportedSpeed,
+		&Track::computeComputedSpeed, &Track::computeHeartRate,
+		&Track::computeTemperature, &Track::computeCadence,
+		&Track::computePower, &Track::computeRatio
+	};
+
+	return functions[series];
+}
+
+/* Graphs computed with an older snapshot of the filter settings than the
+   cache holds are dropped */
+bool Track::cached(Series series, const Filter &settings, Graph &graph) const
+{
+	QMutexLocker locker(&_cache->lock);
+	Cache &cache = *_cache;
+
+	if (cache.settings != settings.id) {
+		if (cache.settings > settings.id)
+			return false;
+		cache.clear();
+		cache.settings = settings.id;
+	}
+	if (cache.valid[series])
+		graph = cache.graphs[series];
+
+	return cache.valid[series];
+}
+
+void Track::cache(Series series, const Filter &settings, const Graph &graph)
+  const
+{
+	QMutexLocker locker(&_cache->lock);
+	Cache &cache = *_cache;
+
+	if (cache.settings == settings.id) {
+		cache.graphs[series] = graph;
+		cache.valid[series] = true;
+	}
+}
+
+Graph Track::series(Series series) const
+{
+	Filter settings(filterSettings());
+	Graph graph;
+
+	if (!cached(series, settings, graph)) {
+		graph = (this->*seriesFunction(series))(0, settings);
+		cache(series, settings, graph);
+	}
+
+	return graph;
+}
+
+void Track::computeGraphs(const QList<Track> &tracks, int series,
+  const Filter &settings)
+{
+	for (int i = 0; i < tracks.size(); i++) {
+		const Track &track = tracks.at(i);
+
+		for (int j = 0; j < SeriesCount; j++) {
+			Graph graph;
+			if (!(series & (1 << j))
+			  || track.cached((Series)j, settings, graph))
+				continue;
+			graph = (track.*seriesFunction((Series)j))(0, settings);
+			track.cache((Series)j, settings, graph);
+		}
+	}
+}
+
+Graph Track::gpsElevation(int from) const
+{
+	return from ? computeGPSElevation(from, filterSettings())
+	  : series(GPSElevation);
+}
+
+Graph Track::reportedSpeed(int from) const
+{
+	return from ? computeReportedSpeed(from, filterSettings())
+	  : series(ReportedSpeed);
+}
+
+Graph Track::computedSpeed(int from) const
+{
+	return from ? computeComputedSpeed(from, filterSettings())
+	  : series(ComputedSpeed);
+}
+
+Graph Track::heartRate(int from) const
+{
+	return from ? computeHeartRate(from, filterSettings())
+	  : series(HeartRate);
+}
+
+Graph Track::temperature(int from) const
+{
+	return from ? computeTemperature(from, filterSettings())
+	  : series(Temperature);
+}
+
+Graph Track::cadence(int from) const
+{
+	return from ? computeCadence(from, filterSettings())
+	  : series(Cadence);
+}
+
+Graph Track::power(int from) const
+{
+	return from ? computePower(from, filterSettings()) : series(Power);
+}
+
+Graph Track::ratio(int from) const
+{
+	return from ? computeRatio(from, filterSettings()) : series(Ratio);
+}
+
 qreal Track::distance() const
 {
 	for (int i = _segments.size() - 1; i >= 0; i--) {
@@ -613,11 +1021,11 @@ QDateTime Track::date() const
 	  ? _data.first().first().timestamp() : QDateTime();
 }
 
-Path Track::path() const
+Path Track::path(int from) const
 {
 	Path ret;
 
-	for (int i = 0; i < _data.size(); i++) {
+	for (int i = firstSegment(from); i < _data.size(); i++) {
 		const SegmentData &sd = _data.at(i);
 		if (sd.size() < 2)
 			continue;
@@ -625,9 +1033,9 @@ Path Track::path() const
 		ret.append(PathSegment());
 		PathSegment &ps = ret.last();
 
-		for (int j = 0; j < sd.size(); j++)
+		for (int j = from; j < sd.size(); j++)
 			if (!seg.outliers.contains(j) && !discardStopPoint(seg, j))
-				ps.append(PathPoint(sd.at(j).coordinates(),
+				ps.append(PathPoint(sd.coordinates(j),
 				  seg.distance.at(j)));
 	}
 
@@ -5,6 +5,8 @@
 #include <QSet>
 #include <QDateTime>
 #include <QDir>
+#include <QSharedPointer>
+#include <QMutex>
 #include "trackdata.h"
 #include "graph.h"
 #include "path.h"
@@ -14,17 +16,55 @@ class Map;
 class Track
 {
 public:
+	enum FilterType {MovingAverage, Median, Gaussian};
+
 	Track(const TrackData &data);
 
-	Path path() const;
+	/* Appends the points to the last track segment (live data). Only the
+	   distances, times and speeds of the new points are computed, they are
+	   neither checked for outliers nor for pauses. Returns the index of the
+	   first appended point in the last segment. */
+	int append(const SegmentData &points);
+
+	/* With a nonzero from, only the last segment points starting with the
+	   point index from (the points added by append()) are returned and the
+	   graphs are not filtered. */
+	Path path(int from = 0) const;
+
+	GraphPair elevation(Map *map, int from = 0) const;
+	GraphPair speed(int from = 0) const;
+	Graph heartRate(int from = 0) const;
+	Graph temperature(int from = 0) const;
+	Graph cadence(int from = 0) const;
+	Graph power(int from = 0) const;
+	Graph ratio(int from = 0) const;
+
+	/* The (map independent) graph series. The series are computed on the
+	   first use and shared between all the copies of the track, the cache
+	   is invalidated when the filter settings change. */
+	enum Series {
+		GPSElevation, ReportedSpeed, ComputedSpeed, HeartRate, Temperature,
+		Cadence, Power, Ratio, SeriesCount
+	};
+	/* Snapshot of the graph filter settings. The settings are only changed
+	   and snapshotted on the GUI thread, the graphs computed in the
+	   background use the snapshot taken when the computation was started. */
+	struct Filter {
+		unsigned id;
+		int elevationWindow;
+		int speedWindow;
+		int heartRateWindow;
+		int cadenceWindow;
+		int powerWindow;
+		FilterType type;
+	};
+	static Filter filterSettings();
 
-	GraphPair elevation(Map *map) const;
-	GraphPair speed() const;
-	Graph heartRate() const;
-	Graph temperature() const;
-	Graph cadence() const;
-	Graph power() const;
-	Graph ratio() const;
+	/* Computes the series (a mask of 1 << Series) of the tracks that are not
+	   cached yet so the graph getters above return the cached graphs. Can be
+	   run on any thread. */
+	static void computeGraphs(const QList<Track> &tracks, int series,
+	  const Filter &settings);
 
 	qreal distance() const;
 	qreal time() const;
@@ -40,11 +80,16 @@ public:
 
 	bool isValid() const;
 
-	static void setElevationFilter(int window) {_elevationWindow = window;}
-	static void setSpeedFilter(int window) {_speedWindow = window;}
-	static void setHeartRateFilter(int window) {_heartRateWindow = window;}
-	static void setCadenceFilter(int window) {_cadenceWindow = window;}
-	static void setPowerFilter(int window) {_powerWindow = window;}
+	static void setElevationFilter(int window)
+	  {_elevationWindow = window; _settings++;}
+	static void setSpeedFilter(int window) {_speedWindow = window; _settings++;}
+	static void setHeartRateFilter(int window)
+	  {_heartRateWindow = window; _settings++;}
+	static void setCadenceFilter(int window)
+	  {_cadenceWindow = window; _settings++;}
+	static void setPowerFilter(int window) {_powerWindow = window; _settings++;}
+	static void setFilterType(FilterType type)
+	  {_filterType = type; _settings++;}
 	static void detectPauses(bool detect) {_detectPauses = detect;}
 	static void setAutomaticPause(bool set) {_automaticPause = set;}
 	static void setPauseSpeed(qreal speed) {_pauseSpeed = speed;}
@@ -67,18 +112,59 @@ private:
 		QSet<int> stop;
 	};
 
+	typedef Graph (Track::*SeriesFunction)(int, const Filter &) const;
+	/* The graphs may be computed by the GUI thread and a background job at
+	   the same time */
+	struct Cache {
+		Cache() : settings(0) {clear();}
+		void clear()
+		{
+			for (int i = 0; i < SeriesCount; i++) {
+				valid[i] = false;
+				graphs[i] = Graph();
+			}
+		}
+
+		QMutex lock;
+		unsigned settings;
+		bool valid[SeriesCount];
+		Graph graphs[SeriesCount];
+	};
+
 	qreal lastDistance(int seg);
 	qreal lastTime(int seg);
 	bool discardStopPoint(const Segment &seg, int i) const;
+	int firstSegment(int from) const {return from ? _data.size() - 1 : 0;}
+	static int minPoints(int from) {return from ? 1 : 2;}
+	static void shareAxis(GraphSegment &gs, const Segment &seg);
 
-	Graph demElevation(Map *map) const;
-	Graph gpsElevation() const;
-	Graph reportedSpeed() const;
-	Graph computedSpeed() const;
+	static SeriesFunction seriesFunction(Series series);
+	Graph series(Series series) const;
+	bool cached(Series series, const Filter &settings, Graph &graph) const;
+	void cache(Series series, const Filter &settings, const Graph &graph)
+	  const;
+	static GraphSegment filter(const GraphSegment &g, int window,
+	  FilterType type);
+
+	Graph demElevation(Map *map, int from = 0) const;
+	Graph gpsElevation(int from = 0) const;
+	Graph reportedSpeed(int from = 0) const;
+	Graph computedSpeed(int from = 0) const;
+	Graph computeGPSElevation(int from, const Filter &settings) const;
+	Graph computeReportedSpeed(int from, const Filter &settings) const;
+	Graph computeComputedSpeed(int from, const Filter &settings) const;
+	Graph computeHeartRate(int from, const Filter &settings) const;
+	Graph computeTemperature(int from, const Filter &settings) const;
+	Graph computeCadence(int from, const Filter &settings) const;
+	Graph computePower(int from, const Filter &settings) const;
+	Graph computeRatio(int from, const Filter &settings) const;
 
 	TrackData _data;
 	QList<Segment> _segments;
 	qreal _pause;
+	QSharedPointer<Cache> _cache;
+
+	static unsigned _settings;
 
 	static bool _outlierEliminate;
 	static int _elevationWindow;
@@ -86,6 +172,7 @@ private:
 	static int _heartRateWindow;
 	static int _cadenceWindow;
 	static int _powerWindow;
+	static FilterType _filterType;
 	static bool _detectPauses;
 	static bool _automaticPause;
 	static qreal _pauseSpeed;
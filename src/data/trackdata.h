@@ -4,12 +4,10 @@
 #include <QList>
 #include <QVector>
 #include <QString>
-#include "trackpoint.h"
+#include "segmentdata.h"
 #include "link.h"
 #include "style.h"
 
-typedef QVector<Trackpoint> SegmentData;
-
 class TrackData : public QList<SegmentData>
 {
 public:
@@ -63,7 +63,7 @@ static QDateTime timestamp(const QString &dateStr, const QString &timeStr)
 	return QDateTime(date, time);
 }
 
-bool TwoNavParser::parse(QFile *file, QList<TrackData> &tracks,
+bool TwoNavParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons,
   QVector<Waypoint> &waypoints)
 {
@@ -146,7 +146,7 @@ bool TwoNavParser::parse(QFile *file, QList<TrackData> &tracks,
 
 				if (!track) {
 					tracks.append(SegmentData());
-					tracks.last().setFile(file->fileName());
+					tracks.last().setFile(fileName(file));
 					track = true;
 				}
 
@@ -201,7 +201,7 @@ bool TwoNavParser::parse(QFile *file, QList<TrackData> &tracks,
 			case 'R':
 				{QStringList list(codec.toString(line).split(','));
 				routes.append(RouteData());
-				routes.last().setFile(file->fileName());
+				routes.last().setFile(fileName(file));
 				if (list.size() > 1)
 					routes.last().setName(list.at(1));
 				route = true;}
@@ -1,38 +1,44 @@
 #include <QTimeZone>
 #include "common/csv.h"
+#include "common/parse.h"
 #include "txtparser.h"
 
-static Coordinates coordinates(const QByteArrayList &entry)
+static Coordinates coordinates(const CSV &csv)
 {
-	bool lonOk, latOk;
-	double lon = entry.at(3).toDouble(&lonOk);
-	double lat = entry.at(2).toDouble(&latOk);
+	double lon, lat;
 
-	return (lonOk && latOk) ? Coordinates(lon, lat) : Coordinates();
+	return (Parse::toDouble(csv.field(3), lon)
+	  && Parse::toDouble(csv.field(2), lat)) ? Coordinates(lon, lat)
+	  : Coordinates();
 }
 
-bool TXTParser::parse(QFile *file, QList<TrackData> &tracks,
+static qulonglong toULongLong(const CSV::Field &field, bool *ok)
+{
+	return QByteArray::fromRawData(field.constData(), field.size())
+	  .toULongLong(ok);
+}
+
+bool TXTParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons, QVector<Waypoint> &waypoints)
 {
 	Q_UNUSED(routes);
 	Q_UNUSED(polygons);
 	Q_UNUSED(waypoints);
 	CSV csv(file);
-	QByteArrayList entry;
 	SegmentData *sg = 0;
 
 	_errorLine = 1;
 	_errorString.clear();
 
 	while (!csv.atEnd()) {
-		if (!csv.readEntry(entry)) {
+		if (!csv.readEntry()) {
 			_errorString = "CSV parse error";
 			_errorLine = csv.line() - 1;
 			return false;
 		}
 
-		if (entry.size() == 1) {
-			if (entry.at(0) == "$V02") {
+		if (csv.fields() == 1) {
+			if (csv.field(0) == "$V02") {
 				tracks.append(TrackData(SegmentData()));
 				sg = &tracks.last().last();
 			} else {
@@ -47,8 +53,8 @@ bool TXTParser::parse(QFile *file, QList<TrackData> &tracks,
 				return false;
 			}
 
-			if (entry.size() == 13 && entry.at(1) == "A") {
-				Coordinates c(coordinates(entry));
+			if (csv.fields() == 13 && csv.field(1) == "A") {
+				Coordinates c(coordinates(csv));
 				if (!c.isValid()) {
 					_errorString = "Invalid coordinates";
 					_errorLine = csv.line() - 1;
@@ -57,7 +63,7 @@ bool TXTParser::parse(QFile *file, QList<TrackData> &tracks,
 				Trackpoint tp(c);
 
 				bool ok;
-				qulonglong ts = entry.at(0).toULongLong(&ok);
+				qulonglong ts = toULongLong(csv.field(0), &ok);
 				if (!ok) {
 					_errorString = "Invalid timestamp";
 					_errorLine = csv.line() - 1;
@@ -66,7 +72,7 @@ bool TXTParser::parse(QFile *file, QList<TrackData> &tracks,
 				tp.setTimestamp(QDateTime::fromSecsSinceEpoch(ts,
 				  QTimeZone::utc()));
 
-				uint speed = entry.at(5).toULong(&ok);
+				uint speed = toULongLong(csv.field(5), &ok);
 				if (ok)
 					tp.setSpeed(speed * 0.01);
 
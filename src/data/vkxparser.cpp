@@ -1,23 +1,19 @@
+#include <cstring>
+#include <QtEndian>
+#include "common/mappedfile.h"
 #include "vkxparser.h"
 
-static bool readTrackPoint(QDataStream &stream, SegmentData &segment)
+#define TRACKPOINT_SIZE 44
+
+static bool readTrackPoint(const char *data, SegmentData &segment)
 {
-	quint64 time;
-	qint32 lat, lon;
-	quint32 unused;
+	quint64 time = qFromLittleEndian<quint64>(data);
+	qint32 lat = qFromLittleEndian<qint32>(data + 8);
+	qint32 lon = qFromLittleEndian<qint32>(data + 12);
 	float speed, alt;
 
-	stream >> time >> lat >> lon;
-	if (stream.status() != QDataStream::Ok)
-		return false;
-	if (stream.readRawData((char*)&speed, 4) != 4)
-		return false;
-	stream >> unused;
-	if (stream.readRawData((char*)&alt, 4) != 4)
-		return false;
-	stream >> unused >> unused >> unused >> unused;
-	if (stream.status() != QDataStream::Ok)
-		return false;
+	memcpy(&speed, data + 16, sizeof(speed));
+	memcpy(&alt, data + 24, sizeof(alt));
 
 	Trackpoint t(Coordinates(lon / 1e7, lat / 1e7));
 	if (!t.coordinates().isValid())
@@ -31,9 +27,9 @@ static bool readTrackPoint(QDataStream &stream, SegmentData &segment)
 	return true;
 }
 
-bool VKXParser::skip(QDataStream &stream, quint8 key, int len)
+bool VKXParser::skip(MappedFile &file, quint8 key, int len)
 {
-	if (stream.skipRawData(len) != len) {
+	if (!file.data(len)) {
 		_errorString = "Invalid 0x" + QString::number(key, 16) + " row";
 		return false;
 	}
@@ -41,97 +37,95 @@ bool VKXParser::skip(QDataStream &stream, quint8 key, int len)
 	return true;
 }
 
-bool VKXParser::parse(QFile *file, QList<TrackData> &tracks,
+bool VKXParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons, QVector<Waypoint> &waypoints)
 {
 	Q_UNUSED(routes);
 	Q_UNUSED(polygons);
 	Q_UNUSED(waypoints);
 	quint8 key;
-	quint64 hdr;
+	const char *data;
 	SegmentData segment;
 
-	QDataStream stream(file);
-	stream.setByteOrder(QDataStream::LittleEndian);
+	MappedFile mf(file);
 
-	stream >> hdr;
-	if ((hdr & 0xFF) != 0xFF) {
+	data = mf.data(8);
+	if (!data || (quint8)data[0] != 0xFF) {
 		_errorString = "Not a Vakaros VKX file";
 		return false;
 	}
 
-	while (stream.status() == QDataStream::Ok) {
-		stream >> key;
-		if (stream.status() != QDataStream::Ok)
-			break;
+	while ((data = mf.data(1))) {
+		key = (quint8)*data;
 
 		switch (key) {
 			case 0x01:
-				if (!skip(stream, key, 32))
+				if (!skip(mf, key, 32))
 					return false;
 				break;
 			case 0x02:
-				if (!readTrackPoint(stream, segment)) {
+				if (!(data = mf.data(TRACKPOINT_SIZE))
+				  || !readTrackPoint(data, segment)) {
 					_errorString = "Invalid 0x2 row";
 					return false;
 				}
 				break;
 			case 0x03:
-				if (!skip(stream, key, 20))
+				if (!skip(mf, key, 20))
 					return false;
 				break;
 			case 0x04:
-				if (!skip(stream, key, 13))
+				if (!skip(mf, key, 13))
 					return false;
 				break;
 			case 0x05:
-				if (!skip(stream, key, 17))
+				if (!skip(mf, key, 17))
 					return false;
 				break;
 			case 0x06:
-				if (!skip(stream, key, 18))
+				if (!skip(mf, key, 18))
 					return false;
 				break;
 			case 0x07:
-				if (!skip(stream, key, 12))
+				if (!skip(mf, key, 12))
 					return false;
 				break;
 			case 0x08:
-				if (!skip(stream, key, 13))
+				if (!skip(mf, key, 13))
 					return false;
 				break;
 			case 0x0A:
 			case 0x0B:
-				if (!skip(stream, key, 16))
+				if (!skip(mf, key, 16))
 					return false;
 				break;
 			case 0x0C:
-				if (!skip(stream, key, 12))
+				if (!skip(mf, key, 12))
 					return false;
 				break;
 			case 0x0E:
 			case 0x0F:
-				if (!skip(stream, key, 16))
+				if (!skip(mf, key, 16))
 					return false;
 				break;
 			case 0x10:
-				if (!skip(stream, key, 12))
+				if (!skip(mf, key, 12))
 					return false;
 				break;
 			case 0x20:
-				if (!skip(stream, key, 13))
+				if (!skip(mf, key, 13))
 					return false;
 				break;
 			case 0x21:
-				if (!skip(stream, key, 52))
+				if (!skip(mf, key, 52))
 					return false;
 				break;
 			case 0xFE:
-				if (!skip(stream, key, 2))
+				if (!skip(mf, key, 2))
 					return false;
 				break;
 			case 0xFF:
-				if (!skip(stream, key, 7))
+				if (!skip(mf, key, 7))
 					return false;
 				break;
 			default:
@@ -140,13 +134,13 @@ bool VKXParser::parse(QFile *file, QList<TrackData> &tracks,
 		}
 	}
 
-	if (stream.status() != QDataStream::ReadPastEnd) {
+	if (!mf.atEnd()) {
 		_errorString = "Unexpected EOF";
 		return false;
 	}
 
 	tracks.append(segment);
-	tracks.last().setFile(file->fileName());
+	tracks.last().setFile(fileName(file));
 
 	return true;
 }
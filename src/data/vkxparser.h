@@ -3,7 +3,7 @@
 
 #include "parser.h"
 
-class QDataStream;
+class MappedFile;
 
 class VKXParser : public Parser
 {
@@ -13,13 +13,14 @@ public:
 		static_assert(sizeof(float) == 4, "Invalid float size");
 	}
 
-	bool parse(QFile *file, QList<TrackData> &tracks, QList<RouteData> &routes,
-	  QList<Area> &polygons, QVector<Waypoint> &waypoints);
+	bool parse(QIODevice *file, QList<TrackData> &tracks,
+	  QList<RouteData> &routes, QList<Area> &polygons,
+	  QVector<Waypoint> &waypoints);
 	QString errorString() const {return _errorString;}
 	int errorLine() const {return 0;}
 
 private:
-	bool skip(QDataStream &stream, quint8 key, int len);
+	bool skip(MappedFile &file, quint8 key, int len);
 
 	QString _errorString;
 };
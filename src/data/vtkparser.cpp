@@ -165,7 +165,7 @@ static bool record(CTX &ctx, Trackpoint &t)
 	return (ctx.bp == ctx.be);
 }
 
-bool VTKParser::parse(QFile *file, QList<TrackData> &tracks,
+bool VTKParser::parse(QIODevice *file, QList<TrackData> &tracks,
   QList<RouteData> &routes, QList<Area> &polygons, QVector<Waypoint> &waypoints)
 {
 	Q_UNUSED(routes);
@@ -213,7 +213,7 @@ bool VTKParser::parse(QFile *file, QList<TrackData> &tracks,
 	}
 
 	tracks.append(segment);
-	tracks.last().setFile(file->fileName());
+	tracks.last().setFile(fileName(file));
 
 	return true;
 }
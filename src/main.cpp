@@ -2,9 +2,22 @@
 #include <QSurfaceFormat>
 #include "GUI/app.h"
 #include "GUI/timezoneinfo.h"
+#include "GUI/startupprofile.h"
 
 int main(int argc, char *argv[])
 {
+	for (int i = 1; i < argc; i++)
+		if (!qstrcmp(argv[i], "--startup-profile"))
+			StartupProfile::start();
+
+#if !defined(Q_OS_WIN32) && !defined(Q_OS_MAC) && !defined(Q_OS_ANDROID)
+	/* The headless render/server modes must work without a display */
+	for (int i = 1; i < argc; i++)
+		if ((!qstrcmp(argv[i], "--render") || !qstrncmp(argv[i], "--serve", 7))
+		  && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+			qputenv("QT_QPA_PLATFORM", "offscreen");
+#endif // !Q_OS_WIN32 && !Q_OS_MAC && !Q_OS_ANDROID
+
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
 	QApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
 	QApplication::setAttribute(Qt::AA_UseHighDpiPixmaps);
@@ -1,53 +1,53 @@
+#include <QFileInfo>
 #include "atlasdata.h"
 
 using namespace ENC;
 
-bool AtlasData::pointCb(MapEntry *map, void *context)
+MapDataPtr AtlasData::mapData(MapEntry *map, MapCache &cache,
+  QMutex &cacheLock, const Projection &proj)
 {
-	PointCTX *ctx = (PointCTX*)context;
-
+	/* The map entry lock makes the concurrent tiles wait for the map being
+	   loaded, but only the tiles that need the map. The cache lock is held
+	   only for the cache lookup/insert, the map data are kept alive by the
+	   shared pointer even when the map gets evicted from the cache while in
+	   use. */
 	map->lock.lock();
 
-	ctx->cacheLock.lock();
-	MapData *cached = ctx->cache.object(map->path);
-	if (!cached) {
-		ctx->cacheLock.unlock();
+	cacheLock.lock();
+	MapDataPtr *cached = cache.object(map->path);
+	MapDataPtr data(cached ? *cached : MapDataPtr());
+	cacheLock.unlock();
 
-		MapData *data = new MapData(map->path);
-		data->points(ctx->rect, ctx->points);
+	if (!data) {
+		data = MapDataPtr(new MapData(map->path, proj));
+		int cost = qMax(1LL, QFileInfo(map->path).size() / 1024);
 
-		ctx->cacheLock.lock();
-		ctx->cache.insert(map->path, data);
-	} else
-		cached->points(ctx->rect, ctx->points);
+		cacheLock.lock();
+		cache.insert(map->path, new MapDataPtr(data), cost);
+		cacheLock.unlock();
+	}
 
-	ctx->cacheLock.unlock();
 	map->lock.unlock();
 
-	return true;
+	return data;
 }
 
-bool AtlasData::polyCb(MapEntry *map, void *context)
+bool AtlasData::pointCb(MapEntry *map, void *context)
 {
-	PolyCTX *ctx = (PolyCTX*)context;
-
-	map->lock.lock();
+	PointCTX *ctx = (PointCTX*)context;
 
-	ctx->cacheLock.lock();
-	MapData *cached = ctx->cache.object(map->path);
-	if (!cached) {
-		ctx->cacheLock.unlock();
+	mapData(map, ctx->cache, ctx->cacheLock, ctx->proj)->points(ctx->rect,
+	  ctx->points);
 
-		MapData *data = new MapData(map->path);
-		data->polys(ctx->rect, ctx->polygons, ctx->lines);
+	return true;
+}
 
-		ctx->cacheLock.lock();
-		ctx->cache.insert(map->path, data);
-	} else
-		cached->polys(ctx->rect, ctx->polygons, ctx->lines);
+bool AtlasData::polyCb(MapEntry *map, void *context)
+{
+	PolyCTX *ctx = (PolyCTX*)context;
 
-	ctx->cacheLock.unlock();
-	map->lock.unlock();
+	mapData(map, ctx->cache, ctx->cacheLock, ctx->proj)->polys(ctx->rect,
+	  ctx->polygons, ctx->lines);
 
 	return true;
 }
@@ -75,7 +75,7 @@ void AtlasData::polys(const RectC &rect, QList<MapData::Poly> *polygons,
   QList<MapData::Line> *lines)
 {
 	double min[2], max[2];
-	PolyCTX polyCtx(rect, polygons, lines, _cache, _cacheLock);
+	PolyCTX polyCtx(rect, polygons, lines, _cache, _cacheLock, _proj);
 
 	min[0] = rect.left();
 	min[1] = rect.bottom();
@@ -88,7 +88,7 @@ void AtlasData::polys(const RectC &rect, QList<MapData::Poly> *polygons,
 void AtlasData::points(const RectC &rect, QList<MapData::Point> *points)
 {
 	double min[2], max[2];
-	PointCTX pointCtx(rect, points, _cache, _cacheLock);
+	PointCTX pointCtx(rect, points, _cache, _cacheLock, _proj);
 
 	min[0] = rect.left();
 	min[1] = rect.bottom();
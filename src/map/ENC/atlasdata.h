@@ -3,18 +3,22 @@
 
 #include <QCache>
 #include <QMutex>
+#include <QSharedPointer>
 #include "common/rtree.h"
+#include "common/cacheregistry.h"
 #include "mapdata.h"
 
 namespace ENC {
 
-typedef QCache<QString, MapData> MapCache;
+typedef QSharedPointer<MapData> MapDataPtr;
+/* The cost of the cached maps is the map file size in KB */
+typedef StatsCache<QString, MapDataPtr> MapCache;
 
 class AtlasData : public Data
 {
 public:
-	AtlasData(MapCache &cache, QMutex &cacheLock)
-	  : _cache(cache), _cacheLock(cacheLock) {}
+	AtlasData(MapCache &cache, QMutex &cacheLock, const Projection &proj)
+	  : _cache(cache), _cacheLock(cacheLock), _proj(proj) {}
 	virtual ~AtlasData();
 
 	void addMap(const RectC &bounds, const QString &path);
@@ -36,35 +40,42 @@ private:
 	struct PolyCTX
 	{
 		PolyCTX(const RectC &rect,  QList<MapData::Poly> *polygons,
-		  QList<MapData::Line> *lines, MapCache &cache, QMutex &cacheLock)
+		  QList<MapData::Line> *lines, MapCache &cache, QMutex &cacheLock,
+		  const Projection &proj)
 		  : rect(rect), polygons(polygons), lines(lines), cache(cache),
-		  cacheLock(cacheLock) {}
+		  cacheLock(cacheLock), proj(proj) {}
 
 		const RectC &rect;
 		QList<MapData::Poly> *polygons;
 		QList<MapData::Line> *lines;
 		MapCache &cache;
 		QMutex &cacheLock;
+		const Projection &proj;
 	};
 
 	struct PointCTX
 	{
 		PointCTX(const RectC &rect, QList<MapData::Point> *points,
-		  MapCache &cache, QMutex &cacheLock)
-		  : rect(rect), points(points), cache(cache), cacheLock(cacheLock) {}
+		  MapCache &cache, QMutex &cacheLock, const Projection &proj)
+		  : rect(rect), points(points), cache(cache), cacheLock(cacheLock),
+		  proj(proj) {}
 
 		const RectC &rect;
 		QList<MapData::Point> *points;
 		MapCache &cache;
 		QMutex &cacheLock;
+		const Projection &proj;
 	};
 
+	static MapDataPtr mapData(MapEntry *map, MapCache &cache,
+	  QMutex &cacheLock, const Projection &proj);
 	static bool polyCb(MapEntry *map, void *context);
 	static bool pointCb(MapEntry *map, void *context);
 
 	MapTree _tree;
 	MapCache &_cache;
 	QMutex &_cacheLock;
+	const Projection &_proj;
 };
 
 }
@@ -3,6 +3,9 @@
 
 #include "common/rectc.h"
 #include "common/polygon.h"
+#include "map/pointd.h"
+
+class Projection;
 
 namespace ENC {
 
@@ -13,10 +16,14 @@ public:
 
 	class Poly {
 	public:
-		Poly(uint type, const Polygon &path, const Attributes &attr, uint HUNI);
+		Poly(uint type, const Polygon &path, const Attributes &attr, uint HUNI,
+		  const Projection &proj);
 
 		RectC bounds() const {return _path.boundingRect();}
 		const Polygon &path() const {return _path;}
+		/* The path in the map projection, precomputed so that the tiles
+		   do not have to project the path again on every render */
+		const QVector<QVector<PointD> > &projPath() const {return _projPath;}
 		uint type() const {return _type;}
 		const Attributes &attributes() const {return _attr;}
 		uint huni() const {return _huni;}
@@ -26,14 +33,17 @@ public:
 		Polygon _path;
 		Attributes _attr;
 		uint _huni;
+		QVector<QVector<PointD> > _projPath;
 	};
 
 	class Line {
 	public:
-		Line(uint type, const QVector<Coordinates> &path, const Attributes &attr);
+		Line(uint type, const QVector<Coordinates> &path, const Attributes &attr,
+		  const Projection &proj);
 
 		RectC bounds() const;
 		const QVector<Coordinates> &path() const {return _path;}
+		const QVector<PointD> &projPath() const {return _projPath;}
 		uint type() const {return _type;}
 		const QString &label() const {return _label;}
 		const Attributes &attributes() const {return _attr;}
@@ -43,6 +53,7 @@ public:
 		QVector<Coordinates> _path;
 		QString _label;
 		Attributes _attr;
+		QVector<PointD> _projPath;
 	};
 
 	class Point {
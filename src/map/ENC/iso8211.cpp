@@ -1,3 +1,4 @@
+#include <cstring>
 #include <QtEndian>
 #include <QFile>
 #include <QRegularExpression>
@@ -53,6 +54,46 @@ const ISO8211::Field *ISO8211::Record::field(quint32 name) const
 	return 0;
 }
 
+bool ISO8211::seek(qint64 pos)
+{
+	if (_map) {
+		if (pos > _size)
+			return false;
+		_pos = pos;
+		return true;
+	} else
+		return _file.seek(pos);
+}
+
+bool ISO8211::read(char *data, qint64 size)
+{
+	if (_map) {
+		if (_pos + size > _size)
+			return false;
+		memcpy(data, _map + _pos, size);
+		_pos += size;
+		return true;
+	} else
+		return (_file.read(data, size) == size);
+}
+
+const char *ISO8211::fieldData(qint64 pos, qint64 size, QByteArray &buffer)
+{
+	/* The mapped file data are used directly, without a copy */
+	if (_map) {
+		if (pos + size > _size)
+			return 0;
+		_pos = pos + size;
+		return (const char*)_map + pos;
+	}
+
+	buffer.resize(size);
+	if (!(_file.seek(pos) && _file.read(buffer.data(), size) == size))
+		return 0;
+
+	return buffer.constData();
+}
+
 int ISO8211::readDR(QVector<FieldDefinition> &fields)
 {
 	DR ddr;
@@ -61,7 +102,7 @@ int ISO8211::readDR(QVector<FieldDefinition> &fields)
 	char tag[4];
 
 	static_assert(sizeof(ddr) == 24, "Invalid DR alignment");
-	if (_file.read((char*)&ddr, sizeof(ddr)) != sizeof(ddr))
+	if (!read((char*)&ddr, sizeof(ddr)))
 		return -1;
 
 	len = Util::str2int(ddr.RecordLength, sizeof(ddr.RecordLength));
@@ -80,9 +121,8 @@ int ISO8211::readDR(QVector<FieldDefinition> &fields)
 	for (int i = 0; i < fields.size(); i++) {
 		FieldDefinition &r = fields[i];
 
-		if (_file.read(tag, sizeof(tag)) != tagSize
-		  || _file.read(fieldLen.data(), lenSize) != lenSize
-		  || _file.read(fieldPos.data(), posSize) != posSize)
+		if (tagSize != sizeof(tag) || !read(tag, sizeof(tag))
+		  || !read(fieldLen.data(), lenSize) || !read(fieldPos.data(), posSize))
 			return -1;
 
 		r.tag = qFromLittleEndian<quint32>(tag);
@@ -102,15 +142,17 @@ bool ISO8211::readDDA(const FieldDefinition &def, SubFields &fields)
 {
 	static const QRegularExpression re(
 	  "([0-9]*)(A|I|R|B|b11|b12|b14|b21|b22|b24)\\(*([0-9]*)\\)*");
-	QByteArray ba(def.size, Qt::Initialization::Uninitialized);
+	QByteArray buffer;
 	bool repeat = false;
 	QVector<SubFieldDefinition> defs;
 	QVector<quint32> defTags;
 
-	if (!(_file.seek(def.pos) && _file.read(ba.data(), ba.size()) == ba.size()))
+	const char *data = fieldData(def.pos, def.size, buffer);
+	if (!data)
 		return false;
 
-	QList<QByteArray> list(ba.split('\x1f'));
+	QList<QByteArray> list(QByteArray::fromRawData(data, def.size)
+	  .split('\x1f'));
 	if (!list.at(1).isEmpty() && list.at(1).front() == '*') {
 		repeat = true;
 		list[1].remove(0, 1);
@@ -173,6 +215,10 @@ bool ISO8211::readDDR()
 		_errorString = _file.errorString();
 		return false;
 	}
+	/* Use the memory mapped file data if possible, the reads are then just
+	   memory accesses */
+	_size = _file.size();
+	_map = _file.map(0, _size);
 
 	int len = readDR(fields);
 	if (len < 0) {
@@ -187,10 +233,10 @@ bool ISO8211::readDDR()
 			  .arg(NAME(fields.at(i).tag));
 			return false;
 		}
-		_map.insert(fields.at(i).tag, def);
+		_fields.insert(fields.at(i).tag, def);
 	}
 
-	if (_file.pos() != len || fields.size() < 2) {
+	if (pos() != len || fields.size() < 2) {
 		_errorString = "DDR format error";
 		return false;
 	}
@@ -201,15 +247,12 @@ bool ISO8211::readDDR()
 bool ISO8211::readUDA(quint64 pos, const FieldDefinition &def,
   const QVector<SubFieldDefinition> &fields, bool repeat, Data &data)
 {
-	QByteArray ba(def.size, Qt::Initialization::Uninitialized);
-
-	if (!(_file.seek(pos + def.pos)
-	  && _file.read(ba.data(), ba.size()) == ba.size()))
-		return false;
-
+	QByteArray buffer;
 	const char *sp;
-	const char *dp = ba.constData();
-	const char *ep = ba.constData() + ba.size() - 1;
+	const char *dp = fieldData(pos + def.pos, def.size, buffer);
+	if (!dp)
+		return false;
+	const char *ep = dp + def.size - 1;
 
 	do {
 		QVector<QVariant> row(fields.size());
@@ -269,7 +312,7 @@ bool ISO8211::readUDA(quint64 pos, const FieldDefinition &def,
 bool ISO8211::readRecord(Record &record)
 {
 	QVector<FieldDefinition> fields;
-	qint64 pos = _file.pos();
+	qint64 pos = this->pos();
 
 	if (readDR(fields) < 0) {
 		_errorString = "Error reading DR";
@@ -282,8 +325,8 @@ bool ISO8211::readRecord(Record &record)
 		const FieldDefinition &def = fields.at(i);
 		Data data;
 
-		FieldsMap::const_iterator it(_map.find(def.tag));
-		if (it == _map.constEnd()) {
+		FieldsMap::const_iterator it(_fields.find(def.tag));
+		if (it == _fields.constEnd()) {
 			_errorString = QString("%1: unknown record").arg(NAME(def.tag));
 			return false;
 		}
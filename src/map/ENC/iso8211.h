@@ -32,10 +32,10 @@ public:
 		const Field *field(quint32 name) const;
 	};
 
-	ISO8211(const QString &path) : _file(path) {}
+	ISO8211(const QString &path) : _file(path), _map(0), _size(0), _pos(0) {}
 	bool readDDR();
 	bool readRecord(Record &record);
-	bool atEnd() const {return _file.atEnd();}
+	bool atEnd() const {return _map ? (_pos >= _size) : _file.atEnd();}
 	const QString &errorString() const {return _errorString;}
 
 	static constexpr quint32 TAG(const char name[4])
@@ -95,13 +95,20 @@ private:
 
 	static SubFieldDefinition fieldType(const QString &str, int cnt);
 
+	qint64 pos() const {return _map ? _pos : _file.pos();}
+	bool seek(qint64 pos);
+	bool read(char *data, qint64 size);
+	const char *fieldData(qint64 pos, qint64 size, QByteArray &buffer);
+
 	int readDR(QVector<FieldDefinition> &fields);
 	bool readDDA(const FieldDefinition &def, SubFields &fields);
 	bool readUDA(quint64 pos, const FieldDefinition &def,
 	  const QVector<SubFieldDefinition> &fields, bool repeat, Data &data);
 
 	QFile _file;
-	FieldsMap _map;
+	const uchar *_map;
+	qint64 _size, _pos;
+	FieldsMap _fields;
 	QString _errorString;
 };
 
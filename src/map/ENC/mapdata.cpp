@@ -1,5 +1,6 @@
 #include <QtEndian>
 #include "GUI/units.h"
+#include "map/projection.h"
 #include "objects.h"
 #include "attributes.h"
 #include "mapdata.h"
@@ -486,11 +487,27 @@ MapData::Point::Point(uint type, const Coordinates &c, const Attributes &attr,
 	}
 }
 
+static QVector<PointD> projPath(const QVector<Coordinates> &path,
+  const Projection &proj)
+{
+	QVector<PointD> pp(path.size());
+
+	for (int i = 0; i < path.size(); i++)
+		if (!path.at(i).isNull())
+			pp[i] = proj.ll2xy(path.at(i));
+
+	return pp;
+}
+
 MapData::Poly::Poly(uint type, const Polygon &path, const Attributes &attr,
-  uint HUNI) : _path(path), _attr(attr), _huni(HUNI)
+  uint HUNI, const Projection &proj) : _path(path), _attr(attr), _huni(HUNI)
 {
 	uint subtype = 0;
 
+	_projPath.reserve(path.size());
+	for (int i = 0; i < path.size(); i++)
+		_projPath.append(projPath(path.at(i), proj));
+
 	if (type == ACHARE)
 		subtype = CATACH;
 	else if (type == I_ACHARE)
@@ -527,7 +544,8 @@ MapData::Poly::Poly(uint type, const Polygon &path, const Attributes &attr,
 }
 
 MapData::Line::Line(uint type, const QVector<Coordinates> &path,
-  const Attributes &attr) : _path(path), _attr(attr)
+  const Attributes &attr, const Projection &proj)
+  : _path(path), _attr(attr), _projPath(projPath(path, proj))
 {
 	uint subtype = 0;
 
@@ -819,17 +837,20 @@ MapData::Point *MapData::pointObject(const ISO8211::Record &r,
 }
 
 MapData::Line *MapData::lineObject(const ISO8211::Record &r,
-  const RecordMap &vc, const RecordMap &ve, uint comf, uint objl)
+  const RecordMap &vc, const RecordMap &ve, uint comf, uint objl,
+  const Projection &proj)
 {
 	QVector<Coordinates> path(lineGeometry(r, vc, ve, comf));
-	return (path.isEmpty() ? 0 : new Line(objl, path, attributes(r)));
+	return (path.isEmpty() ? 0 : new Line(objl, path, attributes(r), proj));
 }
 
 MapData::Poly *MapData::polyObject(const ISO8211::Record &r,
-  const RecordMap &vc, const RecordMap &ve, uint comf, uint objl, uint huni)
+  const RecordMap &vc, const RecordMap &ve, uint comf, uint objl, uint huni,
+  const Projection &proj)
 {
 	Polygon path(polyGeometry(r, vc, ve, comf));
-	return (path.isEmpty() ? 0 : new Poly(objl, path, attributes(r), huni));
+	return (path.isEmpty() ? 0 : new Poly(objl, path, attributes(r), huni,
+	  proj));
 }
 
 bool MapData::processRecord(const ISO8211::Record &record,
@@ -885,7 +906,7 @@ bool MapData::processRecord(const ISO8211::Record &record,
 	return true;
 }
 
-MapData::MapData(const QString &path)
+MapData::MapData(const QString &path, const Projection &proj)
 {
 	RecordMap vi, vc, ve;
 	QVector<ISO8211::Record> fe;
@@ -937,14 +958,14 @@ MapData::MapData(const QString &path)
 				}
 				break;
 			case PRIM_L:
-				if ((line = lineObject(r, vc, ve, comf, objl))) {
+				if ((line = lineObject(r, vc, ve, comf, objl, proj))) {
 					rectcBounds(line->bounds(), min, max);
 					_lines.Insert(min, max, line);
 				} else
 					warning(frid, prim);
 				break;
 			case PRIM_A:
-				if ((poly = polyObject(r, vc, ve, comf, objl, huni))) {
+				if ((poly = polyObject(r, vc, ve, comf, objl, huni, proj))) {
 					rectcBounds(poly->bounds(), min, max);
 					_areas.Insert(min, max, poly);
 				} else
@@ -952,6 +973,10 @@ MapData::MapData(const QString &path)
 				break;
 		}
 	}
+
+	_points.Pack();
+	_lines.Pack();
+	_areas.Pack();
 }
 
 MapData::~MapData()
@@ -1,7 +1,7 @@
 #ifndef ENC_MAPDATA_H
 #define ENC_MAPDATA_H
 
-#include "common/rtree.h"
+#include "common/packedrtree.h"
 #include "iso8211.h"
 #include "data.h"
 
@@ -10,7 +10,7 @@ namespace ENC {
 class MapData : public Data
 {
 public:
-	MapData(const QString &path);
+	MapData(const QString &path, const Projection &proj);
 	virtual ~MapData();
 
 	virtual void polys(const RectC &rect, QList<Poly> *polygons,
@@ -28,9 +28,9 @@ private:
 
 	typedef QMap<uint, ISO8211::Record> RecordMap;
 	typedef QMap<uint, ISO8211::Record>::const_iterator RecordMapIterator;
-	typedef RTree<const Poly*, double, 2> PolygonTree;
-	typedef RTree<const Line*, double, 2> LineTree;
-	typedef RTree<const Point*, double, 2> PointTree;
+	typedef PackedRTree<const Poly*, double, 2> PolygonTree;
+	typedef PackedRTree<const Line*, double, 2> LineTree;
+	typedef PackedRTree<const Point*, double, 2> PointTree;
 
 	static QVector<Sounding> soundings(const ISO8211::Record &r, uint comf,
 	  uint somf);
@@ -47,9 +47,10 @@ private:
 	static Point *pointObject(const ISO8211::Record &r, const RecordMap &vi,
 	  const RecordMap &vc, uint comf, uint objl, uint huni);
 	static Line *lineObject(const ISO8211::Record &r, const RecordMap &vc,
-	  const RecordMap &ve, uint comf, uint objl);
+	  const RecordMap &ve, uint comf, uint objl, const Projection &proj);
 	static Poly *polyObject(const ISO8211::Record &r, const RecordMap &vc,
-	  const RecordMap &ve, uint comf, uint objl, uint huni);
+	  const RecordMap &ve, uint comf, uint objl, uint huni,
+	  const Projection &proj);
 
 	static bool processRecord(const ISO8211::Record &record,
 	  QVector<ISO8211::Record> &fe, RecordMap &vi, RecordMap &vc, RecordMap &ve,
@@ -1,8 +1,12 @@
 #include <QtMath>
 #include <QPainter>
+#include <QFontMetrics>
+#include "common/trace.h"
 #include "map/bitmapline.h"
 #include "map/textpathitem.h"
 #include "map/textpointitem.h"
+#include "map/textitemlist.h"
+#include "map/textcache.h"
 #include "map/rectd.h"
 #include "objects.h"
 #include "attributes.h"
@@ -15,6 +19,7 @@ using namespace ENC;
 #define TSSLPT_SIZE 24
 #define RANGE_FACTOR 4
 #define MAJOR_RANGE 10
+#define SOUNDING_FLAGS (Qt::AlignCenter | Qt::TextDontClip)
 
 static const float C1 = 0.866025f; /* sqrt(3)/2 */
 static const QColor tsslptPen = QColor(0xeb, 0x49, 0xeb);
@@ -41,20 +46,21 @@ bool RasterTile::showLabel(const QImage *img, int type) const
 	return true;
 }
 
-QPainterPath RasterTile::painterPath(const Polygon &polygon) const
+QPainterPath RasterTile::painterPath(const QVector<QVector<PointD> > &polygon)
+  const
 {
 	QPainterPath path;
 
 	for (int i = 0; i < polygon.size(); i++) {
-		const QVector<Coordinates> &subpath = polygon.at(i);
+		const QVector<PointD> &subpath = polygon.at(i);
 
 		QVector<QPointF> p;
 		p.reserve(subpath.size());
 
 		for (int j = 0; j < subpath.size(); j++) {
-			const Coordinates &c = subpath.at(j);
+			const PointD &c = subpath.at(j);
 			if (!c.isNull())
-				p.append(ll2xy(c));
+				p.append(_transform.proj2img(c));
 		}
 		path.addPolygon(p);
 	}
@@ -62,18 +68,18 @@ QPainterPath RasterTile::painterPath(const Polygon &polygon) const
 	return path;
 }
 
-QPolygonF RasterTile::polyline(const QVector<Coordinates> &path) const
+QPolygonF RasterTile::polyline(const QVector<PointD> &path) const
 {
 	QPolygonF polygon;
 	polygon.reserve(path.size());
 
 	for (int i = 0; i < path.size(); i++)
-		polygon.append(ll2xy(path.at(i)));
+		polygon.append(_transform.proj2img(path.at(i)));
 
 	return polygon;
 }
 
-QVector<QPolygonF> RasterTile::polylineM(const QVector<Coordinates> &path) const
+QVector<QPolygonF> RasterTile::polylineM(const QVector<PointD> &path) const
 {
 	QVector<QPolygonF> polys;
 	QPolygonF polygon;
@@ -82,7 +88,7 @@ QVector<QPolygonF> RasterTile::polylineM(const QVector<Coordinates> &path) const
 	polygon.reserve(path.size());
 
 	for (int i = 0; i < path.size(); i++) {
-		const Coordinates &c = path.at(i);
+		const PointD &c = path.at(i);
 
 		if (c.isNull()) {
 			if (mask)
@@ -93,7 +99,7 @@ QVector<QPolygonF> RasterTile::polylineM(const QVector<Coordinates> &path) const
 				mask = true;
 			}
 		} else if (!mask)
-			polygon.append(ll2xy(c));
+			polygon.append(_transform.proj2img(c));
 	}
 
 	if (!polygon.isEmpty())
@@ -163,13 +169,13 @@ void RasterTile::drawPolygons(QPainter *painter,
 			const Style::Polygon &style = _style->polygon(poly.type());
 
 			if (!style.img().isNull()) {
-				for (int i = 0; i < poly.path().size(); i++)
-					BitmapLine::draw(painter, polylineM(poly.path().at(i)),
+				for (int i = 0; i < poly.projPath().size(); i++)
+					BitmapLine::draw(painter, polylineM(poly.projPath().at(i)),
 					  style.img());
 			} else {
 				if (style.brush() != Qt::NoBrush) {
 					painter->setPen(Qt::NoPen);
-					QPainterPath path(painterPath(poly.path()));
+					QPainterPath path(painterPath(poly.projPath()));
 					if (poly.type() == TYPE(DRGARE)) {
 						painter->setBrush(Qt::white);
 						painter->drawPath(path);
@@ -179,8 +185,9 @@ void RasterTile::drawPolygons(QPainter *painter,
 				}
 				if (style.pen() != Qt::NoPen) {
 					painter->setPen(style.pen());
-					for (int i = 0; i < poly.path().size(); i++) {
-						QVector<QPolygonF> outline(polylineM(poly.path().at(i)));
+					for (int i = 0; i < poly.projPath().size(); i++) {
+						QVector<QPolygonF> outline(polylineM(
+						  poly.projPath().at(i)));
 						for (int j = 0; j < outline.size(); j++)
 							painter->drawPolyline(outline.at(j));
 					}
@@ -199,16 +206,16 @@ void RasterTile::drawLines(QPainter *painter, const QList<Data::Line> &lines) co
 		const Style::Line &style = _style->line(line.type());
 
 		if (!style.img().isNull()) {
-			BitmapLine::draw(painter, polyline(line.path()), style.img());
+			BitmapLine::draw(painter, polyline(line.projPath()), style.img());
 		} else if (style.pen() != Qt::NoPen) {
 			painter->setPen(style.pen());
-			painter->drawPolyline(polyline(line.path()));
+			painter->drawPolyline(polyline(line.projPath()));
 		}
 	}
 }
 
 void RasterTile::drawTextItems(QPainter *painter,
-  const QList<TextItem*> &textItems) const
+  const TextItemList &textItems) const
 {
 	QRectF rect(_rect);
 
@@ -263,7 +270,7 @@ void RasterTile::drawSectorLights(QPainter *painter,
 }
 
 void RasterTile::processPoints(const QList<Data::Point> &points,
-  QList<TextItem*> &textItems, QList<TextItem*> &lightItems,
+  TextItemList &textItems, TextItemList &lightItems,
   QMultiMap<Coordinates, SectorLight> &sectorLights, bool overZoom) const
 {
 	QMap<Coordinates, Style::Color> lights;
@@ -292,9 +299,13 @@ void RasterTile::processPoints(const QList<Data::Point> &points,
 			break;
 	}
 
-	/* Everything else */
+	/* Everything else except the soundings that are sorted last and have
+	   their own layer */
 	for ( ; i < points.size(); i++) {
 		const Data::Point &point = points.at(i);
+		if (point.type()>>16 == SOUNDG)
+			break;
+
 		QPoint pos(ll2xy(point.pos()).toPoint());
 		const Style::Point &style = _style->point(point.type());
 
@@ -329,7 +340,7 @@ void RasterTile::processPoints(const QList<Data::Point> &points,
 }
 
 void RasterTile::processLines(const QList<Data::Line> &lines,
-  QList<TextItem*> &textItems) const
+  TextItemList &textItems) const
 {
 	for (int i = 0; i < lines.size(); i++) {
 		const Data::Line &line = lines.at(i);
@@ -343,7 +354,7 @@ void RasterTile::processLines(const QList<Data::Line> &lines,
 		const QFont *fnt = _style->font(style.textFontSize());
 		const QColor *color = &style.textColor();
 
-		TextPathItem *item = new TextPathItem(polyline(line.path()),
+		TextPathItem *item = new TextPathItem(polyline(line.projPath()),
 		  &line.label(), _rect, fnt, color, 0);
 		if (item->isValid() && !item->collides(textItems))
 			textItems.append(item);
@@ -352,15 +363,148 @@ void RasterTile::processLines(const QList<Data::Line> &lines,
 	}
 }
 
+static inline quint64 cell(const QPointF &pos, const QSizeF &size)
+{
+	return ((quint64)(quint32)(qint32)floor(pos.x() / size.width()) << 32)
+	  | (quint32)(qint32)floor(pos.y() / size.height());
+}
+
+static void cells(const QRectF &rect, const QSizeF &size, QList<quint64> &list)
+{
+	qint32 left = (qint32)floor(rect.left() / size.width());
+	qint32 right = (qint32)floor(rect.right() / size.width());
+	qint32 top = (qint32)floor(rect.top() / size.height());
+	qint32 bottom = (qint32)floor(rect.bottom() / size.height());
+
+	for (qint32 x = left; x <= right; x++)
+		for (qint32 y = top; y <= bottom; y++)
+			list.append(((quint64)(quint32)x << 32) | (quint32)y);
+}
+
+/* Dense hydrographic cells have tens of thousands of soundings per tile, so
+   they are not placed as individual text items. The soundings are first
+   thinned to the shallowest one per label sized grid cell (the grid is in
+   the global image coordinates so the neighbouring tiles make the same
+   choice) and only the remaining ones are checked for collisions. The
+   soundings have the lowest priority of all the labels. */
+void RasterTile::processSoundings(const QList<Data::Point> &points,
+  const TextItemList &textItems, QVector<Sounding> &soundings,
+  bool overZoom) const
+{
+	if (points.isEmpty() || points.last().type()>>16 != SOUNDG)
+		return;
+	if (!overZoom && !showLabel(0, TYPE(SOUNDG)))
+		return;
+
+	const Style::Point &style = _style->point(TYPE(SOUNDG));
+	const QFont *fnt = _style->font(style.textFontSize());
+	if (!fnt)
+		return;
+
+	QFontMetrics fm(*fnt);
+	QSizeF cs(fm.horizontalAdvance("00.0"), fm.height());
+	QHash<quint64, Sounding> thinned;
+
+	for (int i = points.size() - 1; i >= 0; i--) {
+		const Data::Point &point = points.at(i);
+		if (point.type()>>16 != SOUNDG)
+			break;
+
+		Sounding s(ll2xy(point.pos()), point.label().toDouble(),
+		  &point.label());
+		quint64 key(cell(s.pos, cs));
+		QHash<quint64, Sounding>::iterator it(thinned.find(key));
+		if (it == thinned.end())
+			thinned.insert(key, s);
+		else if (s < *it)
+			*it = s;
+	}
+
+	QVector<Sounding> candidates;
+	candidates.reserve(thinned.size());
+	for (QHash<quint64, Sounding>::const_iterator it = thinned.constBegin();
+	  it != thinned.constEnd(); ++it)
+		candidates.append(*it);
+	std::sort(candidates.begin(), candidates.end());
+
+	QHash<QString, QRectF> rects;
+	QHash<quint64, QList<int> > placed;
+
+	for (int i = 0; i < candidates.size(); i++) {
+		Sounding &s = candidates[i];
+
+		QHash<QString, QRectF>::const_iterator rit(rects.constFind(*s.label));
+		if (rit == rects.constEnd()) {
+			QRectF rect(fm.boundingRect(QRect(), SOUNDING_FLAGS, *s.label));
+			rect.adjust(-1, 0, 2, 0);
+			rit = rects.insert(*s.label, rect);
+		}
+		s.rect = *rit;
+		s.rect.moveCenter(s.pos.toPoint());
+
+		if (textItems.collides(s.rect))
+			continue;
+
+		QList<quint64> keys;
+		cells(s.rect, cs, keys);
+		bool collides = false;
+		for (int j = 0; j < keys.size() && !collides; j++) {
+			QHash<quint64, QList<int> >::const_iterator it(placed.constFind(
+			  keys.at(j)));
+			if (it == placed.constEnd())
+				continue;
+			for (int k = 0; k < it->size(); k++) {
+				if (soundings.at(it->at(k)).rect.intersects(s.rect)) {
+					collides = true;
+					break;
+				}
+			}
+		}
+		if (collides)
+			continue;
+
+		for (int j = 0; j < keys.size(); j++)
+			placed[keys.at(j)].append(soundings.size());
+		soundings.append(s);
+	}
+}
+
+/* The shaped sounding labels come from the per thread TextCache, there are
+   only a few hundreds distinct depths in a cell */
+void RasterTile::drawSoundings(QPainter *painter,
+  const QVector<Sounding> &soundings) const
+{
+	if (soundings.isEmpty())
+		return;
+
+	const Style::Point &style = _style->point(TYPE(SOUNDG));
+	const QFont *fnt = _style->font(style.textFontSize());
+	QRectF rect(_rect);
+
+	painter->setPen(style.textColor());
+	for (int i = 0; i < soundings.size(); i++) {
+		const Sounding &s = soundings.at(i);
+		if (!rect.intersects(s.rect))
+			continue;
+
+		QList<QGlyphRun> runs(TextCache::block(*s.label, *fnt,
+		  s.rect.width()));
+		for (int j = 0; j < runs.size(); j++)
+			painter->drawGlyphRun(s.rect.topLeft(), runs.at(j));
+	}
+}
+
 void RasterTile::drawLevels(QPainter *painter, const QList<Level> &levels)
 {
 	for (int i = levels.size() - 1; i >= 0; i--) {
-		QList<TextItem*> textItems, lightItems;
+		TextItemList textItems, lightItems;
 		QMultiMap<Coordinates, SectorLight> sectorLights;
+		QVector<Sounding> soundings;
 		const Level &l = levels.at(i);
 
 		processPoints(l.points, textItems, lightItems, sectorLights, l.overZoom);
 		processLines(l.lines, textItems);
+		processSoundings(l.points, textItems, soundings, l.overZoom);
 
 		drawPolygons(painter, l.polygons);
 		drawLines(painter, l.lines);
@@ -368,6 +512,7 @@ void RasterTile::drawLevels(QPainter *painter, const QList<Level> &levels)
 
 		drawTextItems(painter, lightItems);
 		drawSectorLights(painter, sectorLights);
+		drawSoundings(painter, soundings);
 		drawTextItems(painter, textItems);
 
 		qDeleteAll(textItems);
@@ -382,7 +527,7 @@ QPainterPath RasterTile::shape(const QList<Data::Poly> &polygons) const
 	for (int i = 0; i < polygons.size(); i++) {
 		const Data::Poly &p = polygons.at(i);
 		if (p.type() == SUBTYPE(M_COVR, 1))
-			shp.addPath(painterPath(p.path()));
+			shp.addPath(painterPath(p.projPath()));
 	}
 
 	return shp;
@@ -425,7 +570,13 @@ QList<RasterTile::Level> RasterTile::fetchLevels()
 
 void RasterTile::render()
 {
+	if (cancelled())
+		return;
+
+	TRACE_SCOPE("ENC", "fetchData");
 	QList<Level> levels(fetchLevels());
+	if (cancelled())
+		return;
 
 	QImage img(_rect.width() * _ratio, _rect.height() * _ratio,
 	  QImage::Format_ARGB32_Premultiplied);
@@ -438,6 +589,7 @@ void RasterTile::render()
 	painter.setRenderHint(QPainter::Antialiasing);
 	painter.translate(-_rect.x(), -_rect.y());
 
+	TRACE_NEXT("draw");
 	drawLevels(&painter, levels);
 
 	//painter.setPen(Qt::red);
@@ -445,5 +597,7 @@ void RasterTile::render()
 	//painter.setRenderHint(QPainter::Antialiasing, false);
 	//painter.drawRect(_rect);
 
-	_pixmap.convertFromImage(img);
+	/* Convert the image in place, without an additional copy */
+	painter.end();
+	_pixmap = QPixmap::fromImage(std::move(img));
 }
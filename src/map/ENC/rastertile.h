@@ -2,6 +2,7 @@
 #define ENC_RASTERTILE_H
 
 #include <QPixmap>
+#include <QAtomicInt>
 #include "common/range.h"
 #include "map/projection.h"
 #include "map/transform.h"
@@ -10,6 +11,7 @@
 #include "atlasdata.h"
 
 class TextItem;
+class TextItemList;
 
 namespace ENC {
 
@@ -20,7 +22,8 @@ public:
 	  const Style *style, Data *data, int zoom,
 	  const Range &zoomRange, const QRect &rect, qreal ratio) :
 		_proj(proj), _transform(transform), _style(style),
-		_zoom(zoom), _zoomRange(zoomRange), _rect(rect), _ratio(ratio)
+		_zoom(zoom), _zoomRange(zoomRange), _rect(rect), _ratio(ratio),
+		_cancel(0)
 	{
 		_data.append(data);
 	}
@@ -28,12 +31,14 @@ public:
 	  const Style *style, const QList<Data*> &data, int zoom,
 	  const Range &zoomRange, const QRect &rect, qreal ratio) :
 		_proj(proj), _transform(transform), _style(style), _data(data),
-		_zoom(zoom), _zoomRange(zoomRange), _rect(rect), _ratio(ratio) {}
+		_zoom(zoom), _zoomRange(zoomRange), _rect(rect), _ratio(ratio),
+		_cancel(0) {}
 
 	int zoom() const {return _zoom;}
 	QPoint xy() const {return _rect.topLeft();}
 	const QPixmap &pixmap() const {return _pixmap;}
 
+	void setCancelFlag(const QAtomicInt *cancel) {_cancel = cancel;}
 	void render();
 
 private:
@@ -50,6 +55,26 @@ private:
 		double end;
 	};
 
+	struct Sounding
+	{
+		Sounding() : depth(0), label(0) {}
+		Sounding(const QPointF &pos, double depth, const QString *label)
+		  : pos(pos), depth(depth), label(label) {}
+
+		bool operator<(const Sounding &other) const
+		{
+			return (depth == other.depth)
+			  ? (pos.y() == other.pos.y()
+			    ? pos.x() < other.pos.x() : pos.y() < other.pos.y())
+			  : depth < other.depth;
+		}
+
+		QPointF pos;
+		double depth;
+		const QString *label;
+		QRectF rect;
+	};
+
 	struct Level {
 		QList<Data::Line> lines;
 		QList<Data::Poly> polygons;
@@ -60,24 +85,30 @@ private:
 		  {return lines.isEmpty() && polygons.isEmpty() && points.isEmpty();}
 	};
 
+	bool cancelled() const {return (_cancel && _cancel->loadAcquire());}
 	QPointF ll2xy(const Coordinates &c) const
 	  {return _transform.proj2img(_proj.ll2xy(c));}
-	QPainterPath painterPath(const Polygon &polygon) const;
-	QPolygonF polyline(const QVector<Coordinates> &path) const;
-	QVector<QPolygonF> polylineM(const QVector<Coordinates> &path) const;
+	QPainterPath painterPath(const QVector<QVector<PointD> > &polygon) const;
+	QPolygonF polyline(const QVector<PointD> &path) const;
+	QVector<QPolygonF> polylineM(const QVector<PointD> &path) const;
 	QPolygonF tsslptArrow(const QPointF &p, qreal angle) const;
 	QPointF centroid(const QVector<Coordinates> &polygon) const;
 	void processPoints(const QList<Data::Point> &points,
-	  QList<TextItem*> &textItems, QList<TextItem*> &lightItems,
+	  TextItemList &textItems, TextItemList &lightItems,
 	  QMultiMap<Coordinates, SectorLight> &sectorLights, bool overZoom) const;
 	void processLines(const QList<Data::Line> &lines,
-	  QList<TextItem*> &textItems) const;
+	  TextItemList &textItems) const;
+	void processSoundings(const QList<Data::Point> &points,
+	  const TextItemList &textItems, QVector<Sounding> &soundings,
+	  bool overZoom) const;
 	void drawArrows(QPainter *painter, const QList<Data::Point> &points) const;
 	void drawPolygons(QPainter *painter, const QList<Data::Poly> &polygons) const;
 	void drawLines(QPainter *painter, const QList<Data::Line> &lines) const;
-	void drawTextItems(QPainter *painter, const QList<TextItem*> &textItems) const;
+	void drawTextItems(QPainter *painter, const TextItemList &textItems) const;
 	void drawSectorLights(QPainter *painter,
 	  const QMultiMap<Coordinates, SectorLight> &lights) const;
+	void drawSoundings(QPainter *painter,
+	  const QVector<Sounding> &soundings) const;
 	bool showLabel(const QImage *img, int type) const;
 	void drawLevels(QPainter *painter, const QList<Level> &levels);
 	QList<Level> fetchLevels();
@@ -91,6 +122,7 @@ private:
 	Range _zoomRange;
 	QRect _rect;
 	qreal _ratio;
+	const QAtomicInt *_cancel;
 	QPixmap _pixmap;
 };
 
@@ -1,7 +1,7 @@
 #ifndef IMG_DEMTREE_H
 #define IMG_DEMTREE_H
 
-#include "common/rtree.h"
+#include "common/packedrtree.h"
 #include "map/matrix.h"
 #include "mapdata.h"
 
@@ -15,7 +15,7 @@ public:
 	MatrixD elevation(const MatrixC &m) const;
 
 private:
-	typedef RTree<const MapData::Elevation*, double, 2> Tree;
+	typedef PackedRTree<const MapData::Elevation*, double, 2> Tree;
 
 	struct ElevationCTX {
 		ElevationCTX(const Tree &tree, const Coordinates &c, double &ele)
@@ -1,6 +1,8 @@
 #include <QXmlStreamReader>
 #include <QDir>
+#include <QDateTime>
 #include "vectortile.h"
+#include "tileindex.h"
 #include "gmapdata.h"
 
 using namespace IMG;
@@ -78,9 +80,11 @@ bool GMAPData::readXML(const QString &path, QString &dataDir, QString &typFile)
 	return true;
 }
 
-bool GMAPData::loadTile(const QDir &dir)
+bool GMAPData::loadTile(const QDir &dir, QDataStream &index)
 {
 	VectorTile *tile = new VectorTile();
+	QStringList files;
+	QList<qint32> types;
 
 	QFileInfoList ml = dir.entryInfoList(QDir::Files);
 	for (int i = 0; i < ml.size(); i++) {
@@ -93,6 +97,8 @@ bool GMAPData::loadTile(const QDir &dir)
 				delete tile;
 				return false;
 			}
+			files.append(fi.absoluteFilePath());
+			types.append(tt);
 		}
 	}
 
@@ -102,15 +108,51 @@ bool GMAPData::loadTile(const QDir &dir)
 		return false;
 	}
 
-	double min[2], max[2];
-	min[0] = tile->bounds().left();
-	min[1] = tile->bounds().bottom();
-	max[0] = tile->bounds().right();
-	max[1] = tile->bounds().top();
-	_tileTree.Insert(min, max, tile);
+	index << files << types;
+	tile->write(index);
 
-	_bounds |= tile->bounds();
-	_hasDEM |= tile->hasDem();
+	insertTile(tile);
+
+	return true;
+}
+
+static bool readTile(QDataStream &index, VectorTile *tile)
+{
+	QStringList files;
+	QList<qint32> types;
+
+	index >> files >> types;
+	if (index.status() != QDataStream::Ok || files.size() != types.size())
+		return false;
+
+	for (int i = 0; i < files.size(); i++)
+		if (!tile->addFile(files.at(i), (SubFile::Type)types.at(i)))
+			return false;
+
+	return tile->read(index);
+}
+
+bool GMAPData::loadTiles(QDataStream &index)
+{
+	QList<VectorTile*> tiles;
+	quint32 count;
+
+	index >> count;
+	if (index.status() != QDataStream::Ok)
+		return false;
+
+	for (quint32 i = 0; i < count; i++) {
+		VectorTile *tile = new VectorTile();
+		tiles.append(tile);
+
+		if (!readTile(index, tile)) {
+			qDeleteAll(tiles);
+			return false;
+		}
+	}
+
+	for (int i = 0; i < tiles.size(); i++)
+		insertTile(tiles.at(i));
 
 	return true;
 }
@@ -130,12 +172,30 @@ GMAPData::GMAPData(const QString &fileName, PolyCache &polyCache,
 		return;
 	}
 	QDir dataDir(baseDir.filePath(dataDirPath));
-	QFileInfoList ml = dataDir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
 
-	for (int i = 0; i < ml.size(); i++) {
-		const QFileInfo &fi = ml.at(i);
-		if (fi.isDir())
-			loadTile(QDir(fi.absoluteFilePath()));
+	/* Adding/removing tiles changes the data directory modification time */
+	QFileInfo mfi(fileName), dfi(dataDir.absolutePath());
+	TileIndex index(mfi.absoluteFilePath(), mfi.size(), qMax(
+	  mfi.lastModified().toMSecsSinceEpoch(),
+	  dfi.lastModified().toMSecsSinceEpoch()));
+
+	if (!(index.load() && loadTiles(index.in()))) {
+		QFileInfoList ml = dataDir.entryInfoList(QDir::Dirs
+		  | QDir::NoDotAndDotDot);
+		QByteArray data;
+		QDataStream tiles(&data, QIODevice::WriteOnly);
+		tiles.setVersion(index.out().version());
+		quint32 count = 0;
+
+		for (int i = 0; i < ml.size(); i++) {
+			const QFileInfo &fi = ml.at(i);
+			if (fi.isDir() && loadTile(QDir(fi.absoluteFilePath()), tiles))
+				count++;
+		}
+
+		index.out() << count;
+		index.out().writeRawData(data.constData(), data.size());
+		index.save();
 	}
 
 	if (baseDir.exists(typFilePath))
@@ -5,6 +5,7 @@
 
 class QXmlStreamReader;
 class QDir;
+class QDataStream;
 
 namespace IMG {
 
@@ -20,7 +21,8 @@ private:
 	void mapProduct(QXmlStreamReader &reader, QString &dataDir,
 	  QString &typFile);
 	void subProduct(QXmlStreamReader &reader, QString &dataDir);
-	bool loadTile(const QDir &dir);
+	bool loadTile(const QDir &dir, QDataStream &index);
+	bool loadTiles(QDataStream &index);
 };
 
 }
@@ -33,10 +33,33 @@ bool HuffmanTable::load(const RGNFile *rgn, SubFile::Handle &rgnHdl)
 	_aclTable = _bsrchTable + _bsrchEntryBytes * _bsrchEntries;
 	_huffmanTable = _aclTable + (_aclEntryBytes << _aclBits);
 
-	return (_symBits > 0 && _symBits <= 32 && _symbolBits <= 32);
+	if (!(_symBits > 0 && _symBits <= 32 && _symbolBits <= 32))
+		return false;
+
+	createLookupTable();
+
+	return true;
+}
+
+void HuffmanTable::createLookupTable()
+{
+	_lookup.resize(1<<LOOKUP_BITS);
+
+	/* The codes are prefix codes, so a code of at most LOOKUP_BITS bits is
+	   fully determined by the leading LOOKUP_BITS bits of the data */
+	for (quint32 i = 0; i < (1U<<LOOKUP_BITS); i++) {
+		quint8 size;
+		quint32 symbol = decode(i << (32 - LOOKUP_BITS), size);
+
+		if (size && size <= LOOKUP_BITS) {
+			Code &c = _lookup[i];
+			c.symbol = symbol;
+			c.size = size;
+		}
+	}
 }
 
-quint32 HuffmanTable::symbol(quint32 data, quint8 &size) const
+quint32 HuffmanTable::decode(quint32 data, quint8 &size) const
 {
 	quint32 lo, hi;
 	const quint8 *tp;
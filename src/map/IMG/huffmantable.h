@@ -1,6 +1,7 @@
 #ifndef IMG_HUFFMANTABLE_H
 #define IMG_HUFFMANTABLE_H
 
+#include <QVector>
 #include "huffmanbuffer.h"
 
 namespace IMG {
@@ -13,14 +14,37 @@ public:
 
 	bool load(const RGNFile *rgn, SubFile::Handle &rgnHdl);
 
-	quint32 symbol(quint32 data, quint8 &size) const;
+	quint32 symbol(quint32 data, quint8 &size) const
+	{
+		const Code &c = _lookup.at(data >> (32 - LOOKUP_BITS));
+		if (c.size) {
+			size = c.size;
+			return c.symbol;
+		} else
+			return decode(data, size);
+	}
 	quint8 id() const {return _buffer.id();}
 
 	quint8 symBits() const {return _symBits;}
 	quint8 symbolBits() const {return _symbolBits;}
 
 private:
+	/* Codes up to LOOKUP_BITS long are decoded with a single table lookup,
+	   longer codes go through the ACL/binary search tables */
+	static const int LOOKUP_BITS = 12;
+
+	struct Code {
+		Code() : symbol(0), size(0) {}
+
+		quint32 symbol;
+		quint8 size;
+	};
+
+	quint32 decode(quint32 data, quint8 &size) const;
+	void createLookupTable();
+
 	HuffmanBuffer _buffer;
+	QVector<Code> _lookup;
 	const quint8 *_aclTable, *_bsrchTable, *_huffmanTable;
 	quint8 _aclBits, _aclEntryBytes, _symBits, _symBytes, _indexBytes,
 	  _bsrchEntryBytes, _bsrchEntries, _symbolBits, _symbolBytes;
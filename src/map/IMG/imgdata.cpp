@@ -1,9 +1,14 @@
 #include <QMap>
 #include <QtEndian>
 #include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
 #include "vectortile.h"
+#include "tileindex.h"
 #include "imgdata.h"
 
+#define BLOCK_CACHE_SIZE 4194304 /* bytes */
+
 using namespace IMG;
 
 static SubFile::Type tileType(const char str[3])
@@ -141,35 +146,49 @@ bool IMGData::readFAT(QFile *file, TileMap &tileMap)
 
 bool IMGData::createTileTree(QFile *file, const TileMap &tileMap)
 {
+	QFileInfo fi(_fileName);
+	TileIndex index(fi.absoluteFilePath(), fi.size(),
+	  fi.lastModified().toMSecsSinceEpoch());
+	bool cached = index.load();
+	bool changed = !cached;
+
 	for (TileMap::const_iterator it = tileMap.constBegin();
 	  it != tileMap.constEnd(); ++it) {
 		VectorTile *tile = it.value();
+		quint8 valid = 0;
+
+		if (cached)
+			index.in() >> valid;
+		if (!(cached && index.in().status() == QDataStream::Ok
+		  && (!valid || tile->read(index.in())))) {
+			valid = tile->init(file);
+			changed = true;
+			if (!valid)
+				qWarning("%s: %s: Invalid map tile",
+				  qUtf8Printable(_fileName), qUtf8Printable(it.key()));
+		}
 
-		if (!tile->init(file)) {
-			qWarning("%s: %s: Invalid map tile", qUtf8Printable(_fileName),
-			  qUtf8Printable(it.key()));
+		index.out() << valid;
+		if (!valid) {
 			delete tile;
 			continue;
 		}
+		tile->write(index.out());
 
-		double min[2], max[2];
-		min[0] = tile->bounds().left();
-		min[1] = tile->bounds().bottom();
-		max[0] = tile->bounds().right();
-		max[1] = tile->bounds().top();
-		_tileTree.Insert(min, max, tile);
-
-		_bounds |= tile->bounds();
-		_hasDEM |= tile->hasDem();
+		insertTile(tile);
 	}
 
+	if (changed)
+		index.save();
+
 	return (_tileTree.Count() > 0);
 }
 
 IMGData::IMGData(const QString &fileName, PolyCache &polyCache,
   PointCache &pointCache, ElevationCache &demCache, QMutex &lock,
   QMutex &demLock)
-  : MapData(fileName, polyCache, pointCache, demCache, lock, demLock)
+  : MapData(fileName, polyCache, pointCache, demCache, lock, demLock),
+  _blocks(BLOCK_CACHE_SIZE)
 {
 	QFile file(fileName);
 	TileMap tileMap;
@@ -219,10 +238,34 @@ template<class T> bool IMGData::readValue(QFile *file, T &val) const
 
 bool IMGData::readBlock(QFile *file, int blockNum, char *data) const
 {
+	int size = 1<<_blockBits;
+
+	_blocksLock.lock();
+	QByteArray *block = _blocks.object(blockNum);
+	if (block) {
+		memcpy(data, block->constData(), size);
+		_blocksLock.unlock();
+		return true;
+	}
+	_blocksLock.unlock();
+
 	if (!file->seek((quint64)blockNum << _blockBits))
 		return false;
-	if (read(file, data, 1ULL<<_blockBits) < (qint64)(1ULL<<_blockBits))
+	if (read(file, data, size) < size)
 		return false;
 
+	_blocksLock.lock();
+	_blocks.insert(blockNum, new QByteArray(data, size), size);
+	_blocksLock.unlock();
+
 	return true;
 }
+
+void IMGData::clear()
+{
+	MapData::clear();
+
+	_blocksLock.lock();
+	_blocks.clear();
+	_blocksLock.unlock();
+}
@@ -1,6 +1,8 @@
 #ifndef IMG_IMGDATA_H
 #define IMG_IMGDATA_H
 
+#include <QCache>
+#include <QMutex>
 #include "mapdata.h"
 
 class QFile;
@@ -17,6 +19,8 @@ public:
 	unsigned blockBits() const {return _blockBits;}
 	bool readBlock(QFile *file, int blockNum, char *data) const;
 
+	void clear();
+
 private:
 	typedef QMap<QByteArray, VectorTile*> TileMap;
 
@@ -29,6 +33,10 @@ private:
 
 	quint8 _key;
 	unsigned _blockBits;
+
+	/* Decoded blocks shared by all the subfile handles of the IMG file */
+	mutable QCache<int, QByteArray> _blocks;
+	mutable QMutex _blocksLock;
 };
 
 }
@@ -16,45 +16,56 @@ public:
 	  Matrix<qint16> &img) const;
 
 private:
+	/* MSB first bit stream with a 64b buffer that is refilled only when
+	   less than the 32b of the value() window are available. As with the
+	   original byte-wise reader, a read fails when less than 25 bits of
+	   stream data remain in the window (the decoder never peeks at more
+	   than 16 bits). */
 	class BitStream
 	{
 	public:
 		BitStream(const SubFile *file, SubFile::Handle &hdl)
-		  : _file(file), _hdl(hdl) {}
+		  : _file(file), _hdl(hdl), _buffer(0), _bits(0), _eof(false) {}
 
 		bool init()
 		{
-			if (!_file->readVUInt32SW(_hdl, 4, _value))
-				return false;
-			_shift = -8;
-			return true;
+			refill();
+			return (_bits >= 32);
 		}
 
 		bool read(quint8 bits)
 		{
-			quint8 data;
-
-			_value <<= bits;
-			_shift += bits;
-
-			while (_shift >= 0) {
-				if (!_file->readByte(_hdl, &data))
-					return false;
+			_buffer <<= bits;
+			_bits -= bits;
 
-				_value |= (quint32)data << _shift;
-				_shift -= 8;
-			}
+			if (_bits < 32)
+				refill();
 
-			return true;
+			return (_bits >= 25);
 		}
 
-		quint32 value() const {return _value;}
+		quint32 value() const {return (quint32)(_buffer >> 32);}
 
 	private:
+		void refill()
+		{
+			quint8 data;
+
+			while (_bits <= 56 && !_eof) {
+				if (!_file->readByte(_hdl, &data))
+					_eof = true;
+				else {
+					_buffer |= (quint64)data << (56 - _bits);
+					_bits += 8;
+				}
+			}
+		}
+
 		const SubFile *_file;
 		SubFile::Handle &_hdl;
-		quint32 _value;
-		qint8 _shift;
+		quint64 _buffer;
+		int _bits;
+		bool _eof;
 	};
 
 	struct Context
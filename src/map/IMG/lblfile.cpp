@@ -111,6 +111,9 @@ void LBLFile::clear()
 {
 	_table = QVector<quint32>();
 	_rasters = QVector<Image>();
+	_labelsLock.lock();
+	_labels.clear();
+	_labelsLock.unlock();
 	delete _huffmanText;
 	_huffmanText = 0;
 }
@@ -318,6 +321,30 @@ Label LBLFile::labelHuffman(Handle &hdl, const SubFile *file, Handle &fileHdl,
 
 Label LBLFile::label(Handle &hdl, quint32 offset, bool poi, bool capitalize,
   bool convert)
+{
+	quint64 key = offset | ((quint64)poi << 32) | ((quint64)capitalize << 33)
+	  | ((quint64)convert << 34);
+
+	_labelsLock.lock();
+	Label *cached = _labels.object(key);
+	if (cached) {
+		Label lbl(*cached);
+		_labelsLock.unlock();
+		return lbl;
+	}
+	_labelsLock.unlock();
+
+	Label lbl(readLabel(hdl, offset, poi, capitalize, convert));
+
+	_labelsLock.lock();
+	_labels.insert(key, new Label(lbl));
+	_labelsLock.unlock();
+
+	return lbl;
+}
+
+Label LBLFile::readLabel(Handle &hdl, quint32 offset, bool poi,
+  bool capitalize, bool convert)
 {
 	quint32 labelOffset;
 	if (poi) {
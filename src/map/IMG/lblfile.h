@@ -2,6 +2,8 @@
 #define IMG_LBLFILE_H
 
 #include <QPixmap>
+#include <QCache>
+#include <QMutex>
 #include "common/textcodec.h"
 #include "section.h"
 #include "subfile.h"
@@ -17,13 +19,13 @@ class LBLFile : public SubFile
 public:
 	LBLFile(const IMGData *img)
 	  : SubFile(img), _huffmanText(0), _imgIdSize(0), _poiShift(0), _shift(0),
-	  _encoding(0) {}
+	  _encoding(0), _labels(4096) {}
 	LBLFile(const QString &path)
 	  : SubFile(path), _huffmanText(0), _imgIdSize(0), _poiShift(0), _shift(0),
-	  _encoding(0) {}
+	  _encoding(0), _labels(4096) {}
 	LBLFile(const SubFile *gmp, quint32 offset)
 	  : SubFile(gmp, offset), _huffmanText(0), _imgIdSize(0), _poiShift(0),
-	  _shift(0), _encoding(0) {}
+	  _shift(0), _encoding(0), _labels(4096) {}
 	~LBLFile();
 
 	bool load(Handle &hdl, const RGNFile *rgn, Handle &rgnHdl);
@@ -43,6 +45,8 @@ private:
 		quint32 size;
 	};
 
+	Label readLabel(Handle &hdl, quint32 offset, bool poi, bool capitalize,
+	  bool convert);
 	Label str2label(const QVector<quint8> &str, bool capitalize,
 	  bool convert);
 	Label label6b(const SubFile *file, Handle &fileHdl, quint32 size,
@@ -58,6 +62,10 @@ private:
 	QVector<Image> _rasters;
 	QVector<quint32> _table;
 	TextCodec _codec;
+	/* Decoded labels, the key is the label offset with the poi, capitalize
+	   and convert flags in the upper 32 bits */
+	QCache<quint64, Label> _labels;
+	QMutex _labelsLock;
 	Section _base, _poi, _img;
 	quint8 _imgIdSize;
 	quint8 _poiShift;
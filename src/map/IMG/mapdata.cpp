@@ -1,4 +1,5 @@
 #include <QFileInfo>
+#include <QtConcurrent>
 #include "common/programpaths.h"
 #include "vectortile.h"
 #include "style.h"
@@ -6,25 +7,78 @@
 
 using namespace IMG;
 
-#define SUBDIV_CACHE_SIZE 2048 // ~32MB for both caches together
 #define DEM_CACHE_SIZE    1024 // ~32MB
 
-bool MapData::polyCb(VectorTile *tile, void *context)
+int MapData::_cacheSize = 131072;
+
+static qint64 polysSize(const QList<MapData::Poly> &list)
 {
-	PolyCTX *ctx = (PolyCTX*)context;
-	tile->polys(ctx->file, ctx->rect, ctx->zoom, ctx->polygons, ctx->lines,
-	  ctx->cache, ctx->lock);
-	return true;
+	qint64 size = 0;
+
+	for (int i = 0; i < list.size(); i++) {
+		const MapData::Poly &p = list.at(i);
+		size += sizeof(MapData::Poly) + p.points.size() * sizeof(QPointF)
+		  + p.label.text().size() * sizeof(QChar) + p.raster.img().size();
+	}
+
+	return size;
+}
+
+int MapData::cost(const Polys *polys)
+{
+	return qMax((polysSize(polys->polygons) + polysSize(polys->lines)) / 1024,
+	  (qint64)1);
+}
+
+int MapData::cost(const QList<Point> *points)
+{
+	qint64 size = 0;
+
+	for (int i = 0; i < points->size(); i++) {
+		const Point &p = points->at(i);
+		size += sizeof(Point) + p.label.text().size() * sizeof(QChar)
+		  + p.lights.size() * sizeof(Light);
+	}
+
+	return qMax(size / 1024, (qint64)1);
 }
 
-bool MapData::pointCb(VectorTile *tile, void *context)
+bool MapData::tileCb(VectorTile *tile, void *context)
 {
-	PointCTX *ctx = (PointCTX*)context;
-	tile->points(ctx->file, ctx->rect, ctx->zoom, ctx->points, ctx->cache,
-	  ctx->lock);
+	QList<VectorTile*> *tiles = (QList<VectorTile*>*)context;
+	tiles->append(tile);
 	return true;
 }
 
+static QFile *openFile(const QString &fileName)
+{
+	if (fileName.isNull())
+		return 0;
+
+	QFile *file = new QFile(fileName);
+	if (!file->open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+		qWarning("%s: %s", qUtf8Printable(file->fileName()),
+		  qUtf8Printable(file->errorString()));
+
+	return file;
+}
+
+void MapData::polyTask(PolyTask &task)
+{
+	QFile *file = openFile(task.fileName);
+	task.tile->polys(file, *task.rect, *task.zoom, &task.polygonsData,
+	  task.lines ? &task.linesData : 0, task.cache, task.lock);
+	delete file;
+}
+
+void MapData::pointTask(PointTask &task)
+{
+	QFile *file = openFile(task.fileName);
+	task.tile->points(file, *task.rect, *task.zoom, &task.pointsData,
+	  task.cache, task.lock);
+	delete file;
+}
+
 bool MapData::elevationCb(VectorTile *tile, void *context)
 {
 	ElevationCTX *ctx = (ElevationCTX*)context;
@@ -40,8 +94,9 @@ MapData::MapData(const QString &fileName, PolyCache &polyCache,
   _polyCache(polyCache), _pointCache(pointCache), _demCache(demCache),
   _lock(lock), _demLock(demLock)
 {
-	_polyCache.setMaxCost(SUBDIV_CACHE_SIZE);
-	_pointCache.setMaxCost(SUBDIV_CACHE_SIZE);
+	/* Polygons are usually much bigger than the points */
+	_polyCache.setMaxCost(_cacheSize - _cacheSize / 4);
+	_pointCache.setMaxCost(_cacheSize / 4);
 	_demCache.setMaxCost(DEM_CACHE_SIZE);
 }
 
@@ -54,10 +109,9 @@ MapData::~MapData()
 	delete _typ;
 }
 
-void MapData::polys(QFile *file, const RectC &rect, int bits,
-  QList<Poly> *polygons, QList<Poly> *lines)
+QList<VectorTile*> MapData::tiles(const RectC &rect) const
 {
-	PolyCTX ctx(file, rect, zoom(bits), polygons, lines, &_polyCache, &_lock);
+	QList<VectorTile*> list;
 	double min[2], max[2];
 
 	min[0] = rect.left();
@@ -65,21 +119,62 @@ void MapData::polys(QFile *file, const RectC &rect, int bits,
 	max[0] = rect.right();
 	max[1] = rect.top();
 
-	_tileTree.Search(min, max, polyCb, &ctx);
+	_tileTree.Search(min, max, tileCb, &list);
+
+	return list;
+}
+
+/* When the rect spans multiple vector tiles, the tiles are decoded in parallel
+   in the global thread pool. The calling (render) thread takes part in the
+   work, so nesting in the RasterTile jobs can not exhaust the pool. */
+void MapData::polys(QFile *file, const RectC &rect, int bits,
+  QList<Poly> *polygons, QList<Poly> *lines)
+{
+	const Zoom &z = zoom(bits);
+	QList<VectorTile*> tl(tiles(rect));
+
+	if (tl.size() < 2) {
+		for (int i = 0; i < tl.size(); i++)
+			tl.at(i)->polys(file, rect, z, polygons, lines, &_polyCache,
+			  &_lock);
+	} else {
+		QVector<PolyTask> tasks;
+		tasks.reserve(tl.size());
+		for (int i = 0; i < tl.size(); i++)
+			tasks.append(PolyTask(tl.at(i), file ? file->fileName() : QString(),
+			  &rect, &z, lines != 0, &_polyCache, &_lock));
+
+		QtConcurrent::blockingMap(tasks, polyTask);
+
+		for (int i = 0; i < tasks.size(); i++) {
+			polygons->append(tasks.at(i).polygonsData);
+			if (lines)
+				lines->append(tasks.at(i).linesData);
+		}
+	}
 }
 
 void MapData::points(QFile *file, const RectC &rect, int bits,
   QList<Point> *points)
 {
-	PointCTX ctx(file, rect, zoom(bits), points, &_pointCache, &_lock);
-	double min[2], max[2];
+	const Zoom &z = zoom(bits);
+	QList<VectorTile*> tl(tiles(rect));
 
-	min[0] = rect.left();
-	min[1] = rect.bottom();
-	max[0] = rect.right();
-	max[1] = rect.top();
+	if (tl.size() < 2) {
+		for (int i = 0; i < tl.size(); i++)
+			tl.at(i)->points(file, rect, z, points, &_pointCache, &_lock);
+	} else {
+		QVector<PointTask> tasks;
+		tasks.reserve(tl.size());
+		for (int i = 0; i < tl.size(); i++)
+			tasks.append(PointTask(tl.at(i), file ? file->fileName()
+			  : QString(), &rect, &z, &_pointCache, &_lock));
+
+		QtConcurrent::blockingMap(tasks, pointTask);
 
-	_tileTree.Search(min, max, pointCb, &ctx);
+		for (int i = 0; i < tasks.size(); i++)
+			points->append(tasks.at(i).pointsData);
+	}
 }
 
 void MapData::elevations(QFile *file, const RectC &rect, int bits,
@@ -107,6 +202,19 @@ void MapData::clear()
 	_demCache.clear();
 }
 
+void MapData::insertTile(VectorTile *tile)
+{
+	double min[2], max[2];
+	min[0] = tile->bounds().left();
+	min[1] = tile->bounds().bottom();
+	max[0] = tile->bounds().right();
+	max[1] = tile->bounds().top();
+	_tileTree.Insert(min, max, tile);
+
+	_bounds |= tile->bounds();
+	_hasDEM |= tile->hasDem();
+}
+
 void MapData::computeZooms()
 {
 	TileTree::Iterator it;
@@ -4,11 +4,13 @@
 #include <QList>
 #include <QPointF>
 #include <QCache>
+#include <QSharedPointer>
 #include <QMutex>
 #include <QFile>
 #include <QDebug>
 #include "common/rectc.h"
 #include "common/rtree.h"
+#include "common/cacheregistry.h"
 #include "common/range.h"
 #include "map/matrix.h"
 #include "label.h"
@@ -76,14 +78,23 @@ public:
 		double yr;
 	};
 
+	/* The lines (and the NET/NOD links) are decoded only when first
+	   requested, linesLoaded marks the subdivisions where they are present */
 	struct Polys {
+		Polys() : linesLoaded(false) {}
+
 		QList<Poly> polygons;
 		QList<Poly> lines;
+		bool linesLoaded;
 	};
 
-	typedef QCache<const SubDiv*, Polys> PolyCache;
-	typedef QCache<const SubDiv*, QList<Point> > PointCache;
-	typedef QCache<const DEMTile*, Elevation> ElevationCache;
+	/* The cached data are shared so that the cache lock is held only for
+	   the lookup, not while copying the data out of the cache */
+	typedef QSharedPointer<Polys> PolysPtr;
+	typedef QSharedPointer<QList<Point> > PointsPtr;
+	typedef StatsCache<const SubDiv*, PolysPtr> PolyCache;
+	typedef StatsCache<const SubDiv*, PointsPtr> PointCache;
+	typedef StatsCache<const DEMTile*, Elevation> ElevationCache;
 
 	MapData(const QString &fileName, PolyCache &polyCache,
 	  PointCache &pointCache, ElevationCache &demCache, QMutex &lock,
@@ -99,7 +110,7 @@ public:
 	void points(QFile *file, const RectC &rect, int bits, QList<Point> *points);
 	void elevations(QFile *file, const RectC &rect, int bits,
 	  QList<Elevation> *elevations);
-	void clear();
+	virtual void clear();
 
 	bool hasDEM() const {return _hasDEM;}
 
@@ -108,10 +119,17 @@ public:
 	bool isValid() const {return _valid;}
 	QString errorString() const {return _errorString;}
 
+	/* Approximate memory usage in KB, used as the cache cost */
+	static int cost(const Polys *polys);
+	static int cost(const QList<Point> *points);
+	/* Total size of the subdivision caches (polygons + points) in KB */
+	static void setCacheSize(int size) {_cacheSize = size;}
+
 protected:
 	typedef RTree<VectorTile*, double, 2> TileTree;
 
 	void computeZooms();
+	void insertTile(VectorTile *tile);
 
 	QString _fileName;
 	QString _name;
@@ -126,36 +144,46 @@ protected:
 	QString _errorString;
 
 private:
-	struct PolyCTX
+	/* Per vector tile work item of the parallel polys()/points() fetch. Each
+	   item reads its own copy of the IMG file (if any) as QFile is not
+	   thread-safe. */
+	struct PolyTask
 	{
-		PolyCTX(QFile *file, const RectC &rect, const Zoom &zoom,
-		  QList<MapData::Poly> *polygons, QList<MapData::Poly> *lines,
-		  PolyCache *cache, QMutex *lock)
-		  : file(file), rect(rect), zoom(zoom), polygons(polygons),
+		PolyTask() : tile(0), rect(0), zoom(0), lines(false), cache(0),
+		  lock(0) {}
+		PolyTask(VectorTile *tile, const QString &fileName, const RectC *rect,
+		  const Zoom *zoom, bool lines, PolyCache *cache, QMutex *lock)
+		  : tile(tile), fileName(fileName), rect(rect), zoom(zoom),
 		  lines(lines), cache(cache), lock(lock) {}
 
-		QFile *file;
-		const RectC &rect;
-		const Zoom &zoom;
-		QList<MapData::Poly> *polygons;
-		QList<MapData::Poly> *lines;
+		VectorTile *tile;
+		QString fileName;
+		const RectC *rect;
+		const Zoom *zoom;
+		bool lines;
 		PolyCache *cache;
 		QMutex *lock;
+
+		QList<MapData::Poly> polygonsData;
+		QList<MapData::Poly> linesData;
 	};
 
-	struct PointCTX
+	struct PointTask
 	{
-		PointCTX(QFile *file, const RectC &rect, const Zoom &zoom,
-		  QList<MapData::Point> *points, PointCache *cache, QMutex *lock)
-		  : file(file), rect(rect), zoom(zoom), points(points), cache(cache),
-		  lock(lock) {}
+		PointTask() : tile(0), rect(0), zoom(0), cache(0), lock(0) {}
+		PointTask(VectorTile *tile, const QString &fileName, const RectC *rect,
+		  const Zoom *zoom, PointCache *cache, QMutex *lock)
+		  : tile(tile), fileName(fileName), rect(rect), zoom(zoom),
+		  cache(cache), lock(lock) {}
 
-		QFile *file;
-		const RectC &rect;
-		const Zoom &zoom;
-		QList<MapData::Point> *points;
+		VectorTile *tile;
+		QString fileName;
+		const RectC *rect;
+		const Zoom *zoom;
 		PointCache *cache;
 		QMutex *lock;
+
+		QList<MapData::Point> pointsData;
 	};
 
 	struct ElevationCTX
@@ -175,15 +203,20 @@ private:
 
 	const Zoom &zoom(int bits) const;
 
-	static bool polyCb(VectorTile *tile, void *context);
-	static bool pointCb(VectorTile *tile, void *context);
+	QList<VectorTile*> tiles(const RectC &rect) const;
+
+	static bool tileCb(VectorTile *tile, void *context);
 	static bool elevationCb(VectorTile *tile, void *context);
+	static void polyTask(PolyTask &task);
+	static void pointTask(PointTask &task);
 
 	PolyCache &_polyCache;
 	PointCache &_pointCache;
 	ElevationCache &_demCache;
 	QMutex &_lock, &_demLock;
 
+	static int _cacheSize;
+
 	friend class VectorTile;
 };
 
@@ -2,13 +2,16 @@
 #include <QPainter>
 #include <QCache>
 #include "common/util.h"
+#include "common/trace.h"
 #include "map/dem.h"
 #include "map/textpathitem.h"
 #include "map/textpointitem.h"
+#include "map/textitemlist.h"
 #include "map/bitmapline.h"
 #include "map/rectd.h"
 #include "map/hillshading.h"
 #include "map/filter.h"
+#include "map/llgrid.h"
 #include "style.h"
 #include "lblfile.h"
 #include "demtree.h"
@@ -133,11 +136,21 @@ void RasterTile::ll2xy(QList<MapData::Point> &points) const
 void RasterTile::drawPolygons(QPainter *painter,
   const QList<MapData::Poly> &polygons) const
 {
+	/* Bucket the polygons by type (keeping their order) so that the draw
+	   order is resolved in a single pass instead of one pass per type */
+	QHash<quint32, QList<int> > types;
+	for (int i = 0; i < polygons.size(); i++)
+		types[polygons.at(i).type].append(i);
+
 	for (int n = 0; n < _style->drawOrder().size(); n++) {
-		for (int i = 0; i < polygons.size(); i++) {
-			const MapData::Poly &poly = polygons.at(i);
-			if (poly.type != _style->drawOrder().at(n))
-				continue;
+		QHash<quint32, QList<int> >::const_iterator it(types.constFind(
+		  _style->drawOrder().at(n)));
+		if (it == types.constEnd())
+			continue;
+
+		const QList<int> &list = *it;
+		for (int i = 0; i < list.size(); i++) {
+			const MapData::Poly &poly = polygons.at(list.at(i));
 
 			if (poly.raster.isValid()) {
 				if (!_rasters)
@@ -226,7 +239,7 @@ void RasterTile::drawLines(QPainter *painter,
 }
 
 void RasterTile::drawTextItems(QPainter *painter,
-  const QList<TextItem*> &textItems) const
+  const TextItemList &textItems) const
 {
 	QRectF rect(_rect);
 
@@ -314,7 +327,7 @@ void RasterTile::drawSectorLights(QPainter *painter,
 	}
 }
 
-static void removeDuplicitLabel(QList<TextItem*> &labels, const QString &text,
+static void removeDuplicitLabel(TextItemList &labels, const QString &text,
   const QRectF &tileRect)
 {
 	for (int i = 0; i < labels.size(); i++) {
@@ -328,10 +341,10 @@ static void removeDuplicitLabel(QList<TextItem*> &labels, const QString &text,
 }
 
 void RasterTile::processPolygons(const QList<MapData::Poly> &polygons,
-  QList<TextItem*> &textItems)
+  TextItemList &textItems)
 {
 	QSet<QString> set;
-	QList<TextItem *> labels;
+	TextItemList labels;
 
 	if (!_vectors)
 		return;
@@ -368,7 +381,7 @@ void RasterTile::processPolygons(const QList<MapData::Poly> &polygons,
 }
 
 void RasterTile::processLines(QList<MapData::Poly> &lines,
-  QList<TextItem*> &textItems, const QImage (&arrows)[2])
+  TextItemList &textItems, const QImage (&arrows)[2])
 {
 	std::stable_sort(lines.begin(), lines.end());
 
@@ -378,7 +391,7 @@ void RasterTile::processLines(QList<MapData::Poly> &lines,
 }
 
 void RasterTile::processStreetNames(const QList<MapData::Poly> &lines,
-  QList<TextItem*> &textItems, const QImage (&arrows)[2])
+  TextItemList &textItems, const QImage (&arrows)[2])
 {
 	for (int i = 0; i < lines.size(); i++) {
 		const MapData::Poly &poly = lines.at(i);
@@ -422,7 +435,7 @@ void RasterTile::processStreetNames(const QList<MapData::Poly> &lines,
 }
 
 void RasterTile::processShields(const QList<MapData::Poly> &lines,
-  QList<TextItem*> &textItems)
+  TextItemList &textItems)
 {
 	for (int type = FIRST_SHIELD; type <= LAST_SHIELD; type++) {
 		if (minShieldZoom(static_cast<Shield::Type>(type)) > _zoom)
@@ -534,7 +547,7 @@ static quint32 pointType(quint32 type, quint32 flags)
 }
 
 void RasterTile::processPoints(QList<MapData::Point> &points,
-  QList<TextItem*> &textItems, QList<TextItem*> &lights,
+  TextItemList &textItems, TextItemList &lights,
   QList<const MapData::Point*> &sectorLights)
 {
 	std::sort(points.begin(), points.end());
@@ -589,7 +602,7 @@ bool RasterTile::hasDEM() const
 }
 
 void RasterTile::fetchData(QList<MapData::Poly> &polygons,
-  QList<MapData::Poly> &lines, QList<MapData::Point> &points, MatrixD &dem)
+  QList<MapData::Poly> &lines, QList<MapData::Point> &points, MatrixD *dem)
 {
 	QPoint ttl(_rect.topLeft());
 	QRectF polyRect(ttl, QPointF(ttl.x() + _rect.width(), ttl.y()
@@ -610,17 +623,15 @@ void RasterTile::fetchData(QList<MapData::Poly> &polygons,
 	RectC demRectC;
 	MatrixC demLL;
 	QList<MapData::Elevation> tiles;
-	if (_hillShading) {
+	if (dem) {
 		int extend = HillShading::blur() + 1;
 		int left = _rect.left() - extend;
 		int right = _rect.right() + extend;
 		int top = _rect.top() - extend;
 		int bottom = _rect.bottom() + extend;
 
-		demLL = MatrixC(_rect.height() + 2 * extend, _rect.width() + 2 * extend);
-		for (int y = top, i = 0; y <= bottom; y++)
-			for (int x = left; x <= right; x++, i++)
-				demLL.at(i) = xy2ll(QPointF(x, y));
+		demLL = LLGrid::coordinates(_proj, _transform, QRect(left, top,
+		  right - left + 1, bottom - top + 1));
 
 		if (hasDEM()) {
 			RectC rect;
@@ -663,20 +674,18 @@ void RasterTile::fetchData(QList<MapData::Poly> &polygons,
 	ll2xy(lines);
 	ll2xy(points);
 
-	if (_hillShading)
-		dem = demRectC.isNull()
+	if (dem)
+		*dem = demRectC.isNull()
 		  ? DEM::elevation(demLL) : DEMTree(tiles).elevation(demLL);
 }
 
-void RasterTile::drawHillShading(QPainter *painter, const MatrixD &dem) const
+QImage RasterTile::hillShading(const MatrixD &dem) const
 {
 	if (HillShading::blur()) {
 		MatrixD filtered(Filter::blur(dem, HillShading::blur()));
-		painter->drawImage(_rect.x(), _rect.y(), HillShading::render(
-		  filtered, HillShading::blur() + 1));
+		return HillShading::render(filtered, HillShading::blur() + 1);
 	} else
-		painter->drawImage(_rect.x(), _rect.y(), HillShading::render(
-		  dem, HillShading::blur() + 1));
+		return HillShading::render(dem, HillShading::blur() + 1);
 }
 
 void RasterTile::render()
@@ -687,15 +696,30 @@ void RasterTile::render()
 	QList<MapData::Poly> lines;
 	QList<MapData::Point> points;
 	MatrixD dem;
-	QList<TextItem*> textItems, lights;
+	TextItemList textItems, lights;
 	QList<const MapData::Point*> sectorLights;
 	QImage arrows[2];
 
 	arrows[ROAD] = Util::svg2img(":/symbols/oneway.svg", _ratio);
 	arrows[WATER] = Util::svg2img(":/symbols/flow.svg", _ratio);
 
-	fetchData(polygons, lines, points, dem);
+	QString hsKey;
+	QImage hsImg;
+	bool hsCached = false;
+	if (_hillShading) {
+		hsKey = HillShading::key(_data.first()->fileName(),
+		  xy2ll(_rect.topLeft()), xy2ll(_rect.bottomRight()));
+		hsCached = HillShading::find(hsKey, &hsImg);
+	}
 
+	if (cancelled())
+		return;
+	TRACE_SCOPE("IMG", "fetchData");
+	fetchData(polygons, lines, points, (_hillShading && !hsCached) ? &dem : 0);
+	if (cancelled())
+		return;
+
+	TRACE_NEXT("labels");
 	processPoints(points, textItems, lights, sectorLights);
 	processPolygons(polygons, textItems);
 	processLines(lines, textItems, arrows);
@@ -708,10 +732,19 @@ void RasterTile::render()
 	painter.setRenderHint(QPainter::Antialiasing);
 	painter.translate(-_rect.x(), -_rect.y());
 
+	TRACE_NEXT("drawPaths");
 	drawPolygons(&painter, polygons);
-	if (_hillShading)
-		drawHillShading(&painter, dem);
+	if (_hillShading) {
+		TRACE_NEXT("hillShading");
+		if (!hsCached) {
+			hsImg = hillShading(dem);
+			HillShading::insert(hsKey, hsImg);
+		}
+		painter.drawImage(_rect.x(), _rect.y(), hsImg);
+		TRACE_NEXT("drawPaths");
+	}
 	drawLines(&painter, lines);
+	TRACE_NEXT("drawLabels");
 	drawTextItems(&painter, lights);
 	drawSectorLights(&painter, sectorLights);
 	drawTextItems(&painter, textItems);
@@ -724,5 +757,7 @@ void RasterTile::render()
 	//painter.setRenderHint(QPainter::Antialiasing, false);
 	//painter.drawRect(_rect);
 
-	_pixmap.convertFromImage(img);
+	/* Convert the image in place, without an additional copy */
+	painter.end();
+	_pixmap = QPixmap::fromImage(std::move(img));
 }
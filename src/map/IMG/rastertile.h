@@ -2,6 +2,7 @@
 #define IMG_RASTERTILE_H
 
 #include <QPixmap>
+#include <QAtomicInt>
 #include "mapdata.h"
 #include "map/projection.h"
 #include "map/transform.h"
@@ -10,6 +11,7 @@
 
 class QPainter;
 class TextItem;
+class TextItemList;
 
 namespace IMG {
 
@@ -18,26 +20,32 @@ class RasterTile
 public:
 	RasterTile(const Projection &proj, const Transform &transform,
 	  MapData *data, const Style *style, int zoom, const QRect &rect,
-	  qreal ratio, const QString &key, bool hillShading, bool rasters,
+	  qreal ratio, quint64 key, bool hillShading, bool rasters,
 	  bool vectors)
 		: _proj(proj), _transform(transform), _style(style), _zoom(zoom),
-		_rect(rect), _ratio(ratio), _key(key), _hillShading(hillShading),
-		_rasters(rasters), _vectors(vectors)
+		_rect(rect), _ratio(ratio), _key(key), _cancel(0),
+		_hillShading(hillShading), _rasters(rasters), _vectors(vectors),
+		_draft(false)
 	{
 		_data.append(data);
 	}
 	RasterTile(const Projection &proj, const Transform &transform,
 	  const QList<MapData*> &data, const Style *style, int zoom,
-	  const QRect &rect, qreal ratio, const QString &key, bool hillShading,
+	  const QRect &rect, qreal ratio, quint64 key, bool hillShading,
 	  bool rasters, bool vectors)
 		: _proj(proj), _transform(transform), _data(data), _style(style),
-		_zoom(zoom), _rect(rect), _ratio(ratio), _key(key),
-		_hillShading(hillShading), _rasters(rasters), _vectors(vectors) {}
+		_zoom(zoom), _rect(rect), _ratio(ratio), _key(key), _cancel(0),
+		_hillShading(hillShading), _rasters(rasters), _vectors(vectors),
+		_draft(false) {}
 
-	const QString &key() const {return _key;}
+	quint64 key() const {return _key;}
 	QPoint xy() const {return _rect.topLeft();}
 	const QPixmap &pixmap() const {return _pixmap;}
+	bool isDraft() const {return _draft;}
 
+	/* Draft tiles are rendered without the hill shading */
+	void setDraft(bool draft) {_draft = draft;}
+	void setCancelFlag(const QAtomicInt *cancel) {_cancel = cancel;}
 	void render();
 
 private:
@@ -68,7 +76,8 @@ private:
 	};
 
 	void fetchData(QList<MapData::Poly> &polygons, QList<MapData::Poly> &lines,
-	  QList<MapData::Point> &points, MatrixD &dem);
+	  QList<MapData::Point> &points, MatrixD *dem);
+	bool cancelled() const {return (_cancel && _cancel->loadAcquire());}
 	QPointF ll2xy(const Coordinates &c) const
 	  {return _transform.proj2img(_proj.ll2xy(c));}
 	Coordinates xy2ll(const QPointF &p) const
@@ -80,22 +89,22 @@ private:
 	  const QList<MapData::Poly> &polygons) const;
 	void drawLines(QPainter *painter, const QList<MapData::Poly> &lines) const;
 	void drawTextItems(QPainter *painter,
-	  const QList<TextItem*> &textItems) const;
-	void drawHillShading(QPainter *painter, const MatrixD &dem) const;
+	  const TextItemList &textItems) const;
+	QImage hillShading(const MatrixD &dem) const;
 	void drawSectorLights(QPainter *painter,
 	  const QList<const MapData::Point*> &lights) const;
 
 	void processPolygons(const QList<MapData::Poly> &polygons,
-	  QList<TextItem*> &textItems);
-	void processLines(QList<MapData::Poly> &lines, QList<TextItem*> &textItems,
+	  TextItemList &textItems);
+	void processLines(QList<MapData::Poly> &lines, TextItemList &textItems,
 	  const QImage (&arrows)[2]);
 	void processPoints(QList<MapData::Point> &points,
-	  QList<TextItem*> &textItems, QList<TextItem*> &lights,
+	  TextItemList &textItems, TextItemList &lights,
 	  QList<const MapData::Point*> &sectorLights);
 	void processShields(const QList<MapData::Poly> &lines,
-	  QList<TextItem*> &textItems);
+	  TextItemList &textItems);
 	void processStreetNames(const QList<MapData::Poly> &lines,
-	  QList<TextItem*> &textItems, const QImage (&arrows)[2]);
+	  TextItemList &textItems, const QImage (&arrows)[2]);
 
 	const QFont *poiFont(Style::FontSize size = Style::Normal,
 	  int zoom = -1, bool extended = false) const;
@@ -109,10 +118,12 @@ private:
 	int _zoom;
 	QRect _rect;
 	qreal _ratio;
-	QString _key;
+	quint64 _key;
+	const QAtomicInt *_cancel;
 	QPixmap _pixmap;
 	bool _hillShading;
 	bool _rasters, _vectors;
+	bool _draft;
 };
 
 }
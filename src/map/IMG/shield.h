@@ -40,7 +40,7 @@ private:
 
 inline HASH_T qHash(const IMG::Shield &shield)
 {
-	return ::qHash(shield.text()) ^ ::qHash(shield.type());
+	return Hash::combine(::qHash(shield.text()), shield.type());
 }
 
 }
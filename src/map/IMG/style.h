@@ -4,6 +4,7 @@
 #include <QPen>
 #include <QBrush>
 #include <QFont>
+#include <QHash>
 #include <QDebug>
 #include "light.h"
 #include "subfile.h"
@@ -87,7 +88,8 @@ public:
 		Point(FontSize fontSize, const QColor &textColor = QColor())
 		  : _text(textColor, fontSize) {}
 		Point(const QImage &img, const QPoint &offset = QPoint(0, 0))
-		  : _img(img), _offset(offset) {}
+		  : _img(img.convertToFormat(QImage::Format_ARGB32_Premultiplied)),
+		  _offset(offset) {}
 
 		const Font &text() const {return _text;}
 		const QImage &img() const {return _img;}
@@ -210,9 +212,9 @@ private:
 	static bool itemInfo(const SubFile *file, SubFile::Handle &hdl,
 	  const Section &section, ItemInfo &info);
 
-	QMap<quint32, Line> _lines;
-	QMap<quint32, Polygon> _polygons;
-	QMap<quint32, Point> _points;
+	QHash<quint32, Line> _lines;
+	QHash<quint32, Polygon> _polygons;
+	QHash<quint32, Point> _points;
 	QList<quint32> _drawOrder;
 
 	/* Fonts and images must be initialized after QGuiApplication! */
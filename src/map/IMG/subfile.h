@@ -174,6 +174,7 @@ public:
 	bool readVBitfield32(Handle &hdl, quint32 &bitfield) const;
 
 	const QString &fileName() const {return _path ? *_path : _img->fileName();}
+	quint32 gmpOffset() const {return _gmpOffset;}
 	int blockSize() const
 	{
 		return _path ? 1U<<BLOCK_BITS : 1U<<_img->blockBits();
@@ -0,0 +1,68 @@
+#include <QFile>
+#include <QDir>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include "common/programpaths.h"
+#include "tileindex.h"
+
+#define MAGIC   0x494D4749
+#define VERSION 1
+#define SUFFIX  ".idx"
+
+using namespace IMG;
+
+TileIndex::TileIndex(const QString &path, qint64 size, qint64 time)
+  : _path(path), _size(size), _time(time), _inBuffer(&_inData),
+  _outBuffer(&_outData)
+{
+	_outBuffer.open(QIODevice::WriteOnly);
+	_out.setDevice(&_outBuffer);
+	_out.setVersion(QDataStream::Qt_5_0);
+	_out << (quint32)MAGIC << (quint16)VERSION << _size << _time << _path;
+}
+
+QString TileIndex::indexFile() const
+{
+	QByteArray hash(QCryptographicHash::hash(_path.toUtf8(),
+	  QCryptographicHash::Sha1));
+
+	return QDir(ProgramPaths::imgCacheDir()).filePath(
+	  QString::fromLatin1(hash.toHex()) + SUFFIX);
+}
+
+bool TileIndex::load()
+{
+	QFile file(indexFile());
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+	_inData = file.readAll();
+
+	_inBuffer.open(QIODevice::ReadOnly);
+	_in.setDevice(&_inBuffer);
+	_in.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic;
+	quint16 version;
+	qint64 size, time;
+	QString path;
+
+	_in >> magic >> version >> size >> time >> path;
+
+	return (_in.status() == QDataStream::Ok && magic == MAGIC
+	  && version == VERSION && size == _size && time == _time
+	  && path == _path);
+}
+
+void TileIndex::save()
+{
+	if (_out.status() != QDataStream::Ok)
+		return;
+	if (!QDir().mkpath(ProgramPaths::imgCacheDir()))
+		return;
+
+	QSaveFile file(indexFile());
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+	if (file.write(_outData) == _outData.size())
+		file.commit();
+}
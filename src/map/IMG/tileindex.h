@@ -0,0 +1,38 @@
+#ifndef IMG_TILEINDEX_H
+#define IMG_TILEINDEX_H
+
+#include <QString>
+#include <QByteArray>
+#include <QBuffer>
+#include <QDataStream>
+
+namespace IMG {
+
+/* On-disk index of the map tiles headers that allows to open maps with
+   thousands of tiles without parsing all the tiles files. The index is bound
+   to the map file path, size and modification time. */
+class TileIndex
+{
+public:
+	TileIndex(const QString &path, qint64 size, qint64 time);
+
+	bool load();
+	void save();
+
+	QDataStream &in() {return _in;}
+	QDataStream &out() {return _out;}
+
+private:
+	QString indexFile() const;
+
+	QString _path;
+	qint64 _size, _time;
+
+	QByteArray _inData, _outData;
+	QBuffer _inBuffer, _outBuffer;
+	QDataStream _in, _out;
+};
+
+}
+
+#endif // IMG_TILEINDEX_H
@@ -125,6 +125,54 @@ bool TREFile::init(QFile *file)
 	return (_firstLevel >= 0);
 }
 
+void TREFile::write(QDataStream &stream) const
+{
+	stream << _bounds.left() << _bounds.top() << _bounds.right()
+	  << _bounds.bottom() << (quint32)_levels.size();
+	for (int i = 0; i < _levels.size(); i++) {
+		const MapLevel &l = _levels.at(i);
+		stream << l.level << l.bits << l.subdivs;
+	}
+	stream << _subdivSec.offset << _subdivSec.size << _extSec.offset
+	  << _extSec.size << _flags << _extItemSize << (qint32)_firstLevel;
+}
+
+bool TREFile::read(QDataStream &stream)
+{
+	double left, top, right, bottom;
+	quint32 levelsCount, flags;
+	quint16 extItemSize;
+	qint32 firstLevel;
+	Section subdivSec, extSec;
+
+	stream >> left >> top >> right >> bottom >> levelsCount;
+	if (stream.status() != QDataStream::Ok || levelsCount > 16)
+		return false;
+
+	QVector<MapLevel> levels(levelsCount);
+	for (quint32 i = 0; i < levelsCount; i++)
+		stream >> levels[i].level >> levels[i].bits >> levels[i].subdivs;
+	stream >> subdivSec.offset >> subdivSec.size >> extSec.offset
+	  >> extSec.size >> flags >> extItemSize >> firstLevel;
+	if (stream.status() != QDataStream::Ok || firstLevel < 0
+	  || firstLevel >= (qint32)levelsCount)
+		return false;
+
+	RectC bounds(Coordinates(left, top), Coordinates(right, bottom));
+	if (!bounds.isValid())
+		return false;
+
+	_bounds = bounds;
+	_levels = levels;
+	_subdivSec = subdivSec;
+	_extSec = extSec;
+	_flags = flags;
+	_extItemSize = extItemSize;
+	_firstLevel = firstLevel;
+
+	return true;
+}
+
 int TREFile::readExtEntry(Handle &hdl, quint32 &polygons, quint32 &lines,
   quint32 &points)
 {
@@ -4,6 +4,7 @@
 #include <QVector>
 #include <QDebug>
 #include <QRect>
+#include <QDataStream>
 #include "common/rectc.h"
 #include "common/rtree.h"
 #include "section.h"
@@ -27,6 +28,10 @@ public:
 	bool init(QFile *file);
 	void clear();
 
+	/* (De)serialization of the init() data for the tile index */
+	void write(QDataStream &stream) const;
+	bool read(QDataStream &stream);
+
 	const RectC &bounds() const {return _bounds;}
 	QList<SubDiv*> subdivs(QFile *file, const RectC &rect, const Zoom &zoom);
 	quint32 shift(quint8 bits) const
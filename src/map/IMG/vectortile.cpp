@@ -65,6 +65,15 @@ bool VectorTile::initGMP(QFile *file)
 	  && _gmp->readUInt32(hdl, dem)))
 		return false;
 
+	return createGMPFiles(tre, rgn, lbl, net, nod, dem);
+}
+
+bool VectorTile::createGMPFiles(quint32 tre, quint32 rgn, quint32 lbl,
+  quint32 net, quint32 nod, quint32 dem)
+{
+	if (_tre || _rgn || _lbl || _net || _nod || _dem)
+		return false;
+
 	_tre = tre ? new TREFile(_gmp, tre) : 0;
 	_rgn = rgn ? new RGNFile(_gmp, rgn) : 0;
 	_lbl = lbl ? new LBLFile(_gmp, lbl) : 0;
@@ -75,8 +84,48 @@ bool VectorTile::initGMP(QFile *file)
 	return true;
 }
 
-bool VectorTile::load(SubFile::Handle &rgnHdl, SubFile::Handle &lblHdl,
-  SubFile::Handle &netHdl, SubFile::Handle &nodHdl)
+void VectorTile::deleteGMPFiles()
+{
+	delete _tre; delete _rgn; delete _lbl; delete _net; delete _nod;
+	delete _dem;
+
+	_tre = 0; _rgn = 0; _lbl = 0; _net = 0; _nod = 0; _dem = 0;
+}
+
+static quint32 gmpOffset(const SubFile *file)
+{
+	return file ? file->gmpOffset() : 0;
+}
+
+void VectorTile::write(QDataStream &stream) const
+{
+	if (_gmp)
+		stream << gmpOffset(_tre) << gmpOffset(_rgn) << gmpOffset(_lbl)
+		  << gmpOffset(_net) << gmpOffset(_nod) << gmpOffset(_dem);
+	_tre->write(stream);
+}
+
+bool VectorTile::read(QDataStream &stream)
+{
+	if (_gmp) {
+		quint32 tre, rgn, lbl, net, nod, dem;
+
+		stream >> tre >> rgn >> lbl >> net >> nod >> dem;
+		if (stream.status() != QDataStream::Ok
+		  || !createGMPFiles(tre, rgn, lbl, net, nod, dem))
+			return false;
+	}
+
+	if (!(_tre && _rgn && _tre->read(stream))) {
+		if (_gmp)
+			deleteGMPFiles();
+		return false;
+	}
+
+	return true;
+}
+
+bool VectorTile::load(SubFile::Handle &rgnHdl, SubFile::Handle &lblHdl)
 {
 	_loaded = -1;
 
@@ -84,12 +133,26 @@ bool VectorTile::load(SubFile::Handle &rgnHdl, SubFile::Handle &lblHdl,
 		return false;
 	if (_lbl && !_lbl->load(lblHdl, _rgn, rgnHdl))
 		return false;
+
+	_loaded = 1;
+
+	return true;
+}
+
+/* The NET/NOD (routing) data are only required for the lines, so they are
+   loaded on demand when the lines are requested for the first time. A tile
+   with broken routing data is rendered without the links. */
+bool VectorTile::loadNet(SubFile::Handle &netHdl, SubFile::Handle &nodHdl,
+  SubFile::Handle &rgnHdl)
+{
+	_netLoaded = -1;
+
 	if (_net && !_net->load(netHdl, _rgn, rgnHdl))
 		return false;
 	if (_nod && !_nod->load(nodHdl))
 		return false;
 
-	_loaded = 1;
+	_netLoaded = 1;
 
 	return true;
 }
@@ -118,6 +181,7 @@ void VectorTile::clear()
 		_dem->clear();
 
 	_loaded = 0;
+	_netLoaded = 0;
 	_demLoaded = 0;
 }
 
@@ -138,74 +202,82 @@ void VectorTile::polys(QFile *file, const RectC &rect, const Zoom &zoom,
 	if (!_loaded) {
 		rgnHdl = new SubFile::Handle(_rgn, file);
 		lblHdl = new SubFile::Handle(_lbl, file);
-		netHdl = new SubFile::Handle(_net, file);
-		nodHdl = new SubFile::Handle(_nod, file);
 
-		if (!load(*rgnHdl, *lblHdl, *netHdl, *nodHdl)) {
+		if (!load(*rgnHdl, *lblHdl)) {
 			_lock.unlock();
-			delete rgnHdl; delete lblHdl; delete netHdl; delete nodHdl;
+			delete rgnHdl; delete lblHdl;
 			return;
 		}
 	}
 
 	QList<SubDiv*> subdivs = _tre->subdivs(file, rect, zoom);
 
-	cacheLock->lock();
-
 	for (int i = 0; i < subdivs.size(); i++) {
 		SubDiv *subdiv = subdivs.at(i);
 
-		MapData::Polys *polys = cache->object(subdiv);
-		if (!polys) {
-			cacheLock->unlock();
+		cacheLock->lock();
+		MapData::PolysPtr *pp = cache->object(subdiv);
+		MapData::PolysPtr polys(pp ? *pp : MapData::PolysPtr());
+		cacheLock->unlock();
 
+		if (!polys || (lines && !polys->linesLoaded)) {
 			quint32 shift = _tre->shift(subdiv->bits());
 
 			if (!rgnHdl) {
 				rgnHdl = new SubFile::Handle(_rgn, file);
 				lblHdl = new SubFile::Handle(_lbl, file);
-				netHdl = new SubFile::Handle(_net, file);
 			}
+			if (!netHdl)
+				netHdl = new SubFile::Handle(_net, file);
 
-			if (!subdiv->initialized() && !_rgn->subdivInit(*rgnHdl, subdiv)) {
-				cacheLock->lock();
+			if (!subdiv->initialized() && !_rgn->subdivInit(*rgnHdl, subdiv))
 				continue;
-			}
 
-			polys = new MapData::Polys();
+			/* Only the road lines have their labels in the NET file */
+			if (!polys) {
+				polys = MapData::PolysPtr(new MapData::Polys());
 
-			_rgn->polyObjects(*rgnHdl, subdiv, RGNFile::Polygon, _lbl, *lblHdl,
-			  _net, *netHdl, &polys->polygons);
-			_rgn->polyObjects(*rgnHdl, subdiv, RGNFile::Line, _lbl, *lblHdl,
-			  _net, *netHdl, &polys->lines);
-			_rgn->extPolyObjects(*rgnHdl, subdiv, shift, RGNFile::Polygon, _lbl,
-			  *lblHdl, &polys->polygons);
-			_rgn->extPolyObjects(*rgnHdl, subdiv, shift, RGNFile::Line, _lbl,
-			  *lblHdl, &polys->lines);
+				_rgn->polyObjects(*rgnHdl, subdiv, RGNFile::Polygon, _lbl,
+				  *lblHdl, 0, *netHdl, &polys->polygons);
+				_rgn->extPolyObjects(*rgnHdl, subdiv, shift, RGNFile::Polygon,
+				  _lbl, *lblHdl, &polys->polygons);
+			}
 
-			if (_net && _net->hasLinks()) {
+			/* The polys are only accessed with the tile lock held, so the lines
+			   can be added to the already cached polys */
+			if (lines) {
 				if (!nodHdl)
 					nodHdl = new SubFile::Handle(_nod, file);
-				if (!nodHdl2)
-					nodHdl2 = new SubFile::Handle(_nod, file);
-				_rgn->links(*rgnHdl, subdiv, shift, _net, *netHdl, _nod, *nodHdl,
-				  *nodHdl2, _lbl, *lblHdl, &polys->lines);
+				if (!_netLoaded)
+					loadNet(*netHdl, *nodHdl, *rgnHdl);
+				NETFile *net = (_netLoaded > 0) ? _net : 0;
+
+				_rgn->polyObjects(*rgnHdl, subdiv, RGNFile::Line, _lbl, *lblHdl,
+				  net, *netHdl, &polys->lines);
+				_rgn->extPolyObjects(*rgnHdl, subdiv, shift, RGNFile::Line, _lbl,
+				  *lblHdl, &polys->lines);
+
+				if (net && net->hasLinks()) {
+					if (!nodHdl2)
+						nodHdl2 = new SubFile::Handle(_nod, file);
+					_rgn->links(*rgnHdl, subdiv, shift, net, *netHdl, _nod,
+					  *nodHdl, *nodHdl2, _lbl, *lblHdl, &polys->lines);
+				}
+
+				polys->linesLoaded = true;
 			}
 
-			copyPolys(rect, &polys->polygons, polygons);
-			if (lines)
-				copyPolys(rect, &polys->lines, lines);
-
 			cacheLock->lock();
-			cache->insert(subdiv, polys);
-		} else {
-			copyPolys(rect, &polys->polygons, polygons);
-			if (lines)
-				copyPolys(rect, &polys->lines, lines);
+			cache->insert(subdiv, new MapData::PolysPtr(polys),
+			  MapData::cost(polys.data()));
+			cacheLock->unlock();
 		}
+
+		copyPolys(rect, &polys->polygons, polygons);
+		if (lines)
+			copyPolys(rect, &polys->lines, lines);
 	}
 
-	cacheLock->unlock();
 	_lock.unlock();
 
 	delete rgnHdl; delete lblHdl; delete netHdl; delete nodHdl; delete nodHdl2;
@@ -226,10 +298,8 @@ void VectorTile::points(QFile *file, const RectC &rect, const Zoom &zoom,
 	if (!_loaded) {
 		rgnHdl = new SubFile::Handle(_rgn, file);
 		lblHdl = new SubFile::Handle(_lbl, file);
-		SubFile::Handle nodHdl(_nod, file);
-		SubFile::Handle netHdl(_net, file);
 
-		if (!load(*rgnHdl, *lblHdl, netHdl, nodHdl)) {
+		if (!load(*rgnHdl, *lblHdl)) {
 			_lock.unlock();
 			delete rgnHdl; delete lblHdl;
 			return;
@@ -238,42 +308,40 @@ void VectorTile::points(QFile *file, const RectC &rect, const Zoom &zoom,
 
 	QList<SubDiv*> subdivs = _tre->subdivs(file, rect, zoom);
 
-	cacheLock->lock();
-
 	for (int i = 0; i < subdivs.size(); i++) {
 		SubDiv *subdiv = subdivs.at(i);
 
-		QList<MapData::Point> *pl = cache->object(subdiv);
-		if (!pl) {
-			cacheLock->unlock();
+		cacheLock->lock();
+		MapData::PointsPtr *pp = cache->object(subdiv);
+		MapData::PointsPtr pl(pp ? *pp : MapData::PointsPtr());
+		cacheLock->unlock();
 
+		if (!pl) {
 			if (!rgnHdl) {
 				rgnHdl = new SubFile::Handle(_rgn, file);
 				lblHdl = new SubFile::Handle(_lbl, file);
 			}
 
-			if (!subdiv->initialized() && !_rgn->subdivInit(*rgnHdl, subdiv)) {
-				cacheLock->lock();
+			if (!subdiv->initialized() && !_rgn->subdivInit(*rgnHdl, subdiv))
 				continue;
-			}
 
-			pl = new QList<MapData::Point>;
+			pl = MapData::PointsPtr(new QList<MapData::Point>);
 
 			_rgn->pointObjects(*rgnHdl, subdiv, RGNFile::Point, _lbl, *lblHdl,
-			  pl);
+			  pl.data());
 			_rgn->pointObjects(*rgnHdl, subdiv, RGNFile::IndexedPoint, _lbl,
-			  *lblHdl, pl);
-			_rgn->extPointObjects(*rgnHdl, subdiv, _lbl, *lblHdl, pl);
-
-			copyPoints(rect, pl, points);
+			  *lblHdl, pl.data());
+			_rgn->extPointObjects(*rgnHdl, subdiv, _lbl, *lblHdl, pl.data());
 
 			cacheLock->lock();
-			cache->insert(subdiv, pl);
-		} else
-			copyPoints(rect, pl, points);
+			cache->insert(subdiv, new MapData::PointsPtr(pl),
+			  MapData::cost(pl.data()));
+			cacheLock->unlock();
+		}
+
+		copyPoints(rect, pl.data(), points);
 	}
 
-	cacheLock->unlock();
 	_lock.unlock();
 
 	delete rgnHdl; delete lblHdl;
@@ -14,7 +14,7 @@ class VectorTile {
 public:
 	VectorTile()
 	  : _tre(0), _rgn(0), _lbl(0), _net(0), _nod(0), _dem(0), _gmp(0),
-		_loaded(0), _demLoaded(0) {}
+		_loaded(0), _netLoaded(0), _demLoaded(0) {}
 	~VectorTile()
 	{
 		delete _tre; delete _rgn; delete _lbl; delete _net; delete _nod;
@@ -24,6 +24,11 @@ public:
 	bool init(QFile *file = 0);
 	void clear();
 
+	/* Tile index (de)serialization of the init() data. A tile that failed to
+	   read() is left in its initial state and can still be init()ed. */
+	void write(QDataStream &stream) const;
+	bool read(QDataStream &stream);
+
 	const RectC &bounds() const {return _tre->bounds();}
 	QVector<Zoom> zooms() const {return _tre->zooms();}
 	bool hasDem() const {return _dem != 0;}
@@ -92,8 +97,12 @@ public:
 
 private:
 	bool initGMP(QFile *file);
-	bool load(SubFile::Handle &rgnHdl, SubFile::Handle &lblHdl,
-	  SubFile::Handle &netHdl, SubFile::Handle &nodHdl);
+	bool createGMPFiles(quint32 tre, quint32 rgn, quint32 lbl, quint32 net,
+	  quint32 nod, quint32 dem);
+	void deleteGMPFiles();
+	bool load(SubFile::Handle &rgnHdl, SubFile::Handle &lblHdl);
+	bool loadNet(SubFile::Handle &netHdl, SubFile::Handle &nodHdl,
+	  SubFile::Handle &rgnHdl);
 	bool loadDem(SubFile::Handle &demHdl);
 
 	TREFile *_tre;
@@ -104,7 +113,7 @@ private:
 	DEMFile *_dem;
 	SubFile *_gmp;
 
-	int _loaded, _demLoaded;
+	int _loaded, _netLoaded, _demLoaded;
 	QMutex _lock, _demLock;
 };
 
@@ -33,7 +33,7 @@ private:
 
 inline HASH_T qHash(const Zoom &zoom)
 {
-	return ::qHash(zoom.level()) ^ ::qHash(zoom.bits());
+	return Hash::key(zoom.level(), zoom.bits());
 }
 
 }
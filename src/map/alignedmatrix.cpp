@@ -0,0 +1,57 @@
+#include <QMutex>
+#include <QList>
+#include "alignedmatrix.h"
+
+#define POOL_LIMIT 16777216 /* 16 MB */
+
+struct Buffer
+{
+	Buffer(void *ptr, size_t size) : ptr(ptr), size(size) {}
+
+	void *ptr;
+	size_t size;
+};
+
+static QMutex lock;
+static QList<Buffer> buffers;
+static size_t pooled = 0;
+
+void *MatrixPool::alloc(size_t size, size_t *capacity)
+{
+	lock.lock();
+	/* Accept a buffer up to twice the requested size to avoid holding big
+	   buffers by small matrixes */
+	for (int i = 0; i < buffers.size(); i++) {
+		const Buffer &b = buffers.at(i);
+		if (b.size >= size && b.size <= 2 * size) {
+			void *ptr = b.ptr;
+			*capacity = b.size;
+			pooled -= b.size;
+			buffers.removeAt(i);
+			lock.unlock();
+			return ptr;
+		}
+	}
+	lock.unlock();
+
+	*capacity = size;
+	return qMallocAligned(size, MATRIX_ALIGNMENT);
+}
+
+void MatrixPool::release(void *ptr, size_t capacity)
+{
+	lock.lock();
+	if (capacity <= POOL_LIMIT) {
+		while (pooled + capacity > POOL_LIMIT) {
+			qFreeAligned(buffers.first().ptr);
+			pooled -= buffers.first().size;
+			buffers.removeFirst();
+		}
+		buffers.append(Buffer(ptr, capacity));
+		pooled += capacity;
+		ptr = 0;
+	}
+	lock.unlock();
+
+	qFreeAligned(ptr);
+}
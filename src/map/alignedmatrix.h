@@ -0,0 +1,125 @@
+#ifndef ALIGNEDMATRIX_H
+#define ALIGNEDMATRIX_H
+
+#include <cstring>
+#include <QtGlobal>
+#include "matrix.h"
+
+#define MATRIX_ALIGNMENT 64
+
+/* Pool of the aligned matrix buffers. The per-tile temporaries (blur passes,
+   hillshading input) have mostly the same size, so the released buffers are
+   kept (up to a size limit) and reused by the following allocations. */
+class MatrixPool
+{
+public:
+	static void *alloc(size_t size, size_t *capacity);
+	static void release(void *ptr, size_t capacity);
+};
+
+/* Matrix of plain numeric values with every row aligned to MATRIX_ALIGNMENT
+   bytes. The rows are padded to the alignment (stride() >= w()), so the row
+   pointers can be used with vector loads and no element access is bound
+   checked. */
+template <class T>
+class AlignedMatrix
+{
+public:
+	AlignedMatrix() : _m(0), _capacity(0), _h(0), _w(0), _stride(0) {}
+	AlignedMatrix(int h, int w) {init(h, w);}
+	AlignedMatrix(int h, int w, const T &val) {init(h, w); fill(val);}
+	AlignedMatrix(const AlignedMatrix &other)
+	{
+		init(other._h, other._w);
+		if (_m)
+			memcpy(_m, other._m, _h * _stride * sizeof(T));
+	}
+	template <class U> explicit AlignedMatrix(const Matrix<U> &other)
+	{
+		init(other.h(), other.w());
+		for (int i = 0; i < _h; i++) {
+			const U *src = other.row(i);
+			T *dst = row(i);
+			for (int j = 0; j < _w; j++)
+				dst[j] = src[j];
+		}
+	}
+	~AlignedMatrix()
+	{
+		if (_m)
+			MatrixPool::release(_m, _capacity);
+	}
+
+	AlignedMatrix &operator=(const AlignedMatrix &other)
+	{
+		if (this != &other) {
+			if (other._h * other._stride * sizeof(T) > _capacity) {
+				if (_m)
+					MatrixPool::release(_m, _capacity);
+				init(other._h, other._w);
+			} else {
+				_h = other._h;
+				_w = other._w;
+				_stride = other._stride;
+			}
+			if (_m)
+				memcpy(_m, other._m, _h * _stride * sizeof(T));
+		}
+
+		return *this;
+	}
+
+	int h() const {return _h;}
+	int w() const {return _w;}
+	int stride() const {return _stride;}
+	bool isNull() const {return (_h == 0 || _w == 0);}
+
+	T *row(int i) {return _m + i * _stride;}
+	const T *row(int i) const {return _m + i * _stride;}
+	T &at(int i, int j) {return _m[i * _stride + j];}
+	const T &at(int i, int j) const {return _m[i * _stride + j];}
+
+	void fill(const T &val)
+	{
+		for (int i = 0; i < _h; i++) {
+			T *r = row(i);
+			for (int j = 0; j < _w; j++)
+				r[j] = val;
+		}
+	}
+
+	template <class U> void copyTo(Matrix<U> &m) const
+	{
+		Q_ASSERT(m.h() == _h && m.w() == _w);
+
+		for (int i = 0; i < _h; i++) {
+			const T *src = row(i);
+			U *dst = m.row(i);
+			for (int j = 0; j < _w; j++)
+				dst[j] = src[j];
+		}
+	}
+
+private:
+	void init(int h, int w)
+	{
+		int n = MATRIX_ALIGNMENT / sizeof(T);
+
+		_h = h;
+		_w = w;
+		_stride = ((w + n - 1) / n) * n;
+		_m = (h && w) ? (T*)MatrixPool::alloc(h * _stride * sizeof(T),
+		  &_capacity) : 0;
+		if (!_m)
+			_capacity = 0;
+	}
+
+	T *_m;
+	size_t _capacity;
+	int _h, _w, _stride;
+};
+
+typedef AlignedMatrix<double> AlignedMatrixD;
+typedef AlignedMatrix<float> AlignedMatrixF;
+
+#endif // ALIGNEDMATRIX_H
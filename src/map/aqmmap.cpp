@@ -1,11 +1,10 @@
 #include <cctype>
 #include <QPainter>
-#include <QPixmapCache>
 #include <QImageReader>
 #include <QBuffer>
-#include <QtConcurrent>
+#include "common/threadpools.h"
 #include "osm.h"
-#include "tile.h"
+#include "tileorder.h"
 #include "aqmmap.h"
 
 
@@ -267,7 +266,10 @@ void AQMMap::load(const Projection &in, const Projection &out,
 
 void AQMMap::unload()
 {
+	cancelJobs(true);
+
 	_file.close();
+	_tileCache.clear();
 }
 
 QRectF AQMMap::bounds()
@@ -303,12 +305,16 @@ qreal AQMMap::resolution(const QRectF &rect)
 
 int AQMMap::zoomIn()
 {
+	cancelJobs(false);
+
 	_zoom = qMin(_zoom + 1, _zooms.size() - 1);
 	return _zoom;
 }
 
 int AQMMap::zoomOut()
 {
+	cancelJobs(false);
+
 	_zoom = qMax(_zoom - 1, 0);
 	return _zoom;
 }
@@ -333,9 +339,11 @@ qreal AQMMap::tileSize() const
 	return (_zooms.at(_zoom).tileSize / _mapRatio);
 }
 
-QByteArray AQMMap::tileData(const QPoint &tile)
+/* Called from the tile loading threads, the zoom is the zoom index */
+QByteArray AQMMap::tileData(int zoom, const QPoint &tile)
 {
-	const Zoom &z = _zooms.at(_zoom);
+	const Zoom &z = _zooms.at(zoom);
+	QMutexLocker locker(&_lock);
 	QByteArray ba;
 
 	size_t offset = z.tiles.value(tile);
@@ -347,7 +355,6 @@ QByteArray AQMMap::tileData(const QPoint &tile)
 
 void AQMMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 {
-	Q_UNUSED(flags);
 	const Zoom &z = _zooms.at(_zoom);
 	qreal scale = OSM::zoom2scale(z.zoom, z.tileSize);
 	QPoint tile = OSM::mercator2tile(QPointF(rect.topLeft().x() * scale,
@@ -364,19 +371,31 @@ void AQMMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		for (int j = 0; j < height; j++) {
 			QPixmap pm;
 			QPoint t(tile.x() + i, tile.y() + j);
-			QString key = path() + "-" + QString::number(z.zoom) + "_"
-			  + QString::number(t.x()) + "_" + QString::number(t.y());
+			quint64 key = TileCache::key(z.zoom, t);
+
+			if (isRunning(key))
+				continue;
 
-			if (QPixmapCache::find(key, &pm)) {
+			if (_tileCache.find(key, &pm, _mapRatio)) {
 				QPointF tp(tl.x() + (t.x() - tile.x()) * tileSize(),
 				  tl.y() + (t.y() - tile.y()) * tileSize());
 				drawTile(painter, pm, tp);
-			} else
-				tiles.append(DataTile(t, tileData(t), key));
+			} else if (z.tiles.contains(t))
+				tiles.append(DataTile(t, _zoom, this, key));
 		}
 	}
 
-	QFuture<void> future = QtConcurrent::map(tiles, &DataTile::load);
+	if (tiles.isEmpty())
+		return;
+	if (!(flags & Map::Block)) {
+		std::sort(tiles.begin(), tiles.end(), TileOrder<DataTile>(QPointF(
+		  tile.x() + (width - 1) / 2.0, tile.y() + (height - 1) / 2.0)));
+		runJob(new DataTileJob(tiles));
+		return;
+	}
+
+	QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+	  tiles, &DataTile::load);
 	future.waitForFinished();
 
 	for (int i = 0; i < tiles.size(); i++) {
@@ -385,7 +404,7 @@ void AQMMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		if (pm.isNull())
 			continue;
 
-		QPixmapCache::insert(mt.key(), pm);
+		_tileCache.insert(mt.key(), pm);
 
 		QPointF tp(tl.x() + (mt.xy().x() - tile.x()) * tileSize(),
 		  tl.y() + (mt.xy().y() - tile.y()) * tileSize());
@@ -399,6 +418,63 @@ void AQMMap::drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp)
 	painter->drawPixmap(tp, pixmap);
 }
 
+bool AQMMap::isRunning(quint64 key) const
+{
+	for (int i = 0; i < _jobs.size(); i++) {
+		const QList<DataTile> &tiles = _jobs.at(i)->tiles();
+		for (int j = 0; j < tiles.size(); j++)
+			if (tiles.at(j).key() == key)
+				return true;
+	}
+
+	return false;
+}
+
+void AQMMap::runJob(DataTileJob *job)
+{
+	_jobs.append(job);
+
+	connect(job, &DataTileJob::finished, this, &AQMMap::jobFinished);
+	job->run();
+}
+
+void AQMMap::removeJob(DataTileJob *job)
+{
+	_jobs.removeOne(job);
+	job->deleteLater();
+}
+
+void AQMMap::jobFinished(DataTileJob *job)
+{
+	const QList<DataTile> &tiles = job->tiles();
+
+	for (int i = 0; i < tiles.size(); i++) {
+		const DataTile &mt = tiles.at(i);
+		if (!mt.pixmap().isNull())
+			_tileCache.insert(mt.key(), mt.pixmap());
+	}
+
+	removeJob(job);
+
+	emit tilesLoaded();
+}
+
+void AQMMap::cancelJobs(bool wait)
+{
+	for (int i = 0; i < _jobs.size(); i++)
+		_jobs.at(i)->cancel(wait);
+
+	/* Waiting cancels (unload) drop the jobs including the results of the
+	   jobs that finished but whose finished signal is still queued */
+	if (wait) {
+		while (!_jobs.isEmpty()) {
+			DataTileJob *job = _jobs.first();
+			job->disconnect(this);
+			removeJob(job);
+		}
+	}
+}
+
 Map *AQMMap::create(const QString &path, const Projection &proj, bool *isDir)
 {
 	Q_UNUSED(proj);
@@ -4,9 +4,12 @@
 #include <QDebug>
 #include <QFile>
 #include <QHash>
+#include <QMutex>
 #include "map.h"
+#include "tilecache.h"
+#include "datatilejob.h"
 
-class AQMMap : public Map
+class AQMMap : public Map, public DataTileSource
 {
 public:
 	Q_OBJECT
@@ -21,7 +24,7 @@ public:
 	qreal resolution(const QRectF &rect);
 
 	int zoom() const {return _zoom;}
-	void setZoom(int zoom) {_zoom = zoom;}
+	void setZoom(int zoom) {cancelJobs(false); _zoom = zoom;}
 	int zoomFit(const QSize &size, const RectC &rect);
 	int zoomIn();
 	int zoomOut();
@@ -40,6 +43,11 @@ public:
 
 	static Map *create(const QString &path, const Projection &proj, bool *isDir);
 
+	QByteArray tileData(int zoom, const QPoint &tile);
+
+private slots:
+	void jobFinished(DataTileJob *job);
+
 private:
 	struct File {
 		QByteArray name;
@@ -62,18 +70,24 @@ private:
 	bool readHeader();
 
 	qreal tileSize() const;
-	QByteArray tileData(const QPoint &tile);
 	void drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp);
+	bool isRunning(quint64 key) const;
+	void runJob(DataTileJob *job);
+	void removeJob(DataTileJob *job);
+	void cancelJobs(bool wait);
 
 	friend QDebug operator<<(QDebug dbg, const File &file);
 	friend QDebug operator<<(QDebug dbg, const Zoom &zoom);
 
 	QString _name;
 	QFile _file;
+	QMutex _lock;
 	QVector<Zoom> _zooms;
 	int _zoom;
 	RectC _bounds;
 	qreal _mapRatio;
+	TileCache _tileCache;
+	QList<DataTileJob*> _jobs;
 
 	bool _valid;
 	QString _errorString;
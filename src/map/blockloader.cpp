@@ -0,0 +1,337 @@
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QEventLoop>
+#include <QCryptographicHash>
+#include <QMutexLocker>
+#include <algorithm>
+#include "blockloader.h"
+
+#define BLOCK_SIZE     65536
+#define MAX_BLOCKS     16 /* blocks per request */
+#define MAX_CACHE_SIZE 262144 /* KB */
+#define SPAN_SUFFIX    ".span"
+#define KEY_FILE       "version"
+#define VALIDATE_FILE  "validate"
+#define DEFAULT_KEY    "default"
+
+static QByteArray validatorKey(const Validators &validators)
+{
+	const QByteArray &v = validators.etag().isEmpty()
+	  ? validators.lastModified() : validators.etag();
+
+	return v.isEmpty() ? QByteArray()
+	  : QCryptographicHash::hash(v, QCryptographicHash::Sha1).toHex();
+}
+
+static qint64 dirSize(const QString &path)
+{
+	QFileInfoList list(QDir(path).entryInfoList(QDir::Files));
+	qint64 size = 0;
+
+	for (int i = 0; i < list.size(); i++)
+		size += list.at(i).size();
+
+	return size;
+}
+
+BlockLoader::BlockLoader(const QUrl &url, const QString &dir, QObject *parent)
+  : QObject(parent), _url(url), _baseDir(dir), _size(0)
+{
+	QFile kf(QDir(_baseDir).filePath(KEY_FILE));
+	if (kf.open(QIODevice::ReadOnly))
+		_key = kf.readAll().trimmed();
+
+	_dir = QDir(_baseDir).filePath(_key.isEmpty()
+	  ? QString(DEFAULT_KEY) : QString::fromLatin1(_key));
+	if (!QDir().mkpath(_dir))
+		qWarning("%s: %s", qUtf8Printable(_dir),
+		  "Error creating blocks directory");
+	_size = dirSize(_dir);
+
+	_downloader = new Downloader(this);
+	connect(_downloader, &Downloader::downloaded, this,
+	  &BlockLoader::blocksDownloaded);
+	connect(_downloader, &Downloader::finished, this, &BlockLoader::finished);
+}
+
+QString BlockLoader::dir() const
+{
+	QMutexLocker locker(&_lock);
+	return _dir;
+}
+
+QString BlockLoader::blockFile(const QString &dir, quint64 block)
+{
+	return QDir(dir).filePath(QString::number(block));
+}
+
+QString BlockLoader::blockFile(quint64 block) const
+{
+	return blockFile(_dir, block);
+}
+
+bool BlockLoader::isCached(quint64 offset, quint64 size) const
+{
+	if (!size)
+		return true;
+
+	QString bd(dir());
+	for (quint64 i = offset / BLOCK_SIZE; i <= (offset + size - 1) / BLOCK_SIZE;
+	  i++)
+		if (!QFileInfo::exists(blockFile(bd, i)))
+			return false;
+
+	return true;
+}
+
+QByteArray BlockLoader::read(quint64 offset, quint64 size) const
+{
+	QByteArray ba;
+
+	if (!size)
+		return ba;
+
+	/* The blocks directory is switched by setKey() on the GUI thread, all
+	   the blocks are read from the directory valid at the start. Blocks
+	   removed in the meantime fail the read like the missing ones. */
+	QString bd(dir());
+	ba.reserve(size);
+	for (quint64 i = offset / BLOCK_SIZE; i <= (offset + size - 1) / BLOCK_SIZE;
+	  i++) {
+		QFile file(blockFile(bd, i));
+		qint64 pos = (i == offset / BLOCK_SIZE) ? offset % BLOCK_SIZE : 0;
+		qint64 len = qMin((qint64)(BLOCK_SIZE - pos),
+		  (qint64)(size - ba.size()));
+
+		if (!file.open(QIODevice::ReadOnly) || !file.seek(pos))
+			return QByteArray();
+		QByteArray data(file.read(len));
+		if (data.size() != len)
+			return QByteArray();
+		ba.append(data);
+	}
+
+	return ba;
+}
+
+/* The missing blocks are grouped into runs of adjacent blocks, every run is
+   downloaded using a single range request. Single blocks are downloaded
+   directly to the block files, the longer runs to a temporary "span" file
+   that is split into the blocks once downloaded. */
+QList<Download> BlockLoader::downloads(const QList<Range> &list) const
+{
+	QList<quint64> blocks;
+	QList<Download> dl;
+
+	for (int i = 0; i < list.size(); i++) {
+		const Range &r = list.at(i);
+		if (!r.size)
+			continue;
+		for (quint64 j = r.offset / BLOCK_SIZE;
+		  j <= (r.offset + r.size - 1) / BLOCK_SIZE; j++)
+			if (!QFileInfo::exists(blockFile(j)))
+				blocks.append(j);
+	}
+	std::sort(blocks.begin(), blocks.end());
+	blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+
+	for (int i = 0; i < blocks.size(); ) {
+		quint64 first = blocks.at(i);
+		int count = 1;
+		while (i + count < blocks.size() && count < MAX_BLOCKS
+		  && blocks.at(i + count) == first + count)
+			count++;
+
+		/* The URL must be unique for every range, the fragment is not sent
+		   to the server */
+		QUrl url(_url);
+		url.setFragment(QString("%1-%2").arg(first).arg(count));
+		QString file((count > 1)
+		  ? blockFile(first) + "-" + QString::number(count) + SPAN_SUFFIX
+		  : blockFile(first));
+		dl.append(Download(url, file, first * BLOCK_SIZE,
+		  (quint64)count * BLOCK_SIZE));
+
+		i += count;
+	}
+
+	return dl;
+}
+
+/* Switches the cache to another version of the remote file, the blocks of all
+   the other versions are removed */
+void BlockLoader::setKey(const QByteArray &key)
+{
+	QDir base(_baseDir);
+
+	_key = key;
+	_lock.lock();
+	_dir = base.filePath(QString::fromLatin1(key));
+	_lock.unlock();
+
+	QFileInfoList list(base.entryInfoList(QDir::Files | QDir::Dirs
+	  | QDir::NoDotAndDotDot));
+	for (int i = 0; i < list.size(); i++) {
+		const QFileInfo &fi = list.at(i);
+		if (fi.fileName().startsWith(VALIDATE_FILE)
+		  || fi.absoluteFilePath() == QFileInfo(_dir).absoluteFilePath())
+			continue;
+		if (fi.isDir())
+			QDir(fi.absoluteFilePath()).removeRecursively();
+		else
+			QFile::remove(fi.absoluteFilePath());
+	}
+
+	if (!QDir().mkpath(_dir))
+		qWarning("%s: %s", qUtf8Printable(_dir),
+		  "Error creating blocks directory");
+	_size = dirSize(_dir);
+
+	QSaveFile kf(base.filePath(KEY_FILE));
+	if (!kf.open(QIODevice::WriteOnly) || kf.write(key) != key.size()
+	  || !kf.commit())
+		qWarning("%s: %s", qUtf8Printable(kf.fileName()),
+		  qUtf8Printable(kf.errorString()));
+}
+
+/* The blocks are evicted in the download order. The first block, holding the
+   file header, is kept. */
+void BlockLoader::evict()
+{
+	QFileInfoList list(QDir(_dir).entryInfoList(QDir::Files,
+	  QDir::Time | QDir::Reversed));
+	qint64 limit = (MAX_CACHE_SIZE * 1024LL / 4) * 3;
+
+	for (int i = 0; i < list.size() && _size > limit; i++) {
+		const QFileInfo &fi = list.at(i);
+		bool ok;
+		quint64 block = fi.fileName().toULongLong(&ok);
+
+		if (!ok || !block)
+			continue;
+		if (QFile::remove(fi.absoluteFilePath()))
+			_size -= fi.size();
+	}
+}
+
+void BlockLoader::blocksDownloaded(const QString &file,
+  const Validators &validators)
+{
+	QByteArray key(validatorKey(validators));
+	QFileInfo fi(file);
+
+	if (fi.fileName() == VALIDATE_FILE) {
+		bool changed = false;
+
+		if (!key.isEmpty() && key != _key) {
+			changed = (_size > 0);
+			setKey(key);
+		}
+		/* The validation range is the first block of the file */
+		QString bf(blockFile(0));
+		if (QFileInfo::exists(bf) || !QFile::rename(file, bf))
+			QFile::remove(file);
+		else
+			_size += QFileInfo(bf).size();
+
+		if (changed)
+			emit changed();
+		return;
+	}
+
+	/* Downloads started before a version switch */
+	if (fi.absolutePath() != QFileInfo(_dir).absoluteFilePath()) {
+		QFile::remove(file);
+		return;
+	}
+	/* The remote file has changed since the cache was validated */
+	if (!key.isEmpty() && key != _key) {
+		bool changed = (_size > 0);
+		QFile::remove(file);
+		setKey(key);
+		if (changed)
+			emit changed();
+		return;
+	}
+
+	if (!file.endsWith(SPAN_SUFFIX)) {
+		_size += fi.size();
+		if (_size > MAX_CACHE_SIZE * 1024LL)
+			evict();
+		return;
+	}
+
+	QString name(QFileInfo(file).fileName());
+	QStringList span(name.left(name.size() - (sizeof(SPAN_SUFFIX) - 1))
+	  .split('-'));
+	bool ok;
+	quint64 first = span.first().toULongLong(&ok);
+
+	QFile sf(file);
+	if (ok && span.size() == 2 && sf.open(QIODevice::ReadOnly)) {
+		QByteArray data(sf.readAll());
+
+		/* The block files are read by the tile loading threads, they must
+		   appear atomically */
+		for (qint64 pos = 0, i = 0; pos < data.size(); pos += BLOCK_SIZE, i++) {
+			QSaveFile bf(blockFile(first + i));
+			qint64 len = qMin((qint64)BLOCK_SIZE, data.size() - pos);
+
+			if (!bf.open(QIODevice::WriteOnly)
+			  || bf.write(data.constData() + pos, len) != len || !bf.commit())
+				qWarning("%s: %s", qUtf8Printable(bf.fileName()),
+				  qUtf8Printable(bf.errorString()));
+			else
+				_size += len;
+		}
+	}
+
+	sf.remove();
+
+	if (_size > MAX_CACHE_SIZE * 1024LL)
+		evict();
+}
+
+bool BlockLoader::loadAsync(const QList<Range> &list)
+{
+	QList<Download> dl(downloads(list));
+
+	_downloader->cancel(Downloader::Visible);
+
+	return dl.isEmpty() ? false : _downloader->get(dl, _headers);
+}
+
+void BlockLoader::loadSync(const QList<Range> &list)
+{
+	QList<Download> dl(downloads(list));
+
+	if (!dl.isEmpty()) {
+		QEventLoop wait;
+		connect(_downloader, &Downloader::finished, &wait, &QEventLoop::quit);
+		if (_downloader->get(dl, _headers))
+			wait.exec();
+	}
+}
+
+bool BlockLoader::validate()
+{
+	QUrl url(_url);
+	url.setFragment(VALIDATE_FILE);
+
+	return _downloader->get(QList<Download>() << Download(url,
+	  QDir(_baseDir).filePath(VALIDATE_FILE), 0, BLOCK_SIZE), _headers);
+}
+
+void BlockLoader::clearCache()
+{
+	QDir dir = QDir(_dir);
+
+	QStringList list = dir.entryList(QDir::Files);
+	for (int i = 0; i < list.count(); i++)
+		dir.remove(list.at(i));
+	_size = 0;
+
+	_downloader->clearErrors();
+}
@@ -0,0 +1,71 @@
+#ifndef BLOCKLOADER_H
+#define BLOCKLOADER_H
+
+#include <QObject>
+#include <QUrl>
+#include <QList>
+#include <QMutex>
+#include "downloader.h"
+
+/* Random access to a remote file using HTTP range requests. The file is split
+   into fixed size blocks that are downloaded on demand and kept in a local
+   disk cache, adjacent missing blocks are downloaded in a single request.
+   The cache is keyed by the file's HTTP validator (ETag/Last-Modified), blocks
+   of a different version of the file are never mixed. */
+class BlockLoader : public QObject
+{
+	Q_OBJECT
+
+public:
+	struct Range {
+		Range() : offset(0), size(0) {}
+		Range(quint64 offset, quint64 size) : offset(offset), size(size) {}
+
+		quint64 offset;
+		quint64 size;
+	};
+
+	BlockLoader(const QUrl &url, const QString &dir, QObject *parent = 0);
+
+	void setHeaders(const QList<HTTPHeader> &headers) {_headers = headers;}
+	void setNetworkProfile(const NetworkProfile &profile)
+	  {_downloader->setProfile(profile);}
+
+	bool isCached(quint64 offset, quint64 size) const;
+	/* Returns a null array when some of the blocks are not cached. Called
+	   from the tile loading threads, must be thread-safe. */
+	QByteArray read(quint64 offset, quint64 size) const;
+	/* Returns false when no download could be started */
+	bool loadAsync(const QList<Range> &list);
+	void loadSync(const QList<Range> &list);
+	/* Checks the cached blocks against the remote file, changed() is emitted
+	   when the remote file has changed */
+	bool validate();
+	void clearCache();
+
+signals:
+	void finished();
+	void changed();
+
+private slots:
+	void blocksDownloaded(const QString &file, const Validators &validators);
+
+private:
+	static QString blockFile(const QString &dir, quint64 block);
+	QString blockFile(quint64 block) const;
+	QString dir() const;
+	QList<Download> downloads(const QList<Range> &list) const;
+	void setKey(const QByteArray &key);
+	void evict();
+
+	Downloader *_downloader;
+	QUrl _url;
+	QString _baseDir, _dir;
+	/* Guards _dir against the tile loading threads */
+	mutable QMutex _lock;
+	QByteArray _key;
+	qint64 _size;
+	QList<HTTPHeader> _headers;
+};
+
+#endif // BLOCKLOADER_H
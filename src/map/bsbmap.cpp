@@ -1,8 +1,9 @@
 #include <cctype>
+#include <cmath>
 #include <QFileInfo>
 #include <QPainter>
+#include <QtEndian>
 #include "common/color.h"
-#include "image.h"
 #include "gcs.h"
 #include "pcs.h"
 #include "calibrationpoint.h"
@@ -10,6 +11,7 @@
 
 
 #define LINE_LIMIT 1024
+#define TILE_SIZE  256
 
 static inline bool isEOH(const QByteArray &line)
 {
@@ -268,13 +270,13 @@ bool BSBMap::createTransform(QList<ReferencePoint> &points)
 	if (_skew > 0.0 && _skew < 360.0) {
 		QTransform matrix;
 		matrix.rotate(-_skew);
-		QTransform t(QImage::trueMatrix(matrix, _size.width(), _size.height()));
+		_skewMatrix = QImage::trueMatrix(matrix, _size.width(), _size.height());
 
 		for (int i = 0; i < points.size(); i++)
-			points[i].setXY(t.map(points.at(i).xy().toPointF()));
+			points[i].setXY(_skewMatrix.map(points.at(i).xy().toPointF()));
 
 		QPolygonF a(QRectF(0, 0, _size.width(), _size.height()));
-		a = t.map(a);
+		a = _skewMatrix.map(a);
 		_skewSize = a.boundingRect().toAlignedRect().size();
 	}
 
@@ -367,30 +369,101 @@ bool BSBMap::readRow(QFile &file, char bits, uchar *buf)
 	return true;
 }
 
-QImage BSBMap::readImage()
+bool BSBMap::readIndex()
 {
-	QFile file(path());
-	char bits;
+	int height = _size.height();
+	qint64 size = _file.size();
+	quint32 offset;
+
+	/* The KAP files end with a table of the rows offsets followed by the
+	   offset of the table */
+	_index.resize(height);
+	if (_file.seek(size - 4) && _file.read((char*)&offset, 4) == 4) {
+		offset = qFromBigEndian(offset);
+		if (offset > _dataOffset && size - 4 - offset == 4LL * height
+		  && _file.seek(offset)) {
+			QByteArray table(_file.read(4LL * height));
+			const uchar *data = (const uchar*)table.constData();
+			bool ok = (table.size() == 4 * height);
+
+			for (int i = 0; ok && i < height; i++) {
+				_index[i] = qFromBigEndian<quint32>(data + 4 * i);
+				ok = (_index.at(i) > _dataOffset && _index.at(i) < offset
+				  && (!i || _index.at(i) > _index.at(i-1)));
+			}
+			if (ok)
+				return true;
+		}
+	}
+
+	/* Missing/broken index, find the rows by reading the whole image */
+	QByteArray row(_size.width(), 0);
+	if (!_file.seek(_dataOffset + 1))
+		return false;
+	for (int i = 0; i < height; i++) {
+		_index[i] = _file.pos();
+		if (!readRow(_file, _bits, (uchar*)row.data()))
+			return false;
+	}
+
+	return true;
+}
 
-	if (!file.open(QIODevice::ReadOnly))
-		return QImage();
-	if (!(file.seek(_dataOffset) && file.getChar(&bits)))
-		return QImage();
+bool BSBMap::loadRows(int top, int bottom)
+{
+	if (!_rows.isNull() && top >= _rowsTop
+	  && bottom <= _rowsTop + _rows.height())
+		return true;
 
-	QImage img(_size, QImage::Format_Indexed8);
+	QImage img(_size.width(), bottom - top, QImage::Format_Indexed8);
+	if (img.isNull() || !_file.seek(_index.at(top)))
+		return false;
 	img.setColorTable(_palette);
 
-	for (int row = 0; row < _size.height(); row++) {
-		uchar *bsb_row = img.scanLine(row);
-		if (!readRow(file, bits, bsb_row))
-			return QImage();
-	}
+	for (int row = top; row < bottom; row++)
+		if (!readRow(_file, _bits, img.scanLine(row - top)))
+			return false;
+
+	_rows = img;
+	_rowsTop = top;
+
+	return true;
+}
+
+QRect BSBMap::sourceRect(const QRect &rect) const
+{
+	QRect bounds(QPoint(0, 0), _size);
+
+	return _skewSize.isValid()
+	  ? _skewMatrix.inverted().mapRect(QRectF(rect)).toAlignedRect() & bounds
+	  : rect & bounds;
+}
+
+QPixmap BSBMap::tile(const QPoint &xy)
+{
+	QRect tr(xy * TILE_SIZE, QSize(TILE_SIZE, TILE_SIZE));
+	QRect sr(sourceRect(tr));
+
+	if (sr.isEmpty() || !loadRows(sr.top(), sr.bottom() + 1))
+		return QPixmap();
+
+	if (!_skewSize.isValid())
+		return QPixmap::fromImage(_rows.copy(sr.translated(0, -_rowsTop)));
 
-	return img;
+	QImage img(tr.size(), QImage::Format_ARGB32_Premultiplied);
+	img.fill(Qt::transparent);
+	QPainter p(&img);
+	p.setTransform(_skewMatrix * QTransform::fromTranslate(-tr.left(),
+	  -tr.top()));
+	p.drawImage(sr.topLeft(), _rows, sr.translated(0, -_rowsTop));
+	p.end();
+
+	return QPixmap::fromImage(img);
 }
 
 BSBMap::BSBMap(const QString &fileName, QObject *parent)
-  : Map(fileName, parent), _img(0), _mapRatio(1.0), _dataOffset(-1), _valid(false)
+  : Map(fileName, parent), _mapRatio(1.0), _dataOffset(-1), _bits(0),
+  _rowsTop(0), _valid(false)
 {
 	QFile file(fileName);
 
@@ -409,7 +482,6 @@ BSBMap::BSBMap(const QString &fileName, QObject *parent)
 
 BSBMap::~BSBMap()
 {
-	delete _img;
 }
 
 QPointF BSBMap::ll2xy(const Coordinates &c)
@@ -431,8 +503,54 @@ QRectF BSBMap::bounds()
 
 void BSBMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 {
-	if (_img)
-		_img->draw(painter, rect, flags);
+	Q_UNUSED(flags);
+
+	if (!_file.isOpen())
+		return;
+
+	QSize size(_skewSize.isValid() ? _skewSize : _size);
+	QRectF sr(rect.topLeft() * _mapRatio, rect.size() * _mapRatio);
+	int left = qMax(0, (int)floor(sr.left() / TILE_SIZE));
+	int top = qMax(0, (int)floor(sr.top() / TILE_SIZE));
+	int right = qMin((size.width() - 1) / TILE_SIZE,
+	  (int)floor(sr.right() / TILE_SIZE));
+	int bottom = qMin((size.height() - 1) / TILE_SIZE,
+	  (int)floor(sr.bottom() / TILE_SIZE));
+
+	/* The tiles are processed by rows so that all the missing tiles of a row
+	   are created from a single range of decoded image rows */
+	for (int j = top; j <= bottom; j++) {
+		bool decoded = false;
+
+		for (int i = left; i <= right; i++) {
+			QPixmap pm;
+			QPoint t(i, j);
+			quint64 key = TileCache::key(0, t);
+
+			if (!_tileCache.find(key, &pm, _mapRatio)) {
+				if (!decoded) {
+					QRect rr(sourceRect(QRect(QPoint(i * TILE_SIZE,
+					  j * TILE_SIZE), QPoint((right + 1) * TILE_SIZE - 1,
+					  (j + 1) * TILE_SIZE - 1))));
+					if (!rr.isEmpty() && !loadRows(rr.top(), rr.bottom() + 1))
+						qWarning("%s: error reading image data",
+						  qUtf8Printable(path()));
+					decoded = true;
+				}
+
+				pm = tile(t);
+				if (pm.isNull())
+					continue;
+				pm.setDevicePixelRatio(_mapRatio);
+				_tileCache.insert(key, pm);
+			}
+
+			painter->drawPixmap(QPointF(t * TILE_SIZE) / _mapRatio, pm);
+		}
+	}
+
+	/* Only keep the decoded rows while drawing */
+	_rows = QImage();
 }
 
 void BSBMap::load(const Projection &in, const Projection &out,
@@ -445,23 +563,25 @@ void BSBMap::load(const Projection &in, const Projection &out,
 
 	_mapRatio = hidpi ? deviceRatio : 1.0;
 
-	if (!_img) {
-		if (_skew > 0.0 && _skew < 360.0) {
-			QTransform matrix;
-			matrix.rotate(-_skew);
-			_img = new Image(readImage().transformed(matrix));
-		} else
-			_img = new Image(readImage());
+	_file.setFileName(path());
+	if (!_file.open(QIODevice::ReadOnly)) {
+		qWarning("%s: %s", qUtf8Printable(path()),
+		  qUtf8Printable(_file.errorString()));
+		return;
+	}
+	if (!(_file.seek(_dataOffset) && _file.getChar(&_bits))
+	  || (_index.isEmpty() && !readIndex())) {
+		qWarning("%s: invalid image data", qUtf8Printable(path()));
+		_index.clear();
+		_file.close();
 	}
-
-	if (_img)
-		_img->setDevicePixelRatio(_mapRatio);
 }
 
 void BSBMap::unload()
 {
-	delete _img;
-	_img = 0;
+	_file.close();
+	_rows = QImage();
+	_tileCache.clear();
 }
 
 Map *BSBMap::create(const QString &path, const Projection &proj, bool *isMap)
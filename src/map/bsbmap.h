@@ -2,13 +2,13 @@
 #define BSBMAP_H
 
 #include <QColor>
+#include <QFile>
+#include <QImage>
 #include "transform.h"
 #include "projection.h"
+#include "tilecache.h"
 #include "map.h"
 
-class QFile;
-class Image;
-
 class BSBMap : public Map
 {
 	Q_OBJECT
@@ -46,20 +46,30 @@ private:
 	bool createProjection(const QString &datum, const QString &proj,
 	  double params[9], const Coordinates &c);
 	bool createTransform(QList<ReferencePoint> &points);
-	QImage readImage();
 	bool readRow(QFile &file, char bits, uchar *buf);
+	bool readIndex();
+	bool loadRows(int top, int bottom);
+	QRect sourceRect(const QRect &rect) const;
+	QPixmap tile(const QPoint &xy);
 
 	QString _name;
 	Projection _projection;
 	Transform _transform;
 	qreal _skew;
-	Image *_img;
+	QTransform _skewMatrix;
 	QSize _size;
 	QSize _skewSize;
 	qreal _mapRatio;
 	qint64 _dataOffset;
 	QVector<QRgb> _palette;
 
+	QFile _file;
+	char _bits;
+	QVector<qint64> _index;
+	QImage _rows;
+	int _rowsTop;
+	TileCache _tileCache;
+
 	bool _valid;
 	QString _errorString;
 };
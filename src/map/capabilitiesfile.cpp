@@ -0,0 +1,52 @@
+#include <QFileInfo>
+#include "capabilitiesfile.h"
+
+
+#define VALIDATORS_SUFFIX ".validators"
+
+CapabilitiesFile::CapabilitiesFile(const QString &path, QObject *parent)
+  : QObject(parent), _path(path), _validators(path + VALIDATORS_SUFFIX)
+{
+	_downloader = new Downloader(this);
+	connect(_downloader, &Downloader::downloaded, this,
+	  &CapabilitiesFile::downloaded);
+	connect(_downloader, &Downloader::validated, this,
+	  &CapabilitiesFile::downloaded);
+	connect(_downloader, &Downloader::finished, this,
+	  &CapabilitiesFile::finished);
+}
+
+bool CapabilitiesFile::exists() const
+{
+	return QFileInfo::exists(_path);
+}
+
+bool CapabilitiesFile::download(const QUrl &url,
+  const QList<HTTPHeader> &headers)
+{
+	QList<Download> dl;
+	dl.append(Download(url, _path));
+
+	return _downloader->get(dl, headers);
+}
+
+/* Documents without any stored validators (cached by the previous versions
+   or served without any validators) are downloaded unconditionally. */
+void CapabilitiesFile::refresh(const QUrl &url,
+  const QList<HTTPHeader> &headers)
+{
+	Validators v(_validators.value(QFileInfo(_path).fileName()));
+	if (v.isFresh())
+		return;
+
+	QList<Download> dl;
+	dl.append(Download(url, _path, v));
+
+	_downloader->get(dl, headers, Downloader::Prefetch);
+}
+
+void CapabilitiesFile::downloaded(const QString &file,
+  const Validators &validators)
+{
+	_validators.insert(QFileInfo(file).fileName(), validators);
+}
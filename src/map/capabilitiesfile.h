@@ -0,0 +1,35 @@
+#ifndef CAPABILITIESFILE_H
+#define CAPABILITIESFILE_H
+
+#include <QObject>
+#include "downloader.h"
+#include "validatorstore.h"
+
+/* Local copy of a WMS/WMTS capabilities document. A missing document is
+   downloaded and finished() is emitted once done. An existing document is
+   used as it is and refreshed in the background when its HTTP validators
+   have expired, the refreshed document is used on the next map load. */
+class CapabilitiesFile : public QObject
+{
+	Q_OBJECT
+
+public:
+	CapabilitiesFile(const QString &path, QObject *parent = 0);
+
+	bool exists() const;
+	bool download(const QUrl &url, const QList<HTTPHeader> &headers);
+	void refresh(const QUrl &url, const QList<HTTPHeader> &headers);
+
+signals:
+	void finished();
+
+private slots:
+	void downloaded(const QString &file, const Validators &validators);
+
+private:
+	QString _path;
+	Downloader *_downloader;
+	ValidatorStore _validators;
+};
+
+#endif // CAPABILITIESFILE_H
@@ -1,6 +1,7 @@
 #include <QFile>
 #include "common/csv.h"
 #include "angularunits.h"
+#include "lazylist.h"
 #include "conversion.h"
 
 static bool parameter(int key, double val, int units, Conversion::Setup &setup)
@@ -112,6 +113,7 @@ Conversion::Method::Method(int id)
 }
 
 QMap<int, Conversion::Entry> Conversion::_conversions = defaults();
+static LazyList conversionList;
 
 QMap<int, Conversion::Entry> Conversion::defaults()
 {
@@ -121,7 +123,7 @@ QMap<int, Conversion::Entry> Conversion::defaults()
 	return map;
 }
 
-Conversion Conversion::conversion(int id)
+Conversion Conversion::find(int id)
 {
 	QMap<int, Entry>::const_iterator it(_conversions.find(id));
 
@@ -133,7 +135,38 @@ Conversion Conversion::conversion(int id)
 	}
 }
 
+Conversion Conversion::conversion(int id)
+{
+	if (conversionList.isLoaded())
+		return find(id);
+
+	QMutexLocker locker(&conversionList.lock());
+	Conversion conversion(find(id));
+	if (conversion.isNull() && load())
+		conversion = find(id);
+
+	return conversion;
+}
+
+/* The list is only registered here and loaded on the first lookup that
+   the defaults can not satisfy. */
 bool Conversion::loadList(const QString &path)
+{
+	conversionList.setPath(path);
+	return true;
+}
+
+bool Conversion::load()
+{
+	QString path(conversionList.take());
+	if (!path.isNull())
+		loadFile(path);
+	conversionList.setLoaded();
+
+	return !path.isNull();
+}
+
+bool Conversion::loadFile(const QString &path)
 {
 	QFile file(path);
 	CSV csv(&file);
@@ -217,6 +250,11 @@ QList<KV<int, QString> > Conversion::list()
 {
 	QList<KV<int, QString> > list;
 
+	if (!conversionList.isLoaded()) {
+		QMutexLocker locker(&conversionList.lock());
+		load();
+	}
+
 	for (QMap<int, Entry>::const_iterator it = _conversions.constBegin();
 	  it != _conversions.constEnd(); ++it)
 		list.append(KV<int, QString>(it.key(), it.value().name()));
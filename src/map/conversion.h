@@ -116,6 +116,9 @@ private:
 	};
 
 	static QMap<int, Entry> defaults();
+	static Conversion find(int id);
+	static bool load();
+	static bool loadFile(const QString &path);
 
 	Method _method;
 	Setup _setup;
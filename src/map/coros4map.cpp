@@ -1,12 +1,12 @@
 #include <QFile>
 #include <QPainter>
-#include <QPixmapCache>
 #include "common/wgs84.h"
 #include "common/programpaths.h"
 #include "IMG/imgdata.h"
 #include "IMG/demtree.h"
 #include "rectd.h"
 #include "pcs.h"
+#include "tileorder.h"
 #include "imgjob.h"
 #include "coros4map.h"
 
@@ -52,7 +52,9 @@ void Coros4Map::loadDir(const QString &path, MapTree &tree)
 
 Coros4Map::Coros4Map(const QString &fileName, QObject *parent)
   : Map(fileName, parent), _projection(PCS::pcs(3857)), _tileRatio(1.0),
-  _layer(All), _style(0), _valid(false)
+  _layer(All), _style(0), _polyCache("IMG polygons", CacheRegistry::KB, &_lock),
+  _pointCache("IMG points", CacheRegistry::KB, &_lock),
+  _demCache("IMG elevations", CacheRegistry::Items, &_demLock), _valid(false)
 {
 	QFileInfo fi(fileName);
 	QDir dir(fi.absolutePath());
@@ -128,12 +130,13 @@ void Coros4Map::load(const Projection &in, const Projection &out,
 
 	updateTransform();
 
-	QPixmapCache::clear();
+	_tileCache.setVariant(TileCache::variant(style, layer));
 }
 
 void Coros4Map::unload()
 {
 	cancelJobs(true);
+	_tileCache.clear();
 
 	MapTree::Iterator it;
 	for (_osm.GetFirst(it); !_osm.IsNull(it); _osm.GetNext(it))
@@ -145,6 +148,14 @@ void Coros4Map::unload()
 	_style = 0;
 }
 
+void Coros4Map::restyle(const Projection &in, const Projection &out,
+  qreal deviceRatio, bool hidpi, int style, int layer)
+{
+	/* Keep the tiles of the current style for a quick switch back */
+	_tileCache.keep();
+	Map::restyle(in, out, deviceRatio, hidpi, style, layer);
+}
+
 int Coros4Map::zoomFit(const QSize &size, const RectC &rect)
 {
 	const Range &zooms = _zooms;
@@ -214,20 +225,12 @@ void Coros4Map::updateTransform()
 		_bounds.adjust(0.5, 0, -0.5, 0);
 }
 
-bool Coros4Map::isRunning(const QString &key) const
-{
-	for (int i = 0; i < _jobs.size(); i++) {
-		const QList<RasterTile> &tiles = _jobs.at(i)->tiles();
-		for (int j = 0; j < tiles.size(); j++)
-			if (tiles.at(j).key() == key)
-				return true;
-	}
-
-	return false;
-}
-
 void Coros4Map::runJob(IMGJob *job)
 {
+	const QList<RasterTile> &tiles = job->tiles();
+	for (int i = 0; i < tiles.size(); i++)
+		_running.insert(tiles.at(i).key());
+
 	_jobs.append(job);
 
 	connect(job, &IMGJob::finished, this, &Coros4Map::jobFinished);
@@ -236,6 +239,10 @@ void Coros4Map::runJob(IMGJob *job)
 
 void Coros4Map::removeJob(IMGJob *job)
 {
+	const QList<RasterTile> &tiles = job->tiles();
+	for (int i = 0; i < tiles.size(); i++)
+		_running.remove(tiles.at(i).key());
+
 	_jobs.removeOne(job);
 	job->deleteLater();
 }
@@ -247,7 +254,7 @@ void Coros4Map::jobFinished(IMGJob *job)
 	for (int i = 0; i < tiles.size(); i++) {
 		const RasterTile &mt = tiles.at(i);
 		if (!mt.pixmap().isNull())
-			QPixmapCache::insert(mt.key(), mt.pixmap());
+			_tileCache.insert(mt.key(), mt.pixmap(), mt.isDraft());
 	}
 
 	removeJob(job);
@@ -277,21 +284,31 @@ void Coros4Map::draw(QPainter *painter, const QRectF &rect, Flags flags)
 	int width = ceil(s.width() / TILE_SIZE);
 	int height = ceil(s.height() / TILE_SIZE);
 
+	bool fallback = !(flags & Map::Block);
 	QList<RasterTile> tiles;
 
 	for (int i = 0; i < width; i++) {
 		for (int j = 0; j < height; j++) {
 			QPixmap pm;
 			QPoint ttl(tl.x() + i * TILE_SIZE, tl.y() + j * TILE_SIZE);
-			QString key(path() + "-" + QString::number(_zoom)
-			  + "_" + QString::number(ttl.x()) + "_" + QString::number(ttl.y()));
-
-			if (isRunning(key))
+			QRect tr(ttl, QSize(TILE_SIZE, TILE_SIZE));
+			quint64 key = TileCache::key(_zoom, QPoint(ttl.x() / TILE_SIZE,
+			  ttl.y() / TILE_SIZE));
+
+			if (isRunning(key)) {
+				if (fallback)
+					_tileCache.drawFallback(painter, _zoom, ttl / TILE_SIZE, tr,
+					  _zooms);
 				continue;
+			}
 
-			if (QPixmapCache::find(key, &pm))
+			if (_tileCache.find(key, &pm))
 				painter->drawPixmap(ttl, pm);
 			else {
+				if (fallback)
+					_tileCache.drawFallback(painter, _zoom, ttl / TILE_SIZE, tr,
+					  _zooms);
+
 				RectD rectD(_transform.img2proj(ttl), _transform.img2proj(
 				  QPoint(ttl.x() + TILE_SIZE, ttl.y() + TILE_SIZE)));
 				RectC rectC(rectD.toRectC(_projection, 20));
@@ -307,25 +324,37 @@ void Coros4Map::draw(QPainter *painter, const QRectF &rect, Flags flags)
 				if (_layer & Topo)
 					_cm.Search(min, max, cb, &data);
 
-				if (!data.isEmpty())
-					tiles.append(RasterTile(_projection, _transform, data,
-					  _style, _zoom, QRect(ttl, QSize(TILE_SIZE, TILE_SIZE)),
-					  _tileRatio, key, flags & Map::HillShading && _zoom >= 17
-					  && _zoom <= 24, false, true));
+				if (data.isEmpty())
+					continue;
+
+				bool hs = flags & Map::HillShading && _zoom >= 17
+				  && _zoom <= 24;
+				bool draft = hs && flags & Map::Draft;
+				if (draft && _tileCache.isDraft(key))
+					continue;
+
+				RasterTile tile(_projection, _transform, data, _style, _zoom,
+				  tr, _tileRatio, key, hs && !draft, false, true);
+				tile.setDraft(draft);
+				tiles.append(tile);
 			}
 		}
 	}
 
+	std::sort(tiles.begin(), tiles.end(), TileOrder<RasterTile>(rect.center()
+	  - QPointF(TILE_SIZE / 2, TILE_SIZE / 2)));
+
 	if (!tiles.isEmpty()) {
 		if (flags & Map::Block) {
-			QFuture<void> future = QtConcurrent::map(tiles, &RasterTile::render);
+			QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+			  tiles, &RasterTile::render);
 			future.waitForFinished();
 
 			for (int i = 0; i < tiles.size(); i++) {
 				const RasterTile &mt = tiles.at(i);
 				const QPixmap &pm = mt.pixmap();
 				painter->drawPixmap(mt.xy(), pm);
-				QPixmapCache::insert(mt.key(), pm);
+				_tileCache.insert(mt.key(), pm);
 			}
 		} else
 			runJob(new IMGJob(tiles));
@@ -372,6 +401,16 @@ double Coros4Map::elevation(const Coordinates &c)
 	return Map::elevation(c);
 }
 
+MatrixD Coros4Map::elevation(const MatrixC &m)
+{
+	MatrixD ret(m.h(), m.w());
+
+	for (int i = 0; i < m.size(); i++)
+		ret.at(i) = elevation(m.at(i));
+
+	return ret;
+}
+
 QStringList Coros4Map::styles(int &defaultStyle) const
 {
 	QStringList list;
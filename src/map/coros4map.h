@@ -1,10 +1,12 @@
 #ifndef COROS4MAP_H
 #define COROS4MAP_H
 
+#include <QSet>
 #include "map.h"
 #include "projection.h"
 #include "transform.h"
 #include "IMG/mapdata.h"
+#include "tilecache.h"
 
 class IMGJob;
 namespace IMG {class Style;}
@@ -36,8 +38,11 @@ public:
 	void load(const Projection &in, const Projection &out, qreal devicelRatio,
 	  bool hidpi, int style, int layer);
 	void unload();
+	void restyle(const Projection &in, const Projection &out,
+	  qreal deviceRatio, bool hidpi, int style, int layer);
 
 	double elevation(const Coordinates &c);
+	MatrixD elevation(const MatrixC &m);
 
 	QStringList styles(int &defaultStyle) const;
 	QStringList layers(const QString &lang, int &defaultLayer) const;
@@ -68,7 +73,7 @@ private:
 
 	Transform transform(int zoom) const;
 	void updateTransform();
-	bool isRunning(const QString &key) const;
+	bool isRunning(quint64 key) const {return _running.contains(key);}
 	void runJob(IMGJob *job);
 	void removeJob(IMGJob *job);
 	void cancelJobs(bool wait);
@@ -93,7 +98,9 @@ private:
 	QMutex _lock, _demLock;
 	QString _typ;
 
+	TileCache _tileCache;
 	QList<IMGJob*> _jobs;
+	QSet<quint64> _running;
 
 	bool _valid;
 	QString _errorString;
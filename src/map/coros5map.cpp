@@ -1,15 +1,17 @@
-#include <QPixmapCache>
 #include <QPainter>
 #include "osm.h"
+#include "tileorder.h"
 #include "coros5map.h"
 
 #define MAX_TILE_SIZE   4096
 #define ROOT_CACHE_SIZE 16
 #define ANY_ID          0xFFFFFFFF
+#define DATA_CACHE_SIZE 16384 /* KB */
 
 using namespace PMTiles;
 
-Coros5Map::MapTile::MapTile(const QString &path) : path(path)
+Coros5Map::MapTile::MapTile(const QString &path, Coros5Map *map)
+  : map(map), path(path)
 {
 	QFile file(path);
 	if (!file.open(QIODevice::ReadOnly)) {
@@ -85,6 +87,11 @@ QStringList Coros5Map::MapTile::vectorLayers() const
 	return layers;
 }
 
+QByteArray Coros5Map::MapTile::tileData(quint64 id)
+{
+	return map->loadTile(this, id);
+}
+
 void Coros5Map::loadDir(const QString &path, Range &zooms)
 {
 	QDir md(path);
@@ -98,7 +105,7 @@ void Coros5Map::loadDir(const QString &path, Range &zooms)
 		if (fi.isDir())
 			loadDir(fi.absoluteFilePath(), zooms);
 		else {
-			MapTile *map = new MapTile(fi.absoluteFilePath());
+			MapTile *map = new MapTile(fi.absoluteFilePath(), this);
 			if (map->isValid()) {
 				min[0] = map->bounds.left();
 				min[1] = map->bounds.bottom();
@@ -174,6 +181,7 @@ Coros5Map::Coros5Map(const QString &fileName, QObject *parent)
 	}
 
 	_cache.setMaxCost(ROOT_CACHE_SIZE);
+	_dataCache.setMaxCost(DATA_CACHE_SIZE);
 
 	_valid = true;
 }
@@ -208,7 +216,7 @@ void Coros5Map::load(const Projection &in, const Projection &out,
 			_zooms.append(Zoom(i, _zooms.last().base));
 		}
 
-		QPixmapCache::clear();
+		_tileCache.clear();
 	}
 }
 
@@ -216,6 +224,7 @@ void Coros5Map::unload()
 {
 	cancelJobs(true);
 	_cache.clear();
+	_tileCache.clear();
 }
 
 QRectF Coros5Map::bounds()
@@ -280,20 +289,12 @@ qreal Coros5Map::tileSize() const
 	return (_tileSize / coordinatesRatio());
 }
 
-bool Coros5Map::isRunning(const QString &key) const
-{
-	for (int i = 0; i < _jobs.size(); i++) {
-		const QList<PMTile> &tiles = _jobs.at(i)->tiles();
-		for (int j = 0; j < tiles.size(); j++)
-			if (tiles.at(j).key() == key)
-				return true;
-	}
-
-	return false;
-}
-
 void Coros5Map::runJob(PMTileJob *job)
 {
+	const QList<PMTile> &tiles = job->tiles();
+	for (int i = 0; i < tiles.size(); i++)
+		_running.insert(tiles.at(i).key());
+
 	_jobs.append(job);
 
 	connect(job, &PMTileJob::finished, this, &Coros5Map::jobFinished);
@@ -302,6 +303,10 @@ void Coros5Map::runJob(PMTileJob *job)
 
 void Coros5Map::removeJob(PMTileJob *job)
 {
+	const QList<PMTile> &tiles = job->tiles();
+	for (int i = 0; i < tiles.size(); i++)
+		_running.remove(tiles.at(i).key());
+
 	_jobs.removeOne(job);
 	job->deleteLater();
 }
@@ -313,7 +318,7 @@ void Coros5Map::jobFinished(PMTileJob *job)
 	for (int i = 0; i < tiles.size(); i++) {
 		const PMTile &mt = tiles.at(i);
 		if (!mt.pixmap().isNull())
-			QPixmapCache::insert(mt.key(), mt.pixmap());
+			_tileCache.insert(mt.key(), mt.pixmap());
 	}
 
 	removeJob(job);
@@ -361,13 +366,12 @@ void Coros5Map::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		for (int j = 0; j < height; j++) {
 			QPixmap pm;
 			QPoint t(tile.x() + i, tile.y() + j);
-			QString key = path() + "-" + QString::number(zoom.z) + "_"
-			  + QString::number(t.x()) + "_" + QString::number(t.y());
+			quint64 key = TileCache::key(zoom.z, t);
 
 			if (isRunning(key))
 				continue;
 
-			if (QPixmapCache::find(key, &pm)) {
+			if (_tileCache.find(key, &pm, imageRatio())) {
 				QPointF tp(tilePos(tl, t, tile, overzoom));
 				drawTile(painter, pm, tp);
 			} else {
@@ -385,15 +389,19 @@ void Coros5Map::draw(QPainter *painter, const QRectF &rect, Flags flags)
 				_maps.Search(min, max, cb, &map);
 
 				if (map)
-					tiles.append(PMTile(zoom.z, overzoom, _scaledSize, _style,
-					  t, tileData(map, id(zoom.base, t)), map->tc, key));
+					tiles.append(PMTile(zoom.z, overzoom, _scaledSize, _mvt,
+					  _style, t, map, id(zoom.base, t), key));
 			}
 		}
 	}
 
+	std::sort(tiles.begin(), tiles.end(), TileOrder<PMTile>(QPointF(tile.x()
+	  + (width - 1) / 2.0, tile.y() + (height - 1) / 2.0)));
+
 	if (!tiles.isEmpty()) {
 		if (flags & Map::Block) {
-			QFuture<void> future = QtConcurrent::map(tiles, &PMTile::load);
+			QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+			  tiles, &PMTile::load);
 			future.waitForFinished();
 
 			for (int i = 0; i < tiles.size(); i++) {
@@ -402,7 +410,7 @@ void Coros5Map::draw(QPainter *painter, const QRectF &rect, Flags flags)
 				if (pm.isNull())
 					continue;
 
-				QPixmapCache::insert(mt.key(), pm);
+				_tileCache.insert(mt.key(), pm);
 
 				QPointF tp(tilePos(tl, mt.xy(), tile, overzoom));
 				drawTile(painter, pm, tp);
@@ -440,6 +448,31 @@ QByteArray Coros5Map::tileData(const MapTile *map, quint64 id)
 		return readData(ce->file, map->tileOffset + d->offset, d->length, 1);
 }
 
+QByteArray Coros5Map::loadTile(const MapTile *map, quint64 id)
+{
+	/* Called from the tile loading threads, the files and the caches are
+	   shared */
+	QMutexLocker locker(&_lock);
+
+	QByteArray *cached = _dataCache.object(id);
+	if (cached)
+		return *cached;
+
+	QByteArray data(tileData(map, id));
+
+	locker.unlock();
+	QByteArray uba((map->tc == 2) ? Util::gunzip(data) : data);
+
+	/* Keep the uncompressed vector tiles data, the same base tile is decoded
+	   for every overzoom level and style */
+	if (_mvt && !uba.isEmpty()) {
+		locker.relock();
+		_dataCache.insert(id, new QByteArray(uba), qMax(uba.size() / 1024, 1));
+	}
+
+	return uba;
+}
+
 void Coros5Map::drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp)
 {
 	pixmap.setDevicePixelRatio(imageRatio());
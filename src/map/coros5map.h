@@ -2,12 +2,15 @@
 #define COROS5MAP_H
 
 #include <QtConcurrent>
+#include <QMutex>
+#include <QSet>
 #include "common/range.h"
 #include <common/rtree.h>
 #include "pmtiles.h"
 #include "pmtilejob.h"
 #include "mvtstyle.h"
 #include "map.h"
+#include "tilecache.h"
 
 class Coros5Map : public Map
 {
@@ -47,11 +50,16 @@ private slots:
 	void jobFinished(PMTileJob *job);
 
 private:
-	struct MapTile {
-		MapTile(const QString &path);
+	/* The map tiles are the data sources of the PMTiles, the tile data are
+	   read in the tile loading threads */
+	struct MapTile : public PMTileSource {
+		MapTile(const QString &path, Coros5Map *map);
 
 		bool isValid() const {return bounds.isValid() && zooms.isValid();}
 		QStringList vectorLayers() const;
+		QByteArray tileData(quint64 id);
+
+		Coros5Map *map;
 
 		QString path;
 		RectC bounds;
@@ -91,8 +99,9 @@ private:
 	qreal imageRatio() const;
 	void drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp);
 	QByteArray tileData(const MapTile *map, quint64 id);
+	QByteArray loadTile(const MapTile *map, quint64 id);
 
-	bool isRunning(const QString &key) const;
+	bool isRunning(quint64 key) const {return _running.contains(key);}
 	void runJob(PMTileJob *job);
 	void removeJob(PMTileJob *job);
 	void cancelJobs(bool wait);
@@ -107,6 +116,8 @@ private:
 	QVector<Zoom> _zooms, _zoomsBase;
 	QList<MVTStyle> _styles;
 	QCache<const MapTile*, CacheEntry> _cache;
+	QCache<quint64, QByteArray> _dataCache;
+	QMutex _lock;
 	int _zoom;
 	int _tileSize;
 	int _style;
@@ -116,6 +127,8 @@ private:
 
 
 	QList<PMTileJob*> _jobs;
+	QSet<quint64> _running;
+	TileCache _tileCache;
 
 	bool _valid;
 	QString _errorString;
@@ -13,6 +13,14 @@ public:
 
 	virtual PointD ll2xy(const Coordinates &c) const = 0;
 	virtual Coordinates xy2ll(const PointD &p) const = 0;
+
+	/* Batch conversion of n points, reimplemented in the most common
+	   projections to get rid of the per point virtual call. */
+	virtual void ll2xy(const Coordinates *c, PointD *p, int n) const
+	{
+		for (int i = 0; i < n; i++)
+			p[i] = ll2xy(c[i]);
+	}
 };
 
 #endif // CT_H
@@ -0,0 +1,49 @@
+#ifndef DATATILEJOB_H
+#define DATATILEJOB_H
+
+#include "common/threadpools.h"
+#include "common/trace.h"
+#include "tile.h"
+
+class DataTileJob : public QObject
+{
+	Q_OBJECT
+
+public:
+	DataTileJob(const QList<DataTile> &tiles) : _tiles(tiles) {}
+
+	void run()
+	{
+		_trace.start();
+		connect(&_watcher, &QFutureWatcher<void>::finished, this,
+		  &DataTileJob::handleFinished);
+		_future = ThreadPools::map(ThreadPools::Render,
+		  _tiles, &DataTile::load);
+		_watcher.setFuture(_future);
+	}
+	void cancel(bool wait)
+	{
+		_future.cancel();
+		if (wait)
+			_future.waitForFinished();
+	}
+	const QList<DataTile> &tiles() const {return _tiles;}
+
+signals:
+	void finished(DataTileJob *job);
+
+private slots:
+	void handleFinished()
+	{
+		_trace.end("job", "DataTileJob");
+		emit finished(this);
+	}
+
+private:
+	QFutureWatcher<void> _watcher;
+	QFuture<void> _future;
+	Trace::Span _trace;
+	QList<DataTile> _tiles;
+};
+
+#endif // DATATILEJOB_H
@@ -1,3 +1,4 @@
+#include <cstring>
 #include "common/wgs84.h"
 #include "datum.h"
 
@@ -7,8 +8,22 @@
 #define ds2scale(x) (1.0 + (x) * 1e-6)
 #define scale2ds(x) (((x) - 1.0) / 1e-6)
 
-static Coordinates molodensky(const Coordinates &c, const Datum &from,
-  const Datum &to)
+Datum::MolodenskyParams::MolodenskyParams(const Datum &from, const Datum &to)
+{
+	double from_f = from.ellipsoid().flattening();
+	double to_f = to.ellipsoid().flattening();
+
+	dx = from.dx() - to.dx();
+	dy = from.dy() - to.dy();
+	dz = from.dz() - to.dz();
+	df = to_f - from_f;
+	a = from.ellipsoid().radius();
+	da = to.ellipsoid().radius() - a;
+	esq = from_f * (2.0 - from_f);
+	adb = 1.0 / (1.0 - from_f);
+}
+
+Coordinates Datum::molodensky(const Coordinates &c, const MolodenskyParams &p)
 {
 	double rlat = deg2rad(c.lat());
 	double rlon = deg2rad(c.lon());
@@ -19,26 +34,15 @@ static Coordinates molodensky(const Coordinates &c, const Datum &from,
 	double clon = cos(rlon);
 	double ssqlat = slat * slat;
 
-	double dx = from.dx() - to.dx();
-	double dy = from.dy() - to.dy();
-	double dz = from.dz() - to.dz();
-
-	double from_f = from.ellipsoid().flattening();
-	double to_f = to.ellipsoid().flattening();
-	double df = to_f - from_f;
-	double from_a = from.ellipsoid().radius();
-	double to_a = to.ellipsoid().radius();
-	double da = to_a - from_a;
-	double from_esq = from_f * (2.0 - from_f);
-	double adb = 1.0 / (1.0 - from_f);
-	double rn = from_a / sqrt(1 - from_esq * ssqlat);
-	double rm = from_a * (1 - from_esq) / pow((1 - from_esq * ssqlat), 1.5);
+	double w = 1 - p.esq * ssqlat;
+	double rn = p.a / sqrt(w);
+	double rm = p.a * (1 - p.esq) / (w * sqrt(w));
 
-	double dlat = (-dx * slat * clon - dy * slat * slon + dz * clat + da
-	  * rn * from_esq * slat * clat / from_a + df * (rm * adb + rn / adb) * slat
-	  * clat) / rm;
+	double dlat = (-p.dx * slat * clon - p.dy * slat * slon + p.dz * clat
+	  + p.da * rn * p.esq * slat * clat / p.a + p.df * (rm * p.adb + rn / p.adb)
+	  * slat * clat) / rm;
 
-	double dlon = (-dx * slon + dy * clon) / (rn * clat);
+	double dlon = (-p.dx * slon + p.dy * clon) / (rn * clat);
 
 	return Coordinates(c.lon() + rad2deg(dlon), c.lat() + rad2deg(dlat));
 }
@@ -86,8 +90,11 @@ Datum::Datum(const Ellipsoid &ellipsoid, double dx, double dy, double dz)
 	if (_ellipsoid.radius() == WGS84_RADIUS && _ellipsoid.flattening()
 	  == WGS84_FLATTENING && _dx == 0.0 && _dy == 0.0 && _dz == 0.0)
 		_transformation = None;
-	else
+	else {
 		_transformation = Molodensky;
+		_to = MolodenskyParams(*this, WGS84());
+		_from = MolodenskyParams(WGS84(), *this);
+	}
 }
 
 Coordinates Datum::toWGS84(const Coordinates &c) const
@@ -97,7 +104,7 @@ Coordinates Datum::toWGS84(const Coordinates &c) const
 			return Geocentric::toGeodetic(helmert(Geocentric::fromGeodetic(c,
 			  ellipsoid())), WGS84().ellipsoid());
 		case Molodensky:
-			return molodensky(c, *this, WGS84());
+			return molodensky(c, _to);
 		default:
 			return c;
 	}
@@ -110,12 +117,50 @@ Coordinates Datum::fromWGS84(const Coordinates &c) const
 			return Geocentric::toGeodetic(helmertr(Geocentric::fromGeodetic(c,
 			  WGS84().ellipsoid())), ellipsoid());
 		case Molodensky:
-			return molodensky(c, WGS84(), *this);
+			return molodensky(c, _from);
 		default:
 			return c;
 	}
 }
 
+void Datum::toWGS84(const Coordinates *c, Coordinates *out, int n) const
+{
+	switch (_transformation) {
+		case Helmert:
+			for (int i = 0; i < n; i++)
+				out[i] = Geocentric::toGeodetic(helmert(
+				  Geocentric::fromGeodetic(c[i], ellipsoid())),
+				  WGS84().ellipsoid());
+			break;
+		case Molodensky:
+			for (int i = 0; i < n; i++)
+				out[i] = molodensky(c[i], _to);
+			break;
+		default:
+			if (out != c)
+				memcpy(out, c, n * sizeof(Coordinates));
+	}
+}
+
+void Datum::fromWGS84(const Coordinates *c, Coordinates *out, int n) const
+{
+	switch (_transformation) {
+		case Helmert:
+			for (int i = 0; i < n; i++)
+				out[i] = Geocentric::toGeodetic(helmertr(
+				  Geocentric::fromGeodetic(c[i], WGS84().ellipsoid())),
+				  ellipsoid());
+			break;
+		case Molodensky:
+			for (int i = 0; i < n; i++)
+				out[i] = molodensky(c[i], _from);
+			break;
+		default:
+			if (out != c)
+				memcpy(out, c, n * sizeof(Coordinates));
+	}
+}
+
 #ifndef QT_NO_DEBUG
 QDebug operator<<(QDebug dbg, const Datum &datum)
 {
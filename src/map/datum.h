@@ -34,6 +34,9 @@ public:
 
 	Coordinates toWGS84(const Coordinates &c) const;
 	Coordinates fromWGS84(const Coordinates &c) const;
+	/* Batch versions, the transformation is dispatched once per batch */
+	void toWGS84(const Coordinates *c, Coordinates *out, int n) const;
+	void fromWGS84(const Coordinates *c, Coordinates *out, int n) const;
 
 	static const Datum &WGS84();
 
@@ -44,12 +47,25 @@ private:
 		Helmert
 	};
 
+	/* Point independent Molodensky transformation terms */
+	struct MolodenskyParams {
+		MolodenskyParams() {}
+		MolodenskyParams(const Datum &from, const Datum &to);
+
+		double dx, dy, dz;
+		double da, df;
+		double a, esq, adb;
+	};
+
 	Point3D helmert(const Point3D &p) const;
 	Point3D helmertr(const Point3D &p) const;
+	static Coordinates molodensky(const Coordinates &c,
+	  const MolodenskyParams &p);
 
 	Ellipsoid _ellipsoid;
 	TransformationType _transformation;
 	double _dx, _dy, _dz, _rx, _ry, _rz, _scale;
+	MolodenskyParams _to, _from;
 };
 
 inline bool operator==(const Datum &d1, const Datum &d2)
@@ -1,25 +1,18 @@
-/*
-	WARNING: This code uses internal Qt API - the QZipReader class for reading
-	ZIP files - and things may break if Qt changes the API. For Qt5 this is not
-	a problem as we can "see the future" now and there are no changes in all
-	the supported Qt5 versions up to the last one (5.15). In Qt6 the class
-	might change or even disappear in the future, but this is very unlikely
-	as there were no changes for several years and The Qt Company's policy
-	is: "do not invest any resources into any desktop related stuff unless
-	absolutely necessary". There is an issue (QTBUG-3897) since the year 2009 to
-	include the ZIP reader into the public API, which aptly illustrates the
-	effort The Qt Company is willing to make about anything desktop related...
-*/
-
 #include <QtEndian>
 #include <QDir>
 #include <QFile>
 #include <QRegularExpression>
 #include <QLocale>
-#include <private/qzipreader_p.h>
 #include "common/rectc.h"
+#include "common/ziparchive.h"
 #include "dem.h"
 
+/* Only the touched pages of the mapped files are resident, hillshading
+   usually uses a small part of the tile */
+#define MAPPED_COST_RATIO 8
+/* Max overview decimation is 1<<OVERVIEW_LEVELS (16x) */
+#define OVERVIEW_LEVELS 4
+#define OVERVIEW_COST_RATIO 4
 
 static unsigned int isqrt(unsigned int x)
 {
@@ -54,12 +47,36 @@ static double value(int col, int row, int samples, const QByteArray &data)
 	return (val == -32768) ? NAN : val;
 }
 
+static inline double sample(const uchar *p)
+{
+	qint16 val = qFromBigEndian<qint16>(p);
+	return (val == -32768) ? NAN : val;
+}
+
 
-DEM::Entry::Entry(const QByteArray &data) : _data(data)
+DEM::Entry::Entry(const QByteArray &data) : _data(data), _file(0)
 {
 	_samples = isqrt(_data.size() / 2);
 }
 
+DEM::Entry::Entry(QFile *file, const uchar *data, qint64 size)
+  : _data(QByteArray::fromRawData((const char*)data, size)), _file(file)
+{
+	_samples = isqrt(_data.size() / 2);
+}
+
+DEM::Entry::~Entry()
+{
+	delete _file;
+}
+
+int DEM::Entry::cost() const
+{
+	return _file
+	  ? _data.size() / 1024 / MAPPED_COST_RATIO
+	  : _data.size() / 1024;
+}
+
 QString DEM::Tile::latStr() const
 {
 	const char ns = (_lat >= 0) ? 'N' : 'S';
@@ -79,25 +96,43 @@ QString DEM::Tile::fileName() const
 
 
 QMutex DEM::_lock;
+QWaitCondition DEM::_loaded;
 QString DEM::_dir;
-DEM::TileCache DEM::_data;
+QString DEM::_cacheDir;
+DEM::TileCache DEM::_data("DEM tiles", CacheRegistry::KB, &DEM::_lock);
+DEM::OverviewCache DEM::_overviews("DEM overviews", CacheRegistry::KB,
+  &DEM::_lock);
+QSet<DEM::Tile> DEM::_loading;
+QHash<QString, DEM::ZipArchivePtr> DEM::_archives;
 
 void DEM::setCacheSize(int size)
 {
 	_lock.lock();
 	_data.setMaxCost(size);
+	_overviews.setMaxCost(size / OVERVIEW_COST_RATIO);
 	_lock.unlock();
 }
 
 void DEM::setDir(const QString &path)
 {
 	_dir = path;
+
+	_lock.lock();
+	_archives.clear();
+	_lock.unlock();
+}
+
+void DEM::setCacheDir(const QString &path)
+{
+	_cacheDir = path;
 }
 
 void DEM::clearCache()
 {
 	_lock.lock();
 	_data.clear();
+	_overviews.clear();
+	_archives.clear();
 	_lock.unlock();
 }
 
@@ -119,6 +154,121 @@ double DEM::height(const Coordinates &c, const Entry *e)
 	return interpolate(lon - col, lat - row, p0, p1, p2, p3);
 }
 
+/* Batch version of height() for a run of samples from the same tile with
+   the per-tile values hoisted out of the loop. The rows are stored from north
+   to south, so the "row + 1" samples precede the "row" samples in the data. */
+void DEM::heights(const MatrixC &m, int start, int end, const Entry *e,
+  MatrixD &ret)
+{
+	int samples = e->samples();
+	if (!samples) {
+		for (int i = start; i < end; i++)
+			ret.at(i) = NAN;
+		return;
+	}
+
+	const uchar *data = (const uchar*)e->data().constData();
+	double scale = samples - 1;
+	int stride = samples * 2;
+
+	for (int i = start; i < end; i++) {
+		const Coordinates &c = m.at(i);
+		double lat = (c.lat() - floor(c.lat())) * scale;
+		double lon = (c.lon() - floor(c.lon())) * scale;
+		int row = (int)lat;
+		int col = (int)lon;
+
+		const uchar *p = data + (samples - 1 - row) * stride + col * 2;
+		double p0 = sample(p);
+		double p1 = sample(p + 2);
+		double p2 = sample(p - stride);
+		double p3 = sample(p - stride + 2);
+
+		ret.at(i) = interpolate(lon - col, lat - row, p0, p1, p2, p3);
+	}
+}
+
+DEM::Entry *DEM::mapFile(const QString &path, qint64 offset, qint64 size)
+{
+	QFile *file = new QFile(path);
+	if (!file->open(QIODevice::ReadOnly)) {
+		qWarning("%s: %s", qUtf8Printable(file->fileName()),
+		  qUtf8Printable(file->errorString()));
+		delete file;
+		return new Entry();
+	}
+
+	if (size < 0)
+		size = file->size() - offset;
+	uchar *data = file->map(offset, size);
+	if (data)
+		return new Entry(file, data, size);
+	else {
+		Entry *e = file->seek(offset)
+		  ? new Entry(file->read(size)) : new Entry();
+		delete file;
+		return e;
+	}
+}
+
+/* Zipped tiles are inflated only once into the DEM cache directory, further
+   loads map the unpacked file. Returns a null string if the tile could not
+   be unpacked. */
+QString DEM::unzipTile(ZipArchive &zip, const QString &fileName)
+{
+	if (_cacheDir.isEmpty())
+		return QString();
+
+	QDir dir(_cacheDir);
+	QString path(dir.absoluteFilePath(fileName));
+	QFileInfo fi(path);
+	if (fi.exists()
+	  && fi.lastModified() >= QFileInfo(zip.fileName()).lastModified())
+		return path;
+
+	if (!dir.mkpath(dir.absolutePath()))
+		return QString();
+
+	QByteArray data(zip.fileData(fileName));
+	if (data.isEmpty())
+		return QString();
+
+	QFile file(path + ".tmp");
+	if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+		qWarning("%s: %s", qUtf8Printable(file.fileName()),
+		  qUtf8Printable(file.errorString()));
+		file.remove();
+		return QString();
+	}
+	file.close();
+
+	QFile::remove(path);
+	if (!file.rename(path)) {
+		file.remove();
+		return QString();
+	}
+
+	return path;
+}
+
+/* The archives central directory index is parsed only once and kept until
+   the DEM dir/cache changes (ZipArchive keeps the index between the close()
+   and open() calls), so the tiles evicted from the cache are reloaded without
+   re-reading the archive directory. An archive holds a single tile and is
+   thus only used by the one thread loading that tile. */
+DEM::ZipArchivePtr DEM::archive(const QString &path)
+{
+	QMutexLocker locker(&_lock);
+
+	ZipArchivePtr zip(_archives.value(path));
+	if (!zip) {
+		zip = ZipArchivePtr(new ZipArchive(path));
+		_archives.insert(path, zip);
+	}
+
+	return zip;
+}
+
 DEM::Entry *DEM::loadTile(const Tile &tile)
 {
 	QString fileName(tile.fileName());
@@ -126,33 +276,143 @@ DEM::Entry *DEM::loadTile(const Tile &tile)
 	QString zipPath(path + ".zip");
 
 	if (QFileInfo::exists(zipPath)) {
-		QZipReader zip(zipPath, QIODevice::ReadOnly);
-		return new Entry(zip.fileData(fileName));
-	} else {
-		QFile file(path);
-		if (!file.open(QIODevice::ReadOnly)) {
-			qWarning("%s: %s", qUtf8Printable(file.fileName()),
-			  qUtf8Printable(file.errorString()));
+		ZipArchivePtr zip(archive(zipPath));
+		qint64 offset, size;
+		Entry *e;
+
+		if (!zip->open()) {
+			qWarning("%s: %s", qUtf8Printable(zipPath),
+			  qUtf8Printable(zip->errorString()));
 			return new Entry();
-		} else
-			return new Entry(file.readAll());
+		}
+
+		/* Stored (uncompressed) tiles are mapped directly from the archive */
+		if (zip->stored(fileName, offset, size))
+			e = mapFile(zipPath, offset, size);
+		else {
+			QString unzipped(unzipTile(*zip, fileName));
+			e = unzipped.isNull()
+			  ? new Entry(zip->fileData(fileName)) : mapFile(unzipped);
+		}
+
+		zip->close();
+
+		return e;
+	} else
+		return mapFile(path);
+}
+
+/* The lock only guards the cache itself, the tiles are loaded and the
+   elevations computed outside of it. The entries are reference counted so
+   they stay valid even when evicted from the cache while in use. Concurrent
+   requests of the same missing tile wait for the first one to load it. */
+DEM::EntryPtr DEM::entry(const Tile &tile)
+{
+	QMutexLocker locker(&_lock);
+
+	while (true) {
+		EntryPtr *ep = _data.object(tile);
+		if (ep)
+			return *ep;
+		if (!_loading.contains(tile))
+			break;
+		_loaded.wait(&_lock);
 	}
+	_loading.insert(tile);
+
+	locker.unlock();
+	EntryPtr e(loadTile(tile));
+	locker.relock();
+
+	_data.insert(tile, new EntryPtr(e), e->cost());
+	_loading.remove(tile);
+	_loaded.wakeAll();
+
+	return e;
 }
 
-double DEM::elevationLockFree(const Coordinates &c)
+/* Overviews are built by averaging the (1<<level)^2 samples around every
+   overview sample. Tiles whose size is not divisible by the decimation
+   factor have no overview of the level. */
+DEM::Entry *DEM::createOverview(const Entry *e, int level)
 {
-	Tile tile(floor(c.lon()), floor(c.lat()));
-	Entry *e = _data.object(tile);
-	double ele;
+	int f = 1<<level;
+	int full = e->samples();
+	if (full < 2 || (full - 1) % f)
+		return 0;
+
+	int samples = (full - 1) / f + 1;
+	QByteArray data(samples * samples * 2, 0);
+	qint16 *dp = (qint16*)data.data();
+
+	for (int row = 0; row < samples; row++) {
+		for (int col = 0; col < samples; col++) {
+			int r0 = qMax(row * f - f/2, 0), r1 = qMin(row * f + f/2, full - 1);
+			int c0 = qMax(col * f - f/2, 0), c1 = qMin(col * f + f/2, full - 1);
+			double sum = 0;
+			int cnt = 0;
+
+			for (int r = r0; r <= r1; r++) {
+				for (int c = c0; c <= c1; c++) {
+					double val = value(c, r, full, e->data());
+					if (!std::isnan(val)) {
+						sum += val;
+						cnt++;
+					}
+				}
+			}
+
+			dp[(samples - 1 - row) * samples + col] = qToBigEndian(
+			  cnt ? (qint16)qRound(sum / cnt) : (qint16)-32768);
+		}
+	}
 
-	if (!e) {
-		e = loadTile(tile);
-		ele = height(c, e);
-		_data.insert(tile, e, e->data().size() / 1024);
-	} else
-		ele = height(c, e);
+	return new Entry(data);
+}
+
+DEM::EntryPtr DEM::overview(const Tile &tile, int level)
+{
+	QPair<Tile, int> key(tile, level);
+
+	_lock.lock();
+	EntryPtr *ep = _overviews.object(key);
+	EntryPtr e(ep ? *ep : EntryPtr());
+	_lock.unlock();
+	if (e)
+		return e;
+
+	EntryPtr full(entry(tile));
+	e = EntryPtr(createOverview(full.data(), level));
+	if (!e)
+		return full;
+
+	_lock.lock();
+	_overviews.insert(key, new EntryPtr(e), e->cost());
+	_lock.unlock();
 
-	return ele;
+	return e;
+}
+
+/* The overview level is chosen so that the overview samples are still at
+   least as dense as the matrix points. */
+int DEM::overviewLevel(const MatrixC &m, const Entry *e)
+{
+	if (m.h() < 2 || m.w() < 2 || e->samples() < 2)
+		return 0;
+
+	int i = m.h() / 2 - 1, j = m.w() / 2 - 1;
+	const Coordinates &c = m.at(i, j);
+	const Coordinates &cx = m.at(i, j + 1);
+	const Coordinates &cy = m.at(i + 1, j);
+	double dx = qMax(qAbs(cx.lon() - c.lon()), qAbs(cx.lat() - c.lat()));
+	double dy = qMax(qAbs(cy.lon() - c.lon()), qAbs(cy.lat() - c.lat()));
+	double res = qMin(dx, dy) * (e->samples() - 1);
+
+	int level = 0;
+	while (level < OVERVIEW_LEVELS && (1<<(level + 1)) <= res)
+		level++;
+
+	return level;
 }
 
 double DEM::elevation(const Coordinates &c)
@@ -160,11 +420,8 @@ double DEM::elevation(const Coordinates &c)
 	if (_dir.isEmpty())
 		return NAN;
 
-	_lock.lock();
-	double ele = elevationLockFree(c);
-	_lock.unlock();
-
-	return ele;
+	EntryPtr e(entry(Tile(floor(c.lon()), floor(c.lat()))));
+	return height(c, e.data());
 }
 
 MatrixD DEM::elevation(const MatrixC &m)
@@ -173,11 +430,38 @@ MatrixD DEM::elevation(const MatrixC &m)
 		return MatrixD(m.h(), m.w(), NAN);
 
 	MatrixD ret(m.h(), m.w());
-
-	_lock.lock();
-	for (int i = 0; i < m.size(); i++)
-		ret.at(i) = elevationLockFree(m.at(i));
-	_lock.unlock();
+	QList<QPair<Tile, EntryPtr> > entries;
+
+	for (int i = 0; i < m.size(); ) {
+		const Coordinates &c = m.at(i);
+		Tile t(floor(c.lon()), floor(c.lat()));
+
+		int end = i + 1;
+		while (end < m.size()) {
+			const Coordinates &n = m.at(end);
+			if (floor(n.lon()) != t.lon() || floor(n.lat()) != t.lat())
+				break;
+			end++;
+		}
+
+		EntryPtr e;
+		for (int j = 0; j < entries.size(); j++) {
+			if (entries.at(j).first == t) {
+				e = entries.at(j).second;
+				break;
+			}
+		}
+		if (!e) {
+			e = entry(t);
+			int level = overviewLevel(m, e.data());
+			if (level)
+				e = overview(t, level);
+			entries.append(QPair<Tile, EntryPtr>(t, e));
+		}
+
+		heights(m, i, end, e.data(), ret);
+		i = end;
+	}
 
 	return ret;
 }
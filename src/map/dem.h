@@ -5,10 +5,18 @@
 #include <QCache>
 #include <QByteArray>
 #include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+#include <QSet>
+#include <QHash>
 #include "common/hash.h"
+#include "common/cacheregistry.h"
 #include "data/area.h"
 #include "matrix.h"
 
+class QFile;
+class ZipArchive;
+
 class DEM
 {
 public:
@@ -34,6 +42,7 @@ public:
 
 	static void setCacheSize(int size);
 	static void setDir(const QString &path);
+	static void setCacheDir(const QString &path);
 	static void clearCache();
 
 	static double elevation(const Coordinates &c);
@@ -44,31 +53,54 @@ public:
 private:
 	class Entry {
 	public:
-		Entry() : _samples(0) {}
+		Entry() : _samples(0), _file(0) {}
 		Entry(const QByteArray &data);
+		Entry(QFile *file, const uchar *data, qint64 size);
+		~Entry();
 
 		const QByteArray &data() const {return _data;}
 		int samples() const {return _samples;}
+		int cost() const;
 
 	private:
+		Q_DISABLE_COPY(Entry)
+
 		unsigned int _samples;
 		QByteArray _data;
+		QFile *_file;
 	};
 
-	typedef QCache<DEM::Tile, Entry> TileCache;
+	typedef QSharedPointer<Entry> EntryPtr;
+	typedef QSharedPointer<ZipArchive> ZipArchivePtr;
+	typedef StatsCache<DEM::Tile, EntryPtr> TileCache;
+	typedef StatsCache<QPair<DEM::Tile, int>, EntryPtr> OverviewCache;
 
 	static double height(const Coordinates &c, const Entry *e);
+	static void heights(const MatrixC &m, int start, int end, const Entry *e,
+	  MatrixD &ret);
 	static Entry *loadTile(const Tile &tile);
-	static double elevationLockFree(const Coordinates &c);
+	static Entry *mapFile(const QString &path, qint64 offset = 0,
+	  qint64 size = -1);
+	static QString unzipTile(ZipArchive &zip, const QString &fileName);
+	static ZipArchivePtr archive(const QString &path);
+	static EntryPtr entry(const Tile &tile);
+	static EntryPtr overview(const Tile &tile, int level);
+	static Entry *createOverview(const Entry *e, int level);
+	static int overviewLevel(const MatrixC &m, const Entry *e);
 
 	static QString _dir;
+	static QString _cacheDir;
 	static TileCache _data;
+	static OverviewCache _overviews;
+	static QSet<Tile> _loading;
+	static QHash<QString, ZipArchivePtr> _archives;
 	static QMutex _lock;
+	static QWaitCondition _loaded;
 };
 
 inline HASH_T qHash(const DEM::Tile &tile)
 {
-	return (qHash(tile.lon()) ^ qHash(tile.lat()));
+	return Hash::key((quint32)tile.lon(), (quint32)tile.lat());
 }
 
 #ifndef QT_NO_DEBUG
@@ -1,8 +1,10 @@
 #include <QtMath>
 #include <QFileInfo>
+#include <private/qzipreader_p.h>
 #include "common/rectc.h"
 #include "demloader.h"
 
+#define VALIDATORS_FILE "dem.validators"
 
 static QList<DEM::Tile> tiles(const RectC &rect)
 {
@@ -24,12 +26,73 @@ static bool isZip(const QUrl &url)
 	return (fi.suffix().toLower() == "zip");
 }
 
+/* HGT files are square matrixes of 16b samples */
+static bool isValidSize(qint64 size)
+{
+	qint64 samples = qRound64(sqrt(size / 2));
+	return (size > 0 && samples * samples * 2 == size);
+}
+
+static bool isValidTile(const QString &file)
+{
+	if (QFileInfo(file).suffix().toLower() == "zip") {
+		QZipReader zip(file, QIODevice::ReadOnly);
+		if (zip.status() != QZipReader::NoError)
+			return false;
+
+		QString name(QFileInfo(file).completeBaseName());
+		QVector<QZipReader::FileInfo> list(zip.fileInfoList());
+		for (int i = 0; i < list.size(); i++)
+			if (list.at(i).filePath == name)
+				return isValidSize(list.at(i).size);
+
+		return false;
+	} else
+		return isValidSize(QFileInfo(file).size());
+}
+
 
 DEMLoader::DEMLoader(const QString &dir, QObject *parent)
-  : QObject(parent), _dir(dir)
+  : QObject(parent), _validators(QDir(dir).filePath(VALIDATORS_FILE)),
+  _dir(dir), _total(0), _done(0)
 {
 	_downloader = new Downloader(this);
-	connect(_downloader, &Downloader::finished, this, &DEMLoader::finished);
+	_downloader->setResumable(true);
+	connect(_downloader, &Downloader::finished, this,
+	  &DEMLoader::downloadFinished);
+	connect(_downloader, &Downloader::downloaded, this,
+	  &DEMLoader::tileDownloaded);
+	connect(_downloader, &Downloader::validated, this,
+	  &DEMLoader::tileValidated);
+}
+
+void DEMLoader::tileDownloaded(const QString &file,
+  const Validators &validators)
+{
+	if (!isValidTile(file)) {
+		qWarning("%s: invalid DEM tile", qUtf8Printable(file));
+		QFile::remove(file);
+	} else if (!validators.isNull())
+		_validators.insert(QFileInfo(file).fileName(), validators);
+
+	emit progress(++_done, _total);
+}
+
+void DEMLoader::tileValidated(const QString &file,
+  const Validators &validators)
+{
+	if (!validators.isNull())
+		_validators.insert(QFileInfo(file).fileName(), validators);
+
+	emit progress(++_done, _total);
+}
+
+void DEMLoader::downloadFinished()
+{
+	_total = 0;
+	_done = 0;
+
+	emit finished();
 }
 
 int DEMLoader::numTiles(const RectC &rect) const
@@ -71,6 +134,12 @@ bool DEMLoader::loadTiles(const RectC &rect)
 		if (!(QFileInfo::exists(zn) || QFileInfo::exists(fn))) {
 			QUrl url(tileUrl(t));
 			dl.append(Download(url, isZip(url) ? zn : fn));
+		} else if (Downloader::revalidation()) {
+			QUrl url(tileUrl(t));
+			QString file(isZip(url) ? zn : fn);
+			Validators v(_validators.value(QFileInfo(file).fileName()));
+			if (!v.isNull() && !v.isFresh() && QFileInfo::exists(file))
+				dl.append(Download(url, file, v));
 		}
 
 		if (dl.size() > DEM_DOWNLOAD_LIMIT) {
@@ -79,7 +148,13 @@ bool DEMLoader::loadTiles(const RectC &rect)
 		}
 	}
 
-	return _downloader->get(dl, _headers);
+	if (_downloader->isIdle()) {
+		_total = 0;
+		_done = 0;
+	}
+	_total += dl.size();
+
+	return _downloader->get(dl, _headers, Downloader::Bulk);
 }
 
 bool DEMLoader::checkTiles(const RectC &rect) const
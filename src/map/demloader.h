@@ -4,6 +4,7 @@
 #include <QObject>
 #include <QDir>
 #include "downloader.h"
+#include "validatorstore.h"
 #include "dem.h"
 
 class RectC;
@@ -24,20 +25,29 @@ public:
 	int numTiles(const RectC &rect) const;
 	bool loadTiles(const RectC &rect);
 	bool checkTiles(const RectC &rect) const;
+	void cancel() {_downloader->cancel(Downloader::Bulk);}
 
 	const QString &url() const {return _url;}
 
 signals:
 	void finished();
+	void progress(int done, int total);
+
+private slots:
+	void tileDownloaded(const QString &file, const Validators &validators);
+	void tileValidated(const QString &file, const Validators &validators);
+	void downloadFinished();
 
 private:
 	QUrl tileUrl(const DEM::Tile &tile) const;
 	QString tileFile(const DEM::Tile &tile) const;
 
 	Downloader *_downloader;
+	ValidatorStore _validators;
 	QString _url;
 	QDir _dir;
 	QList<HTTPHeader> _headers;
+	int _total, _done;
 };
 
 #endif // DEMLOADER_H
@@ -2,6 +2,7 @@
 #include <QNetworkRequest>
 #include <QDir>
 #include <QTimerEvent>
+#include <QLocale>
 #include "common/config.h"
 #include "downloader.h"
 
@@ -28,6 +29,8 @@
 #define MAX_REDIRECT_LEVEL 5
 #define RETRIES 3
 #define TMP_SUFFIX ".download"
+#define MIN_MAX_AGE 3600
+#define DEFAULT_MAX_AGE 86400
 
 // QNetworkReply::errorString() returns bullshit, use our own reporting
 static const char *errorString(QNetworkReply::NetworkError error)
@@ -114,6 +117,41 @@ static QString origName(const QString &tmpName)
 	return tmpName.left(tmpName.size() - (sizeof(TMP_SUFFIX) - 1));
 }
 
+/* Objects with no or too short expiration time are considered fresh for
+   a reasonable time to not revalidate them on every access. */
+static Validators validators(QNetworkReply *reply)
+{
+	QDateTime now(QDateTime::currentDateTimeUtc());
+	qint64 maxAge = -1;
+
+	QList<QByteArray> cc(reply->rawHeader("Cache-Control").split(','));
+	for (int i = 0; i < cc.size(); i++) {
+		QByteArray directive(cc.at(i).trimmed().toLower());
+		if (directive.startsWith("max-age=")) {
+			bool ok;
+			maxAge = directive.mid(8).toLongLong(&ok);
+			if (!ok)
+				maxAge = -1;
+		}
+	}
+	if (maxAge < 0) {
+		QByteArray hdr(reply->rawHeader("Expires"));
+		if (!hdr.isEmpty()) {
+			QDateTime expires(QLocale::c().toDateTime(QString::fromLatin1(hdr),
+			  "ddd, dd MMM yyyy hh:mm:ss 'GMT'"));
+			expires.setTimeSpec(Qt::UTC);
+			if (expires.isValid())
+				maxAge = qMax(now.secsTo(expires), (qint64)0);
+		}
+	}
+	if (maxAge < 0)
+		maxAge = DEFAULT_MAX_AGE;
+
+	return Validators(reply->rawHeader("ETag"),
+	  reply->rawHeader("Last-Modified"),
+	  now.addSecs(qMax(maxAge, (qint64)MIN_MAX_AGE)));
+}
+
 Authorization::Authorization(const QString &username, const QString &password)
 {
 	QString concatenated = username + ":" + password;
@@ -124,6 +162,7 @@ Authorization::Authorization(const QString &username, const QString &password)
 QNetworkAccessManager *Downloader::_manager = 0;
 int Downloader::_timeout = 30;
 bool Downloader::_http2 = true;
+bool Downloader::_revalidate = false;
 
 bool Downloader::doDownload(const Download &dl, const QList<HTTPHeader> &headers)
 {
@@ -145,7 +184,10 @@ bool Downloader::doDownload(const Download &dl, const QList<HTTPHeader> &headers
 	request.setMaximumRedirectsAllowed(MAX_REDIRECT_LEVEL);
 	request.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
 	  QNetworkRequest::NoLessSafeRedirectPolicy);
-	request.setAttribute(QNetworkRequest::Http2AllowedAttribute, QVariant(_http2));
+	request.setAttribute(QNetworkRequest::Http2AllowedAttribute,
+	  QVariant(_http2 && _profile.http2()));
+	request.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute,
+	  QVariant(_profile.pipelining()));
 	request.setTransferTimeout(_timeout * 1000);
 
 	for (int i = 0; i < headers.size(); i++) {
@@ -156,9 +198,34 @@ bool Downloader::doDownload(const Download &dl, const QList<HTTPHeader> &headers
 	}
 	if (!userAgent)
 		request.setRawHeader("User-Agent", USER_AGENT);
+	if (!_profile.keepAlive())
+		request.setRawHeader("Connection", "close");
+	/* Qt adds "Accept-Encoding: gzip, deflate" and decompresses the data
+	   on its own unless the header is set explicitly */
+	if (!_profile.compression())
+		request.setRawHeader("Accept-Encoding", "identity");
+	if (!dl.validators().etag().isEmpty())
+		request.setRawHeader("If-None-Match", dl.validators().etag());
+	if (!dl.validators().lastModified().isEmpty())
+		request.setRawHeader("If-Modified-Since",
+		  dl.validators().lastModified());
+
+	if (dl.isRange()) {
+		request.setRawHeader("Range", "bytes=" + QByteArray::number(
+		  dl.offset()) + "-" + QByteArray::number(dl.offset() + dl.size() - 1));
+		request.setRawHeader("Accept-Encoding", "identity");
+	}
 
 	QFile *file = new QFile(tmpName(dl.file()));
-	if (!file->open(QIODevice::WriteOnly)) {
+	bool resume = _resume && !dl.isRange() && file->size() > 0;
+	if (resume) {
+		request.setRawHeader("Range", "bytes=" + QByteArray::number(
+		  file->size()) + "-");
+		/* Ranges of the compressed representation can not be joined */
+		request.setRawHeader("Accept-Encoding", "identity");
+	}
+	if (!file->open(resume ? QIODevice::ReadWrite : QIODevice::WriteOnly)
+	  || (resume && !file->seek(file->size()))) {
 		qWarning("%s: %s", qUtf8Printable(file->fileName()),
 		  qUtf8Printable(file->errorString()));
 		delete file;
@@ -170,6 +237,13 @@ bool Downloader::doDownload(const Download &dl, const QList<HTTPHeader> &headers
 	QNetworkReply *reply = _manager->get(request);
 	file->setParent(reply);
 	_currentDownloads.insert(url, file);
+	_hostDownloads[url.host()]++;
+	if (resume)
+		_resumed.insert(url);
+	if (dl.isRange())
+		_ranges.insert(url);
+	if (Trace::isEnabled())
+		_started[url].start();
 
 	if (reply->isRunning()) {
 		connect(reply, &QIODevice::readyRead, this, &Downloader::emitReadReady);
@@ -192,24 +266,71 @@ void Downloader::emitReadReady()
 	readData(static_cast<QNetworkReply*>(sender()));
 }
 
-void Downloader::insertError(const QUrl &url, QNetworkReply::NetworkError error)
+static bool isTransient(QNetworkReply::NetworkError error)
 {
 	switch (error) {
 		case QNetworkReply::OperationCanceledError:
 		case QNetworkReply::TimeoutError:
 		case QNetworkReply::RemoteHostClosedError:
 		case QNetworkReply::ConnectionRefusedError:
-			_errorDownloads.insert(url, _errorDownloads.value(url) + 1);
-			break;
+			return true;
 		default:
-			_errorDownloads.insert(url, RETRIES);
+			return false;
+	}
+}
+
+void Downloader::insertError(const QUrl &url, QNetworkReply::NetworkError error)
+{
+	if (isTransient(error))
+		_errorDownloads.insert(url, _errorDownloads.value(url) + 1);
+	else
+		_errorDownloads.insert(url, RETRIES);
+}
+
+/* Servers not supporting range requests send the whole object, the partial
+   data must be dropped in such case */
+void Downloader::checkResumed(QNetworkReply *reply, QFile *file)
+{
+	if (!_resumed.remove(reply->request().url()))
+		return;
+
+	if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt()
+	  != 206) {
+		file->resize(0);
+		file->seek(0);
+	}
+}
+
+/* Servers not supporting range requests send the whole object, that may be
+   huge in case of range requests. Such downloads are aborted and never
+   retried. */
+bool Downloader::checkRange(QNetworkReply *reply)
+{
+	const QUrl &url = reply->request().url();
+
+	if (!_ranges.contains(url) || reply->attribute(
+	  QNetworkRequest::HttpStatusCodeAttribute).toInt() == 206)
+		return true;
+
+	if (_errorDownloads.value(url) < RETRIES) {
+		qWarning("%s: HTTP range requests not supported",
+		  url.toEncoded().constData());
+		_errorDownloads.insert(url, RETRIES);
 	}
+
+	return false;
 }
 
 void Downloader::readData(QNetworkReply *reply)
 {
+	if (!checkRange(reply)) {
+		reply->abort();
+		return;
+	}
+
 	QFile *file = _currentDownloads.value(reply->request().url());
 	Q_ASSERT(file);
+	checkResumed(reply, file);
 	file->write(reply->readAll());
 }
 
@@ -222,28 +343,92 @@ void Downloader::downloadFinished(QNetworkReply *reply)
 	if (error) {
 		insertError(url, error);
 		qWarning("%s: %s", url.toEncoded().constData(), errorString(error));
+		/* Keep the partial data only on connection errors, the server errors
+		   (e.g. an unsatisfiable range) would repeat */
+		if (_resume && file->size() > 0 && isTransient(error))
+			file->close();
+		else
+			file->remove();
+	} else if (!checkRange(reply)) {
+		file->remove();
+	} else if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute)
+	  .toInt() == 304) {
 		file->remove();
+		emit validated(origName(file->fileName()), validators(reply));
 	} else {
+		QString name(origName(file->fileName()));
+		checkResumed(reply, file);
 		file->close();
-		file->rename(origName(file->fileName()));
+		/* Revalidated objects replace the previous version */
+		if (QFile::exists(name))
+			QFile::remove(name);
+		if (file->rename(name))
+			emit downloaded(name, validators(reply));
 	}
 
+	if (Trace::isEnabled())
+		_started.take(url).end("network", "download");
+
 	_currentDownloads.remove(url);
+	_resumed.remove(url);
+	_ranges.remove(url);
+	if (!--_hostDownloads[url.host()])
+		_hostDownloads.remove(url.host());
 	reply->deleteLater();
 
+	startDownloads();
+
 	if (_currentDownloads.isEmpty())
 		emit finished();
 }
 
+bool Downloader::isQueued(const QUrl &url) const
+{
+	for (int i = 0; i <= Bulk; i++)
+		for (int j = 0; j < _queue[i].size(); j++)
+			if (_queue[i].at(j).download().url() == url)
+				return true;
+
+	return false;
+}
+
+/* Starts the queued downloads in the priority order while respecting the
+   per-host concurrency limit of the network profile. The requests above the
+   limit stay in the queue and may be canceled (e.g. when superseded by a new
+   visible tiles set) before they are started. */
+void Downloader::startDownloads()
+{
+	for (int i = 0; i <= Bulk; i++) {
+		QList<Request> &queue = _queue[i];
+
+		for (int j = 0; j < queue.size(); ) {
+			if (_hostDownloads.value(queue.at(j).download().url().host())
+			  >= _profile.connections()) {
+				j++;
+				continue;
+			}
+
+			Request r(queue.takeAt(j));
+			doDownload(r.download(), r.headers());
+		}
+	}
+}
+
 bool Downloader::get(const QList<Download> &list,
-  const QList<HTTPHeader> &headers)
+  const QList<HTTPHeader> &headers, Priority priority)
 {
-	bool finishEmitted = false;
+	for (int i = 0; i < list.count(); i++) {
+		const QUrl &url = list.at(i).url();
+		if (_currentDownloads.contains(url) || isQueued(url)
+		  || _errorDownloads.value(url) >= RETRIES)
+			continue;
+
+		_queue[priority].append(Request(list.at(i), headers));
+	}
 
-	for (int i = 0; i < list.count(); i++)
-		finishEmitted |= doDownload(list.at(i), headers);
+	startDownloads();
 
-	return finishEmitted;
+	return !_currentDownloads.isEmpty();
 }
 
 void Downloader::enableHTTP2(bool enable)
@@ -6,23 +6,91 @@
 #include <QUrl>
 #include <QList>
 #include <QHash>
+#include <QSet>
+#include <QDateTime>
 #include "common/kv.h"
+#include "common/trace.h"
 
 class QFile;
 
 typedef KV<QByteArray, QByteArray> HTTPHeader;
 
+/* HTTP cache validators of a downloaded object */
+class Validators
+{
+public:
+	Validators() {}
+	Validators(const QByteArray &etag, const QByteArray &lastModified,
+	  const QDateTime &expires)
+	  : _etag(etag), _lastModified(lastModified), _expires(expires) {}
+
+	const QByteArray &etag() const {return _etag;}
+	const QByteArray &lastModified() const {return _lastModified;}
+	const QDateTime &expires() const {return _expires;}
+
+	bool isNull() const {return _etag.isEmpty() && _lastModified.isEmpty();}
+	bool isFresh() const
+	  {return _expires.isValid() && _expires > QDateTime::currentDateTimeUtc();}
+
+private:
+	QByteArray _etag;
+	QByteArray _lastModified;
+	QDateTime _expires;
+};
+
 class Download
 {
 public:
-	Download(const QUrl &url, const QString &file) : _url(url), _file(file) {}
+	Download(const QUrl &url, const QString &file)
+	  : _url(url), _file(file), _offset(0), _size(0) {}
+	/* Conditional download of an already cached object */
+	Download(const QUrl &url, const QString &file, const Validators &validators)
+	  : _url(url), _file(file), _validators(validators), _offset(0), _size(0) {}
+	/* Download of the object's byte range (HTTP range request). The URL must
+	   be unique for every range (e.g. contain the range as fragment). */
+	Download(const QUrl &url, const QString &file, quint64 offset,
+	  quint64 size) : _url(url), _file(file), _offset(offset), _size(size) {}
 
 	const QUrl &url() const {return _url;}
 	const QString &file() const {return _file;}
+	const Validators &validators() const {return _validators;}
+	quint64 offset() const {return _offset;}
+	quint64 size() const {return _size;}
+	bool isRange() const {return (_size > 0);}
 
 private:
 	QUrl _url;
 	QString _file;
+	Validators _validators;
+	quint64 _offset;
+	quint64 _size;
+};
+
+/* Per-map HTTP connection settings */
+class NetworkProfile
+{
+public:
+	NetworkProfile() : _http2(true), _connections(6), _keepAlive(true),
+	  _pipelining(false), _compression(true) {}
+
+	bool http2() const {return _http2;}
+	int connections() const {return _connections;}
+	bool keepAlive() const {return _keepAlive;}
+	bool pipelining() const {return _pipelining;}
+	bool compression() const {return _compression;}
+
+	void setHttp2(bool enable) {_http2 = enable;}
+	void setConnections(int connections) {_connections = connections;}
+	void setKeepAlive(bool enable) {_keepAlive = enable;}
+	void setPipelining(bool enable) {_pipelining = enable;}
+	void setCompression(bool enable) {_compression = enable;}
+
+private:
+	bool _http2;
+	int _connections;
+	bool _keepAlive;
+	bool _pipelining;
+	bool _compression;
 };
 
 class Authorization
@@ -43,17 +111,35 @@ class Downloader : public QObject
 	Q_OBJECT
 
 public:
-	Downloader(QObject *parent = 0) : QObject(parent) {}
+	enum Priority {
+		Visible,
+		Prefetch,
+		Bulk
+	};
+
+	Downloader(QObject *parent = 0) : QObject(parent), _resume(false) {}
 
-	bool get(const QList<Download> &list, const QList<HTTPHeader> &headers);
+	bool get(const QList<Download> &list, const QList<HTTPHeader> &headers,
+	  Priority priority = Visible);
+	void cancel(Priority priority) {_queue[priority].clear();}
 	void clearErrors() {_errorDownloads.clear();}
+	bool isIdle() const {return _currentDownloads.isEmpty();}
+	void setProfile(const NetworkProfile &profile) {_profile = profile;}
+	/* Keep the partially downloaded files on errors and resume them using
+	   HTTP range requests */
+	void setResumable(bool resume) {_resume = resume;}
 
 	static void setNetworkManager(QNetworkAccessManager *manager)
 	  {_manager = manager;}
 	static void setTimeout(int timeout) {_timeout = timeout;}
 	static void enableHTTP2(bool enable);
+	static void enableRevalidation(bool enable) {_revalidate = enable;}
+	static bool revalidation() {return _revalidate;}
 
 signals:
+	void downloaded(const QString &file, const Validators &validators);
+	/* The cached object is still valid (HTTP 304), nothing was downloaded */
+	void validated(const QString &file, const Validators &validators);
 	void finished();
 
 private slots:
@@ -61,17 +147,43 @@ private slots:
 	void emitReadReady();
 
 private:
+	class Request
+	{
+	public:
+		Request(const Download &download, const QList<HTTPHeader> &headers)
+		  : _download(download), _headers(headers) {}
+
+		const Download &download() const {return _download;}
+		const QList<HTTPHeader> &headers() const {return _headers;}
+
+	private:
+		Download _download;
+		QList<HTTPHeader> _headers;
+	};
+
 	void insertError(const QUrl &url, QNetworkReply::NetworkError error);
+	bool isQueued(const QUrl &url) const;
+	void startDownloads();
 	bool doDownload(const Download &dl, const QList<HTTPHeader> &headers);
 	void downloadFinished(QNetworkReply *reply);
 	void readData(QNetworkReply *reply);
+	void checkResumed(QNetworkReply *reply, QFile *file);
+	bool checkRange(QNetworkReply *reply);
 
 	QHash<QUrl, QFile*> _currentDownloads;
 	QHash<QUrl, int> _errorDownloads;
+	QHash<QString, int> _hostDownloads;
+	QList<Request> _queue[Bulk + 1];
+	NetworkProfile _profile;
+	QSet<QUrl> _resumed;
+	QSet<QUrl> _ranges;
+	QHash<QUrl, Trace::Span> _started;
+	bool _resume;
 
 	static QNetworkAccessManager *_manager;
 	static int _timeout;
 	static bool _http2;
+	static bool _revalidate;
 };
 
 #ifndef QT_NO_DEBUG
@@ -2,9 +2,11 @@
 #include <QDebug>
 #include "common/wgs84.h"
 #include "common/csv.h"
+#include "lazylist.h"
 #include "ellipsoid.h"
 
 QMap<int, Ellipsoid> Ellipsoid::_ellipsoids = defaults();
+static LazyList ellipsoidList;
 
 const Ellipsoid &Ellipsoid::WGS84()
 {
@@ -19,18 +21,50 @@ QMap<int, Ellipsoid> Ellipsoid::defaults()
 	return map;
 }
 
-const Ellipsoid &Ellipsoid::ellipsoid(int id)
+const Ellipsoid *Ellipsoid::find(int id)
 {
 	QMap<int, Ellipsoid>::const_iterator it(_ellipsoids.find(id));
+	return (it == _ellipsoids.constEnd()) ? 0 : &it.value();
+}
+
+/* The returned references stay valid as the list is never modified once
+   loaded and the map nodes do not move on insertion. */
+const Ellipsoid &Ellipsoid::ellipsoid(int id)
+{
 	static const Ellipsoid null;
+	const Ellipsoid *e;
+
+	if (ellipsoidList.isLoaded())
+		e = find(id);
+	else {
+		QMutexLocker locker(&ellipsoidList.lock());
+		e = find(id);
+		if (!e && load())
+			e = find(id);
+	}
 
-	if (it == _ellipsoids.constEnd())
-		return null;
-	else
-		return it.value();
+	return e ? *e : null;
 }
 
+/* The list is only registered here and loaded on the first lookup that
+   the defaults can not satisfy. */
 bool Ellipsoid::loadList(const QString &path)
+{
+	ellipsoidList.setPath(path);
+	return true;
+}
+
+bool Ellipsoid::load()
+{
+	QString path(ellipsoidList.take());
+	if (!path.isNull())
+		loadFile(path);
+	ellipsoidList.setLoaded();
+
+	return !path.isNull();
+}
+
+bool Ellipsoid::loadFile(const QString &path)
 {
 	QFile file(path);
 	CSV csv(&file);
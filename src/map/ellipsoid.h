@@ -34,6 +34,9 @@ private:
 	double _es, _e2s, _b;
 
 	static QMap<int, Ellipsoid> defaults();
+	static const Ellipsoid *find(int id);
+	static bool load();
+	static bool loadFile(const QString &path);
 	static QMap<int, Ellipsoid> _ellipsoids;
 };
 
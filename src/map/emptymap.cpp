@@ -71,6 +71,16 @@ QPointF EmptyMap::ll2xy(const Coordinates &c)
 	return QPointF(m.x() / scale, m.y() / -scale);
 }
 
+void EmptyMap::ll2xy(const Coordinates *c, QPointF *p, int n)
+{
+	qreal scale = OSM::zoom2scale(_zoom, TILE_SIZE);
+
+	for (int i = 0; i < n; i++) {
+		QPointF m = OSM::ll2m(c[i]);
+		p[i] = QPointF(m.x() / scale, m.y() / -scale);
+	}
+}
+
 Coordinates EmptyMap::xy2ll(const QPointF &p)
 {
 	qreal scale = OSM::zoom2scale(_zoom, TILE_SIZE);
@@ -25,6 +25,7 @@ public:
 
 	QPointF ll2xy(const Coordinates &c);
 	Coordinates xy2ll(const QPointF &p);
+	void ll2xy(const Coordinates *c, QPointF *p, int n);
 
 	void draw(QPainter *painter, const QRectF &rect, Flags flags);
 
@@ -1,9 +1,9 @@
 #include <QPainter>
-#include <QPixmapCache>
 #include "common/wgs84.h"
 #include "GUI/format.h"
 #include "rectd.h"
 #include "pcs.h"
+#include "tileorder.h"
 #include "encjob.h"
 #include "encatlas.h"
 
@@ -106,7 +106,7 @@ void ENCAtlas::addMap(const QDir &dir, const QByteArray &file,
 	IntendedUsage iu = usage(path);
 	auto it = _data.find(iu);
 	if (it == _data.end())
-		it = _data.insert(iu, new AtlasData(_cache, _cacheLock));
+		it = _data.insert(iu, new AtlasData(_cache, _cacheLock, _projection));
 
 	it.value()->addMap(bounds, path);
 
@@ -115,7 +115,8 @@ void ENCAtlas::addMap(const QDir &dir, const QByteArray &file,
 
 ENCAtlas::ENCAtlas(const QString &fileName, QObject *parent)
   : Map(fileName, parent), _projection(PCS::pcs(3857)),  _tileRatio(1.0),
-  _style(0), _zoom(0), _valid(false)
+  _style(0), _cache("ENC maps", CacheRegistry::KB, &_cacheLock), _zoom(0),
+  _valid(false)
 {
 	QDir dir(QFileInfo(fileName).absoluteDir());
 	ISO8211 ddf(fileName);
@@ -147,7 +148,7 @@ ENCAtlas::ENCAtlas(const QString &fileName, QObject *parent)
 	_zoom = zooms(_usage).min();
 	updateTransform();
 
-	_cache.setMaxCost(16);
+	_cache.setMaxCost(65536);
 
 	_valid = true;
 }
@@ -172,12 +173,13 @@ void ENCAtlas::load(const Projection &in, const Projection &out,
 	Q_ASSERT(!_style);
 	_style = new Style(deviceRatio);
 
-	QPixmapCache::clear();
+	_tileCache.clear();
 }
 
 void ENCAtlas::unload()
 {
 	cancelJobs(true);
+	_tileCache.clear();
 
 	_cache.clear();
 
@@ -285,22 +287,12 @@ void ENCAtlas::updateTransform()
 	  _transform.proj2img(prect.bottomRight()));
 }
 
-bool ENCAtlas::isRunning(int zoom, const QPoint &xy) const
-{
-	for (int i = 0; i < _jobs.size(); i++) {
-		const QList<ENC::RasterTile> &tiles = _jobs.at(i)->tiles();
-		for (int j = 0; j < tiles.size(); j++) {
-			const ENC::RasterTile &mt = tiles.at(j);
-			if (mt.zoom() == zoom && mt.xy() == xy)
-				return true;
-		}
-	}
-
-	return false;
-}
-
 void ENCAtlas::runJob(ENCJob *job)
 {
+	const QList<ENC::RasterTile> &tiles = job->tiles();
+	for (int i = 0; i < tiles.size(); i++)
+		_running.insert(key(tiles.at(i).zoom(), tiles.at(i).xy()));
+
 	_jobs.append(job);
 
 	connect(job, &ENCJob::finished, this, &ENCAtlas::jobFinished);
@@ -309,6 +301,10 @@ void ENCAtlas::runJob(ENCJob *job)
 
 void ENCAtlas::removeJob(ENCJob *job)
 {
+	const QList<ENC::RasterTile> &tiles = job->tiles();
+	for (int i = 0; i < tiles.size(); i++)
+		_running.remove(key(tiles.at(i).zoom(), tiles.at(i).xy()));
+
 	_jobs.removeOne(job);
 	job->deleteLater();
 }
@@ -320,7 +316,7 @@ void ENCAtlas::jobFinished(ENCJob *job)
 	for (int i = 0; i < tiles.size(); i++) {
 		const ENC::RasterTile &mt = tiles.at(i);
 		if (!mt.pixmap().isNull())
-			QPixmapCache::insert(key(mt.zoom(), mt.xy()), mt.pixmap());
+			_tileCache.insert(key(mt.zoom(), mt.xy()), mt.pixmap());
 	}
 
 	removeJob(job);
@@ -334,10 +330,9 @@ void ENCAtlas::cancelJobs(bool wait)
 		_jobs.at(i)->cancel(wait);
 }
 
-QString ENCAtlas::key(int zoom, const QPoint &xy) const
+quint64 ENCAtlas::key(int zoom, const QPoint &xy) const
 {
-	return path() + "-" + QString::number(zoom) + "_"
-	  + QString::number(xy.x()) + "_" + QString::number(xy.y());
+	return TileCache::key(zoom, QPoint(xy.x() / TILE_SIZE, xy.y() / TILE_SIZE));
 }
 
 QList<Data*> ENCAtlas::levels() const
@@ -371,7 +366,7 @@ void ENCAtlas::draw(QPainter *painter, const QRectF &rect, Flags flags)
 				continue;
 
 			QPixmap pm;
-			if (QPixmapCache::find(key(_zoom, ttl), &pm))
+			if (_tileCache.find(key(_zoom, ttl), &pm))
 				painter->drawPixmap(ttl, pm);
 			else
 				tiles.append(RasterTile(_projection, _transform, _style,
@@ -380,16 +375,20 @@ void ENCAtlas::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		}
 	}
 
+	std::sort(tiles.begin(), tiles.end(), TileOrder<RasterTile>(rect.center()
+	  - QPointF(TILE_SIZE / 2, TILE_SIZE / 2)));
+
 	if (!tiles.isEmpty()) {
 		if (flags & Map::Block) {
-			QFuture<void> future = QtConcurrent::map(tiles, &RasterTile::render);
+			QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+			  tiles, &RasterTile::render);
 			future.waitForFinished();
 
 			for (int i = 0; i < tiles.size(); i++) {
 				const RasterTile &mt = tiles.at(i);
 				const QPixmap &pm = mt.pixmap();
 				painter->drawPixmap(mt.xy(), pm);
-				QPixmapCache::insert(key(mt.zoom(), mt.xy()), pm);
+				_tileCache.insert(key(mt.zoom(), mt.xy()), pm);
 			}
 		} else
 			runJob(new ENCJob(tiles));
@@ -3,8 +3,10 @@
 
 #include <QMap>
 #include <QMutex>
+#include <QSet>
 #include "common/range.h"
 #include "map.h"
+#include "tilecache.h"
 #include "projection.h"
 #include "transform.h"
 #include "ENC/iso8211.h"
@@ -68,11 +70,12 @@ private:
 
 	Transform transform(int zoom) const;
 	void updateTransform();
-	bool isRunning(int zoom, const QPoint &xy) const;
+	bool isRunning(int zoom, const QPoint &xy) const
+	  {return _running.contains(key(zoom, xy));}
 	void runJob(ENCJob *job);
 	void removeJob(ENCJob *job);
 	void cancelJobs(bool wait);
-	QString key(int zoom, const QPoint &xy) const;
+	quint64 key(int zoom, const QPoint &xy) const;
 	void addMap(const QDir &dir, const QByteArray &file, const RectC &bounds);
 	QList<ENC::Data*> levels() const;
 
@@ -94,7 +97,9 @@ private:
 	IntendedUsage _usage;
 	int _zoom;
 
+	TileCache _tileCache;
 	QList<ENCJob*> _jobs;
+	QSet<quint64> _running;
 
 	bool _valid;
 	QString _errorString;
@@ -1,7 +1,8 @@
 #ifndef ENCJOB_H
 #define ENCJOB_H
 
-#include <QtConcurrent>
+#include "common/threadpools.h"
+#include "common/trace.h"
 #include "ENC/rastertile.h"
 
 class ENCJob : public QObject
@@ -10,17 +11,26 @@ class ENCJob : public QObject
 
 public:
 	ENCJob(const QList<ENC::RasterTile> &tiles)
-	  : _tiles(tiles) {}
+	  : _tiles(tiles)
+	{
+		for (int i = 0; i < _tiles.size(); i++)
+			_tiles[i].setCancelFlag(&_cancel);
+	}
 
 	void run()
 	{
+		_trace.start();
 		connect(&_watcher, &QFutureWatcher<void>::finished, this,
 		  &ENCJob::handleFinished);
-		_future = QtConcurrent::map(_tiles, &ENC::RasterTile::render);
+		_future = ThreadPools::map(ThreadPools::Render,
+		  _tiles, &ENC::RasterTile::render);
 		_watcher.setFuture(_future);
 	}
 	void cancel(bool wait)
 	{
+		/* Stops also the already running tiles at their next fetch/draw
+		   phase boundary */
+		_cancel.storeRelease(1);
 		_future.cancel();
 		if (wait)
 			_future.waitForFinished();
@@ -31,12 +41,18 @@ signals:
 	void finished(ENCJob *job);
 
 private slots:
-	void handleFinished() {emit finished(this);}
+	void handleFinished()
+	{
+		_trace.end("job", "ENCJob");
+		emit finished(this);
+	}
 
 private:
 	QFutureWatcher<void> _watcher;
 	QFuture<void> _future;
+	Trace::Span _trace;
 	QList<ENC::RasterTile> _tiles;
+	QAtomicInt _cancel;
 };
 
 #endif // ENCJOB_H
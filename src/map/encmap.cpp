@@ -1,11 +1,11 @@
 #include <QPainter>
-#include <QPixmapCache>
 #include "common/range.h"
 #include "common/wgs84.h"
 #include "ENC/mapdata.h"
 #include "ENC/style.h"
 #include "rectd.h"
 #include "pcs.h"
+#include "tileorder.h"
 #include "encjob.h"
 #include "encmap.h"
 
@@ -131,7 +131,7 @@ bool ENCMap::processRecord(const ISO8211::Record &record,
 
 ENCMap::ENCMap(const QString &fileName, QObject *parent)
   : Map(fileName, parent), _data(0), _style(0), _projection(PCS::pcs(3857)),
-  _tileRatio(1.0), _valid(false)
+  _tileRatio(1.0), _prefetch(0), _valid(false)
 {
 	QVector<ISO8211::Record> gv;
 	ISO8211 ddf(fileName);
@@ -193,16 +193,17 @@ void ENCMap::load(const Projection &in, const Projection &out,
 	_tileRatio = deviceRatio;
 	_projection = out;
 	Q_ASSERT(!_data);
-	_data = new MapData(path());
+	_data = new MapData(path(), _projection);
 	Q_ASSERT(!_style);
 	_style = new Style(deviceRatio);
 
-	QPixmapCache::clear();
+	_tileCache.clear();
 }
 
 void ENCMap::unload()
 {
 	cancelJobs(true);
+	_tileCache.clear();
 
 	delete _data;
 	_data = 0;
@@ -276,22 +277,12 @@ void ENCMap::updateTransform()
 	  _transform.proj2img(prect.bottomRight()));
 }
 
-bool ENCMap::isRunning(int zoom, const QPoint &xy) const
-{
-	for (int i = 0; i < _jobs.size(); i++) {
-		const QList<ENC::RasterTile> &tiles = _jobs.at(i)->tiles();
-		for (int j = 0; j < tiles.size(); j++) {
-			const ENC::RasterTile &mt = tiles.at(j);
-			if (mt.zoom() == zoom && mt.xy() == xy)
-				return true;
-		}
-	}
-
-	return false;
-}
-
 void ENCMap::runJob(ENCJob *job)
 {
+	const QList<ENC::RasterTile> &tiles = job->tiles();
+	for (int i = 0; i < tiles.size(); i++)
+		_running.insert(key(tiles.at(i).zoom(), tiles.at(i).xy()));
+
 	_jobs.append(job);
 
 	connect(job, &ENCJob::finished, this, &ENCMap::jobFinished);
@@ -300,7 +291,13 @@ void ENCMap::runJob(ENCJob *job)
 
 void ENCMap::removeJob(ENCJob *job)
 {
+	const QList<ENC::RasterTile> &tiles = job->tiles();
+	for (int i = 0; i < tiles.size(); i++)
+		_running.remove(key(tiles.at(i).zoom(), tiles.at(i).xy()));
+
 	_jobs.removeOne(job);
+	if (job == _prefetch)
+		_prefetch = 0;
 	job->deleteLater();
 }
 
@@ -311,7 +308,7 @@ void ENCMap::jobFinished(ENCJob *job)
 	for (int i = 0; i < tiles.size(); i++) {
 		const ENC::RasterTile &mt = tiles.at(i);
 		if (!mt.pixmap().isNull())
-			QPixmapCache::insert(key(mt.zoom(), mt.xy()), mt.pixmap());
+			_tileCache.insert(key(mt.zoom(), mt.xy()), mt.pixmap());
 	}
 
 	removeJob(job);
@@ -325,15 +322,18 @@ void ENCMap::cancelJobs(bool wait)
 		_jobs.at(i)->cancel(wait);
 }
 
-QString ENCMap::key(int zoom, const QPoint &xy) const
+quint64 ENCMap::key(int zoom, const QPoint &xy) const
 {
-	return path() + "-" + QString::number(zoom) + "_"
-	  + QString::number(xy.x()) + "_" + QString::number(xy.y());
+	return TileCache::key(zoom, QPoint(xy.x() / TILE_SIZE, xy.y() / TILE_SIZE));
 }
 
-void ENCMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
+/* Draws the cached tiles (if painter is set) and returns the missing ones.
+   The missing tiles are drawn using the cached tiles of the other zooms
+   until they are rendered (except when blocking). */
+QList<RasterTile> ENCMap::tiles(QPainter *painter, int zoom,
+  const Transform &transform, const QRectF &rect, Flags flags)
 {
-	Q_UNUSED(flags);
+	bool fallback = painter && !(flags & Map::Block);
 	QPointF tl(floor(rect.left() / TILE_SIZE) * TILE_SIZE,
 	  floor(rect.top() / TILE_SIZE) * TILE_SIZE);
 	QSizeF s(rect.right() - tl.x(), rect.bottom() - tl.y());
@@ -345,35 +345,79 @@ void ENCMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 	for (int i = 0; i < width; i++) {
 		for (int j = 0; j < height; j++) {
 			QPoint ttl(tl.x() + i * TILE_SIZE, tl.y() + j * TILE_SIZE);
-			if (isRunning(_zoom, ttl))
+			QRect tr(ttl, QSize(TILE_SIZE, TILE_SIZE));
+			if (isRunning(zoom, ttl)) {
+				if (fallback)
+					_tileCache.drawFallback(painter, zoom, ttl / TILE_SIZE, tr,
+					  _zooms);
 				continue;
+			}
 
 			QPixmap pm;
-			if (QPixmapCache::find(key(_zoom, ttl), &pm))
-				painter->drawPixmap(ttl, pm);
-			else
-				tiles.append(RasterTile(_projection, _transform, _style, _data,
-				  _zoom, _zooms, QRect(ttl, QSize(TILE_SIZE, TILE_SIZE)),
-				  _tileRatio));
+			if (_tileCache.find(key(zoom, ttl), &pm)) {
+				if (painter)
+					painter->drawPixmap(ttl, pm);
+			} else {
+				if (fallback)
+					_tileCache.drawFallback(painter, zoom, ttl / TILE_SIZE, tr,
+					  _zooms);
+				tiles.append(RasterTile(_projection, transform, _style, _data,
+				  zoom, _zooms, tr, _tileRatio));
+			}
 		}
 	}
 
+	std::sort(tiles.begin(), tiles.end(), TileOrder<RasterTile>(rect.center()
+	  - QPointF(TILE_SIZE / 2, TILE_SIZE / 2)));
+
+	return tiles;
+}
+
+void ENCMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
+{
+	if (_prefetch)
+		_prefetch->cancel(false);
+
+	QList<RasterTile> tiles(this->tiles(painter, _zoom, _transform, rect,
+	  flags));
+
 	if (!tiles.isEmpty()) {
 		if (flags & Map::Block) {
-			QFuture<void> future = QtConcurrent::map(tiles, &RasterTile::render);
+			QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+			  tiles, &RasterTile::render);
 			future.waitForFinished();
 
 			for (int i = 0; i < tiles.size(); i++) {
 				const RasterTile &mt = tiles.at(i);
 				const QPixmap &pm = mt.pixmap();
 				painter->drawPixmap(mt.xy(), pm);
-				QPixmapCache::insert(key(mt.zoom(), mt.xy()), pm);
+				_tileCache.insert(key(mt.zoom(), mt.xy()), pm);
 			}
 		} else
 			runJob(new ENCJob(tiles));
 	}
 }
 
+void ENCMap::prefetch(const QRectF &rect, Flags flags)
+{
+	/* Only when idle, i.e. all the visible tiles are rendered */
+	if (!_jobs.isEmpty())
+		return;
+
+	QList<RasterTile> tiles;
+	for (int dz = 1; dz >= -1; dz -= 2) {
+		int z = _zoom + dz;
+		QRectF zr(zoomRect(rect, _bounds, dz));
+		if (_zooms.contains(z) && !zr.isEmpty())
+			tiles.append(this->tiles(0, z, transform(z), zr, flags));
+	}
+
+	if (!tiles.isEmpty()) {
+		_prefetch = new ENCJob(tiles);
+		runJob(_prefetch);
+	}
+}
+
 Map *ENCMap::create(const QString &path, const Projection &proj, bool *isMap)
 {
 	Q_UNUSED(proj);
@@ -3,8 +3,10 @@
 
 #include <climits>
 #include <QtConcurrent>
+#include <QSet>
 #include "common/range.h"
 #include "map.h"
+#include "tilecache.h"
 #include "projection.h"
 #include "transform.h"
 #include "ENC/iso8211.h"
@@ -42,6 +44,7 @@ public:
 	  {return _projection.xy2ll(_transform.img2proj(p));}
 
 	void draw(QPainter *painter, const QRectF &rect, Flags flags);
+	void prefetch(const QRectF &rect, Flags flags);
 
 	bool isValid() const {return _valid;}
 	QString errorString() const {return _errorString;}
@@ -88,11 +91,14 @@ private:
 
 	Transform transform(int zoom) const;
 	void updateTransform();
-	bool isRunning(int zoom, const QPoint &xy) const;
+	bool isRunning(int zoom, const QPoint &xy) const
+	  {return _running.contains(key(zoom, xy));}
 	void runJob(ENCJob *job);
 	void removeJob(ENCJob *job);
 	void cancelJobs(bool wait);
-	QString key(int zoom, const QPoint &xy) const;
+	quint64 key(int zoom, const QPoint &xy) const;
+	QList<ENC::RasterTile> tiles(QPainter *painter, int zoom,
+	  const Transform &transform, const QRectF &rect, Flags flags);
 
 	static bool bounds(const ENC::ISO8211::Record &record, Rect &rect);
 	static bool bounds(const QVector<ENC::ISO8211::Record> &gv, Rect &b);
@@ -110,7 +116,10 @@ private:
 	Range _zooms;
 	int _zoom;
 
+	TileCache _tileCache;
 	QList<ENCJob*> _jobs;
+	QSet<quint64> _running;
+	ENCJob *_prefetch;
 
 	bool _valid;
 	QString _errorString;
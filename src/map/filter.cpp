@@ -1,4 +1,5 @@
 #include <cmath>
+#include "alignedmatrix.h"
 #include "filter.h"
 
 static QVector<int> boxesForGauss(double sigma, int n)
@@ -20,119 +21,141 @@ static QVector<int> boxesForGauss(double sigma, int n)
 	return sizes;
 }
 
-static void boxBlurH4(const MatrixD &src, MatrixD &dst, int r)
+static void boxBlurH4(const AlignedMatrixD &src, AlignedMatrixD &dst, int r)
 {
 	double iarr = 1.0 / (r + r + 1);
+	int w = src.w();
 
 	for (int i = 0; i < src.h(); i++) {
-		int ti = i * src.w(), li = ti, ri = ti + r;
-		double fv = src.at(ti);
-		double lv = src.at(ti + src.w() - 1);
+		const double *s = src.row(i);
+		double *d = dst.row(i);
+		int ti = 0, li = 0, ri = r;
+		double fv = s[0];
+		double lv = s[w - 1];
 		double val = (r + 1) * fv;
 
 		for (int j = 0; j < r; j++)
-			val += src.at(ti + j);
+			val += s[j];
 		for (int j = 0; j <= r; j++) {
-			val += src.at(ri++) - fv;
-			dst.at(ti++) = val * iarr;
+			val += s[ri++] - fv;
+			d[ti++] = val * iarr;
 		}
-		for (int j = r + 1; j < src.w() - r; j++) {
-			val += src.at(ri++) - src.at(li++);
-			dst.at(ti++) = val * iarr;
+		for (int j = r + 1; j < w - r; j++) {
+			val += s[ri++] - s[li++];
+			d[ti++] = val * iarr;
 		}
-		for (int j = src.w() - r; j < src.w(); j++) {
-			val += lv - src.at(li++);
-			dst.at(ti++) = val * iarr;
+		for (int j = w - r; j < w; j++) {
+			val += lv - s[li++];
+			d[ti++] = val * iarr;
 		}
 	}
 }
 
-static void boxBlurT4(const MatrixD &src, MatrixD &dst, int r)
+/* The vertical pass processes all the columns at once row by row (with
+   a row of running sums) rather than column by column to access the matrix
+   sequentially. The per-column arithmetic is the same. */
+static void boxBlurT4(const AlignedMatrixD &src, AlignedMatrixD &dst, int r)
 {
 	double iarr = 1.0 / (r + r + 1);
-
-	for (int i = 0; i < src.w(); i++) {
-		int ti = i, li = ti, ri = ti + r * src.w();
-		double fv = src.at(ti);
-		double lv = src.at(ti + src.w() * (src.h() - 1));
-		double val = (r + 1) * fv;
-
-		for (int j = 0; j < r; j++)
-			val += src.at(ti + j * src.w());
-		for (int j = 0; j <= r; j++) {
-			val += src.at(ri) - fv;
-			dst.at(ti) = val * iarr;
-			ri += src.w(); ti += src.w();
+	int w = src.w(), h = src.h();
+	QVector<double> acc(w);
+	double *val = acc.data();
+	const double *fv = src.row(0);
+	const double *lv = src.row(h - 1);
+
+	for (int k = 0; k < w; k++)
+		val[k] = (r + 1) * fv[k];
+	for (int j = 0; j < r; j++) {
+		const double *s = src.row(j);
+		for (int k = 0; k < w; k++)
+			val[k] += s[k];
+	}
+	for (int j = 0; j <= r; j++) {
+		const double *rs = src.row(j + r);
+		double *d = dst.row(j);
+		for (int k = 0; k < w; k++) {
+			val[k] += rs[k] - fv[k];
+			d[k] = val[k] * iarr;
 		}
-		for (int j = r + 1; j < src.h() - r; j++) {
-			val += src.at(ri) - src.at(li);
-			dst.at(ti) = val * iarr;
-			li += src.w(); ri += src.w(); ti += src.w();
+	}
+	for (int j = r + 1; j < h - r; j++) {
+		const double *rs = src.row(j + r);
+		const double *ls = src.row(j - r - 1);
+		double *d = dst.row(j);
+		for (int k = 0; k < w; k++) {
+			val[k] += rs[k] - ls[k];
+			d[k] = val[k] * iarr;
 		}
-		for (int j = src.h() - r; j < src.h(); j++) {
-			val += lv - src.at(li);
-			dst.at(ti) = val * iarr;
-			li += src.w(); ti += src.w();
+	}
+	for (int j = h - r; j < h; j++) {
+		const double *ls = src.row(j - r - 1);
+		double *d = dst.row(j);
+		for (int k = 0; k < w; k++) {
+			val[k] += lv[k] - ls[k];
+			d[k] = val[k] * iarr;
 		}
 	}
 }
 
-static void boxBlur4(MatrixD &src, MatrixD &dst, int r)
-{
-	for (int i = 0; i < src.size(); i++)
-		dst.at(i) = src.at(i);
-
-	boxBlurH4(dst, src, r);
-	boxBlurT4(src, dst, r);
-}
-
-static void gaussBlur4(MatrixD &src, MatrixD &dst, int r)
+/* The blur result ends up in src, the passes are run back and forth between
+   the matrices instead of copying src to dst before every box blur. */
+static void gaussBlur4(AlignedMatrixD &src, AlignedMatrixD &dst, int r)
 {
 	QVector<int> bxs(boxesForGauss(r, 3));
 
-	boxBlur4(src, dst, (bxs.at(0) - 1) / 2);
-	boxBlur4(dst, src, (bxs.at(1) - 1) / 2);
-	boxBlur4(src, dst, (bxs.at(2) - 1) / 2);
+	for (int i = 0; i < bxs.size(); i++) {
+		boxBlurH4(src, dst, (bxs.at(i) - 1) / 2);
+		boxBlurT4(dst, src, (bxs.at(i) - 1) / 2);
+	}
 }
 
-static int hasNANs(const MatrixD &m)
+static bool hasNANs(const MatrixD &m)
 {
 	for (int i = 0; i < m.size(); i++)
 		if (std::isnan(m.at(i)))
-			return i;
+			return true;
 
-	return -1;
+	return false;
 }
 
+/* The blur passes work on aligned (pooled) temporaries, only the result is
+   converted back to a MatrixD. */
 MatrixD Filter::blur(const MatrixD &m, int radius)
 {
-	MatrixD src(m);
-	MatrixD dst(m.h(), m.w());
-	int firstNAN = hasNANs(m);
+	AlignedMatrixD src(m);
+	AlignedMatrixD dst(m.h(), m.w());
 
-	if (firstNAN >= 0) {
+	if (hasNANs(m)) {
 		// https://stackoverflow.com/a/36307291
-		MatrixD z(m.h(), m.w(), 1);
-		MatrixD zdst(m.h(), m.w());
-
-		for (int i = firstNAN; i < m.size(); i++) {
-			if (std::isnan(m.at(i))) {
-				z.at(i) = 0;
-				src.at(i) = 0;
+		AlignedMatrixD z(m.h(), m.w());
+
+		for (int i = 0; i < m.h(); i++) {
+			double *s = src.row(i);
+			double *zr = z.row(i);
+			for (int j = 0; j < m.w(); j++) {
+				if (std::isnan(s[j])) {
+					zr[j] = 0;
+					s[j] = 0;
+				} else
+					zr[j] = 1;
 			}
 		}
 
-		gaussBlur4(z, zdst, radius);
+		gaussBlur4(z, dst, radius);
 		gaussBlur4(src, dst, radius);
 
-		for (int i = 0; i < m.size(); i++)
-			dst.at(i) = dst.at(i) / zdst.at(i);
-
-		for (int i = firstNAN; i < m.size(); i++)
-			if (std::isnan(m.at(i)))
-				dst.at(i) = NAN;
+		for (int i = 0; i < m.h(); i++) {
+			const double *mr = m.row(i);
+			const double *zr = z.row(i);
+			double *s = src.row(i);
+			for (int j = 0; j < m.w(); j++)
+				s[j] = std::isnan(mr[j]) ? NAN : s[j] / zr[j];
+		}
 	} else
 		gaussBlur4(src, dst, radius);
 
-	return dst;
+	MatrixD ret(m.h(), m.w());
+	src.copyTo(ret);
+
+	return ret;
 }
@@ -1,5 +1,6 @@
 #include <QFile>
 #include "common/csv.h"
+#include "lazylist.h"
 #include "gcs.h"
 
 
@@ -45,6 +46,7 @@ static double parameterd(const QByteArray &str, bool *res)
 
 
 QList<GCS::Entry> GCS::_gcss = defaults();
+static LazyList gcsList;
 
 const GCS &GCS::WGS84()
 {
@@ -61,19 +63,15 @@ QList<GCS::Entry> GCS::defaults()
 	return list;
 }
 
-GCS GCS::gcs(int id)
+GCS GCS::find(int id)
 {
-	// There are GCSs without EPSG code (id = 0) in the list!
-	if (!id)
-		return GCS();
-
-	QList<GCS::Entry>::iterator it = std::lower_bound(
-	  _gcss.begin(), _gcss.end(), id);
+	QList<GCS::Entry>::const_iterator it = std::lower_bound(
+	  _gcss.constBegin(), _gcss.constEnd(), id);
 
-	return (it == _gcss.end() || id != it->id()) ? GCS() : it->gcs();
+	return (it == _gcss.constEnd() || id != it->id()) ? GCS() : it->gcs();
 }
 
-GCS GCS::gcs(int geodeticDatum, int primeMeridian, int angularUnits)
+GCS GCS::find(int geodeticDatum, int primeMeridian, int angularUnits)
 {
 	for (int i = 0; i < _gcss.size(); i++) {
 		const Entry &e = _gcss.at(i);
@@ -85,7 +83,7 @@ GCS GCS::gcs(int geodeticDatum, int primeMeridian, int angularUnits)
 	return GCS();
 }
 
-GCS GCS::gcs(const QString &name)
+GCS GCS::find(const QString &name)
 {
 	for (int i = 0; i < _gcss.size(); i++)
 		if (_gcss.at(i).name() == name)
@@ -94,7 +92,67 @@ GCS GCS::gcs(const QString &name)
 	return GCS();
 }
 
+GCS GCS::gcs(int id)
+{
+	// There are GCSs without EPSG code (id = 0) in the list!
+	if (!id)
+		return GCS();
+	if (gcsList.isLoaded())
+		return find(id);
+
+	QMutexLocker locker(&gcsList.lock());
+	GCS gcs(find(id));
+	if (gcs.isNull() && load())
+		gcs = find(id);
+
+	return gcs;
+}
+
+GCS GCS::gcs(int geodeticDatum, int primeMeridian, int angularUnits)
+{
+	if (gcsList.isLoaded())
+		return find(geodeticDatum, primeMeridian, angularUnits);
+
+	QMutexLocker locker(&gcsList.lock());
+	GCS gcs(find(geodeticDatum, primeMeridian, angularUnits));
+	if (gcs.isNull() && load())
+		gcs = find(geodeticDatum, primeMeridian, angularUnits);
+
+	return gcs;
+}
+
+GCS GCS::gcs(const QString &name)
+{
+	if (gcsList.isLoaded())
+		return find(name);
+
+	QMutexLocker locker(&gcsList.lock());
+	GCS gcs(find(name));
+	if (gcs.isNull() && load())
+		gcs = find(name);
+
+	return gcs;
+}
+
+/* The list is only registered here and loaded on the first lookup that
+   the defaults can not satisfy. */
 bool GCS::loadList(const QString &path)
+{
+	gcsList.setPath(path);
+	return true;
+}
+
+bool GCS::load()
+{
+	QString path(gcsList.take());
+	if (!path.isNull())
+		loadFile(path);
+	gcsList.setLoaded();
+
+	return !path.isNull();
+}
+
+bool GCS::loadFile(const QString &path)
 {
 	QFile file(path);
 	CSV csv(&file);
@@ -236,6 +294,11 @@ QList<KV<int, QString> > GCS::list()
 {
 	QList<KV<int, QString> > list;
 
+	if (!gcsList.isLoaded()) {
+		QMutexLocker locker(&gcsList.lock());
+		load();
+	}
+
 	for (int i = 0; i < _gcss.size(); i++) {
 		const Entry &e = _gcss.at(i);
 		if (!e.id() || (!list.isEmpty() && e.id() == list.last().key()))
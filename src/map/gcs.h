@@ -39,6 +39,19 @@ public:
 		Coordinates ds(datum().fromWGS84(c));
 		return Coordinates(_primeMeridian.fromGreenwich(ds.lon()), ds.lat());
 	}
+	void fromWGS84(const Coordinates *c, Coordinates *out, int n) const
+	{
+		datum().fromWGS84(c, out, n);
+		for (int i = 0; i < n; i++)
+			out[i].setLon(_primeMeridian.fromGreenwich(out[i].lon()));
+	}
+	void toWGS84(const Coordinates *c, Coordinates *out, int n) const
+	{
+		for (int i = 0; i < n; i++)
+			out[i] = Coordinates(_primeMeridian.toGreenwich(c[i].lon()),
+			  c[i].lat());
+		datum().toWGS84(out, out, n);
+	}
 
 	static GCS gcs(int id);
 	static GCS gcs(int geodeticDatum, int primeMeridian, int angularUnits);
@@ -53,6 +66,11 @@ private:
 	class Entry;
 
 	static QList<Entry> defaults();
+	static GCS find(int id);
+	static GCS find(int geodeticDatum, int primeMeridian, int angularUnits);
+	static GCS find(const QString &name);
+	static bool load();
+	static bool loadFile(const QString &path);
 
 	Datum _datum;
 	PrimeMeridian _primeMeridian;
@@ -1,9 +1,8 @@
 #include <QDataStream>
 #include <QPainter>
-#include <QPixmapCache>
-#include <QtConcurrent>
+#include "common/threadpools.h"
 #include "osm.h"
-#include "tile.h"
+#include "tileorder.h"
 #include "gemfmap.h"
 
 static bool readSources(QDataStream &stream)
@@ -154,12 +153,16 @@ int GEMFMap::zoomFit(const QSize &size, const RectC &rect)
 
 int GEMFMap::zoomIn()
 {
+	cancelJobs(false);
+
 	_zi = qMin(_zi + 1, _zooms.size() - 1);
 	return _zi;
 }
 
 int GEMFMap::zoomOut()
 {
+	cancelJobs(false);
+
 	_zi = qMax(_zi - 1, 0);
 	return _zi;
 }
@@ -176,6 +179,12 @@ QPointF GEMFMap::ll2xy(const Coordinates &c)
 	return QPointF(m.x() / scale, m.y() / -scale) / _mapRatio;
 }
 
+void GEMFMap::ll2xy(const Coordinates *c, QPointF *p, int n)
+{
+	OSM::ll2xy(c, p, n, OSM::zoom2scale(_zooms.at(_zi).level, _tileSize),
+	  _mapRatio);
+}
+
 Coordinates GEMFMap::xy2ll(const QPointF &p)
 {
 	qreal scale = OSM::zoom2scale(_zooms.at(_zi).level, _tileSize);
@@ -198,7 +207,10 @@ void GEMFMap::load(const Projection &in, const Projection &out,
 
 void GEMFMap::unload()
 {
+	cancelJobs(true);
+
 	_file.close();
+	_tileCache.clear();
 }
 
 qreal GEMFMap::tileSize() const
@@ -206,9 +218,11 @@ qreal GEMFMap::tileSize() const
 	return (_tileSize / _mapRatio);
 }
 
-QByteArray GEMFMap::tileData(const QPoint &tile)
+/* Called from the tile loading threads, the zoom is the zoom index */
+QByteArray GEMFMap::tileData(int zoom, const QPoint &tile)
 {
-	const Zoom &z = _zooms.at(_zi);
+	const Zoom &z = _zooms.at(zoom);
+	QMutexLocker locker(&_lock);
 
 	for(int i = 0; i < z.ranges.size(); i++) {
 		const Region &r = z.ranges.at(i);
@@ -244,7 +258,6 @@ QByteArray GEMFMap::tileData(const QPoint &tile)
 
 void GEMFMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 {
-	Q_UNUSED(flags);
 	const Zoom &z = _zooms.at(_zi);
 	qreal scale = OSM::zoom2scale(z.level, _tileSize);
 	QPoint tile = OSM::mercator2tile(QPointF(rect.topLeft().x() * scale,
@@ -261,19 +274,31 @@ void GEMFMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		for (int j = 0; j < height; j++) {
 			QPixmap pm;
 			QPoint t(tile.x() + i, tile.y() + j);
-			QString key = path() + "-" + QString::number(z.level) + "_"
-			  + QString::number(t.x()) + "_" + QString::number(t.y());
+			quint64 key = TileCache::key(z.level, t);
+
+			if (isRunning(key))
+				continue;
 
-			if (QPixmapCache::find(key, &pm)) {
+			if (_tileCache.find(key, &pm, _mapRatio)) {
 				QPointF tp(tl.x() + (t.x() - tile.x()) * tileSize(),
 				  tl.y() + (t.y() - tile.y()) * tileSize());
 				drawTile(painter, pm, tp);
 			} else
-				tiles.append(DataTile(t, tileData(t), key));
+				tiles.append(DataTile(t, _zi, this, key));
 		}
 	}
 
-	QFuture<void> future = QtConcurrent::map(tiles, &DataTile::load);
+	if (tiles.isEmpty())
+		return;
+	if (!(flags & Map::Block)) {
+		std::sort(tiles.begin(), tiles.end(), TileOrder<DataTile>(QPointF(
+		  tile.x() + (width - 1) / 2.0, tile.y() + (height - 1) / 2.0)));
+		runJob(new DataTileJob(tiles));
+		return;
+	}
+
+	QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+	  tiles, &DataTile::load);
 	future.waitForFinished();
 
 	for (int i = 0; i < tiles.size(); i++) {
@@ -282,7 +307,7 @@ void GEMFMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		if (pm.isNull())
 			continue;
 
-		QPixmapCache::insert(mt.key(), pm);
+		_tileCache.insert(mt.key(), pm);
 
 		QPointF tp(tl.x() + (mt.xy().x() - tile.x()) * tileSize(),
 		  tl.y() + (mt.xy().y() - tile.y())* tileSize());
@@ -296,6 +321,63 @@ void GEMFMap::drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp)
 	painter->drawPixmap(tp, pixmap);
 }
 
+bool GEMFMap::isRunning(quint64 key) const
+{
+	for (int i = 0; i < _jobs.size(); i++) {
+		const QList<DataTile> &tiles = _jobs.at(i)->tiles();
+		for (int j = 0; j < tiles.size(); j++)
+			if (tiles.at(j).key() == key)
+				return true;
+	}
+
+	return false;
+}
+
+void GEMFMap::runJob(DataTileJob *job)
+{
+	_jobs.append(job);
+
+	connect(job, &DataTileJob::finished, this, &GEMFMap::jobFinished);
+	job->run();
+}
+
+void GEMFMap::removeJob(DataTileJob *job)
+{
+	_jobs.removeOne(job);
+	job->deleteLater();
+}
+
+void GEMFMap::jobFinished(DataTileJob *job)
+{
+	const QList<DataTile> &tiles = job->tiles();
+
+	for (int i = 0; i < tiles.size(); i++) {
+		const DataTile &mt = tiles.at(i);
+		if (!mt.pixmap().isNull())
+			_tileCache.insert(mt.key(), mt.pixmap());
+	}
+
+	removeJob(job);
+
+	emit tilesLoaded();
+}
+
+void GEMFMap::cancelJobs(bool wait)
+{
+	for (int i = 0; i < _jobs.size(); i++)
+		_jobs.at(i)->cancel(wait);
+
+	/* Waiting cancels (unload) drop the jobs including the results of the
+	   jobs that finished but whose finished signal is still queued */
+	if (wait) {
+		while (!_jobs.isEmpty()) {
+			DataTileJob *job = _jobs.first();
+			job->disconnect(this);
+			removeJob(job);
+		}
+	}
+}
+
 Map *GEMFMap::create(const QString &path, const Projection &proj, bool *isDir)
 {
 	Q_UNUSED(proj);
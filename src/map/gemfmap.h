@@ -2,10 +2,13 @@
 #define GEMFMAP_H
 
 #include <QFile>
+#include <QMutex>
 #include <QDebug>
 #include "map.h"
+#include "tilecache.h"
+#include "datatilejob.h"
 
-class GEMFMap : public Map
+class GEMFMap : public Map, public DataTileSource
 {
 public:
 	Q_OBJECT
@@ -17,7 +20,7 @@ public:
 	RectC llBounds() {return _bounds;}
 
 	int zoom() const {return _zi;}
-	void setZoom(int zoom) {_zi = zoom;}
+	void setZoom(int zoom) {cancelJobs(false); _zi = zoom;}
 	int zoomFit(const QSize &size, const RectC &rect);
 	int zoomIn();
 	int zoomOut();
@@ -25,6 +28,7 @@ public:
 
 	QPointF ll2xy(const Coordinates &c);
 	Coordinates xy2ll(const QPointF &p);
+	void ll2xy(const Coordinates *c, QPointF *p, int n);
 
 	void load(const Projection &in, const Projection &out, qreal deviceRatio,
 	  bool hidpi, int style, int layer);
@@ -37,6 +41,11 @@ public:
 
 	static Map *create(const QString &path, const Projection &proj, bool *isDir);
 
+	QByteArray tileData(int zoom, const QPoint &tile);
+
+private slots:
+	void jobFinished(DataTileJob *job);
+
 private:
 	struct Region {
 		quint32 minX;
@@ -63,18 +72,24 @@ private:
 	bool readRegions(QDataStream &stream);
 	bool computeBounds();
 	qreal tileSize() const;
-	QByteArray tileData(const QPoint &tile);
 	void drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp);
+	bool isRunning(quint64 key) const;
+	void runJob(DataTileJob *job);
+	void removeJob(DataTileJob *job);
+	void cancelJobs(bool wait);
 
 	friend QDebug operator<<(QDebug dbg, const Region &region);
 	friend QDebug operator<<(QDebug dbg, const Zoom &zoom);
 
 	QFile _file;
+	QMutex _lock;
 	int _zi;
 	RectC _bounds;
 	qreal _mapRatio;
 	int _tileSize;
 	QList<Zoom> _zooms;
+	TileCache _tileCache;
+	QList<DataTileJob*> _jobs;
 
 	bool _valid;
 	QString _errorString;
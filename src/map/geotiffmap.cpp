@@ -1,19 +1,33 @@
 #include <QPainter>
 #include <QImageReader>
+#include "common/threadpools.h"
 #include "geotiff.h"
 #include "image.h"
+#include "rectd.h"
 #include "geotiffmap.h"
 
 
 GeoTIFFMap::GeoTIFFMap(const QString &fileName, QObject *parent)
-  : Map(fileName, parent), _img(0), _ratio(1.0), _valid(false)
+  : Map(fileName, parent), _img(0), _tiff(0), _zoom(0), _scale(1.0, 1.0),
+  _ratio(1.0), _valid(false)
 {
-	QImageReader ir(fileName);
-	if (!ir.canRead()) {
-		_errorString = "Unsupported/invalid image file";
-		return;
+	/* Tiled/striped images are read on demand, the images not supported by
+	   the TIFF reader are loaded as a whole using the Qt image plugin */
+	_tiff = new TIFFImage(fileName);
+	if (_tiff->open()) {
+		_size = _tiff->size(0);
+		_tiff->close();
+	} else {
+		delete _tiff;
+		_tiff = 0;
+
+		QImageReader ir(fileName);
+		if (!ir.canRead()) {
+			_errorString = "Unsupported/invalid image file";
+			return;
+		}
+		_size = ir.size();
 	}
-	_size = ir.size();
 
 	GeoTIFF gt(fileName);
 	if (!gt.isValid()) {
@@ -30,26 +44,148 @@ GeoTIFFMap::GeoTIFFMap(const QString &fileName, QObject *parent)
 GeoTIFFMap::~GeoTIFFMap()
 {
 	delete _img;
+	delete _tiff;
 }
 
 QPointF GeoTIFFMap::ll2xy(const Coordinates &c)
 {
-	return QPointF(_transform.proj2img(_projection.ll2xy(c))) / _ratio;
+	QPointF p(_transform.proj2img(_projection.ll2xy(c)));
+	return QPointF(p.x() * _scale.x(), p.y() * _scale.y()) / _ratio;
+}
+
+void GeoTIFFMap::ll2xy(const Coordinates *c, QPointF *p, int n)
+{
+	QVector<PointD> pp(n);
+
+	_projection.ll2xy(c, pp.data(), n);
+	for (int i = 0; i < n; i++) {
+		QPointF ip(_transform.proj2img(pp.at(i)));
+		p[i] = QPointF(ip.x() * _scale.x(), ip.y() * _scale.y()) / _ratio;
+	}
 }
 
 Coordinates GeoTIFFMap::xy2ll(const QPointF &p)
 {
-	return _projection.xy2ll(_transform.img2proj(p * _ratio));
+	return _projection.xy2ll(_transform.img2proj(QPointF(p.x() / _scale.x(),
+	  p.y() / _scale.y()) * _ratio));
 }
 
 QRectF GeoTIFFMap::bounds()
 {
-	return QRectF(QPointF(0, 0), _size / _ratio);
+	return QRectF(QPointF(0, 0), (_tiff ? _tiff->size(_zoom) : _size) / _ratio);
+}
+
+void GeoTIFFMap::setZoom(int zoom)
+{
+	if (_tiff && zoom >= 0 && zoom < _tiff->zooms())
+		rescale(zoom);
+}
+
+int GeoTIFFMap::zoomFit(const QSize &size, const RectC &rect)
+{
+	if (!_tiff)
+		return _zoom;
+
+	if (!rect.isValid())
+		rescale(0);
+	else {
+		RectD prect(rect, _projection);
+		QRectF sbr(_transform.proj2img(prect.topLeft()),
+		  _transform.proj2img(prect.bottomRight()));
+
+		for (int i = 0; i < _tiff->zooms(); i++) {
+			rescale(i);
+			if (sbr.size().width() * _scale.x() <= size.width()
+			  && sbr.size().height() * _scale.y() <= size.height())
+				break;
+		}
+	}
+
+	return _zoom;
+}
+
+int GeoTIFFMap::zoomIn()
+{
+	if (_tiff)
+		rescale(qMax(_zoom - 1, 0));
+
+	return _zoom;
+}
+
+int GeoTIFFMap::zoomOut()
+{
+	if (_tiff)
+		rescale(qMin(_zoom + 1, _tiff->zooms() - 1));
+
+	return _zoom;
+}
+
+void GeoTIFFMap::rescale(int zoom)
+{
+	_zoom = zoom;
+	_scale = _tiff->scale(zoom);
+}
+
+void GeoTIFFMap::drawTile(QPainter *painter, QPixmap &pixmap,
+  const QPoint &tile)
+{
+	QSize ts(_tiff->tileSize(_zoom));
+
+	pixmap.setDevicePixelRatio(_ratio);
+	painter->drawPixmap(QPointF(tile.x() * ts.width(), tile.y() * ts.height())
+	  / _ratio, pixmap);
+}
+
+void GeoTIFFMap::drawTiled(QPainter *painter, const QRectF &rect)
+{
+	QSize ts(_tiff->tileSize(_zoom));
+	QSize dim(_tiff->dim(_zoom));
+	QRectF sr(rect.topLeft() * _ratio, rect.size() * _ratio);
+	int left = qMax(0, (int)floor(sr.left() / ts.width()));
+	int top = qMax(0, (int)floor(sr.top() / ts.height()));
+	int right = qMin(dim.width() - 1, (int)floor(sr.right() / ts.width()));
+	int bottom = qMin(dim.height() - 1, (int)floor(sr.bottom() / ts.height()));
+	QList<GeoTIFFTile> tiles;
+
+	for (int i = left; i <= right; i++) {
+		for (int j = top; j <= bottom; j++) {
+			QPixmap pm;
+			QPoint t(i, j);
+			quint64 key = TileCache::key(_zoom, t);
+
+			if (_tileCache.find(key, &pm, _ratio))
+				drawTile(painter, pm, t);
+			else if (!_failed.contains(key))
+				tiles.append(GeoTIFFTile(_tiff, _zoom, t,
+				  _tiff->tileData(_zoom, i, j), key));
+		}
+	}
+
+	/* The file is read sequentially, the tiles are decoded in parallel */
+	QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+	  tiles, &GeoTIFFTile::load);
+	future.waitForFinished();
+
+	for (int i = 0; i < tiles.size(); i++) {
+		const GeoTIFFTile &mt = tiles.at(i);
+		QPixmap pm(mt.pixmap());
+		if (pm.isNull()) {
+			qWarning("%s: %d/%d,%d: error loading tile image",
+			  qUtf8Printable(path()), _zoom, mt.xy().x(), mt.xy().y());
+			_failed.insert(mt.key());
+			continue;
+		}
+
+		_tileCache.insert(mt.key(), pm);
+		drawTile(painter, pm, mt.xy());
+	}
 }
 
 void GeoTIFFMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 {
-	if (_img)
+	if (_tiff)
+		drawTiled(painter, rect);
+	else if (_img)
 		_img->draw(painter, rect, flags);
 }
 
@@ -63,13 +199,24 @@ void GeoTIFFMap::load(const Projection &in, const Projection &out,
 
 	_ratio = hidpi ? deviceRatio : 1.0;
 
-	_img = new Image(path());
-	if (_img)
-		_img->setDevicePixelRatio(_ratio);
+	if (_tiff) {
+		if (!_tiff->open())
+			qWarning("%s: %s", qUtf8Printable(path()),
+			  qUtf8Printable(_tiff->errorString()));
+	} else {
+		_img = new Image(path());
+		if (_img)
+			_img->setDevicePixelRatio(_ratio);
+	}
 }
 
 void GeoTIFFMap::unload()
 {
+	if (_tiff) {
+		_tiff->close();
+		_tileCache.clear();
+	}
+
 	delete _img;
 	_img = 0;
 }
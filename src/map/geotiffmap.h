@@ -1,12 +1,42 @@
 #ifndef GEOTIFFMAP_H
 #define GEOTIFFMAP_H
 
+#include <QPixmap>
+#include <QSet>
 #include "transform.h"
 #include "projection.h"
+#include "tilecache.h"
+#include "tiffimage.h"
 #include "map.h"
 
 class Image;
 
+class GeoTIFFTile
+{
+public:
+	GeoTIFFTile(const TIFFImage *tiff, int zoom, const QPoint &xy,
+	  const QByteArray &data, quint64 key)
+	  : _tiff(tiff), _zoom(zoom), _xy(xy), _data(data), _key(key) {}
+
+	const QPoint &xy() const {return _xy;}
+	quint64 key() const {return _key;}
+	const QPixmap &pixmap() const {return _pixmap;}
+
+	void load()
+	{
+		_pixmap = QPixmap::fromImage(_tiff->tile(_zoom, _xy.x(), _xy.y(),
+		  _data));
+	}
+
+private:
+	const TIFFImage *_tiff;
+	int _zoom;
+	QPoint _xy;
+	QByteArray _data;
+	quint64 _key;
+	QPixmap _pixmap;
+};
+
 class GeoTIFFMap : public Map
 {
 	Q_OBJECT
@@ -18,6 +48,13 @@ public:
 	QRectF bounds();
 	QPointF ll2xy(const Coordinates &c);
 	Coordinates xy2ll(const QPointF &p);
+	void ll2xy(const Coordinates *c, QPointF *p, int n);
+
+	int zoom() const {return _zoom;}
+	void setZoom(int zoom);
+	int zoomFit(const QSize &size, const RectC &rect);
+	int zoomIn();
+	int zoomOut();
 
 	void draw(QPainter *painter, const QRectF &rect, Flags flags);
 
@@ -32,10 +69,20 @@ public:
 	static Map *create(const QString &path, const Projection &proj, bool *isDir);
 
 private:
+	void rescale(int zoom);
+	void drawTiled(QPainter *painter, const QRectF &rect);
+	void drawTile(QPainter *painter, QPixmap &pixmap, const QPoint &tile);
+
 	Projection _projection;
 	Transform _transform;
 	Image *_img;
+	TIFFImage *_tiff;
+	TileCache _tileCache;
+	/* The broken tiles are reported and read only once */
+	QSet<quint64> _failed;
 	QSize _size;
+	int _zoom;
+	QPointF _scale;
 	qreal _ratio;
 
 	bool _valid;
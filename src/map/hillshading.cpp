@@ -1,6 +1,9 @@
 #include <cmath>
+#include "common/coordinates.h"
 #include "hillshading.h"
 
+#define CACHE_SIZE 32768 /* KB */
+
 struct Constants
 {
 	double a1;
@@ -8,18 +11,6 @@ struct Constants
 	double a3;
 };
 
-struct SubMatrix
-{
-	double z1;
-	double z2;
-	double z3;
-	double z4;
-	double z6;
-	double z7;
-	double z8;
-	double z9;
-};
-
 struct Derivatives
 {
 	double dzdx;
@@ -32,6 +23,8 @@ int HillShading::_azimuth = 315;
 int HillShading::_altitude = 45;
 double HillShading::_z = 0.6;
 double HillShading::_l = 0.2;
+QCache<QString, QImage> HillShading::_cache(CACHE_SIZE);
+QMutex HillShading::_lock;
 
 static void getConstants(double azimuth, double elevation, Constants &c)
 {
@@ -43,27 +36,15 @@ static void getConstants(double azimuth, double elevation, Constants &c)
 	c.a3 = cos(beta) * cos(alpha);
 }
 
-static void getDerivativesHorn(const SubMatrix &sm, double z, Derivatives &d)
+/* The 3x3 neighbourhood of the x-th sample is read directly from the three
+   adjacent matrix rows */
+static inline void getDerivativesHorn(const double *top, const double *mid,
+  const double *bottom, int x, double z, Derivatives &d)
 {
-	d.dzdx = (z * (sm.z3 + 2 * sm.z6 + sm.z9 - sm.z1 - 2 * sm.z4 - sm.z7)) / 8;
-	d.dzdy = (z * (sm.z1 + 2 * sm.z2 + sm.z3 - sm.z7 - 2 * sm.z8 - sm.z9)) / 8;
-}
-
-static void getSubmatrix(int x, int y, const MatrixD &m, SubMatrix &sm)
-{
-	int left = x - 1;
-	int right = x + 1;
-	int top = y - 1;
-	int bottom = y + 1;
-
-	sm.z1 = m.at(top, left);
-	sm.z2 = m.at(top, x);
-	sm.z3 = m.at(top, right);
-	sm.z4 = m.at(y, left);
-	sm.z6 = m.at(y, right);
-	sm.z7 = m.at(bottom, left);
-	sm.z8 = m.at(bottom, x);
-	sm.z9 = m.at(bottom, right);
+	d.dzdx = (z * (top[x+1] + 2 * mid[x+1] + bottom[x+1] - top[x-1]
+	  - 2 * mid[x-1] - bottom[x-1])) / 8;
+	d.dzdy = (z * (top[x-1] + 2 * top[x] + top[x+1] - bottom[x-1]
+	  - 2 * bottom[x] - bottom[x+1])) / 8;
 }
 
 QImage HillShading::render(const MatrixD &m, int extend)
@@ -74,7 +55,6 @@ QImage HillShading::render(const MatrixD &m, int extend)
 	int bpl = img.bytesPerLine();
 
 	Constants c;
-	SubMatrix sm;
 	Derivatives d;
 
 	getConstants(_azimuth, _altitude, c);
@@ -82,9 +62,13 @@ QImage HillShading::render(const MatrixD &m, int extend)
 	Q_ASSERT(extend > 0);
 
 	for (int y = extend; y < m.h() - extend; y++) {
+		const double *top = m.row(y - 1);
+		const double *mid = m.row(y);
+		const double *bottom = m.row(y + 1);
+		quint32 *line = (quint32*)(bits + (y - extend) * bpl);
+
 		for (int x = extend; x < m.w() - extend; x++) {
-			getSubmatrix(x, y, m, sm);
-			getDerivativesHorn(sm, _z, d);
+			getDerivativesHorn(top, mid, bottom, x, _z, d);
 
 			double L = (c.a1 - c.a2 * d.dzdx - c.a3 * d.dzdy)
 			  / sqrt(1.0 + d.dzdx * d.dzdx + d.dzdy * d.dzdy);
@@ -98,9 +82,42 @@ QImage HillShading::render(const MatrixD &m, int extend)
 				pixel = (_alpha - val)<<24;
 			}
 
-			*(quint32*)(bits + (y - extend) * bpl + (x - extend) * 4) = pixel;
+			line[x - extend] = pixel;
 		}
 	}
 
 	return img;
 }
+
+QString HillShading::key(const QString &id, const Coordinates &tl,
+  const Coordinates &br)
+{
+	return id + QString("_%1_%2_%3_%4-%5_%6_%7_%8_%9_%10")
+	  .arg(tl.lon(), 0, 'g', 15).arg(tl.lat(), 0, 'g', 15)
+	  .arg(br.lon(), 0, 'g', 15).arg(br.lat(), 0, 'g', 15)
+	  .arg(_alpha).arg(_blur).arg(_azimuth).arg(_altitude).arg(_z).arg(_l);
+}
+
+bool HillShading::find(const QString &key, QImage *img)
+{
+	QMutexLocker locker(&_lock);
+
+	QImage *ci = _cache.object(key);
+	if (!ci)
+		return false;
+	*img = *ci;
+
+	return true;
+}
+
+void HillShading::insert(const QString &key, const QImage &img)
+{
+	QMutexLocker locker(&_lock);
+	_cache.insert(key, new QImage(img), img.sizeInBytes() / 1024);
+}
+
+void HillShading::clearCache()
+{
+	QMutexLocker locker(&_lock);
+	_cache.clear();
+}
@@ -2,13 +2,25 @@
 #define HILLSHADING_H
 
 #include <QImage>
+#include <QCache>
+#include <QMutex>
 #include "map/matrix.h"
 
+class Coordinates;
+
 class HillShading
 {
 public:
 	static QImage render(const MatrixD &m, int extend);
 
+	/* Rendered hillshading cache. The key identifies the DEM window,
+	   the shading parameters are added to it implicitly. */
+	static QString key(const QString &id, const Coordinates &tl,
+	  const Coordinates &br);
+	static bool find(const QString &key, QImage *img);
+	static void insert(const QString &key, const QImage &img);
+	static void clearCache();
+
 	static int blur() {return _blur;}
 
 	static void setAlpha(int alpha) {_alpha = alpha;}
@@ -25,6 +37,9 @@ private:
 	static int _altitude;
 	static double _z;
 	static double _l;
+
+	static QCache<QString, QImage> _cache;
+	static QMutex _lock;
 };
 
 #endif // HILLSHADING_H
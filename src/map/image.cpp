@@ -1,36 +1,88 @@
+#include <cmath>
 #include <QPainter>
 #include "image.h"
 
 #define TILE_SIZE 256
-#if QT_VERSION >= QT_VERSION_CHECK(6, 5, 0)
-#define OPENGL_SIZE_LIMIT 536870912 /* 512MB */
-#else
-#define OPENGL_SIZE_LIMIT 134217728 /* 128MB */
-#endif
+
+int Image::zoom(qreal scale) const
+{
+	const QImage &img = _levels.first();
+	int z = 0;
+
+	/* Use the smallest level that is still at least the size of the drawn
+	   image, never go below a single tile */
+	while (scale <= 0.5 && qMax(img.width(), img.height()) >> (z + 1)
+	  >= TILE_SIZE) {
+		scale *= 2;
+		z++;
+	}
+
+	return z;
+}
+
+const QImage &Image::level(int zoom)
+{
+	for (int i = _levels.size(); i <= zoom; i++) {
+		const QImage &img = _levels.at(i - 1);
+		_levels.append(img.scaled(qMax(img.width() / 2, 1),
+		  qMax(img.height() / 2, 1), Qt::IgnoreAspectRatio,
+		  Qt::SmoothTransformation));
+	}
+
+	return _levels.at(zoom);
+}
+
+QPixmap Image::tile(int zoom, const QPoint &xy)
+{
+	QPixmap pm;
+	quint64 key = TileCache::key(zoom, xy);
+	qreal ratio = _ratio / (1 << zoom);
+
+	if (!_tileCache.find(key, &pm, ratio)) {
+		pm = QPixmap::fromImage(level(zoom).copy(QRect(xy * TILE_SIZE,
+		  QSize(TILE_SIZE, TILE_SIZE))));
+		if (!pm.isNull()) {
+			pm.setDevicePixelRatio(ratio);
+			_tileCache.insert(key, pm);
+		}
+	}
+
+	return pm;
+}
 
 void Image::draw(QPainter *painter, const QRectF &rect, Map::Flags flags)
 {
-	qreal ratio = _img.devicePixelRatioF();
-	QRectF sr(rect.topLeft() * ratio, rect.size() * ratio);
-
-	/* When OpenGL is used, big images are rendered incredibly slow or not at
-	   all using the QPainter::drawImage() function with a source rect set. So
-	   we have to tile the image ourself before it can be drawn. */
-	if (flags & Map::OpenGL && _img.sizeInBytes() > OPENGL_SIZE_LIMIT) {
-		for (int i = sr.left()/TILE_SIZE; i <= sr.right()/TILE_SIZE; i++) {
-			for (int j = sr.top()/TILE_SIZE; j <= sr.bottom()/TILE_SIZE; j++) {
-				QPoint tl(i * TILE_SIZE, j * TILE_SIZE);
-				QRect tile(tl, QSize(TILE_SIZE, TILE_SIZE));
-				QImage img(_img.copy(tile));
-				img.setDevicePixelRatio(ratio);
-				painter->drawImage(tl/ratio, img);
-			}
+	Q_UNUSED(flags);
+
+	if (_levels.first().isNull())
+		return;
+
+	/* The tiles are drawn as pixmaps, so with OpenGL they are uploaded as
+	   textures only once and big images do not need any special handling */
+	int z = zoom(painter->transform().m11());
+	int f = 1 << z;
+	const QImage &img = level(z);
+	QRectF sr(rect.topLeft() * _ratio / f, rect.size() * _ratio / f);
+	int left = qMax(0, (int)floor(sr.left() / TILE_SIZE));
+	int top = qMax(0, (int)floor(sr.top() / TILE_SIZE));
+	int right = qMin((img.width() - 1) / TILE_SIZE,
+	  (int)floor(sr.right() / TILE_SIZE));
+	int bottom = qMin((img.height() - 1) / TILE_SIZE,
+	  (int)floor(sr.bottom() / TILE_SIZE));
+
+	for (int i = left; i <= right; i++) {
+		for (int j = top; j <= bottom; j++) {
+			QPoint t(i, j);
+			QPixmap pm(tile(z, t));
+			if (pm.isNull())
+				continue;
+
+			painter->drawPixmap(QPointF(t * TILE_SIZE * f) / _ratio, pm);
 		}
-	} else
-		painter->drawImage(rect.topLeft(), _img, sr);
+	}
 }
 
 void Image::setDevicePixelRatio(qreal ratio)
 {
-	_img.setDevicePixelRatio(ratio);
+	_ratio = ratio;
 }
@@ -2,21 +2,33 @@
 #define IMAGE_H
 
 #include <QImage>
+#include <QVector>
+#include "tilecache.h"
 #include "map.h"
 
 class QPainter;
 
+/* Tiled image with a lazily generated, downsampled pyramid. The pyramid
+   levels are used when the image is drawn downscaled (digital zoom out) so
+   that the zoomed-out redraws do not smooth-scale the whole source image. */
 class Image
 {
 public:
-	Image(const QString &fileName) : _img(fileName) {}
-	Image(const QImage &img) : _img(img) {}
+	Image(const QString &fileName) : _ratio(1.0)
+	  {_levels.append(QImage(fileName));}
+	Image(const QImage &img) : _ratio(1.0) {_levels.append(img);}
 
 	void draw(QPainter *painter, const QRectF &rect, Map::Flags flags);
 	void setDevicePixelRatio(qreal ratio);
 
 private:
-	QImage _img;
+	int zoom(qreal scale) const;
+	const QImage &level(int zoom);
+	QPixmap tile(int zoom, const QPoint &xy);
+
+	QVector<QImage> _levels;
+	qreal _ratio;
+	TileCache _tileCache;
 };
 
 #endif // IMAGE_H
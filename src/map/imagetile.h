@@ -0,0 +1,44 @@
+#ifndef IMAGETILE_H
+#define IMAGETILE_H
+
+#include <QPixmap>
+#include <QPointF>
+
+class TileDecoder
+{
+public:
+	virtual ~TileDecoder() {}
+
+	/* Called from the tile loading threads */
+	virtual QImage decode(int zoom, const QByteArray &data) const = 0;
+};
+
+/* Raster map tile. The tile data is read sequentially in the GUI thread, the
+   decoding runs in the tile loading threads. */
+class ImageTile
+{
+public:
+	ImageTile(const TileDecoder *decoder, int zoom, const QPointF &xy,
+	  const QByteArray &data, quint64 key) : _decoder(decoder), _zoom(zoom),
+	  _xy(xy), _data(data), _key(key) {}
+
+	const QPointF &xy() const {return _xy;}
+	quint64 key() const {return _key;}
+	const QPixmap &pixmap() const {return _pixmap;}
+
+	void load()
+	{
+		if (!_data.isNull())
+			_pixmap = QPixmap::fromImage(_decoder->decode(_zoom, _data));
+	}
+
+private:
+	const TileDecoder *_decoder;
+	int _zoom;
+	QPointF _xy;
+	QByteArray _data;
+	quint64 _key;
+	QPixmap _pixmap;
+};
+
+#endif // IMAGETILE_H
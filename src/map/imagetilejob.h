@@ -0,0 +1,42 @@
+#ifndef IMAGETILEJOB_H
+#define IMAGETILEJOB_H
+
+#include "common/threadpools.h"
+#include "imagetile.h"
+
+class ImageTileJob : public QObject
+{
+	Q_OBJECT
+
+public:
+	ImageTileJob(const QList<ImageTile> &tiles) : _tiles(tiles) {}
+
+	void run()
+	{
+		connect(&_watcher, &QFutureWatcher<void>::finished, this,
+		  &ImageTileJob::handleFinished);
+		_future = ThreadPools::map(ThreadPools::Render,
+		  _tiles, &ImageTile::load);
+		_watcher.setFuture(_future);
+	}
+	void cancel(bool wait)
+	{
+		_future.cancel();
+		if (wait)
+			_future.waitForFinished();
+	}
+	const QList<ImageTile> &tiles() const {return _tiles;}
+
+signals:
+	void finished(ImageTileJob *job);
+
+private slots:
+	void handleFinished() {emit finished(this);}
+
+private:
+	QFutureWatcher<void> _watcher;
+	QFuture<void> _future;
+	QList<ImageTile> _tiles;
+};
+
+#endif // IMAGETILEJOB_H
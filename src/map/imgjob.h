@@ -1,7 +1,8 @@
 #ifndef IMGJOB_H
 #define IMGJOB_H
 
-#include <QtConcurrent>
+#include "common/threadpools.h"
+#include "common/trace.h"
 #include "IMG/rastertile.h"
 
 class IMGJob : public QObject
@@ -10,17 +11,26 @@ class IMGJob : public QObject
 
 public:
 	IMGJob(const QList<IMG::RasterTile> &tiles)
-	  : _tiles(tiles) {}
+	  : _tiles(tiles)
+	{
+		for (int i = 0; i < _tiles.size(); i++)
+			_tiles[i].setCancelFlag(&_cancel);
+	}
 
 	void run()
 	{
+		_trace.start();
 		connect(&_watcher, &QFutureWatcher<void>::finished, this,
 		  &IMGJob::handleFinished);
-		_future = QtConcurrent::map(_tiles, &IMG::RasterTile::render);
+		_future = ThreadPools::map(ThreadPools::Render,
+		  _tiles, &IMG::RasterTile::render);
 		_watcher.setFuture(_future);
 	}
 	void cancel(bool wait)
 	{
+		/* Stops also the already running tiles at their next fetch/draw
+		   phase boundary */
+		_cancel.storeRelease(1);
 		_future.cancel();
 		if (wait)
 			_future.waitForFinished();
@@ -31,12 +41,18 @@ signals:
 	void finished(IMGJob *job);
 
 private slots:
-	void handleFinished() {emit finished(this);}
+	void handleFinished()
+	{
+		_trace.end("job", "IMGJob");
+		emit finished(this);
+	}
 
 private:
 	QFutureWatcher<void> _watcher;
 	QFuture<void> _future;
+	Trace::Span _trace;
 	QList<IMG::RasterTile> _tiles;
+	QAtomicInt _cancel;
 };
 
 #endif // IMGJOB_H
@@ -1,6 +1,6 @@
+#include <cmath>
 #include <QFile>
 #include <QPainter>
-#include <QPixmapCache>
 #include "common/wgs84.h"
 #include "common/programpaths.h"
 #include "IMG/imgdata.h"
@@ -9,6 +9,7 @@
 #include "osm.h"
 #include "pcs.h"
 #include "rectd.h"
+#include "tileorder.h"
 #include "imgjob.h"
 #include "imgmap.h"
 
@@ -17,6 +18,7 @@ using namespace IMG;
 #define EPSILON    1e-6
 #define TILE_SIZE  384
 #define DELTA      1e-3
+#define DEM_CELL   0.1
 
 static RectC limitBounds(const RectC &bounds, const Projection &proj)
 {
@@ -57,8 +59,13 @@ QList<MapData*> IMGMap::overlays(const QString &fileName)
 }
 
 IMGMap::IMGMap(const QString &fileName, bool GMAP, QObject *parent)
-  : Map(fileName, parent), _projection(PCS::pcs(3857)), _tileRatio(1.0),
-  _layer(All), _valid(false)
+  : Map(fileName, parent),
+  _polyCache("IMG polygons", CacheRegistry::KB, &_lock),
+  _pointCache("IMG points", CacheRegistry::KB, &_lock),
+  _demCache("IMG elevations", CacheRegistry::Items, &_demLock),
+  _demCells("IMG elevation cells", CacheRegistry::Items, &_demCellLock, 64),
+  _projection(PCS::pcs(3857)), _tileRatio(1.0), _layer(All), _prefetch(0),
+  _valid(false)
 {
 	if (GMAP)
 		_data.append(new GMAPData(fileName, _polyCache, _pointCache, _demCache,
@@ -128,20 +135,32 @@ void IMGMap::load(const Projection &in, const Projection &out,
 
 	updateTransform();
 
-	QPixmapCache::clear();
+	_tileCache.setVariant(TileCache::variant(style, layer));
 }
 
 void IMGMap::unload()
 {
 	cancelJobs(true);
+	_tileCache.clear();
 
 	for (int i = 0; i < _data.size(); i++)
 		_data.at(i)->clear();
+	_demCellLock.lock();
+	_demCells.clear();
+	_demCellLock.unlock();
 
 	qDeleteAll(_styles);
 	_styles = QList<IMG::Style*>();
 }
 
+void IMGMap::restyle(const Projection &in, const Projection &out,
+  qreal deviceRatio, bool hidpi, int style, int layer)
+{
+	/* Keep the tiles of the current style for a quick switch back */
+	_tileCache.keep();
+	Map::restyle(in, out, deviceRatio, hidpi, style, layer);
+}
+
 int IMGMap::zoomFit(const QSize &size, const RectC &rect)
 {
 	const Range &zooms = _data.first()->zooms();
@@ -211,20 +230,12 @@ void IMGMap::updateTransform()
 		_bounds.adjust(0.5, 0, -0.5, 0);
 }
 
-bool IMGMap::isRunning(const QString &key) const
-{
-	for (int i = 0; i < _jobs.size(); i++) {
-		const QList<IMG::RasterTile> &tiles = _jobs.at(i)->tiles();
-		for (int j = 0; j < tiles.size(); j++)
-			if (tiles.at(j).key() == key)
-				return true;
-	}
-
-	return false;
-}
-
 void IMGMap::runJob(IMGJob *job)
 {
+	const QList<IMG::RasterTile> &tiles = job->tiles();
+	for (int i = 0; i < tiles.size(); i++)
+		_running.insert(tiles.at(i).key());
+
 	_jobs.append(job);
 
 	connect(job, &IMGJob::finished, this, &IMGMap::jobFinished);
@@ -233,7 +244,13 @@ void IMGMap::runJob(IMGJob *job)
 
 void IMGMap::removeJob(IMGJob *job)
 {
+	const QList<IMG::RasterTile> &tiles = job->tiles();
+	for (int i = 0; i < tiles.size(); i++)
+		_running.remove(tiles.at(i).key());
+
 	_jobs.removeOne(job);
+	if (job == _prefetch)
+		_prefetch = 0;
 	job->deleteLater();
 }
 
@@ -244,7 +261,7 @@ void IMGMap::jobFinished(IMGJob *job)
 	for (int i = 0; i < tiles.size(); i++) {
 		const IMG::RasterTile &mt = tiles.at(i);
 		if (!mt.pixmap().isNull())
-			QPixmapCache::insert(mt.key(), mt.pixmap());
+			_tileCache.insert(mt.key(), mt.pixmap(), mt.isDraft());
 	}
 
 	removeJob(job);
@@ -258,8 +275,14 @@ void IMGMap::cancelJobs(bool wait)
 		_jobs.at(i)->cancel(wait);
 }
 
-void IMGMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
+/* Draws the cached tiles (if painter is set) and returns the missing ones.
+   The missing tiles are drawn using the cached tiles of the other zooms
+   until they are rendered (except when blocking). */
+QList<RasterTile> IMGMap::tiles(QPainter *painter, int zoom,
+  const Transform &transform, const QRectF &rect, Flags flags)
 {
+	bool fallback = painter && !(flags & Map::Block);
+	const Range &zooms = _data.first()->zooms();
 	QPoint tl(qFloor(rect.left() / TILE_SIZE)
 	  * TILE_SIZE, qFloor(rect.top() / TILE_SIZE) * TILE_SIZE);
 	QSizeF s(rect.right() - tl.x(), rect.bottom() - tl.y());
@@ -272,60 +295,167 @@ void IMGMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		for (int i = 0; i < width; i++) {
 			for (int j = 0; j < height; j++) {
 				QPoint ttl(tl.x() + i * TILE_SIZE, tl.y() + j * TILE_SIZE);
-				QString key(_data.at(n)->fileName()
-				  + "-" + QString::number(_zoom)
-				  + "_" + QString::number(ttl.x())
-				  + "_" + QString::number(ttl.y()));
-
-				if (isRunning(key))
+				QRect tr(ttl, QSize(TILE_SIZE, TILE_SIZE));
+				/* The overlay index takes the place of the overzoom */
+				quint64 key = TileCache::key(zoom, ttl / TILE_SIZE, n);
+
+				if (isRunning(key)) {
+					if (fallback)
+						_tileCache.drawFallback(painter, zoom, ttl / TILE_SIZE,
+						  tr, zooms, n);
 					continue;
+				}
 
 				QPixmap pm;
-				if (QPixmapCache::find(key, &pm))
-					painter->drawPixmap(ttl, pm);
-				else {
-					tiles.append(RasterTile(_projection, _transform, _data.at(n),
-					  _styles.at(n), _zoom, QRect(ttl, QSize(TILE_SIZE, TILE_SIZE)),
-					  _tileRatio, key, !n && flags & Map::HillShading
-					  && _zoom >= 17 && _zoom <= 24, _layer & Raster,
-					  _layer & Vector));
+				if (_tileCache.find(key, &pm)) {
+					if (painter)
+						painter->drawPixmap(ttl, pm);
+				} else {
+					if (fallback)
+						_tileCache.drawFallback(painter, zoom, ttl / TILE_SIZE,
+						  tr, zooms, n);
+
+					/* Only the hill shading makes a difference in the draft
+					   mode, the drafts are refined once the interaction ends */
+					bool hs = !n && flags & Map::HillShading && zoom >= 17
+					  && zoom <= 24;
+					bool draft = hs && flags & Map::Draft;
+					if (draft && _tileCache.isDraft(key))
+						continue;
+
+					RasterTile tile(_projection, transform, _data.at(n),
+					  _styles.at(n), zoom, tr, _tileRatio, key, hs && !draft,
+					  _layer & Raster, _layer & Vector);
+					tile.setDraft(draft);
+					tiles.append(tile);
 				}
 			}
 		}
 	}
 
+	std::sort(tiles.begin(), tiles.end(), TileOrder<RasterTile>(rect.center()
+	  - QPointF(TILE_SIZE / 2, TILE_SIZE / 2)));
+
+	return tiles;
+}
+
+void IMGMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
+{
+	if (_prefetch)
+		_prefetch->cancel(false);
+
+	QList<RasterTile> tiles(this->tiles(painter, _zoom, _transform, rect,
+	  flags));
+
 	if (!tiles.isEmpty()) {
 		if (flags & Map::Block) {
-			QFuture<void> future = QtConcurrent::map(tiles, &RasterTile::render);
+			QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+			  tiles, &RasterTile::render);
 			future.waitForFinished();
 
 			for (int i = 0; i < tiles.size(); i++) {
 				const RasterTile &mt = tiles.at(i);
 				const QPixmap &pm = mt.pixmap();
 				painter->drawPixmap(mt.xy(), pm);
-				QPixmapCache::insert(mt.key(), pm);
+				_tileCache.insert(mt.key(), pm);
 			}
 		} else
 			runJob(new IMGJob(tiles));
 	}
 }
 
-double IMGMap::elevation(const Coordinates &c)
+void IMGMap::prefetch(const QRectF &rect, Flags flags)
 {
-	MapData *d = _data.first();
+	/* Only when idle, i.e. all the visible tiles are rendered */
+	if (!_jobs.isEmpty())
+		return;
 
-	if (d->hasDEM()) {
+	QList<RasterTile> tiles;
+	for (int dz = 1; dz >= -1; dz -= 2) {
+		int z = _zoom + dz;
+		QRectF zr(zoomRect(rect, _bounds, dz));
+		if (_data.first()->zooms().contains(z) && !zr.isEmpty())
+			tiles.append(this->tiles(0, z, transform(z), zr, flags));
+	}
+
+	if (!tiles.isEmpty()) {
+		_prefetch = new IMGJob(tiles);
+		runJob(_prefetch);
+	}
+}
+
+/* The DEM is queried in DEM_CELL sized grid cells, the cells (the DEM tiles
+   including the neighbouring tiles required for the edges interpolation and
+   their search tree) are cached */
+IMGMap::DEMCellPtr IMGMap::demCell(const Coordinates &c)
+{
+	int x = (int)floor(c.lon() / DEM_CELL);
+	int y = (int)floor(c.lat() / DEM_CELL);
+	quint64 key = ((quint64)(quint32)x << 32) | (quint32)y;
+
+	_demCellLock.lock();
+	DEMCellPtr *cached = _demCells.object(key);
+	DEMCellPtr cell(cached ? *cached : DEMCellPtr());
+	_demCellLock.unlock();
+
+	if (!cell) {
+		MapData *d = _data.first();
 		QList<MapData::Elevation> tiles;
+		RectC rect(Coordinates(x * DEM_CELL - DELTA,
+		  (y + 1) * DEM_CELL + DELTA), Coordinates((x + 1) * DEM_CELL + DELTA,
+		  y * DEM_CELL - DELTA));
 
-		d->elevations(0, RectC(c, Coordinates(c.lon() + DELTA, c.lat() - DELTA)),
-		  d->zooms().max(), &tiles);
-		DEMTree tree(tiles);
+		d->elevations(0, rect, d->zooms().max(), &tiles);
+		cell = DEMCellPtr(new DEMCell(tiles));
 
-		return tree.elevation(c);
-	} else
+		_demCellLock.lock();
+		_demCells.insert(key, new DEMCellPtr(cell));
+		_demCellLock.unlock();
+	}
+
+	return cell;
+}
+
+double IMGMap::elevation(const Coordinates &c)
+{
+	if (_data.first()->hasDEM())
+		return c.isValid() ? demCell(c)->elevation(c) : NAN;
+	else
 		return Map::elevation(c);
 }
 
+MatrixD IMGMap::elevation(const MatrixC &m)
+{
+	if (!_data.first()->hasDEM())
+		return Map::elevation(m);
+
+	MatrixD ret(m.h(), m.w());
+	DEMCellPtr cell;
+	int cx = 0, cy = 0;
+
+	/* Consecutive points (tracks, hillshading grids) mostly lie in the same
+	   cell */
+	for (int i = 0; i < m.size(); i++) {
+		const Coordinates &c = m.at(i);
+		if (!c.isValid()) {
+			ret.at(i) = NAN;
+			continue;
+		}
+
+		int x = (int)floor(c.lon() / DEM_CELL);
+		int y = (int)floor(c.lat() / DEM_CELL);
+
+		if (!cell || x != cx || y != cy) {
+			cell = demCell(c);
+			cx = x;
+			cy = y;
+		}
+		ret.at(i) = cell->elevation(c);
+	}
+
+	return ret;
+}
+
 QStringList IMGMap::styles(int &defaultStyle) const
 {
 	QStringList list;
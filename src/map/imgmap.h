@@ -1,10 +1,13 @@
 #ifndef IMGMAP_H
 #define IMGMAP_H
 
+#include <QSet>
 #include "map.h"
 #include "projection.h"
 #include "transform.h"
 #include "IMG/mapdata.h"
+#include "IMG/demtree.h"
+#include "tilecache.h"
 
 class IMGJob;
 namespace IMG {class Style;}
@@ -34,12 +37,16 @@ public:
 	  {return _projection.xy2ll(_transform.img2proj(p));}
 
 	void draw(QPainter *painter, const QRectF &rect, Flags flags);
+	void prefetch(const QRectF &rect, Flags flags);
 
 	void load(const Projection &in, const Projection &out, qreal devicelRatio,
 	  bool hidpi, int style, int layer);
 	void unload();
+	void restyle(const Projection &in, const Projection &out,
+	  qreal deviceRatio, bool hidpi, int style, int layer);
 
 	double elevation(const Coordinates &c);
+	MatrixD elevation(const MatrixC &m);
 
 	QStringList styles(int &defaultStyle) const;
 	QStringList layers(const QString &lang, int &defaultLayer) const;
@@ -69,16 +76,39 @@ private:
 		StyleList();
 	};
 
+	/* The DEM tiles of a grid cell with their search tree, so that the
+	   elevation point queries do not build a new tree for every point */
+	class DEMCell
+	{
+	public:
+		DEMCell(const QList<IMG::MapData::Elevation> &tiles)
+		  : _tiles(tiles), _tree(_tiles) {}
+
+		double elevation(const Coordinates &c) const
+		  {return _tree.elevation(c);}
+
+	private:
+		const QList<IMG::MapData::Elevation> _tiles;
+		IMG::DEMTree _tree;
+	};
+
+	typedef QSharedPointer<DEMCell> DEMCellPtr;
+	typedef StatsCache<quint64, DEMCellPtr> DEMCellCache;
+
 	Transform transform(int zoom) const;
 	void updateTransform();
-	bool isRunning(const QString &key) const;
+	bool isRunning(quint64 key) const {return _running.contains(key);}
 	void runJob(IMGJob *job);
 	void removeJob(IMGJob *job);
 	void cancelJobs(bool wait);
+	QList<IMG::RasterTile> tiles(QPainter *painter, int zoom,
+	  const Transform &transform, const QRectF &rect, Flags flags);
 
 	QList<IMG::MapData*> overlays(const QString &fileName);
 	IMG::Style *createStyle(IMG::MapData *data, const QString *typFile);
 
+	DEMCellPtr demCell(const Coordinates &c);
+
 	static StyleList &styles();
 
 	QList<IMG::MapData*> _data;
@@ -86,7 +116,8 @@ private:
 	IMG::MapData::PolyCache _polyCache;
 	IMG::MapData::PointCache _pointCache;
 	IMG::MapData::ElevationCache _demCache;
-	QMutex _lock, _demLock;
+	DEMCellCache _demCells;
+	QMutex _lock, _demLock, _demCellLock;
 	int _zoom;
 	Projection _projection;
 	Transform _transform;
@@ -95,7 +126,10 @@ private:
 	qreal _tileRatio;
 	Layer _layer;
 
+	TileCache _tileCache;
 	QList<IMGJob*> _jobs;
+	QSet<quint64> _running;
+	IMGJob *_prefetch;
 
 	bool _valid;
 	QString _errorString;
@@ -1,8 +1,8 @@
 #include <QtEndian>
 #include <QPainter>
 #include <QFileInfo>
-#include <QPixmapCache>
 #include "rectd.h"
+#include "tileorder.h"
 #include "jnxmap.h"
 
 
@@ -116,6 +116,8 @@ bool JNXMap::readTiles()
 			max[1] = trect.bottom();
 			z->tree.Insert(min, max, &tile);
 		}
+
+		z->tree.Pack();
 	}
 
 	return true;
@@ -151,6 +153,7 @@ JNXMap::JNXMap(const QString &fileName, QObject *parent)
 
 JNXMap::~JNXMap()
 {
+	cancelJobs(true);
 	qDeleteAll(_zooms);
 }
 
@@ -173,6 +176,9 @@ void JNXMap::load(const Projection &in, const Projection &out,
 
 void JNXMap::unload()
 {
+	cancelJobs(true);
+	_tileCache.clear();
+
 	_file.close();
 	clearTiles();
 }
@@ -216,56 +222,71 @@ int JNXMap::zoomFit(const QSize &size, const RectC &rect)
 
 int JNXMap::zoomIn()
 {
+	cancelJobs(false);
+
 	_zoom = qMin(_zoom + 1, _zooms.size() - 1);
 	return _zoom;
 }
 
 int JNXMap::zoomOut()
 {
+	cancelJobs(false);
+
 	_zoom = qMax(_zoom - 1, 0);
 	return _zoom;
 }
 
-QPixmap JNXMap::pixmap(const Tile *tile, QFile *file)
+QByteArray JNXMap::tileData(const Tile *tile)
 {
-	QPixmap pm;
+	/* The JPEG SOI marker is omitted in the JNX tiles */
+	QByteArray ba;
+	ba.resize(tile->size + 2);
+	ba[0] = (char)0xFF;
+	ba[1] = (char)0xD8;
+	char *data = ba.data() + 2;
+
+	if (!_file.seek(tile->offset))
+		return QByteArray();
+	if (!_file.read(data, tile->size))
+		return QByteArray();
+
+	return ba;
+}
 
-	QString key = file->fileName() + "-" + QString::number(tile->offset);
-	if (!QPixmapCache::find(key, &pm)) {
-		QByteArray ba;
-		ba.resize(tile->size + 2);
-		ba[0] = (char)0xFF;
-		ba[1] = (char)0xD8;
-		char *data = ba.data() + 2;
-
-		if (!file->seek(tile->offset))
-			return QPixmap();
-		if (!file->read(data, tile->size))
-			return QPixmap();
-		pm = QPixmap::fromImage(QImage::fromData(ba));
-
-		if (!pm.isNull())
-			QPixmapCache::insert(key, pm);
-	}
+QImage JNXMap::decode(int zoom, const QByteArray &data) const
+{
+	Q_UNUSED(zoom);
 
-	return pm;
+	return QImage::fromData(data);
 }
 
 bool JNXMap::cb(Tile *tile, void *context)
 {
 	Ctx *ctx = static_cast<Ctx*>(context);
-	QPixmap pm(pixmap(tile, ctx->file));
-	pm.setDevicePixelRatio(ctx->ratio);
-	ctx->painter->drawPixmap(tile->pos / ctx->ratio, pm);
+	JNXMap *map = ctx->map;
+	const Zoom *z = map->_zooms.at(map->_zoom);
+	QPointF tp(tile->pos / map->_mapRatio);
+	quint64 key = TileCache::key(map->_zoom,
+	  QPoint(0, tile - z->tiles.constData()));
+	QPixmap pm;
+
+	if (map->isRunning(key))
+		return true;
+
+	if (map->_tileCache.find(key, &pm, map->_mapRatio)) {
+		pm.setDevicePixelRatio(map->_mapRatio);
+		ctx->painter->drawPixmap(tp, pm);
+	} else
+		ctx->tiles.append(ImageTile(map, map->_zoom, tp, map->tileData(tile),
+		  key));
 
 	return true;
 }
 
 void JNXMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 {
-	Q_UNUSED(flags);
-	const RTree<Tile*, qreal, 2> &tree = _zooms.at(_zoom)->tree;
-	Ctx ctx(painter, &_file, _mapRatio);
+	const PackedRTree<Tile*, qreal, 2> &tree = _zooms.at(_zoom)->tree;
+	Ctx ctx(painter, this);
 	QRectF rr(rect.topLeft() * _mapRatio, rect.size() * _mapRatio);
 
 	qreal min[2], max[2];
@@ -274,6 +295,90 @@ void JNXMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 	max[0] = rr.right();
 	max[1] = rr.bottom();
 	tree.Search(min, max, cb, &ctx);
+
+	QList<ImageTile> &tiles = ctx.tiles;
+	if (tiles.isEmpty())
+		return;
+	if (!(flags & Map::Block)) {
+		std::sort(tiles.begin(), tiles.end(),
+		  TileOrder<ImageTile>(rect.center()));
+		runJob(new ImageTileJob(tiles));
+		return;
+	}
+
+	QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+	  tiles, &ImageTile::load);
+	future.waitForFinished();
+
+	for (int i = 0; i < tiles.size(); i++) {
+		const ImageTile &mt = tiles.at(i);
+		QPixmap pm(mt.pixmap());
+		if (pm.isNull()) {
+			qWarning("%s: error loading tile image", qUtf8Printable(path()));
+			continue;
+		}
+
+		_tileCache.insert(mt.key(), pm);
+		pm.setDevicePixelRatio(_mapRatio);
+		painter->drawPixmap(mt.xy(), pm);
+	}
+}
+
+bool JNXMap::isRunning(quint64 key) const
+{
+	for (int i = 0; i < _jobs.size(); i++) {
+		const QList<ImageTile> &tiles = _jobs.at(i)->tiles();
+		for (int j = 0; j < tiles.size(); j++)
+			if (tiles.at(j).key() == key)
+				return true;
+	}
+
+	return false;
+}
+
+void JNXMap::runJob(ImageTileJob *job)
+{
+	_jobs.append(job);
+
+	connect(job, &ImageTileJob::finished, this, &JNXMap::jobFinished);
+	job->run();
+}
+
+void JNXMap::removeJob(ImageTileJob *job)
+{
+	_jobs.removeOne(job);
+	job->deleteLater();
+}
+
+void JNXMap::jobFinished(ImageTileJob *job)
+{
+	const QList<ImageTile> &tiles = job->tiles();
+
+	for (int i = 0; i < tiles.size(); i++) {
+		const ImageTile &mt = tiles.at(i);
+		if (!mt.pixmap().isNull())
+			_tileCache.insert(mt.key(), mt.pixmap());
+	}
+
+	removeJob(job);
+
+	emit tilesLoaded();
+}
+
+void JNXMap::cancelJobs(bool wait)
+{
+	for (int i = 0; i < _jobs.size(); i++)
+		_jobs.at(i)->cancel(wait);
+
+	/* Waiting cancels (unload) drop the jobs including the results of the
+	   jobs that finished but whose finished signal is still queued */
+	if (wait) {
+		while (!_jobs.isEmpty()) {
+			ImageTileJob *job = _jobs.first();
+			job->disconnect(this);
+			removeJob(job);
+		}
+	}
 }
 
 Map *JNXMap::create(const QString &path, const Projection &proj, bool *isDir)
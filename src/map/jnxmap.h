@@ -3,13 +3,15 @@
 
 #include <QFile>
 #include <QVector>
-#include "common/rtree.h"
+#include "common/packedrtree.h"
 #include "common/rectc.h"
 #include "transform.h"
 #include "projection.h"
+#include "tilecache.h"
+#include "imagetilejob.h"
 #include "map.h"
 
-class JNXMap : public Map
+class JNXMap : public Map, public TileDecoder
 {
 public:
 	Q_OBJECT
@@ -41,6 +43,11 @@ public:
 
 	static Map *create(const QString &path, const Projection &proj, bool *isDir);
 
+	QImage decode(int zoom, const QByteArray &data) const;
+
+private slots:
+	void jobFinished(ImageTileJob *job);
+
 private:
 	struct Tile {
 		qint32 top, right, bottom, left;
@@ -64,16 +71,15 @@ private:
 		Level level;
 		Transform transform;
 		QVector<Tile> tiles;
-		RTree<Tile*, qreal, 2> tree;
+		PackedRTree<Tile*, qreal, 2> tree;
 	};
 
 	struct Ctx {
 		QPainter *painter;
-		QFile *file;
-		qreal ratio;
+		JNXMap *map;
+		QList<ImageTile> tiles;
 
-		Ctx(QPainter *painter, QFile *file, qreal ratio)
-		  : painter(painter), file(file), ratio(ratio) {}
+		Ctx(QPainter *painter, JNXMap *map) : painter(painter), map(map) {}
 	};
 
 
@@ -83,8 +89,13 @@ private:
 	bool readTiles();
 	void clearTiles();
 
+	QByteArray tileData(const Tile *tile);
+	bool isRunning(quint64 key) const;
+	void runJob(ImageTileJob *job);
+	void removeJob(ImageTileJob *job);
+	void cancelJobs(bool wait);
+
 	static bool cb(Tile *tile, void *context);
-	static QPixmap pixmap(const Tile *tile, QFile *file);
 
 	QFile _file;
 	QList<Zoom*> _zooms;
@@ -92,6 +103,8 @@ private:
 	RectC _bounds;
 	Projection _projection;
 	qreal _mapRatio;
+	TileCache _tileCache;
+	QList<ImageTileJob*> _jobs;
 
 	bool _valid;
 	QString _errorString;
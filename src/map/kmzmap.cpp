@@ -1,27 +1,15 @@
-/*
-	WARNING: This code uses internal Qt API - the QZipReader class for reading
-	ZIP files - and things may break if Qt changes the API. For Qt5 this is not
-	a problem as we can "see the future" now and there are no changes in all
-	the supported Qt5 versions up to the last one (5.15). In Qt6 the class
-	might change or even disappear in the future, but this is very unlikely
-	as there were no changes for several years and The Qt Company's policy
-	is: "do not invest any resources into any desktop related stuff unless
-	absolutely necessary". There is an issue (QTBUG-3897) since the year 2009 to
-	include the ZIP reader into the public API, which aptly illustrates the
-	effort The Qt Company is willing to make about anything desktop related...
-*/
-
 #include <QFileInfo>
 #include <QXmlStreamReader>
 #include <QBuffer>
 #include <QImageReader>
 #include <QPainter>
 #include <QPixmapCache>
-#include <private/qzipreader_p.h>
+#include "common/ziparchive.h"
 #include "kmzmap.h"
 
 
 #define ZOOM_THRESHOLD 0.9
+#define HEADER_SIZE    65536
 
 #define TL(m) ((m).bbox().topLeft())
 #define BR(m) ((m).bbox().bottomRight())
@@ -42,13 +30,24 @@ bool KMZMap::yCmp(const Tile &m1, const Tile &m2)
 }
 
 
-KMZMap::Tile::Tile(const Overlay &overlay, QZipReader &zip)
+KMZMap::Tile::Tile(const Overlay &overlay, ZipArchive &zip)
   : _overlay(overlay)
 {
-	QByteArray ba(zip.fileData(overlay.path()));
+	/* Only the beginning of the image is inflated for the image size, the
+	   whole image is used when the header is not found there. */
+	QByteArray ba(zip.fileData(overlay.path(), HEADER_SIZE));
 	QBuffer img(&ba);
 	QImageReader ir(&img);
 	_size = ir.size();
+
+	if (!_size.isValid()) {
+		QByteArray data(zip.fileData(overlay.path()));
+		if (data.size() > ba.size()) {
+			QBuffer full(&data);
+			QImageReader fr(&full);
+			_size = fr.size();
+		}
+	}
 }
 
 void KMZMap::Tile::configure(const Projection &proj)
@@ -85,7 +84,7 @@ qreal KMZMap::Tile::resolution() const
 	return ds/ps;
 }
 
-bool KMZMap::createTiles(const QList<Overlay> &overlays, QZipReader &zip)
+bool KMZMap::createTiles(const QList<Overlay> &overlays, ZipArchive &zip)
 {
 	if (overlays.isEmpty()) {
 		_errorString = "No usable overlay found";
@@ -277,8 +276,13 @@ KMZMap::KMZMap(const QString &fileName, QObject *parent)
   : Map(fileName, parent), _zoom(0), _mapIndex(-1), _zip(0), _mapRatio(1.0),
   _valid(false)
 {
-	QZipReader zip(fileName, QIODevice::ReadOnly);
-	QByteArray xml(zip.fileData("doc.kml"));
+	_zip = new ZipArchive(fileName);
+	if (!_zip->open()) {
+		_errorString = _zip->errorString();
+		return;
+	}
+
+	QByteArray xml(_zip->fileData("doc.kml"));
 	QXmlStreamReader reader(xml);
 	QList<Overlay> overlays;
 
@@ -294,7 +298,9 @@ KMZMap::KMZMap(const QString &fileName, QObject *parent)
 		return;
 	}
 
-	if (!createTiles(overlays, zip))
+	bool ret = createTiles(overlays, *_zip);
+	_zip->close();
+	if (!ret)
 		return;
 	computeLLBounds();
 	computeZooms();
@@ -441,16 +447,17 @@ void KMZMap::load(const Projection &in, const Projection &out,
 
 	computeBounds();
 
-	Q_ASSERT(!_zip);
-	_zip = new QZipReader(path(), QIODevice::ReadOnly);
+	Q_ASSERT(!_zip->isOpen());
+	if (!_zip->open())
+		qWarning("%s: %s", qUtf8Printable(path()),
+		  qUtf8Printable(_zip->errorString()));
 }
 
 void KMZMap::unload()
 {
 	_bounds = QVector<Bounds>();
 
-	delete _zip;
-	_zip = 0;
+	_zip->close();
 }
 
 void KMZMap::draw(QPainter *painter, const QRectF &rect, int mapIndex)
@@ -7,7 +7,7 @@
 #include "map.h"
 
 class QXmlStreamReader;
-class QZipReader;
+class ZipArchive;
 
 class KMZMap : public Map
 {
@@ -58,7 +58,7 @@ private:
 
 	class Tile {
 	public:
-		Tile(const Overlay &overlay, QZipReader &zip);
+		Tile(const Overlay &overlay, ZipArchive &zip);
 
 		bool operator==(const Tile &other) const
 		  {return _overlay.path() == other._overlay.path();}
@@ -105,7 +105,7 @@ private:
 
 	void draw(QPainter *painter, const QRectF &rect, int mapIndex);
 
-	bool createTiles(const QList<Overlay> &overlays, QZipReader &zip);
+	bool createTiles(const QList<Overlay> &overlays, ZipArchive &zip);
 	void computeZooms();
 	void computeBounds();
 	void computeLLBounds();
@@ -125,7 +125,7 @@ private:
 	QVector<Bounds> _bounds;
 	int _zoom;
 	int _mapIndex;
-	QZipReader *_zip;
+	ZipArchive *_zip;
 	qreal _adjust;
 	Projection _projection;
 	qreal _mapRatio;
@@ -0,0 +1,45 @@
+#ifndef LAZYLIST_H
+#define LAZYLIST_H
+
+#include <QString>
+#include <QMutex>
+#include <QAtomicInt>
+
+/* Deferred loading of the CRS database lists. The list file is parsed on
+   the first lookup that can not be satisfied by the built-in defaults (or
+   when the whole list is requested), so sessions using only WGS84/Web
+   Mercator never parse the databases. Until the list is loaded, the lookups
+   are serialized with the lock, the loaded list is read-only and the lookups
+   are lock-free. */
+class LazyList
+{
+public:
+	LazyList() : _loaded(0) {}
+
+	void setPath(const QString &path)
+	{
+		QMutexLocker locker(&_lock);
+		_path = path;
+		_loaded.storeRelease(0);
+	}
+
+	QMutex &lock() {return _lock;}
+	bool isLoaded() const {return _loaded.loadAcquire();}
+
+	/* Must be called with the lock held. Returns the path of the list to be
+	   loaded, a null string when there is nothing (more) to load. */
+	QString take()
+	{
+		QString path(_path);
+		_path = QString();
+		return path;
+	}
+	void setLoaded() {_loaded.storeRelease(1);}
+
+private:
+	QMutex _lock;
+	QAtomicInt _loaded;
+	QString _path;
+};
+
+#endif // LAZYLIST_H
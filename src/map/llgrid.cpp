@@ -0,0 +1,126 @@
+#include <QVector>
+#include "projection.h"
+#include "transform.h"
+#include "llgrid.h"
+
+#define STEP      16
+#define MAX_ERROR 0.1 /* pixels */
+
+static inline Coordinates xy2ll(const Projection &proj,
+  const Transform &transform, int x, int y)
+{
+	return proj.xy2ll(transform.img2proj(QPointF(x, y)));
+}
+
+static inline Coordinates interpolate(const Coordinates &c00,
+  const Coordinates &c01, const Coordinates &c10, const Coordinates &c11,
+  double u, double v)
+{
+	double w00 = (1.0 - u) * (1.0 - v);
+	double w01 = u * (1.0 - v);
+	double w10 = (1.0 - u) * v;
+	double w11 = u * v;
+
+	return Coordinates(w00 * c00.lon() + w01 * c01.lon() + w10 * c10.lon()
+	  + w11 * c11.lon(), w00 * c00.lat() + w01 * c01.lat() + w10 * c10.lat()
+	  + w11 * c11.lat());
+}
+
+static bool interpolable(const Projection &proj, const Transform &transform,
+  const QRect &rect, const Coordinates &c00, const Coordinates &c01,
+  const Coordinates &c10, const Coordinates &c11)
+{
+	if (!(c00.isValid() && c01.isValid() && c10.isValid() && c11.isValid()))
+		return false;
+
+	double minLon = qMin(qMin(c00.lon(), c01.lon()), qMin(c10.lon(), c11.lon()));
+	double maxLon = qMax(qMax(c00.lon(), c01.lon()), qMax(c10.lon(), c11.lon()));
+	double minLat = qMin(qMin(c00.lat(), c01.lat()), qMin(c10.lat(), c11.lat()));
+	double maxLat = qMax(qMax(c00.lat(), c01.lat()), qMax(c10.lat(), c11.lat()));
+	// Cells crossing the antimeridian
+	if (maxLon - minLon > 180.0)
+		return false;
+
+	int dx = rect.width() - 1;
+	int dy = rect.height() - 1;
+	if (dx < 2 && dy < 2)
+		return true;
+
+	double tolerance = MAX_ERROR * qMax(maxLon - minLon, maxLat - minLat)
+	  / qMax(dx, dy);
+	Coordinates ce(xy2ll(proj, transform, rect.left() + dx / 2,
+	  rect.top() + dy / 2));
+	if (!ce.isValid())
+		return false;
+	Coordinates ci(interpolate(c00, c01, c10, c11,
+	  dx ? (double)(dx / 2) / dx : 0, dy ? (double)(dy / 2) / dy : 0));
+
+	return (qAbs(ce.lon() - ci.lon()) <= tolerance
+	  && qAbs(ce.lat() - ci.lat()) <= tolerance);
+}
+
+static QVector<int> nodes(int size)
+{
+	QVector<int> v;
+
+	for (int i = 0; i < size - 1; i += STEP)
+		v.append(i);
+	v.append(size - 1);
+
+	return v;
+}
+
+MatrixC LLGrid::coordinates(const Projection &proj,
+  const Transform &transform, const QRect &rect)
+{
+	MatrixC ll(rect.height(), rect.width());
+	if (ll.isNull())
+		return ll;
+
+	if (rect.width() < 2 || rect.height() < 2) {
+		for (int y = 0; y < ll.h(); y++)
+			for (int x = 0; x < ll.w(); x++)
+				ll.at(y, x) = xy2ll(proj, transform, rect.left() + x,
+				  rect.top() + y);
+		return ll;
+	}
+
+	QVector<int> gx(nodes(rect.width()));
+	QVector<int> gy(nodes(rect.height()));
+	MatrixC grid(gy.size(), gx.size());
+
+	for (int i = 0; i < gy.size(); i++)
+		for (int j = 0; j < gx.size(); j++)
+			grid.at(i, j) = xy2ll(proj, transform, rect.left() + gx.at(j),
+			  rect.top() + gy.at(i));
+
+	for (int i = 0; i < gy.size() - 1; i++) {
+		int y0 = gy.at(i), y1 = gy.at(i + 1);
+
+		for (int j = 0; j < gx.size() - 1; j++) {
+			int x0 = gx.at(j), x1 = gx.at(j + 1);
+			const Coordinates &c00 = grid.at(i, j);
+			const Coordinates &c01 = grid.at(i, j + 1);
+			const Coordinates &c10 = grid.at(i + 1, j);
+			const Coordinates &c11 = grid.at(i + 1, j + 1);
+			QRect cell(rect.left() + x0, rect.top() + y0, x1 - x0 + 1,
+			  y1 - y0 + 1);
+
+			if (interpolable(proj, transform, cell, c00, c01, c10, c11)) {
+				for (int y = y0; y <= y1; y++) {
+					double v = (double)(y - y0) / (y1 - y0);
+					for (int x = x0; x <= x1; x++)
+						ll.at(y, x) = interpolate(c00, c01, c10, c11,
+						  (double)(x - x0) / (x1 - x0), v);
+				}
+			} else {
+				for (int y = y0; y <= y1; y++)
+					for (int x = x0; x <= x1; x++)
+						ll.at(y, x) = xy2ll(proj, transform, rect.left() + x,
+						  rect.top() + y);
+			}
+		}
+	}
+
+	return ll;
+}
@@ -0,0 +1,19 @@
+#ifndef LLGRID_H
+#define LLGRID_H
+
+#include <QRect>
+#include "matrix.h"
+
+class Projection;
+class Transform;
+
+namespace LLGrid
+{
+	/* Geographic coordinates of all the pixels of the image rect. The exact
+	   inverse projection is only computed on a coarse grid, the pixels in
+	   between are interpolated where the interpolation error is negligible. */
+	MatrixC coordinates(const Projection &proj, const Transform &transform,
+	  const QRect &rect);
+}
+
+#endif // LLGRID_H
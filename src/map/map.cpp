@@ -79,3 +79,9 @@ qreal Map::resolution(const QRectF &rect)
 
 	return ds/ps;
 }
+
+void Map::ll2xy(const Coordinates *c, QPointF *p, int n)
+{
+	for (int i = 0; i < n; i++)
+		p[i] = ll2xy(c[i]);
+}
@@ -6,12 +6,14 @@
 #include <QRectF>
 #include <QFlags>
 #include "common/rectc.h"
+#include "common/range.h"
 #include "common/util.h"
 #include "dem.h"
 
 
 class QPainter;
 class Projection;
+class TileSeeder;
 
 class Map : public QObject
 {
@@ -23,6 +25,9 @@ public:
 		Block = 1,
 		OpenGL = 2,
 		HillShading = 4,
+		/* The view is being panned/zoomed, the map may render cheaper
+		   draft tiles that get refined when drawn without the flag */
+		Draft = 8
 	};
 	Q_DECLARE_FLAGS(Flags, Flag)
 
@@ -40,6 +45,13 @@ public:
 	virtual void load(const Projection &, const Projection &, qreal, bool, int,
 	  int) {}
 	virtual void unload() {}
+	/* Reloads the map with another style/layer */
+	virtual void restyle(const Projection &in, const Projection &out,
+	  qreal deviceRatio, bool hidpi, int style, int layer)
+	{
+		unload();
+		load(in, out, deviceRatio, hidpi, style, layer);
+	}
 
 	/* llBounds() is mandatory for maps that do not provide bounds() until
 	   load() is called! */
@@ -55,10 +67,20 @@ public:
 
 	virtual QPointF ll2xy(const Coordinates &c) = 0;
 	virtual Coordinates xy2ll(const QPointF &p) = 0;
+	/* Batch conversion of n points */
+	virtual void ll2xy(const Coordinates *c, QPointF *p, int n);
 
 	virtual void draw(QPainter *painter, const QRectF &rect, Flags flags) = 0;
+	/* Renders the tiles of the neighbouring zooms around the (visible) rect
+	   in the background. Called when the view is idle, the maps cancel the
+	   prefetch on the next draw(). */
+	virtual void prefetch(const QRectF &rect, Flags flags)
+	  {Q_UNUSED(rect); Q_UNUSED(flags);}
 
 	virtual double elevation(const Coordinates &c) {return DEM::elevation(c);}
+	/* Batch version of elevation(), the DEM tiles are resolved once per
+	   run of points instead of once per point */
+	virtual MatrixD elevation(const MatrixC &m) {return DEM::elevation(m);}
 
 	virtual QStringList layers(const QString &, int &) const
 	  {return QStringList();}
@@ -67,10 +89,28 @@ public:
 
 	virtual void clearCache() {}
 
+	/* Offline tiles seeding, maps that do not support it return an invalid
+	   range/null seeder */
+	virtual Range seedZooms() const {return Range(0, -1);}
+	virtual TileSeeder *seeder(const QList<RectC> &, const Range &)
+	  {return 0;}
+
 signals:
 	void tilesLoaded();
 	void mapLoaded();
 
+protected:
+	/* The rect of the same size and with the same centre as rect in the zoom
+	   dz levels from the rect zoom, limited to the map bounds (the maps with
+	   2^zoom scales) */
+	static QRectF zoomRect(const QRectF &rect, const QRectF &bounds, int dz)
+	{
+		qreal f = (dz < 0) ? 1.0 / (1 << -dz) : (1 << dz);
+		QRectF r(QPointF(0, 0), rect.size());
+		r.moveCenter(rect.center() * f);
+		return r.intersected(QRectF(bounds.topLeft() * f, bounds.size() * f));
+	}
+
 private:
 	QString _path;
 };
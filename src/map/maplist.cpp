@@ -1,6 +1,11 @@
 #include <QFileInfo>
 #include <QDir>
 #include <QApplication>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QSet>
+#include "common/programpaths.h"
+#include "common/threadpools.h"
 #include "atlas.h"
 #include "ozimap.h"
 #include "jnxmap.h"
@@ -25,9 +30,13 @@
 #include "coros5map.h"
 #include "pmtilesmap.h"
 #include "invalidmap.h"
+#include "mapstub.h"
 #include "maplist.h"
 
 
+#define MAGIC   0x47504d4c
+#define VERSION 2
+
 MapList::ParserMap MapList::parsers()
 {
 	MapList::ParserMap map;
@@ -73,30 +82,44 @@ MapList::ParserMap MapList::parsers()
 
 MapList::ParserMap MapList::_parsers = MapList::parsers();
 
-Map *MapList::loadFile(const QString &path, const Projection &proj, bool *isDir)
+Map *MapList::loadFile(const QString &path, const Projection &proj, bool *isDir,
+  QString *format, int *parser)
 {
 	ParserMap::iterator it;
 	QFileInfo fi(Util::displayName(path));
 	QString suffix(fi.completeSuffix().toLower());
 	Map *map = 0;
 	QStringList errors;
+	int idx = 0;
 
 	if ((it = _parsers.find(suffix)) != _parsers.end()) {
 		while (it != _parsers.end() && it.key() == suffix) {
 			delete map;
 			map = it.value()(path, proj, isDir);
-			if (map->isValid())
+			if (map->isValid()) {
+				if (format)
+					*format = it.key();
+				if (parser)
+					*parser = idx;
 				return map;
-			else
+			} else
 				errors.append(it.key() + ": " + map->errorString());
 			++it;
+			idx++;
 		}
 	} else {
+		QString last;
 		for (it = _parsers.begin(); it != _parsers.end(); it++) {
+			idx = (it.key() == last) ? idx + 1 : 0;
+			last = it.key();
 			map = it.value()(path, proj, isDir);
-			if (map->isValid())
+			if (map->isValid()) {
+				if (format)
+					*format = it.key();
+				if (parser)
+					*parser = idx;
 				return map;
-			else {
+			} else {
 				errors.append(it.key() + ": " + map->errorString());
 				delete map;
 				map = 0;
@@ -111,8 +134,170 @@ Map *MapList::loadFile(const QString &path, const Projection &proj, bool *isDir)
 	return map ? map : new InvalidMap(path, "Unknown file format");
 }
 
+Map *MapList::loadFile(const QString &path, const Projection &proj,
+  const QString &format, int parser, bool isDir)
+{
+	ParserMap::iterator it(_parsers.find(format));
+	bool dir;
+
+	for (int i = 0; it != _parsers.end() && it.key() == format; i++, ++it) {
+		if (i == parser) {
+			Map *map = it.value()(path, proj, isDir ? &dir : 0);
+			if (map->isValid())
+				return map;
+			delete map;
+			break;
+		}
+	}
+
+	return loadFile(path, proj, isDir ? &dir : 0);
+}
+
+/* Online map sources and Garmin GMAP maps must be created in the GUI thread
+   and the SQLite based maps can not share the DB connection between threads,
+   so they are neither scanned in parallel nor stubbed. */
+bool MapList::parallel(const QString &suffix)
+{
+	return !(suffix == "xml" || suffix == "mbtiles" || suffix == "sqlite"
+	  || suffix == "sqlitedb");
+}
+
+bool MapList::upToDate(const Info &info, const QFileInfo &fi)
+{
+	return (info.size == fi.size()
+	  && info.time == fi.lastModified().toMSecsSinceEpoch());
+}
+
+/* Only the first not cached map of a directory is scanned right away, the
+   rest is deferred until it is known that the first one is not a directory map
+   (whose scan would just build the same directory map again). */
+void MapList::collect(const QString &path, const Projection &proj,
+  const InfoCache &cache, InfoCache &found, QList<Info> &todo,
+  QList<Info> &deferred)
+{
+	QDir md(path);
+	md.setFilter(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+	md.setSorting(QDir::DirsLast);
+	QFileInfoList ml = md.entryInfoList();
+	bool first = true;
+
+	for (int i = 0; i < ml.size(); i++) {
+		const QFileInfo &fi = ml.at(i);
+		QString suffix = fi.suffix().toLower();
+
+		if (fi.isDir())
+			collect(fi.absoluteFilePath(), proj, cache, found, todo,
+			  deferred);
+		else if (filter().contains("*." + suffix) && parallel(suffix)) {
+			InfoCache::const_iterator it(cache.find(fi.absoluteFilePath()));
+			if (it != cache.constEnd() && upToDate(*it, fi)) {
+				found.insert(it.key(), *it);
+				if (it->isDir)
+					break;
+			} else {
+				Info info;
+				info.path = fi.absoluteFilePath();
+				info.size = fi.size();
+				info.time = fi.lastModified().toMSecsSinceEpoch();
+				info.proj = &proj;
+				if (first)
+					todo.append(info);
+				else
+					deferred.append(info);
+				first = false;
+			}
+		}
+	}
+}
+
+void MapList::scan(Info &info)
+{
+	Map *map = loadFile(info.path, *info.proj, &info.isDir, &info.format,
+	  &info.parser);
+
+	info.valid = map->isValid();
+	/* Maps that are not ready after creation (e.g. waiting for some
+	   network data) have no meaningful metadata to cache */
+	if (info.valid && !map->isReady())
+		info.size = -1;
+	else {
+		info.name = map->name();
+		info.error = map->errorString();
+		info.bounds = map->llBounds();
+	}
+
+	delete map;
+}
+
+MapList::InfoCache MapList::loadCache()
+{
+	InfoCache cache;
+	QFile file(ProgramPaths::mapListCacheFile());
+	if (!file.open(QIODevice::ReadOnly))
+		return cache;
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic;
+	quint16 version;
+	stream >> magic >> version;
+	if (stream.status() != QDataStream::Ok || magic != MAGIC
+	  || version != VERSION)
+		return cache;
+
+	while (!stream.atEnd()) {
+		Info info;
+		double left, top, right, bottom;
+
+		stream >> info.path >> info.size >> info.time >> info.isDir
+		  >> info.valid >> info.format >> info.parser >> info.name
+		  >> info.error >> left >> top >> right >> bottom;
+		if (stream.status() != QDataStream::Ok) {
+			qWarning("%s: invalid map list cache",
+			  qUtf8Printable(file.fileName()));
+			return InfoCache();
+		}
+		info.bounds = RectC(Coordinates(left, top), Coordinates(right, bottom));
+
+		cache.insert(info.path, info);
+	}
+
+	return cache;
+}
+
+void MapList::saveCache(const InfoCache &cache)
+{
+	QFileInfo fi(ProgramPaths::mapListCacheFile());
+	if (!QDir().mkpath(fi.absolutePath()))
+		return;
+
+	QSaveFile file(fi.absoluteFilePath());
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+
+	stream << (quint32)MAGIC << (quint16)VERSION;
+	for (InfoCache::const_iterator it = cache.constBegin();
+	  it != cache.constEnd(); ++it) {
+		const Info &info = *it;
+		stream << info.path << info.size << info.time << info.isDir
+		  << info.valid << info.format << info.parser << info.name
+		  << info.error
+		  << info.bounds.topLeft().lon() << info.bounds.topLeft().lat()
+		  << info.bounds.bottomRight().lon()
+		  << info.bounds.bottomRight().lat();
+	}
+
+	if (stream.status() != QDataStream::Ok || !file.commit())
+		qWarning("%s: error writing map list cache",
+		  qUtf8Printable(file.fileName()));
+}
+
 TreeNode<Map*> MapList::loadDir(const QString &path, const Projection &proj,
-  TreeNode<Map*> *parent)
+  const InfoCache &cache, TreeNode<Map*> *parent)
 {
 	QDir md(path);
 	md.setFilter(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
@@ -129,12 +314,24 @@ TreeNode<Map*> MapList::loadDir(const QString &path, const Projection &proj,
 		QString suffix = fi.suffix().toLower();
 
 		if (fi.isDir()) {
-			TreeNode<Map*> child(loadDir(fi.absoluteFilePath(), proj, &tree));
+			TreeNode<Map*> child(loadDir(fi.absoluteFilePath(), proj, cache,
+			  &tree));
 			if (!child.isEmpty())
 				tree.addChild(child);
 		} else if (filter().contains("*." + suffix)) {
+			InfoCache::const_iterator it(cache.find(fi.absoluteFilePath()));
 			bool isDir = false;
-			Map *map = loadFile(fi.absoluteFilePath(), proj, &isDir);
+			Map *map;
+
+			if (parallel(suffix) && it != cache.constEnd()
+			  && upToDate(*it, fi)) {
+				isDir = it->isDir;
+				map = it->valid
+				  ? (Map*)new MapStub(it->path, it->size, it->time, it->name,
+				    it->bounds, it->format, it->parser, it->isDir, proj)
+				  : (Map*)new InvalidMap(it->path, it->error);
+			} else
+				map = loadFile(fi.absoluteFilePath(), proj, &isDir);
 			if (isDir) {
 				if (parent)
 					parent->addItem(map);
@@ -151,15 +348,85 @@ TreeNode<Map*> MapList::loadDir(const QString &path, const Projection &proj,
 
 TreeNode<Map *> MapList::loadMaps(const QString &path, const Projection &proj)
 {
-	if (QFileInfo(path).isDir())
-		return loadDir(path, proj);
-	else {
+	if (QFileInfo(path).isDir()) {
+		InfoCache cache(loadCache());
+		InfoCache found;
+		QList<Info> todo, deferred;
+
+		collect(path, proj, cache, found, todo, deferred);
+		ThreadPools::blockingMap(ThreadPools::Parse, todo, &MapList::scan);
+
+		QSet<QString> dirMaps;
+		for (int i = 0; i < todo.size(); i++)
+			if (todo.at(i).isDir)
+				dirMaps.insert(QFileInfo(todo.at(i).path).absolutePath());
+		QList<Info> rest;
+		for (int i = 0; i < deferred.size(); i++)
+			if (!dirMaps.contains(QFileInfo(deferred.at(i).path)
+			  .absolutePath()))
+				rest.append(deferred.at(i));
+		ThreadPools::blockingMap(ThreadPools::Parse, rest, &MapList::scan);
+		todo.append(rest);
+
+		/* Replace all the entries below the scanned directory with the
+		   current state so that entries of removed maps do not pile up */
+		QString prefix(QDir(path).absolutePath() + "/");
+		int hits = found.size(), removed = 0;
+		for (InfoCache::iterator it = cache.begin(); it != cache.end();) {
+			if (it.key().startsWith(prefix)) {
+				it = cache.erase(it);
+				removed++;
+			} else
+				++it;
+		}
+		for (int i = 0; i < todo.size(); i++)
+			if (todo.at(i).size >= 0)
+				found.insert(todo.at(i).path, todo.at(i));
+		for (InfoCache::const_iterator it = found.constBegin();
+		  it != found.constEnd(); ++it)
+			cache.insert(it.key(), *it);
+		if (!todo.isEmpty() || removed != hits)
+			saveCache(cache);
+
+		return loadDir(path, proj, cache);
+	} else {
 		TreeNode<Map*> tree;
 		tree.addItem(loadFile(path, proj));
 		return tree;
 	}
 }
 
+static void flatten(const TreeNode<Map*> &node, QList<Map*> &list)
+{
+	for (int i = 0; i < node.childs().size(); i++)
+		flatten(node.childs().at(i), list);
+	list.append(node.items());
+}
+
+Map *MapList::loadMap(const QString &path, const Projection &proj)
+{
+	QList<Map*> list;
+	Map *map = 0;
+
+	flatten(loadMaps(path, proj), list);
+	if (list.isEmpty())
+		qWarning("%s: no map found", qUtf8Printable(path));
+
+	for (int i = 0; i < list.size(); i++) {
+		Map *m = list.at(i);
+		if (!map && m->isValid())
+			map = m;
+		else {
+			if (!m->isValid())
+				qWarning("%s: %s", qUtf8Printable(m->path()),
+				  qUtf8Printable(m->errorString()));
+			delete m;
+		}
+	}
+
+	return map;
+}
+
 QString MapList::formats()
 {
 	return
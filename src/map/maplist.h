@@ -2,8 +2,11 @@
 #define MAPLIST_H
 
 #include <QString>
+#include <QHash>
 #include "common/treenode.h"
+#include "common/rectc.h"
 
+class QFileInfo;
 class Map;
 class Projection;
 
@@ -11,6 +14,9 @@ class MapList
 {
 public:
 	static TreeNode<Map*> loadMaps(const QString &path, const Projection &proj);
+	/* First valid map of the path (file or directory), the other maps are
+	   deleted. Returns 0 if there is no valid map. */
+	static Map *loadMap(const QString &path, const Projection &proj);
 	static QString formats();
 	static QStringList filter();
 
@@ -18,13 +24,48 @@ private:
 	typedef Map*(*ParserCb)(const QString &, const Projection &, bool *);
 	typedef QMultiMap<QString, ParserCb> ParserMap;
 
+	/* Map directory scan result, cached on disk between the runs */
+	struct Info {
+		Info() : size(-1), time(-1), isDir(false), valid(false), parser(0),
+		  proj(0) {}
+
+		QString path;
+		qint64 size;
+		qint64 time;
+		bool isDir;
+		bool valid;
+		QString format;
+		qint32 parser;
+		QString name;
+		QString error;
+		RectC bounds;
+		const Projection *proj;
+	};
+	typedef QHash<QString, Info> InfoCache;
+
+	static Map *loadFile(const QString &path, const Projection &proj,
+	  bool *isDir = 0, QString *format = 0, int *parser = 0);
+	/* Creates the map using the parser that succeeded when the map was
+	   scanned (the parser-th one registered for format). isDir is the value
+	   returned by the scan, directory maps are created as such again. */
 	static Map *loadFile(const QString &path, const Projection &proj,
-	  bool *isDir = 0);
+	  const QString &format, int parser, bool isDir);
 	static TreeNode<Map*> loadDir(const QString &path, const Projection &proj,
-	  TreeNode<Map*> *parent = 0);
+	  const InfoCache &cache, TreeNode<Map*> *parent = 0);
+
+	static bool parallel(const QString &suffix);
+	static bool upToDate(const Info &info, const QFileInfo &fi);
+	static void collect(const QString &path, const Projection &proj,
+	  const InfoCache &cache, InfoCache &found, QList<Info> &todo,
+	  QList<Info> &deferred);
+	static void scan(Info &info);
+	static InfoCache loadCache();
+	static void saveCache(const InfoCache &cache);
 
 	static ParserMap parsers();
 	static ParserMap _parsers;
+
+	friend class MapStub;
 };
 
 #endif // MAPLIST_H
@@ -19,34 +19,14 @@ using namespace Mapsforge;
 #define KEY_REF   "ref"
 #define KEY_ELE   "ele"
 
-static void copyPaths(const RectC &rect, const QList<MapData::Path> *src,
-  QList<MapData::Path> *dst)
+static QByteArray intern(QSet<QByteArray> &strings, const QByteArray &str)
 {
-	for (int i = 0; i < src->size(); i++) {
-		const MapData::Path &path = src->at(i);
-		if (rect.intersects(path.poly.boundingRect()))
-			dst->append(path);
-	}
-}
+	QSet<QByteArray>::const_iterator it(strings.constFind(str));
+	if (it != strings.constEnd())
+		return *it;
 
-static void copyPoints(const RectC &rect, const QList<MapData::Point> *src,
-  QList<MapData::Point> *dst)
-{
-	for (int i = 0; i < src->size(); i++) {
-		const MapData::Point &point = src->at(i);
-		if (rect.contains(point.coordinates))
-			dst->append(point);
-	}
-}
-
-static void copyPoints(const RectC &rect, const QList<MapData::Path> *src,
-  QList<MapData::Point> *dst)
-{
-	for (int i = 0; i < src->size(); i++) {
-		const MapData::Path &path = src->at(i);
-		if (path.closed && rect.contains(path.point.coordinates))
-			dst->append(path.point);
-	}
+	strings.insert(str);
+	return str;
 }
 
 static double distance(const Coordinates &c1, const Coordinates &c2)
@@ -162,7 +142,8 @@ static bool readOffset(QDataStream &stream, quint64 &offset)
 }
 
 bool MapData::readTags(SubFile &subfile, int count,
-  const QVector<TagSource> &tags, QVector<Tag> &list)
+  const QVector<TagSource> &tags, QSet<QByteArray> &strings,
+  QVector<Tag> &list)
 {
 	QVector<quint32> ids(count);
 
@@ -211,7 +192,7 @@ bool MapData::readTags(SubFile &subfile, int count,
 			} else
 				value = tag.value;
 
-			list[i] = MapData::Tag(tag.id, value);
+			list[i] = MapData::Tag(tag.id, intern(strings, value));
 		} else
 			list[i] = MapData::Tag(tag.id, tag.value);
 	}
@@ -264,6 +245,8 @@ bool MapData::readSubFiles(QFile &file)
 				offset = nextOffset;
 			}
 		}
+
+		_tiles.last()->Pack();
 	}
 
 	return true;
@@ -303,12 +286,12 @@ bool MapData::readTagInfo(SubFile &hdr, QVector<TagSource> &tags)
 		if (!hdr.readString(str))
 			return false;
 		tag = str;
-		unsigned key = _keys.value(tag.key);
+		unsigned key = _keys->value(tag.key);
 		if (key)
 			tag.id = key;
 		else {
-			tag.id = _keys.size() + 1;
-			_keys.insert(tag.key, tag.id);
+			tag.id = _keys->size() + 1;
+			_keys->insert(tag.key, tag.id);
 		}
 	}
 
@@ -317,10 +300,10 @@ bool MapData::readTagInfo(SubFile &hdr, QVector<TagSource> &tags)
 
 bool MapData::readTagInfo(SubFile &hdr)
 {
-	_keys.insert(KEY_NAME, ID_NAME);
-	_keys.insert(KEY_HOUSE, ID_HOUSE);
-	_keys.insert(KEY_REF, ID_REF);
-	_keys.insert(KEY_ELE, ID_ELE);
+	_keys->insert(KEY_NAME, ID_NAME);
+	_keys->insert(KEY_HOUSE, ID_HOUSE);
+	_keys->insert(KEY_REF, ID_REF);
+	_keys->insert(KEY_ELE, ID_ELE);
 
 	return (readTagInfo(hdr, _pointTags) && readTagInfo(hdr, _pathTags));
 }
@@ -421,7 +404,12 @@ bool MapData::readHeader(QFile &file)
 	return true;
 }
 
-MapData::MapData(const QString &fileName) : _fileName(fileName), _valid(false)
+MapData::MapData(const QString &fileName, QHash<QByteArray, unsigned> *keys)
+  : _fileName(fileName), _file(fileName), _map(0),
+  _keys(keys ? keys : &_localKeys),
+  _pathCache("Mapsforge paths", CacheRegistry::Items, &_pathCacheLock),
+  _pointCache("Mapsforge points", CacheRegistry::Items, &_pointCacheLock),
+  _valid(false)
 {
 	QFile file(fileName);
 
@@ -458,13 +446,19 @@ RectC MapData::bounds() const
 
 void MapData::load()
 {
-	QFile file(_fileName);
+	if (!_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+		qWarning("%s: %s", qUtf8Printable(_file.fileName()),
+		  qUtf8Printable(_file.errorString()));
+		return;
+	}
 
-	if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
-		qWarning("%s: %s", qUtf8Printable(file.fileName()),
-		  qUtf8Printable(file.errorString()));
-	else
-		readSubFiles(file);
+	readSubFiles(_file);
+
+	/* If the file can not be mapped (e.g. address space limits), the tiles
+	   are read using the file handles passed to paths()/points(). */
+	_map = _file.map(0, _file.size());
+	if (!_map)
+		_file.close();
 }
 
 void MapData::clear()
@@ -472,6 +466,12 @@ void MapData::clear()
 	_pathCache.clear();
 	_pointCache.clear();
 
+	if (_map) {
+		_file.unmap(_map);
+		_map = 0;
+	}
+	_file.close();
+
 	clearTiles();
 }
 
@@ -513,7 +513,7 @@ int MapData::level(int zoom) const
 }
 
 void MapData::points(QFile &file, const RectC &rect, int zoom,
-  QList<Point> *list)
+  PointList *list)
 {
 	if (!rect.isValid())
 		return;
@@ -530,52 +530,86 @@ void MapData::points(QFile &file, const RectC &rect, int zoom,
 	_tiles.at(l)->Search(min, max, pointCb, &ctx);
 }
 
-void MapData::points(QFile &file, VectorTile *tile, const RectC &rect,
-  int zoom, QList<Point> *list)
+MapData::PathsPtr MapData::tilePaths(QFile &file, VectorTile *tile, int zoom)
 {
 	Key key(tile, zoom);
 
-	tile->lock.lock();
+	_pathCacheLock.lock();
+	PathsPtr *cached = _pathCache.object(key);
+	PathsPtr paths(cached ? *cached : PathsPtr());
+	_pathCacheLock.unlock();
+
+	if (!paths) {
+		QList<Path> *p = new QList<Path>();
+		if (!readPaths(file, tile, zoom, p)) {
+			delete p;
+			return PathsPtr();
+		}
+		paths = PathsPtr(p);
+
+		_pathCacheLock.lock();
+		_pathCache.insert(key, new PathsPtr(paths));
+		_pathCacheLock.unlock();
+	}
+
+	return paths;
+}
+
+MapData::PointsPtr MapData::tilePoints(QFile &file, VectorTile *tile,
+  int zoom)
+{
+	Key key(tile, zoom);
 
 	_pointCacheLock.lock();
-	QList<Point> *tilePoints = _pointCache.object(key);
-	if (!tilePoints) {
-		_pointCacheLock.unlock();
+	PointsPtr *cached = _pointCache.object(key);
+	PointsPtr points(cached ? *cached : PointsPtr());
+	_pointCacheLock.unlock();
+
+	if (!points) {
 		QList<Point> *p = new QList<Point>();
-		if (readPoints(file, tile, zoom, p)) {
-			copyPoints(rect, p, list);
-			_pointCacheLock.lock();
-			_pointCache.insert(key, p);
-			_pointCacheLock.unlock();
-		} else
+		if (!readPoints(file, tile, zoom, p)) {
 			delete p;
-	} else {
-		copyPoints(rect, tilePoints, list);
+			return PointsPtr();
+		}
+		points = PointsPtr(p);
+
+		_pointCacheLock.lock();
+		_pointCache.insert(key, new PointsPtr(points));
 		_pointCacheLock.unlock();
 	}
 
-	_pathCacheLock.lock();
-	QList<Path> *tilePaths = _pathCache.object(key);
-	if (!tilePaths) {
-		_pathCacheLock.unlock();
-		QList<Path> *p = new QList<Path>();
-		if (readPaths(file, tile, zoom, p)) {
-			copyPoints(rect, p, list);
-			_pathCacheLock.lock();
-			_pathCache.insert(key, p);
-			_pathCacheLock.unlock();
-		} else
-			delete p;
-	} else {
-		copyPoints(rect, tilePaths, list);
-		_pathCacheLock.unlock();
-	}
+	return points;
+}
 
+void MapData::points(QFile &file, VectorTile *tile, const RectC &rect,
+  int zoom, PointList *list)
+{
+	tile->lock.lock();
+	PointsPtr points(tilePoints(file, tile, zoom));
+	PathsPtr paths(tilePaths(file, tile, zoom));
 	tile->lock.unlock();
+
+	if (points) {
+		for (int i = 0; i < points->size(); i++) {
+			const Point &point = points->at(i);
+			if (rect.contains(point.coordinates))
+				list->_items.append(&point);
+		}
+		list->_points.append(points);
+	}
+
+	if (paths) {
+		for (int i = 0; i < paths->size(); i++) {
+			const Path &path = paths->at(i);
+			if (path.closed && rect.contains(path.point.coordinates))
+				list->_items.append(&path.point);
+		}
+		list->_paths.append(paths);
+	}
 }
 
 void MapData::paths(QFile &file, const RectC &searchRect,
-  const RectC &boundsRect, int zoom, QList<Path> *list)
+  const RectC &boundsRect, int zoom, PathList *list)
 {
 	if (!searchRect.isValid())
 		return;
@@ -593,43 +627,34 @@ void MapData::paths(QFile &file, const RectC &searchRect,
 }
 
 void MapData::paths(QFile &file, VectorTile *tile, const RectC &rect, int zoom,
-  QList<Path> *list)
+  PathList *list)
 {
-	Key key(tile, zoom);
-
 	tile->lock.lock();
+	PathsPtr paths(tilePaths(file, tile, zoom));
+	tile->lock.unlock();
 
-	_pathCacheLock.lock();
-	QList<Path> *cached = _pathCache.object(key);
-	if (!cached) {
-		_pathCacheLock.unlock();
-		QList<Path> *p = new QList<Path>();
-		if (readPaths(file, tile, zoom, p)) {
-			copyPaths(rect, p, list);
-			_pathCacheLock.lock();
-			_pathCache.insert(key, p);
-			_pathCacheLock.unlock();
-		} else
-			delete p;
-	} else {
-		copyPaths(rect, cached, list);
-		_pathCacheLock.unlock();
+	if (paths) {
+		for (int i = 0; i < paths->size(); i++) {
+			const Path &path = paths->at(i);
+			if (rect.intersects(path.poly.boundingRect()))
+				list->_items.append(&path);
+		}
+		list->_paths.append(paths);
 	}
-
-	tile->lock.unlock();
 }
 
 bool MapData::readPaths(QFile &file, const VectorTile *tile, int zoom,
   QList<Path> *list)
 {
 	const SubFileInfo &info = _subFiles.at(level(zoom));
-	SubFile subfile(file, info.offset, info.size);
+	SubFile subfile(file, info.offset, info.size, _map);
 	int rows = info.max - info.min + 1;
 	QVector<unsigned> paths(rows);
 	quint32 blocks, unused, val, cnt = 0;
 	quint16 bitmap;
 	quint8 sb, flags;
 	QByteArray name, houseNumber, reference;
+	QSet<QByteArray> strings;
 
 
 	if (!subfile.seek(tile->offset & OFFSET_MASK))
@@ -659,7 +684,7 @@ bool MapData::readPaths(QFile &file, const VectorTile *tile, int zoom,
 
 		p.point.layer = sb >> 4;
 		int tags = sb & 0x0F;
-		if (!readTags(subfile, tags, _pathTags, p.point.tags))
+		if (!readTags(subfile, tags, _pathTags, strings, p.point.tags))
 			return false;
 
 		if (!subfile.readByte(flags))
@@ -668,17 +693,17 @@ bool MapData::readPaths(QFile &file, const VectorTile *tile, int zoom,
 			if (!subfile.readString(name))
 				return false;
 			name = name.split('\r').first();
-			p.point.tags.append(Tag(ID_NAME, name));
+			p.point.tags.append(Tag(ID_NAME, intern(strings, name)));
 		}
 		if (flags & 0x40) {
 			if (!subfile.readString(houseNumber))
 				return false;
-			p.point.tags.append(Tag(ID_HOUSE, houseNumber));
+			p.point.tags.append(Tag(ID_HOUSE, intern(strings, houseNumber)));
 		}
 		if (flags & 0x20) {
 			if (!subfile.readString(reference))
 				return false;
-			p.point.tags.append(Tag(ID_REF, reference));
+			p.point.tags.append(Tag(ID_REF, intern(strings, reference)));
 		}
 		if (flags & 0x10) {
 			if (!(subfile.readVInt32(lat) && subfile.readVInt32(lon)))
@@ -712,12 +737,13 @@ bool MapData::readPoints(QFile &file, const VectorTile *tile, int zoom,
   QList<Point> *list)
 {
 	const SubFileInfo &info = _subFiles.at(level(zoom));
-	SubFile subfile(file, info.offset, info.size);
+	SubFile subfile(file, info.offset, info.size, _map);
 	int rows = info.max - info.min + 1;
 	QVector<unsigned> points(rows);
 	quint32 val, unused, cnt = 0;
 	quint8 sb, flags;
 	QByteArray name, houseNumber;
+	QSet<QByteArray> strings;
 
 
 	if (!subfile.seek(tile->offset & OFFSET_MASK))
@@ -748,7 +774,7 @@ bool MapData::readPoints(QFile &file, const VectorTile *tile, int zoom,
 			return false;
 		p.layer = sb >> 4;
 		int tags = sb & 0x0F;
-		if (!readTags(subfile, tags, _pointTags, p.tags))
+		if (!readTags(subfile, tags, _pointTags, strings, p.tags))
 			return false;
 
 		if (!subfile.readByte(flags))
@@ -757,18 +783,19 @@ bool MapData::readPoints(QFile &file, const VectorTile *tile, int zoom,
 			if (!subfile.readString(name))
 				return false;
 			name = name.split('\r').first();
-			p.tags.append(Tag(ID_NAME, name));
+			p.tags.append(Tag(ID_NAME, intern(strings, name)));
 		}
 		if (flags & 0x40) {
 			if (!subfile.readString(houseNumber))
 				return false;
-			p.tags.append(Tag(ID_HOUSE, houseNumber));
+			p.tags.append(Tag(ID_HOUSE, intern(strings, houseNumber)));
 		}
 		if (flags & 0x20) {
 			qint32 elevation;
 			if (!subfile.readVInt32(elevation))
 				return false;
-			p.tags.append(Tag(ID_ELE, QByteArray::number(elevation)));
+			p.tags.append(Tag(ID_ELE, intern(strings,
+			  QByteArray::number(elevation))));
 		}
 
 		list->append(p);
@@ -4,9 +4,12 @@
 #include <QFile>
 #include <QCache>
 #include <QMutex>
+#include <QSharedPointer>
+#include <QSet>
 #include "common/hash.h"
+#include "common/cacheregistry.h"
 #include "common/rectc.h"
-#include "common/rtree.h"
+#include "common/packedrtree.h"
 #include "common/range.h"
 #include "common/polygon.h"
 
@@ -22,7 +25,9 @@ class SubFile;
 class MapData
 {
 public:
-	MapData(const QString &path);
+	/* The tag key IDs are assigned from the keys table, pass a shared table
+	   to get compatible IDs in multiple map files. */
+	MapData(const QString &path, QHash<QByteArray, unsigned> *keys = 0);
 	~MapData();
 
 	struct Tag {
@@ -58,16 +63,40 @@ public:
 		  {return point.layer < other.point.layer;}
 	};
 
+	typedef QSharedPointer<const QList<Path> > PathsPtr;
+	typedef QSharedPointer<const QList<Point> > PointsPtr;
+
+	/* List of references to the cached tile data. The referenced tile data
+	   are kept alive as long as the list exists. */
+	template <class T>
+	class List
+	{
+	public:
+		int size() const {return _items.size();}
+		const T &at(int i) const {return *_items.at(i);}
+
+	private:
+		friend class MapData;
+
+		QList<const T*> _items;
+		QList<PathsPtr> _paths;
+		QList<PointsPtr> _points;
+	};
+
+	typedef List<Path> PathList;
+	typedef List<Point> PointList;
+
 	const QString &fileName() const {return _fileName;}
 	RectC bounds() const;
 	Range zooms() const
 	  {return Range(_subFiles.first().min, _subFiles.last().max);}
 	int tileSize() const {return _tileSize;}
+	bool isMapped() const {return (_map != 0);}
 
-	void points(QFile &file, const RectC &rect, int zoom, QList<Point> *list);
+	void points(QFile &file, const RectC &rect, int zoom, PointList *list);
 	void paths(QFile &file, const RectC &searchRect, const RectC &boundsRect,
-	  int zoom, QList<Path> *set);
-	unsigned tagId(const QByteArray &name) const {return _keys.value(name);}
+	  int zoom, PathList *list);
+	unsigned tagId(const QByteArray &name) const {return _keys->value(name);}
 
 	void load();
 	void clear();
@@ -95,26 +124,26 @@ private:
 
 	struct PathCTX {
 		PathCTX(QFile &file, MapData *data, const RectC &rect, int zoom,
-		  QList<Path> *list)
+		  PathList *list)
 		  : file(file), data(data), rect(rect), zoom(zoom), list(list) {}
 
 		QFile &file;
 		MapData *data;
 		const RectC &rect;
 		int zoom;
-		QList<Path> *list;
+		PathList *list;
 	};
 
 	struct PointCTX {
 		PointCTX(QFile &file, MapData *data, const RectC &rect, int zoom,
-		  QList<Point> *list)
+		  PointList *list)
 		  : file(file), data(data), rect(rect), zoom(zoom), list(list) {}
 
 		QFile &file;
 		MapData *data;
 		const RectC &rect;
 		int zoom;
-		QList<Point> *list;
+		PointList *list;
 	};
 
 	struct Key {
@@ -142,7 +171,7 @@ private:
 		unsigned id;
 	};
 
-	typedef RTree<VectorTile *, double, 2> TileTree;
+	typedef PackedRTree<VectorTile *, double, 2> TileTree;
 
 	bool readZoomInfo(SubFile &hdr);
 	bool readTagInfo(SubFile &hdr);
@@ -154,31 +183,37 @@ private:
 
 	int level(int zoom) const;
 	void paths(QFile &file, VectorTile *tile, const RectC &rect, int zoom,
-	  QList<Path> *list);
+	  PathList *list);
 	void points(QFile &file, VectorTile *tile, const RectC &rect, int zoom,
-	  QList<Point> *list);
+	  PointList *list);
+	PathsPtr tilePaths(QFile &file, VectorTile *tile, int zoom);
+	PointsPtr tilePoints(QFile &file, VectorTile *tile, int zoom);
 	bool readPaths(QFile &file, const VectorTile *tile, int zoom,
 	  QList<Path> *list);
 	bool readPoints(QFile &file, const VectorTile *tile, int zoom,
 	  QList<Point> *list);
 
 	static bool readTags(SubFile &subfile, int count,
-	  const QVector<TagSource> &tags, QVector<Tag> &list);
+	  const QVector<TagSource> &tags, QSet<QByteArray> &strings,
+	  QVector<Tag> &list);
 	static bool pathCb(VectorTile *tile, void *context);
 	static bool pointCb(VectorTile *tile, void *context);
 
 	friend HASH_T qHash(const MapData::Key &key);
 
 	QString _fileName;
+	QFile _file;
+	uchar *_map;
 	RectC _bounds;
 	quint16 _tileSize;
 	QVector<SubFileInfo> _subFiles;
 	QVector<TagSource> _pointTags, _pathTags;
 	QList<TileTree*> _tiles;
-	QHash<QByteArray, unsigned> _keys;
+	QHash<QByteArray, unsigned> _localKeys;
+	QHash<QByteArray, unsigned> *_keys;
 
-	QCache<Key, QList<Path> > _pathCache;
-	QCache<Key, QList<Point> > _pointCache;
+	StatsCache<Key, PathsPtr> _pathCache;
+	StatsCache<Key, PointsPtr> _pointCache;
 	QMutex _pathCacheLock, _pointCacheLock;
 
 	bool _valid;
@@ -187,12 +222,12 @@ private:
 
 inline HASH_T qHash(const MapData::Key &key)
 {
-	return ::qHash(key.tile) ^ ::qHash(key.zoom);
+	return Hash::combine((quintptr)key.tile, key.zoom);
 }
 
 inline HASH_T qHash(const MapData::Tag &tag)
 {
-	return ::qHash(tag.key) ^ ::qHash(tag.value);
+	return Hash::combine(tag.key, ::qHash(tag.value));
 }
 
 }
@@ -1,10 +1,12 @@
 #include <cmath>
 #include <QPainter>
 #include <QCache>
+#include "common/trace.h"
 #include "map/dem.h"
 #include "map/rectd.h"
 #include "map/hillshading.h"
 #include "map/filter.h"
+#include "map/llgrid.h"
 #include "map/bitmapline.h"
 #include "rastertile.h"
 
@@ -13,6 +15,66 @@ using namespace Mapsforge;
 #define TEXT_EXTENT 160
 #define PATHS_EXTENT 20
 #define SEARCH_EXTENT -0.5
+#define CLIP_EXTENT 256
+
+enum {OutLeft = 1, OutRight = 2, OutTop = 4, OutBottom = 8};
+
+static inline int outcode(const QPointF &p, const QRectF &rect)
+{
+	int code = 0;
+
+	if (p.x() < rect.left())
+		code |= OutLeft;
+	else if (p.x() > rect.right())
+		code |= OutRight;
+	if (p.y() < rect.top())
+		code |= OutTop;
+	else if (p.y() > rect.bottom())
+		code |= OutBottom;
+
+	return code;
+}
+
+/* Removes the vertices of runs of vertices lying outside the same edge of the
+   rect. The first two and last two vertices of a run are kept, so the lines,
+   curves and polygon fills inside the rect remain exactly the same. */
+static QVector<QPointF> clipPath(const QVector<QPointF> &path,
+  const QRectF &rect)
+{
+	QVector<QPointF> clipped;
+	int i = 0;
+
+	clipped.reserve(path.size());
+
+	while (i < path.size()) {
+		int code = outcode(path.at(i), rect);
+		int j = i + 1;
+
+		if (code) {
+			while (j < path.size()) {
+				int c = code & outcode(path.at(j), rect);
+				if (!c)
+					break;
+				code = c;
+				j++;
+			}
+		}
+
+		if (j - i > 4) {
+			clipped.append(path.at(i));
+			clipped.append(path.at(i + 1));
+			clipped.append(path.at(j - 2));
+			clipped.append(path.at(j - 1));
+		} else {
+			for (int k = i; k < j; k++)
+				clipped.append(path.at(k));
+		}
+
+		i = j;
+	}
+
+	return clipped;
+}
 
 static double LIMIT = cos(deg2rad(170));
 
@@ -72,41 +134,31 @@ static QPainterPath parallelPath(const QPainterPath &p, double dy)
 	return h;
 }
 
-void RasterTile::processLabels(const QList<MapData::Point> &points,
-  QList<TextItem*> &textItems) const
+void RasterTile::processLabels(const MapData::PointList &points,
+  TextItemList &textItems) const
 {
 	QList<Label> items;
-	QList<const Style::TextRender*> labels(_style->labels(_zoom));
-	QList<const Style::Symbol*> symbols(_style->symbols(_zoom));
 
 	for (int i = 0; i < points.size(); i++) {
 		const MapData::Point &point = points.at(i);
+		Style::PointRender pr(_style->points(_zoom, point.center(),
+		  point.tags));
 		const Style::TextRender *ti = 0;
-		const Style::Symbol *si = 0;
+		const Style::Symbol *si = pr.symbol;
 		QList<const QByteArray *> ll;
 
-		for (int j = 0; j < symbols.size(); j++) {
-			const Style::Symbol *ri = symbols.at(j);
-			if (ri->rule().match(point.center(), point.tags)) {
-				si = ri;
-				break;
-			}
-		}
-
-		for (int j = 0; j < labels.size(); j++) {
-			const Style::TextRender *ri = labels.at(j);
-			if (ri->rule().match(point.center(), point.tags)) {
-				const QByteArray *lbl = label(ri->key(), point.tags);
-				if (lbl) {
-					if (!si) {
+		for (int j = 0; j < pr.labels.size(); j++) {
+			const Style::TextRender *ri = pr.labels.at(j);
+			const QByteArray *lbl = label(ri->key(), point.tags);
+			if (lbl) {
+				if (!si) {
+					ti = ri;
+					ll.append(lbl);
+					break;
+				} else if (si->id() == ri->symbolId()) {
+					if (!ti)
 						ti = ri;
-						ll.append(lbl);
-						break;
-					} else if (si->id() == ri->symbolId()) {
-						if (!ti)
-							ti = ri;
-						ll.append(lbl);
-					}
+					ll.append(lbl);
 				}
 			}
 		}
@@ -134,7 +186,7 @@ void RasterTile::processLabels(const QList<MapData::Point> &points,
 }
 
 void RasterTile::processLineLabels(const QVector<PainterPath> &paths,
-  QList<TextItem*> &textItems) const
+  TextItemList &textItems) const
 {
 	QList<const Style::TextRender*> labels(_style->pathLabels(_zoom));
 	QList<const Style::Symbol*> symbols(_style->lineSymbols(_zoom));
@@ -195,10 +247,14 @@ void RasterTile::processLineLabels(const QVector<PainterPath> &paths,
 		if (!l.si && l.ti && l.ti->shield()) {
 			if (l.ti && l.lbl && set.contains(*l.lbl))
 				continue;
-			if (l.path->pp.length() < _rect.width() / 3.0)
+			/* The shields are placed in the center of the whole path */
+			QPainterPath pp((l.path->clip && l.path->pp.elementCount())
+			  ? painterPath(l.path->path->poly, l.path->curve, false)
+			  : l.path->pp);
+			if (pp.length() < _rect.width() / 3.0)
 				continue;
 
-			QPointF pos = l.path->pp.pointAtPercent(0.5);
+			QPointF pos = pp.pointAtPercent(0.5);
 
 			PointItem *item = new PointItem(pos.toPoint(), l.lbl, font, color,
 			  hColor);
@@ -233,7 +289,7 @@ void RasterTile::processLineLabels(const QVector<PainterPath> &paths,
 }
 
 void RasterTile::drawTextItems(QPainter *painter,
-  const QList<TextItem*> &textItems)
+  const TextItemList &textItems)
 {
 	QRectF rect(_rect);
 
@@ -244,47 +300,43 @@ void RasterTile::drawTextItems(QPainter *painter,
 	}
 }
 
-QPainterPath RasterTile::painterPath(const Polygon &polygon, bool curve) const
+QPainterPath RasterTile::painterPath(const Polygon &polygon, bool curve,
+  bool clip) const
 {
+	QRectF rect(QRectF(_rect).adjusted(-CLIP_EXTENT, -CLIP_EXTENT, CLIP_EXTENT,
+	  CLIP_EXTENT));
 	QPainterPath path;
 
-	if (curve) {
-		int size = 0;
-		for (int i = 0; i < polygon.size(); i++)
-			size += polygon.at(i).size();
-		path.reserve(size);
+	for (int i = 0; i < polygon.size(); i++) {
+		const QVector<Coordinates> &subpath = polygon.at(i);
 
-		for (int i = 0; i < polygon.size(); i++) {
-			const QVector<Coordinates> &subpath = polygon.at(i);
+		QVector<QPointF> p(subpath.size());
+		for (int j = 0; j < subpath.size(); j++)
+			p[j] = ll2xy(subpath.at(j));
+		if (clip)
+			p = clipPath(p, rect);
 
-			QPointF p1(ll2xy(subpath.first()));
+		if (curve) {
+			QPointF p1(p.first());
 			QPointF p2(0, 0);
 			QPointF p3(0, 0);
 
 			path.moveTo(p1);
-			for (int j = 1; j < subpath.size(); j++) {
-				p3 = ll2xy(subpath.at(j));
+			for (int j = 1; j < p.size(); j++) {
+				p3 = p.at(j);
 				p2 = QPointF((p1.x() + p3.x()) / 2.0, (p1.y() + p3.y()) / 2.0);
 				path.quadTo(p1, p2);
 				p1 = p3;
 			}
 			path.quadTo(p2, p3);
-		}
-	} else {
-		for (int i = 0; i < polygon.size(); i++) {
-			const QVector<Coordinates> &subpath = polygon.at(i);
-
-			QVector<QPointF> p(subpath.size());
-			for (int j = 0; j < subpath.size(); j++)
-				p[j] = ll2xy(subpath.at(j));
+		} else
 			path.addPolygon(p);
-		}
 	}
 
 	return path;
 }
 
-void RasterTile::pathInstructions(const QList<MapData::Path> &paths,
+void RasterTile::pathInstructions(const MapData::PathList &paths,
   QVector<PainterPath> &painterPaths,
   QVector<RasterTile::RenderInstruction> &instructions) const
 {
@@ -301,17 +353,20 @@ void RasterTile::pathInstructions(const QList<MapData::Path> &paths,
 		if (!(ri = cache.object(key))) {
 			ri = new QList<const Style::PathRender*>(_style->paths(_zoom,
 			  path.closed, path.point.tags));
-			for (int j = 0; j < ri->size(); j++)
-				instructions.append(RenderInstruction(ri->at(j), &rp));
 			cache.insert(key, ri);
-		} else {
-			for (int j = 0; j < ri->size(); j++)
-				instructions.append(RenderInstruction(ri->at(j), &rp));
+		}
+
+		for (int j = 0; j < ri->size(); j++) {
+			const Style::PathRender *r = ri->at(j);
+			/* The clipping would shift the dash pattern/bitmap phase */
+			if (r->dashed() || r->bitmapLine())
+				rp.clip = false;
+			instructions.append(RenderInstruction(r, &rp));
 		}
 	}
 }
 
-void RasterTile::circleInstructions(const QList<MapData::Point> &points,
+void RasterTile::circleInstructions(const MapData::PointList &points,
   QVector<RasterTile::RenderInstruction> &instructions) const
 {
 	QCache<PointKey, QList<const Style::CircleRender *> > cache(8192);
@@ -342,8 +397,8 @@ void RasterTile::hillShadingInstructions(
 		instructions.append(RenderInstruction(hs));
 }
 
-void RasterTile::drawPaths(QPainter *painter, const QList<MapData::Path> &paths,
-  const QList<MapData::Point> &points, QVector<PainterPath> &painterPaths)
+void RasterTile::drawPaths(QPainter *painter, const MapData::PathList &paths,
+  const MapData::PointList &points, QVector<PainterPath> &painterPaths)
 {
 	QVector<RenderInstruction> instructions;
 	pathInstructions(paths, painterPaths, instructions);
@@ -360,8 +415,11 @@ void RasterTile::drawPaths(QPainter *painter, const QList<MapData::Path> &paths,
 			const Style::PathRender *ri = is.pathRender();
 			qreal dy = ri->dy(_zoom);
 
-			if (!path->pp.elementCount())
-				path->pp = painterPath(path->path->poly, ri->curve());
+			if (!path->pp.elementCount()) {
+				path->curve = ri->curve();
+				path->pp = painterPath(path->path->poly, path->curve,
+				  path->clip);
+			}
 
 			if (ri->bitmapLine()) {
 				if (dy != 0)
@@ -386,32 +444,16 @@ void RasterTile::drawPaths(QPainter *painter, const QList<MapData::Path> &paths,
 			painter->setBrush(ri->brush());
 			painter->drawEllipse(ll2xy(point->coordinates), radius, radius);
 		} else {
-			if (_hillShading) {
-				if (HillShading::blur()) {
-					MatrixD dem(Filter::blur(elevation(HillShading::blur() + 1),
-					  HillShading::blur()));
-					QImage img(HillShading::render(dem, HillShading::blur() + 1));
-					painter->drawImage(_rect.x(), _rect.y(), img);
-				} else
-					painter->drawImage(_rect.x(), _rect.y(),
-					  HillShading::render(elevation(1), 1));
-			}
+			if (_hillShading)
+				painter->drawImage(_rect.x(), _rect.y(), hillShading());
 		}
 	}
 }
 
-void RasterTile::fetchData(QList<MapData::Path> &paths,
-  QList<MapData::Point> &points) const
+void RasterTile::fetchData(MapData::PathList &paths,
+  MapData::PointList &points) const
 {
 	QPoint ttl(_rect.topLeft());
-	QFile file(_data->fileName());
-
-	if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
-		qWarning("%s: %s", qUtf8Printable(file.fileName()),
-		  qUtf8Printable(file.errorString()));
-		return;
-	}
-
 	QRectF pathRect(QPointF(ttl.x() - PATHS_EXTENT, ttl.y() - PATHS_EXTENT),
 	  QPointF(ttl.x() + _rect.width() + PATHS_EXTENT, ttl.y() + _rect.height()
 	  + PATHS_EXTENT));
@@ -422,15 +464,30 @@ void RasterTile::fetchData(QList<MapData::Path> &paths,
 	  _transform.img2proj(pathRect.bottomRight()));
 	RectD searchRectD(_transform.img2proj(searchRect.topLeft()),
 	  _transform.img2proj(searchRect.bottomRight()));
-	_data->paths(file, searchRectD.toRectC(_proj, 20),
-	  pathRectD.toRectC(_proj, 20), _zoom, &paths);
-
 	QRectF pointRect(QPointF(ttl.x() - TEXT_EXTENT, ttl.y() - TEXT_EXTENT),
 	  QPointF(ttl.x() + _rect.width() + TEXT_EXTENT, ttl.y() + _rect.height()
 	  + TEXT_EXTENT));
 	RectD pointRectD(_transform.img2proj(pointRect.topLeft()),
 	  _transform.img2proj(pointRect.bottomRight()));
-	_data->points(file, pointRectD.toRectC(_proj, 20), _zoom, &points);
+	RectC searchRectC(searchRectD.toRectC(_proj, 20));
+	RectC pathRectC(pathRectD.toRectC(_proj, 20));
+	RectC pointRectC(pointRectD.toRectC(_proj, 20));
+
+	/* All the map files features are merged into a single paths/points list
+	   so that the style and the label placement are processed only once */
+	for (int i = 0; i < _data.size(); i++) {
+		MapData *data = _data.at(i);
+		QFile file(data->fileName());
+		if (!data->isMapped()
+		  && !file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+			qWarning("%s: %s", qUtf8Printable(file.fileName()),
+			  qUtf8Printable(file.errorString()));
+			continue;
+		}
+
+		data->paths(file, searchRectC, pathRectC, _zoom, &paths);
+		data->points(file, pointRectC, _zoom, &points);
+	}
 }
 
 MatrixD RasterTile::elevation(int extend) const
@@ -440,24 +497,50 @@ MatrixD RasterTile::elevation(int extend) const
 	int top = _rect.top() - extend;
 	int bottom = _rect.bottom() + extend;
 
-	MatrixC ll(_rect.height() + 2 * extend, _rect.width() + 2 * extend);
-	for (int y = top, i = 0; y <= bottom; y++)
-		for (int x = left; x <= right; x++, i++)
-			ll.at(i) = xy2ll(QPointF(x, y));
+	MatrixC ll(LLGrid::coordinates(_proj, _transform, QRect(left, top,
+	  right - left + 1, bottom - top + 1)));
 
 	return DEM::elevation(ll);
 }
 
+QImage RasterTile::hillShading() const
+{
+	QString key(HillShading::key(_data.first()->fileName() + "-"
+	  + QString::number(_zoom) + "_" + QString::number(_rect.x()) + "_"
+	  + QString::number(_rect.y()), xy2ll(_rect.topLeft()),
+	  xy2ll(_rect.bottomRight())));
+	QImage img;
+
+	if (HillShading::find(key, &img))
+		return img;
+
+	if (HillShading::blur()) {
+		MatrixD dem(Filter::blur(elevation(HillShading::blur() + 1),
+		  HillShading::blur()));
+		img = HillShading::render(dem, HillShading::blur() + 1);
+	} else
+		img = HillShading::render(elevation(1), 1);
+
+	HillShading::insert(key, img);
+
+	return img;
+}
+
 void RasterTile::render()
 {
-	QImage img(_rect.width() * _ratio, _rect.height() * _ratio,
-	  QImage::Format_ARGB32_Premultiplied);
-	QList<MapData::Path> paths;
-	QList<MapData::Point> points;
+	MapData::PathList paths;
+	MapData::PointList points;
 
+	if (cancelled())
+		return;
+	TRACE_SCOPE("Mapsforge", "fetchData");
 	fetchData(paths, points);
+	if (cancelled())
+		return;
 
-	QList<TextItem*> textItems;
+	QImage img(_rect.width() * _ratio, _rect.height() * _ratio,
+	  QImage::Format_ARGB32_Premultiplied);
+	TextItemList textItems;
 	QVector<PainterPath> renderPaths(paths.size());
 
 	img.setDevicePixelRatio(_ratio);
@@ -468,10 +551,13 @@ void RasterTile::render()
 	painter.setRenderHint(QPainter::SmoothPixmapTransform);
 	painter.translate(-_rect.x(), -_rect.y());
 
+	TRACE_NEXT("drawPaths");
 	drawPaths(&painter, paths, points, renderPaths);
 
+	TRACE_NEXT("labels");
 	processLabels(points, textItems);
 	processLineLabels(renderPaths, textItems);
+	TRACE_NEXT("drawLabels");
 	drawTextItems(&painter, textItems);
 
 	//painter.setPen(Qt::red);
@@ -481,5 +567,7 @@ void RasterTile::render()
 
 	qDeleteAll(textItems);
 
-	_pixmap.convertFromImage(img);
+	/* Convert the image in place, without an additional copy */
+	painter.end();
+	_pixmap = QPixmap::fromImage(std::move(img));
 }
@@ -2,9 +2,11 @@
 #define MAPSFORGE_RASTERTILE_H
 
 #include <QPixmap>
+#include <QAtomicInt>
 #include "map/projection.h"
 #include "map/transform.h"
 #include "map/textpointitem.h"
+#include "map/textitemlist.h"
 #include "map/textpathitem.h"
 #include "map/matrix.h"
 #include "style.h"
@@ -24,23 +26,29 @@ class RasterTile
 {
 public:
 	RasterTile(const Projection &proj, const Transform &transform,
-	  const Style *style, MapData *data, int zoom, const QRect &rect,
-	  qreal ratio, bool hillShading)
+	  const Style *style, const QList<MapData*> &data, int zoom,
+	  const QRect &rect, qreal ratio, bool hillShading)
 		: _proj(proj), _transform(transform), _style(style), _data(data),
-		_zoom(zoom), _rect(rect), _ratio(ratio), _hillShading(hillShading) {}
+		_zoom(zoom), _rect(rect), _ratio(ratio), _cancel(0),
+		_hillShading(hillShading), _draft(false) {}
 
 	int zoom() const {return _zoom;}
 	QPoint xy() const {return _rect.topLeft();}
 	const QPixmap &pixmap() const {return _pixmap;}
+	bool isDraft() const {return _draft;}
 
+	/* Draft tiles are rendered without the hill shading */
+	void setDraft(bool draft) {_draft = draft;}
+	void setCancelFlag(const QAtomicInt *cancel) {_cancel = cancel;}
 	void render();
 
 private:
 	struct PainterPath {
-		PainterPath() : path(0) {}
+		PainterPath() : path(0), clip(true), curve(false) {}
 
 		QPainterPath pp;
 		const MapData::Path *path;
+		bool clip, curve;
 	};
 
 	struct Label {
@@ -208,49 +216,55 @@ private:
 	friend HASH_T qHash(const RasterTile::PathKey &key);
 	friend HASH_T qHash(const RasterTile::PointKey &key);
 
-	void fetchData(QList<MapData::Path> &paths,
-	  QList<MapData::Point> &points) const;
-	void pathInstructions(const QList<MapData::Path> &paths,
+	void fetchData(MapData::PathList &paths,
+	  MapData::PointList &points) const;
+	void pathInstructions(const MapData::PathList &paths,
 	  QVector<PainterPath> &painterPaths,
 	  QVector<RasterTile::RenderInstruction> &instructions) const;
-	void circleInstructions(const QList<MapData::Point> &points,
+	void circleInstructions(const MapData::PointList &points,
 	  QVector<RasterTile::RenderInstruction> &instructions) const;
 	void hillShadingInstructions(
 	  QVector<RasterTile::RenderInstruction> &instructions) const;
+	bool cancelled() const {return (_cancel && _cancel->loadAcquire());}
 	QPointF ll2xy(const Coordinates &c) const
 	  {return _transform.proj2img(_proj.ll2xy(c));}
 	Coordinates xy2ll(const QPointF &p) const
 	  {return _proj.xy2ll(_transform.img2proj(p));}
-	void processLabels(const QList<MapData::Point> &points,
-	  QList<TextItem*> &textItems) const;
+	void processLabels(const MapData::PointList &points,
+	  TextItemList &textItems) const;
 	void processLineLabels(const QVector<PainterPath> &paths,
-	  QList<TextItem*> &textItems) const;
-	QPainterPath painterPath(const Polygon &polygon, bool curve) const;
-	void drawTextItems(QPainter *painter, const QList<TextItem*> &textItems);
-	void drawPaths(QPainter *painter, const QList<MapData::Path> &paths,
-	  const QList<MapData::Point> &points, QVector<PainterPath> &painterPaths);
+	  TextItemList &textItems) const;
+	QPainterPath painterPath(const Polygon &polygon, bool curve,
+	  bool clip) const;
+	void drawTextItems(QPainter *painter, const TextItemList &textItems);
+	void drawPaths(QPainter *painter, const MapData::PathList &paths,
+	  const MapData::PointList &points, QVector<PainterPath> &painterPaths);
 
 	MatrixD elevation(int extend) const;
+	QImage hillShading() const;
 
 	Projection _proj;
 	Transform _transform;
 	const Style *_style;
-	MapData *_data;
+	QList<MapData*> _data;
 	int _zoom;
 	QRect _rect;
 	qreal _ratio;
+	const QAtomicInt *_cancel;
 	QPixmap _pixmap;
 	bool _hillShading;
+	bool _draft;
 };
 
 inline HASH_T qHash(const RasterTile::PathKey &key)
 {
-	return ::qHash(key.zoom) ^ ::qHash(key.tags);
+	return Hash::combine(((quint64)key.zoom << 1) | key.closed,
+	  ::qHash(key.tags));
 }
 
 inline HASH_T qHash(const RasterTile::PointKey &key)
 {
-	return ::qHash(key.zoom) ^ ::qHash(key.tags);
+	return Hash::combine(key.zoom, ::qHash(key.tags));
 }
 
 }
@@ -5,11 +5,16 @@
 #include <QImageReader>
 #include <QPainter>
 #include <QtMath>
+#include <QDir>
+#include <QDateTime>
+#include <QCryptographicHash>
 #include "common/programpaths.h"
 #include "style.h"
 
 using namespace Mapsforge;
 
+#define CACHE_SIZE 8192
+
 static QString resourcePath(const QString &src, const QString &dir)
 {
 	QUrl url(src);
@@ -19,9 +24,45 @@ static QString resourcePath(const QString &src, const QString &dir)
 		return dir + "/" + url.toLocalFile();
 }
 
+#define SOURCE_KEY "Source"
+
+/* The rasterized SVG symbols are cached on disk, keyed by the symbol
+   parameters (not the SVG size), so the theme loading skips both the SVG
+   parsing and rendering on cache hits. */
+static QString cacheFile(const QFileInfo &fi, int width, int height,
+  int percent, qreal ratio)
+{
+	QByteArray hash(QCryptographicHash::hash(fi.absoluteFilePath().toUtf8()
+	  + '\0' + QByteArray::number(width) + 'x' + QByteArray::number(height)
+	  + '@' + QByteArray::number(percent) + '/' + QByteArray::number(ratio),
+	  QCryptographicHash::Sha1));
+
+	return QDir(ProgramPaths::symbolCacheDir()).filePath(
+	  QString::fromLatin1(hash.toHex()) + ".png");
+}
+
+static QString source(const QFileInfo &fi)
+{
+	return QString::number(fi.size()) + ":"
+	  + QString::number(fi.lastModified().toMSecsSinceEpoch());
+}
+
 static QImage image(const QString &path, int width, int height, int percent,
   qreal ratio)
 {
+	QFileInfo fi(path);
+	QString file(cacheFile(fi, width, height, percent, ratio));
+	QString src(source(fi));
+	QImage img;
+
+	/* Draw the symbols in the premultiplied format, other formats are
+	   converted on every drawImage() */
+	if (img.load(file, "PNG") && img.text(SOURCE_KEY) == src) {
+		img = img.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+		img.setDevicePixelRatio(ratio);
+		return img;
+	}
+
 	QImageReader ir(path, "svg");
 
 	if (ir.canRead()) {
@@ -41,11 +82,22 @@ static QImage image(const QString &path, int width, int height, int percent,
 		}
 
 		ir.setScaledSize(QSize(width * ratio, height * ratio));
-		QImage img(ir.read());
+		img = ir.read();
+		if (img.isNull())
+			return img;
+
+		img.setText(SOURCE_KEY, src);
+		if (QDir().mkpath(ProgramPaths::symbolCacheDir())
+		  && !img.save(file, "PNG"))
+			qWarning("%s: error writing symbol cache file",
+			  qUtf8Printable(file));
+
+		img = img.convertToFormat(QImage::Format_ARGB32_Premultiplied);
 		img.setDevicePixelRatio(ratio);
 		return img;
 	} else
-		return QImage(path);
+		return QImage(path).convertToFormat(
+		  QImage::Format_ARGB32_Premultiplied);
 }
 
 static QList<unsigned> keyList(const MapData &data, const QList<QByteArray> &in)
@@ -865,6 +917,8 @@ bool Style::loadXml(const QString &path, const MapData &data, qreal ratio,
 }
 
 Style::Style(const QString &path, const MapData &data, qreal ratio, int layer)
+  : _anyKey(false), _pathCache(CACHE_SIZE), _circleCache(CACHE_SIZE),
+  _pointCache(CACHE_SIZE)
 {
 	if (!loadXml(path, data, ratio, layer)) {
 		_paths = QList<PathRender>();
@@ -881,32 +935,148 @@ Style::Style(const QString &path, const MapData &data, qreal ratio, int layer)
 		std::stable_sort(_labels.begin(), _labels.end());
 		std::stable_sort(_pathLabels.begin(), _pathLabels.end());
 	}
+
+	for (int i = 0; i < _paths.size(); i++)
+		indexRule(_paths.at(i).rule());
+	for (int i = 0; i < _circles.size(); i++)
+		indexRule(_circles.at(i).rule());
+	for (int i = 0; i < _labels.size(); i++)
+		indexRule(_labels.at(i).rule());
+	for (int i = 0; i < _symbols.size(); i++)
+		indexRule(_symbols.at(i).rule());
+}
+
+void Style::indexRule(const Rule &rule)
+{
+	for (int i = 0; i < rule._filters.size(); i++) {
+		const Rule::Filter &filter = rule._filters.at(i);
+
+		for (int j = 0; j < filter._keys.size(); j++) {
+			unsigned key = filter._keys.at(j);
+			if (key)
+				_tagKeys.insert(key);
+			else
+				_anyKey = true;
+		}
+		for (int j = 0; j < filter._vals.size(); j++) {
+			const QByteArray &val = filter._vals.at(j);
+			if (!val.isEmpty())
+				_tagValues.insert(val);
+		}
+	}
+}
+
+/* The tags that can affect the rules matching. Dropping the other tags (names,
+   refs, ...) makes most of the features share a few tag sets. */
+QVector<MapData::Tag> Style::ruleTags(const QVector<MapData::Tag> &tags) const
+{
+	if (_anyKey)
+		return tags;
+
+	QVector<MapData::Tag> rt;
+	rt.reserve(tags.size());
+
+	for (int i = 0; i < tags.size(); i++) {
+		const MapData::Tag &tag = tags.at(i);
+		if (_tagKeys.contains(tag.key) || _tagValues.contains(tag.value))
+			rt.append(tag);
+	}
+
+	return rt;
 }
 
 QList<const Style::PathRender *> Style::paths(int zoom, bool closed,
   const QVector<MapData::Tag> &tags) const
 {
+	Key key(zoom, closed, ruleTags(tags));
+
+	_lock.lock();
+	QList<const PathRender*> *cached = _pathCache.object(key);
+	if (cached) {
+		QList<const PathRender*> ri(*cached);
+		_lock.unlock();
+		return ri;
+	}
+	_lock.unlock();
+
 	QList<const PathRender*> ri;
 
 	for (int i = 0; i < _paths.size(); i++)
-		if (_paths.at(i).rule().match(zoom, closed, tags))
+		if (_paths.at(i).rule().match(zoom, closed, key.tags))
 			ri.append(&_paths.at(i));
 
+	_lock.lock();
+	_pathCache.insert(key, new QList<const PathRender*>(ri));
+	_lock.unlock();
+
 	return ri;
 }
 
 QList<const Style::CircleRender *> Style::circles(int zoom,
   const QVector<MapData::Tag> &tags) const
 {
+	Key key(zoom, false, ruleTags(tags));
+
+	_lock.lock();
+	QList<const CircleRender*> *cached = _circleCache.object(key);
+	if (cached) {
+		QList<const CircleRender*> ri(*cached);
+		_lock.unlock();
+		return ri;
+	}
+	_lock.unlock();
+
 	QList<const CircleRender*> ri;
 
 	for (int i = 0; i < _circles.size(); i++)
-		if (_circles.at(i).rule().match(zoom, tags))
+		if (_circles.at(i).rule().match(zoom, key.tags))
 			ri.append(&_circles.at(i));
 
+	_lock.lock();
+	_circleCache.insert(key, new QList<const CircleRender*>(ri));
+	_lock.unlock();
+
 	return ri;
 }
 
+Style::PointRender Style::points(int zoom, bool path,
+  const QVector<MapData::Tag> &tags) const
+{
+	Key key(zoom, path, ruleTags(tags));
+
+	_lock.lock();
+	PointRender *cached = _pointCache.object(key);
+	if (cached) {
+		PointRender pr(*cached);
+		_lock.unlock();
+		return pr;
+	}
+	_lock.unlock();
+
+	PointRender pr;
+
+	for (int i = 0; i < _symbols.size(); i++) {
+		const Symbol &symbol = _symbols.at(i);
+		if (symbol.rule()._zooms.contains(zoom)
+		  && symbol.rule().match(path, key.tags)) {
+			pr.symbol = &symbol;
+			break;
+		}
+	}
+	for (int i = 0; i < _labels.size(); i++) {
+		const TextRender &label = _labels.at(i);
+		if (label.rule()._zooms.contains(zoom)
+		  && label.rule().match(path, key.tags))
+			pr.labels.append(&label);
+	}
+
+	_lock.lock();
+	_pointCache.insert(key, new PointRender(pr));
+	_lock.unlock();
+
+	return pr;
+}
+
 const Style::HillShadingRender *Style::hillShading(int zoom) const
 {
 	return (_hillShading.isValid() && _hillShading.rule()._zooms.contains(zoom))
@@ -924,19 +1094,6 @@ QList<const Style::TextRender*> Style::pathLabels(int zoom) const
 	return list;
 }
 
-QList<const Style::TextRender*> Style::labels(int zoom) const
-{
-	QList<const TextRender*> list;
-
-	for (int i = 0; i < _labels.size(); i++) {
-		const TextRender &label= _labels.at(i);
-		if (label.rule()._zooms.contains(zoom))
-			list.append(&label);
-	}
-
-	return list;
-}
-
 QList<const Style::Symbol*> Style::lineSymbols(int zoom) const
 {
 	QList<const Symbol*> list;
@@ -950,19 +1107,6 @@ QList<const Style::Symbol*> Style::lineSymbols(int zoom) const
 	return list;
 }
 
-QList<const Style::Symbol*> Style::symbols(int zoom) const
-{
-	QList<const Symbol*> list;
-
-	for (int i = 0; i < _symbols.size(); i++) {
-		const Symbol &symbol = _symbols.at(i);
-		if (symbol.rule()._zooms.contains(zoom))
-			list.append(&symbol);
-	}
-
-	return list;
-}
-
 QPen Style::PathRender::pen(int zoom) const
 {
 	if (!_img.isNull() || _strokeColor.isValid()) {
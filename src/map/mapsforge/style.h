@@ -5,6 +5,9 @@
 #include <QList>
 #include <QPen>
 #include <QFont>
+#include <QSet>
+#include <QCache>
+#include <QMutex>
 #include "mapdata.h"
 
 class QXmlStreamReader;
@@ -85,6 +88,8 @@ public:
 				return false;
 			}
 
+			friend class Style;
+
 			QList<unsigned> _keys;
 			QList<QByteArray> _vals;
 			bool _neg, _excl;
@@ -165,6 +170,7 @@ public:
 		qreal dy(int zoom) const;
 		const QImage &img() const {return _img;}
 		bool bitmapLine() const {return !_img.isNull() && _strokeWidth == 0;}
+		bool dashed() const {return !_strokeDasharray.isEmpty();}
 
 	private:
 		friend class Style;
@@ -260,16 +266,23 @@ public:
 		QImage _img;
 	};
 
+	struct PointRender {
+		PointRender() : symbol(0) {}
+
+		const Symbol *symbol;
+		QList<const TextRender*> labels;
+	};
+
 	Style(const QString &path, const MapData &data, qreal ratio, int layer);
 
 	QList<const PathRender *> paths(int zoom, bool closed,
 	  const QVector<MapData::Tag> &tags) const;
 	QList<const CircleRender *> circles(int zoom,
 	  const QVector<MapData::Tag> &tags) const;
+	PointRender points(int zoom, bool path,
+	  const QVector<MapData::Tag> &tags) const;
 	QList<const TextRender*> pathLabels(int zoom) const;
-	QList<const TextRender*> labels(int zoom) const;
 	QList<const TextRender*> areaLabels(int zoom) const;
-	QList<const Symbol*> symbols(int zoom) const;
 	QList<const Symbol*> areaSymbols(int zoom) const;
 	QList<const Symbol*> lineSymbols(int zoom) const;
 	const HillShadingRender *hillShading(int zoom) const;
@@ -328,6 +341,22 @@ private:
 		QList<Layer> _layers;
 	};
 
+	struct Key {
+		Key(int zoom, bool flag, const QVector<MapData::Tag> &tags)
+		  : zoom(zoom), flag(flag), tags(tags) {}
+		bool operator==(const Key &other) const
+		{
+			return zoom == other.zoom && flag == other.flag
+			  && tags == other.tags;
+		}
+
+		int zoom;
+		bool flag;
+		QVector<MapData::Tag> tags;
+	};
+
+	friend HASH_T qHash(const Style::Key &key);
+
 	HillShadingRender _hillShading;
 	QList<PathRender> _paths;
 	QList<CircleRender> _circles;
@@ -335,6 +364,19 @@ private:
 	QList<Symbol> _symbols, _lineSymbols;
 	Menu _menu;
 
+	/* Tag keys/values used by the rules and the shared rule matching
+	   results of the unique (rule relevant) tag sets */
+	QSet<unsigned> _tagKeys;
+	QSet<QByteArray> _tagValues;
+	bool _anyKey;
+	mutable QCache<Key, QList<const PathRender*> > _pathCache;
+	mutable QCache<Key, QList<const CircleRender*> > _circleCache;
+	mutable QCache<Key, PointRender> _pointCache;
+	mutable QMutex _lock;
+
+	void indexRule(const Rule &rule);
+	QVector<MapData::Tag> ruleTags(const QVector<MapData::Tag> &tags) const;
+
 	bool loadXml(const QString &path, const MapData &data, qreal ratio,
 	  int layer);
 	void rendertheme(QXmlStreamReader &reader, const QString &dir,
@@ -359,6 +401,12 @@ private:
 	  const Rule &rule, bool line);
 };
 
+inline HASH_T qHash(const Style::Key &key)
+{
+	return Hash::combine(((quint64)key.zoom << 1) | key.flag,
+	  ::qHash(key.tags));
+}
+
 }
 
 #endif // MAPSFORGE_STYLE_H
@@ -9,6 +9,16 @@ bool SubFile::seek(quint64 pos)
 {
 	Q_ASSERT(pos < _size);
 
+	if (_mapped) {
+		if (pos >= _size)
+			return false;
+
+		_blockPos = pos;
+		_pos = pos;
+
+		return true;
+	}
+
 	int blockNum = pos >> BLOCK_BITS;
 
 	if (_blockNum != blockNum) {
@@ -16,7 +26,7 @@ bool SubFile::seek(quint64 pos)
 
 		if (seek >= _offset + _size || !_file.seek(seek))
 			return false;
-		if (_file.read((char*)_data, sizeof(_data)) < 0)
+		if (_file.read((char*)_block, sizeof(_block)) < 0)
 			return false;
 		_blockNum = blockNum;
 	}
@@ -30,7 +40,7 @@ bool SubFile::seek(quint64 pos)
 bool SubFile::read(char *buff, quint32 size)
 {
 	while (size) {
-		quint32 remaining = sizeof(_data) - _blockPos;
+		qint64 remaining = _blockSize - _blockPos;
 		if (size < remaining) {
 			memcpy(buff, _data + _blockPos, size);
 			_blockPos += size;
@@ -10,9 +10,12 @@ namespace Mapsforge {
 class SubFile
 {
 public:
-	SubFile(QFile &file, quint64 offset, quint64 size)
-	  : _file(file), _offset(offset), _size(size), _pos(-1),
-	  _blockNum(-1), _blockPos(-1) {}
+	/* If the file is memory mapped, the whole subfile is read directly from
+	   the mapped memory as a single block. */
+	SubFile(QFile &file, quint64 offset, quint64 size, const uchar *map = 0)
+	  : _file(file), _data(map ? map + offset : _block),
+	  _blockSize(map ? size : sizeof(_block)), _mapped(map != 0),
+	  _offset(offset), _size(size), _pos(-1), _blockNum(-1), _blockPos(-1) {}
 
 	quint64 pos() const {return _pos;}
 	bool seek(quint64 pos);
@@ -23,7 +26,7 @@ public:
 	{
 		val = _data[_blockPos++];
 		_pos++;
-		return (_blockPos >= (int)sizeof(_data)) ? seek(_pos) : true;
+		return (_blockPos >= _blockSize) ? seek(_pos) : true;
 	}
 
 	template<typename T>
@@ -117,12 +120,15 @@ public:
 
 private:
 	QFile &_file;
-	quint8 _data[1U<<BLOCK_BITS];
+	quint8 _block[1U<<BLOCK_BITS];
+	const quint8 *_data;
+	qint64 _blockSize;
+	bool _mapped;
 	quint64 _offset;
 	quint64 _size;
 	qint64 _pos;
 	int _blockNum;
-	int _blockPos;
+	qint64 _blockPos;
 };
 
 }
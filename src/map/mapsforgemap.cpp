@@ -1,29 +1,52 @@
 #include <QPainter>
-#include <QPixmapCache>
 #include <QDir>
+#include <QDateTime>
 #include "common/wgs84.h"
 #include "common/util.h"
 #include "common/programpaths.h"
 #include "rectd.h"
 #include "pcs.h"
+#include "tileorder.h"
 #include "mapsforgemap.h"
 
 
 using namespace Mapsforge;
 
 #define EPSILON     1e-6
+#define STYLES      3
 
-MapsforgeMap::MapsforgeMap(const QString &fileName, QObject *parent)
-  : Map(fileName, parent), _data(fileName), _style(0), _zoom(0),
-  _projection(PCS::pcs(3857)), _tileRatio(1.0)
+MapsforgeMap::MapsforgeMap(const QString &path, const QStringList &files,
+  QObject *parent) : Map(path, parent), _tileSize(0), _style(0),
+  _styles(STYLES), _zoom(0), _projection(PCS::pcs(3857)), _tileRatio(1.0),
+  _prefetch(0), _valid(false)
 {
-	if (_data.isValid())
-		_zoom = _data.zooms().min();
+	for (int i = 0; i < files.size(); i++) {
+		MapData *data = new MapData(files.at(i), &_keys);
+		_data.append(data);
+
+		if (!data->isValid()) {
+			_errorString = (files.size() > 1)
+			  ? files.at(i) + ": " + data->errorString()
+			  : data->errorString();
+			return;
+		}
+		if (i && data->tileSize() != _tileSize) {
+			_errorString = files.at(i) + ": tile size mismatch";
+			return;
+		}
+
+		_llBounds |= data->bounds();
+		_zooms |= data->zooms();
+		_tileSize = data->tileSize();
+	}
+
+	_zoom = _zooms.min();
+	_valid = true;
 }
 
 MapsforgeMap::~MapsforgeMap()
 {
-	delete _style;
+	qDeleteAll(_data);
 }
 
 void MapsforgeMap::load(const Projection &in, const Projection &out,
@@ -35,33 +58,52 @@ void MapsforgeMap::load(const Projection &in, const Projection &out,
 	_tileRatio = deviceRatio;
 	_projection = out;
 
-	_data.load();
+	for (int i = 0; i < _data.size(); i++)
+		_data.at(i)->load();
 
 	if (style < 0 || style >= styles().size())
 		style = 0;
-	_style = new Style(styles().at(style), _data, _tileRatio, layer);
+	const QString &path = styles().at(style);
+	QString key(path + "\n" + QString::number(QFileInfo(path).lastModified()
+	  .toMSecsSinceEpoch()) + "\n" + QString::number(_tileRatio) + "\n"
+	  + QString::number(layer));
+	_style = _styles.object(key);
+	if (!_style) {
+		/* All the map data share the same tag keys table */
+		_style = new Style(path, *_data.first(), _tileRatio, layer);
+		_styles.insert(key, _style);
+	}
 
 	updateTransform();
 
-	QPixmapCache::clear();
+	_tileCache.setVariant(TileCache::variant(style, layer));
 }
 
 void MapsforgeMap::unload()
 {
 	cancelJobs(true);
+	_tileCache.clear();
 
-	_data.clear();
-	delete _style;
+	for (int i = 0; i < _data.size(); i++)
+		_data.at(i)->clear();
 	_style = 0;
 }
 
+void MapsforgeMap::restyle(const Projection &in, const Projection &out,
+  qreal deviceRatio, bool hidpi, int style, int layer)
+{
+	/* Keep the tiles of the current style for a quick switch back */
+	_tileCache.keep();
+	Map::restyle(in, out, deviceRatio, hidpi, style, layer);
+}
+
 int MapsforgeMap::zoomFit(const QSize &size, const RectC &rect)
 {
 	if (rect.isValid()) {
 		RectD pr(rect, _projection, 10);
 
-		_zoom = _data.zooms().min();
-		for (int i = _data.zooms().min() + 1; i <= _data.zooms().max(); i++) {
+		_zoom = _zooms.min();
+		for (int i = _zooms.min() + 1; i <= _zooms.max(); i++) {
 			Transform t(transform(i));
 			QRectF r(t.proj2img(pr.topLeft()), t.proj2img(pr.bottomRight()));
 			if (size.width() + EPSILON < r.width()
@@ -70,7 +112,7 @@ int MapsforgeMap::zoomFit(const QSize &size, const RectC &rect)
 			_zoom = i;
 		}
 	} else
-		_zoom = _data.zooms().max();
+		_zoom = _zooms.max();
 
 	updateTransform();
 
@@ -81,7 +123,7 @@ int MapsforgeMap::zoomIn()
 {
 	cancelJobs(false);
 
-	_zoom = qMin(_zoom + 1, _data.zooms().max());
+	_zoom = qMin(_zoom + 1, _zooms.max());
 	updateTransform();
 	return _zoom;
 }
@@ -90,7 +132,7 @@ int MapsforgeMap::zoomOut()
 {
 	cancelJobs(false);
 
-	_zoom = qMax(_zoom - 1, _data.zooms().min());
+	_zoom = qMax(_zoom - 1, _zooms.min());
 	updateTransform();
 	return _zoom;
 }
@@ -103,11 +145,11 @@ void MapsforgeMap::setZoom(int zoom)
 
 Transform MapsforgeMap::transform(int zoom) const
 {
-	int z = zoom + Util::log2i(_data.tileSize());
+	int z = zoom + Util::log2i(_tileSize);
 
 	double scale = _projection.isGeographic()
 	  ? 360.0 / (1<<z) : (2.0 * M_PI * WGS84_RADIUS) / (1<<z);
-	PointD topLeft(_projection.ll2xy(_data.bounds().topLeft()));
+	PointD topLeft(_projection.ll2xy(_llBounds.topLeft()));
 	return Transform(ReferencePoint(PointD(0, 0), topLeft),
 	  PointD(scale, scale));
 }
@@ -116,36 +158,26 @@ void MapsforgeMap::updateTransform()
 {
 	_transform = transform(_zoom);
 
-	RectD prect(_data.bounds(), _projection);
+	RectD prect(_llBounds, _projection);
 	_bounds = QRectF(_transform.proj2img(prect.topLeft()),
 	  _transform.proj2img(prect.bottomRight()));
 	// Adjust the bounds of world maps to avoid problems with wrapping
-	if (_data.bounds().left() <= -180.0 || _data.bounds().right() >= 180.0)
+	if (_llBounds.left() <= -180.0 || _llBounds.right() >= 180.0)
 		_bounds.adjust(0.5, 0, -0.5, 0);
 }
 
-QString MapsforgeMap::key(int zoom, const QPoint &xy) const
+quint64 MapsforgeMap::key(int zoom, const QPoint &xy) const
 {
-	return path() + "-" + QString::number(zoom) + "_"
-	  + QString::number(xy.x()) + "_" + QString::number(xy.y());
-}
-
-bool MapsforgeMap::isRunning(int zoom, const QPoint &xy) const
-{
-	for (int i = 0; i < _jobs.size(); i++) {
-		const QList<Mapsforge::RasterTile> &tiles = _jobs.at(i)->tiles();
-		for (int j = 0; j < tiles.size(); j++) {
-			const Mapsforge::RasterTile &mt = tiles.at(j);
-			if (mt.zoom() == zoom && mt.xy() == xy)
-				return true;
-		}
-	}
-
-	return false;
+	return TileCache::key(zoom, QPoint(xy.x() / _tileSize,
+	  xy.y() / _tileSize));
 }
 
 void MapsforgeMap::runJob(MapsforgeMapJob *job)
 {
+	const QList<Mapsforge::RasterTile> &tiles = job->tiles();
+	for (int i = 0; i < tiles.size(); i++)
+		_running.insert(key(tiles.at(i).zoom(), tiles.at(i).xy()));
+
 	_jobs.append(job);
 
 	connect(job, &MapsforgeMapJob::finished, this, &MapsforgeMap::jobFinished);
@@ -154,7 +186,13 @@ void MapsforgeMap::runJob(MapsforgeMapJob *job)
 
 void MapsforgeMap::removeJob(MapsforgeMapJob *job)
 {
+	const QList<Mapsforge::RasterTile> &tiles = job->tiles();
+	for (int i = 0; i < tiles.size(); i++)
+		_running.remove(key(tiles.at(i).zoom(), tiles.at(i).xy()));
+
 	_jobs.removeOne(job);
+	if (job == _prefetch)
+		_prefetch = 0;
 	job->deleteLater();
 }
 
@@ -165,7 +203,8 @@ void MapsforgeMap::jobFinished(MapsforgeMapJob *job)
 	for (int i = 0; i < tiles.size(); i++) {
 		const Mapsforge::RasterTile &mt = tiles.at(i);
 		if (!mt.pixmap().isNull())
-			QPixmapCache::insert(key(mt.zoom(), mt.xy()), mt.pixmap());
+			_tileCache.insert(key(mt.zoom(), mt.xy()), mt.pixmap(),
+			  mt.isDraft());
 	}
 
 	removeJob(job);
@@ -179,9 +218,14 @@ void MapsforgeMap::cancelJobs(bool wait)
 		_jobs.at(i)->cancel(wait);
 }
 
-void MapsforgeMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
+/* Draws the cached tiles (if painter is set) and returns the missing ones.
+   The missing tiles are drawn using the cached tiles of the other zooms
+   until they are rendered (except when blocking). */
+QList<RasterTile> MapsforgeMap::tiles(QPainter *painter, int zoom,
+  const Transform &transform, const QRectF &rect, Flags flags)
 {
-	int tileSize = _data.tileSize();
+	bool fallback = painter && !(flags & Map::Block);
+	int tileSize = _tileSize;
 	QPointF tl(floor(rect.left() / tileSize) * tileSize,
 	  floor(rect.top() / tileSize) * tileSize);
 	QSizeF s(rect.right() - tl.x(), rect.bottom() - tl.y());
@@ -193,36 +237,89 @@ void MapsforgeMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 	for (int i = 0; i < width; i++) {
 		for (int j = 0; j < height; j++) {
 			QPoint ttl(tl.x() + i * tileSize, tl.y() + j * tileSize);
-			if (isRunning(_zoom, ttl))
+			QRect tr(ttl, QSize(tileSize, tileSize));
+			if (isRunning(zoom, ttl)) {
+				if (fallback)
+					_tileCache.drawFallback(painter, zoom, ttl / tileSize, tr,
+					  _zooms);
 				continue;
+			}
 
 			QPixmap pm;
-			if (QPixmapCache::find(key(_zoom, ttl), &pm))
-				painter->drawPixmap(ttl, pm);
-			else {
-				tiles.append(RasterTile(_projection, _transform, _style, &_data,
-				  _zoom, QRect(ttl, QSize(tileSize, tileSize)), _tileRatio,
-				  flags & Map::HillShading));
+			if (_tileCache.find(key(zoom, ttl), &pm)) {
+				if (painter)
+					painter->drawPixmap(ttl, pm);
+			} else {
+				if (fallback)
+					_tileCache.drawFallback(painter, zoom, ttl / tileSize, tr,
+					  _zooms);
+
+				/* Only the hill shading makes a difference in the draft
+				   mode, the drafts are refined once the interaction ends */
+				bool hs = flags & Map::HillShading && _style->hasHillShading();
+				bool draft = hs && flags & Map::Draft;
+				if (draft && _tileCache.isDraft(key(zoom, ttl)))
+					continue;
+
+				RasterTile tile(_projection, transform, _style, _data, zoom, tr,
+				  _tileRatio, hs && !draft);
+				tile.setDraft(draft);
+				tiles.append(tile);
 			}
 		}
 	}
 
+	std::sort(tiles.begin(), tiles.end(), TileOrder<RasterTile>(rect.center()
+	  - QPointF(tileSize / 2, tileSize / 2)));
+
+	return tiles;
+}
+
+void MapsforgeMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
+{
+	if (_prefetch)
+		_prefetch->cancel(false);
+
+	QList<RasterTile> tiles(this->tiles(painter, _zoom, _transform, rect,
+	  flags));
+
 	if (!tiles.isEmpty()) {
 		if (flags & Map::Block) {
-			QFuture<void> future = QtConcurrent::map(tiles, &RasterTile::render);
+			QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+			  tiles, &RasterTile::render);
 			future.waitForFinished();
 
 			for (int i = 0; i < tiles.size(); i++) {
 				const RasterTile &mt = tiles.at(i);
 				const QPixmap &pm = mt.pixmap();
 				painter->drawPixmap(mt.xy(), pm);
-				QPixmapCache::insert(key(mt.zoom(), mt.xy()), pm);
+				_tileCache.insert(key(mt.zoom(), mt.xy()), pm);
 			}
 		} else
 			runJob(new MapsforgeMapJob(tiles));
 	}
 }
 
+void MapsforgeMap::prefetch(const QRectF &rect, Flags flags)
+{
+	/* Only when idle, i.e. all the visible tiles are rendered */
+	if (!_jobs.isEmpty())
+		return;
+
+	QList<RasterTile> tiles;
+	for (int dz = 1; dz >= -1; dz -= 2) {
+		int z = _zoom + dz;
+		QRectF zr(zoomRect(rect, _bounds, dz));
+		if (_zooms.contains(z) && !zr.isEmpty())
+			tiles.append(this->tiles(0, z, transform(z), zr, flags));
+	}
+
+	if (!tiles.isEmpty()) {
+		_prefetch = new MapsforgeMapJob(tiles);
+		runJob(_prefetch);
+	}
+}
+
 QStringList MapsforgeMap::styles(int &defaultStyle) const
 {
 	QStringList list;
@@ -251,10 +348,30 @@ Map *MapsforgeMap::create(const QString &path, const Projection &proj,
 {
 	Q_UNUSED(proj);
 
-	if (isMap)
+	/* When loading a map directory, all the Mapsforge maps in the directory
+	   are merged into a single map */
+	if (isMap) {
+		QFileInfo fi(path);
+		QDir dir(fi.absolutePath());
+		QFileInfoList fl(dir.entryInfoList(QStringList("*.map"), QDir::Files));
+
 		*isMap = false;
 
-	return new MapsforgeMap(path);
+		if (fl.size() > 1) {
+			QStringList files;
+			for (int i = 0; i < fl.size(); i++)
+				files.append(fl.at(i).absoluteFilePath());
+
+			MapsforgeMap *map = new MapsforgeMap(dir.absolutePath(), files);
+			if (map->isValid()) {
+				*isMap = true;
+				return map;
+			} else
+				delete map;
+		}
+	}
+
+	return new MapsforgeMap(path, QStringList(path));
 }
 
 MapsforgeMap::StyleList::StyleList()
@@ -1,12 +1,16 @@
 #ifndef MAPSFORGEMAP_H
 #define MAPSFORGEMAP_H
 
-#include <QtConcurrent>
+#include <QSet>
+#include <QCache>
+#include "common/threadpools.h"
+#include "common/trace.h"
 #include "mapsforge/mapdata.h"
 #include "mapsforge/rastertile.h"
 #include "projection.h"
 #include "transform.h"
 #include "map.h"
+#include "tilecache.h"
 
 
 class MapsforgeMapJob : public QObject
@@ -15,17 +19,26 @@ class MapsforgeMapJob : public QObject
 
 public:
 	MapsforgeMapJob(const QList<Mapsforge::RasterTile> &tiles)
-	  : _tiles(tiles) {}
+	  : _tiles(tiles)
+	{
+		for (int i = 0; i < _tiles.size(); i++)
+			_tiles[i].setCancelFlag(&_cancel);
+	}
 
 	void run()
 	{
+		_trace.start();
 		connect(&_watcher, &QFutureWatcher<void>::finished, this,
 		  &MapsforgeMapJob::handleFinished);
-		_future = QtConcurrent::map(_tiles, &Mapsforge::RasterTile::render);
+		_future = ThreadPools::map(ThreadPools::Render,
+		  _tiles, &Mapsforge::RasterTile::render);
 		_watcher.setFuture(_future);
 	}
 	void cancel(bool wait)
 	{
+		/* Stops also the already running tiles at their next fetch/draw
+		   phase boundary */
+		_cancel.storeRelease(1);
 		_future.cancel();
 		if (wait)
 			_future.waitForFinished();
@@ -36,12 +49,18 @@ signals:
 	void finished(MapsforgeMapJob *job);
 
 private slots:
-	void handleFinished() {emit finished(this);}
+	void handleFinished()
+	{
+		_trace.end("job", "MapsforgeMapJob");
+		emit finished(this);
+	}
 
 private:
 	QFutureWatcher<void> _watcher;
 	QFuture<void> _future;
+	Trace::Span _trace;
 	QList<Mapsforge::RasterTile> _tiles;
+	QAtomicInt _cancel;
 };
 
 class MapsforgeMap : public Map
@@ -49,11 +68,12 @@ class MapsforgeMap : public Map
 	Q_OBJECT
 
 public:
-	MapsforgeMap(const QString &fileName, QObject *parent = 0);
+	MapsforgeMap(const QString &path, const QStringList &files,
+	  QObject *parent = 0);
 	~MapsforgeMap();
 
 	QRectF bounds() {return _bounds;}
-	RectC llBounds() {return _data.bounds();}
+	RectC llBounds() {return _llBounds;}
 
 	int zoom() const {return _zoom;}
 	void setZoom(int zoom);
@@ -64,6 +84,8 @@ public:
 	void load(const Projection &in, const Projection &out, qreal deviceRatio,
 	  bool hidpi, int style, int layer);
 	void unload();
+	void restyle(const Projection &in, const Projection &out,
+	  qreal deviceRatio, bool hidpi, int style, int layer);
 
 	QPointF ll2xy(const Coordinates &c)
 	  {return _transform.proj2img(_projection.ll2xy(c));}
@@ -71,13 +93,14 @@ public:
 	  {return _projection.xy2ll(_transform.img2proj(p));}
 
 	void draw(QPainter *painter, const QRectF &rect, Flags flags);
+	void prefetch(const QRectF &rect, Flags flags);
 
 	QStringList styles(int &defaultStyle) const;
 	QStringList layers(const QString &lang, int &defaultLayer) const;
 	bool hillShading() const;
 
-	bool isValid() const {return _data.isValid();}
-	QString errorString() const {return _data.errorString();}
+	bool isValid() const {return _valid;}
+	QString errorString() const {return _errorString;}
 
 	static Map *create(const QString &path, const Projection &proj, bool *isMap);
 
@@ -91,18 +114,29 @@ private:
 		StyleList();
 	};
 
-	QString key(int zoom, const QPoint &xy) const;
+	quint64 key(int zoom, const QPoint &xy) const;
 	Transform transform(int zoom) const;
 	void updateTransform();
-	bool isRunning(int zoom, const QPoint &xy) const;
+	bool isRunning(int zoom, const QPoint &xy) const
+	  {return _running.contains(key(zoom, xy));}
 	void runJob(MapsforgeMapJob *job);
 	void removeJob(MapsforgeMapJob *job);
 	void cancelJobs(bool wait);
+	QList<Mapsforge::RasterTile> tiles(QPainter *painter, int zoom,
+	  const Transform &transform, const QRectF &rect, Flags flags);
 
 	static StyleList &styles();
 
-	Mapsforge::MapData _data;
+	QHash<QByteArray, unsigned> _keys;
+	QList<Mapsforge::MapData*> _data;
+	RectC _llBounds;
+	Range _zooms;
+	int _tileSize;
 	Mapsforge::Style *_style;
+	/* The parsed styles are bound to the map tag keys, so they are kept with
+	   the map (not only while it is loaded) to make the style/layer switches
+	   and the map reloads skip the style parsing */
+	QCache<QString, Mapsforge::Style> _styles;
 	int _zoom;
 
 	Projection _projection;
@@ -110,7 +144,13 @@ private:
 	QRectF _bounds;
 	qreal _tileRatio;
 
+	TileCache _tileCache;
 	QList<MapsforgeMapJob*> _jobs;
+	QSet<quint64> _running;
+	MapsforgeMapJob *_prefetch;
+
+	bool _valid;
+	QString _errorString;
 };
 
 #endif // MAPSFORGEMAP_H
@@ -3,6 +3,7 @@
 #include "onlinemap.h"
 #include "wmtsmap.h"
 #include "wmsmap.h"
+#include "pmtilesmap.h"
 #include "osm.h"
 #include "invalidmap.h"
 #include "mapsource.h"
@@ -148,6 +149,67 @@ void MapSource::tile(QXmlStreamReader &reader, Config &config)
 	}
 }
 
+static bool boolAttribute(QStringView value, bool *ok)
+{
+	if (value == QLatin1String("true")) {
+		*ok = true;
+		return true;
+	} else if (value == QLatin1String("false")) {
+		*ok = true;
+		return false;
+	} else {
+		*ok = false;
+		return false;
+	}
+}
+
+void MapSource::network(QXmlStreamReader &reader, Config &config)
+{
+	QXmlStreamAttributes attr = reader.attributes();
+	bool ok, val;
+
+	if (attr.hasAttribute("http2")) {
+		val = boolAttribute(attr.value("http2"), &ok);
+		if (!ok) {
+			reader.raiseError("Invalid network http2 value");
+			return;
+		} else
+			config.profile.setHttp2(val);
+	}
+	if (attr.hasAttribute("connections")) {
+		int connections = attr.value("connections").toString().toInt(&ok);
+		if (!ok || connections < 1) {
+			reader.raiseError("Invalid network connections value");
+			return;
+		} else
+			config.profile.setConnections(connections);
+	}
+	if (attr.hasAttribute("keepAlive")) {
+		val = boolAttribute(attr.value("keepAlive"), &ok);
+		if (!ok) {
+			reader.raiseError("Invalid network keepAlive value");
+			return;
+		} else
+			config.profile.setKeepAlive(val);
+	}
+	if (attr.hasAttribute("pipelining")) {
+		val = boolAttribute(attr.value("pipelining"), &ok);
+		if (!ok) {
+			reader.raiseError("Invalid network pipelining value");
+			return;
+		} else
+			config.profile.setPipelining(val);
+	}
+	if (attr.hasAttribute("compression")) {
+		val = boolAttribute(attr.value("compression"), &ok);
+		if (!ok) {
+			reader.raiseError("Invalid network compression value");
+			return;
+		} else
+			config.profile.setCompression(val);
+	}
+}
+
 void MapSource::map(QXmlStreamReader &reader, Config &config)
 {
 	const QXmlStreamAttributes &attr = reader.attributes();
@@ -161,6 +223,8 @@ void MapSource::map(QXmlStreamReader &reader, Config &config)
 		config.type = TMS;
 	else if (type == QLatin1String("QuadTiles"))
 		config.type = QuadTiles;
+	else if (type == QLatin1String("PMTiles"))
+		config.type = PMTiles;
 	else if (type == QLatin1String("OSM") || type.isEmpty())
 		config.type = OSM;
 	else {
@@ -217,6 +281,9 @@ void MapSource::map(QXmlStreamReader &reader, Config &config)
 		} else if (reader.name() == QLatin1String("tile")) {
 			tile(reader, config);
 			reader.skipCurrentElement();
+		} else if (reader.name() == QLatin1String("network")) {
+			network(reader, config);
+			reader.skipCurrentElement();
 		} else
 			reader.skipCurrentElement();
 	}
@@ -270,24 +337,27 @@ Map *MapSource::create(const QString &path, const Projection &proj, bool *isDir)
 			return new WMTSMap(path, config.name, WMTS::Setup(config.url,
 			  config.layer, config.set, config.style, config.format, config.rest,
 			  config.coordinateSystem, config.dimensions, config.headers),
-			  config.tileRatio);
+			  config.profile, config.tileRatio);
 		case WMS:
 			return new WMSMap(path, config.name, WMS::Setup(config.url,
 			  config.layer, config.style, config.format, config.crs,
 			  config.coordinateSystem, config.dimensions, config.headers),
-			  config.tileSize);
+			  config.profile, config.tileSize);
 		case TMS:
 			return new OnlineMap(path, config.name, config.url, config.zooms,
-			  config.bounds, config.tileRatio, config.headers,
+			  config.bounds, config.tileRatio, config.headers, config.profile,
 			  config.tileSize, config.mvt, true, false, config.layers);
 		case OSM:
 			return new OnlineMap(path, config.name, config.url, config.zooms,
-			 config.bounds, config.tileRatio, config.headers,
+			 config.bounds, config.tileRatio, config.headers, config.profile,
 			 config.tileSize, config.mvt, false, false, config.layers);
 		case QuadTiles:
 			return new OnlineMap(path, config.name, config.url, config.zooms,
-			 config.bounds, config.tileRatio, config.headers,
+			 config.bounds, config.tileRatio, config.headers, config.profile,
 			 config.tileSize, config.mvt, false, true, config.layers);
+		case PMTiles:
+			return new PMTilesMap(path, config.name, QUrl(config.url),
+			  config.headers, config.profile);
 		default:
 			return new InvalidMap(path, "Invalid map type");
 	}
@@ -23,7 +23,8 @@ private:
 		WMTS,
 		WMS,
 		TMS,
-		QuadTiles
+		QuadTiles,
+		PMTiles
 	};
 
 	struct Config {
@@ -41,6 +42,7 @@ private:
 		bool rest;
 		QList<KV<QString, QString> > dimensions;
 		QList<HTTPHeader> headers;
+		NetworkProfile profile;
 		qreal tileRatio;
 		int tileSize;
 		bool mvt;
@@ -53,6 +55,7 @@ private:
 	static Range zooms(QXmlStreamReader &reader);
 	static void map(QXmlStreamReader &reader, Config &config);
 	static void tile(QXmlStreamReader &reader, Config &config);
+	static void network(QXmlStreamReader &reader, Config &config);
 };
 
 #endif // MAPSOURCE_H
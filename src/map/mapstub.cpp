@@ -0,0 +1,36 @@
+#include <QFileInfo>
+#include "maplist.h"
+#include "mapstub.h"
+
+/* Whether the stub data can still be used (the real map has not been created
+   yet and the map file has not changed) */
+bool MapStub::upToDate() const
+{
+	if (_map)
+		return false;
+
+	QFileInfo fi(path());
+	return (fi.size() == _size
+	  && fi.lastModified().toMSecsSinceEpoch() == _time);
+}
+
+Map *MapStub::map() const
+{
+	if (!_map) {
+		MapStub *stub = const_cast<MapStub*>(this);
+
+		_map = MapList::loadFile(path(), _proj, _format, _parser,
+		  _isDir);
+		_map->setParent(stub);
+		connect(_map, &Map::tilesLoaded, stub, &Map::tilesLoaded);
+		connect(_map, &Map::mapLoaded, stub, &Map::mapLoaded);
+
+		/* The map list cache said the map is valid, but the file may have
+		   been modified or broken since */
+		if (!_map->isValid())
+			qWarning("%s: %s", qUtf8Printable(path()),
+			  qUtf8Printable(_map->errorString()));
+	}
+
+	return _map;
+}
@@ -0,0 +1,89 @@
+#ifndef MAPSTUB_H
+#define MAPSTUB_H
+
+#include "projection.h"
+#include "map.h"
+
+/* Placeholder of a map from a scanned map directory. Only the map name and
+   bounds are known (from the map list cache), the real map is created on the
+   first use of anything else and all the calls are forwarded to it. When the
+   map file has changed since it was cached (size/modification time), the
+   real map is created right away on the validity checks. */
+class MapStub : public Map
+{
+	Q_OBJECT
+
+public:
+	MapStub(const QString &path, qint64 size, qint64 time, const QString &name,
+	  const RectC &llBounds, const QString &format, int parser, bool isDir,
+	  const Projection &proj, QObject *parent = 0) : Map(path, parent),
+	  _size(size), _time(time), _name(name), _llBounds(llBounds),
+	  _format(format), _parser(parser), _isDir(isDir), _proj(proj), _map(0) {}
+
+	QString name() const {return _map ? _map->name() : _name;}
+
+	bool isValid() const {return upToDate() ? true : map()->isValid();}
+	bool isReady() const {return upToDate() ? true : map()->isReady();}
+	QString errorString() const
+	  {return _map ? _map->errorString() : QString();}
+
+	void load(const Projection &in, const Projection &out, qreal deviceRatio,
+	  bool hidpi, int style, int layer)
+	  {map()->load(in, out, deviceRatio, hidpi, style, layer);}
+	void unload() {if (_map) _map->unload();}
+	void restyle(const Projection &in, const Projection &out,
+	  qreal deviceRatio, bool hidpi, int style, int layer)
+	  {map()->restyle(in, out, deviceRatio, hidpi, style, layer);}
+
+	RectC llBounds() {return _map ? _map->llBounds() : _llBounds;}
+	QRectF bounds() {return map()->bounds();}
+	qreal resolution(const QRectF &rect) {return map()->resolution(rect);}
+
+	int zoom() const {return map()->zoom();}
+	void setZoom(int zoom) {map()->setZoom(zoom);}
+	int zoomFit(const QSize &size, const RectC &rect)
+	  {return map()->zoomFit(size, rect);}
+	int zoomIn() {return map()->zoomIn();}
+	int zoomOut() {return map()->zoomOut();}
+
+	QPointF ll2xy(const Coordinates &c) {return map()->ll2xy(c);}
+	Coordinates xy2ll(const QPointF &p) {return map()->xy2ll(p);}
+	void ll2xy(const Coordinates *c, QPointF *p, int n)
+	  {map()->ll2xy(c, p, n);}
+
+	void draw(QPainter *painter, const QRectF &rect, Flags flags)
+	  {map()->draw(painter, rect, flags);}
+	void prefetch(const QRectF &rect, Flags flags)
+	  {if (_map) _map->prefetch(rect, flags);}
+
+	double elevation(const Coordinates &c) {return map()->elevation(c);}
+	MatrixD elevation(const MatrixC &m) {return map()->elevation(m);}
+
+	QStringList layers(const QString &lang, int &defaultLayer) const
+	  {return map()->layers(lang, defaultLayer);}
+	QStringList styles(int &defaultStyle) const
+	  {return map()->styles(defaultStyle);}
+	bool hillShading() const {return map()->hillShading();}
+
+	void clearCache() {map()->clearCache();}
+
+	Range seedZooms() const {return map()->seedZooms();}
+	TileSeeder *seeder(const QList<RectC> &rects, const Range &zooms)
+	  {return map()->seeder(rects, zooms);}
+
+private:
+	Map *map() const;
+	bool upToDate() const;
+
+	qint64 _size;
+	qint64 _time;
+	QString _name;
+	RectC _llBounds;
+	QString _format;
+	int _parser;
+	bool _isDir;
+	Projection _proj;
+	mutable Map *_map;
+};
+
+#endif // MAPSTUB_H
@@ -22,6 +22,7 @@ public:
 	T &at(int i, int j) {return _m[_w * i + j];}
 	T const &at(int i, int j) const {return _m.at(_w * i + j);}
 	T *row(int i) {return &_m[_w * i];}
+	const T *row(int i) const {return _m.constData() + _w * i;}
 
 	bool isNull() const {return (_h == 0 || _w == 0);}
 	int size() const {return _m.size();}
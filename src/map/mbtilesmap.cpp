@@ -3,13 +3,13 @@
 #include <QSqlField>
 #include <QSqlError>
 #include <QPainter>
-#include <QPixmapCache>
 #include "common/util.h"
 #include "osm.h"
 #include "metatype.h"
 #include "mbtilesmap.h"
 
-#define MAX_TILE_SIZE 4096
+#define MAX_TILE_SIZE   4096
+#define DATA_CACHE_SIZE 16384 /* KB */
 
 static RectC str2bounds(const QString &str)
 {
@@ -218,6 +218,8 @@ MBTilesMap::MBTilesMap(const QString &fileName, QObject *parent)
   : Map(fileName, parent), _style(0), _mapRatio(1.0), _tileRatio(1.0),
   _mvt(false), _scaledSize(0), _valid(false)
 {
+	_dataCache.setMaxCost(DATA_CACHE_SIZE);
+
 	if (!Util::isSQLiteDB(fileName, _errorString))
 		return;
 
@@ -259,6 +261,13 @@ MBTilesMap::MBTilesMap(const QString &fileName, QObject *parent)
 	_valid = true;
 }
 
+static void coverageKey(const QSqlQuery &query, int &zoom, QPoint &tile)
+{
+	zoom = query.value(0).toInt();
+	tile = QPoint(query.value(1).toInt(),
+	  (1<<zoom) - query.value(2).toInt() - 1);
+}
+
 void MBTilesMap::load(const Projection &in, const Projection &out,
   qreal deviceRatio, bool hidpi, int style, int layer)
 {
@@ -282,16 +291,30 @@ void MBTilesMap::load(const Projection &in, const Projection &out,
 			_zooms.append(Zoom(i, _zooms.last().base));
 		}
 
-		QPixmapCache::clear();
-	}
+		_tileCache.setVariant(TileCache::variant(_style, -1));
+	} else
+		_scaledSize = (_mapRatio > 1.0 || deviceRatio == _tileRatio)
+		  ? 0 : qRound(_tileSize * deviceRatio / _tileRatio);
 
-	_db.open();
+	_tiles.open(path(), "SELECT tile_data FROM tiles "
+	  "WHERE zoom_level=? AND tile_column=? AND tile_row=?");
+	_coverage.load(path(), "SELECT zoom_level, tile_column, tile_row "
+	  "FROM tiles", coverageKey);
 }
 
 void MBTilesMap::unload()
 {
 	cancelJobs(true);
-	_db.close();
+	_tiles.close();
+	_tileCache.clear();
+}
+
+void MBTilesMap::restyle(const Projection &in, const Projection &out,
+  qreal deviceRatio, bool hidpi, int style, int layer)
+{
+	/* Keep the tiles of the current style for a quick switch back */
+	_tileCache.keep();
+	Map::restyle(in, out, deviceRatio, hidpi, style, layer);
 }
 
 QRectF MBTilesMap::bounds()
@@ -348,7 +371,12 @@ qreal MBTilesMap::coordinatesRatio() const
 
 qreal MBTilesMap::imageRatio() const
 {
-	return _mapRatio > 1.0 ? _mapRatio : _tileRatio;
+	if (_mapRatio > 1.0)
+		return _mapRatio;
+	if (_scaledSize && !_mvt)
+		return (_scaledSize * _tileRatio) / _tileSize;
+
+	return _tileRatio;
 }
 
 qreal MBTilesMap::tileSize() const
@@ -356,23 +384,44 @@ qreal MBTilesMap::tileSize() const
 	return (_tileSize / coordinatesRatio());
 }
 
-QByteArray MBTilesMap::tileData(int zoom, const QPoint &tile) const
+QByteArray MBTilesMap::tileData(int zoom, const QPoint &tile)
 {
-	QSqlQuery query(_db);
-	query.prepare("SELECT tile_data FROM tiles "
-	  "WHERE zoom_level=:zoom AND tile_column=:x AND tile_row=:y");
-	query.bindValue(":zoom", zoom);
-	query.bindValue(":x", tile.x());
-	query.bindValue(":y", (1<<zoom) - tile.y() - 1);
-	query.exec();
+	return _tiles.tile(QVariantList() << zoom << tile.x()
+	  << (1<<zoom) - tile.y() - 1);
+}
 
-	if (query.first())
-		return query.value(0).toByteArray();
+/* Reads the data of all the tiles without data with a single query */
+void MBTilesMap::tilesData(int zoom, QList<MBTile> &tiles)
+{
+	QSet<qint64> xs, ys;
+	QHash<quint64, QByteArray> data;
 
-	return QByteArray();
+	for (int i = 0; i < tiles.size(); i++) {
+		if (tiles.at(i).hasSource()) {
+			xs.insert(tiles.at(i).xy().x());
+			ys.insert((1<<zoom) - tiles.at(i).xy().y() - 1);
+		}
+	}
+	if (xs.isEmpty())
+		return;
+
+	SQLiteTiles::Query query(_tiles);
+	if (query.exec(QString("SELECT tile_column, tile_row, tile_data"
+	  " FROM tiles WHERE zoom_level=%1 AND tile_column IN (%2)"
+	  " AND tile_row IN (%3)").arg(zoom)
+	  .arg(SQLiteTiles::valueList(xs), SQLiteTiles::valueList(ys)))) {
+		while (query.next())
+			data.insert(TileCache::key(zoom, QPoint(query.value(0).toInt(),
+			  (1<<zoom) - query.value(1).toInt() - 1)),
+			  query.value(2).toByteArray());
+	}
+
+	for (int i = 0; i < tiles.size(); i++)
+		if (tiles.at(i).hasSource())
+			tiles[i].setData(data.value(tiles.at(i).dataKey()));
 }
 
-bool MBTilesMap::isRunning(const QString &key) const
+bool MBTilesMap::isRunning(quint64 key) const
 {
 	for (int i = 0; i < _jobs.size(); i++) {
 		const QList<MBTile> &tiles = _jobs.at(i)->tiles();
@@ -405,7 +454,8 @@ void MBTilesMap::jobFinished(MBTilesMapJob *job)
 	for (int i = 0; i < tiles.size(); i++) {
 		const MBTile &mt = tiles.at(i);
 		if (!mt.pixmap().isNull())
-			QPixmapCache::insert(mt.key(), mt.pixmap());
+			_tileCache.insert(mt.key(), mt.pixmap());
+		insertData(mt);
 	}
 
 	removeJob(job);
@@ -446,33 +496,44 @@ void MBTilesMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		for (int j = 0; j < height; j++) {
 			QPixmap pm;
 			QPoint t(tile.x() + i, tile.y() + j);
-			QString key = path() + "-" + QString::number(zoom.z) + "_"
-			  + QString::number(t.x()) + "_" + QString::number(t.y());
+			quint64 key = TileCache::key(zoom.z, t);
 
 			if (isRunning(key))
 				continue;
 
-			if (QPixmapCache::find(key, &pm)) {
+			if (_tileCache.find(key, &pm, imageRatio())) {
 				QPointF tp(tilePos(tl, t, tile, overzoom));
 				drawTile(painter, pm, tp);
-			} else
-				tiles.append(MBTile(zoom.z, overzoom, _scaledSize, _style, t,
-				  tileData(zoom.base, t), key));
+			} else if (_coverage.contains(zoom.base, t)) {
+				quint64 dk = TileCache::key(zoom.base, t);
+				QByteArray *data = _dataCache.object(dk);
+				if (data)
+					tiles.append(MBTile(zoom.z, overzoom, _scaledSize, _mvt,
+					  _style, t, *data, false, key));
+				else
+					tiles.append(MBTile(zoom.z, overzoom, _scaledSize, _mvt,
+					  _style, t, this, key));
+			}
 		}
 	}
 
 	if (!tiles.isEmpty()) {
 		if (flags & Map::Block || !_mvt) {
-			QFuture<void> future = QtConcurrent::map(tiles, &MBTile::load);
+			/* All the tiles are needed at once, read them in a single
+			   batch */
+			tilesData(zoom.base, tiles);
+			QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+			  tiles, &MBTile::load);
 			future.waitForFinished();
 
 			for (int i = 0; i < tiles.size(); i++) {
 				const MBTile &mt = tiles.at(i);
+				insertData(mt);
 				QPixmap pm(mt.pixmap());
 				if (pm.isNull())
 					continue;
 
-				QPixmapCache::insert(mt.key(), pm);
+				_tileCache.insert(mt.key(), pm);
 
 				QPointF tp(tilePos(tl, mt.xy(), tile, overzoom));
 				drawTile(painter, pm, tp);
@@ -482,6 +543,18 @@ void MBTilesMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 	}
 }
 
+/* The vector tiles are decoded for every overzoom level and style, keep the
+   uncompressed data to not read and gunzip the same base tile repeatedly. The
+   cache is deliberately kept on unload(), style changes reload the map. */
+void MBTilesMap::insertData(const MBTile &tile)
+{
+	if (!_mvt || tile.data().isEmpty() || _dataCache.contains(tile.dataKey()))
+		return;
+
+	_dataCache.insert(tile.dataKey(), new QByteArray(tile.data()),
+	  qMax(tile.data().size() / 1024, 1));
+}
+
 void MBTilesMap::drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp)
 {
 	pixmap.setDevicePixelRatio(imageRatio());
@@ -495,6 +568,12 @@ QPointF MBTilesMap::ll2xy(const Coordinates &c)
 	return QPointF(m.x() / scale, m.y() / -scale) / coordinatesRatio();
 }
 
+void MBTilesMap::ll2xy(const Coordinates *c, QPointF *p, int n)
+{
+	OSM::ll2xy(c, p, n, OSM::zoom2scale(_zooms.at(_zoom).z, _tileSize),
+	  coordinatesRatio());
+}
+
 Coordinates MBTilesMap::xy2ll(const QPointF &p)
 {
 	qreal scale = OSM::zoom2scale(_zooms.at(_zoom).z, _tileSize);
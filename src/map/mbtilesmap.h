@@ -7,35 +7,63 @@
 #include <QImageReader>
 #include <QBuffer>
 #include <QPixmap>
-#include <QtConcurrent>
+#include "common/threadpools.h"
+#include "common/trace.h"
 #include "mvtstyle.h"
 #include "map.h"
+#include "tilecache.h"
+#include "tilecoverage.h"
+#include "sqlitetiles.h"
+#include "tile.h"
 
 class MBTile
 {
 public:
-	MBTile(int zoom, int overzoom, int scaledSize, int style, const QPoint &xy,
-	  const QByteArray &data, const QString &key) : _zoom(zoom),
-	  _overzoom(overzoom), _scaledSize(scaledSize), _style(style), _xy(xy),
-	  _data(data), _key(key) {}
+	MBTile(int zoom, int overzoom, int scaledSize, bool mvt, int style,
+	  const QPoint &xy, const QByteArray &data, bool gzip, quint64 key)
+	  : _zoom(zoom), _overzoom(overzoom), _scaledSize(scaledSize),
+	  _style(style), _xy(xy), _data(data), _source(0), _key(key), _gzip(gzip),
+	  _mvt(mvt) {}
+	MBTile(int zoom, int overzoom, int scaledSize, bool mvt, int style,
+	  const QPoint &xy, DataTileSource *source, quint64 key)
+	  : _zoom(zoom), _overzoom(overzoom), _scaledSize(scaledSize),
+	  _style(style), _xy(xy), _source(source), _key(key), _gzip(mvt),
+	  _mvt(mvt) {}
 
 	const QPoint &xy() const {return _xy;}
-	const QString &key() const {return _key;}
+	quint64 key() const {return _key;}
 	const QPixmap &pixmap() const {return _pixmap;}
+	/* The uncompressed base tile data, shared by all the overzoom levels and
+	   styles. Null until the tile gets loaded. */
+	QByteArray data() const {return _gzip ? QByteArray() : _data;}
+	quint64 dataKey() const {return TileCache::key(_zoom - _overzoom, _xy);}
+	/* Tiles with a data source read their (compressed) data in load() */
+	bool hasSource() const {return (_source != 0);}
+	void setData(const QByteArray &data) {_data = data; _source = 0;}
 
 	void load() {
-		if (_scaledSize) {
+		if (_source)
+			_data = _source->tileData(_zoom - _overzoom, _xy);
+
+		if (_mvt) {
 			QByteArray format(QByteArray::number(_zoom)
 			  + ';' + QByteArray::number(_overzoom)
 			  + ';' + QByteArray::number(_style));
-			QByteArray data(Util::gunzip(_data));
-			QBuffer buffer(&data);
+			if (_gzip) {
+				_data = Util::gunzip(_data);
+				_gzip = false;
+			}
+			QBuffer buffer(&_data);
 			QImageReader reader(&buffer, format);
 			reader.setScaledSize(QSize(_scaledSize, _scaledSize));
 			_pixmap = QPixmap::fromImageReader(&reader);
 		} else {
 			QBuffer buffer(&_data);
 			QImageReader reader(&buffer);
+			/* Raster tiles are decoded straight to the display size (JPEG
+			   uses DCT scaling) instead of being scaled on every draw */
+			if (_scaledSize)
+				reader.setScaledSize(QSize(_scaledSize, _scaledSize));
 			_pixmap = QPixmap::fromImageReader(&reader);
 		}
 	}
@@ -47,8 +75,11 @@ private:
 	int _style;
 	QPoint _xy;
 	QByteArray _data;
-	QString _key;
+	DataTileSource *_source;
+	quint64 _key;
 	QPixmap _pixmap;
+	bool _gzip;
+	bool _mvt;
 };
 
 class MBTilesMapJob : public QObject
@@ -60,9 +91,10 @@ public:
 
 	void run()
 	{
+		_trace.start();
 		connect(&_watcher, &QFutureWatcher<void>::finished, this,
 		  &MBTilesMapJob::handleFinished);
-		_future = QtConcurrent::map(_tiles, &MBTile::load);
+		_future = ThreadPools::map(ThreadPools::Render, _tiles, &MBTile::load);
 		_watcher.setFuture(_future);
 	}
 	void cancel(bool wait)
@@ -77,15 +109,20 @@ signals:
 	void finished(MBTilesMapJob *job);
 
 private slots:
-	void handleFinished() {emit finished(this);}
+	void handleFinished()
+	{
+		_trace.end("job", "MBTilesMapJob");
+		emit finished(this);
+	}
 
 private:
 	QFutureWatcher<void> _watcher;
 	QFuture<void> _future;
+	Trace::Span _trace;
 	QList<MBTile> _tiles;
 };
 
-class MBTilesMap : public Map
+class MBTilesMap : public Map, public DataTileSource
 {
 	Q_OBJECT
 
@@ -106,12 +143,15 @@ public:
 
 	QPointF ll2xy(const Coordinates &c);
 	Coordinates xy2ll(const QPointF &p);
+	void ll2xy(const Coordinates *c, QPointF *p, int n);
 
 	void draw(QPainter *painter, const QRectF &rect, Flags flags);
 
 	void load(const Projection &in, const Projection &out, qreal deviceRatio,
 	  bool hidpi, int style, int layer);
 	void unload();
+	void restyle(const Projection &in, const Projection &out,
+	  qreal deviceRatio, bool hidpi, int style, int layer);
 
 	QStringList styles(int &defaultStyle) const;
 
@@ -120,6 +160,8 @@ public:
 
 	static Map *create(const QString &path, const Projection &proj, bool *isDir);
 
+	QByteArray tileData(int zoom, const QPoint &tile);
+
 private slots:
 	void jobFinished(MBTilesMapJob *job);
 
@@ -144,9 +186,10 @@ private:
 	qreal tileSize() const;
 	qreal coordinatesRatio() const;
 	qreal imageRatio() const;
-	QByteArray tileData(int zoom, const QPoint &tile) const;
+	void tilesData(int zoom, QList<MBTile> &tiles);
+	void insertData(const MBTile &tile);
 	void drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp);
-	bool isRunning(const QString &key) const;
+	bool isRunning(quint64 key) const;
 	void runJob(MBTilesMapJob *job);
 	void removeJob(MBTilesMapJob *job);
 	void cancelJobs(bool wait);
@@ -156,6 +199,7 @@ private:
 	friend QDebug operator<<(QDebug dbg, const Zoom &zoom);
 
 	QSqlDatabase _db;
+	SQLiteTiles _tiles;
 
 	QString _name;
 	RectC _bounds;
@@ -169,6 +213,9 @@ private:
 	int _scaledSize;
 
 	QList<MBTilesMapJob*> _jobs;
+	TileCache _tileCache;
+	QCache<quint64, QByteArray> _dataCache;
+	TileCoverage _coverage;
 
 	bool _valid;
 	QString _errorString;
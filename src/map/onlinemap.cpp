@@ -1,10 +1,10 @@
 #include <QPainter>
 #include <QDir>
-#include <QPixmapCache>
 #include "common/rectc.h"
 #include "common/programpaths.h"
 #include "downloader.h"
 #include "osm.h"
+#include "tileseeder.h"
 #include "onlinemap.h"
 
 
@@ -12,8 +12,9 @@
 
 OnlineMap::OnlineMap(const QString &fileName, const QString &name,
   const QString &url, const Range &zooms, const RectC &bounds, qreal tileRatio,
-  const QList<HTTPHeader> &headers, int tileSize, bool mvt, bool invertY,
-  bool quadTiles, const QStringList &layers, QObject *parent)
+  const QList<HTTPHeader> &headers, const NetworkProfile &profile,
+  int tileSize, bool mvt, bool invertY, bool quadTiles,
+  const QStringList &layers, QObject *parent)
     : Map(fileName, parent), _name(name), _zooms(zooms), _bounds(bounds),
 	_zoom(_zooms.max()), _tileSize(tileSize), _baseZoom(0), _mapRatio(1.0),
 	_tileRatio(tileRatio), _mvt(mvt), _scaledSize(0),
@@ -23,7 +24,10 @@ OnlineMap::OnlineMap(const QString &fileName, const QString &name,
 	  this);
 	_tileLoader->setUrl(url, quadTiles ? TileLoader::QuadTiles : TileLoader::XYZ);
 	_tileLoader->setHeaders(headers);
+	_tileLoader->setNetworkProfile(profile);
 	connect(_tileLoader, &TileLoader::finished, this, &OnlineMap::tilesLoaded);
+	connect(_tileLoader, &TileLoader::tilesChanged, this,
+	  &OnlineMap::tilesChanged);
 
 	_baseZoom = _zooms.max();
 
@@ -119,13 +123,24 @@ void OnlineMap::load(const Projection &in, const Projection &out,
 			_zooms.setMax(i);
 		}
 
-		QPixmapCache::clear();
-	}
+		_tileCache.setVariant(TileCache::variant(_style, -1));
+	} else
+		_scaledSize = (_mapRatio > 1.0 || deviceRatio == _tileRatio)
+		  ? 0 : qRound(_tileSize * deviceRatio);
 }
 
 void OnlineMap::unload()
 {
 	cancelJobs(true);
+	_tileCache.clear();
+}
+
+void OnlineMap::restyle(const Projection &in, const Projection &out,
+  qreal deviceRatio, bool hidpi, int style, int layer)
+{
+	/* Keep the tiles of the current style for a quick switch back */
+	_tileCache.keep();
+	Map::restyle(in, out, deviceRatio, hidpi, style, layer);
 }
 
 qreal OnlineMap::coordinatesRatio() const
@@ -135,7 +150,12 @@ qreal OnlineMap::coordinatesRatio() const
 
 qreal OnlineMap::imageRatio() const
 {
-	return _mapRatio > 1.0 ? _mapRatio : _tileRatio;
+	if (_mapRatio > 1.0)
+		return _mapRatio;
+	if (_scaledSize && !_mvt)
+		return (qreal)_scaledSize / _tileSize;
+
+	return _tileRatio;
 }
 
 qreal OnlineMap::tileSize() const
@@ -155,7 +175,7 @@ QPointF OnlineMap::tilePos(const QPointF &tl, const QPoint &tc,
 	  tl.y() + ((tc.y() - tile.y()) << overzoom) * tileSize());
 }
 
-bool OnlineMap::isRunning(const QString &key) const
+bool OnlineMap::isRunning(quint64 key) const
 {
 	for (int i = 0; i < _jobs.size(); i++) {
 		const QList<OnlineMapTile> &tiles = _jobs.at(i)->tiles();
@@ -188,7 +208,7 @@ void OnlineMap::jobFinished(OnlineMapJob *job)
 	for (int i = 0; i < tiles.size(); i++) {
 		const OnlineMapTile &mt = tiles.at(i);
 		if (!mt.pixmap().isNull())
-			QPixmapCache::insert(mt.key(), mt.pixmap());
+			_tileCache.insert(mt.key(), mt.pixmap());
 	}
 
 	removeJob(job);
@@ -228,34 +248,50 @@ void OnlineMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 
 	if (flags & Map::Block)
 		_tileLoader->loadTilesSync(fetchTiles);
-	else
+	else {
 		_tileLoader->loadTilesAsync(fetchTiles);
 
+		QRect visible(tile, QSize(width, height));
+		QRect pr(_tileLoader->prefetchRect(visible, baseZoom,
+		  QRect(0, 0, 1<<baseZoom, 1<<baseZoom)));
+		QVector<TileLoader::Tile> prefetchTiles;
+		for (int i = pr.left(); i <= pr.right(); i++)
+			for (int j = pr.top(); j <= pr.bottom(); j++)
+				if (!visible.contains(i, j))
+					prefetchTiles.append(TileLoader::Tile(
+					  tileCoordinates(i, j, baseZoom), baseZoom));
+		_tileLoader->prefetchTiles(prefetchTiles);
+	}
+
 	QList<OnlineMapTile> renderTiles;
 	for (int i = 0; i < fetchTiles.count(); i++) {
 		const TileLoader::Tile &t = fetchTiles.at(i);
-		if (t.file().isNull())
-			continue;
-
-		QString key(overzoom
-		  ? t.file() + ":" + QString::number(overzoom) : t.file());
-		if (isRunning(key))
+		QPoint tc(tileCoordinates(t.xy().x(), t.xy().y(), baseZoom));
+		QPointF tp(tilePos(tl, tc, tile, overzoom));
+		QRectF tr(tp, QSizeF(tileSize() * f, tileSize() * f));
+		quint64 key = TileCache::key(baseZoom, t.xy(), overzoom);
+
+		if (t.file().isNull() || isRunning(key)) {
+			if (!(flags & Map::Block))
+				drawFallback(painter, tc, baseZoom, overzoom, tr);
 			continue;
+		}
 
 		QPixmap pm;
-		if (QPixmapCache::find(key, &pm)) {
-			QPoint tc(tileCoordinates(t.xy().x(), t.xy().y(), baseZoom));
-			QPointF tp(tilePos(tl, tc, tile, overzoom));
+		if (_tileCache.find(key, &pm, imageRatio()))
 			drawTile(painter, pm, tp);
-		} else
-			renderTiles.append(OnlineMapTile(t.xy(), t.file(), _zoom, overzoom,
-			  _scaledSize, _style, key));
+		else {
+			renderTiles.append(OnlineMapTile(t.xy(), _tileLoader->tileData(t),
+			  _zoom, overzoom, _scaledSize, _mvt, _style, key));
+			if (!(flags & Map::Block) && _mvt)
+				drawFallback(painter, tc, baseZoom, overzoom, tr);
+		}
 	}
 
 	if (!renderTiles.isEmpty()) {
 		if (flags & Map::Block || !_mvt) {
-			QFuture<void> future = QtConcurrent::map(renderTiles,
-			  &OnlineMapTile::load);
+			QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+			  renderTiles, &OnlineMapTile::load);
 			future.waitForFinished();
 
 			for (int i = 0; i < renderTiles.size(); i++) {
@@ -264,7 +300,7 @@ void OnlineMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 				if (pm.isNull())
 					continue;
 
-				QPixmapCache::insert(mt.key(), pm);
+				_tileCache.insert(mt.key(), pm);
 
 				QPoint tc(tileCoordinates(mt.xy().x(), mt.xy().y(), baseZoom));
 				QPointF tp(tilePos(tl, tc, tile, overzoom));
@@ -281,6 +317,67 @@ void OnlineMap::drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp)
 	painter->drawPixmap(tp, pixmap);
 }
 
+bool OnlineMap::drawCached(QPainter *painter, quint64 key, const QRectF &rect,
+  unsigned shift, const QPoint &offset)
+{
+	QPixmap pm;
+	if (!_tileCache.find(key, &pm))
+		return false;
+
+	qreal w = (qreal)pm.width() / (1U<<shift);
+	qreal h = (qreal)pm.height() / (1U<<shift);
+	painter->drawPixmap(rect, pm, QRectF(offset.x() * w, offset.y() * h, w, h));
+
+	return true;
+}
+
+/* Draws a scaled placeholder of a not yet available tile from the already
+   decoded parent (up to 4 zoom levels up) or child tiles. The placeholder
+   gets replaced on the next redraw when the real tile is loaded. */
+bool OnlineMap::drawFallback(QPainter *painter, const QPoint &tc, int zoom,
+  unsigned overzoom, const QRectF &rect)
+{
+	for (int i = 1; i <= 4; i++) {
+		int z = _zoom - i;
+		if (z < _zooms.min())
+			break;
+
+		int pz = qMin(_baseZoom, z);
+		unsigned shift = zoom - pz;
+		QPoint ptc(tc.x() >> shift, tc.y() >> shift);
+		QPoint offset(tc.x() - (ptc.x() << shift), tc.y() - (ptc.y() << shift));
+		quint64 key = TileCache::key(pz, tileCoordinates(ptc.x(), ptc.y(), pz),
+		  z - pz);
+
+		if (drawCached(painter, key, rect, shift, offset))
+			return true;
+	}
+
+	if (_zoom + 1 > _zooms.max())
+		return false;
+
+	if (zoom + 1 > _baseZoom)
+		return drawCached(painter, TileCache::key(zoom,
+		  tileCoordinates(tc.x(), tc.y(), zoom), overzoom + 1), rect, 0,
+		  QPoint(0, 0));
+
+	bool ret = false;
+	QSizeF cs(rect.width() / 2, rect.height() / 2);
+	for (int i = 0; i < 2; i++) {
+		for (int j = 0; j < 2; j++) {
+			QPoint ctc(tc.x() * 2 + i, tc.y() * 2 + j);
+			quint64 key = TileCache::key(zoom + 1,
+			  tileCoordinates(ctc.x(), ctc.y(), zoom + 1));
+			QRectF cr(QPointF(rect.left() + i * cs.width(),
+			  rect.top() + j * cs.height()), cs);
+			if (drawCached(painter, key, cr, 0, QPoint(0, 0)))
+				ret = true;
+		}
+	}
+
+	return ret;
+}
+
 QPointF OnlineMap::ll2xy(const Coordinates &c)
 {
 	qreal scale = OSM::zoom2scale(_zoom, _tileSize);
@@ -288,6 +385,12 @@ QPointF OnlineMap::ll2xy(const Coordinates &c)
 	return QPointF(m.x() / scale, m.y() / -scale) / coordinatesRatio();
 }
 
+void OnlineMap::ll2xy(const Coordinates *c, QPointF *p, int n)
+{
+	OSM::ll2xy(c, p, n, OSM::zoom2scale(_zoom, _tileSize),
+	  coordinatesRatio());
+}
+
 Coordinates OnlineMap::xy2ll(const QPointF &p)
 {
 	qreal scale = OSM::zoom2scale(_zoom, _tileSize);
@@ -298,7 +401,46 @@ Coordinates OnlineMap::xy2ll(const QPointF &p)
 void OnlineMap::clearCache()
 {
 	_tileLoader->clearCache();
-	QPixmapCache::clear();
+	_tileCache.clear();
+}
+
+/* The tiles are enumerated up to SEED_LIMIT + 1 tiles, the caller is
+   expected to refuse larger jobs. */
+TileSeeder *OnlineMap::seeder(const QList<RectC> &areas, const Range &zooms)
+{
+	QVector<TileLoader::Tile> tiles;
+	QSet<quint64> keys;
+	int zmin = qMax(zooms.min(), _zooms.min());
+	int zmax = qMin(zooms.max(), _baseZoom);
+
+	for (int z = zmin; z <= zmax && tiles.size() <= SEED_LIMIT; z++) {
+		int n = 1<<z;
+
+		for (int i = 0; i < areas.size() && tiles.size() <= SEED_LIMIT; i++) {
+			RectC r(areas.at(i) & _bounds);
+			if (!r.isValid())
+				continue;
+
+			QPoint tl(OSM::ll2tile(r.topLeft(), z));
+			QPoint br(OSM::ll2tile(r.bottomRight(), z));
+			int left = qMax(0, tl.x()), right = qMin(n - 1, br.x());
+			int top = qMax(0, tl.y()), bottom = qMin(n - 1, br.y());
+
+			for (int x = left; x <= right && tiles.size() <= SEED_LIMIT; x++) {
+				for (int y = top; y <= bottom && tiles.size() <= SEED_LIMIT;
+				  y++) {
+					QPoint tc(tileCoordinates(x, y, z));
+					quint64 key = TileCache::key(z, tc);
+					if (!keys.contains(key)) {
+						keys.insert(key);
+						tiles.append(TileLoader::Tile(tc, z));
+					}
+				}
+			}
+		}
+	}
+
+	return new TileSeeder(_tileLoader, tiles);
 }
 
 QStringList OnlineMap::styles(int &defaultStyle) const
@@ -2,40 +2,50 @@
 #define ONLINEMAP_H
 
 #include <QImageReader>
+#include <QBuffer>
 #include <QPixmap>
-#include <QtConcurrent>
+#include "common/threadpools.h"
 #include "common/range.h"
 #include "common/rectc.h"
+#include "common/trace.h"
 #include "map.h"
+#include "tilecache.h"
 #include "mvtstyle.h"
 #include "tileloader.h"
 
 class OnlineMapTile
 {
 public:
-	OnlineMapTile(const QPoint &xy, const QString &file, int zoom, int overzoom,
-	  int scaledSize, int style, const QString &key) : _zoom(zoom),
-	  _overzoom(overzoom), _scaledSize(scaledSize), _style(style), _xy(xy),
-	  _file(file), _key(key) {}
+	OnlineMapTile(const QPoint &xy, const QByteArray &data, int zoom,
+	  int overzoom, int scaledSize, bool mvt, int style, quint64 key)
+	  : _zoom(zoom), _overzoom(overzoom), _scaledSize(scaledSize),
+	  _style(style), _xy(xy), _data(data), _key(key), _mvt(mvt) {}
 
 	void load()
 	{
-		if (_scaledSize) {
+		TRACE_SCOPE("OnlineMap", "decode");
+		QBuffer buffer(&_data);
+
+		if (_mvt) {
 			QByteArray format(QByteArray::number(_zoom)
 			  + ';' + QByteArray::number(_overzoom)
 			  + ';' + QByteArray::number(_style));
-			QImageReader reader(_file, format);
+			QImageReader reader(&buffer, format);
 			reader.setScaledSize(QSize(_scaledSize, _scaledSize));
 			_pixmap = QPixmap::fromImageReader(&reader);
 		} else {
-			QImageReader reader(_file);
+			QImageReader reader(&buffer);
+			/* Raster tiles are decoded straight to the display size (JPEG
+			   uses DCT scaling) instead of being scaled on every draw */
+			if (_scaledSize)
+				reader.setScaledSize(QSize(_scaledSize, _scaledSize));
 			_pixmap = QPixmap::fromImageReader(&reader);
 		}
 	}
 
 	const QPoint &xy() const {return _xy;}
 	const QPixmap &pixmap() const {return _pixmap;}
-	const QString &key() const {return _key;}
+	quint64 key() const {return _key;}
 
 private:
 	int _zoom;
@@ -43,9 +53,10 @@ private:
 	int _scaledSize;
 	int _style;
 	QPoint _xy;
-	QString _file;
-	QString _key;
+	QByteArray _data;
+	quint64 _key;
 	QPixmap _pixmap;
+	bool _mvt;
 };
 
 class OnlineMapJob : public QObject
@@ -57,9 +68,11 @@ public:
 
 	void run()
 	{
+		_trace.start();
 		connect(&_watcher, &QFutureWatcher<void>::finished, this,
 		  &OnlineMapJob::handleFinished);
-		_future = QtConcurrent::map(_tiles, &OnlineMapTile::load);
+		_future = ThreadPools::map(ThreadPools::Render,
+		  _tiles, &OnlineMapTile::load);
 		_watcher.setFuture(_future);
 	}
 	void cancel(bool wait)
@@ -74,11 +87,16 @@ signals:
 	void finished(OnlineMapJob *job);
 
 private slots:
-	void handleFinished() {emit finished(this);}
+	void handleFinished()
+	{
+		_trace.end("job", "OnlineMapJob");
+		emit finished(this);
+	}
 
 private:
 	QFutureWatcher<void> _watcher;
 	QFuture<void> _future;
+	Trace::Span _trace;
 	QList<OnlineMapTile> _tiles;
 };
 
@@ -89,8 +107,9 @@ class OnlineMap : public Map
 public:
 	OnlineMap(const QString &fileName, const QString &name, const QString &url,
 	  const Range &zooms, const RectC &bounds, qreal tileRatio,
-	  const QList<HTTPHeader> &headers, int tileSize, bool mvt, bool invertY,
-	  bool quadTiles, const QStringList &layers, QObject *parent = 0);
+	  const QList<HTTPHeader> &headers, const NetworkProfile &profile,
+	  int tileSize, bool mvt, bool invertY, bool quadTiles,
+	  const QStringList &layers, QObject *parent = 0);
 
 	QString name() const {return _name;}
 
@@ -106,18 +125,25 @@ public:
 
 	QPointF ll2xy(const Coordinates &c);
 	Coordinates xy2ll(const QPointF &p);
+	void ll2xy(const Coordinates *c, QPointF *p, int n);
 
 	void draw(QPainter *painter, const QRectF &rect, Flags flags);
 
 	void load(const Projection &in, const Projection &out, qreal deviceRatio,
 	  bool hidpi, int style, int layer);
 	void unload();
+	void restyle(const Projection &in, const Projection &out,
+	  qreal deviceRatio, bool hidpi, int style, int layer);
 	void clearCache();
 
+	Range seedZooms() const {return Range(_zooms.min(), _baseZoom);}
+	TileSeeder *seeder(const QList<RectC> &areas, const Range &zooms);
+
 	QStringList styles(int &defaultStyle) const;
 
 private slots:
 	void jobFinished(OnlineMapJob *job);
+	void tilesChanged() {_tileCache.clear();}
 
 private:
 	int defaultStyle(const QStringList &vectorLayers);
@@ -129,12 +155,17 @@ private:
 	QPointF tilePos(const QPointF &tl, const QPoint &tc, const QPoint &tile,
 	  unsigned overzoom) const;
 	void drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp);
-	bool isRunning(const QString &key) const;
+	bool drawFallback(QPainter *painter, const QPoint &tc, int zoom,
+	  unsigned overzoom, const QRectF &rect);
+	bool drawCached(QPainter *painter, quint64 key, const QRectF &rect,
+	  unsigned shift, const QPoint &offset);
+	bool isRunning(quint64 key) const;
 	void runJob(OnlineMapJob *job);
 	void removeJob(OnlineMapJob *job);
 	void cancelJobs(bool wait);
 
 	TileLoader *_tileLoader;
+	TileCache _tileCache;
 	QString _name;
 	Range _zooms;
 	RectC _bounds;
@@ -485,6 +485,12 @@ int OruxMap::zoomOut()
 	return _zoom;
 }
 
+static void coverageKey(const QSqlQuery &query, int &zoom, QPoint &tile)
+{
+	zoom = query.value(0).toInt();
+	tile = QPoint(query.value(1).toInt(), query.value(2).toInt());
+}
+
 void OruxMap::load(const Projection &in, const Projection &out,
   qreal deviceRatio, bool hidpi, int style, int layer)
 {
@@ -495,8 +501,11 @@ void OruxMap::load(const Projection &in, const Projection &out,
 
 	_mapRatio = hidpi ? deviceRatio : 1.0;
 
-	if (_db.isValid())
+	if (_db.isValid()) {
 		_db.open();
+		_coverage.load(_db.databaseName(), "SELECT z, x, y FROM tiles",
+		  coverageKey);
+	}
 }
 
 void OruxMap::unload()
@@ -556,7 +565,8 @@ void OruxMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 			QString key = path() + "/" + QString::number(z.zoom)
 			  + "_" + QString::number(x/z.tileSize.width())
 			  + "_" + QString::number(y/z.tileSize.height());
-			if (!QPixmapCache::find(key, &pixmap)) {
+			if (!QPixmapCache::find(key, &pixmap) && _coverage.contains(z.zoom,
+			  QPoint(x/z.tileSize.width(), y/z.tileSize.height()))) {
 				pixmap = tile(z, x/z.tileSize.width(), y/z.tileSize.height());
 				if (!pixmap.isNull())
 					QPixmapCache::insert(key, pixmap);
@@ -8,6 +8,7 @@
 #include "projection.h"
 #include "transform.h"
 #include "calibrationpoint.h"
+#include "tilecoverage.h"
 
 class QXmlStreamReader;
 
@@ -73,6 +74,7 @@ private:
 	QString _name;
 	QList<Zoom> _zooms;
 	QSqlDatabase _db;
+	TileCoverage _coverage;
 	int _zoom;
 	qreal _mapRatio;
 
@@ -42,6 +42,23 @@ int OSM::scale2zoom(qreal scale, int tileSize)
 	return (int)(log2(360.0/(scale * (qreal)tileSize)) + EPSILON);
 }
 
+void OSM::ll2xy(const Coordinates *c, QPointF *p, int n, qreal scale,
+  qreal ratio)
+{
+	double kx = 1.0 / (scale * ratio);
+	double ky = -rad2deg(1.0) * kx;
+
+	double maxLat = BOUNDS.top();
+
+	/* atanh(sin(lat)) == log(tan(M_PI_4 + lat/2)) with a single
+	   trigonometric call. The latitude is limited to the mercator bounds as
+	   atanh(1) is inf. */
+	for (int i = 0; i < n; i++) {
+		double lat = qMax(-maxLat, qMin(maxLat, c[i].lat()));
+		p[i] = QPointF(c[i].lon() * kx, atanh(sin(deg2rad(lat))) * ky);
+	}
+}
+
 qreal OSM::resolution(const QPointF &p, int zoom, int tileSize)
 {
 	qreal scale = zoom2scale(zoom, tileSize);
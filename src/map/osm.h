@@ -20,6 +20,11 @@ namespace OSM
 	int scale2zoom(qreal scale, int tileSize);
 	qreal resolution(const QPointF &p, int zoom, int tileSize);
 
+	/* Batch Web Mercator map coordinates of n points, i.e.
+	   ll2m(c) / (scale * ratio) with the y axis pointing down */
+	void ll2xy(const Coordinates *c, QPointF *p, int n, qreal scale,
+	  qreal ratio);
+
 	inline Coordinates tile2ll(const QPoint &p, int zoom)
 	  {return m2ll(tile2mercator(p, zoom));}
 	inline QPoint ll2tile(const Coordinates &c, int zoom)
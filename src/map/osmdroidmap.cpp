@@ -3,12 +3,11 @@
 #include <QSqlField>
 #include <QSqlError>
 #include <QPainter>
-#include <QPixmapCache>
 #include <QImageReader>
 #include <QBuffer>
-#include <QtConcurrent>
+#include "common/threadpools.h"
 #include "osm.h"
-#include "tile.h"
+#include "tileorder.h"
 #include "metatype.h"
 #include "osmdroidmap.h"
 
@@ -151,6 +150,19 @@ OsmdroidMap::OsmdroidMap(const QString &fileName, QObject *parent)
 	_valid = true;
 }
 
+/* key = (((z << z) + x) << z) + y */
+static void coverageKey(const QSqlQuery &query, int &zoom, QPoint &tile)
+{
+	quint64 key = query.value(0).toULongLong();
+	int z = 0;
+	while (z < 28 && ((quint64)(z + 1) << (2 * (z + 1))) <= key)
+		z++;
+	quint64 xy = key - ((quint64)z << (2 * z));
+
+	zoom = z;
+	tile = QPoint(xy >> z, xy & ((1ULL<<z) - 1));
+}
+
 void OsmdroidMap::load(const Projection &in, const Projection &out,
   qreal deviceRatio, bool hidpi, int style, int layer)
 {
@@ -160,12 +172,16 @@ void OsmdroidMap::load(const Projection &in, const Projection &out,
 	Q_UNUSED(layer);
 
 	_mapRatio = hidpi ? deviceRatio : 1.0;
-	_db.open();
+	_tiles.open(path(), "SELECT tile FROM tiles WHERE key=?");
+	_coverage.load(path(), "SELECT key FROM tiles", coverageKey);
 }
 
 void OsmdroidMap::unload()
 {
-	_db.close();
+	cancelJobs(true);
+
+	_tiles.close();
+	_tileCache.clear();
 }
 
 QRectF OsmdroidMap::bounds()
@@ -204,12 +220,16 @@ qreal OsmdroidMap::resolution(const QRectF &rect)
 
 int OsmdroidMap::zoomIn()
 {
+	cancelJobs(false);
+
 	_zoom = qMin(_zoom + 1, _zooms.max());
 	return _zoom;
 }
 
 int OsmdroidMap::zoomOut()
 {
+	cancelJobs(false);
+
 	_zoom = qMax(_zoom - 1, _zooms.min());
 	return _zoom;
 }
@@ -219,25 +239,46 @@ qreal OsmdroidMap::tileSize() const
 	return (_tileSize / _mapRatio);
 }
 
-QByteArray OsmdroidMap::tileData(int zoom, const QPoint &tile) const
+static quint64 tileKey(int zoom, const QPoint &tile)
 {
 	quint64 z = zoom;
-	quint64 key = (((z << z) + tile.x()) << z) + tile.y();
+	return (((z << z) + tile.x()) << z) + tile.y();
+}
 
-	QSqlQuery query(_db);
-	query.prepare("SELECT tile FROM tiles WHERE key=:key");
-	query.bindValue(":key", key);
-	query.exec();
+QByteArray OsmdroidMap::tileData(int zoom, const QPoint &tile)
+{
+	return _tiles.tile(QVariantList() << tileKey(zoom, tile));
+}
 
-	if (query.first())
-		return query.value(0).toByteArray();
+/* Reads the data of all the tiles with a single query */
+QList<DataTile> OsmdroidMap::tilesData(int zoom, const QList<DataTile> &tiles)
+{
+	QSet<qint64> keys;
+	QHash<quint64, QByteArray> data;
+	QList<DataTile> list;
+
+	for (int i = 0; i < tiles.size(); i++)
+		keys.insert(tileKey(zoom, tiles.at(i).xy()));
+
+	SQLiteTiles::Query query(_tiles);
+	if (query.exec(QString("SELECT key, tile FROM tiles"
+	  " WHERE key IN (%1)").arg(SQLiteTiles::valueList(keys)))) {
+		while (query.next())
+			data.insert(query.value(0).toULongLong(),
+			  query.value(1).toByteArray());
+	}
 
-	return QByteArray();
+	for (int i = 0; i < tiles.size(); i++) {
+		const DataTile &t = tiles.at(i);
+		list.append(DataTile(t.xy(), data.value(tileKey(zoom, t.xy())),
+		  t.key()));
+	}
+
+	return list;
 }
 
 void OsmdroidMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 {
-	Q_UNUSED(flags);
 	qreal scale = OSM::zoom2scale(_zoom, _tileSize);
 	QPoint tile = OSM::mercator2tile(QPointF(rect.topLeft().x() * scale,
 	  -rect.topLeft().y() * scale) * _mapRatio, _zoom);
@@ -253,19 +294,33 @@ void OsmdroidMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		for (int j = 0; j < height; j++) {
 			QPixmap pm;
 			QPoint t(tile.x() + i, tile.y() + j);
-			QString key = path() + "-" + QString::number(_zoom) + "_"
-			  + QString::number(t.x()) + "_" + QString::number(t.y());
+			quint64 key = TileCache::key(_zoom, t);
+
+			if (isRunning(key))
+				continue;
 
-			if (QPixmapCache::find(key, &pm)) {
+			if (_tileCache.find(key, &pm, _mapRatio)) {
 				QPointF tp(tl.x() + (t.x() - tile.x()) * tileSize(),
 				  tl.y() + (t.y() - tile.y()) * tileSize());
 				drawTile(painter, pm, tp);
-			} else
-				tiles.append(DataTile(t, tileData(_zoom, t), key));
+			} else if (_coverage.contains(_zoom, t))
+				tiles.append(DataTile(t, _zoom, this, key));
 		}
 	}
 
-	QFuture<void> future = QtConcurrent::map(tiles, &DataTile::load);
+	if (tiles.isEmpty())
+		return;
+	if (!(flags & Map::Block)) {
+		std::sort(tiles.begin(), tiles.end(), TileOrder<DataTile>(QPointF(
+		  tile.x() + (width - 1) / 2.0, tile.y() + (height - 1) / 2.0)));
+		runJob(new DataTileJob(tiles));
+		return;
+	}
+
+	/* All the tiles are needed at once, read them in a single batch */
+	tiles = tilesData(_zoom, tiles);
+	QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+	  tiles, &DataTile::load);
 	future.waitForFinished();
 
 	for (int i = 0; i < tiles.size(); i++) {
@@ -274,7 +329,7 @@ void OsmdroidMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		if (pm.isNull())
 			continue;
 
-		QPixmapCache::insert(mt.key(), pm);
+		_tileCache.insert(mt.key(), pm);
 
 		QPointF tp(tl.x() + (mt.xy().x() - tile.x()) * tileSize(),
 		  tl.y() + (mt.xy().y() - tile.y()) * tileSize());
@@ -288,6 +343,63 @@ void OsmdroidMap::drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp)
 	painter->drawPixmap(tp, pixmap);
 }
 
+bool OsmdroidMap::isRunning(quint64 key) const
+{
+	for (int i = 0; i < _jobs.size(); i++) {
+		const QList<DataTile> &tiles = _jobs.at(i)->tiles();
+		for (int j = 0; j < tiles.size(); j++)
+			if (tiles.at(j).key() == key)
+				return true;
+	}
+
+	return false;
+}
+
+void OsmdroidMap::runJob(DataTileJob *job)
+{
+	_jobs.append(job);
+
+	connect(job, &DataTileJob::finished, this, &OsmdroidMap::jobFinished);
+	job->run();
+}
+
+void OsmdroidMap::removeJob(DataTileJob *job)
+{
+	_jobs.removeOne(job);
+	job->deleteLater();
+}
+
+void OsmdroidMap::jobFinished(DataTileJob *job)
+{
+	const QList<DataTile> &tiles = job->tiles();
+
+	for (int i = 0; i < tiles.size(); i++) {
+		const DataTile &mt = tiles.at(i);
+		if (!mt.pixmap().isNull())
+			_tileCache.insert(mt.key(), mt.pixmap());
+	}
+
+	removeJob(job);
+
+	emit tilesLoaded();
+}
+
+void OsmdroidMap::cancelJobs(bool wait)
+{
+	for (int i = 0; i < _jobs.size(); i++)
+		_jobs.at(i)->cancel(wait);
+
+	/* Waiting cancels (unload) drop the jobs including the results of the
+	   jobs that finished but whose finished signal is still queued */
+	if (wait) {
+		while (!_jobs.isEmpty()) {
+			DataTileJob *job = _jobs.first();
+			job->disconnect(this);
+			removeJob(job);
+		}
+	}
+}
+
 QPointF OsmdroidMap::ll2xy(const Coordinates &c)
 {
 	qreal scale = OSM::zoom2scale(_zoom, _tileSize);
@@ -295,6 +407,11 @@ QPointF OsmdroidMap::ll2xy(const Coordinates &c)
 	return QPointF(m.x() / scale, m.y() / -scale) / _mapRatio;
 }
 
+void OsmdroidMap::ll2xy(const Coordinates *c, QPointF *p, int n)
+{
+	OSM::ll2xy(c, p, n, OSM::zoom2scale(_zoom, _tileSize), _mapRatio);
+}
+
 Coordinates OsmdroidMap::xy2ll(const QPointF &p)
 {
 	qreal scale = OSM::zoom2scale(_zoom, _tileSize);
@@ -202,7 +202,7 @@ bool OZF::open()
 	return true;
 }
 
-QPixmap OZF::tile(int zoom, int x, int y)
+QByteArray OZF::tileData(int zoom, int x, int y)
 {
 	Q_ASSERT(_file.isOpen());
 	Q_ASSERT(0 <= zoom && zoom < _zooms.count());
@@ -211,31 +211,41 @@ QPixmap OZF::tile(int zoom, int x, int y)
 
 	int i = (y/tileSize().height()) * z.dim.width() + (x/tileSize().width());
 	if (i >= z.tiles.size() - 1 || i < 0)
-		return QPixmap();
+		return QByteArray();
 
 	int size = z.tiles.at(i+1) - z.tiles.at(i);
 	if (!_file.seek(z.tiles.at(i)))
-		return QPixmap();
+		return QByteArray();
 
+	/* The data is prefixed with the uncompressed size as qUncompress()
+	   requires it */
 	quint32 bes = qToBigEndian(tileSize().width() * tileSize().height());
 	QByteArray ba;
 	ba.resize(sizeof(bes) + size);
 	memcpy(ba.data(), &bes, sizeof(bes));
 
 	if (!read(ba.data() + sizeof(bes), size, 16))
-		return QPixmap();
-	QByteArray uba = qUncompress(ba);
+		return QByteArray();
+
+	return ba;
+}
+
+QImage OZF::decode(int zoom, const QByteArray &data) const
+{
+	Q_ASSERT(0 <= zoom && zoom < _zooms.count());
+
+	QByteArray uba = qUncompress(data);
 	if (uba.size() != tileSize().width() * tileSize().height())
-		return QPixmap();
+		return QImage();
 
 	QImage img((const uchar*)uba.constData(), tileSize().width(),
 	  tileSize().height(), QImage::Format_Indexed8);
-	img.setColorTable(z.palette);
+	img.setColorTable(_zooms.at(zoom).palette);
 
 #if QT_VERSION < QT_VERSION_CHECK(6, 9, 0)
-	return QPixmap::fromImage(img.mirrored());
+	return img.mirrored();
 #else // QT 6.9
-	return QPixmap::fromImage(img.flipped());
+	return img.flipped();
 #endif // QT 6.9
 }
 
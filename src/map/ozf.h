@@ -8,8 +8,9 @@
 #include <QVector>
 #include <QFile>
 #include <QPixmap>
+#include "imagetile.h"
 
-class OZF
+class OZF : public TileDecoder
 {
 public:
 	OZF(const QString &name) : _tileSize(0), _decrypt(false), _key(0),
@@ -26,7 +27,8 @@ public:
 	QSize size(int zoom) const;
 	QPointF scale(int zoom) const;
 	QSize tileSize() const {return QSize(_tileSize, _tileSize);}
-	QPixmap tile(int zoom, int x, int y);
+	QByteArray tileData(int zoom, int x, int y);
+	QImage decode(int zoom, const QByteArray &data) const;
 
 	static bool isOZF(const QString &path);
 
@@ -14,6 +14,7 @@
 #include "mapfile.h"
 #include "gmifile.h"
 #include "rectd.h"
+#include "tileorder.h"
 #include "ozimap.h"
 
 
@@ -212,6 +213,8 @@ OziMap::OziMap(const QString &dirName, Tar &tar, const Projection &proj,
 
 OziMap::~OziMap()
 {
+	cancelJobs(true);
+
 	delete _img;
 	delete _tar;
 	delete _ozf;
@@ -334,6 +337,9 @@ void OziMap::load(const Projection &in, const Projection &out,
 
 void OziMap::unload()
 {
+	cancelJobs(true);
+	_tileCache.clear();
+
 	delete _img;
 	_img = 0;
 
@@ -382,46 +388,128 @@ void OziMap::drawTiled(QPainter *painter, const QRectF &rect) const
 	}
 }
 
-void OziMap::drawOZF(QPainter *painter, const QRectF &rect) const
+void OziMap::drawOZF(QPainter *painter, const QRectF &rect, Flags flags)
 {
 	QSizeF ts(_ozf->tileSize().width() / _mapRatio, _ozf->tileSize().height()
 	  / _mapRatio);
 	QPointF tl(floor(rect.left() / ts.width()) * ts.width(),
 	  floor(rect.top() / ts.height()) * ts.height());
+	QList<ImageTile> tiles;
 
 	QSizeF s(rect.right() - tl.x(), rect.bottom() - tl.y());
-	for (int i = 0; i < ceil(s.width() / ts.width()); i++) {
-		for (int j = 0; j < ceil(s.height() / ts.height()); j++) {
+	int width = ceil(s.width() / ts.width());
+	int height = ceil(s.height() / ts.height());
+	for (int i = 0; i < width; i++) {
+		for (int j = 0; j < height; j++) {
 			int x = round(tl.x() * _mapRatio + i * _ozf->tileSize().width());
 			int y = round(tl.y() * _mapRatio + j * _ozf->tileSize().height());
-
+			QPointF tp(tl.x() + i * ts.width(), tl.y() + j * ts.height());
+			quint64 key = TileCache::key(_zoom, QPoint(
+			  x / _ozf->tileSize().width(), y / _ozf->tileSize().height()));
 			QPixmap pixmap;
-			QString key(_ozf->fileName() + "/" + QString::number(_zoom) + "_"
-			  + QString::number(x) + "_" + QString::number(y));
 
-			if (!QPixmapCache::find(key, &pixmap)) {
-				pixmap = _ozf->tile(_zoom, x, y);
-				if (!pixmap.isNull())
-					QPixmapCache::insert(key, pixmap);
-			}
+			if (isRunning(key))
+				continue;
 
-			if (pixmap.isNull())
-				qWarning("%s: error loading tile image", qUtf8Printable(key));
-			else {
+			if (_tileCache.find(key, &pixmap, _mapRatio)) {
 				pixmap.setDevicePixelRatio(_mapRatio);
-				QPointF tp(tl.x() + i * ts.width(), tl.y() + j * ts.height());
 				painter->drawPixmap(tp, pixmap);
-			}
+			} else
+				tiles.append(ImageTile(_ozf, _zoom, tp,
+				  _ozf->tileData(_zoom, x, y), key));
 		}
 	}
+
+	if (tiles.isEmpty())
+		return;
+	if (!(flags & Map::Block)) {
+		std::sort(tiles.begin(), tiles.end(),
+		  TileOrder<ImageTile>(rect.center() - QPointF(ts.width() / 2,
+		  ts.height() / 2)));
+		runJob(new ImageTileJob(tiles));
+		return;
+	}
+
+	QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+	  tiles, &ImageTile::load);
+	future.waitForFinished();
+
+	for (int i = 0; i < tiles.size(); i++) {
+		const ImageTile &mt = tiles.at(i);
+		QPixmap pixmap(mt.pixmap());
+		if (pixmap.isNull()) {
+			qWarning("%s: error loading tile image",
+			  qUtf8Printable(_ozf->fileName()));
+			continue;
+		}
+
+		_tileCache.insert(mt.key(), pixmap);
+		pixmap.setDevicePixelRatio(_mapRatio);
+		painter->drawPixmap(mt.xy(), pixmap);
+	}
 }
 
-void OziMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
+bool OziMap::isRunning(quint64 key) const
+{
+	for (int i = 0; i < _jobs.size(); i++) {
+		const QList<ImageTile> &tiles = _jobs.at(i)->tiles();
+		for (int j = 0; j < tiles.size(); j++)
+			if (tiles.at(j).key() == key)
+				return true;
+	}
+
+	return false;
+}
+
+void OziMap::runJob(ImageTileJob *job)
 {
-	Q_UNUSED(flags);
+	_jobs.append(job);
 
+	connect(job, &ImageTileJob::finished, this, &OziMap::jobFinished);
+	job->run();
+}
+
+void OziMap::removeJob(ImageTileJob *job)
+{
+	_jobs.removeOne(job);
+	job->deleteLater();
+}
+
+void OziMap::jobFinished(ImageTileJob *job)
+{
+	const QList<ImageTile> &tiles = job->tiles();
+
+	for (int i = 0; i < tiles.size(); i++) {
+		const ImageTile &mt = tiles.at(i);
+		if (!mt.pixmap().isNull())
+			_tileCache.insert(mt.key(), mt.pixmap());
+	}
+
+	removeJob(job);
+
+	emit tilesLoaded();
+}
+
+void OziMap::cancelJobs(bool wait)
+{
+	for (int i = 0; i < _jobs.size(); i++)
+		_jobs.at(i)->cancel(wait);
+
+	/* Waiting cancels (unload) drop the jobs including the results of the
+	   jobs that finished but whose finished signal is still queued */
+	if (wait) {
+		while (!_jobs.isEmpty()) {
+			ImageTileJob *job = _jobs.first();
+			job->disconnect(this);
+			removeJob(job);
+		}
+	}
+}
+
+void OziMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
+{
 	if (_ozf)
-		drawOZF(painter, rect);
+		drawOZF(painter, rect, flags);
 	else if (_img)
 		_img->draw(painter, rect, flags);
 	else if (_tile.isValid())
@@ -492,6 +580,8 @@ int OziMap::zoomOut()
 
 void OziMap::rescale(int zoom)
 {
+	cancelJobs(false);
+
 	_zoom = zoom;
 	_scale = _ozf->scale(zoom);
 }
@@ -4,6 +4,8 @@
 #include "transform.h"
 #include "projection.h"
 #include "calibrationpoint.h"
+#include "tilecache.h"
+#include "imagetilejob.h"
 #include "map.h"
 
 class Tar;
@@ -61,6 +63,9 @@ public:
 	static Map *createGMI(const QString &path, const Projection &proj,
 	  bool *isDir);
 
+private slots:
+	void jobFinished(ImageTileJob *job);
+
 private:
 	struct ImageInfo {
 		QSize size;
@@ -73,8 +78,12 @@ private:
 	bool setImageInfo(const QString &path);
 
 	void drawTiled(QPainter *painter, const QRectF &rect) const;
-	void drawOZF(QPainter *painter, const QRectF &rect) const;
+	void drawOZF(QPainter *painter, const QRectF &rect, Flags flags);
 	void drawImage(QPainter *painter, const QRectF &rect, Flags flags) const;
+	bool isRunning(quint64 key) const;
+	void runJob(ImageTileJob *job);
+	void removeJob(ImageTileJob *job);
+	void cancelJobs(bool wait);
 
 	void rescale(int zoom);
 	void computeTransform();
@@ -93,6 +102,8 @@ private:
 	QPointF _scale;
 	qreal _mapRatio;
 	QList<CalibrationPoint> _calibrationPoints;
+	TileCache _tileCache;
+	QList<ImageTileJob*> _jobs;
 
 	bool _valid;
 	QString _errorString;
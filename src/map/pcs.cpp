@@ -1,8 +1,10 @@
 #include <QFile>
 #include "common/csv.h"
+#include "lazylist.h"
 #include "pcs.h"
 
 QMap<int, PCS::Entry> PCS::_pcss = defaults();
+static LazyList pcsList;
 
 QMap<int, PCS::Entry> PCS::defaults()
 {
@@ -11,7 +13,7 @@ QMap<int, PCS::Entry> PCS::defaults()
 	return map;
 }
 
-PCS PCS::pcs(int id)
+PCS PCS::find(int id)
 {
 	QMap<int, Entry>::const_iterator it(_pcss.find(id));
 
@@ -23,7 +25,38 @@ PCS PCS::pcs(int id)
 	}
 }
 
+PCS PCS::pcs(int id)
+{
+	if (pcsList.isLoaded())
+		return find(id);
+
+	QMutexLocker locker(&pcsList.lock());
+	PCS pcs(find(id));
+	if (pcs.isNull() && load())
+		pcs = find(id);
+
+	return pcs;
+}
+
+/* The list is only registered here and loaded on the first lookup that
+   the defaults can not satisfy. */
 bool PCS::loadList(const QString &path)
+{
+	pcsList.setPath(path);
+	return true;
+}
+
+bool PCS::load()
+{
+	QString path(pcsList.take());
+	if (!path.isNull())
+		loadFile(path);
+	pcsList.setLoaded();
+
+	return !path.isNull();
+}
+
+bool PCS::loadFile(const QString &path)
 {
 	QFile file(path);
 	CSV csv(&file);
@@ -88,6 +121,11 @@ QList<KV<int, QString> > PCS::list()
 {
 	QList<KV<int, QString> > list;
 
+	if (!pcsList.isLoaded()) {
+		QMutexLocker locker(&pcsList.lock());
+		load();
+	}
+
 	for (QMap<int, Entry>::const_iterator it = _pcss.constBegin();
 	  it != _pcss.constEnd(); ++it)
 		list.append(KV<int, QString>(it.key(), it.value().name()));
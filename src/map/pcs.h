@@ -40,6 +40,9 @@ private:
 	};
 
 	static QMap<int, Entry> defaults();
+	static PCS find(int id);
+	static bool load();
+	static bool loadFile(const QString &path);
 
 	GCS _gcs;
 	Conversion _conversion;
@@ -7,23 +7,43 @@
 #include <QPixmap>
 #include "common/util.h"
 
+/* Source of the tile data for tiles that read their data in load(). As the
+   tiles are loaded in parallel, tileData() must be thread-safe. The data are
+   expected to be already uncompressed. */
+class PMTileSource
+{
+public:
+	virtual ~PMTileSource() {}
+	virtual QByteArray tileData(quint64 id) = 0;
+};
+
 class PMTile
 {
 public:
-	PMTile(int zoom, int overzoom, int scaledSize, int style, const QPoint &xy,
-	  const QByteArray &data, quint8 tc, const QString &key)
+	PMTile(int zoom, int overzoom, int scaledSize, bool mvt, int style,
+	  const QPoint &xy, const QByteArray &data, quint8 tc, quint64 key)
+	  : _zoom(zoom), _overzoom(overzoom), _scaledSize(scaledSize),
+	  _style(style), _xy(xy), _data(data), _source(0), _id(0), _key(key),
+	  _tc(tc), _mvt(mvt) {}
+	PMTile(int zoom, int overzoom, int scaledSize, bool mvt, int style,
+	  const QPoint &xy, PMTileSource *source, quint64 id, quint64 key)
 	  : _zoom(zoom), _overzoom(overzoom), _scaledSize(scaledSize),
-	  _style(style), _xy(xy), _data(data), _key(key), _tc(tc) {}
+	  _style(style), _xy(xy), _source(source), _id(id), _key(key), _tc(1),
+	  _mvt(mvt) {}
 
 	const QPoint &xy() const {return _xy;}
-	const QString &key() const {return _key;}
+	quint64 key() const {return _key;}
+	quint64 id() const {return _id;}
 	const QPixmap &pixmap() const {return _pixmap;}
 
 	void load() {
+		if (_source)
+			_data = _source->tileData(_id);
+
 		QByteArray data((_tc == 2) ? Util::gunzip(_data) : _data);
 		QBuffer buffer(&data);
 
-		if (_scaledSize) {
+		if (_mvt) {
 			QByteArray format(QByteArray::number(_zoom)
 			  + ';' + QByteArray::number(_overzoom)
 			  + ';' + QByteArray::number(_style));
@@ -32,6 +52,10 @@ public:
 			_pixmap = QPixmap::fromImageReader(&reader);
 		} else {
 			QImageReader reader(&buffer);
+			/* Raster tiles are decoded straight to the display size (JPEG
+			   uses DCT scaling) instead of being scaled on every draw */
+			if (_scaledSize)
+				reader.setScaledSize(QSize(_scaledSize, _scaledSize));
 			_pixmap = QPixmap::fromImageReader(&reader);
 		}
 	}
@@ -43,9 +67,12 @@ private:
 	int _style;
 	QPoint _xy;
 	QByteArray _data;
-	QString _key;
+	PMTileSource *_source;
+	quint64 _id;
+	quint64 _key;
 	QPixmap _pixmap;
 	quint8 _tc;
+	bool _mvt;
 };
 
 #endif // PMTILE_H
@@ -1,7 +1,8 @@
 #ifndef PMTILEJOB_H
 #define PMTILEJOB_H
 
-#include <QtConcurrent>
+#include "common/threadpools.h"
+#include "common/trace.h"
 #include "pmtile.h"
 
 class PMTileJob : public QObject
@@ -13,9 +14,10 @@ public:
 
 	void run()
 	{
+		_trace.start();
 		connect(&_watcher, &QFutureWatcher<void>::finished, this,
 		  &PMTileJob::handleFinished);
-		_future = QtConcurrent::map(_tiles, &PMTile::load);
+		_future = ThreadPools::map(ThreadPools::Render, _tiles, &PMTile::load);
 		_watcher.setFuture(_future);
 	}
 	void cancel(bool wait)
@@ -30,11 +32,16 @@ signals:
 	void finished(PMTileJob *job);
 
 private slots:
-	void handleFinished() {emit finished(this);}
+	void handleFinished()
+	{
+		_trace.end("job", "PMTileJob");
+		emit finished(this);
+	}
 
 private:
 	QFutureWatcher<void> _watcher;
 	QFuture<void> _future;
+	Trace::Span _trace;
 	QList<PMTile> _tiles;
 };
 
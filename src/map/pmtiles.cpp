@@ -1,4 +1,4 @@
-#include <QFile>
+#include <QIODevice>
 #include <QDataStream>
 #include "common/util.h"
 #include "pmtiles.h"
@@ -19,9 +19,9 @@ static bool varint(char **bp, const char *be, T &val)
 	return false;
 }
 
-bool PMTiles::readHeader(QFile &file, Header &hdr, QString &err)
+bool PMTiles::readHeader(QIODevice &dev, Header &hdr, QString &err)
 {
-	QDataStream stream(&file);
+	QDataStream stream(&dev);
 	stream.setByteOrder(QDataStream::LittleEndian);
 	stream >> hdr.magic >> hdr.rootOffset >> hdr.rootLength
 	  >> hdr.metadataOffset >> hdr.metadataLength >> hdr.leafOffset
@@ -77,25 +77,33 @@ const PMTiles::Directory *PMTiles::findDir(const QVector<Directory> &list,
 	return 0;
 }
 
-QByteArray PMTiles::readData(QFile &file, quint64 offset, quint64 size,
+QByteArray PMTiles::readData(QIODevice &dev, quint64 offset, quint64 size,
   quint8 compression)
 {
 	QByteArray ba;
 
-	if (!file.seek(offset))
+	if (!dev.seek(offset))
 		return QByteArray();
 
 	ba.resize(size);
-	if (file.read(ba.data(), ba.size()) != ba.size())
+	if (dev.read(ba.data(), ba.size()) != ba.size())
 		return QByteArray();
 
 	return (compression == 2) ? Util::gunzip(ba) : ba;
 }
 
-QVector<PMTiles::Directory> PMTiles::readDir(QFile &file, quint64 offset,
+QVector<PMTiles::Directory> PMTiles::readDir(QIODevice &dev, quint64 offset,
   quint64 size, quint8 compression)
 {
-	QByteArray uba(readData(file, offset, size, compression));
+	return readDir(readData(dev, offset, size, 1), compression);
+}
+
+QVector<PMTiles::Directory> PMTiles::readDir(const QByteArray &data,
+  quint8 compression)
+{
+	if (data.isNull())
+		return QVector<Directory>();
+	QByteArray uba((compression == 2) ? Util::gunzip(data) : data);
 	if (uba.isNull())
 		return QVector<Directory>();
 
@@ -4,7 +4,7 @@
 #include <QByteArray>
 #include "common/coordinates.h"
 
-class QFile;
+class QIODevice;
 class QPoint;
 
 namespace PMTiles
@@ -41,12 +41,13 @@ namespace PMTiles
 		quint32 runLength;
 	};
 
-	bool readHeader(QFile &file, Header &hdr, QString &err);
+	bool readHeader(QIODevice &dev, Header &hdr, QString &err);
 	const Directory *findDir(const QVector<Directory> &list,
 	  quint64 tileId);
-	QVector<Directory> readDir(QFile &file, quint64 offset, quint64 size,
+	QVector<Directory> readDir(QIODevice &dev, quint64 offset, quint64 size,
 	  quint8 compression);
-	QByteArray readData(QFile &file, quint64 offset, quint64 size,
+	QVector<Directory> readDir(const QByteArray &data, quint8 compression);
+	QByteArray readData(QIODevice &dev, quint64 offset, quint64 size,
 	  quint8 compression);
 	quint64 id(unsigned zoom, const QPoint &tile);
 	inline Coordinates pos(qint32 lon, qint32 lat)
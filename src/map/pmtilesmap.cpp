@@ -1,40 +1,87 @@
 #include <QPainter>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QPixmapCache>
+#include <QDir>
+#include "common/programpaths.h"
 #include "osm.h"
+#include "tileorder.h"
 #include "pmtilesmap.h"
 
 #define MAX_TILE_SIZE   4096
-#define LEAF_CACHE_SIZE 16
+#define LEAF_CACHE_SIZE 262144 /* directory entries */
+#define MAX_DIR_DEPTH   4
+#define HEADER_SIZE     127
+#define DATA_CACHE_SIZE 16384 /* KB */
 
 using namespace PMTiles;
 
 PMTilesMap::PMTilesMap(const QString &fileName, QObject *parent)
-  : Map(fileName, parent), _file(fileName), _style(0), _mapRatio(1.0),
-  _tileRatio(1.0), _mvt(false), _scaledSize(0), _valid(false)
+  : Map(fileName, parent), _file(fileName), _loader(0), _zoom(0), _style(0),
+  _mapRatio(1.0), _tileRatio(1.0), _deviceRatio(1.0), _mvt(false),
+  _scaledSize(0), _valid(false), _ready(true), _pending(false)
 {
 	if (!_file.open(QIODevice::ReadOnly)) {
 		_errorString = _file.errorString();
 		return;
 	}
 
+	_valid = init();
+
+	_file.close();
+}
+
+PMTilesMap::PMTilesMap(const QString &fileName, const QString &name,
+  const QUrl &url, const QList<HTTPHeader> &headers,
+  const NetworkProfile &profile, QObject *parent)
+  : Map(fileName, parent), _name(name), _zoom(0), _style(0), _mapRatio(1.0),
+  _tileRatio(1.0), _deviceRatio(1.0), _mvt(false), _scaledSize(0),
+  _valid(true), _ready(false), _pending(true)
+{
+	QString dir(QDir(ProgramPaths::tilesDir()).filePath(name));
+
+	_loader = new BlockLoader(url, dir, this);
+	_loader->setHeaders(headers);
+	_loader->setNetworkProfile(profile);
+	connect(_loader, &BlockLoader::finished, this, &PMTilesMap::blocksLoaded);
+	connect(_loader, &BlockLoader::changed, this, &PMTilesMap::archiveChanged);
+
+	/* The map is initialized from the blocks cache when possible, the cache
+	   is validated against the remote archive in the background. Otherwise
+	   the validation download (the archive's first block) is the first step
+	   of the initialization. */
+	bool cached = _loader->isCached(0, HEADER_SIZE);
+	if (cached)
+		initRemote();
+	if (!_loader->validate() && !cached)
+		initRemote();
+}
+
+/* Remote archives: the data not yet in the blocks cache are appended to
+   missing and init() returns false, it is re-run once they get loaded. */
+bool PMTilesMap::init(QList<BlockLoader::Range> *missing)
+{
 	// header
 	Header hdr;
-	if (!readHeader(_file, hdr, _errorString))
-		return;
+	QByteArray ba(initData(0, HEADER_SIZE, missing));
+	if (missing && !missing->isEmpty())
+		return false;
+	QBuffer buffer(&ba);
+	buffer.open(QIODevice::ReadOnly);
+	if (!readHeader(buffer, hdr, _errorString))
+		return false;
 
 	_bounds = RectC(pos(hdr.minLon, hdr.maxLat), pos(hdr.maxLon, hdr.minLat));
 	if (!_bounds.isValid()) {
 		_errorString = "Invalid map bounds";
-		return;
+		return false;
 	}
 
+	_zoomsBase.clear();
 	for (int i = hdr.minZ; i <= hdr.maxZ; i++)
 		_zoomsBase.append(Zoom(i, i));
 	if (_zoomsBase.isEmpty()) {
 		_errorString = "Invalid zoom levels range";
-		return;
+		return false;
 	}
 	_zoom = _zoomsBase.size() - 1;
 
@@ -43,22 +90,28 @@ PMTilesMap::PMTilesMap(const QString &fileName, QObject *parent)
 	_tc = hdr.tc;
 	_ic = hdr.ic;
 
+	QByteArray md(hdr.metadataLength ? initData(hdr.metadataOffset,
+	  hdr.metadataLength, missing) : QByteArray());
+	QByteArray rd(initData(hdr.rootOffset, hdr.rootLength, missing));
+	if (missing && !missing->isEmpty())
+		return false;
+
 	// metadata
 	QStringList vectorLayers;
 	if (hdr.metadataLength) {
-		QByteArray uba(readData(_file, hdr.metadataOffset, hdr.metadataLength,
-		  hdr.ic));
+		QByteArray uba((hdr.ic == 2) ? Util::gunzip(md) : md);
 		if (uba.isNull())
-			qWarning("%s: error reading metadata", qUtf8Printable(fileName));
+			qWarning("%s: error reading metadata", qUtf8Printable(path()));
 		else {
 			QJsonParseError error;
 			QJsonDocument doc(QJsonDocument::fromJson(uba, &error));
 			if (doc.isNull())
-				qWarning("%s: metadata error: %s", qUtf8Printable(fileName),
+				qWarning("%s: metadata error: %s", qUtf8Printable(path()),
 				  qUtf8Printable(error.errorString()));
 			else {
 				QJsonObject json(doc.object());
-				_name = json["name"].toString();
+				if (_name.isEmpty())
+					_name = json["name"].toString();
 				QJsonArray vl(json["vector_layers"].toArray());
 				for (int i = 0; i < vl.size(); i++)
 					vectorLayers.append(vl.at(i).toObject()["id"].toString());
@@ -67,26 +120,24 @@ PMTilesMap::PMTilesMap(const QString &fileName, QObject *parent)
 	}
 
 	// root directory
-	_root = readDir(_file, hdr.rootOffset, hdr.rootLength, hdr.ic);
+	_root = readDir(rd, hdr.ic);
 	if (_root.isEmpty()) {
 		_errorString = "Error reading root directory";
-		return;
+		return false;
 	}
 
 	// tile size
-	QByteArray data;
-	if (_tc == 2) {
-		QByteArray gzip(tileData(_root.first().tileId));
-		data = Util::gunzip(gzip);
-	} else
-		data = tileData(_root.first().tileId);
-	QBuffer buffer(&data);
-	QImageReader reader(&buffer);
+	quint64 id = _root.first().tileId;
+	if (_loader && !isCached(id, *missing))
+		return false;
+	QByteArray data(tileData(id));
+	QBuffer tileBuffer(&data);
+	QImageReader reader(&tileBuffer);
 
 	QSize tileSize(reader.size());
 	if (!tileSize.isValid() || tileSize.width() != tileSize.height()) {
 		_errorString = "Unsupported/invalid tile images";
-		return;
+		return false;
 	}
 	_tileSize = tileSize.width();
 
@@ -97,11 +148,63 @@ PMTilesMap::PMTilesMap(const QString &fileName, QObject *parent)
 		_mvt = true;
 	}
 
-	_file.close();
-
 	_cache.setMaxCost(LEAF_CACHE_SIZE);
+	_dataCache.setMaxCost(DATA_CACHE_SIZE);
+
+	return true;
+}
+
+/* The header, the metadata, the root directory and the first tile (with its
+   leaf directories) are loaded asynchronously, init() is re-run on every
+   finished download until all of them are in the blocks cache */
+void PMTilesMap::initRemote()
+{
+	QList<BlockLoader::Range> missing;
+	int zoom = _zoom;
+
+	bool valid = init(&missing);
+	if (!missing.isEmpty()) {
+		if (_loader->loadAsync(missing))
+			return;
+		_errorString = "Error downloading map data";
+	}
+
+	_pending = false;
+	_valid = valid;
 
-	_valid = true;
+	if (_ready) {
+		if (_valid) {
+			initZooms();
+			_zoom = qMin(zoom, _zooms.size() - 1);
+		}
+		emit tilesLoaded();
+	} else {
+		_ready = true;
+		emit mapLoaded();
+	}
+}
+
+void PMTilesMap::blocksLoaded()
+{
+	if (_pending)
+		initRemote();
+	else
+		emit tilesLoaded();
+}
+
+/* The remote archive has been replaced, all the cached data are stale */
+void PMTilesMap::archiveChanged()
+{
+	cancelJobs(true);
+	_tileCache.clear();
+
+	_lock.lock();
+	_cache.clear();
+	_dataCache.clear();
+	_lock.unlock();
+
+	_pending = true;
+	initRemote();
 }
 
 void PMTilesMap::load(const Projection &in, const Projection &out,
@@ -112,13 +215,24 @@ void PMTilesMap::load(const Projection &in, const Projection &out,
 	Q_UNUSED(layer);
 
 	_mapRatio = hidpi ? deviceRatio : 1.0;
+	_deviceRatio = deviceRatio;
+	if (style >= 0 && style < _styles.size())
+		_style = style;
+
+	initZooms();
+
+	if (!_loader && !_file.open(QIODevice::ReadOnly))
+		qWarning("%s: %s", qUtf8Printable(_file.fileName()),
+		  qUtf8Printable(_file.errorString()));
+}
+
+void PMTilesMap::initZooms()
+{
 	_zooms = _zoomsBase;
 
 	if (_mvt) {
-		_scaledSize = _tileSize * deviceRatio;
-		_tileRatio = deviceRatio;
-		if (style >= 0 && style < _styles.size())
-			_style = style;
+		_scaledSize = _tileSize * _deviceRatio;
+		_tileRatio = _deviceRatio;
 
 		for (int i = _zooms.last().base + 1; i <= OSM::ZOOMS.max(); i++) {
 			Zoom z(i, _zooms.last().base);
@@ -127,12 +241,10 @@ void PMTilesMap::load(const Projection &in, const Projection &out,
 			_zooms.append(Zoom(i, _zooms.last().base));
 		}
 
-		QPixmapCache::clear();
-	}
-
-	if (!_file.open(QIODevice::ReadOnly))
-		qWarning("%s: %s", qUtf8Printable(_file.fileName()),
-		  qUtf8Printable(_file.errorString()));
+		_tileCache.setVariant(TileCache::variant(_style, -1));
+	} else
+		_scaledSize = (_mapRatio > 1.0 || _deviceRatio == _tileRatio)
+		  ? 0 : qRound(_tileSize * _deviceRatio / _tileRatio);
 }
 
 void PMTilesMap::unload()
@@ -140,6 +252,15 @@ void PMTilesMap::unload()
 	cancelJobs(true);
 	_file.close();
 	_cache.clear();
+	_tileCache.clear();
+}
+
+void PMTilesMap::restyle(const Projection &in, const Projection &out,
+  qreal deviceRatio, bool hidpi, int style, int layer)
+{
+	/* Keep the tiles of the current style for a quick switch back */
+	_tileCache.keep();
+	Map::restyle(in, out, deviceRatio, hidpi, style, layer);
 }
 
 QString PMTilesMap::name() const
@@ -201,7 +322,12 @@ qreal PMTilesMap::coordinatesRatio() const
 
 qreal PMTilesMap::imageRatio() const
 {
-	return _mapRatio > 1.0 ? _mapRatio : _tileRatio;
+	if (_mapRatio > 1.0)
+		return _mapRatio;
+	if (_scaledSize && !_mvt)
+		return (_scaledSize * _tileRatio) / _tileSize;
+
+	return _tileRatio;
 }
 
 qreal PMTilesMap::tileSize() const
@@ -209,27 +335,152 @@ qreal PMTilesMap::tileSize() const
 	return (_tileSize / coordinatesRatio());
 }
 
+QByteArray PMTilesMap::rawData(quint64 offset, quint64 size)
+{
+	return _loader
+	  ? _loader->read(offset, size) : readData(_file, offset, size, 1);
+}
+
+QByteArray PMTilesMap::initData(quint64 offset, quint64 size,
+  QList<BlockLoader::Range> *missing)
+{
+	if (_loader && !_loader->isCached(offset, size)) {
+		missing->append(BlockLoader::Range(offset, size));
+		return QByteArray();
+	}
+
+	return rawData(offset, size);
+}
+
 QByteArray PMTilesMap::tileData(quint64 id)
 {
-	const Directory *d = findDir(_root, id);
-	if (!d)
+	/* Called from the tile loading threads, the file and the caches are
+	   shared */
+	QMutexLocker locker(&_lock);
+	quint64 offset, length;
+
+	QByteArray *cached = _dataCache.object(id);
+	if (cached)
+		return *cached;
+
+	if (!tileLocation(id, offset, length, 0) || !length)
 		return QByteArray();
-	if (!d->runLength) {
-		QVector<Directory> *leaf = _cache.object(d->offset);
-		if (!leaf) {
-			leaf = new QVector<Directory>(readDir(_file, _leafOffset + d->offset,
-			  d->length, _ic));
-			_cache.insert(d->offset, leaf);
+	QByteArray data(rawData(offset, length));
+
+	locker.unlock();
+	QByteArray uba((_tc == 2) ? Util::gunzip(data) : data);
+
+	/* The vector tiles are decoded for every overzoom level and style, keep
+	   the uncompressed data to not read and gunzip the same base tile
+	   repeatedly. The cache is deliberately kept on unload(), style changes
+	   reload the map. */
+	if (_mvt && !uba.isEmpty()) {
+		locker.relock();
+		_dataCache.insert(id, new QByteArray(uba), qMax(uba.size() / 1024, 1));
+	}
+
+	return uba;
+}
+
+/* Finds the tile data location, zero length means that the tile does not
+   exist. Entries with zero run length point to leaf directories that may
+   again point to deeper leaf directories. Returns false when a leaf directory
+   is not available, its location is appended to missing if not yet in the
+   blocks cache. Must be called with the lock held. */
+bool PMTilesMap::tileLocation(quint64 id, quint64 &offset, quint64 &length,
+  QList<BlockLoader::Range> *missing)
+{
+	const QVector<Directory> *dir = &_root;
+
+	length = 0;
+	for (int i = 0; i < MAX_DIR_DEPTH; i++) {
+		const Directory *d = findDir(*dir, id);
+		if (!d)
+			return true;
+		if (d->runLength) {
+			offset = _tileOffset + d->offset;
+			length = d->length;
+			return true;
 		}
-		const Directory *l = findDir(*leaf, id);
-		return (l)
-		  ? readData(_file, _tileOffset + l->offset, l->length, 1)
-		  : QByteArray();
-	} else
-		return readData(_file, _tileOffset + d->offset, d->length, 1);
+
+		if (!(dir = leafDir(d->offset, d->length))) {
+			if (missing)
+				missing->append(BlockLoader::Range(_leafOffset + d->offset,
+				  d->length));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+const QVector<Directory> *PMTilesMap::leafDir(quint64 offset, quint64 length)
+{
+	QVector<Directory> *leaf = _cache.object(offset);
+
+	if (!leaf) {
+		QByteArray data(rawData(_leafOffset + offset, length));
+		if (data.isNull())
+			return 0;
+
+		leaf = new QVector<Directory>(readDir(data, _ic));
+		/* The cost is limited to the cache size, so that the insert never
+		   fails (and deletes the leaf) */
+		_cache.insert(offset, leaf, qBound(1, leaf->size(), LEAF_CACHE_SIZE));
+	}
+
+	return leaf;
+}
+
+bool PMTilesMap::isCached(quint64 id, QList<BlockLoader::Range> &missing)
+{
+	QMutexLocker locker(&_lock);
+	quint64 offset, length;
+
+	if (!tileLocation(id, offset, length, &missing))
+		return false;
+	if (_loader->isCached(offset, length))
+		return true;
+
+	missing.append(BlockLoader::Range(offset, length));
+
+	return false;
+}
+
+/* The leaf directories locations are known only once their parent directories
+   are loaded, so the blocks are loaded in up to MAX_DIR_DEPTH + 1 rounds. Used
+   only for the blocking draws (printing, export). */
+void PMTilesMap::loadSync(const QVector<quint64> &ids)
+{
+	for (int i = 0; i <= MAX_DIR_DEPTH; i++) {
+		QList<BlockLoader::Range> missing;
+		for (int j = 0; j < ids.size(); j++)
+			isCached(ids.at(j), missing);
+		if (missing.isEmpty())
+			break;
+
+		_loader->loadSync(missing);
+	}
 }
 
-bool PMTilesMap::isRunning(const QString &key) const
+/* Only the tiles that can be loaded from the blocks cache are kept in the list,
+   the other tiles are drawn once the missing blocks get downloaded */
+void PMTilesMap::loadAsync(QList<PMTile> &tiles)
+{
+	QList<BlockLoader::Range> missing;
+
+	for (int i = 0; i < tiles.size(); ) {
+		if (isCached(tiles.at(i).id(), missing))
+			i++;
+		else
+			tiles.removeAt(i);
+	}
+
+	if (!missing.isEmpty())
+		_loader->loadAsync(missing);
+}
+
+bool PMTilesMap::isRunning(quint64 key) const
 {
 	for (int i = 0; i < _jobs.size(); i++) {
 		const QList<PMTile> &tiles = _jobs.at(i)->tiles();
@@ -262,7 +513,7 @@ void PMTilesMap::jobFinished(PMTileJob *job)
 	for (int i = 0; i < tiles.size(); i++) {
 		const PMTile &mt = tiles.at(i);
 		if (!mt.pixmap().isNull())
-			QPixmapCache::insert(mt.key(), mt.pixmap());
+			_tileCache.insert(mt.key(), mt.pixmap());
 	}
 
 	removeJob(job);
@@ -285,6 +536,10 @@ QPointF PMTilesMap::tilePos(const QPointF &tl, const QPoint &tc,
 
 void PMTilesMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 {
+	/* The archive is being re-initialized after a remote change */
+	if (_pending)
+		return;
+
 	const Zoom &zoom = _zooms.at(_zoom);
 	unsigned overzoom = zoom.z - zoom.base;
 	qreal scale = OSM::zoom2scale(zoom.base, _tileSize << overzoom);
@@ -303,24 +558,37 @@ void PMTilesMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		for (int j = 0; j < height; j++) {
 			QPixmap pm;
 			QPoint t(tile.x() + i, tile.y() + j);
-			QString key = path() + "-" + QString::number(zoom.z) + "_"
-			  + QString::number(t.x()) + "_" + QString::number(t.y());
+			quint64 key = TileCache::key(zoom.z, t);
 
 			if (isRunning(key))
 				continue;
 
-			if (QPixmapCache::find(key, &pm)) {
+			if (_tileCache.find(key, &pm, imageRatio())) {
 				QPointF tp(tilePos(tl, t, tile, overzoom));
 				drawTile(painter, pm, tp);
 			} else
-				tiles.append(PMTile(zoom.z, overzoom, _scaledSize, _style, t,
-				  tileData(id(zoom.base, t)), _tc, key));
+				tiles.append(PMTile(zoom.z, overzoom, _scaledSize, _mvt,
+				  _style, t, this, id(zoom.base, t), key));
 		}
 	}
 
+	if (_loader && !tiles.isEmpty()) {
+		if (flags & Map::Block) {
+			QVector<quint64> ids;
+			for (int i = 0; i < tiles.size(); i++)
+				ids.append(tiles.at(i).id());
+			loadSync(ids);
+		} else
+			loadAsync(tiles);
+	}
+
+	std::sort(tiles.begin(), tiles.end(), TileOrder<PMTile>(QPointF(tile.x()
+	  + (width - 1) / 2.0, tile.y() + (height - 1) / 2.0)));
+
 	if (!tiles.isEmpty()) {
 		if (flags & Map::Block || !_mvt) {
-			QFuture<void> future = QtConcurrent::map(tiles, &PMTile::load);
+			QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+			  tiles, &PMTile::load);
 			future.waitForFinished();
 
 			for (int i = 0; i < tiles.size(); i++) {
@@ -329,7 +597,7 @@ void PMTilesMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 				if (pm.isNull())
 					continue;
 
-				QPixmapCache::insert(mt.key(), pm);
+				_tileCache.insert(mt.key(), pm);
 
 				QPointF tp(tilePos(tl, mt.xy(), tile, overzoom));
 				drawTile(painter, pm, tp);
@@ -352,6 +620,12 @@ QPointF PMTilesMap::ll2xy(const Coordinates &c)
 	return QPointF(m.x() / scale, m.y() / -scale) / coordinatesRatio();
 }
 
+void PMTilesMap::ll2xy(const Coordinates *c, QPointF *p, int n)
+{
+	OSM::ll2xy(c, p, n, OSM::zoom2scale(_zooms.at(_zoom).z, _tileSize),
+	  coordinatesRatio());
+}
+
 Coordinates PMTilesMap::xy2ll(const QPointF &p)
 {
 	qreal scale = OSM::zoom2scale(_zooms.at(_zoom).z, _tileSize);
@@ -370,6 +644,13 @@ int PMTilesMap::defaultStyle(const QStringList &vectorLayers)
 	return 0;
 }
 
+void PMTilesMap::clearCache()
+{
+	if (_loader)
+		_loader->clearCache();
+	_tileCache.clear();
+}
+
 QStringList PMTilesMap::styles(int &defaultStyle) const
 {
 	QStringList list;
@@ -2,20 +2,26 @@
 #define PMTILESMAP_H
 
 #include <QFile>
+#include <QMutex>
 #include "common/rectc.h"
 #include "pmtiles.h"
 #include "pmtilejob.h"
 #include "mvtstyle.h"
 #include "map.h"
+#include "tilecache.h"
+#include "blockloader.h"
 
 
-class PMTilesMap : public Map
+class PMTilesMap : public Map, public PMTileSource
 {
 public:
 	Q_OBJECT
 
 public:
 	PMTilesMap(const QString &fileName, QObject *parent = 0);
+	PMTilesMap(const QString &fileName, const QString &name, const QUrl &url,
+	  const QList<HTTPHeader> &headers, const NetworkProfile &profile,
+	  QObject *parent = 0);
 
 	QString name() const;
 
@@ -31,15 +37,20 @@ public:
 
 	QPointF ll2xy(const Coordinates &c);
 	Coordinates xy2ll(const QPointF &p);
+	void ll2xy(const Coordinates *c, QPointF *p, int n);
 
 	void draw(QPainter *painter, const QRectF &rect, Flags flags);
 
 	void load(const Projection &in, const Projection &out, qreal deviceRatio,
 	  bool hidpi, int style, int layer);
 	void unload();
+	void restyle(const Projection &in, const Projection &out,
+	  qreal deviceRatio, bool hidpi, int style, int layer);
 
 	QStringList styles(int &defaultStyle) const;
+	void clearCache();
 
+	bool isReady() const {return _valid && _ready;}
 	bool isValid() const {return _valid;}
 	QString errorString() const {return _errorString;}
 
@@ -47,6 +58,8 @@ public:
 
 private slots:
 	void jobFinished(PMTileJob *job);
+	void blocksLoaded();
+	void archiveChanged();
 
 private:
 	struct Zoom {
@@ -62,9 +75,21 @@ private:
 	qreal tileSize() const;
 	qreal coordinatesRatio() const;
 	qreal imageRatio() const;
+	bool init(QList<BlockLoader::Range> *missing = 0);
+	void initRemote();
+	void initZooms();
+	QByteArray rawData(quint64 offset, quint64 size);
+	QByteArray initData(quint64 offset, quint64 size,
+	  QList<BlockLoader::Range> *missing);
 	QByteArray tileData(quint64 id);
+	bool tileLocation(quint64 id, quint64 &offset, quint64 &length,
+	  QList<BlockLoader::Range> *missing);
+	const QVector<PMTiles::Directory> *leafDir(quint64 offset, quint64 length);
+	bool isCached(quint64 id, QList<BlockLoader::Range> &missing);
+	void loadSync(const QVector<quint64> &ids);
+	void loadAsync(QList<PMTile> &tiles);
 	void drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp);
-	bool isRunning(const QString &key) const;
+	bool isRunning(quint64 key) const;
 	void runJob(PMTileJob *job);
 	void removeJob(PMTileJob *job);
 	void cancelJobs(bool wait);
@@ -72,10 +97,13 @@ private:
 	int defaultStyle(const QStringList &vectorLayers);
 
 	QFile _file;
+	BlockLoader *_loader;
+	QMutex _lock;
 	QString _name;
 	RectC _bounds;
 	QVector<PMTiles::Directory> _root;
 	QCache<quint64, QVector<PMTiles::Directory> > _cache;
+	QCache<quint64, QByteArray> _dataCache;
 	quint64 _tileOffset, _leafOffset;
 	quint8 _tc, _ic;
 	QVector<Zoom> _zooms, _zoomsBase;
@@ -83,13 +111,14 @@ private:
 	int _zoom;
 	int _tileSize;
 	int _style;
-	qreal _mapRatio, _tileRatio;
+	qreal _mapRatio, _tileRatio, _deviceRatio;
 	bool _mvt;
 	int _scaledSize;
 
 	QList<PMTileJob*> _jobs;
+	TileCache _tileCache;
 
-	bool _valid;
+	bool _valid, _ready, _pending;
 	QString _errorString;
 };
 
@@ -112,6 +112,12 @@ PointD LambertConic1::ll2xy(const Coordinates &c) const
 	  * cos(theta) + _falseNorthing);
 }
 
+void LambertConic1::ll2xy(const Coordinates *c, PointD *p, int n) const
+{
+	for (int i = 0; i < n; i++)
+		p[i] = LambertConic1::ll2xy(c[i]);
+}
+
 Coordinates LambertConic1::xy2ll(const PointD &p) const
 {
 	double dx;
@@ -18,6 +18,7 @@ public:
 
 	virtual PointD ll2xy(const Coordinates &c) const;
 	virtual Coordinates xy2ll(const PointD &p) const;
+	virtual void ll2xy(const Coordinates *c, PointD *p, int n) const;
 
 private:
 	double _longitudeOrigin;
@@ -44,6 +45,8 @@ public:
 
 	virtual PointD ll2xy(const Coordinates &c) const;
 	virtual Coordinates xy2ll(const PointD &p) const;
+	virtual void ll2xy(const Coordinates *c, PointD *p, int n) const
+	  {_lc1.ll2xy(c, p, n);}
 
 private:
 	LambertConic1 _lc1;
@@ -101,6 +101,12 @@ PointD Mercator::ll2xy(const Coordinates &c) const
 	  _scaleFactor * _a * log(ctanz2) + _falseNorthing);
 }
 
+void Mercator::ll2xy(const Coordinates *c, PointD *p, int n) const
+{
+	for (int i = 0; i < n; i++)
+		p[i] = Mercator::ll2xy(c[i]);
+}
+
 Coordinates Mercator::xy2ll(const PointD &p) const
 {
 	double dx;
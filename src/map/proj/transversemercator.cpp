@@ -46,8 +46,8 @@ Defense.
 #include "transversemercator.h"
 
 
-#define SPHSN(lat) \
-	((double)(_a / sqrt(1.e0 - _es * pow(sin(lat), 2))))
+#define SPHSN(sl) \
+	((double)(_a / sqrt(1.e0 - _es * (sl) * (sl))))
 #define SPHTMD(lat) \
 	((double)(_ap * lat - _bp * sin(2.e0 * lat) + _cp * sin(4.e0 * lat) \
 	  - _dp * sin(6.e0 * lat) + _ep * sin(8.e0 * lat)))
@@ -89,6 +89,8 @@ TransverseMercator::TransverseMercator(const Ellipsoid &ellipsoid,
 	_cp = 15.e0 * _a * (tn2 - tn3 + 3.e0 * (tn4 - tn5 ) / 4.e0) / 16.0;
 	_dp = 35.e0 * _a * (tn3 - tn4 + 11.e0 * tn5 / 16.e0) / 48.e0;
 	_ep = 315.e0 * _a * (tn4 - tn5) / 512.e0;
+
+	_tmdo = SPHTMD(_latitudeOrigin);
 }
 
 PointD TransverseMercator::ll2xy(const Coordinates &c) const
@@ -100,7 +102,8 @@ PointD TransverseMercator::ll2xy(const Coordinates &c) const
 	double sl, sn;
 	double t, tan2, tan3, tan4, tan5, tan6;
 	double t1, t2, t3, t4, t5, t6, t7, t8, t9;
-	double tmd, tmdo;
+	double tmd;
+	double dlam2, dlam3;
 	double x, y;
 
 
@@ -131,12 +134,11 @@ PointD TransverseMercator::ll2xy(const Coordinates &c) const
 	eta3 = eta2 * eta;
 	eta4 = eta3 * eta;
 
-	sn = SPHSN(rl);
+	sn = SPHSN(sl);
 	tmd = SPHTMD(rl);
-	tmdo = SPHTMD (_latitudeOrigin);
 
 
-	t1 = (tmd - tmdo) * _scale;
+	t1 = (tmd - _tmdo) * _scale;
 	t2 = sn * sl * cl * _scale / 2.e0;
 	t3 = sn * sl * c3 * _scale * (5.e0 - tan2 + 9.e0 * eta + 4.e0 * eta2)
 	  / 24.e0;
@@ -147,8 +149,10 @@ PointD TransverseMercator::ll2xy(const Coordinates &c) const
 	t5 = sn * sl * c7 * _scale * (1385.e0 - 3111.e0 * tan2 + 543.e0 * tan4
 	  - tan6) / 40320.e0;
 
-	y = _falseNorthing + t1 + pow(dlam, 2.e0) * t2 + pow(dlam, 4.e0) * t3
-	  + pow(dlam, 6.e0) * t4 + pow(dlam, 8.e0) * t5;
+	/* Horner scheme instead of the pow() calls */
+	dlam2 = dlam * dlam;
+	y = _falseNorthing + t1 + dlam2 * (t2 + dlam2 * (t3 + dlam2 * (t4
+	  + dlam2 * t5)));
 
 
 	t6 = sn * cl * _scale;
@@ -159,12 +163,18 @@ PointD TransverseMercator::ll2xy(const Coordinates &c) const
 	t9 = sn * c7 * _scale * (61.e0 - 479.e0 * tan2 + 179.e0 * tan4 - tan6)
 	  / 5040.e0;
 
-	x = _falseEasting + dlam * t6 + pow(dlam, 3.e0) * t7 + pow(dlam, 5.e0)
-	  * t8 + pow(dlam, 7.e0) * t9;
+	dlam3 = dlam2 * dlam;
+	x = _falseEasting + dlam * t6 + dlam3 * (t7 + dlam2 * (t8 + dlam2 * t9));
 
 	return PointD(x, y);
 }
 
+void TransverseMercator::ll2xy(const Coordinates *c, PointD *p, int n) const
+{
+	for (int i = 0; i < n; i++)
+		p[i] = TransverseMercator::ll2xy(c[i]);
+}
+
 Coordinates TransverseMercator::xy2ll(const PointD &p) const
 {
 	double cl;
@@ -176,12 +186,11 @@ Coordinates TransverseMercator::xy2ll(const PointD &p) const
 	double sr;
 	double t, tan2, tan4;
 	double t10, t11, t12, t13, t14, t15, t16, t17;
-	double tmd, tmdo;
+	double tmd;
 	double lat, lon;
 
 
-	tmdo = SPHTMD(_latitudeOrigin);
-	tmd = tmdo + (p.y() - _falseNorthing) / _scale;
+	tmd = _tmdo + (p.y() - _falseNorthing) / _scale;
 
 	sr = SPHSR(0.e0);
 	ftphi = tmd / sr;
@@ -193,7 +202,7 @@ Coordinates TransverseMercator::xy2ll(const PointD &p) const
 	}
 
 	sr = SPHSR(ftphi);
-	sn = SPHSN(ftphi);
+	sn = SPHSN(sin(ftphi));
 
 	cl = cos(ftphi);
 
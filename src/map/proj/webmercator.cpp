@@ -9,6 +9,13 @@ PointD WebMercator::ll2xy(const Coordinates &c) const
 	  log(tan(M_PI_4 + deg2rad(c.lat())/2.0)) * WGS84_RADIUS);
 }
 
+void WebMercator::ll2xy(const Coordinates *c, PointD *p, int n) const
+{
+	for (int i = 0; i < n; i++)
+		p[i] = PointD(deg2rad(c[i].lon()) * WGS84_RADIUS,
+		  log(tan(M_PI_4 + deg2rad(c[i].lat())/2.0)) * WGS84_RADIUS);
+}
+
 Coordinates WebMercator::xy2ll(const PointD &p) const
 {
 	return Coordinates(rad2deg(p.x() / WGS84_RADIUS),
@@ -11,6 +11,7 @@ public:
 
 	virtual PointD ll2xy(const Coordinates &c) const;
 	virtual Coordinates xy2ll(const PointD &p) const;
+	virtual void ll2xy(const Coordinates *c, PointD *p, int n) const;
 };
 
 #endif // WEBMERCATOR_H
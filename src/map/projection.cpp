@@ -1,3 +1,4 @@
+#include <QVector>
 #include "proj/mercator.h"
 #include "proj/webmercator.h"
 #include "proj/transversemercator.h"
@@ -130,3 +131,14 @@ bool Projection::operator==(const Projection &p) const
 	return (*_ct == *p._ct && _gcs == p._gcs && _units == p._units
 	  && _cs == p._cs);
 }
+
+void Projection::ll2xy(const Coordinates *c, PointD *p, int n) const
+{
+	Q_ASSERT(isValid());
+	QVector<Coordinates> gc(n);
+
+	_gcs.fromWGS84(c, gc.data(), n);
+	_ct->ll2xy(gc.constData(), p, n);
+	for (int i = 0; i < n; i++)
+		p[i] = _units.fromMeters(p[i]);
+}
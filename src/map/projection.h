@@ -49,6 +49,7 @@ public:
 		Q_ASSERT(isValid());
 		return _gcs.toWGS84(_ct->xy2ll(_units.toMeters(p)));
 	}
+	void ll2xy(const Coordinates *c, PointD *p, int n) const;
 
 	const LinearUnits &units() const {return _units;}
 	const CoordinateSystem &coordinateSystem() const {return _cs;}
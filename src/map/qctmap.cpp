@@ -1,9 +1,12 @@
 #include <cstring>
+#include <algorithm>
 #include <QDataStream>
-#include <QPixmapCache>
 #include <QPainter>
+#include <QtEndian>
 #include "common/util.h"
 #include "common/color.h"
+#include "common/mappedfile.h"
+#include "tileorder.h"
 #include "qctmap.h"
 
 #define TILE_SIZE 64
@@ -30,21 +33,48 @@ static quint8 bpp(quint8 colours)
 	return 8;
 }
 
-static bool validateTable(const QVector<quint8> &table)
+/* The decoders work directly on the (memory mapped) tile data. The huffman
+   table is used in place, it is only scanned for its size and validated. */
+static int tableSize(const uchar *data, const uchar *end)
+{
+	const uchar *p = data;
+	int colours = 0;
+	int branches = 0;
+
+	while (colours <= branches) {
+		if (p >= end)
+			return -1;
+
+		if (*p == 128) {
+			p += 3;
+			branches++;
+		} else {
+			if (*p > 128)
+				branches++;
+			else
+				colours++;
+			p++;
+		}
+	}
+
+	return (p > end) ? -1 : p - data;
+}
+
+static bool validateTable(const uchar *table, int size)
 {
 	int delta;
 
-	for (int i = 0; i < table.size(); i++) {
-		if (table.at(i) == 128) {
-			if (i + 2 >= table.size())
+	for (int i = 0; i < size; i++) {
+		if (table[i] == 128) {
+			if (i + 2 >= size)
 				return false;
-			delta = 65537 - (256 * table.at(i+2) + table.at(i+1)) + 2;
-			if (i + delta >= table.size())
+			delta = 65537 - (256 * table[i+2] + table[i+1]) + 2;
+			if (i + delta >= size)
 				return false;
 			i += 2;
-		} else if (table.at(i) > 128) {
-			delta = 257 - table.at(i);
-			if (i + delta >= table.size())
+		} else if (table[i] > 128) {
+			delta = 257 - table[i];
+			if (i + delta >= size)
 				return false;
 		}
 	}
@@ -52,131 +82,111 @@ static bool validateTable(const QVector<quint8> &table)
 	return true;
 }
 
-static bool createTable(QDataStream &stream, QVector<quint8> &table)
+static bool huffman(const uchar *data, const uchar *end,
+  quint8 tileData[TILE_PIXELS])
 {
-	int idx = 0;
-	int colours = 0;
-	int branches = 0;
-
-	table.reserve(256);
-
-	while (stream.status() == QDataStream::Ok && colours <= branches) {
-		table.resize(table.size() + 1);
-		stream >> table[idx];
-
-		if (table[idx] == 128) {
-			table.resize(table.size() + 2);
-			stream >> table[++idx];
-			stream >> table[++idx];
-			branches++;
-		} else if (table[idx] > 128)
-			branches++;
-		else
-			colours++;
+	int size = tableSize(data, end);
+	if (size < 0)
+		return false;
 
-		idx++;
+	const uchar *table = data;
+	if (size == 1) {
+		memset(tileData, table[0], TILE_PIXELS);
+		return true;
 	}
-
-	return (stream.status() == QDataStream::Ok);
-}
-
-static bool huffman(QDataStream &stream, quint8 tileData[TILE_PIXELS])
-{
-	QVector<quint8> table;
-	if (!createTable(stream, table))
+	if (!validateTable(table, size))
 		return false;
 
-	if (table.size() == 1) {
-		memset(tileData, table[0], TILE_PIXELS);
-	} else {
-		if (!validateTable(table))
-			return false;
+	const uchar *p = data + size;
+	const uchar *tp = table;
+	int bitsLeft = 0;
+	quint8 val = 0;
 
-		const quint8 *tp = table.constData();
-		int bitsLeft = 8;
-		int bitVal;
-		quint8 val;
+	for (int pixelnum = 0; pixelnum < TILE_PIXELS; ) {
+		if (*tp < 128) {
+			tileData[pixelnum++] = *tp;
+			tp = table;
+		} else {
+			if (!bitsLeft) {
+				if (p >= end)
+					return false;
+				val = *p++;
+				bitsLeft = 8;
+			}
 
-		stream >> val;
+			int bitVal = (val & 1);
+			val >>= 1;
+			bitsLeft--;
 
-		for (int pixelnum = 0; pixelnum < TILE_PIXELS; ) {
-			if (*tp < 128) {
-				tileData[pixelnum++] = *tp;
-				tp = table.constData();
+			if (bitVal == 0) {
+				if (*tp == 128)
+					tp += 2;
+				tp++;
 			} else {
-				bitVal = (val & 1);
-
-				val >>= 1;
-				bitsLeft--;
-				if (bitsLeft == 0) {
-					stream >> val;
-					bitsLeft = 8;
-				}
-
-				if (bitVal == 0) {
-					if (*tp == 128)
-						tp += 2;
-					tp++;
-				} else {
-					if (*tp > 128)
-						tp += 257 - (*tp);
-					else if (*tp == 128)
-						tp += 65537 - (256 * tp[2] + tp[1]) + 2;
-				}
+				if (*tp > 128)
+					tp += 257 - (*tp);
+				else if (*tp == 128)
+					tp += 65537 - (256 * tp[2] + tp[1]) + 2;
 			}
 		}
 	}
 
-	return (stream.status() == QDataStream::Ok);
+	return true;
 }
 
-static bool pixelPacking(QDataStream &stream, quint8 tileData[TILE_PIXELS],
-  quint8 colours)
+static bool pixelPacking(const uchar *data, const uchar *end,
+  quint8 tileData[TILE_PIXELS], quint8 colours)
 {
 	quint8 shift = bpp(colours);
 	quint32 mask = (1 << shift) - 1;
 	int wordSize = 32 / shift;
+	int words = (TILE_PIXELS + wordSize - 1) / wordSize;
 	quint8 paletteIndex[256];
 
-	for (quint8 i = 0; i < colours; i++)
-		stream >> paletteIndex[i];
+	if (end - data < colours + 4 * words)
+		return false;
+	memset(paletteIndex, 0, sizeof(paletteIndex));
+	memcpy(paletteIndex, data, colours);
+	data += colours;
 
-	for (int pixelnum = 0; pixelnum < TILE_PIXELS; ) {
-		quint32 colour, val;
-		stream >> val;
+	for (int w = 0, pixelnum = 0; w < words; w++, data += 4) {
+		quint32 val = qFromLittleEndian<quint32>(data);
+		int runs = qMin(wordSize, TILE_PIXELS - pixelnum);
 
-		for (int runs = 0; runs < wordSize; runs++) {
-			colour = val & mask;
-			val = val >> shift;
-			tileData[pixelnum++] = paletteIndex[colour];
+		for (int i = 0; i < runs; i++) {
+			tileData[pixelnum++] = paletteIndex[val & mask];
+			val >>= shift;
 		}
 	}
 
-	return (stream.status() == QDataStream::Ok);
+	return true;
 }
 
-static bool rle(QDataStream &stream, quint8 tileData[TILE_PIXELS],
-  quint8 colours)
+static bool rle(const uchar *data, const uchar *end,
+  quint8 tileData[TILE_PIXELS], quint8 colours)
 {
 	quint8 bits = bpp(colours);
 	quint8 paletteMask = (1 << bits) - 1;
 	quint8 paletteIndex[256];
-	quint8 val;
 
-	for (quint8 i = 0; i < colours; i++)
-		stream >> paletteIndex[i];
+	if (end - data < colours)
+		return false;
+	memset(paletteIndex, 0, sizeof(paletteIndex));
+	memcpy(paletteIndex, data, colours);
+	data += colours;
 
 	for (int pixelnum = 0; pixelnum < TILE_PIXELS; ) {
-		stream >> val;
+		if (data >= end)
+			return false;
 
-		quint8 colour = val & paletteMask;
-		quint8 runs = val >> bits;
+		quint8 val = *data++;
+		int runs = qMin(val >> bits, TILE_PIXELS - pixelnum);
 
-		while (runs-- > 0)
-			tileData[pixelnum++] = paletteIndex[colour];
+		memset(tileData + pixelnum, paletteIndex[val & paletteMask], runs);
+		pixelnum += runs;
 	}
 
-	return (stream.status() == QDataStream::Ok);
+	return true;
 }
 
 static bool readString(QDataStream &stream, quint32 offset, QString &str)
@@ -318,13 +328,27 @@ bool QCTMap::readIndex(QDataStream &stream)
 	_index.resize(_cols * _rows);
 	for (int i = 0; i < _cols * _rows; i++)
 		stream >> _index[i];
+	if (stream.status() != QDataStream::Ok)
+		return false;
 
-	return (stream.status() == QDataStream::Ok);
+	/* The tiles are not necessarily stored in the index order, the tile data
+	   ends at the next tile (or the end of the file) */
+	QVector<quint32> offsets(_index);
+	offsets.append(stream.device()->size());
+	std::sort(offsets.begin(), offsets.end());
+	_sizes.resize(_index.size());
+	for (int i = 0; i < _index.size(); i++) {
+		QVector<quint32>::const_iterator it = std::upper_bound(
+		  offsets.constBegin(), offsets.constEnd(), _index.at(i));
+		_sizes[i] = (it == offsets.constEnd()) ? 0 : *it - _index.at(i);
+	}
+
+	return true;
 }
 
 QCTMap::QCTMap(const QString &fileName, QObject *parent)
-  : Map(fileName, parent), _file(fileName), _shiftE(0), _shiftN(0),
-  _mapRatio(1.0), _valid(false)
+  : Map(fileName, parent), _file(fileName), _mapped(0), _shiftE(0),
+  _shiftN(0), _mapRatio(1.0), _valid(false)
 {
 	if (!_file.open(QIODevice::ReadOnly)) {
 		_errorString = _file.errorString();
@@ -366,10 +390,23 @@ void QCTMap::load(const Projection &in, const Projection &out,
 	if (!_file.open(QIODevice::ReadOnly))
 		qWarning("%s: %s", qUtf8Printable(_file.fileName()),
 		  qUtf8Printable(_file.errorString()));
+	else
+		_mapped = new MappedFile(&_file);
+}
+
+QCTMap::~QCTMap()
+{
+	cancelJobs(true);
+	delete _mapped;
 }
 
 void QCTMap::unload()
 {
+	cancelJobs(true);
+	_tileCache.clear();
+
+	delete _mapped;
+	_mapped = 0;
 	_file.close();
 }
 
@@ -417,80 +454,177 @@ Coordinates QCTMap::xy2ll(const QPointF &p)
 	return Coordinates(lon + _shiftE, lat + _shiftN);
 }
 
-QPixmap QCTMap::tile(int x, int y)
+QByteArray QCTMap::tileData(int x, int y)
 {
+	if (!_mapped || x < 0 || y < 0 || x >= _cols || y >= _rows)
+		return QByteArray();
+
+	int i = y * _cols + x;
+	if (!_mapped->seek(_index.at(i)))
+		return QByteArray();
+
+	/* No copy of the mapped data, the mapping lives until unload() where all
+	   the jobs are finished first */
+	if (_mapped->isMapped()) {
+		const char *data = _mapped->data(_sizes.at(i));
+		return data
+		  ? QByteArray::fromRawData(data, _sizes.at(i)) : QByteArray();
+	} else
+		return _mapped->read(_sizes.at(i));
+}
+
+QImage QCTMap::decode(int zoom, const QByteArray &data) const
+{
+	Q_UNUSED(zoom);
 	static quint8 rowSeq[] = {
 		 0, 32, 16, 48,  8, 40, 24, 56,  4, 36, 20, 52, 12, 44, 28, 60,
 		 2, 34, 18, 50, 10, 42, 26, 58,  6, 38, 22, 54, 14, 46, 30, 62,
 		 1, 33, 17, 49,  9, 41, 25, 57,  5, 37, 21, 53, 13, 45, 29, 61,
 		 3, 35, 19, 51, 11, 43, 27, 59,  7, 39, 23, 55, 15, 47, 31, 63
 	};
-	quint8 tileData[TILE_PIXELS], imgData[TILE_PIXELS];
-	quint8 packing;
+	quint8 tileData[TILE_PIXELS];
+	const uchar *p = (const uchar*)data.constData();
+	const uchar *end = p + data.size();
 	bool ret;
 
+	if (p >= end)
+		return QImage();
 
-	if (!_file.seek(_index.at(y * _cols + x)))
-		return QPixmap();
-
-	QDataStream stream(&_file);
-	stream.setByteOrder(QDataStream::LittleEndian);
-
-	stream >> packing;
-	if (stream.status() != QDataStream::Ok)
-		return QPixmap();
-
+	quint8 packing = *p++;
 	if (packing == 0 || packing == 255)
-		ret = huffman(stream, tileData);
+		ret = huffman(p, end, tileData);
 	else if (packing > 127)
-		ret = pixelPacking(stream, tileData, 256 - packing);
+		ret = pixelPacking(p, end, tileData, 256 - packing);
 	else
-		ret = rle(stream, tileData, packing);
+		ret = rle(p, end, tileData, packing);
 
 	if (!ret)
-		return QPixmap();
-
-	for (int i = 0; i < TILE_SIZE; i++)
-		memcpy(imgData + i * TILE_SIZE, tileData + rowSeq[i] * TILE_SIZE,
-		  TILE_SIZE);
-
-	QImage img(imgData, TILE_SIZE, TILE_SIZE, TILE_SIZE,
-	  QImage::Format_Indexed8);
-	img.setColorTable(_palette);
+		return QImage();
+
+	/* The palette expansion is done together with the rows de-interlacing,
+	   the resulting RGB32 image is the native pixmap format */
+	QImage img(TILE_SIZE, TILE_SIZE, QImage::Format_RGB32);
+	const QRgb *palette = _palette.constData();
+	for (int i = 0; i < TILE_SIZE; i++) {
+		const quint8 *src = tileData + rowSeq[i] * TILE_SIZE;
+		QRgb *dst = (QRgb*)img.scanLine(i);
+		for (int j = 0; j < TILE_SIZE; j++)
+			dst[j] = palette[src[j]];
+	}
 
-	return QPixmap::fromImage(img);
+	return img;
 }
 
 void QCTMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 {
-	Q_UNUSED(flags);
-
 	QSizeF ts(TILE_SIZE / _mapRatio, TILE_SIZE / _mapRatio);
 	QPointF tl(floor(rect.left() / ts.width()) * ts.width(),
 	  floor(rect.top() / ts.height()) * ts.height());
+	QList<ImageTile> tiles;
 
 	QSizeF s(rect.right() - tl.x(), rect.bottom() - tl.y());
-	for (int i = 0; i < ceil(s.width() / ts.width()); i++) {
-		for (int j = 0; j < ceil(s.height() / ts.height()); j++) {
+	int width = ceil(s.width() / ts.width());
+	int height = ceil(s.height() / ts.height());
+	for (int i = 0; i < width; i++) {
+		for (int j = 0; j < height; j++) {
 			int x = round(tl.x() * _mapRatio + i * TILE_SIZE) / TILE_SIZE;
 			int y = round(tl.y() * _mapRatio + j * TILE_SIZE) / TILE_SIZE;
-
+			QPointF tp(tl.x() + i * ts.width(), tl.y() + j * ts.height());
+			quint64 key = TileCache::key(0, QPoint(x, y));
 			QPixmap pixmap;
-			QString key = path() + "/" + QString::number(x) + "_"
-			  + QString::number(y);
-			if (!QPixmapCache::find(key, &pixmap)) {
-				pixmap = tile(x, y);
-				if (!pixmap.isNull())
-					QPixmapCache::insert(key, pixmap);
-			}
 
-			if (pixmap.isNull())
-				qWarning("%s: error loading tile image", qUtf8Printable(key));
-			else {
+			if (isRunning(key))
+				continue;
+
+			if (_tileCache.find(key, &pixmap, _mapRatio)) {
 				pixmap.setDevicePixelRatio(_mapRatio);
-				QPointF tp(tl.x() + i * ts.width(), tl.y() + j * ts.height());
 				painter->drawPixmap(tp, pixmap);
-			}
+			} else
+				tiles.append(ImageTile(this, 0, tp, tileData(x, y), key));
+		}
+	}
+
+	if (tiles.isEmpty())
+		return;
+	if (!(flags & Map::Block)) {
+		std::sort(tiles.begin(), tiles.end(),
+		  TileOrder<ImageTile>(rect.center() - QPointF(ts.width() / 2,
+		  ts.height() / 2)));
+		runJob(new ImageTileJob(tiles));
+		return;
+	}
+
+	QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+	  tiles, &ImageTile::load);
+	future.waitForFinished();
+
+	for (int i = 0; i < tiles.size(); i++) {
+		const ImageTile &mt = tiles.at(i);
+		QPixmap pixmap(mt.pixmap());
+		if (pixmap.isNull()) {
+			qWarning("%s: error loading tile image", qUtf8Printable(path()));
+			continue;
+		}
+
+		_tileCache.insert(mt.key(), pixmap);
+		pixmap.setDevicePixelRatio(_mapRatio);
+		painter->drawPixmap(mt.xy(), pixmap);
+	}
+}
+
+bool QCTMap::isRunning(quint64 key) const
+{
+	for (int i = 0; i < _jobs.size(); i++) {
+		const QList<ImageTile> &tiles = _jobs.at(i)->tiles();
+		for (int j = 0; j < tiles.size(); j++)
+			if (tiles.at(j).key() == key)
+				return true;
+	}
+
+	return false;
+}
+
+void QCTMap::runJob(ImageTileJob *job)
+{
+	_jobs.append(job);
+
+	connect(job, &ImageTileJob::finished, this, &QCTMap::jobFinished);
+	job->run();
+}
+
+void QCTMap::removeJob(ImageTileJob *job)
+{
+	_jobs.removeOne(job);
+	job->deleteLater();
+}
+
+void QCTMap::jobFinished(ImageTileJob *job)
+{
+	const QList<ImageTile> &tiles = job->tiles();
+
+	for (int i = 0; i < tiles.size(); i++) {
+		const ImageTile &mt = tiles.at(i);
+		if (!mt.pixmap().isNull())
+			_tileCache.insert(mt.key(), mt.pixmap());
+	}
+
+	removeJob(job);
+
+	emit tilesLoaded();
+}
+
+void QCTMap::cancelJobs(bool wait)
+{
+	for (int i = 0; i < _jobs.size(); i++)
+		_jobs.at(i)->cancel(wait);
+
+	/* Waiting cancels (unload) drop the jobs including the results of the
+	   jobs that finished but whose finished signal is still queued */
+	if (wait) {
+		while (!_jobs.isEmpty()) {
+			ImageTileJob *job = _jobs.first();
+			job->disconnect(this);
+			removeJob(job);
 		}
 	}
 }
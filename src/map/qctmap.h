@@ -3,14 +3,20 @@
 
 #include <QFile>
 #include <QRgb>
+#include "tilecache.h"
+#include "imagetilejob.h"
 #include "map.h"
 
 class QDataStream;
+class MappedFile;
 
-class QCTMap : public Map
+class QCTMap : public Map, public TileDecoder
 {
+	Q_OBJECT
+
 public:
 	QCTMap(const QString &fileName, QObject *parent = 0);
+	~QCTMap();
 
 	QString name() const {return _name;}
 
@@ -30,6 +36,11 @@ public:
 
 	static Map *create(const QString &path, const Projection &proj, bool *isDir);
 
+	QImage decode(int zoom, const QByteArray &data) const;
+
+private slots:
+	void jobFinished(ImageTileJob *job);
+
 private:
 	bool readName(QDataStream &stream);
 	bool readSize(QDataStream &stream);
@@ -38,9 +49,14 @@ private:
 	bool readGeoRef(QDataStream &stream);
 	bool readIndex(QDataStream &stream);
 	bool readPalette(QDataStream &stream);
-	QPixmap tile(int x, int y);
+	QByteArray tileData(int x, int y);
+	bool isRunning(quint64 key) const;
+	void runJob(ImageTileJob *job);
+	void removeJob(ImageTileJob *job);
+	void cancelJobs(bool wait);
 
 	QFile _file;
+	MappedFile *_mapped;
 	QString _name;
 	int _rows, _cols;
 	double _lon, _lonX, _lonXX, _lonXXX, _lonY, _lonYY, _lonYYY, _lonXY,
@@ -53,7 +69,10 @@ private:
 	  _norXXY, _norXXX;
 	double _shiftE, _shiftN;
 	QVector<quint32> _index;
+	QVector<quint32> _sizes;
 	QVector<QRgb> _palette;
+	TileCache _tileCache;
+	QList<ImageTileJob*> _jobs;
 
 	qreal _mapRatio;
 	bool _valid;
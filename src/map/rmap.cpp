@@ -1,6 +1,5 @@
 #include <QFileInfo>
 #include <QDataStream>
-#include <QPixmapCache>
 #include <QPainter>
 #include <QRegularExpression>
 #include <QtEndian>
@@ -10,6 +9,7 @@
 #include "utm.h"
 #include "pcs.h"
 #include "rectd.h"
+#include "tileorder.h"
 #include "rmap.h"
 
 
@@ -332,14 +332,23 @@ int RMap::zoomFit(const QSize &size, const RectC &rect)
 	return _zoom;
 }
 
+RMap::~RMap()
+{
+	cancelJobs(true);
+}
+
 int RMap::zoomIn()
 {
+	cancelJobs(false);
+
 	_zoom = qMax(_zoom - 1, 0);
 	return _zoom;
 }
 
 int RMap::zoomOut()
 {
+	cancelJobs(false);
+
 	_zoom = qMin(_zoom + 1, _zooms.size() - 1);
 	return _zoom;
 }
@@ -374,95 +383,203 @@ void RMap::load(const Projection &in, const Projection &out, qreal deviceRatio,
 
 void RMap::unload()
 {
+	cancelJobs(true);
+	_tileCache.clear();
+
 	_file.close();
 }
 
-QPixmap RMap::tile(int x, int y)
+QByteArray RMap::tileData(int x, int y)
 {
 	const Zoom &zoom = _zooms.at(_zoom);
 
 	qint32 index = y / _tileSize.height() * zoom.dim.width()
 	  + x / _tileSize.width();
 	if (index > zoom.tiles.size())
-		return QPixmap();
+		return QByteArray();
 
 	quint64 offset = zoom.tiles.at(index);
 	if (!_file.seek(offset))
-		return QPixmap();
+		return QByteArray();
 	QDataStream stream(&_file);
 	stream.setByteOrder(QDataStream::LittleEndian);
 	quint32 tag;
 	stream >> tag;
 	if (stream.status() != QDataStream::Ok)
-		return QPixmap();
+		return QByteArray();
 
+	/* The tile data is prefixed with the tag byte for decode() */
 	if (tag == 2) {
 		if (_palette.isEmpty())
-			return QPixmap();
+			return QByteArray();
 		quint32 width, height, size;
 		stream >> width >> height >> size;
 		QSize tileSize(width, -(int)height);
+		if (tileSize.isEmpty())
+			return QByteArray();
 
+		/* tag, tile width, qUncompress() size prefix, compressed data */
+		quint32 bew = qToBigEndian(tileSize.width());
 		quint32 bes = qToBigEndian(tileSize.width() * tileSize.height());
 		QByteArray ba;
-		ba.resize(sizeof(bes) + size);
-		memcpy(ba.data(), &bes, sizeof(bes));
-
-		if (stream.readRawData(ba.data() + sizeof(bes), size) != (int)size)
-			return QPixmap();
-		QByteArray uba = qUncompress(ba);
-		if (uba.size() < tileSize.width() * tileSize.height())
-			return QPixmap();
-		QImage img((const uchar*)uba.constData(), tileSize.width(),
-		  tileSize.height(), QImage::Format_Indexed8);
-		img.setColorTable(_palette);
+		ba.resize(1 + sizeof(bew) + sizeof(bes) + size);
+		ba[0] = (char)tag;
+		memcpy(ba.data() + 1, &bew, sizeof(bew));
+		memcpy(ba.data() + 1 + sizeof(bew), &bes, sizeof(bes));
 
-		return QPixmap::fromImage(img);
+		if (stream.readRawData(ba.data() + 1 + sizeof(bew) + sizeof(bes), size)
+		  != (int)size)
+			return QByteArray();
+
+		return ba;
 	} else if (tag == 7) {
 		quint32 len;
 		stream >> len;
 
 		QByteArray ba;
-		ba.resize(len);
-		if (stream.readRawData(ba.data(), ba.size()) != ba.size())
-			return QPixmap();
+		ba.resize(1 + len);
+		ba[0] = (char)tag;
+		if (stream.readRawData(ba.data() + 1, len) != (int)len)
+			return QByteArray();
 
-		QImage img(QImage::fromData(ba, "JPG"));
-		return QPixmap::fromImage(img);
+		return ba;
 	} else
-		return QPixmap();
+		return QByteArray();
 }
 
-void RMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
+QImage RMap::decode(int zoom, const QByteArray &data) const
 {
-	Q_UNUSED(flags);
+	Q_UNUSED(zoom);
+	const uchar *d = (const uchar*)data.constData();
+
+	if (d[0] == 2 && data.size() > 9) {
+		int width = qFromBigEndian<quint32>(d + 1);
+		int size = qFromBigEndian<quint32>(d + 5);
+		QByteArray uba = qUncompress(d + 5, data.size() - 5);
+		if (uba.size() < size)
+			return QImage();
+		QImage img((const uchar*)uba.constData(), width, size / width,
+		  QImage::Format_Indexed8);
+		img.setColorTable(_palette);
 
+		return img.copy();
+	} else if (d[0] == 7)
+		return QImage::fromData(d + 1, data.size() - 1, "JPG");
+	else
+		return QImage();
+}
+
+void RMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
+{
 	QSizeF ts(_tileSize.width() / _mapRatio, _tileSize.height() / _mapRatio);
 	QPointF tl(floor(rect.left() / ts.width()) * ts.width(),
 	  floor(rect.top() / ts.height()) * ts.height());
+	QList<ImageTile> tiles;
 
 	QSizeF s(rect.right() - tl.x(), rect.bottom() - tl.y());
-	for (int i = 0; i < ceil(s.width() / ts.width()); i++) {
-		for (int j = 0; j < ceil(s.height() / ts.height()); j++) {
+	int width = ceil(s.width() / ts.width());
+	int height = ceil(s.height() / ts.height());
+	for (int i = 0; i < width; i++) {
+		for (int j = 0; j < height; j++) {
 			int x = round(tl.x() * _mapRatio + i * _tileSize.width());
 			int y = round(tl.y() * _mapRatio + j * _tileSize.height());
-
+			QPointF tp(tl.x() + i * ts.width(), tl.y() + j * ts.height());
+			quint64 key = TileCache::key(_zoom, QPoint(x / _tileSize.width(),
+			  y / _tileSize.height()));
 			QPixmap pixmap;
-			QString key = path() + "/" + QString::number(_zoom) + "_"
-			  + QString::number(x) + "_" + QString::number(y);
-			if (!QPixmapCache::find(key, &pixmap)) {
-				pixmap = tile(x, y);
-				if (!pixmap.isNull())
-					QPixmapCache::insert(key, pixmap);
-			}
 
-			if (pixmap.isNull())
-				qWarning("%s: error loading tile image", qUtf8Printable(key));
-			else {
+			if (isRunning(key))
+				continue;
+
+			if (_tileCache.find(key, &pixmap, _mapRatio)) {
 				pixmap.setDevicePixelRatio(_mapRatio);
-				QPointF tp(tl.x() + i * ts.width(), tl.y() + j * ts.height());
 				painter->drawPixmap(tp, pixmap);
-			}
+			} else
+				tiles.append(ImageTile(this, _zoom, tp, tileData(x, y), key));
+		}
+	}
+
+	if (tiles.isEmpty())
+		return;
+	if (!(flags & Map::Block)) {
+		std::sort(tiles.begin(), tiles.end(),
+		  TileOrder<ImageTile>(rect.center() - QPointF(ts.width() / 2,
+		  ts.height() / 2)));
+		runJob(new ImageTileJob(tiles));
+		return;
+	}
+
+	QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+	  tiles, &ImageTile::load);
+	future.waitForFinished();
+
+	for (int i = 0; i < tiles.size(); i++) {
+		const ImageTile &mt = tiles.at(i);
+		QPixmap pixmap(mt.pixmap());
+		if (pixmap.isNull()) {
+			qWarning("%s: error loading tile image", qUtf8Printable(path()));
+			continue;
+		}
+
+		_tileCache.insert(mt.key(), pixmap);
+		pixmap.setDevicePixelRatio(_mapRatio);
+		painter->drawPixmap(mt.xy(), pixmap);
+	}
+}
+
+bool RMap::isRunning(quint64 key) const
+{
+	for (int i = 0; i < _jobs.size(); i++) {
+		const QList<ImageTile> &tiles = _jobs.at(i)->tiles();
+		for (int j = 0; j < tiles.size(); j++)
+			if (tiles.at(j).key() == key)
+				return true;
+	}
+
+	return false;
+}
+
+void RMap::runJob(ImageTileJob *job)
+{
+	_jobs.append(job);
+
+	connect(job, &ImageTileJob::finished, this, &RMap::jobFinished);
+	job->run();
+}
+
+void RMap::removeJob(ImageTileJob *job)
+{
+	_jobs.removeOne(job);
+	job->deleteLater();
+}
+
+void RMap::jobFinished(ImageTileJob *job)
+{
+	const QList<ImageTile> &tiles = job->tiles();
+
+	for (int i = 0; i < tiles.size(); i++) {
+		const ImageTile &mt = tiles.at(i);
+		if (!mt.pixmap().isNull())
+			_tileCache.insert(mt.key(), mt.pixmap());
+	}
+
+	removeJob(job);
+
+	emit tilesLoaded();
+}
+
+void RMap::cancelJobs(bool wait)
+{
+	for (int i = 0; i < _jobs.size(); i++)
+		_jobs.at(i)->cancel(wait);
+
+	/* Waiting cancels (unload) drop the jobs including the results of the
+	   jobs that finished but whose finished signal is still queued */
+	if (wait) {
+		while (!_jobs.isEmpty()) {
+			ImageTileJob *job = _jobs.first();
+			job->disconnect(this);
+			removeJob(job);
 		}
 	}
 }
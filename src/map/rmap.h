@@ -6,13 +6,16 @@
 #include "map.h"
 #include "transform.h"
 #include "projection.h"
+#include "tilecache.h"
+#include "imagetilejob.h"
 
-class RMap : public Map
+class RMap : public Map, public TileDecoder
 {
 	Q_OBJECT
 
 public:
 	RMap(const QString &fileName, QObject *parent = 0);
+	~RMap();
 
 	QRectF bounds();
 
@@ -36,6 +39,11 @@ public:
 
 	static Map *create(const QString &path, const Projection &proj, bool *isDir);
 
+	QImage decode(int zoom, const QByteArray &data) const;
+
+private slots:
+	void jobFinished(ImageTileJob *job);
+
 private:
 	struct Header {
 		quint32 type;
@@ -62,7 +70,11 @@ private:
 	bool readZoomLevel(quint64 offset, const QSize &imageSize);
 	QByteArray readIMP(quint64 IMPOffset);
 	bool parseIMP(const QByteArray &data);
-	QPixmap tile(int x, int y);
+	QByteArray tileData(int x, int y);
+	bool isRunning(quint64 key) const;
+	void runJob(ImageTileJob *job);
+	void removeJob(ImageTileJob *job);
+	void cancelJobs(bool wait);
 
 	QList<Zoom> _zooms;
 	Projection _projection;
@@ -72,6 +84,8 @@ private:
 	qreal _mapRatio;
 	int _zoom;
 	QVector<QRgb> _palette;
+	TileCache _tileCache;
+	QList<ImageTileJob*> _jobs;
 
 	bool _valid;
 	QString _errorString;
@@ -3,12 +3,11 @@
 #include <QSqlField>
 #include <QSqlError>
 #include <QPainter>
-#include <QPixmapCache>
 #include <QImageReader>
 #include <QBuffer>
-#include <QtConcurrent>
+#include "common/threadpools.h"
 #include "osm.h"
-#include "tile.h"
+#include "tileorder.h"
 #include "metatype.h"
 #include "sqlitemap.h"
 
@@ -99,6 +98,12 @@ SqliteMap::SqliteMap(const QString &fileName, QObject *parent)
 	_valid = true;
 }
 
+static void coverageKey(const QSqlQuery &query, int &zoom, QPoint &tile)
+{
+	zoom = 17 - query.value(0).toInt();
+	tile = QPoint(query.value(1).toInt(), query.value(2).toInt());
+}
+
 void SqliteMap::load(const Projection &in, const Projection &out,
   qreal deviceRatio, bool hidpi, int style, int layer)
 {
@@ -108,12 +113,16 @@ void SqliteMap::load(const Projection &in, const Projection &out,
 	Q_UNUSED(layer);
 
 	_mapRatio = hidpi ? deviceRatio : 1.0;
-	_db.open();
+	_tiles.open(path(), "SELECT image FROM tiles WHERE z=? AND x=? AND y=?");
+	_coverage.load(path(), "SELECT z, x, y FROM tiles", coverageKey);
 }
 
 void SqliteMap::unload()
 {
-	_db.close();
+	cancelJobs(true);
+
+	_tiles.close();
+	_tileCache.clear();
 }
 
 QRectF SqliteMap::bounds()
@@ -152,12 +161,16 @@ qreal SqliteMap::resolution(const QRectF &rect)
 
 int SqliteMap::zoomIn()
 {
+	cancelJobs(false);
+
 	_zoom = qMin(_zoom + 1, _zooms.max());
 	return _zoom;
 }
 
 int SqliteMap::zoomOut()
 {
+	cancelJobs(false);
+
 	_zoom = qMax(_zoom - 1, _zooms.min());
 	return _zoom;
 }
@@ -167,24 +180,42 @@ qreal SqliteMap::tileSize() const
 	return (_tileSize / _mapRatio);
 }
 
-QByteArray SqliteMap::tileData(int zoom, const QPoint &tile) const
+QByteArray SqliteMap::tileData(int zoom, const QPoint &tile)
 {
-	QSqlQuery query(_db);
-	query.prepare("SELECT image FROM tiles WHERE z=:zoom AND x=:x AND y=:y");
-	query.bindValue(":zoom", 17 - zoom);
-	query.bindValue(":x", tile.x());
-	query.bindValue(":y", tile.y());
-	query.exec();
+	return _tiles.tile(QVariantList() << 17 - zoom << tile.x() << tile.y());
+}
+
+/* Reads the data of all the tiles with a single query */
+QList<DataTile> SqliteMap::tilesData(int zoom, const QList<DataTile> &tiles)
+{
+	QSet<qint64> xs, ys;
+	QHash<quint64, QByteArray> data;
+	QList<DataTile> list;
+
+	for (int i = 0; i < tiles.size(); i++) {
+		xs.insert(tiles.at(i).xy().x());
+		ys.insert(tiles.at(i).xy().y());
+	}
 
-	if (query.first())
-		return query.value(0).toByteArray();
+	SQLiteTiles::Query query(_tiles);
+	if (query.exec(QString("SELECT x, y, image FROM tiles WHERE z=%1"
+	  " AND x IN (%2) AND y IN (%3)").arg(17 - zoom)
+	  .arg(SQLiteTiles::valueList(xs), SQLiteTiles::valueList(ys)))) {
+		while (query.next())
+			data.insert(TileCache::key(zoom, QPoint(query.value(0).toInt(),
+			  query.value(1).toInt())), query.value(2).toByteArray());
+	}
+
+	for (int i = 0; i < tiles.size(); i++) {
+		const DataTile &t = tiles.at(i);
+		list.append(DataTile(t.xy(), data.value(t.key()), t.key()));
+	}
 
-	return QByteArray();
+	return list;
 }
 
 void SqliteMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 {
-	Q_UNUSED(flags);
 	qreal scale = OSM::zoom2scale(_zoom, _tileSize);
 	QPoint tile = OSM::mercator2tile(QPointF(rect.topLeft().x() * scale,
 	  -rect.topLeft().y() * scale) * _mapRatio, _zoom);
@@ -200,19 +231,33 @@ void SqliteMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		for (int j = 0; j < height; j++) {
 			QPixmap pm;
 			QPoint t(tile.x() + i, tile.y() + j);
-			QString key = path() + "-" + QString::number(_zoom) + "_"
-			  + QString::number(t.x()) + "_" + QString::number(t.y());
+			quint64 key = TileCache::key(_zoom, t);
 
-			if (QPixmapCache::find(key, &pm)) {
+			if (isRunning(key))
+				continue;
+
+			if (_tileCache.find(key, &pm, _mapRatio)) {
 				QPointF tp(tl.x() + (t.x() - tile.x()) * tileSize(),
 				  tl.y() + (t.y() - tile.y()) * tileSize());
 				drawTile(painter, pm, tp);
-			} else
-				tiles.append(DataTile(t, tileData(_zoom, t), key));
+			} else if (_coverage.contains(_zoom, t))
+				tiles.append(DataTile(t, _zoom, this, key));
 		}
 	}
 
-	QFuture<void> future = QtConcurrent::map(tiles, &DataTile::load);
+	if (tiles.isEmpty())
+		return;
+	if (!(flags & Map::Block)) {
+		std::sort(tiles.begin(), tiles.end(), TileOrder<DataTile>(QPointF(
+		  tile.x() + (width - 1) / 2.0, tile.y() + (height - 1) / 2.0)));
+		runJob(new DataTileJob(tiles));
+		return;
+	}
+
+	/* All the tiles are needed at once, read them in a single batch */
+	tiles = tilesData(_zoom, tiles);
+	QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+	  tiles, &DataTile::load);
 	future.waitForFinished();
 
 	for (int i = 0; i < tiles.size(); i++) {
@@ -221,7 +266,7 @@ void SqliteMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		if (pm.isNull())
 			continue;
 
-		QPixmapCache::insert(mt.key(), pm);
+		_tileCache.insert(mt.key(), pm);
 
 		QPointF tp(tl.x() + (mt.xy().x() - tile.x()) * tileSize(),
 		  tl.y() + (mt.xy().y() - tile.y()) * tileSize());
@@ -235,6 +280,63 @@ void SqliteMap::drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp)
 	painter->drawPixmap(tp, pixmap);
 }
 
+bool SqliteMap::isRunning(quint64 key) const
+{
+	for (int i = 0; i < _jobs.size(); i++) {
+		const QList<DataTile> &tiles = _jobs.at(i)->tiles();
+		for (int j = 0; j < tiles.size(); j++)
+			if (tiles.at(j).key() == key)
+				return true;
+	}
+
+	return false;
+}
+
+void SqliteMap::runJob(DataTileJob *job)
+{
+	_jobs.append(job);
+
+	connect(job, &DataTileJob::finished, this, &SqliteMap::jobFinished);
+	job->run();
+}
+
+void SqliteMap::removeJob(DataTileJob *job)
+{
+	_jobs.removeOne(job);
+	job->deleteLater();
+}
+
+void SqliteMap::jobFinished(DataTileJob *job)
+{
+	const QList<DataTile> &tiles = job->tiles();
+
+	for (int i = 0; i < tiles.size(); i++) {
+		const DataTile &mt = tiles.at(i);
+		if (!mt.pixmap().isNull())
+			_tileCache.insert(mt.key(), mt.pixmap());
+	}
+
+	removeJob(job);
+
+	emit tilesLoaded();
+}
+
+void SqliteMap::cancelJobs(bool wait)
+{
+	for (int i = 0; i < _jobs.size(); i++)
+		_jobs.at(i)->cancel(wait);
+
+	/* Waiting cancels (unload) drop the jobs including the results of the
+	   jobs that finished but whose finished signal is still queued */
+	if (wait) {
+		while (!_jobs.isEmpty()) {
+			DataTileJob *job = _jobs.first();
+			job->disconnect(this);
+			removeJob(job);
+		}
+	}
+}
+
 QPointF SqliteMap::ll2xy(const Coordinates &c)
 {
 	qreal scale = OSM::zoom2scale(_zoom, _tileSize);
@@ -242,6 +344,11 @@ QPointF SqliteMap::ll2xy(const Coordinates &c)
 	return QPointF(m.x() / scale, m.y() / -scale) / _mapRatio;
 }
 
+void SqliteMap::ll2xy(const Coordinates *c, QPointF *p, int n)
+{
+	OSM::ll2xy(c, p, n, OSM::zoom2scale(_zoom, _tileSize), _mapRatio);
+}
+
 Coordinates SqliteMap::xy2ll(const QPointF &p)
 {
 	qreal scale = OSM::zoom2scale(_zoom, _tileSize);
@@ -4,9 +4,15 @@
 #include <QSqlDatabase>
 #include "common/range.h"
 #include "map.h"
+#include "tilecache.h"
+#include "tilecoverage.h"
+#include "datatilejob.h"
+#include "sqlitetiles.h"
 
-class SqliteMap : public Map
+class SqliteMap : public Map, public DataTileSource
 {
+	Q_OBJECT
+
 public:
 	SqliteMap(const QString &fileName, QObject *parent = 0);
 
@@ -15,13 +21,14 @@ public:
 	qreal resolution(const QRectF &rect);
 
 	int zoom() const {return _zoom;}
-	void setZoom(int zoom) {_zoom = zoom;}
+	void setZoom(int zoom) {cancelJobs(false); _zoom = zoom;}
 	int zoomFit(const QSize &size, const RectC &rect);
 	int zoomIn();
 	int zoomOut();
 
 	QPointF ll2xy(const Coordinates &c);
 	Coordinates xy2ll(const QPointF &p);
+	void ll2xy(const Coordinates *c, QPointF *p, int n);
 
 	void draw(QPainter *painter, const QRectF &rect, Flags flags);
 
@@ -34,19 +41,32 @@ public:
 
 	static Map *create(const QString &path, const Projection &proj, bool *isDir);
 
+	QByteArray tileData(int zoom, const QPoint &tile);
+
+private slots:
+	void jobFinished(DataTileJob *job);
+
 private:
 	int limitZoom(int zoom) const;
 	qreal tileSize() const;
-	QByteArray tileData(int zoom, const QPoint &tile) const;
+	QList<DataTile> tilesData(int zoom, const QList<DataTile> &tiles);
 	void drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp);
+	bool isRunning(quint64 key) const;
+	void runJob(DataTileJob *job);
+	void removeJob(DataTileJob *job);
+	void cancelJobs(bool wait);
 
 	QSqlDatabase _db;
+	SQLiteTiles _tiles;
 
 	RectC _bounds;
 	Range _zooms;
 	int _zoom;
 	int _tileSize;
 	qreal _mapRatio;
+	TileCache _tileCache;
+	TileCoverage _coverage;
+	QList<DataTileJob*> _jobs;
 
 	bool _valid;
 	QString _errorString;
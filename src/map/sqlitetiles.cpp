@@ -0,0 +1,108 @@
+#include <QStringList>
+#include <QSqlError>
+#include "sqlitetiles.h"
+
+#define MMAP_SIZE 268435456 /* 256MB */
+
+SQLiteTiles::Query::~Query()
+{
+	_query = QSqlQuery();
+	_tiles.release(_connection);
+}
+
+bool SQLiteTiles::Query::exec(const QString &sql)
+{
+	_query = QSqlQuery(_connection->db);
+	_query.setForwardOnly(true);
+
+	return _query.exec(sql);
+}
+
+void SQLiteTiles::open(const QString &fileName, const QString &tileQuery)
+{
+	_fileName = fileName;
+	_tileQuery = tileQuery;
+}
+
+void SQLiteTiles::close()
+{
+	QMutexLocker locker(&_lock);
+
+	for (int i = 0; i < _pool.size(); i++) {
+		Connection *c = _pool.at(i);
+		QString name(c->db.connectionName());
+
+		c->query = QSqlQuery();
+		c->db.close();
+		delete c;
+		QSqlDatabase::removeDatabase(name);
+	}
+	_pool.clear();
+}
+
+SQLiteTiles::Connection *SQLiteTiles::checkout()
+{
+	QString name;
+
+	_lock.lock();
+	if (!_pool.isEmpty()) {
+		Connection *c = _pool.takeLast();
+		_lock.unlock();
+		return c;
+	}
+	name = QString("%1#%2#%3").arg(_fileName).arg((quintptr)this, 0, 16)
+	  .arg(_serial++);
+	_lock.unlock();
+
+	Connection *c = new Connection();
+	c->db = QSqlDatabase::addDatabase("QSQLITE", name);
+	c->db.setDatabaseName(_fileName);
+	c->db.setConnectOptions("QSQLITE_OPEN_READONLY");
+	if (!c->db.open())
+		qWarning("%s: %s", qUtf8Printable(_fileName),
+		  qUtf8Printable(c->db.lastError().text()));
+	else {
+		QSqlQuery pragma(c->db);
+		pragma.exec(QString("PRAGMA mmap_size=%1").arg(MMAP_SIZE));
+	}
+
+	c->query = QSqlQuery(c->db);
+	c->query.setForwardOnly(true);
+	c->query.prepare(_tileQuery);
+
+	return c;
+}
+
+void SQLiteTiles::release(Connection *c)
+{
+	QMutexLocker locker(&_lock);
+	_pool.append(c);
+}
+
+QByteArray SQLiteTiles::tile(const QVariantList &key)
+{
+	Connection *c = checkout();
+	QSqlQuery &query = c->query;
+	QByteArray data;
+
+	for (int i = 0; i < key.size(); i++)
+		query.bindValue(i, key.at(i));
+	if (query.exec() && query.first())
+		data = query.value(0).toByteArray();
+	query.finish();
+
+	release(c);
+
+	return data;
+}
+
+QString SQLiteTiles::valueList(const QSet<qint64> &values)
+{
+	QStringList list;
+
+	for (QSet<qint64>::const_iterator it = values.constBegin();
+	  it != values.constEnd(); ++it)
+		list.append(QString::number(*it));
+
+	return list.join(',');
+}
@@ -0,0 +1,69 @@
+#ifndef SQLITETILES_H
+#define SQLITETILES_H
+
+#include <QList>
+#include <QSet>
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QVariant>
+
+/* Tile data access to a SQLite tiles database that can be used from any
+   thread. The read-only, memory mapped connections (with their prepared tile
+   query) are kept in a pool and every read checks out a connection for its
+   duration, so a connection is never used by two threads at once and there
+   are never more connections than concurrent reads. The connections are
+   created on first use and are all closed in close(), which must only be
+   called when no tile reads are running (the tile jobs have been canceled). */
+class SQLiteTiles
+{
+private:
+	struct Connection {
+		QSqlDatabase db;
+		QSqlQuery query;
+	};
+
+public:
+	/* A (batch) query holding a pooled connection for its lifetime */
+	class Query
+	{
+	public:
+		Query(SQLiteTiles &tiles)
+		  : _tiles(tiles), _connection(tiles.checkout()) {}
+		~Query();
+
+		bool exec(const QString &sql);
+		bool next() {return _query.next();}
+		QVariant value(int index) const {return _query.value(index);}
+
+	private:
+		SQLiteTiles &_tiles;
+		Connection *_connection;
+		QSqlQuery _query;
+	};
+
+	SQLiteTiles() : _serial(0) {}
+	~SQLiteTiles() {close();}
+
+	/* The tile query gets the tile key values as its positional (?)
+	   parameters and returns the tile data as its first column. */
+	void open(const QString &fileName, const QString &tileQuery);
+	void close();
+
+	QByteArray tile(const QVariantList &key);
+
+	/* "v1,v2,...,vn" list for batch query IN clauses */
+	static QString valueList(const QSet<qint64> &values);
+
+private:
+	Connection *checkout();
+	void release(Connection *c);
+
+	QString _fileName;
+	QString _tileQuery;
+	QList<Connection*> _pool;
+	int _serial;
+	QMutex _lock;
+};
+
+#endif // SQLITETILES_H
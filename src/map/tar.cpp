@@ -1,6 +1,12 @@
 #include <cctype>
 #include <QFile>
 #include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QCryptographicHash>
+#include "common/programpaths.h"
 #include "tar.h"
 
 
@@ -9,6 +15,10 @@
 #define BLOCKCOUNT(size) \
 	((size)/BLOCKSIZE + ((size) % BLOCKSIZE > 0 ? 1 : 0))
 
+#define MAGIC   0x54415249
+#define VERSION 1
+#define SUFFIX  ".idx"
+
 struct TARHeader
 {
 	char name[100];               /*   0 */
@@ -51,16 +61,30 @@ bool Tar::open()
 		return false;
 	}
 
+	_size = _file.size();
+	_data = _file.map(0, _size);
+
 	if (!_index.isEmpty())
 		return true;
 
 	QFileInfo fi(_file.fileName());
 	QString tmiPath = fi.path() + "/" + fi.completeBaseName() + ".tmi";
 
-	if (loadTmi(tmiPath))
+	if (loadTmi(tmiPath) || loadIndex())
 		return true;
-	else
-		return loadTar();
+	if (!loadTar())
+		return false;
+
+	saveIndex();
+
+	return true;
+}
+
+void Tar::close()
+{
+	/* Closing the file also unmaps the data */
+	_file.close();
+	_data = 0;
 }
 
 bool Tar::loadTar()
@@ -72,7 +96,7 @@ bool Tar::loadTar()
 
 	while ((ret = _file.read(buffer, BLOCKSIZE))) {
 		if (ret < BLOCKSIZE) {
-			_file.close();
+			close();
 			_index.clear();
 			_errorString = "Error reading TAR header block";
 			return false;
@@ -80,7 +104,7 @@ bool Tar::loadTar()
 		size = number(hdr->size, sizeof(hdr->size));
 		_index.insert(hdr->name, _file.pos() / BLOCKSIZE - 1);
 		if (!_file.seek(_file.pos() + BLOCKCOUNT(size) * BLOCKSIZE)) {
-			_file.close();
+			close();
 			_index.clear();
 			_errorString = "Error skipping data blocks";
 			return false;
@@ -117,6 +141,70 @@ bool Tar::loadTmi(const QString &path)
 	return true;
 }
 
+/* On-disk copy of the index in the cache dir, bound to the archive path,
+   size and modification time. It replaces the walk through all the archive
+   headers on the next open. */
+QString Tar::indexFile() const
+{
+	QByteArray hash(QCryptographicHash::hash(QFileInfo(_file.fileName())
+	  .absoluteFilePath().toUtf8(), QCryptographicHash::Sha1));
+
+	return QDir(ProgramPaths::tarCacheDir()).filePath(
+	  QString::fromLatin1(hash.toHex()) + SUFFIX);
+}
+
+bool Tar::loadIndex()
+{
+	QFile file(indexFile());
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+
+	QFileInfo fi(_file.fileName());
+	quint32 magic;
+	quint16 version;
+	qint64 size, time;
+	QString path;
+
+	stream >> magic >> version >> size >> time >> path;
+	if (!(stream.status() == QDataStream::Ok && magic == MAGIC
+	  && version == VERSION && size == fi.size()
+	  && time == fi.lastModified().toMSecsSinceEpoch()
+	  && path == fi.absoluteFilePath()))
+		return false;
+
+	stream >> _index;
+	if (stream.status() != QDataStream::Ok) {
+		_index.clear();
+		return false;
+	}
+
+	return true;
+}
+
+void Tar::saveIndex() const
+{
+	if (!QDir().mkpath(ProgramPaths::tarCacheDir()))
+		return;
+
+	QSaveFile file(indexFile());
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+
+	QFileInfo fi(_file.fileName());
+	stream << (quint32)MAGIC << (quint16)VERSION << (qint64)fi.size()
+	  << (qint64)fi.lastModified().toMSecsSinceEpoch()
+	  << fi.absoluteFilePath() << _index;
+
+	if (stream.status() == QDataStream::Ok)
+		file.commit();
+}
+
 QByteArray Tar::file(const QString &name)
 {
 	char buffer[BLOCKSIZE];
@@ -128,6 +216,19 @@ QByteArray Tar::file(const QString &name)
 		return QByteArray();
 
 	Q_ASSERT(_file.isOpen());
+
+	if (_data) {
+		quint64 offset = it.value() * BLOCKSIZE;
+		if (offset + BLOCKSIZE > (quint64)_size)
+			return QByteArray();
+		const TARHeader *mhdr = (const TARHeader*)(_data + offset);
+		size = number(mhdr->size, sizeof(mhdr->size));
+		if (offset + BLOCKSIZE + size > (quint64)_size)
+			return QByteArray();
+		return QByteArray((const char*)_data + offset + BLOCKSIZE, size);
+	}
+
+	QMutexLocker locker(&_lock);
 	if (_file.seek(it.value() * BLOCKSIZE)) {
 		if (_file.read(buffer, BLOCKSIZE) < BLOCKSIZE)
 			return QByteArray();
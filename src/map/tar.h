@@ -4,14 +4,18 @@
 #include <QStringList>
 #include <QMap>
 #include <QFile>
+#include <QMutex>
 
+/* The file() lookups are thread-safe. When the archive can be memory mapped,
+   the files are read directly from the mapping, otherwise the (shared) file
+   access is serialized. */
 class Tar
 {
 public:
-	Tar(const QString &name) : _file(name) {}
+	Tar(const QString &name) : _file(name), _data(0), _size(0) {}
 
 	bool open();
-	void close() {_file.close();}
+	void close();
 	const QString &errorString() const {return _errorString;}
 
 	QStringList files() const {return _index.keys();}
@@ -24,8 +28,14 @@ public:
 private:
 	bool loadTar();
 	bool loadTmi(const QString &path);
+	bool loadIndex();
+	void saveIndex() const;
+	QString indexFile() const;
 
 	QFile _file;
+	uchar *_data;
+	qint64 _size;
+	QMutex _lock;
 	QMap<QString, quint64> _index;
 	QString _errorString;
 };
@@ -0,0 +1,122 @@
+#include <QFont>
+#include <QFontMetrics>
+#include <QTextLayout>
+#include "textcache.h"
+
+#define CACHE_SIZE 2048
+
+/* Not a function-local static, the storage must outlive the thread pools
+   (their threads delete the caches on exit) */
+QThreadStorage<TextCache::Cache*> TextCache::_caches;
+
+TextCache::Cache::Cache()
+  : blocks("Label texts", CacheRegistry::Items, &lock, CACHE_SIZE),
+  chars("Path label texts", CacheRegistry::Items, &lock, CACHE_SIZE)
+{
+}
+
+TextCache::Cache *TextCache::cache()
+{
+	if (!_caches.hasLocalData())
+		_caches.setLocalData(new Cache());
+
+	return _caches.localData();
+}
+
+static QString key(const QString &text, const QFont &font, qreal width = 0)
+{
+	return font.key() + QLatin1Char('\n') + QString::number(width)
+	  + QLatin1Char('\n') + text;
+}
+
+QList<QGlyphRun> TextCache::block(const QString &text, const QFont &font,
+  qreal width)
+{
+	Cache *c = cache();
+	QString k(key(text, font, width));
+
+	/* Only the registry statistics read the cache from other threads */
+	c->lock.lock();
+	QList<QGlyphRun> *cached = c->blocks.object(k);
+	if (cached) {
+		QList<QGlyphRun> runs(*cached);
+		c->lock.unlock();
+		return runs;
+	}
+	c->lock.unlock();
+
+	QFontMetricsF fm(font);
+	QTextLayout layout(text, font);
+	QTextOption option(Qt::AlignHCenter);
+	option.setWrapMode(QTextOption::WordWrap);
+	layout.setTextOption(option);
+	layout.setCacheEnabled(true);
+
+	qreal height = 0;
+	layout.beginLayout();
+	for (QTextLine line = layout.createLine(); line.isValid();
+	  line = layout.createLine()) {
+		line.setLineWidth(width);
+		line.setPosition(QPointF(0, height));
+		height += fm.leading() + line.height();
+	}
+	layout.endLayout();
+
+	QList<QGlyphRun> runs(layout.glyphRuns());
+
+	c->lock.lock();
+	c->blocks.insert(k, new QList<QGlyphRun>(runs));
+	c->lock.unlock();
+
+	return runs;
+}
+
+TextCache::Chars TextCache::chars(const QString &text, const QFont &font)
+{
+	Cache *cc = cache();
+	QString k(key(text, font));
+
+	cc->lock.lock();
+	Chars *cached = cc->chars.object(k);
+	if (cached) {
+		Chars c(*cached);
+		cc->lock.unlock();
+		return c;
+	}
+	cc->lock.unlock();
+
+	QFontMetrics fm(font);
+	Chars c;
+	c.width = fm.boundingRect(text).width();
+	c.advances.resize(text.size());
+	c.glyphs.resize(text.size());
+
+	for (int i = 0; i < text.size(); i++) {
+		c.advances[i] = fm.horizontalAdvance(text.at(i));
+
+		/* Lay out every char on its own, like when drawn with drawText(),
+		   so the font fallback works the same way */
+		QTextLayout layout(QString(text.at(i)), font);
+		layout.beginLayout();
+		QTextLine line(layout.createLine());
+		layout.endLayout();
+		if (!line.isValid())
+			continue;
+
+		QList<QGlyphRun> runs(layout.glyphRuns());
+		for (int j = 0; j < runs.size(); j++) {
+			QGlyphRun &run = runs[j];
+			QVector<QPointF> pos(run.positions());
+			for (int k = 0; k < pos.size(); k++)
+				pos[k].ry() -= line.ascent();
+			run.setPositions(pos);
+		}
+		c.glyphs[i] = runs;
+	}
+
+	cc->lock.lock();
+	cc->chars.insert(k, new Chars(c));
+	cc->lock.unlock();
+
+	return c;
+}
@@ -0,0 +1,52 @@
+#ifndef TEXTCACHE_H
+#define TEXTCACHE_H
+
+#include <QList>
+#include <QVector>
+#include <QString>
+#include <QGlyphRun>
+#include <QMutex>
+#include <QThreadStorage>
+#include "common/cacheregistry.h"
+
+class QFont;
+
+/* Cache of the shaped label texts. The same labels (street names, POIs) are
+   drawn on many tiles and zooms, the cache keeps their glyph runs so they
+   are laid out only once. The glyph runs (their raw fonts) may only be used
+   in the thread they were created in, so every render thread has its own
+   cache. */
+class TextCache
+{
+public:
+	/* A text laid out into the given width, the lines centered horizontally
+	   (like a QStaticText with Qt::AlignHCenter) */
+	static QList<QGlyphRun> block(const QString &text, const QFont &font,
+	  qreal width);
+
+	/* A text drawn char-by-char along a path. The glyph runs of each char
+	   have their baseline at y = 0. */
+	struct Chars
+	{
+		int width;
+		QVector<int> advances;
+		QVector<QList<QGlyphRun> > glyphs;
+	};
+	static Chars chars(const QString &text, const QFont &font);
+
+private:
+	struct Cache
+	{
+		Cache();
+
+		QMutex lock;
+		StatsCache<QString, QList<QGlyphRun> > blocks;
+		StatsCache<QString, Chars> chars;
+	};
+
+	static Cache *cache();
+
+	static QThreadStorage<Cache*> _caches;
+};
+
+#endif // TEXTCACHE_H
@@ -1,3 +1,4 @@
+#include "textitemlist.h"
 #include "textitem.h"
 
 bool TextItem::collides(const QList<TextItem*> &list) const
@@ -15,3 +16,8 @@ bool TextItem::collides(const QList<TextItem*> &list) const
 
 	return false;
 }
+
+bool TextItem::collides(const TextItemList &list) const
+{
+	return list.collides(this);
+}
@@ -0,0 +1,113 @@
+#include <cmath>
+#include "textitemlist.h"
+
+#define CELL_SIZE 64
+
+static inline quint64 cell(qint32 x, qint32 y)
+{
+	return ((quint64)(quint32)x << 32) | (quint32)y;
+}
+
+void TextItemList::cells(const QRectF &rect, QList<quint64> &list) const
+{
+	qint32 left = (qint32)floor(rect.left() / CELL_SIZE);
+	qint32 right = (qint32)floor(rect.right() / CELL_SIZE);
+	qint32 top = (qint32)floor(rect.top() / CELL_SIZE);
+	qint32 bottom = (qint32)floor(rect.bottom() / CELL_SIZE);
+
+	for (qint32 x = left; x <= right; x++)
+		for (qint32 y = top; y <= bottom; y++)
+			list.append(cell(x, y));
+}
+
+void TextItemList::append(TextItem *item)
+{
+	_items.append(item);
+
+	/* Items with empty bounding rects never collide */
+	QRectF rect(item->boundingRect());
+	if (rect.isEmpty())
+		return;
+
+	QList<quint64> list;
+	cells(rect, list);
+	for (int i = 0; i < list.size(); i++)
+		_grid[list.at(i)].append(item);
+}
+
+void TextItemList::append(const TextItemList &list)
+{
+	for (int i = 0; i < list.size(); i++)
+		append(list.at(i));
+}
+
+void TextItemList::removeAt(int i)
+{
+	TextItem *item = _items.takeAt(i);
+
+	QRectF rect(item->boundingRect());
+	if (rect.isEmpty())
+		return;
+
+	QList<quint64> list;
+	cells(rect, list);
+	for (int j = 0; j < list.size(); j++)
+		_grid[list.at(j)].removeOne(item);
+}
+
+bool TextItemList::collides(const TextItem *item) const
+{
+	QRectF r1(item->boundingRect());
+	if (r1.isEmpty())
+		return false;
+
+	QList<quint64> list;
+	cells(r1, list);
+
+	for (int i = 0; i < list.size(); i++) {
+		QHash<quint64, QList<TextItem*> >::const_iterator it(_grid.constFind(
+		  list.at(i)));
+		if (it == _grid.constEnd())
+			continue;
+
+		const QList<TextItem*> &cl = *it;
+		for (int j = 0; j < cl.size(); j++) {
+			const TextItem *other = cl.at(j);
+			if (r1.intersects(other->boundingRect())
+			  && other->shape().intersects(item->shape()))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/* Collision of a plain (rectangular) item that is not part of any list */
+bool TextItemList::collides(const QRectF &rect) const
+{
+	if (rect.isEmpty())
+		return false;
+
+	QList<quint64> list;
+	cells(rect, list);
+
+	QPainterPath shape;
+	shape.addRect(rect);
+
+	for (int i = 0; i < list.size(); i++) {
+		QHash<quint64, QList<TextItem*> >::const_iterator it(_grid.constFind(
+		  list.at(i)));
+		if (it == _grid.constEnd())
+			continue;
+
+		const QList<TextItem*> &cl = *it;
+		for (int j = 0; j < cl.size(); j++) {
+			const TextItem *other = cl.at(j);
+			if (rect.intersects(other->boundingRect())
+			  && other->shape().intersects(shape))
+				return true;
+		}
+	}
+
+	return false;
+}
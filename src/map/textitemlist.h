@@ -0,0 +1,35 @@
+#ifndef TEXTITEMLIST_H
+#define TEXTITEMLIST_H
+
+#include <QList>
+#include <QHash>
+#include "textitem.h"
+
+/* List of the placed text items with a uniform grid index of their bounding
+   rects. The collision checks only test the items sharing a grid cell with
+   the checked item rather than all the items, with the same results. The
+   list keeps the insertion (paint) order and does not own the items. */
+class TextItemList
+{
+public:
+	typedef QList<TextItem*>::const_iterator const_iterator;
+
+	void append(TextItem *item);
+	void append(const TextItemList &list);
+	void removeAt(int i);
+	bool collides(const TextItem *item) const;
+	bool collides(const QRectF &rect) const;
+
+	int size() const {return _items.size();}
+	TextItem *at(int i) const {return _items.at(i);}
+	const_iterator begin() const {return _items.constBegin();}
+	const_iterator end() const {return _items.constEnd();}
+
+private:
+	void cells(const QRectF &rect, QList<quint64> &list) const;
+
+	QList<TextItem*> _items;
+	QHash<quint64, QList<TextItem*> > _grid;
+};
+
+#endif // TEXTITEMLIST_H
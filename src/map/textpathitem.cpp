@@ -1,5 +1,6 @@
 #include <QFont>
 #include <QPainter>
+#include "textcache.h"
 #include "textpathitem.h"
 
 #define CHAR_RATIO     0.55
@@ -243,12 +244,63 @@ static qreal diff(qreal a1, qreal a2)
 	return (d > 180) ? 360 - d : d;
 }
 
+static QRectF bounds(const QPolygonF &path)
+{
+	return path.boundingRect();
+}
+
+static QRectF bounds(const QPainterPath &path)
+{
+	return path.controlPointRect();
+}
+
+/* QRectF::intersects() is false for the empty (horizontal or vertical line)
+   bounding rects */
+static bool overlaps(const QRectF &r1, const QRectF &r2)
+{
+	return (r1.left() <= r2.right() && r1.right() >= r2.left()
+	  && r1.top() <= r2.bottom() && r1.bottom() >= r2.top());
+}
+
+static qreal maxLength(const QPolygonF &path)
+{
+	qreal length = 0;
+
+	for (int i = 1; i < path.size(); i++)
+		length += QLineF(path.at(i-1), path.at(i)).length();
+
+	return length;
+}
+
+static qreal maxLength(const QPainterPath &path)
+{
+	qreal max = 0, length = 0;
+
+	for (int i = 1; i < path.elementCount(); i++) {
+		QPainterPath::Element e(path.elementAt(i));
+
+		if (e.isLineTo())
+			length += QLineF(path.elementAt(i-1), e).length();
+		else {
+			max = qMax(max, length);
+			length = 0;
+		}
+	}
+
+	return qMax(max, length);
+}
+
 template<class T>
 static QPainterPath textPath(const T &path, qreal textWidth, qreal charWidth,
   const QRectF &tileRect)
 {
 	if (path.isEmpty())
 		return QPainterPath();
+	/* Most of the candidate lines are rejected, so check whether the line
+	   can hold the text at all (the clipped line can only be shorter) before
+	   the much more expensive clipping */
+	if (!overlaps(bounds(path), tileRect) || maxLength(path) <= textWidth)
+		return QPainterPath();
 
 	QList<QPolygonF> lines(polyLines(path, tileRect));
 
@@ -360,15 +412,15 @@ void TextPathItem::paint(QPainter *painter) const
 
 	if (_text && _font && _color) {
 		QFontMetrics fm(*_font);
-		int textWidth = fm.boundingRect(*_text).width();
+		TextCache::Chars chars(TextCache::chars(*_text, *_font));
+		int textWidth = chars.width;
 		int imgWidth = _img
 		  ? (_img->width() / _img->devicePixelRatioF()) + PADDING : 0;
 		qreal imgPercent = imgWidth / _path.length();
 		qreal factor = textWidth / qMax(_path.length(), (qreal)(textWidth));
 		qreal percent = ((1.0 - factor) + imgPercent) / 2.0;
 		QTransform t = painter->transform();
-
-		painter->setFont(*_font);
+		int d = fm.descent();
 
 		if (_haloColor) {
 			painter->setPen(*_haloColor);
@@ -376,21 +428,23 @@ void TextPathItem::paint(QPainter *painter) const
 			for (int i = 0; i < _text->size(); i++) {
 				QPointF point = _path.pointAtPercent(percent);
 				qreal angle = _path.angleAtPercent(percent);
-				QChar c = _text->at(i);
+				const QList<QGlyphRun> &c = chars.glyphs.at(i);
 
 				painter->translate(point);
 				painter->rotate(-angle);
-				painter->drawText(QPoint(-1, fm.descent() - 1), c);
-				painter->drawText(QPoint(1, fm.descent() + 1), c);
-				painter->drawText(QPoint(-1, fm.descent() + 1), c);
-				painter->drawText(QPoint(1, fm.descent() -1), c);
-				painter->drawText(QPoint(0, fm.descent() - 1), c);
-				painter->drawText(QPoint(0, fm.descent() + 1), c);
-				painter->drawText(QPoint(-1, fm.descent()), c);
-				painter->drawText(QPoint(1, fm.descent()), c);
+				for (int j = 0; j < c.size(); j++) {
+					painter->drawGlyphRun(QPointF(-1, d - 1), c.at(j));
+					painter->drawGlyphRun(QPointF(1, d + 1), c.at(j));
+					painter->drawGlyphRun(QPointF(-1, d + 1), c.at(j));
+					painter->drawGlyphRun(QPointF(1, d - 1), c.at(j));
+					painter->drawGlyphRun(QPointF(0, d - 1), c.at(j));
+					painter->drawGlyphRun(QPointF(0, d + 1), c.at(j));
+					painter->drawGlyphRun(QPointF(-1, d), c.at(j));
+					painter->drawGlyphRun(QPointF(1, d), c.at(j));
+				}
 				painter->setTransform(t);
 
-				int width = fm.horizontalAdvance(_text->at(i));
+				int width = chars.advances.at(i);
 				percent += ((qreal)width / (qreal)textWidth) * factor;
 			}
 			percent = ((1.0 - factor) + imgPercent) / 2.0;
@@ -400,13 +454,15 @@ void TextPathItem::paint(QPainter *painter) const
 		for (int i = 0; i < _text->size(); i++) {
 			QPointF point = _path.pointAtPercent(percent);
 			qreal angle = _path.angleAtPercent(percent);
+			const QList<QGlyphRun> &c = chars.glyphs.at(i);
 
 			painter->translate(point);
 			painter->rotate(-angle);
-			painter->drawText(QPoint(0, fm.descent()), _text->at(i));
+			for (int j = 0; j < c.size(); j++)
+				painter->drawGlyphRun(QPointF(0, d), c.at(j));
 			painter->setTransform(t);
 
-			int width = fm.horizontalAdvance(_text->at(i));
+			int width = chars.advances.at(i);
 			percent += ((qreal)width / (qreal)textWidth) * factor;
 		}
 	}
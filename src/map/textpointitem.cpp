@@ -3,7 +3,7 @@
 #include <QFontMetrics>
 #include <QImage>
 #include <QPainter>
-#include <QStaticText>
+#include "textcache.h"
 #include "textpointitem.h"
 
 
@@ -81,26 +81,26 @@ void TextPointItem::paint(QPainter *painter) const
 			painter->setFont(*_font);
 			painter->drawText(_textRect, FLAGS, *_text);
 		} else if (_haloColor) {
-			QStaticText st(*_text);
-			st.setTextFormat(Qt::PlainText);
-			st.setTextWidth(_textRect.width());
-			st.setTextOption(QTextOption(Qt::AlignHCenter));
-			st.setPerformanceHint(QStaticText::AggressiveCaching);
+			QList<QGlyphRun> runs(TextCache::block(*_text, *_font,
+			  _textRect.width()));
+			QPointF tl(_textRect.topLeft());
 
 			painter->setPen(*_haloColor);
-			painter->setFont(*_font);
-
-			painter->drawStaticText(_textRect.topLeft() + QPointF(-1, -1), st);
-			painter->drawStaticText(_textRect.topLeft() + QPointF(+1, +1), st);
-			painter->drawStaticText(_textRect.topLeft() + QPointF(-1, +1), st);
-			painter->drawStaticText(_textRect.topLeft() + QPointF(+1, -1), st);
-			painter->drawStaticText(_textRect.topLeft() + QPointF(0, -1), st);
-			painter->drawStaticText(_textRect.topLeft() + QPointF(0, +1), st);
-			painter->drawStaticText(_textRect.topLeft() + QPointF(-1, 0), st);
-			painter->drawStaticText(_textRect.topLeft() + QPointF(+1, 0), st);
+			for (int i = 0; i < runs.size(); i++) {
+				const QGlyphRun &run = runs.at(i);
+				painter->drawGlyphRun(tl + QPointF(-1, -1), run);
+				painter->drawGlyphRun(tl + QPointF(+1, +1), run);
+				painter->drawGlyphRun(tl + QPointF(-1, +1), run);
+				painter->drawGlyphRun(tl + QPointF(+1, -1), run);
+				painter->drawGlyphRun(tl + QPointF(0, -1), run);
+				painter->drawGlyphRun(tl + QPointF(0, +1), run);
+				painter->drawGlyphRun(tl + QPointF(-1, 0), run);
+				painter->drawGlyphRun(tl + QPointF(+1, 0), run);
+			}
 
 			painter->setPen(*_color);
-			painter->drawStaticText(_textRect.topLeft(), st);
+			for (int i = 0; i < runs.size(); i++)
+				painter->drawGlyphRun(tl, runs.at(i));
 		} else {
 			painter->setPen(*_color);
 			painter->setFont(*_font);
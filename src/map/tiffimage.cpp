@@ -0,0 +1,547 @@
+#include <cstring>
+#include <zlib.h>
+#include "common/tifffile.h"
+#include "tiffimage.h"
+
+#define NewSubfileTypeTag         254
+#define ImageWidthTag             256
+#define ImageLengthTag            257
+#define BitsPerSampleTag          258
+#define CompressionTag            259
+#define PhotometricTag            262
+#define StripOffsetsTag           273
+#define SamplesPerPixelTag        277
+#define RowsPerStripTag           278
+#define StripByteCountsTag        279
+#define PlanarConfigurationTag    284
+#define PredictorTag              317
+#define ColorMapTag               320
+#define TileWidthTag              322
+#define TileLengthTag             323
+#define TileOffsetsTag            324
+#define TileByteCountsTag         325
+#define SampleFormatTag           339
+#define JPEGTablesTag             347
+
+#define COMPRESSION_NONE          1
+#define COMPRESSION_LZW           5
+#define COMPRESSION_JPEG          7
+#define COMPRESSION_DEFLATE       8
+#define COMPRESSION_DEFLATE_OLD   32946
+
+#define PHOTOMETRIC_WHITEISZERO   0
+#define PHOTOMETRIC_BLACKISZERO   1
+#define PHOTOMETRIC_RGB           2
+#define PHOTOMETRIC_PALETTE       3
+#define PHOTOMETRIC_YCBCR         6
+
+/* APP14 Adobe marker, transform = 0 (RGB) */
+#define ADOBE_NO_TRANSFORM \
+  "\xFF\xEE\x00\x0E" "Adobe" "\x00\x64\x00\x00\x00\x00\x00"
+
+#define FILETYPE_REDUCEDIMAGE     1
+#define FILETYPE_MASK             4
+
+#define MAX_IFDS                  32
+#define MAX_VALUES                16777216
+#define MAX_TILE_DATA             67108864 /* 64MB */
+
+static int typeSize(quint16 type)
+{
+	switch (type) {
+		case TIFF_SHORT:
+			return 2;
+		case TIFF_LONG:
+			return 4;
+		case TIFF_RATIONAL:
+		case TIFF_SRATIONAL:
+		case TIFF_DOUBLE:
+			return 8;
+		default:
+			return 1;
+	}
+}
+
+static bool readValues(TIFFFile &file, quint16 type, quint32 count, qint64 pos,
+  QVector<quint32> &values)
+{
+	if (count > MAX_VALUES || !file.seek(pos))
+		return false;
+
+	values.resize(count);
+	for (quint32 i = 0; i < count; i++) {
+		if (type == TIFF_SHORT) {
+			quint16 val;
+			if (!file.readValue(val))
+				return false;
+			values[i] = val;
+		} else if (type == TIFF_LONG) {
+			if (!file.readValue(values[i]))
+				return false;
+		} else if (type == TIFF_BYTE) {
+			quint8 val;
+			if (!file.readValue(val))
+				return false;
+			values[i] = val;
+		} else
+			return false;
+	}
+
+	return true;
+}
+
+/* TIFF flavour of LZW - MSB first codes with the "early change" of the code
+   width. Every dictionary entry is the previous entry extended by one byte,
+   so the entries can be stored as (offset, length) references to the already
+   decoded data. */
+static bool lzw(const QByteArray &data, QByteArray &out, int size)
+{
+	const quint8 *dp = (const quint8*)data.constData();
+	qint64 bits = (qint64)data.size() * 8;
+	QVector<quint32> start(4096), length(4096);
+	quint32 prevStart = 0, prevLength = 0;
+	int width = 9, next = 258;
+	qint64 bp = 0;
+	bool first = true;
+
+	/* Appending the dictionary entries must never reallocate the data */
+	out.reserve(size + 4096);
+
+	while (bp + width <= bits && out.size() < size) {
+		int code = 0;
+		for (int i = 0; i < width; i++, bp++)
+			code = (code << 1) | ((dp[bp >> 3] >> (7 - (bp & 7))) & 1);
+
+		if (code == 257)
+			break;
+		if (code == 256) {
+			width = 9;
+			next = 258;
+			first = true;
+			continue;
+		}
+
+		quint32 pos = out.size();
+		if (first) {
+			if (code > 255)
+				return false;
+			out.append((char)code);
+			prevStart = pos;
+			prevLength = 1;
+			first = false;
+			continue;
+		}
+
+		if (code < 256)
+			out.append((char)code);
+		else if (code < next)
+			out.append(out.constData() + start.at(code), length.at(code));
+		else if (code == next) {
+			out.append(out.constData() + prevStart, prevLength);
+			out.append(out.at(prevStart));
+		} else
+			return false;
+
+		if (next < 4096) {
+			start[next] = prevStart;
+			length[next] = prevLength + 1;
+			next++;
+		}
+		if (next >= (1 << width) - 1 && width < 12)
+			width++;
+
+		prevStart = pos;
+		prevLength = out.size() - pos;
+	}
+
+	return (out.size() >= size);
+}
+
+static bool inflateData(const QByteArray &data, QByteArray &out, int size)
+{
+	z_stream strm;
+
+	out.resize(size);
+
+	strm.zalloc = Z_NULL;
+	strm.zfree = Z_NULL;
+	strm.opaque = Z_NULL;
+	strm.avail_in = data.size();
+	strm.next_in = (Bytef*)data.constData();
+	strm.avail_out = out.size();
+	strm.next_out = (Bytef*)out.data();
+
+	if (inflateInit(&strm) != Z_OK)
+		return false;
+	int ret = inflate(&strm, Z_FINISH);
+	(void)inflateEnd(&strm);
+
+	return (ret == Z_STREAM_END || (ret != Z_DATA_ERROR && !strm.avail_out));
+}
+
+bool TIFFImage::readIFD(TIFFFile &file, quint32 offset, Zoom &zoom,
+  quint32 &type, quint32 &next) const
+{
+	QVector<quint32> bps, format, offsets, sizes, colors;
+	quint32 width = 0, height = 0, tileWidth = 0, tileHeight = 0, rows = 0;
+	quint16 count, planar = 1;
+
+	type = 0;
+
+	if (!file.seek(offset))
+		return false;
+	if (!file.readValue(count))
+		return false;
+
+	for (quint16 i = 0; i < count; i++) {
+		quint16 tag, vt;
+		quint32 vc, vo;
+		QVector<quint32> values;
+
+		if (!file.seek(offset + 2 + i * 12))
+			return false;
+		if (!file.readValue(tag) || !file.readValue(vt) || !file.readValue(vc))
+			return false;
+		qint64 pos = file.pos();
+		if (!file.readValue(vo))
+			return false;
+		/* Values that fit into the offset field are stored in place */
+		if ((quint64)vc * typeSize(vt) > 4)
+			pos = vo;
+
+		if (tag == JPEGTablesTag) {
+			if (vc > MAX_TILE_DATA || !file.seek(pos))
+				return false;
+			zoom.jpegTables = file.read(vc);
+			if (zoom.jpegTables.size() != (int)vc)
+				return false;
+			continue;
+		}
+
+		switch (tag) {
+			case NewSubfileTypeTag:
+			case ImageWidthTag:
+			case ImageLengthTag:
+			case BitsPerSampleTag:
+			case CompressionTag:
+			case PhotometricTag:
+			case StripOffsetsTag:
+			case SamplesPerPixelTag:
+			case RowsPerStripTag:
+			case StripByteCountsTag:
+			case PlanarConfigurationTag:
+			case PredictorTag:
+			case ColorMapTag:
+			case TileWidthTag:
+			case TileLengthTag:
+			case TileOffsetsTag:
+			case TileByteCountsTag:
+			case SampleFormatTag:
+				if (!readValues(file, vt, vc, pos, values) || values.isEmpty())
+					return false;
+				break;
+			default:
+				continue;
+		}
+
+		switch (tag) {
+			case NewSubfileTypeTag:
+				type = values.first();
+				break;
+			case ImageWidthTag:
+				width = values.first();
+				break;
+			case ImageLengthTag:
+				height = values.first();
+				break;
+			case BitsPerSampleTag:
+				bps = values;
+				break;
+			case CompressionTag:
+				zoom.compression = values.first();
+				break;
+			case PhotometricTag:
+				zoom.photometric = values.first();
+				break;
+			case SamplesPerPixelTag:
+				zoom.samples = values.first();
+				break;
+			case RowsPerStripTag:
+				rows = values.first();
+				break;
+			case PlanarConfigurationTag:
+				planar = values.first();
+				break;
+			case PredictorTag:
+				zoom.predictor = values.first();
+				break;
+			case ColorMapTag:
+				colors = values;
+				break;
+			case TileWidthTag:
+				tileWidth = values.first();
+				break;
+			case TileLengthTag:
+				tileHeight = values.first();
+				break;
+			case StripOffsetsTag:
+			case TileOffsetsTag:
+				offsets = values;
+				break;
+			case StripByteCountsTag:
+			case TileByteCountsTag:
+				sizes = values;
+				break;
+			case SampleFormatTag:
+				format = values;
+				break;
+		}
+	}
+
+	if (!file.seek(offset + 2 + count * 12) || !file.readValue(next))
+		return false;
+
+	// Only the 8 bit per sample chunky images are supported
+	if (!width || !height || width > 0xFFFFFF || height > 0xFFFFFF)
+		return false;
+	if (zoom.samples < 1 || zoom.samples > 4 || planar != 1)
+		return false;
+	if (bps.size() != zoom.samples)
+		return false;
+	for (int i = 0; i < bps.size(); i++)
+		if (bps.at(i) != 8)
+			return false;
+	for (int i = 0; i < format.size(); i++)
+		if (format.at(i) != 1)
+			return false;
+
+	switch (zoom.compression) {
+		case COMPRESSION_NONE:
+		case COMPRESSION_LZW:
+		case COMPRESSION_DEFLATE:
+		case COMPRESSION_DEFLATE_OLD:
+			if (zoom.predictor != 1 && zoom.predictor != 2)
+				return false;
+			break;
+		case COMPRESSION_JPEG:
+			if (zoom.predictor != 1)
+				return false;
+			break;
+		default:
+			return false;
+	}
+
+	switch (zoom.photometric) {
+		case PHOTOMETRIC_WHITEISZERO:
+		case PHOTOMETRIC_BLACKISZERO:
+			if (zoom.samples != 1)
+				return false;
+			break;
+		case PHOTOMETRIC_RGB:
+			if (zoom.samples != 3 && (zoom.samples != 4
+			  || zoom.compression == COMPRESSION_JPEG))
+				return false;
+			break;
+		case PHOTOMETRIC_PALETTE:
+			if (zoom.samples != 1 || colors.size() != 3 * 256)
+				return false;
+			zoom.palette.resize(256);
+			for (int i = 0; i < 256; i++)
+				zoom.palette[i] = qRgb(colors.at(i) >> 8,
+				  colors.at(i + 256) >> 8, colors.at(i + 512) >> 8);
+			break;
+		case PHOTOMETRIC_YCBCR:
+			/* The JPEG decoder does the colour space conversion */
+			if (zoom.compression != COMPRESSION_JPEG || zoom.samples != 3)
+				return false;
+			break;
+		default:
+			return false;
+	}
+
+	zoom.size = QSize(width, height);
+	if (tileWidth && tileHeight)
+		zoom.tileSize = QSize(tileWidth, tileHeight);
+	else
+		zoom.tileSize = QSize(width, (rows && rows < height) ? rows : height);
+	/* Huge strips (e.g. a single strip image) are not worth reading in parts */
+	if ((qint64)zoom.tileSize.width() * zoom.tileSize.height() * zoom.samples
+	  > MAX_TILE_DATA)
+		return false;
+
+	QSize d(dim(zoom));
+	if (offsets.size() != d.width() * d.height()
+	  || sizes.size() != offsets.size())
+		return false;
+	zoom.offsets = offsets;
+	zoom.sizes = sizes;
+
+	return true;
+}
+
+bool TIFFImage::open()
+{
+	if (!_file.open(QIODevice::ReadOnly)) {
+		_errorString = _file.errorString();
+		return false;
+	}
+
+	if (!_zooms.isEmpty())
+		return true;
+
+	TIFFFile tiff(&_file);
+	if (!tiff.isValid()) {
+		_errorString = "Not a TIFF file";
+		_file.close();
+		return false;
+	}
+
+	/* The first IFD is the full resolution image, the following
+	   reduced-resolution IFDs are the overviews */
+	quint32 ifd = tiff.ifd();
+	for (int i = 0; ifd && i < MAX_IFDS; i++) {
+		Zoom zoom;
+		quint32 type, next;
+
+		bool valid = readIFD(tiff, ifd, zoom, type, next);
+		if (!i && !valid) {
+			_errorString = "Unsupported TIFF image layout";
+			_file.close();
+			return false;
+		}
+		if (valid && (!i || ((type & FILETYPE_REDUCEDIMAGE) && !(type
+		  & FILETYPE_MASK) && zoom.size.width() < _zooms.last().size.width())))
+			_zooms.append(zoom);
+
+		ifd = valid ? next : 0;
+	}
+
+	return true;
+}
+
+QPointF TIFFImage::scale(int zoom) const
+{
+	return QPointF((qreal)size(zoom).width() / (qreal)size(0).width(),
+	  (qreal)size(zoom).height() / (qreal)size(0).height());
+}
+
+QSize TIFFImage::dim(const Zoom &zoom)
+{
+	return QSize((zoom.size.width() + zoom.tileSize.width() - 1)
+	  / zoom.tileSize.width(), (zoom.size.height() + zoom.tileSize.height() - 1)
+	  / zoom.tileSize.height());
+}
+
+QByteArray TIFFImage::tileData(int zoom, int x, int y)
+{
+	Q_ASSERT(_file.isOpen());
+	Q_ASSERT(0 <= zoom && zoom < _zooms.count());
+
+	const Zoom &z = _zooms.at(zoom);
+	int i = y * dim(z).width() + x;
+
+	if (i < 0 || i >= z.offsets.size() || z.sizes.at(i) > MAX_TILE_DATA)
+		return QByteArray();
+	if (!_file.seek(z.offsets.at(i)))
+		return QByteArray();
+
+	return _file.read(z.sizes.at(i));
+}
+
+QImage TIFFImage::image(const Zoom &zoom, const QByteArray &data,
+  int rows) const
+{
+	int width = zoom.tileSize.width();
+	int bpl = width * zoom.samples;
+	QImage img;
+
+	switch (zoom.photometric) {
+		case PHOTOMETRIC_WHITEISZERO:
+		case PHOTOMETRIC_BLACKISZERO:
+			img = QImage(width, rows, QImage::Format_Grayscale8);
+			break;
+		case PHOTOMETRIC_PALETTE:
+			img = QImage(width, rows, QImage::Format_Indexed8);
+			img.setColorTable(zoom.palette);
+			break;
+		default:
+			img = QImage(width, rows, (zoom.samples == 4)
+			  ? QImage::Format_RGBA8888 : QImage::Format_RGB888);
+	}
+	if (img.isNull())
+		return img;
+
+	for (int i = 0; i < rows; i++)
+		memcpy(img.scanLine(i), data.constData() + i * bpl, bpl);
+	if (zoom.photometric == PHOTOMETRIC_WHITEISZERO)
+		img.invertPixels();
+
+	return img;
+}
+
+QImage TIFFImage::tile(int zoom, int x, int y, const QByteArray &data) const
+{
+	Q_ASSERT(0 <= zoom && zoom < _zooms.count());
+
+	const Zoom &z = _zooms.at(zoom);
+	/* The edge tiles exceed the image, the last strip is only as high as
+	   the remaining image rows */
+	QSize s(qMin(z.tileSize.width(), z.size.width() - x * z.tileSize.width()),
+	  qMin(z.tileSize.height(), z.size.height() - y * z.tileSize.height()));
+	QImage img;
+
+	if (data.isEmpty())
+		return img;
+
+	if (z.compression == COMPRESSION_JPEG) {
+		if (data.size() < 2)
+			return img;
+
+		/* Abbreviated JPEG streams use the shared quantization and Huffman
+		   tables, merge them into a complete JPEG stream */
+		QByteArray jpeg((z.jpegTables.size() > 4)
+		  ? z.jpegTables.left(z.jpegTables.size() - 2) + data.mid(2) : data);
+		/* RGB JPEG data must not be converted from YCbCr by the decoder,
+		   which is what an Adobe marker with no transform says (the libtiff
+		   JPEGCOLORMODE equivalent) */
+		if (z.photometric == PHOTOMETRIC_RGB)
+			jpeg.insert(2, QByteArray(ADOBE_NO_TRANSFORM,
+			  sizeof(ADOBE_NO_TRANSFORM) - 1));
+		img = QImage::fromData(jpeg, "JPEG");
+	} else {
+		int bpl = z.tileSize.width() * z.samples;
+		int rows = (z.tileSize.width() == z.size.width())
+		  ? s.height() : z.tileSize.height();
+		QByteArray uba;
+
+		switch (z.compression) {
+			case COMPRESSION_LZW:
+				if (!lzw(data, uba, bpl * rows))
+					return img;
+				break;
+			case COMPRESSION_DEFLATE:
+			case COMPRESSION_DEFLATE_OLD:
+				if (!inflateData(data, uba, bpl * rows))
+					return img;
+				break;
+			default:
+				uba = data;
+		}
+		if (uba.size() < bpl * rows)
+			return img;
+
+		if (z.predictor == 2) {
+			uchar *dp = (uchar*)uba.data();
+			for (int i = 0; i < rows; i++) {
+				uchar *row = dp + i * bpl;
+				for (int j = z.samples; j < bpl; j++)
+					row[j] += row[j - z.samples];
+			}
+		}
+
+		img = image(z, uba, rows);
+	}
+
+	return (img.isNull() || img.size() == s)
+	  ? img : img.copy(QRect(QPoint(0, 0), s));
+}
@@ -0,0 +1,60 @@
+#ifndef TIFFIMAGE_H
+#define TIFFIMAGE_H
+
+#include <QFile>
+#include <QImage>
+#include <QList>
+#include <QVector>
+
+class TIFFFile;
+
+/* Tiled/striped TIFF image with reduced-resolution (overview) images support.
+   Only the tiles (strips) that are needed get read and decoded, the image is
+   never loaded as a whole. */
+class TIFFImage
+{
+public:
+	TIFFImage(const QString &name) : _file(name) {}
+
+	bool open();
+	void close() {_file.close();}
+	const QString &errorString() const {return _errorString;}
+
+	QString fileName() const {return _file.fileName();}
+
+	int zooms() const {return _zooms.size();}
+	QSize size(int zoom) const {return _zooms.at(zoom).size;}
+	QPointF scale(int zoom) const;
+	QSize tileSize(int zoom) const {return _zooms.at(zoom).tileSize;}
+	QSize dim(int zoom) const {return dim(_zooms.at(zoom));}
+	QByteArray tileData(int zoom, int x, int y);
+	/* Thread-safe, the tiles are decoded in parallel */
+	QImage tile(int zoom, int x, int y, const QByteArray &data) const;
+
+private:
+	struct Zoom {
+		Zoom() : compression(1), photometric(1), predictor(1), samples(1) {}
+
+		QSize size;
+		QSize tileSize;
+		quint16 compression;
+		quint16 photometric;
+		quint16 predictor;
+		quint16 samples;
+		QVector<quint32> offsets;
+		QVector<quint32> sizes;
+		QVector<QRgb> palette;
+		QByteArray jpegTables;
+	};
+
+	static QSize dim(const Zoom &zoom);
+	bool readIFD(TIFFFile &file, quint32 offset, Zoom &zoom, quint32 &type,
+	  quint32 &next) const;
+	QImage image(const Zoom &zoom, const QByteArray &data, int rows) const;
+
+	QList<Zoom> _zooms;
+	QFile _file;
+	QString _errorString;
+};
+
+#endif // TIFFIMAGE_H
@@ -5,40 +5,39 @@
 #include <QPixmap>
 #include <QPoint>
 
-class FileTile
+/* Source of the tile data for tiles that read their data in load(). As the
+   tiles are loaded in parallel, tileData() must be thread-safe. */
+class DataTileSource
 {
 public:
-	FileTile(const QPoint &xy, const QString &file)
-	  : _xy(xy), _file(file) {}
-
-	const QPoint &xy() const {return _xy;}
-	const QString &file() const {return _file;}
-	const QPixmap &pixmap() const {return _pixmap;}
-
-	void load() {_pixmap.load(_file);}
-
-private:
-	QPoint _xy;
-	QString _file;
-	QPixmap _pixmap;
+	virtual ~DataTileSource() {}
+	virtual QByteArray tileData(int zoom, const QPoint &tile) = 0;
 };
 
 class DataTile
 {
 public:
-	DataTile(const QPoint &xy, const QByteArray &data, const QString &key)
-	  : _xy(xy), _data(data), _key(key) {}
+	DataTile(const QPoint &xy, const QByteArray &data, quint64 key)
+	  : _xy(xy), _zoom(0), _data(data), _source(0), _key(key) {}
+	DataTile(const QPoint &xy, int zoom, DataTileSource *source, quint64 key)
+	  : _xy(xy), _zoom(zoom), _source(source), _key(key) {}
 
 	const QPoint &xy() const {return _xy;}
-	const QString &key() const {return _key;}
+	quint64 key() const {return _key;}
 	const QPixmap &pixmap() const {return _pixmap;}
 
-	void load() {_pixmap.loadFromData(_data);}
+	void load() {
+		if (_source)
+			_data = _source->tileData(_zoom, _xy);
+		_pixmap.loadFromData(_data);
+	}
 
 private:
 	QPoint _xy;
+	int _zoom;
 	QByteArray _data;
-	QString _key;
+	DataTileSource *_source;
+	quint64 _key;
 	QPixmap _pixmap;
 };
 
@@ -0,0 +1,134 @@
+#include <QPainter>
+#include "tilecache.h"
+
+int TileCache::_limit = 131072;
+
+bool TileCache::find(quint64 key, QPixmap *pixmap)
+{
+	QPixmap *pm = _cache.object(Key(_variant, key));
+
+	if (pm) {
+		*pixmap = *pm;
+		return true;
+	} else
+		return false;
+}
+
+bool TileCache::find(quint64 key, QPixmap *pixmap, qreal ratio)
+{
+	QPixmap *pm = _cache.object(Key(_variant, key));
+
+	if (pm) {
+		pm->setDevicePixelRatio(ratio);
+		*pixmap = *pm;
+		return true;
+	} else
+		return false;
+}
+
+void TileCache::insert(quint64 key, const QPixmap &pixmap, bool draft)
+{
+	if (_cache.maxCost() != _limit)
+		_cache.setMaxCost(_limit);
+
+	qint64 cost = ((qint64)pixmap.width() * pixmap.height() * pixmap.depth())
+	  / (8 * 1024);
+	if (draft)
+		_cache.insert(Key(_variant | DRAFT, key), new QPixmap(pixmap),
+		  qMax(cost, (qint64)1));
+	else {
+		_cache.remove(Key(_variant | DRAFT, key));
+		_cache.insert(Key(_variant, key), new QPixmap(pixmap),
+		  qMax(cost, (qint64)1));
+	}
+}
+
+bool TileCache::draw(QPainter *painter, const Key &key, const QRectF &rect,
+  int shift, const QPoint &offset)
+{
+	/* The placeholder lookups do not count in the cache statistics */
+	QPixmap *pm = _cache.QCache<Key, QPixmap>::object(key);
+	if (!pm)
+		return false;
+
+	qreal w = (qreal)pm->width() / (1U<<shift);
+	qreal h = (qreal)pm->height() / (1U<<shift);
+	painter->drawPixmap(rect, *pm, QRectF(offset.x() * w, offset.y() * h,
+	  w, h));
+
+	return true;
+}
+
+/* Draws a placeholder of a not yet rendered tile (xy is the tile index) - the
+   tile's draft or a scaled part of the cached parent (up to 4 zoom levels up)
+   or child tiles. The placeholder gets replaced on the next redraw when the
+   tile is rendered. */
+bool TileCache::drawFallback(QPainter *painter, int zoom, const QPoint &xy,
+  const QRectF &rect, const Range &zooms, int overzoom)
+{
+	if (draw(painter, Key(_variant | DRAFT, key(zoom, xy, overzoom)), rect, 0,
+	  QPoint(0, 0)))
+		return true;
+
+	for (int i = 1; i <= 4; i++) {
+		int z = zoom - i;
+		if (z < zooms.min())
+			break;
+
+		QPoint pxy(xy.x() >> i, xy.y() >> i);
+		QPoint offset(xy.x() - (pxy.x() << i), xy.y() - (pxy.y() << i));
+		if (draw(painter, Key(_variant, key(z, pxy, overzoom)), rect, i,
+		  offset))
+			return true;
+	}
+
+	if (zoom + 1 > zooms.max())
+		return false;
+
+	bool ret = false;
+	QSizeF cs(rect.width() / 2, rect.height() / 2);
+	for (int i = 0; i < 2; i++) {
+		for (int j = 0; j < 2; j++) {
+			QPoint cxy(xy.x() * 2 + i, xy.y() * 2 + j);
+			QRectF cr(QPointF(rect.left() + i * cs.width(),
+			  rect.top() + j * cs.height()), cs);
+			if (draw(painter, Key(_variant, key(zoom + 1, cxy, overzoom)), cr,
+			  0, QPoint(0, 0)))
+				ret = true;
+		}
+	}
+
+	return ret;
+}
+
+void TileCache::clear()
+{
+	if (_keep)
+		_keep = false;
+	else
+		_cache.clear();
+}
+
+void TileCache::setVariant(quint32 variant)
+{
+	if (variant == _variant)
+		return;
+
+	_previous = _variant;
+	_variant = variant;
+
+	QList<Key> keys(_cache.keys());
+	for (int i = 0; i < keys.size(); i++)
+		if ((keys.at(i).variant & ~DRAFT) != _variant
+		  && (keys.at(i).variant & ~DRAFT) != _previous)
+			_cache.remove(keys.at(i));
+}
+
+#ifndef QT_NO_DEBUG
+QDebug operator<<(QDebug dbg, const TileCache &cache)
+{
+	dbg.nospace() << "TileCache(" << cache.size() << "KB, " << cache.hits()
+	  << " hits, " << cache.misses() << " misses)";
+	return dbg.space();
+}
+#endif // QT_NO_DEBUG
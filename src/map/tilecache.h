@@ -0,0 +1,97 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <QCache>
+#include <QPair>
+#include <QPixmap>
+#include <QPoint>
+#include <QDebug>
+#include "common/cacheregistry.h"
+#include "common/hash.h"
+#include "common/range.h"
+
+class QPainter;
+
+/* Per-map LRU cache of the decoded (rendered) tiles. Unlike the global
+   QPixmapCache, the tiles of different maps do not evict each other and the
+   lookups use integer keys. The cost is the pixmap size in KB, the (per map)
+   limit is shared by all the caches.
+
+   The tiles are stored per variant (map style/layer). The tiles of the
+   previous variant are kept (within the limit) when the variant changes
+   after a clear() preceded by keep(), so switching the style back does not
+   render all the tiles again.
+
+   Draft tiles are the reduced quality tiles rendered during the user
+   interaction (Map::Draft). They are not returned by find() but are drawn
+   as the tile placeholder until the full quality tile replaces them. */
+class TileCache
+{
+public:
+	TileCache() : _cache("Tile images", CacheRegistry::KB), _variant(0),
+	  _previous(0), _keep(false) {}
+
+	static quint64 key(int zoom, const QPoint &xy, int overzoom = 0)
+	{
+		return ((quint64)(overzoom & 0xFF) << 56)
+		  | ((quint64)(zoom & 0xFF) << 48) | ((quint64)(xy.x() & 0xFFFFFF) << 24)
+		  | (quint64)(xy.y() & 0xFFFFFF);
+	}
+
+	bool find(quint64 key, QPixmap *pixmap);
+	/* Sets the device pixel ratio on the cached pixmap itself, so the drawn
+	   pixmap is not detached from the cache on every draw and keeps its
+	   cacheKey() - and thus its OpenGL texture - between the frames. */
+	bool find(quint64 key, QPixmap *pixmap, qreal ratio);
+	void insert(quint64 key, const QPixmap &pixmap, bool draft = false);
+	bool isDraft(quint64 key) const
+	  {return _cache.contains(Key(_variant | DRAFT, key));}
+	bool drawFallback(QPainter *painter, int zoom, const QPoint &xy,
+	  const QRectF &rect, const Range &zooms, int overzoom = 0);
+	void clear();
+
+	static quint32 variant(int style, int layer)
+	  {return ((quint32)((style + 1) & 0xFFFF) << 16) | ((layer + 1) & 0xFFFF);}
+	void setVariant(quint32 variant);
+	void keep() {_keep = true;}
+
+	quint64 hits() const {return _cache.hits();}
+	quint64 misses() const {return _cache.misses();}
+	int size() const {return _cache.totalCost();}
+
+	static void setCacheSize(int size) {_limit = size;}
+
+private:
+	static const quint32 DRAFT = 0x80000000U;
+
+	struct Key {
+		Key(quint32 variant, quint64 tile) : variant(variant), tile(tile) {}
+		bool operator==(const Key &other) const
+		  {return variant == other.variant && tile == other.tile;}
+
+		quint32 variant;
+		quint64 tile;
+	};
+
+	friend HASH_T qHash(const TileCache::Key &key);
+
+	bool draw(QPainter *painter, const Key &key, const QRectF &rect,
+	  int shift, const QPoint &offset);
+
+	StatsCache<Key, QPixmap> _cache;
+	quint32 _variant, _previous;
+	bool _keep;
+
+	static int _limit;
+};
+
+inline HASH_T qHash(const TileCache::Key &key)
+{
+	return Hash::combine(key.variant, key.tile);
+}
+
+#ifndef QT_NO_DEBUG
+QDebug operator<<(QDebug dbg, const TileCache &cache);
+#endif // QT_NO_DEBUG
+
+#endif // TILECACHE_H
@@ -0,0 +1,183 @@
+#include <QDataStream>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include "common/threadpools.h"
+#include "data/datacache.h"
+#include "tilecoverage.h"
+
+#define MAX_TILES 4194304
+#define MAX_BITS  16777216
+#define VERSION   1
+
+TileCoverage::~TileCoverage()
+{
+	_canceled.storeRelease(1);
+	_future.waitForFinished();
+}
+
+void TileCoverage::load(const QString &path, const QString &query,
+  TileKey key)
+{
+	if (!_path.isEmpty())
+		return;
+
+	_path = path;
+	_query = query;
+	_key = key;
+
+	if (loadIndex())
+		_ready.storeRelease(1);
+	else
+		_future = QtConcurrent::run(ThreadPools::pool(ThreadPools::Parse),
+		  &TileCoverage::scan, this);
+}
+
+/* Runs in a worker thread with its own connection, the map connections
+   can not be shared across threads */
+void TileCoverage::scan(TileCoverage *coverage)
+{
+	QString name(QString("%1#coverage#%2").arg(coverage->_path)
+	  .arg((quintptr)coverage, 0, 16));
+
+	{
+		QSqlDatabase db(QSqlDatabase::addDatabase("QSQLITE", name));
+		db.setDatabaseName(coverage->_path);
+		db.setConnectOptions("QSQLITE_OPEN_READONLY");
+		if (db.open())
+			coverage->build(db);
+	}
+
+	QSqlDatabase::removeDatabase(name);
+}
+
+void TileCoverage::build(QSqlDatabase &db)
+{
+	QSqlQuery query(db);
+	query.setForwardOnly(true);
+	if (!query.exec(_query))
+		return;
+
+	int zoom;
+	QPoint tile;
+	while (query.next()) {
+		if (_canceled.loadAcquire())
+			return;
+		_key(query, zoom, tile);
+		if (!add(zoom, tile))
+			break;
+	}
+
+	finish();
+	saveIndex();
+
+	_ready.storeRelease(1);
+}
+
+bool TileCoverage::add(int zoom, const QPoint &tile)
+{
+	if (++_count > MAX_TILES) {
+		_tiles.clear();
+		return false;
+	}
+
+	_tiles[zoom].append(tile);
+
+	return true;
+}
+
+void TileCoverage::finish()
+{
+	_indexed = (_count <= MAX_TILES);
+
+	for (QHash<int, QVector<QPoint> >::const_iterator it = _tiles.constBegin();
+	  it != _tiles.constEnd(); ++it) {
+		const QVector<QPoint> &tiles = it.value();
+		Zoom z;
+
+		int left = tiles.first().x(), right = left;
+		int top = tiles.first().y(), bottom = top;
+		for (int i = 1; i < tiles.size(); i++) {
+			const QPoint &t = tiles.at(i);
+			left = qMin(left, t.x());
+			right = qMax(right, t.x());
+			top = qMin(top, t.y());
+			bottom = qMax(bottom, t.y());
+		}
+		z.rect = QRect(QPoint(left, top), QPoint(right, bottom));
+
+		qint64 bits = (qint64)z.rect.width() * z.rect.height();
+		if (bits <= MAX_BITS) {
+			z.bits.resize(bits);
+			for (int i = 0; i < tiles.size(); i++) {
+				QPoint p(tiles.at(i) - z.rect.topLeft());
+				z.bits.setBit(p.y() * z.rect.width() + p.x());
+			}
+		}
+
+		_zooms.insert(it.key(), z);
+	}
+
+	_tiles.clear();
+	_count = 0;
+}
+
+bool TileCoverage::contains(int zoom, const QPoint &tile) const
+{
+	if (!_ready.loadAcquire() || !_indexed)
+		return true;
+
+	QMap<int, Zoom>::const_iterator it(_zooms.constFind(zoom));
+	if (it == _zooms.constEnd() || !it->rect.contains(tile))
+		return false;
+	if (it->bits.isEmpty())
+		return true;
+
+	QPoint p(tile - it->rect.topLeft());
+	return it->bits.testBit(p.y() * it->rect.width() + p.x());
+}
+
+bool TileCoverage::loadIndex()
+{
+	QByteArray ba(DataCache::loadIndex(_path));
+	if (ba.isEmpty())
+		return false;
+
+	QDataStream stream(ba);
+	stream.setVersion(QDataStream::Qt_5_0);
+
+	quint8 version;
+	qint32 count;
+	stream >> version;
+	if (version != VERSION)
+		return false;
+
+	stream >> _indexed >> count;
+	for (qint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+		qint32 zoom;
+		Zoom z;
+
+		stream >> zoom >> z.rect >> z.bits;
+		_zooms.insert(zoom, z);
+	}
+	if (stream.status() != QDataStream::Ok) {
+		_zooms.clear();
+		_indexed = false;
+		return false;
+	}
+
+	return true;
+}
+
+void TileCoverage::saveIndex() const
+{
+	QByteArray ba;
+	QDataStream stream(&ba, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_5_0);
+
+	stream << (quint8)VERSION << _indexed << (qint32)_zooms.size();
+	for (QMap<int, Zoom>::const_iterator it = _zooms.constBegin();
+	  it != _zooms.constEnd(); ++it)
+		stream << (qint32)it.key() << it->rect << it->bits;
+	if (stream.status() == QDataStream::Ok)
+		DataCache::saveIndex(_path, ba);
+}
@@ -0,0 +1,69 @@
+#ifndef TILECOVERAGE_H
+#define TILECOVERAGE_H
+
+#include <QMap>
+#include <QHash>
+#include <QVector>
+#include <QRect>
+#include <QBitArray>
+#include <QString>
+#include <QAtomicInt>
+#include <QFuture>
+
+class QSqlQuery;
+class QSqlDatabase;
+
+/* Coverage index of a tile database - a per zoom bitmap of the existing
+   tiles over their bounding rect. The index is built from a single scan
+   of the tile keys and is kept in the data cache (bound to the database
+   file size and modification time), so the tiles outside of the map
+   coverage can be skipped without a database query.
+
+   The scan runs in the background on its own database connection, until
+   it has finished contains() is true for all the tiles. Databases with too
+   many tiles are not indexed and the zoom levels with too large bitmaps are
+   indexed by their bounding rect only. */
+class TileCoverage
+{
+public:
+	/* Decodes the zoom and tile of a scan query result row */
+	typedef void (*TileKey)(const QSqlQuery &query, int &zoom, QPoint &tile);
+
+	TileCoverage() : _key(0), _indexed(false), _count(0), _ready(0),
+	  _canceled(0) {}
+	~TileCoverage();
+
+	/* Loads the index from the data cache or starts the database scan.
+	   Does nothing when the index has already been loaded/started. */
+	void load(const QString &path, const QString &query, TileKey key);
+	bool contains(int zoom, const QPoint &tile) const;
+
+private:
+	struct Zoom {
+		QRect rect;
+		/* Empty for the zooms indexed by the rect only */
+		QBitArray bits;
+	};
+
+	static void scan(TileCoverage *coverage);
+	void build(QSqlDatabase &db);
+	bool add(int zoom, const QPoint &tile);
+	void finish();
+
+	bool loadIndex();
+	void saveIndex() const;
+
+	QString _path, _query;
+	TileKey _key;
+
+	QMap<int, Zoom> _zooms;
+	bool _indexed;
+
+	QHash<int, QVector<QPoint> > _tiles;
+	int _count;
+
+	QFuture<void> _future;
+	QAtomicInt _ready, _canceled;
+};
+
+#endif // TILECOVERAGE_H
@@ -4,6 +4,12 @@
 #include "tileloader.h"
 
 #define SUBSTITUTE_CHAR '$'
+#define PACK_FILE       "tiles.pack"
+#define VALIDATORS_FILE PACK_FILE ".validators"
+#define PACK_BATCH      64
+#define TILE_SIZE       16384
+
+int TileLoader::_prefetchRing = 1;
 
 static bool inline IS_INT(const QVariant &v)
 {
@@ -53,16 +59,85 @@ static QString quadKey(const QPoint &xy, int zoom)
 }
 
 TileLoader::TileLoader(const QString &dir, QObject *parent)
-  : QObject(parent), _urlType(XYZ), _dir(dir)
+  : QObject(parent), _pack(QDir(dir).filePath(PACK_FILE)),
+  _validators(QDir(dir).filePath(VALIDATORS_FILE)), _urlType(XYZ), _dir(dir)
 {
 	if (!QDir().mkpath(_dir))
 		qWarning("%s: %s", qUtf8Printable(_dir),
 		  "Error creating tiles directory");
 
 	_downloader = new Downloader(this);
-	connect(_downloader, &Downloader::finished, this, &TileLoader::finished);
+	connect(_downloader, &Downloader::downloaded, this,
+	  &TileLoader::tileDownloaded);
+	connect(_downloader, &Downloader::validated, this,
+	  &TileLoader::tileValidated);
+	connect(_downloader, &Downloader::finished, this,
+	  &TileLoader::downloadFinished);
+}
+
+void TileLoader::tileDownloaded(const QString &file,
+  const Validators &validators)
+{
+	QString name(QFileInfo(file).fileName());
+
+	_downloaded.insert(name);
+	if (!validators.isNull())
+		_validators.insert(name, validators);
+	if (_downloaded.size() >= PACK_BATCH)
+		packTiles();
+}
+
+void TileLoader::tileValidated(const QString &file,
+  const Validators &validators)
+{
+	_validators.insert(QFileInfo(file).fileName(), validators);
+}
+
+void TileLoader::downloadFinished()
+{
+	packTiles();
+	emit finished();
 }
 
+/* The downloaded tiles are stored as separate files until the whole batch
+   is moved to the tiles pack at once. */
+void TileLoader::packTiles()
+{
+	QHash<QString, QByteArray> tiles;
+	bool changed = false;
+
+	for (QSet<QString>::const_iterator it = _downloaded.constBegin();
+	  it != _downloaded.constEnd(); ++it) {
+		QFile file(tileFile(*it));
+		if (file.open(QIODevice::ReadOnly))
+			tiles.insert(*it, file.readAll());
+		/* A revalidated tile has changed */
+		if (_pack.contains(*it))
+			changed = true;
+	}
+
+	if (_pack.insert(tiles))
+		for (QSet<QString>::const_iterator it = _downloaded.constBegin();
+		  it != _downloaded.constEnd(); ++it)
+			QFile::remove(tileFile(*it));
+
+	_downloaded.clear();
+
+	if (changed)
+		emit tilesChanged();
+}
+
+bool TileLoader::cachedTile(Tile &tile, const QString &name)
+{
+	if (_pack.contains(name))
+		tile.setFile(tileFile(name), true);
+	else if (_downloaded.contains(name))
+		tile.setFile(tileFile(name));
+	else
+		return false;
+
+	return true;
+}
 
 void TileLoader::loadTilesAsync(QVector<Tile> &list)
 {
@@ -70,21 +145,50 @@ void TileLoader::loadTilesAsync(QVector<Tile> &list)
 
 	for (int i = 0; i < list.size(); i++) {
 		Tile &t = list[i];
-		QString file(tileFile(t));
+		QString name(tileName(t));
 
-		if (QFileInfo::exists(file))
-			t.setFile(file);
-		else {
+		if (!cachedTile(t, name)) {
 			QUrl url(tileUrl(t));
 			if (url.isLocalFile())
 				t.setFile(url.toLocalFile());
 			else
-				dl.append(Download(url, file));
+				dl.append(Download(url, tileFile(name)));
 		}
 	}
 
+	/* Drop the queued downloads of the tiles that are not visible anymore */
+	_downloader->cancel(Downloader::Prefetch);
+	_downloader->cancel(Downloader::Visible);
 	if (!dl.empty())
 		_downloader->get(dl, _headers);
+	else if (Downloader::revalidation())
+		revalidateTiles(list);
+}
+
+/* Sends conditional requests for the expired visible tiles. The revalidation
+   runs in the background only when all the visible tiles are available and
+   an unchanged tile costs just a HTTP 304 response. Tiles with no validators
+   (e.g. downloaded by previous versions) are never revalidated. */
+void TileLoader::revalidateTiles(const QVector<Tile> &list)
+{
+	QList<Download> dl;
+
+	if (!_downloader->isIdle())
+		return;
+
+	for (int i = 0; i < list.size(); i++) {
+		const Tile &t = list.at(i);
+		if (!t._packed)
+			continue;
+
+		QString name(tileName(t));
+		Validators v(_validators.value(name));
+		if (!v.isNull() && !v.isFresh())
+			dl.append(Download(tileUrl(t), tileFile(name), v));
+	}
+
+	if (!dl.empty())
+		_downloader->get(dl, _headers, Downloader::Bulk);
 }
 
 void TileLoader::loadTilesSync(QVector<Tile> &list)
@@ -94,16 +198,14 @@ void TileLoader::loadTilesSync(QVector<Tile> &list)
 
 	for (int i = 0; i < list.size(); i++) {
 		Tile &t = list[i];
-		QString file(tileFile(t));
+		QString name(tileName(t));
 
-		if (QFileInfo::exists(file))
-			t.setFile(file);
-		else {
+		if (!cachedTile(t, name)) {
 			QUrl url(tileUrl(t));
 			if (url.isLocalFile())
 				t.setFile(url.toLocalFile());
 			else {
-				dl.append(Download(url, file));
+				dl.append(Download(url, tileFile(name)));
 				tl.append(&t);
 			}
 		}
@@ -117,18 +219,114 @@ void TileLoader::loadTilesSync(QVector<Tile> &list)
 
 		for (int i = 0; i < tl.size(); i++) {
 			Tile *t = tl[i];
-			QString file(tileFile(*t));
-			if (QFileInfo::exists(file))
-				t->setFile(file);
+			cachedTile(*t, tileName(*t));
 		}
 	}
 }
 
+/* Returns the tiles range to prefetch for the visible tiles range - a ring of
+   _prefetchRing tiles around the visible tiles, extended by another
+   _prefetchRing tiles in the current panning direction. The next zoom level
+   is deliberately not prefetched, the tile servers usage policies usually
+   forbid bulk downloading. */
+QRect TileLoader::prefetchRect(const QRect &visible, const QVariant &zoom,
+  const QRect &bounds)
+{
+	int dx = 0, dy = 0;
+
+	if (zoom == _visibleZoom && !_visible.isNull()) {
+		dx = visible.center().x() - _visible.center().x();
+		dy = visible.center().y() - _visible.center().y();
+	}
+	_visible = visible;
+	_visibleZoom = zoom;
+
+	int r = _prefetchRing;
+	return visible.adjusted(-r - ((dx < 0) ? r : 0), -r - ((dy < 0) ? r : 0),
+	  r + ((dx > 0) ? r : 0), r + ((dy > 0) ? r : 0)) & bounds;
+}
+
+/* The prefetch downloads are only started when there are no other (visible
+   tiles) downloads running, so they never delay the visible tiles. */
+void TileLoader::prefetchTiles(QVector<Tile> &list)
+{
+	QList<Download> dl;
+
+	if (!_downloader->isIdle())
+		return;
+
+	for (int i = 0; i < list.size(); i++) {
+		Tile &t = list[i];
+		QString name(tileName(t));
+
+		if (!cachedTile(t, name)) {
+			QUrl url(tileUrl(t));
+			if (!url.isLocalFile())
+				dl.append(Download(url, tileFile(name)));
+		}
+	}
+
+	if (!dl.empty())
+		_downloader->get(dl, _headers, Downloader::Prefetch);
+}
+
+/* Downloads the tiles with the lowest priority, used for the offline tiles
+   seeding */
+bool TileLoader::loadTilesBulk(QVector<Tile> &list)
+{
+	QList<Download> dl;
+
+	for (int i = 0; i < list.size(); i++) {
+		Tile &t = list[i];
+		QString name(tileName(t));
+
+		if (!cachedTile(t, name)) {
+			QUrl url(tileUrl(t));
+			if (!url.isLocalFile())
+				dl.append(Download(url, tileFile(name)));
+		}
+	}
+
+	return dl.empty() ? false : _downloader->get(dl, _headers, Downloader::Bulk);
+}
+
+bool TileLoader::isCached(const Tile &tile)
+{
+	QString name(tileName(tile));
+	return (_pack.contains(name) || _downloaded.contains(name));
+}
+
+/* Average size of the cached tiles, an estimate when no tiles are cached */
+qint64 TileLoader::averageTileSize()
+{
+	qint64 size = _pack.averageSize();
+	return size ? size : TILE_SIZE;
+}
+
+QByteArray TileLoader::tileData(const Tile &tile)
+{
+	if (tile._packed)
+		return _pack.data(QFileInfo(tile.file()).fileName());
+
+	QFile file(tile.file());
+	if (!file.open(QIODevice::ReadOnly)) {
+		qWarning("%s: %s", qUtf8Printable(file.fileName()),
+		  qUtf8Printable(file.errorString()));
+		return QByteArray();
+	}
+
+	return file.readAll();
+}
+
 void TileLoader::clearCache()
 {
 	QDir dir = QDir(_dir);
-	QStringList list = dir.entryList();
 
+	_pack.clear();
+	_validators.clear();
+	_downloaded.clear();
+
+	QStringList list = dir.entryList();
 	for (int i = 0; i < list.count(); i++)
 		dir.remove(list.at(i));
 
@@ -159,12 +357,16 @@ QUrl TileLoader::tileUrl(const Tile &tile) const
 	return QUrl(url);
 }
 
-QString TileLoader::tileFile(const Tile &tile) const
+QString TileLoader::tileName(const Tile &tile) const
 {
 	QString zoom(IS_INT(tile.zoom())
 	  ? tile.zoom().toString() : fsSafeStr(tile.zoom().toString()));
 
-	return _dir + QLatin1Char('/') + zoom + QLatin1Char('-')
-	  + QString::number(tile.xy().x()) + QLatin1Char('-')
-	  + QString::number(tile.xy().y());
+	return zoom + QLatin1Char('-') + QString::number(tile.xy().x())
+	  + QLatin1Char('-') + QString::number(tile.xy().y());
+}
+
+QString TileLoader::tileFile(const QString &name) const
+{
+	return _dir + QLatin1Char('/') + name;
 }
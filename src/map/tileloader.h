@@ -3,7 +3,10 @@
 
 #include <QObject>
 #include <QString>
+#include <QSet>
 #include "downloader.h"
+#include "tilepack.h"
+#include "validatorstore.h"
 #include "rectd.h"
 
 class TileLoader : public QObject
@@ -20,28 +23,33 @@ public:
 	class Tile
 	{
 	public:
-		Tile() {}
+		Tile() : _packed(false) {}
 		Tile(const QPoint &xy, int zoom)
-		  : _xy(xy), _zoom(zoom) {}
+		  : _xy(xy), _zoom(zoom), _packed(false) {}
 		Tile(const QPoint &xy, const QString &zoom)
-		  : _xy(xy), _zoom(zoom) {}
+		  : _xy(xy), _zoom(zoom), _packed(false) {}
 		Tile(const QPoint &xy, int zoom, const RectD &bbox)
-		  : _xy(xy), _zoom(zoom), _bbox(bbox) {}
+		  : _xy(xy), _zoom(zoom), _bbox(bbox), _packed(false) {}
 
 		const QVariant &zoom() const {return _zoom;}
 		const QPoint &xy() const {return _xy;}
 		const RectD &bbox() const {return _bbox;}
+		/* Unique tile path, usable as a pixmap cache key. Use
+		   TileLoader::tileData() to get the tile data, the path may point
+		   into the tiles pack. */
 		const QString &file() const {return _file;}
 
 	private:
 		friend class TileLoader;
 
-		void setFile(const QString &file) {_file = file;}
+		void setFile(const QString &file, bool packed = false)
+		  {_file = file; _packed = packed;}
 
 		QPoint _xy;
 		QVariant _zoom;
 		RectD _bbox;
 		QString _file;
+		bool _packed;
 	};
 
 
@@ -49,23 +57,56 @@ public:
 
 	void setUrl(const QString &url, UrlType type) {_url = url; _urlType = type;}
 	void setHeaders(const QList<HTTPHeader> &headers) {_headers = headers;}
+	void setNetworkProfile(const NetworkProfile &profile)
+	  {_downloader->setProfile(profile);}
 
 	void loadTilesAsync(QVector<Tile> &list);
 	void loadTilesSync(QVector<Tile> &list);
+	QRect prefetchRect(const QRect &visible, const QVariant &zoom,
+	  const QRect &bounds);
+	void prefetchTiles(QVector<Tile> &list);
+	bool loadTilesBulk(QVector<Tile> &list);
+	void cancelBulk() {_downloader->cancel(Downloader::Bulk);}
+	bool isCached(const Tile &tile);
+	qint64 averageTileSize();
+	QByteArray tileData(const Tile &tile);
 	void clearCache();
 
+	static void setCacheSize(int size) {TilePack::setCacheSize(size);}
+	/* 0 disables the tiles prefetching */
+	static void setPrefetchRing(int ring) {_prefetchRing = ring;}
+
 signals:
 	void finished();
+	/* Some of the already cached tiles have been replaced with a new
+	   version, the decoded tiles must be dropped. */
+	void tilesChanged();
+
+private slots:
+	void tileDownloaded(const QString &file, const Validators &validators);
+	void tileValidated(const QString &file, const Validators &validators);
+	void downloadFinished();
 
 private:
 	QUrl tileUrl(const Tile &tile) const;
-	QString tileFile(const Tile &tile) const;
+	QString tileName(const Tile &tile) const;
+	QString tileFile(const QString &name) const;
+	bool cachedTile(Tile &tile, const QString &name);
+	void packTiles();
+	void revalidateTiles(const QVector<Tile> &list);
 
 	Downloader *_downloader;
+	TilePack _pack;
+	ValidatorStore _validators;
+	QSet<QString> _downloaded;
+	QRect _visible;
+	QVariant _visibleZoom;
 	QString _url;
 	UrlType _urlType;
 	QString _dir;
 	QList<HTTPHeader> _headers;
+
+	static int _prefetchRing;
 };
 
 #endif // TILELOADER_H
@@ -0,0 +1,27 @@
+#ifndef TILEORDER_H
+#define TILEORDER_H
+
+#include <QPointF>
+
+/* Tile sort predicate ordering the tiles by their distance from the given
+   point, used to render the tiles from the viewport centre outwards. */
+template <class T>
+class TileOrder
+{
+public:
+	TileOrder(const QPointF &center) : _center(center) {}
+
+	bool operator()(const T &t1, const T &t2) const
+	  {return distance(t1) < distance(t2);}
+
+private:
+	qreal distance(const T &tile) const
+	{
+		QPointF d(QPointF(tile.xy()) - _center);
+		return d.x() * d.x() + d.y() * d.y();
+	}
+
+	QPointF _center;
+};
+
+#endif // TILEORDER_H
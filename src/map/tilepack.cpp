@@ -0,0 +1,414 @@
+#include <QDir>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QStringList>
+#include <algorithm>
+#include "tilepack.h"
+
+
+#define MAGIC        0x47505450
+#define VERSION      1
+#define HEADER_SIZE  (2 * sizeof(quint32))
+#define RECORD_SIZE(nameSize, dataSize) \
+	((qint64)(sizeof(quint16) + (nameSize) + sizeof(quint32) + (dataSize)))
+#define TMP_SUFFIX   ".tmp"
+#define LOCK_SUFFIX  ".lock"
+#define ATIME_SUFFIX ".atime"
+#define ATIME_MAGIC  0x47505441
+#define LOCK_TIMEOUT 10000 /* ms */
+#define IMPORT_BATCH 256
+
+qint64 TilePack::_limit = 0;
+
+TilePack::TilePack(const QString &fileName)
+  : _file(fileName), _lock(fileName + LOCK_SUFFIX), _clock(0), _open(false)
+{
+}
+
+TilePack::~TilePack()
+{
+	if (_file.isOpen() && _lock.tryLock(LOCK_TIMEOUT)) {
+		saveAccessTimes();
+		_lock.unlock();
+	}
+}
+
+bool TilePack::open()
+{
+	if (_open)
+		return _file.isOpen();
+	_open = true;
+
+	if (!_lock.tryLock(LOCK_TIMEOUT)) {
+		qWarning("%s: error locking the tile pack",
+		  qUtf8Printable(_file.fileName()));
+		return false;
+	}
+
+	if (!_file.open(QIODevice::ReadWrite)) {
+		qWarning("%s: %s", qUtf8Printable(_file.fileName()),
+		  qUtf8Printable(_file.errorString()));
+		_lock.unlock();
+		return false;
+	}
+
+	if (_file.size())
+		scan();
+	else if (!writeHeader()) {
+		_file.close();
+		_lock.unlock();
+		return false;
+	}
+
+	import();
+	_lock.unlock();
+
+	return true;
+}
+
+/* The access times are stored as the tile names in the LRU order (oldest
+   first), the loaded values are their positions */
+QHash<QString, quint64> TilePack::loadAccessTimes()
+{
+	QHash<QString, quint64> atimes;
+	QFile file(_file.fileName() + ATIME_SUFFIX);
+	if (!file.open(QIODevice::ReadOnly))
+		return atimes;
+
+	QDataStream stream(&file);
+	quint32 magic;
+	QStringList names;
+
+	stream >> magic >> names;
+	if (stream.status() != QDataStream::Ok || magic != ATIME_MAGIC)
+		return atimes;
+
+	for (int i = 0; i < names.size(); i++)
+		atimes.insert(names.at(i), i + 1);
+
+	return atimes;
+}
+
+void TilePack::saveAccessTimes()
+{
+	QList<QPair<quint64, QString> > lru;
+	for (QHash<QString, Entry>::const_iterator it = _index.constBegin();
+	  it != _index.constEnd(); ++it)
+		lru.append(QPair<quint64, QString>(it->atime, it.key()));
+	std::sort(lru.begin(), lru.end());
+
+	QStringList names;
+	for (int i = 0; i < lru.size(); i++)
+		names.append(lru.at(i).second);
+
+	QFile file(_file.fileName() + ATIME_SUFFIX);
+	if (!file.open(QIODevice::WriteOnly)) {
+		qWarning("%s: %s", qUtf8Printable(file.fileName()),
+		  qUtf8Printable(file.errorString()));
+		return;
+	}
+
+	QDataStream stream(&file);
+	stream << (quint32)ATIME_MAGIC << names;
+}
+
+bool TilePack::writeHeader()
+{
+	QDataStream stream(&_file);
+	stream << (quint32)MAGIC << (quint32)VERSION;
+
+	if (stream.status() != QDataStream::Ok) {
+		qWarning("%s: %s", qUtf8Printable(_file.fileName()),
+		  qUtf8Printable(_file.errorString()));
+		return false;
+	}
+
+	return true;
+}
+
+void TilePack::scan()
+{
+	QDataStream stream(&_file);
+	quint32 magic, version;
+
+	stream >> magic >> version;
+	if (stream.status() != QDataStream::Ok || magic != MAGIC
+	  || version != VERSION) {
+		qWarning("%s: invalid tile pack", qUtf8Printable(_file.fileName()));
+		_file.resize(0);
+		_file.seek(0);
+		writeHeader();
+		return;
+	}
+
+	/* Tiles appended after the access times were saved are newer than all
+	   the saved ones */
+	QHash<QString, quint64> atimes(loadAccessTimes());
+	_clock = atimes.size();
+
+	qint64 size = _file.size();
+	qint64 offset = HEADER_SIZE;
+
+	while (offset < size) {
+		quint16 nameSize;
+		quint32 dataSize;
+
+		stream >> nameSize;
+		QByteArray name(nameSize, Qt::Uninitialized);
+		if (stream.readRawData(name.data(), nameSize) != nameSize)
+			break;
+		stream >> dataSize;
+		if (stream.status() != QDataStream::Ok
+		  || offset + RECORD_SIZE(nameSize, dataSize) > size
+		  || stream.skipRawData(dataSize) != (int)dataSize)
+			break;
+
+		QString key(QString::fromUtf8(name));
+		quint64 atime = atimes.value(key);
+		_index.insert(key, Entry(offset + RECORD_SIZE(nameSize, 0), dataSize,
+		  atime ? atime : ++_clock));
+		offset += RECORD_SIZE(nameSize, dataSize);
+	}
+
+	/* Remove the incomplete record of an interrupted write */
+	if (offset < size) {
+		qWarning("%s: truncated tile pack", qUtf8Printable(_file.fileName()));
+		_file.resize(offset);
+	}
+}
+
+void TilePack::import()
+{
+	QFileInfo fi(_file);
+	QDir dir(fi.absolutePath());
+	QStringList files(dir.entryList(QDir::Files));
+	QHash<QString, QByteArray> tiles;
+	QStringList imported;
+
+	for (int i = 0; i < files.size(); i++) {
+		const QString &name = files.at(i);
+		if (name.startsWith(fi.fileName()) || name.endsWith(TMP_SUFFIX)
+		  || name.endsWith(".download"))
+			continue;
+
+		QFile file(dir.filePath(name));
+		if (file.open(QIODevice::ReadOnly))
+			tiles.insert(name, file.readAll());
+		imported.append(name);
+
+		if (tiles.size() >= IMPORT_BATCH) {
+			if (!append(tiles))
+				return;
+			for (int j = 0; j < imported.size(); j++)
+				dir.remove(imported.at(j));
+			tiles.clear();
+			imported.clear();
+		}
+	}
+
+	if (!tiles.isEmpty() && append(tiles))
+		for (int j = 0; j < imported.size(); j++)
+			dir.remove(imported.at(j));
+}
+
+bool TilePack::contains(const QString &name)
+{
+	return open() ? _index.contains(name) : false;
+}
+
+QByteArray TilePack::data(const QString &name)
+{
+	if (!open())
+		return QByteArray();
+
+	QHash<QString, Entry>::iterator it = _index.find(name);
+	if (it == _index.end())
+		return QByteArray();
+
+	it->atime = ++_clock;
+	if (!_file.seek(it->offset))
+		return QByteArray();
+
+	return _file.read(it->size);
+}
+
+/* Another instance may have compacted (replaced) the pack since it was
+   opened, the pack is then reopened and rescanned. Tiles appended by other
+   instances to the same file are not indexed until the next rescan, the
+   appends always go to the current end of the file. */
+void TilePack::sync()
+{
+	QFileInfo fi(_file.fileName());
+	if (fi.exists() && fi.size() == _file.size())
+		return;
+
+	QHash<QString, quint64> atimes;
+	for (QHash<QString, Entry>::const_iterator it = _index.constBegin();
+	  it != _index.constEnd(); ++it)
+		atimes.insert(it.key(), it->atime);
+
+	_file.close();
+	_index.clear();
+	if (!_file.open(QIODevice::ReadWrite)) {
+		qWarning("%s: %s", qUtf8Printable(_file.fileName()),
+		  qUtf8Printable(_file.errorString()));
+		return;
+	}
+	if (_file.size())
+		scan();
+	else
+		writeHeader();
+
+	for (QHash<QString, Entry>::iterator it = _index.begin();
+	  it != _index.end(); ++it)
+		if (atimes.contains(it.key()))
+			it->atime = atimes.value(it.key());
+}
+
+bool TilePack::insert(const QHash<QString, QByteArray> &tiles)
+{
+	if (!open())
+		return false;
+
+	if (!_lock.tryLock(LOCK_TIMEOUT)) {
+		qWarning("%s: error locking the tile pack",
+		  qUtf8Printable(_file.fileName()));
+		return false;
+	}
+	sync();
+	bool ret = _file.isOpen() && append(tiles);
+	_lock.unlock();
+
+	return ret;
+}
+
+bool TilePack::append(const QHash<QString, QByteArray> &tiles)
+{
+	qint64 offset = _file.size();
+	if (!_file.seek(offset))
+		return false;
+
+	QDataStream stream(&_file);
+	for (QHash<QString, QByteArray>::const_iterator it = tiles.constBegin();
+	  it != tiles.constEnd(); ++it) {
+		QByteArray name(it.key().toUtf8());
+		const QByteArray &data = it.value();
+
+		stream << (quint16)name.size();
+		stream.writeRawData(name.constData(), name.size());
+		stream << (quint32)data.size();
+		stream.writeRawData(data.constData(), data.size());
+
+		if (stream.status() != QDataStream::Ok) {
+			qWarning("%s: %s", qUtf8Printable(_file.fileName()),
+			  qUtf8Printable(_file.errorString()));
+			_file.resize(offset);
+			return false;
+		}
+
+		_index.insert(it.key(), Entry(offset + RECORD_SIZE(name.size(), 0),
+		  data.size(), ++_clock));
+		offset += RECORD_SIZE(name.size(), data.size());
+	}
+	_file.flush();
+
+	if (_limit && _file.size() > _limit)
+		compact();
+
+	return true;
+}
+
+void TilePack::compact()
+{
+	QList<QPair<quint64, QString> > lru;
+	for (QHash<QString, Entry>::const_iterator it = _index.constBegin();
+	  it != _index.constEnd(); ++it)
+		lru.append(QPair<quint64, QString>(it->atime, it.key()));
+	std::sort(lru.begin(), lru.end());
+
+	QFile tmp(_file.fileName() + TMP_SUFFIX);
+	if (!tmp.open(QIODevice::WriteOnly)) {
+		qWarning("%s: %s", qUtf8Printable(tmp.fileName()),
+		  qUtf8Printable(tmp.errorString()));
+		return;
+	}
+
+	QDataStream stream(&tmp);
+	QHash<QString, Entry> index;
+	qint64 limit = (_limit / 10) * 9;
+	qint64 size = HEADER_SIZE;
+
+	/* Copy the most recently used tiles up to 90% of the limit */
+	stream << (quint32)MAGIC << (quint32)VERSION;
+	for (int i = lru.size() - 1; i >= 0; i--) {
+		const Entry &e = _index[lru.at(i).second];
+		QByteArray name(lru.at(i).second.toUtf8());
+		if (size + RECORD_SIZE(name.size(), e.size) > limit)
+			break;
+		if (!_file.seek(e.offset))
+			continue;
+		QByteArray data(_file.read(e.size));
+		if (data.size() != (int)e.size)
+			continue;
+
+		stream << (quint16)name.size();
+		stream.writeRawData(name.constData(), name.size());
+		stream << (quint32)data.size();
+		stream.writeRawData(data.constData(), data.size());
+
+		index.insert(lru.at(i).second, Entry(size + RECORD_SIZE(name.size(),
+		  0), e.size, e.atime));
+		size += RECORD_SIZE(name.size(), e.size);
+	}
+
+	if (stream.status() != QDataStream::Ok) {
+		qWarning("%s: %s", qUtf8Printable(tmp.fileName()),
+		  qUtf8Printable(tmp.errorString()));
+		tmp.remove();
+		return;
+	}
+	tmp.close();
+
+	_file.close();
+	_index.clear();
+	if (!(QFile::remove(_file.fileName()) && tmp.rename(_file.fileName()))) {
+		qWarning("%s: error replacing the tile pack",
+		  qUtf8Printable(_file.fileName()));
+		return;
+	}
+	if (!_file.open(QIODevice::ReadWrite)) {
+		qWarning("%s: %s", qUtf8Printable(_file.fileName()),
+		  qUtf8Printable(_file.errorString()));
+		return;
+	}
+
+	_index = index;
+	saveAccessTimes();
+}
+
+qint64 TilePack::averageSize()
+{
+	if (!open() || _index.isEmpty())
+		return 0;
+
+	qint64 size = 0;
+	for (QHash<QString, Entry>::const_iterator it = _index.constBegin();
+	  it != _index.constEnd(); ++it)
+		size += it->size;
+
+	return size / _index.size();
+}
+
+void TilePack::clear()
+{
+	bool locked = _lock.tryLock(LOCK_TIMEOUT);
+
+	_file.remove();
+	QFile::remove(_file.fileName() + ATIME_SUFFIX);
+	_index.clear();
+	_clock = 0;
+	_open = false;
+
+	if (locked)
+		_lock.unlock();
+}
@@ -0,0 +1,65 @@
+#ifndef TILEPACK_H
+#define TILEPACK_H
+
+#include <QFile>
+#include <QLockFile>
+#include <QHash>
+#include <QString>
+#include <QByteArray>
+
+/* Single file, append-only on-disk tiles store. The index is kept in memory
+   and is build on the first access by scanning the pack records. When the
+   pack size limit is exceeded, the pack is compacted keeping only the most
+   recently used tiles. Tiles stored as separate files in the pack directory
+   (the legacy cache layout) are imported into the pack on the first
+   access.
+
+   The pack may be shared by multiple program instances, all the pack
+   modifications are done holding a lock file. The tiles access order is
+   kept in a side file, written on compaction and when the pack is
+   destroyed, so the eviction remains LRU across restarts. */
+class TilePack
+{
+public:
+	TilePack(const QString &fileName);
+	~TilePack();
+
+	bool contains(const QString &name);
+	QByteArray data(const QString &name);
+	bool insert(const QHash<QString, QByteArray> &tiles);
+	void clear();
+	qint64 averageSize();
+
+	static void setCacheSize(int size) {_limit = (qint64)size * 1024;}
+
+private:
+	struct Entry {
+		Entry() : offset(0), size(0), atime(0) {}
+		Entry(qint64 offset, quint32 size, quint64 atime)
+		  : offset(offset), size(size), atime(atime) {}
+
+		qint64 offset;
+		quint32 size;
+		quint64 atime;
+	};
+
+	bool open();
+	bool writeHeader();
+	void scan();
+	void sync();
+	bool append(const QHash<QString, QByteArray> &tiles);
+	void compact();
+	void import();
+	QHash<QString, quint64> loadAccessTimes();
+	void saveAccessTimes();
+
+	QFile _file;
+	QLockFile _lock;
+	QHash<QString, Entry> _index;
+	quint64 _clock;
+	bool _open;
+
+	static qint64 _limit;
+};
+
+#endif // TILEPACK_H
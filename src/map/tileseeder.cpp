@@ -0,0 +1,75 @@
+#include "tileseeder.h"
+
+#define BATCH_SIZE 16
+#define RATE_LIMIT 8 /* tiles/s */
+
+TileSeeder::TileSeeder(TileLoader *loader,
+  const QVector<TileLoader::Tile> &tiles, QObject *parent)
+  : QObject(parent), _loader(loader), _total(tiles.size()), _done(0),
+  _failed(0), _running(false)
+{
+	for (int i = 0; i < tiles.size(); i++)
+		if (!_loader->isCached(tiles.at(i)))
+			_tiles.append(tiles.at(i));
+
+	_timer.setSingleShot(true);
+	connect(&_timer, &QTimer::timeout, this, &TileSeeder::nextBatch);
+}
+
+qint64 TileSeeder::size() const
+{
+	return _tiles.size() * _loader->averageTileSize();
+}
+
+void TileSeeder::start()
+{
+	_running = true;
+	connect(_loader, &TileLoader::finished, this, &TileSeeder::batchFinished);
+	nextBatch();
+}
+
+void TileSeeder::cancel()
+{
+	_running = false;
+	_timer.stop();
+	disconnect(_loader, &TileLoader::finished, this,
+	  &TileSeeder::batchFinished);
+	_loader->cancelBulk();
+}
+
+void TileSeeder::nextBatch()
+{
+	if (!_running)
+		return;
+
+	if (_done >= _tiles.size()) {
+		cancel();
+		emit finished();
+		return;
+	}
+
+	_batch = _tiles.mid(_done, BATCH_SIZE);
+	_elapsed.start();
+	if (!_loader->loadTilesBulk(_batch))
+		batchFinished();
+}
+
+/* TileLoader::finished() is emitted when all downloads, including the ones
+   of the visible tiles, are finished. */
+void TileSeeder::batchFinished()
+{
+	if (!_running || _batch.isEmpty())
+		return;
+
+	for (int i = 0; i < _batch.size(); i++)
+		if (!_loader->isCached(_batch.at(i)))
+			_failed++;
+	_done += _batch.size();
+	_batch.clear();
+
+	emit progress(_done, _tiles.size());
+
+	qint64 delay = (_done == _tiles.size())
+	  ? 0 : (BATCH_SIZE * 1000) / RATE_LIMIT - _elapsed.elapsed();
+	_timer.start(qMax(delay, (qint64)0));
+}
@@ -0,0 +1,54 @@
+#ifndef TILESEEDER_H
+#define TILESEEDER_H
+
+#include <QObject>
+#include <QVector>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "tileloader.h"
+
+#define SEED_LIMIT 100000
+
+/* Bulk download of the map tiles into the tiles cache for offline use. The
+   tiles are downloaded in small batches with a limited rate, the already
+   cached tiles are skipped so an interrupted job continues where it stopped
+   when run again. */
+class TileSeeder : public QObject
+{
+	Q_OBJECT
+
+public:
+	TileSeeder(TileLoader *loader, const QVector<TileLoader::Tile> &tiles,
+	  QObject *parent = 0);
+
+	/* All the tiles of the area (up to SEED_LIMIT + 1) */
+	int total() const {return _total;}
+	/* The tiles that are not yet cached */
+	int count() const {return _tiles.size();}
+	qint64 size() const;
+	int failed() const {return _failed;}
+
+	void start();
+	void cancel();
+
+signals:
+	void progress(int done, int count);
+	void finished();
+
+private slots:
+	void nextBatch();
+	void batchFinished();
+
+private:
+	TileLoader *_loader;
+	QVector<TileLoader::Tile> _tiles;
+	QVector<TileLoader::Tile> _batch;
+	QTimer _timer;
+	QElapsedTimer _elapsed;
+	int _total;
+	int _done;
+	int _failed;
+	bool _running;
+};
+
+#endif // TILESEEDER_H
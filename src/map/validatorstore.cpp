@@ -0,0 +1,146 @@
+#include <QDataStream>
+#include "validatorstore.h"
+
+
+#define MAGIC       0x47505656
+#define VERSION     1
+#define TMP_SUFFIX  ".tmp"
+#define MIN_RECORDS 64
+
+static void writeRecord(QDataStream &stream, const QString &name,
+  const Validators &validators)
+{
+	stream << name << validators.etag() << validators.lastModified()
+	  << (qint64)(validators.expires().isValid()
+	  ? validators.expires().toMSecsSinceEpoch() : -1);
+}
+
+bool ValidatorStore::open()
+{
+	if (_open)
+		return _file.isOpen();
+	_open = true;
+
+	if (!_file.open(QIODevice::ReadWrite)) {
+		qWarning("%s: %s", qUtf8Printable(_file.fileName()),
+		  qUtf8Printable(_file.errorString()));
+		return false;
+	}
+
+	if (_file.size())
+		load();
+	else {
+		QDataStream stream(&_file);
+		stream << (quint32)MAGIC << (quint32)VERSION;
+	}
+
+	return true;
+}
+
+void ValidatorStore::load()
+{
+	QDataStream stream(&_file);
+	quint32 magic, version;
+
+	stream >> magic >> version;
+	if (stream.status() != QDataStream::Ok || magic != MAGIC
+	  || version != VERSION) {
+		qWarning("%s: invalid validators file",
+		  qUtf8Printable(_file.fileName()));
+		_file.resize(0);
+		_file.seek(0);
+		stream.resetStatus();
+		stream << (quint32)MAGIC << (quint32)VERSION;
+		return;
+	}
+
+	qint64 offset = _file.pos();
+	while (!stream.atEnd()) {
+		QString name;
+		QByteArray etag, lastModified;
+		qint64 expires;
+
+		stream >> name >> etag >> lastModified >> expires;
+		if (stream.status() != QDataStream::Ok)
+			break;
+
+		_map.insert(name, Validators(etag, lastModified, (expires < 0)
+		  ? QDateTime() : QDateTime::fromMSecsSinceEpoch(expires, Qt::UTC)));
+		_records++;
+		offset = _file.pos();
+	}
+
+	/* Remove the incomplete record of an interrupted write */
+	if (offset < _file.size())
+		_file.resize(offset);
+}
+
+void ValidatorStore::compact()
+{
+	QFile tmp(_file.fileName() + TMP_SUFFIX);
+	if (!tmp.open(QIODevice::WriteOnly)) {
+		qWarning("%s: %s", qUtf8Printable(tmp.fileName()),
+		  qUtf8Printable(tmp.errorString()));
+		return;
+	}
+
+	QDataStream stream(&tmp);
+	stream << (quint32)MAGIC << (quint32)VERSION;
+	for (QHash<QString, Validators>::const_iterator it = _map.constBegin();
+	  it != _map.constEnd(); ++it)
+		writeRecord(stream, it.key(), it.value());
+	if (stream.status() != QDataStream::Ok) {
+		qWarning("%s: %s", qUtf8Printable(tmp.fileName()),
+		  qUtf8Printable(tmp.errorString()));
+		tmp.remove();
+		return;
+	}
+	tmp.close();
+
+	_file.close();
+	if (!(QFile::remove(_file.fileName()) && tmp.rename(_file.fileName()))) {
+		qWarning("%s: error replacing the validators file",
+		  qUtf8Printable(_file.fileName()));
+		return;
+	}
+	if (!_file.open(QIODevice::ReadWrite)) {
+		qWarning("%s: %s", qUtf8Printable(_file.fileName()),
+		  qUtf8Printable(_file.errorString()));
+		return;
+	}
+
+	_records = _map.size();
+}
+
+Validators ValidatorStore::value(const QString &name)
+{
+	return open() ? _map.value(name) : Validators();
+}
+
+void ValidatorStore::insert(const QString &name, const Validators &validators)
+{
+	if (!open() || !_file.seek(_file.size()))
+		return;
+
+	QDataStream stream(&_file);
+	writeRecord(stream, name, validators);
+	if (stream.status() != QDataStream::Ok) {
+		qWarning("%s: %s", qUtf8Printable(_file.fileName()),
+		  qUtf8Printable(_file.errorString()));
+		return;
+	}
+	_file.flush();
+
+	_map.insert(name, validators);
+	if (++_records > 2 * _map.size() + MIN_RECORDS)
+		compact();
+}
+
+void ValidatorStore::clear()
+{
+	_file.close();
+	_file.remove();
+	_map.clear();
+	_records = 0;
+	_open = false;
+}
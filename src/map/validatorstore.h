@@ -0,0 +1,33 @@
+#ifndef VALIDATORSTORE_H
+#define VALIDATORSTORE_H
+
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include "downloader.h"
+
+/* Append-only on-disk store of the HTTP cache validators of the downloaded
+   objects. The last record of an object wins, the store is rewritten when
+   the outdated records take most of the file. */
+class ValidatorStore
+{
+public:
+	ValidatorStore(const QString &fileName) : _file(fileName), _records(0),
+	  _open(false) {}
+
+	Validators value(const QString &name);
+	void insert(const QString &name, const Validators &validators);
+	void clear();
+
+private:
+	bool open();
+	void load();
+	void compact();
+
+	QFile _file;
+	QHash<QString, Validators> _map;
+	int _records;
+	bool _open;
+};
+
+#endif // VALIDATORSTORE_H
@@ -4,6 +4,7 @@
 #include <QXmlStreamReader>
 #include <QStringList>
 #include "crs.h"
+#include "capabilitiesfile.h"
 #include "wms.h"
 
 
@@ -338,16 +339,14 @@ WMS::WMS(const QString &file, const WMS::Setup &setup, QObject *parent)
 	QString url = QString("%1%2service=WMS&request=GetCapabilities")
 	  .arg(setup.url(), setup.url().contains('?') ? "&" : "?");
 
-	if (!QFileInfo::exists(file)) {
-		Downloader *downloader = new Downloader(this);
-		connect(downloader, &Downloader::finished, this,
+	CapabilitiesFile *cf = new CapabilitiesFile(_path, this);
+	if (!cf->exists()) {
+		connect(cf, &CapabilitiesFile::finished, this,
 		  &WMS::capabilitiesReady);
-
-		QList<Download> dl;
-		dl.append(Download(url, _path));
-		_valid = downloader->get(dl, _setup.headers());
+		_valid = cf->download(url, _setup.headers());
 	} else {
 		_ready = true;
 		_valid = parseCapabilities();
+		cf->refresh(url, _setup.headers());
 	}
 }
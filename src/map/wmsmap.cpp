@@ -1,8 +1,7 @@
 #include <QtMath>
 #include <QDir>
 #include <QPainter>
-#include <QPixmapCache>
-#include <QtConcurrent>
+#include "common/threadpools.h"
 #include "common/wgs84.h"
 #include "common/rectc.h"
 #include "common/programpaths.h"
@@ -70,7 +69,8 @@ void WMSMap::updateTransform()
 }
 
 WMSMap::WMSMap(const QString &fileName, const QString &name,
-  const WMS::Setup &setup, int tileSize, QObject *parent)
+  const WMS::Setup &setup, const NetworkProfile &profile, int tileSize,
+  QObject *parent)
   : Map(fileName, parent), _name(name), _tileLoader(0), _zoom(0),
   _tileSize(tileSize), _mapRatio(1.0)
 {
@@ -78,7 +78,10 @@ WMSMap::WMSMap(const QString &fileName, const QString &name,
 
 	_tileLoader = new TileLoader(tilesDir, this);
 	_tileLoader->setHeaders(setup.headers());
+	_tileLoader->setNetworkProfile(profile);
 	connect(_tileLoader, &TileLoader::finished, this, &WMSMap::tilesLoaded);
+	connect(_tileLoader, &TileLoader::tilesChanged, this,
+	  &WMSMap::tilesChanged);
 
 	_wms = new WMS(QDir(tilesDir).filePath(CAPABILITIES_FILE), setup, this);
 	connect(_wms, &WMS::downloadFinished, this, &WMSMap::wmsReady);
@@ -102,6 +105,12 @@ void WMSMap::wmsReady()
 	emit mapLoaded();
 }
 
+void WMSMap::unload()
+{
+	cancelJobs(true);
+	_tileCache.clear();
+}
+
 void WMSMap::load(const Projection &in, const Projection &out,
   qreal deviceRatio, bool hidpi, int style, int layer)
 {
@@ -116,7 +125,7 @@ void WMSMap::load(const Projection &in, const Projection &out,
 void WMSMap::clearCache()
 {
 	_tileLoader->clearCache();
-	QPixmapCache::clear();
+	_tileCache.clear();
 }
 
 QRectF WMSMap::bounds()
@@ -149,12 +158,16 @@ int WMSMap::zoomFit(const QSize &size, const RectC &rect)
 
 void WMSMap::setZoom(int zoom)
 {
+	cancelJobs(false);
+
 	_zoom = zoom;
 	updateTransform();
 }
 
 int WMSMap::zoomIn()
 {
+	cancelJobs(false);
+
 	_zoom = qMin(_zoom + 1, _zooms.size() - 1);
 	updateTransform();
 	return _zoom;
@@ -162,6 +175,8 @@ int WMSMap::zoomIn()
 
 int WMSMap::zoomOut()
 {
+	cancelJobs(false);
+
 	_zoom = qMax(_zoom - 1, 0);
 	updateTransform();
 	return _zoom;
@@ -182,6 +197,17 @@ qreal WMSMap::tileSize() const
 	return (_tileSize / _mapRatio);
 }
 
+RectD WMSMap::tileBBox(int x, int y) const
+{
+	PointD ttl(_transform.img2proj(QPointF(x * _tileSize, y * _tileSize)));
+	PointD tbr(_transform.img2proj(QPointF(x * _tileSize + _tileSize,
+	  y * _tileSize + _tileSize)));
+
+	return (_wms->cs().axisOrder() == CoordinateSystem::YX)
+	  ? RectD(PointD(tbr.y(), tbr.x()), PointD(ttl.y(), ttl.x()))
+	  : RectD(ttl, tbr);
+}
+
 void WMSMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 {
 	QPoint tl = QPoint(qFloor(rect.left() / tileSize()),
@@ -191,55 +217,121 @@ void WMSMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 
 	QVector<TileLoader::Tile> fetchTiles;
 	fetchTiles.reserve((br.x() - tl.x()) * (br.y() - tl.y()));
-	for (int i = tl.x(); i < br.x(); i++) {
-		for (int j = tl.y(); j < br.y(); j++) {
-			PointD ttl(_transform.img2proj(QPointF(i * _tileSize,
-			  j * _tileSize)));
-			PointD tbr(_transform.img2proj(QPointF(i * _tileSize + _tileSize,
-			  j * _tileSize + _tileSize)));
-			RectD bbox = (_wms->cs().axisOrder() == CoordinateSystem::YX)
-			  ? RectD(PointD(tbr.y(), tbr.x()), PointD(ttl.y(), ttl.x()))
-			  : RectD(ttl, tbr);
-
-			fetchTiles.append(TileLoader::Tile(QPoint(i, j), _zoom, bbox));
-		}
-	}
+	for (int i = tl.x(); i < br.x(); i++)
+		for (int j = tl.y(); j < br.y(); j++)
+			fetchTiles.append(TileLoader::Tile(QPoint(i, j), _zoom,
+			  tileBBox(i, j)));
 
 	if (flags & Map::Block)
 		_tileLoader->loadTilesSync(fetchTiles);
-	else
+	else {
 		_tileLoader->loadTilesAsync(fetchTiles);
 
-	QList<FileTile> renderTiles;
+		QRectF b(bounds());
+		QRect visible(tl, br - QPoint(1, 1));
+		QRect pr(_tileLoader->prefetchRect(visible, _zoom, QRect(
+		  QPoint(qFloor(b.left() / tileSize()), qFloor(b.top() / tileSize())),
+		  QPoint(qCeil(b.right() / tileSize()) - 1,
+		  qCeil(b.bottom() / tileSize()) - 1))));
+		QVector<TileLoader::Tile> prefetchTiles;
+		for (int i = pr.left(); i <= pr.right(); i++)
+			for (int j = pr.top(); j <= pr.bottom(); j++)
+				if (!visible.contains(i, j))
+					prefetchTiles.append(TileLoader::Tile(QPoint(i, j), _zoom,
+					  tileBBox(i, j)));
+		_tileLoader->prefetchTiles(prefetchTiles);
+	}
+
+	QList<DataTile> renderTiles;
 	for (int i = 0; i < fetchTiles.count(); i++) {
 		const TileLoader::Tile &t = fetchTiles.at(i);
 		if (t.file().isNull())
 			continue;
 
+		quint64 key = TileCache::key(_zoom, t.xy());
+		if (isRunning(key))
+			continue;
+
 		QPixmap pm;
-		if (QPixmapCache::find(t.file(), &pm)) {
+		if (_tileCache.find(key, &pm, _mapRatio)) {
 			QPointF tp(t.xy().x() * tileSize(), t.xy().y() * tileSize());
 			drawTile(painter, pm, tp);
 		} else
-			renderTiles.append(FileTile(t.xy(), t.file()));
+			renderTiles.append(DataTile(t.xy(), _tileLoader->tileData(t),
+			  key));
+	}
+
+	if (renderTiles.isEmpty())
+		return;
+	if (!(flags & Map::Block)) {
+		runJob(new DataTileJob(renderTiles));
+		return;
 	}
 
-	QFuture<void> future = QtConcurrent::map(renderTiles, &FileTile::load);
+	QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+	  renderTiles, &DataTile::load);
 	future.waitForFinished();
 
 	for (int i = 0; i < renderTiles.size(); i++) {
-		const FileTile &mt = renderTiles.at(i);
+		const DataTile &mt = renderTiles.at(i);
 		QPixmap pm(mt.pixmap());
 		if (pm.isNull())
 			continue;
 
-		QPixmapCache::insert(mt.file(), pm);
+		_tileCache.insert(mt.key(), pm);
 
 		QPointF tp(mt.xy().x() * tileSize(), mt.xy().y() * tileSize());
 		drawTile(painter, pm, tp);
 	}
 }
 
+bool WMSMap::isRunning(quint64 key) const
+{
+	for (int i = 0; i < _jobs.size(); i++) {
+		const QList<DataTile> &tiles = _jobs.at(i)->tiles();
+		for (int j = 0; j < tiles.size(); j++)
+			if (tiles.at(j).key() == key)
+				return true;
+	}
+
+	return false;
+}
+
+void WMSMap::runJob(DataTileJob *job)
+{
+	_jobs.append(job);
+
+	connect(job, &DataTileJob::finished, this, &WMSMap::jobFinished);
+	job->run();
+}
+
+void WMSMap::removeJob(DataTileJob *job)
+{
+	_jobs.removeOne(job);
+	job->deleteLater();
+}
+
+void WMSMap::jobFinished(DataTileJob *job)
+{
+	const QList<DataTile> &tiles = job->tiles();
+
+	for (int i = 0; i < tiles.size(); i++) {
+		const DataTile &mt = tiles.at(i);
+		if (!mt.pixmap().isNull())
+			_tileCache.insert(mt.key(), mt.pixmap());
+	}
+
+	removeJob(job);
+
+	emit tilesLoaded();
+}
+
+void WMSMap::cancelJobs(bool wait)
+{
+	for (int i = 0; i < _jobs.size(); i++)
+		_jobs.at(i)->cancel(wait);
+}
+
 void WMSMap::drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp)
 {
 	pixmap.setDevicePixelRatio(_mapRatio);
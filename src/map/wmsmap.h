@@ -4,6 +4,8 @@
 #include "transform.h"
 #include "projection.h"
 #include "map.h"
+#include "tilecache.h"
+#include "datatilejob.h"
 #include "wms.h"
 #include "rectd.h"
 
@@ -15,7 +17,7 @@ class WMSMap : public Map
 
 public:
 	WMSMap(const QString &fileName, const QString &name, const WMS::Setup &setup,
-	  int tileSize, QObject *parent = 0);
+	  const NetworkProfile &profile, int tileSize, QObject *parent = 0);
 
 	QString name() const {return _name;}
 
@@ -35,6 +37,7 @@ public:
 
 	void load(const Projection &in, const Projection &out, qreal deviceRatio,
 	  bool hidpi, int style, int layer);
+	void unload();
 	void clearCache();
 
 	bool isReady() const {return _wms->isReady();}
@@ -43,6 +46,8 @@ public:
 
 private slots:
 	void wmsReady();
+	void tilesChanged() {_tileCache.clear();}
+	void jobFinished(DataTileJob *job);
 
 private:
 	QString tileUrl() const;
@@ -50,17 +55,24 @@ private:
 	void computeZooms();
 	void updateTransform();
 	qreal tileSize() const;
+	RectD tileBBox(int x, int y) const;
 	void init();
 	void drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp);
+	bool isRunning(quint64 key) const;
+	void runJob(DataTileJob *job);
+	void removeJob(DataTileJob *job);
+	void cancelJobs(bool wait);
 
 	QString _name;
 	WMS *_wms;
 	TileLoader *_tileLoader;
+	TileCache _tileCache;
 	RectD _bounds;
 	Transform _transform;
 	QVector<double> _zooms;
 	int _zoom;
 	int _tileSize;
+	QList<DataTileJob*> _jobs;
 	qreal _mapRatio;
 };
 
@@ -6,10 +6,19 @@
 #include <QStringList>
 #include <QtAlgorithms>
 #include <QXmlStreamReader>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDateTime>
 #include "crs.h"
+#include "capabilitiesfile.h"
 #include "wmts.h"
 
 
+#define MAGIC        0x574D5453
+#define VERSION      1
+#define MODEL_SUFFIX ".model"
+
+
 static QString bareFormat(const QString &format)
 {
 	return format.left(format.indexOf(';')).trimmed();
@@ -298,6 +307,96 @@ bool WMTS::parseCapabilities(CTX &ctx)
 	return true;
 }
 
+/* The parsed capabilities model (the map setup relevant part of it) is
+   cached next to the capabilities file as parsing huge capabilities
+   documents takes seconds. The model is bound to the capabilities file size
+   and modification time and to the map setup. */
+static QString modelKey(const QString &path, const WMTS::Setup &setup)
+{
+	QFileInfo fi(path);
+	QStringList list;
+
+	list << QString::number(fi.size())
+	  << QString::number(fi.lastModified().toMSecsSinceEpoch()) << setup.url()
+	  << setup.layer() << setup.set() << setup.style() << setup.format()
+	  << QString::number(setup.rest());
+	for (int i = 0; i < setup.dimensions().size(); i++)
+		list << setup.dimensions().at(i).key()
+		  << setup.dimensions().at(i).value();
+
+	return list.join('\n');
+}
+
+bool WMTS::loadModel(const QString &key)
+{
+	QFile file(_modelPath);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic, count;
+	quint16 version;
+	QString k, crs, tileUrl;
+	double left, top, right, bottom;
+
+	stream >> magic >> version >> k;
+	if (stream.status() != QDataStream::Ok || magic != MAGIC
+	  || version != VERSION || k != key)
+		return false;
+
+	stream >> crs >> tileUrl >> left >> top >> right >> bottom >> count;
+	QList<Zoom> zooms;
+	for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+		QString id;
+		double sd;
+		PointD tl;
+		QSize tile, matrix;
+		QRect limits;
+
+		stream >> id >> sd >> tl.rx() >> tl.ry() >> tile >> matrix >> limits;
+		zooms.append(Zoom(id, sd, tl, tile, matrix, limits));
+	}
+	if (stream.status() != QDataStream::Ok || zooms.isEmpty())
+		return false;
+
+	_projection = CRS::projection(crs);
+	if (!_projection.isValid())
+		return false;
+
+	_zooms = zooms;
+	_tileUrl = tileUrl;
+	_bbox = RectC(Coordinates(left, top), Coordinates(right, bottom));
+	_cs = (_setup.coordinateSystem().axisOrder() == CoordinateSystem::Unknown)
+	  ? _projection.coordinateSystem() : _setup.coordinateSystem();
+
+	return true;
+}
+
+void WMTS::saveModel(const QString &key, const QString &crs) const
+{
+	QSaveFile file(_modelPath);
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+
+	stream << (quint32)MAGIC << (quint16)VERSION << key << crs << _tileUrl
+	  << _bbox.topLeft().lon() << _bbox.topLeft().lat()
+	  << _bbox.bottomRight().lon() << _bbox.bottomRight().lat()
+	  << (quint32)_zooms.size();
+	for (int i = 0; i < _zooms.size(); i++) {
+		const Zoom &z = _zooms.at(i);
+		stream << z.id() << z.scaleDenominator() << z.topLeft().x()
+		  << z.topLeft().y() << z.tile() << z.matrix() << z.limits();
+	}
+
+	if (stream.status() == QDataStream::Ok)
+		file.commit();
+}
+
 void WMTS::capabilitiesReady()
 {
 	if (!QFileInfo::exists(_path)) {
@@ -313,6 +412,14 @@ void WMTS::capabilitiesReady()
 
 bool WMTS::init()
 {
+	QString key;
+
+	if (!_modelPath.isNull()) {
+		key = modelKey(_path, _setup);
+		if (loadModel(key))
+			return true;
+	}
+
 	CTX ctx;
 	if (!parseCapabilities(ctx))
 		return false;
@@ -341,6 +448,9 @@ bool WMTS::init()
 		}
 	}
 
+	if (!_modelPath.isNull())
+		saveModel(key, ctx.crs);
+
 	return true;
 }
 
@@ -351,19 +461,24 @@ WMTS::WMTS(const QString &file, const WMTS::Setup &setup, QObject *parent)
 	  "%1%2service=WMTS&Version=1.0.0&request=GetCapabilities").arg(setup.url(),
 	  setup.url().contains('?') ? "&" : "?"));
 
-	_path = url.isLocalFile() ? url.toLocalFile() : file;
-
-	if (!url.isLocalFile() && !QFileInfo::exists(file)) {
-		Downloader *downloader = new Downloader(this);
-		connect(downloader, &Downloader::finished, this,
-		  &WMTS::capabilitiesReady);
-
-		QList<Download> dl;
-		dl.append(Download(url.toString(), _path));
-		_valid = downloader->get(dl, _setup.headers());
-	} else {
+	if (url.isLocalFile()) {
+		_path = url.toLocalFile();
 		_ready = true;
 		_valid = init();
+	} else {
+		_path = file;
+		_modelPath = file + MODEL_SUFFIX;
+
+		CapabilitiesFile *cf = new CapabilitiesFile(_path, this);
+		if (!cf->exists()) {
+			connect(cf, &CapabilitiesFile::finished, this,
+			  &WMTS::capabilitiesReady);
+			_valid = cf->download(url, _setup.headers());
+		} else {
+			_ready = true;
+			_valid = init();
+			cf->refresh(url, _setup.headers());
+		}
 	}
 }
 
@@ -155,10 +155,12 @@ private:
 	void capabilities(QXmlStreamReader &reader, CTX &ctx);
 	bool parseCapabilities(CTX &ctx);
 	void createZooms(const CTX &ctx);
+	bool loadModel(const QString &key);
+	void saveModel(const QString &key, const QString &crs) const;
 	bool init();
 
 	WMTS::Setup _setup;
-	QString _path;
+	QString _path, _modelPath;
 	RectC _bbox;
 	QList<Zoom> _zooms;
 	Projection _projection;
@@ -1,8 +1,7 @@
 #include <QtMath>
 #include <QPainter>
 #include <QDir>
-#include <QPixmapCache>
-#include <QtConcurrent>
+#include "common/threadpools.h"
 #include "common/rectc.h"
 #include "common/wgs84.h"
 #include "common/programpaths.h"
@@ -16,7 +15,7 @@
 #define CAPABILITIES_FILE "capabilities.xml"
 
 WMTSMap::WMTSMap(const QString &fileName, const QString &name,
-  const WMTS::Setup &setup, qreal tileRatio,
+  const WMTS::Setup &setup, const NetworkProfile &profile, qreal tileRatio,
   QObject *parent) : Map(fileName, parent), _name(name), _tileLoader(0),
   _zoom(0), _mapRatio(1.0), _tileRatio(tileRatio)
 {
@@ -24,7 +23,10 @@ WMTSMap::WMTSMap(const QString &fileName, const QString &name,
 
 	_tileLoader = new TileLoader(tilesDir, this);
 	_tileLoader->setHeaders(setup.headers());
+	_tileLoader->setNetworkProfile(profile);
 	connect(_tileLoader, &TileLoader::finished, this, &WMTSMap::tilesLoaded);
+	connect(_tileLoader, &TileLoader::tilesChanged, this,
+	  &WMTSMap::tilesChanged);
 
 	_wmts = new WMTS(QDir(tilesDir).filePath(CAPABILITIES_FILE), setup, this);
 	connect(_wmts, &WMTS::downloadFinished, this, &WMTSMap::wmtsReady);
@@ -47,6 +49,12 @@ void WMTSMap::wmtsReady()
 	emit mapLoaded();
 }
 
+void WMTSMap::unload()
+{
+	cancelJobs(true);
+	_tileCache.clear();
+}
+
 void WMTSMap::load(const Projection &in, const Projection &out,
   qreal deviceRatio, bool hidpi, int style, int layer)
 {
@@ -61,7 +69,7 @@ void WMTSMap::load(const Projection &in, const Projection &out,
 void WMTSMap::clearCache()
 {
 	_tileLoader->clearCache();
-	QPixmapCache::clear();
+	_tileCache.clear();
 }
 
 double WMTSMap::sd2res(double scaleDenominator) const
@@ -151,12 +159,16 @@ int WMTSMap::zoomFit(const QSize &size, const RectC &rect)
 
 void WMTSMap::setZoom(int zoom)
 {
+	cancelJobs(false);
+
 	_zoom = zoom;
 	updateTransform();
 }
 
 int WMTSMap::zoomIn()
 {
+	cancelJobs(false);
+
 	_zoom = qMin(_zoom + 1, _wmts->zooms().size() - 1);
 	updateTransform();
 	return _zoom;
@@ -164,6 +176,8 @@ int WMTSMap::zoomIn()
 
 int WMTSMap::zoomOut()
 {
+	cancelJobs(false);
+
 	_zoom = qMax(_zoom - 1, 0);
 	updateTransform();
 	return _zoom;
@@ -203,39 +217,114 @@ void WMTSMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 
 	if (flags & Map::Block)
 		_tileLoader->loadTilesSync(fetchTiles);
-	else
+	else {
 		_tileLoader->loadTilesAsync(fetchTiles);
 
-	QList<FileTile> renderTiles;
+		QRectF b(bounds());
+		QRect visible(tl, br - QPoint(1, 1));
+		QRect pr(_tileLoader->prefetchRect(visible, z.id(), QRect(
+		  QPoint(qFloor(b.left() / ts.width()), qFloor(b.top() / ts.height())),
+		  QPoint(qCeil(b.right() / ts.width()) - 1,
+		  qCeil(b.bottom() / ts.height()) - 1))));
+		QVector<TileLoader::Tile> prefetchTiles;
+		for (int i = pr.left(); i <= pr.right(); i++)
+			for (int j = pr.top(); j <= pr.bottom(); j++)
+				if (!visible.contains(i, j))
+					prefetchTiles.append(TileLoader::Tile(QPoint(i, j),
+					  z.id()));
+		_tileLoader->prefetchTiles(prefetchTiles);
+	}
+
+	QList<DataTile> renderTiles;
 	for (int i = 0; i < fetchTiles.count(); i++) {
 		const TileLoader::Tile &t = fetchTiles.at(i);
 		if (t.file().isNull())
 			continue;
 
+		quint64 key = TileCache::key(_zoom, t.xy());
+		if (isRunning(key))
+			continue;
+
 		QPixmap pm;
-		if (QPixmapCache::find(t.file(), &pm)) {
+		if (_tileCache.find(key, &pm, imageRatio())) {
 			QPointF tp(t.xy().x() * ts.width(), t.xy().y() * ts.height());
 			drawTile(painter, pm, tp);
 		} else
-			renderTiles.append(FileTile(t.xy(), t.file()));
+			renderTiles.append(DataTile(t.xy(), _tileLoader->tileData(t),
+			  key));
 	}
 
-	QFuture<void> future = QtConcurrent::map(renderTiles, &FileTile::load);
+	if (renderTiles.isEmpty())
+		return;
+	if (!(flags & Map::Block)) {
+		runJob(new DataTileJob(renderTiles));
+		return;
+	}
+
+	QFuture<void> future = ThreadPools::map(ThreadPools::Render,
+	  renderTiles, &DataTile::load);
 	future.waitForFinished();
 
 	for (int i = 0; i < renderTiles.size(); i++) {
-		const FileTile &mt = renderTiles.at(i);
+		const DataTile &mt = renderTiles.at(i);
 		QPixmap pm(mt.pixmap());
 		if (pm.isNull())
 			continue;
 
-		QPixmapCache::insert(mt.file(), pm);
+		_tileCache.insert(mt.key(), pm);
 
 		QPointF tp(mt.xy().x() * ts.width(), mt.xy().y() * ts.height());
 		drawTile(painter, pm, tp);
 	}
 }
 
+bool WMTSMap::isRunning(quint64 key) const
+{
+	for (int i = 0; i < _jobs.size(); i++) {
+		const QList<DataTile> &tiles = _jobs.at(i)->tiles();
+		for (int j = 0; j < tiles.size(); j++)
+			if (tiles.at(j).key() == key)
+				return true;
+	}
+
+	return false;
+}
+
+void WMTSMap::runJob(DataTileJob *job)
+{
+	_jobs.append(job);
+
+	connect(job, &DataTileJob::finished, this, &WMTSMap::jobFinished);
+	job->run();
+}
+
+void WMTSMap::removeJob(DataTileJob *job)
+{
+	_jobs.removeOne(job);
+	job->deleteLater();
+}
+
+void WMTSMap::jobFinished(DataTileJob *job)
+{
+	const QList<DataTile> &tiles = job->tiles();
+
+	for (int i = 0; i < tiles.size(); i++) {
+		const DataTile &mt = tiles.at(i);
+		if (!mt.pixmap().isNull())
+			_tileCache.insert(mt.key(), mt.pixmap());
+	}
+
+	removeJob(job);
+
+	emit tilesLoaded();
+}
+
+void WMTSMap::cancelJobs(bool wait)
+{
+	for (int i = 0; i < _jobs.size(); i++)
+		_jobs.at(i)->cancel(wait);
+}
+
 void WMTSMap::drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp)
 {
 	pixmap.setDevicePixelRatio(imageRatio());
@@ -4,6 +4,8 @@
 #include "transform.h"
 #include "projection.h"
 #include "map.h"
+#include "tilecache.h"
+#include "datatilejob.h"
 #include "rectd.h"
 #include "wmts.h"
 
@@ -15,7 +17,8 @@ class WMTSMap : public Map
 
 public:
 	WMTSMap(const QString &fileName, const QString &name,
-	  const WMTS::Setup &setup, qreal tileRatio, QObject *parent = 0);
+	  const WMTS::Setup &setup, const NetworkProfile &profile,
+	  qreal tileRatio, QObject *parent = 0);
 
 	QString name() const {return _name;}
 
@@ -35,6 +38,7 @@ public:
 
 	void load(const Projection &in, const Projection &out, qreal deviceRatio,
 	  bool hidpi, int style, int layer);
+	void unload();
 	void clearCache();
 
 	bool isReady() const {return _wmts->isReady();}
@@ -43,6 +47,8 @@ public:
 
 private slots:
 	void wmtsReady();
+	void tilesChanged() {_tileCache.clear();}
+	void jobFinished(DataTileJob *job);
 
 private:
 	double sd2res(double scaleDenominator) const;
@@ -54,13 +60,19 @@ private:
 	qreal imageRatio() const;
 	void init();
 	void drawTile(QPainter *painter, QPixmap &pixmap, QPointF &tp);
+	bool isRunning(quint64 key) const;
+	void runJob(DataTileJob *job);
+	void removeJob(DataTileJob *job);
+	void cancelJobs(bool wait);
 
 	QString _name;
 	WMTS *_wmts;
 	TileLoader *_tileLoader;
+	TileCache _tileCache;
 	Transform _transform;
 	RectD _bounds;
 	int _zoom;
+	QList<DataTileJob*> _jobs;
 	qreal _mapRatio, _tileRatio;
 };
 
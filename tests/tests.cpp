@@ -0,0 +1,237 @@
+#include <QtTest>
+#include <QRandomGenerator>
+#include <QtMath>
+#include <algorithm>
+#include "common/packedrtree.h"
+#include "map/hillshading.h"
+
+#define RTREE_QUERIES 1000
+
+typedef PackedRTree<int, qreal, 2> PackedRTreeI;
+
+struct Box {
+	qreal min[2];
+	qreal max[2];
+
+	bool overlaps(const Box &other) const
+	{
+		return !(min[0] > other.max[0] || other.min[0] > max[0]
+		  || min[1] > other.max[1] || other.min[1] > max[1]);
+	}
+};
+
+/* Random boxes of up to the given size, including points (zero size) */
+static Box box(QRandomGenerator &rnd, qreal size)
+{
+	Box b;
+
+	b.min[0] = rnd.bounded(1000.0);
+	b.min[1] = rnd.bounded(1000.0);
+	b.max[0] = b.min[0] + (rnd.bounded(4) ? rnd.bounded(size) : 0);
+	b.max[1] = b.min[1] + (rnd.bounded(4) ? rnd.bounded(size) : 0);
+
+	return b;
+}
+
+/* The hillshading kernel as it was before the row streaming version, with
+   the shading parameters passed explicitly */
+namespace Old
+{
+	struct SubMatrix
+	{
+		double z1;
+		double z2;
+		double z3;
+		double z4;
+		double z6;
+		double z7;
+		double z8;
+		double z9;
+	};
+
+	static void getSubmatrix(int x, int y, const MatrixD &m, SubMatrix &sm)
+	{
+		int left = x - 1;
+		int right = x + 1;
+		int top = y - 1;
+		int bottom = y + 1;
+
+		sm.z1 = m.at(top, left);
+		sm.z2 = m.at(top, x);
+		sm.z3 = m.at(top, right);
+		sm.z4 = m.at(y, left);
+		sm.z6 = m.at(y, right);
+		sm.z7 = m.at(bottom, left);
+		sm.z8 = m.at(bottom, x);
+		sm.z9 = m.at(bottom, right);
+	}
+
+	static QImage render(const MatrixD &m, int extend, int alpha, int azimuth,
+	  int altitude, double z, double l)
+	{
+		QImage img(m.w() - 2 * extend, m.h() - 2 * extend,
+		  QImage::Format_ARGB32_Premultiplied);
+		uchar *bits = img.bits();
+		int bpl = img.bytesPerLine();
+		SubMatrix sm;
+
+		double a = (M_PI / 180.0) * azimuth;
+		double b = (M_PI / 180.0) * altitude;
+		double a1 = sin(b);
+		double a2 = cos(b) * sin(a);
+		double a3 = cos(b) * cos(a);
+
+		for (int y = extend; y < m.h() - extend; y++) {
+			for (int x = extend; x < m.w() - extend; x++) {
+				getSubmatrix(x, y, m, sm);
+				double dzdx = (z * (sm.z3 + 2 * sm.z6 + sm.z9 - sm.z1
+				  - 2 * sm.z4 - sm.z7)) / 8;
+				double dzdy = (z * (sm.z1 + 2 * sm.z2 + sm.z3 - sm.z7
+				  - 2 * sm.z8 - sm.z9)) / 8;
+
+				double L = (a1 - a2 * dzdx - a3 * dzdy)
+				  / sqrt(1.0 + dzdx * dzdx + dzdy * dzdy);
+
+				quint32 pixel;
+				if (std::isnan(L))
+					pixel = 0;
+				else {
+					L = sqrt(L * (1.0 - l) + l);
+					quint8 val = (L < 0) ? 0 : L * alpha;
+					pixel = (alpha - val)<<24;
+				}
+
+				*(quint32*)(bits + (y - extend) * bpl + (x - extend) * 4)
+				  = pixel;
+			}
+		}
+
+		return img;
+	}
+}
+
+static MatrixD terrain(int size, bool nans)
+{
+	MatrixD m(size, size);
+
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < size; j++)
+			m.at(i, j) = (nans && (i * j) % 97 == 5) ? NAN
+			  : 500 + 200 * qSin(i * 0.05) * qCos(j * 0.03)
+			  + 20 * qSin((i + j) * 0.4);
+
+	return m;
+}
+
+static bool searchCb(int data, void *context)
+{
+	((QVector<int>*)context)->append(data);
+	return true;
+}
+
+class Tests : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void packedRTree_data();
+	void packedRTree();
+	void hillShading_data();
+	void hillShading();
+};
+
+void Tests::packedRTree_data()
+{
+	QTest::addColumn<int>("items");
+
+	QTest::newRow("empty") << 0;
+	QTest::newRow("1") << 1;
+	QTest::newRow("16") << 16;
+	QTest::newRow("17") << 17;
+	QTest::newRow("257") << 257;
+	QTest::newRow("10000") << 10000;
+}
+
+/* The packed tree search (and the search of a tree restored with SetData())
+   must give the same results as a brute-force search */
+void Tests::packedRTree()
+{
+	QFETCH(int, items);
+
+	QRandomGenerator rnd(items);
+	QVector<Box> boxes;
+	PackedRTreeI tree;
+
+	for (int i = 0; i < items; i++) {
+		boxes.append(box(rnd, 20));
+		tree.Insert(boxes.last().min, boxes.last().max, i);
+	}
+	tree.Pack();
+	QCOMPARE(tree.Count(), items);
+
+	PackedRTreeI restored;
+	QVERIFY(restored.SetData(tree.Data()));
+	QCOMPARE(restored.Count(), items);
+	const PackedRTreeI *trees[] = {&tree, &restored};
+
+	for (int i = 0; i < RTREE_QUERIES; i++) {
+		Box query(box(rnd, (i % 10) ? 50 : 1000));
+		QVector<int> expected;
+
+		for (int j = 0; j < boxes.size(); j++)
+			if (boxes.at(j).overlaps(query))
+				expected.append(j);
+
+		for (int j = 0; j < 2; j++) {
+			QVector<int> found;
+			int cnt = trees[j]->Search(query.min, query.max, searchCb, &found);
+			std::sort(found.begin(), found.end());
+
+			QCOMPARE(cnt, found.size());
+			QCOMPARE(found, expected);
+		}
+	}
+}
+
+void Tests::hillShading_data()
+{
+	QTest::addColumn<int>("extend");
+	QTest::addColumn<bool>("nans");
+	QTest::addColumn<int>("alpha");
+	QTest::addColumn<int>("azimuth");
+	QTest::addColumn<int>("altitude");
+	QTest::addColumn<double>("z");
+	QTest::addColumn<double>("l");
+
+	QTest::newRow("defaults") << 1 << false << 96 << 315 << 45 << 0.6 << 0.2;
+	QTest::newRow("extend") << 4 << false << 96 << 315 << 45 << 0.6 << 0.2;
+	QTest::newRow("nans") << 1 << true << 96 << 315 << 45 << 0.6 << 0.2;
+	QTest::newRow("light") << 2 << false << 255 << 120 << 20 << 2.0 << 0.0;
+}
+
+/* The hillshading must render exactly the same image as the previous
+   kernel */
+void Tests::hillShading()
+{
+	QFETCH(int, extend);
+	QFETCH(bool, nans);
+	QFETCH(int, alpha);
+	QFETCH(int, azimuth);
+	QFETCH(int, altitude);
+	QFETCH(double, z);
+	QFETCH(double, l);
+
+	MatrixD m(terrain(256 + 2 * extend, nans));
+
+	HillShading::setAlpha(alpha);
+	HillShading::setAzimuth(azimuth);
+	HillShading::setAltitude(altitude);
+	HillShading::setZFactor(z);
+	HillShading::setLightening(l);
+
+	QCOMPARE(HillShading::render(m, extend),
+	  Old::render(m, extend, alpha, azimuth, altitude, z, l));
+}
+
+QTEST_MAIN(Tests)
+#include "tests.moc"
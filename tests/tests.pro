@@ -0,0 +1,35 @@
+# GPXSee tests (QtTest). Build with:
+#   qmake tests/tests.pro && make
+# and run with:
+#   ./gpxsee-tests
+#
+# The tests use synthetic data only.
+
+include(../gpxsee.pro)
+
+TARGET = gpxsee-tests
+QT += testlib
+CONFIG += console
+CONFIG -= app_bundle
+
+# gpxsee.pro lists the files relative to the top directory
+APP_HEADERS = $$HEADERS
+APP_SOURCES = $$SOURCES
+APP_RESOURCES = $$RESOURCES
+APP_SOURCES -= src/main.cpp
+HEADERS =
+SOURCES =
+RESOURCES =
+for(file, APP_HEADERS): HEADERS += ../$$file
+for(file, APP_SOURCES): SOURCES += ../$$file
+for(file, APP_RESOURCES): RESOURCES += ../$$file
+INCLUDEPATH += ../src
+
+SOURCES += tests.cpp
+
+TRANSLATIONS =
+INSTALLS =
+QMAKE_BUNDLE_DATA =
+ICON =
+QMAKE_INFO_PLIST =
+RC_ICONS =